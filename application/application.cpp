@@ -188,7 +188,8 @@ void Application::check_initialization_progress()
 
 	if (!ready_pipelines)
 	{
-		if (device.query_initialization_progress(Device::InitializationStage::Pipelines) >= 100)
+		// Pipelines nobody used in earlier sessions keep compiling in the background.
+		if (device.query_initialization_progress(Device::InitializationStage::UsedPipelines) >= 100)
 		{
 			if (auto *event = GRANITE_EVENT_MANAGER())
 			{
@@ -314,7 +315,7 @@ void Application::render_loading(double, double)
 	VkClearRect rect = {};
 	rect.layerCount = 1;
 	rect.rect.extent = {
-		uint32_t(vp.width * 0.01f * float(device.query_initialization_progress(Device::InitializationStage::Pipelines))),
+		uint32_t(vp.width * 0.01f * float(device.query_initialization_progress(Device::InitializationStage::UsedPipelines))),
 		uint32_t(vp.height),
 	};
 
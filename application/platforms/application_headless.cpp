@@ -28,17 +28,19 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include "stb_image_write.h"
 #include "cli_parser.hpp"
 #include "os_filesystem.hpp"
 #include "rapidjson_wrapper.hpp"
 #include <limits.h>
 #include <cmath>
+#include <algorithm>
+#include <vector>
 #include "thread_group.hpp"
 #include "global_managers_init.hpp"
 #include "path_utils.hpp"
 #include "thread_group.hpp"
 #include "asset_manager.hpp"
+#include "frame_encoder.hpp"
 
 #ifdef HAVE_GRANITE_FFMPEG
 #include "ffmpeg_encode.hpp"
@@ -70,6 +72,7 @@ public:
 		if (last_task_dependency)
 			last_task_dependency->wait();
 		last_task_dependency.reset();
+		wait_captures();
 
 		auto *em = GRANITE_EVENT_MANAGER();
 		if (em)
@@ -82,6 +85,7 @@ public:
 
 		swapchain_images.clear();
 		readback_buffers.clear();
+		free_readback_buffers.clear();
 		acquire_semaphore.clear();
 #ifdef HAVE_GRANITE_FFMPEG
 		ycbcr_pipelines.clear();
@@ -110,6 +114,16 @@ public:
 		png_readback = std::move(base_path);
 	}
 
+	void set_capture_format(FrameCaptureFormat format)
+	{
+		capture_format = format;
+	}
+
+	void set_readback_buffer_count(unsigned count)
+	{
+		readback_buffer_count = std::max(count, 1u);
+	}
+
 	std::vector<const char *> get_instance_extensions() override
 	{
 		return {};
@@ -209,18 +223,18 @@ public:
 		info.misc |= Vulkan::IMAGE_MISC_MUTABLE_SRGB_BIT;
 		info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-		BufferCreateInfo readback = {};
-		readback.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-		readback.domain = BufferDomain::CachedHost;
-		readback.size = width * height * sizeof(uint32_t);
-
 		for (unsigned i = 0; i < SwapchainImages; i++)
 		{
 			swapchain_images.push_back(device.create_image(info, nullptr));
-			readback_buffers.push_back(device.create_buffer(readback, nullptr));
 			acquire_semaphore.emplace_back(nullptr);
 		}
 
+		for (unsigned i = 0; i < readback_buffer_count; i++)
+		{
+			readback_buffers.push_back(create_readback_buffer(device));
+			free_readback_buffers.push_back(i);
+		}
+
 		// Target present layouts to be more accurate for timing in case PRESENT_SRC forces decompress,
 		// and also makes sure pipeline caches are valid w.r.t render passes.
 		for (auto &swap : swapchain_images)
@@ -311,6 +325,9 @@ public:
 
 			if (!next_readback_path.empty() || !png_readback.empty())
 			{
+				unsigned readback_index = acquire_readback_buffer(device);
+				auto *readback = get_readback_buffer(readback_index);
+
 				OwnershipTransferInfo transfer_info = {};
 				transfer_info.old_queue = wsi.get_current_present_queue_type();
 				transfer_info.new_queue = CommandBuffer::Type::AsyncTransfer;
@@ -321,7 +338,7 @@ public:
 				auto cmd = request_command_buffer_with_ownership_transfer(device, *swapchain_images[frame_index],
 				                                                          transfer_info, release_semaphore);
 
-				cmd->copy_image_to_buffer(*readback_buffers[frame_index], *swapchain_images[frame_index],
+				cmd->copy_image_to_buffer(*readback, *swapchain_images[frame_index],
 				                          0, {}, {width, height, 1},
 				                          0, 0, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1});
 
@@ -331,23 +348,15 @@ public:
 				Fence readback_fence;
 				device.submit(cmd, &readback_fence, 1, &acquire_semaphore[frame_index]);
 
+				// Captures complete out of order on their own tasks, so they do not join the dependency chain.
 				if (!next_readback_path.empty())
 				{
-					swapchain_tasks[frame_index] = GRANITE_THREAD_GROUP()->create_task(
-							[this, readback_fence, index = frame_index, frame = this->frames, p = std::make_unique<std::string>(next_readback_path)]() mutable {
-								readback_fence->wait();
-								dump_frame_single(*p, frame, index);
-							});
+					auto format = FrameEncoder::format_from_path(next_readback_path, capture_format);
+					dump_frame_single(std::move(next_readback_path), format, frames, readback_index, std::move(readback_fence));
 					next_readback_path.clear();
 				}
 				else
-				{
-					swapchain_tasks[frame_index] = GRANITE_THREAD_GROUP()->create_task(
-							[this, readback_fence, index = frame_index, frame = this->frames]() mutable {
-								readback_fence->wait();
-								dump_frame(frame, index);
-							});
-				}
+					dump_frame(frames, readback_index, std::move(readback_fence));
 			}
 #ifdef HAVE_GRANITE_FFMPEG
 			else if (!video_encode_path.empty())
@@ -411,6 +420,7 @@ public:
 
 	void wait_threads()
 	{
+		wait_captures();
 		GRANITE_THREAD_GROUP()->wait_idle();
 	}
 
@@ -423,46 +433,123 @@ private:
 	double time_step = 0.01;
 	std::string png_readback;
 	std::string video_encode_path;
-	enum { SwapchainImages = 4 };
+	FrameCaptureFormat capture_format = FrameCaptureFormat::PNG;
+	unsigned readback_buffer_count = 4;
+	enum { SwapchainImages = 4, MaxReadbackGrowthFactor = 4 };
 
 #ifdef HAVE_GRANITE_AUDIO
 	std::unique_ptr<Audio::RecordStream> record_stream;
 #endif
 
 	std::vector<ImageHandle> swapchain_images;
-	std::vector<BufferHandle> readback_buffers;
 	std::vector<Semaphore> acquire_semaphore;
 	std::string next_readback_path;
 	TaskGroupHandle swapchain_tasks[SwapchainImages];
 	TaskGroupHandle last_task_dependency;
 
+	// Readback buffers are not tied to swapchain images. A frame holds on to its buffer until encoding completes.
+	std::mutex capture_lock;
+	std::condition_variable capture_cond;
+	std::vector<BufferHandle> readback_buffers;
+	std::vector<unsigned> free_readback_buffers;
+	unsigned captures_in_flight = 0;
+	bool warned_readback_growth = false;
+
 #ifdef HAVE_GRANITE_FFMPEG
 	VideoEncoder encoder;
 	std::vector<VideoEncoder::YCbCrPipeline> ycbcr_pipelines;
 #endif
 
-	void dump_frame_single(const std::string &path, unsigned frame, unsigned index)
+	BufferHandle create_readback_buffer(Device &device) const
 	{
-		auto &wsi = app->get_wsi();
-		auto &device = wsi.get_device();
+		BufferCreateInfo readback = {};
+		readback.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		readback.domain = BufferDomain::CachedHost;
+		readback.size = width * height * sizeof(uint32_t);
+		return device.create_buffer(readback, nullptr);
+	}
 
-		LOGI("Dumping frame: %u (index: %u)\n", frame, index);
+	unsigned acquire_readback_buffer(Device &device)
+	{
+		std::unique_lock<std::mutex> holder{capture_lock};
 
-		auto *ptr = static_cast<uint32_t *>(device.map_host_buffer(*readback_buffers[index], MEMORY_ACCESS_READ_WRITE_BIT));
-		for (unsigned i = 0; i < width * height; i++)
-			ptr[i] |= 0xff000000u;
+		// Rather than stalling the frame on a slow encoder, grow the pool up to a limit.
+		if (free_readback_buffers.empty() && readback_buffers.size() < MaxReadbackGrowthFactor * readback_buffer_count)
+		{
+			if (!warned_readback_growth)
+			{
+				LOGW("All readback buffers are in flight, growing pool. Consider increasing --readback-buffers.\n");
+				warned_readback_growth = true;
+			}
+
+			free_readback_buffers.push_back(unsigned(readback_buffers.size()));
+			readback_buffers.push_back(create_readback_buffer(device));
+		}
+
+		capture_cond.wait(holder, [this]() { return !free_readback_buffers.empty(); });
+		unsigned index = free_readback_buffers.back();
+		free_readback_buffers.pop_back();
+		captures_in_flight++;
+		return index;
+	}
 
-		if (!stbi_write_png(path.c_str(), width, height, 4, ptr, width * 4))
-			LOGE("Failed to write PNG to disk.\n");
-		device.unmap_host_buffer(*readback_buffers[index], MEMORY_ACCESS_READ_WRITE_BIT);
+	Buffer *get_readback_buffer(unsigned index)
+	{
+		std::lock_guard<std::mutex> holder{capture_lock};
+		return readback_buffers[index].get();
+	}
+
+	void release_readback_buffer(unsigned index)
+	{
+		std::lock_guard<std::mutex> holder{capture_lock};
+		free_readback_buffers.push_back(index);
+		captures_in_flight--;
+		capture_cond.notify_all();
 	}
 
-	void dump_frame(unsigned frame, unsigned index)
+	void wait_captures()
+	{
+		std::unique_lock<std::mutex> holder{capture_lock};
+		capture_cond.wait(holder, [this]() { return captures_in_flight == 0; });
+	}
+
+	void dump_frame_single(std::string path, FrameCaptureFormat format, unsigned frame, unsigned index, Fence fence)
+	{
+		auto task = GRANITE_THREAD_GROUP()->create_task(
+				[this, fence = std::move(fence), p = std::make_unique<std::string>(std::move(path)), format, frame, index]() mutable {
+					fence->wait();
+					fence.reset();
+
+					auto &device = app->get_wsi().get_device();
+					auto *buffer = get_readback_buffer(index);
+
+					LOGI("Dumping frame: %u (buffer: %u)\n", frame, index);
+
+					FrameEncoder::EncodeInfo info;
+					info.path = std::move(*p);
+					info.rgba = static_cast<const uint8_t *>(device.map_host_buffer(*buffer, MEMORY_ACCESS_READ_BIT));
+					info.width = width;
+					info.height = height;
+					info.format = format;
+					info.force_opaque = true;
+
+					FrameEncoder::encode_async(*GRANITE_THREAD_GROUP(), info, [this, buffer, index](bool) {
+						app->get_wsi().get_device().unmap_host_buffer(*buffer, MEMORY_ACCESS_READ_BIT);
+						release_readback_buffer(index);
+					});
+				});
+
+		task->set_desc("application-headless-readback");
+		task->set_task_class(TaskClass::Background);
+		task->flush();
+	}
+
+	void dump_frame(unsigned frame, unsigned index, Fence fence)
 	{
 		char buffer[64];
-		sprintf(buffer, "_%05u.png", frame);
+		snprintf(buffer, sizeof(buffer), "_%05u.%s", frame, FrameEncoder::format_extension(capture_format));
 		auto path = png_readback + buffer;
-		dump_frame_single(path, frame, index);
+		dump_frame_single(std::move(path), capture_format, frame, index, std::move(fence));
 	}
 
 	Application *app = nullptr;
@@ -471,12 +558,100 @@ private:
 
 static void print_help()
 {
-	LOGI("[--png-path <path>] [--stat <output.json>]\n"
+	LOGI("[--png-path <path>] [--stat <output.json>] [--stat-csv <output.csv>] [--warmup-frames <frames>]\n"
 	     "[--fs-assets <path>] [--fs-cache <path>] [--fs-builtin <path>]\n"
 	     "[--video-encode-path <path>]\n"
+	     "[--capture-format <png|png-uncompressed|qoi>] [--readback-buffers <count>]\n"
 	     "[--png-reference-path <path>] [--frames <frames>] [--width <width>] [--height <height>] [--time-step <step>].\n");
 }
 
+namespace
+{
+struct SampleStatistics
+{
+	size_t count = 0;
+	double mean = 0.0;
+	double variance = 0.0;
+	double min = 0.0;
+	double max = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+};
+
+struct SampleSeries
+{
+	std::string name;
+	SampleStatistics stats;
+};
+}
+
+// Linear interpolation between closest ranks. Samples must be sorted.
+static double compute_percentile(const std::vector<double> &sorted_samples, double percentile)
+{
+	if (sorted_samples.empty())
+		return 0.0;
+
+	double rank = percentile * double(sorted_samples.size() - 1);
+	auto lo = size_t(rank);
+	auto hi = std::min(lo + 1, sorted_samples.size() - 1);
+	double l = rank - double(lo);
+	return sorted_samples[lo] * (1.0 - l) + sorted_samples[hi] * l;
+}
+
+static SampleStatistics compute_sample_statistics(std::vector<double> samples)
+{
+	SampleStatistics stats;
+	if (samples.empty())
+		return stats;
+
+	std::sort(samples.begin(), samples.end());
+	stats.count = samples.size();
+	stats.min = samples.front();
+	stats.max = samples.back();
+
+	double sum = 0.0;
+	for (auto s : samples)
+		sum += s;
+	stats.mean = sum / double(stats.count);
+
+	double sq_sum = 0.0;
+	for (auto s : samples)
+		sq_sum += (s - stats.mean) * (s - stats.mean);
+	stats.variance = stats.count > 1 ? sq_sum / double(stats.count - 1) : 0.0;
+
+	stats.p50 = compute_percentile(samples, 0.50);
+	stats.p95 = compute_percentile(samples, 0.95);
+	stats.p99 = compute_percentile(samples, 0.99);
+	return stats;
+}
+
+static Value sample_statistics_to_json(const SampleStatistics &stats, Document::AllocatorType &allocator)
+{
+	Value obj(kObjectType);
+	obj.AddMember("samples", uint64_t(stats.count), allocator);
+	obj.AddMember("mean", stats.mean, allocator);
+	obj.AddMember("variance", stats.variance, allocator);
+	obj.AddMember("stddev", std::sqrt(stats.variance), allocator);
+	obj.AddMember("min", stats.min, allocator);
+	obj.AddMember("max", stats.max, allocator);
+	obj.AddMember("p50", stats.p50, allocator);
+	obj.AddMember("p95", stats.p95, allocator);
+	obj.AddMember("p99", stats.p99, allocator);
+	return obj;
+}
+
+static void append_sample_statistics_csv(std::string &csv, const char *domain, const SampleSeries &series)
+{
+	char line[1024];
+	snprintf(line, sizeof(line), "%s,\"%s\",%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+	         domain, series.name.c_str(), series.stats.count,
+	         series.stats.mean, std::sqrt(series.stats.variance),
+	         series.stats.p50, series.stats.p95, series.stats.p99,
+	         series.stats.min, series.stats.max);
+	csv += line;
+}
+
 namespace Granite
 {
 int application_main_headless(
@@ -493,10 +668,14 @@ int application_main_headless(
 		std::string video_encode_path;
 		std::string png_reference_path;
 		std::string stat;
+		std::string stat_csv;
 		std::string assets;
 		std::string cache;
 		std::string builtin;
+		FrameCaptureFormat capture_format = FrameCaptureFormat::PNG;
+		unsigned readback_buffers = 4;
 		unsigned max_frames = UINT_MAX;
+		unsigned warmup_frames = 0;
 		unsigned width = 1280;
 		unsigned height = 720;
 		double time_step = 0.01;
@@ -514,6 +693,20 @@ int application_main_headless(
 	cbs.add("--fs-builtin", [&](CLIParser &parser) { args.builtin = parser.next_string(); });
 	cbs.add("--fs-cache", [&](CLIParser &parser) { args.cache = parser.next_string(); });
 	cbs.add("--stat", [&](CLIParser &parser) { args.stat = parser.next_string(); });
+	cbs.add("--stat-csv", [&](CLIParser &parser) { args.stat_csv = parser.next_string(); });
+	cbs.add("--warmup-frames", [&](CLIParser &parser) { args.warmup_frames = parser.next_uint(); });
+	cbs.add("--readback-buffers", [&](CLIParser &parser) { args.readback_buffers = parser.next_uint(); });
+	cbs.add("--capture-format", [&](CLIParser &parser) {
+		std::string format = parser.next_string();
+		if (format == "png")
+			args.capture_format = FrameCaptureFormat::PNG;
+		else if (format == "png-uncompressed")
+			args.capture_format = FrameCaptureFormat::PNGUncompressed;
+		else if (format == "qoi")
+			args.capture_format = FrameCaptureFormat::QOI;
+		else
+			LOGE("Unknown capture format %s, using PNG.\n", format.c_str());
+	});
 	cbs.add("--help", [](CLIParser &parser)
 	{
 		print_help();
@@ -552,8 +745,14 @@ int application_main_headless(
 		if (!app->init_platform(std::move(platform)))
 			return 1;
 
-		p->set_max_frames(args.max_frames);
+		// Warm-up frames do not count towards the measured frames.
+		if (args.max_frames != UINT_MAX)
+			p->set_max_frames(args.max_frames + std::min(args.warmup_frames, UINT_MAX - 1 - args.max_frames));
+		else
+			p->set_max_frames(args.max_frames);
 		p->set_time_step(args.time_step);
+		p->set_readback_buffer_count(args.readback_buffers);
+		p->set_capture_format(args.capture_format);
 		p->init_headless(app.get());
 
 		// Ensure all startup work is complete.
@@ -581,27 +780,40 @@ int application_main_headless(
 		Global::start_audio_system();
 #endif
 
-		// Run warm-up frame.
-		if (app->poll())
+		// Run warm-up frames. These are excluded from any statistics.
+		for (unsigned i = 0; i < std::max(args.warmup_frames, 1u) && app->poll(); i++)
 		{
 			p->begin_frame();
 			app->run_frame();
 			p->end_frame();
 		}
 
+		// Per frame statistics need a sample for every frame context,
+		// and CPU timestamps even without a timeline trace.
+		bool collect_frame_samples = !args.stat.empty() || !args.stat_csv.empty();
+
 		p->wait_threads();
 		app->get_wsi().get_device().wait_idle();
+		app->get_wsi().get_device().timestamp_log_enable_frame_samples(collect_frame_samples);
 		app->get_wsi().get_device().timestamp_log_reset();
 
 		LOGI("=== Begin run ===\n");
 
+		std::vector<double> frame_times;
 		auto start_time = get_current_time_nsecs();
+		auto frame_start_time = start_time;
 		unsigned rendered_frames = 0;
 		while (app->poll())
 		{
 			p->begin_frame();
 			app->run_frame();
 			p->end_frame();
+
+			auto frame_end_time = get_current_time_nsecs();
+			if (collect_frame_samples)
+				frame_times.push_back(1e-3 * double(frame_end_time - frame_start_time));
+			frame_start_time = frame_end_time;
+
 			if (!args.video_encode_path.empty() || !args.png_path.empty())
 			{
 				LOGI("   Queued frame %u (Total time = %.3f ms).\n", rendered_frames,
@@ -622,10 +834,23 @@ int application_main_headless(
 			TimestampIntervalReport report;
 		};
 		std::vector<Report> reports;
+		std::vector<SampleSeries> cpu_series, gpu_series;
 		app->get_wsi().get_device().timestamp_log([&](const std::string &tag, const TimestampIntervalReport &report) {
 			reports.push_back({ tag, report });
+			if (report.frame_context_samples && !report.frame_context_samples->empty())
+			{
+				std::vector<double> samples_us;
+				samples_us.reserve(report.frame_context_samples->size());
+				for (auto t : *report.frame_context_samples)
+					samples_us.push_back(1e6 * t);
+				auto &series = report.device_timebase ? gpu_series : cpu_series;
+				series.push_back({ tag, compute_sample_statistics(std::move(samples_us)) });
+			}
 		});
 		app->get_wsi().get_device().timestamp_log_reset();
+		app->get_wsi().get_device().timestamp_log_enable_frame_samples(false);
+
+		SampleSeries frame_series = { "frame", compute_sample_statistics(std::move(frame_times)) };
 
 		if (rendered_frames)
 		{
@@ -641,6 +866,18 @@ int application_main_headless(
 				doc.AddMember("averageFrameTimeUs", usec, allocator);
 				doc.AddMember("gpu", StringRef(app->get_wsi().get_context().get_gpu_props().deviceName), allocator);
 				doc.AddMember("driverVersion", app->get_wsi().get_context().get_gpu_props().driverVersion, allocator);
+				doc.AddMember("warmupFrames", args.warmup_frames, allocator);
+				doc.AddMember("frameTimeUs", sample_statistics_to_json(frame_series.stats, allocator), allocator);
+
+				Value cpu_objs(kObjectType);
+				for (auto &series : cpu_series)
+					cpu_objs.AddMember(StringRef(series.name), sample_statistics_to_json(series.stats, allocator), allocator);
+				doc.AddMember("cpuPhasesUs", cpu_objs, allocator);
+
+				Value gpu_objs(kObjectType);
+				for (auto &series : gpu_series)
+					gpu_objs.AddMember(StringRef(series.name), sample_statistics_to_json(series.stats, allocator), allocator);
+				doc.AddMember("gpuPassesUs", gpu_objs, allocator);
 
 				if (!reports.empty())
 				{
@@ -663,6 +900,19 @@ int application_main_headless(
 				if (!GRANITE_FILESYSTEM()->write_string_to_file(args.stat, buffer.GetString()))
 					LOGE("Failed to write stat file to disk.\n");
 			}
+
+			if (!args.stat_csv.empty())
+			{
+				std::string csv = "domain,name,samples,mean_us,stddev_us,p50_us,p95_us,p99_us,min_us,max_us\n";
+				append_sample_statistics_csv(csv, "frame", frame_series);
+				for (auto &series : cpu_series)
+					append_sample_statistics_csv(csv, "cpu", series);
+				for (auto &series : gpu_series)
+					append_sample_statistics_csv(csv, "gpu", series);
+
+				if (!GRANITE_FILESYSTEM()->write_string_to_file(args.stat_csv, csv))
+					LOGE("Failed to write stat CSV file to disk.\n");
+			}
 		}
 
 		if (!args.png_reference_path.empty())
@@ -0,0 +1,710 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "frame_encoder.hpp"
+#include "intrusive.hpp"
+#include "logging.hpp"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+namespace Granite
+{
+namespace FrameEncoder
+{
+namespace
+{
+struct DeflateTables
+{
+	// Fixed Huffman codes, bit-reversed since deflate streams are written LSB first.
+	uint16_t lit_code[288];
+	uint8_t lit_bits[288];
+	uint16_t dist_code[30];
+
+	uint8_t length_symbol[259];
+	uint8_t distance_symbol[512];
+
+	uint32_t crc[256];
+
+	DeflateTables()
+	{
+		for (unsigned i = 0; i < 288; i++)
+		{
+			unsigned code, bits;
+			if (i < 144)
+			{
+				code = 0x30 + i;
+				bits = 8;
+			}
+			else if (i < 256)
+			{
+				code = 0x190 + (i - 144);
+				bits = 9;
+			}
+			else if (i < 280)
+			{
+				code = i - 256;
+				bits = 7;
+			}
+			else
+			{
+				code = 0xc0 + (i - 280);
+				bits = 8;
+			}
+
+			lit_code[i] = uint16_t(reverse(code, bits));
+			lit_bits[i] = uint8_t(bits);
+		}
+
+		for (unsigned i = 0; i < 30; i++)
+			dist_code[i] = uint16_t(reverse(i, 5));
+
+		for (unsigned sym = 0; sym < 29; sym++)
+			for (unsigned len = length_base[sym]; len < length_base[sym] + (1u << length_extra[sym]) && len <= 258; len++)
+				length_symbol[len] = uint8_t(sym);
+		// 258 has its own symbol without extra bits.
+		length_symbol[258] = 28;
+
+		for (unsigned sym = 0; sym < 30; sym++)
+		{
+			for (unsigned d = distance_base[sym]; d < distance_base[sym] + (1u << distance_extra[sym]); d++)
+			{
+				unsigned index = d - 1 < 256 ? d - 1 : 256 + ((d - 1) >> 7);
+				distance_symbol[index] = uint8_t(sym);
+			}
+		}
+
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (unsigned k = 0; k < 8; k++)
+				c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+			crc[i] = c;
+		}
+	}
+
+	static unsigned reverse(unsigned code, unsigned bits)
+	{
+		unsigned r = 0;
+		for (unsigned i = 0; i < bits; i++)
+			r |= ((code >> i) & 1u) << (bits - 1 - i);
+		return r;
+	}
+
+	static const uint16_t length_base[29];
+	static const uint8_t length_extra[29];
+	static const uint16_t distance_base[30];
+	static const uint8_t distance_extra[30];
+};
+
+const uint16_t DeflateTables::length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+
+const uint8_t DeflateTables::length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+
+const uint16_t DeflateTables::distance_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+
+const uint8_t DeflateTables::distance_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+static const DeflateTables &get_tables()
+{
+	static const DeflateTables tables;
+	return tables;
+}
+
+struct BitWriter
+{
+	explicit BitWriter(std::vector<uint8_t> &out_)
+		: out(out_)
+	{
+	}
+
+	void put(uint32_t value, unsigned num_bits)
+	{
+		bits |= uint64_t(value) << count;
+		count += num_bits;
+		if (count >= 32)
+		{
+			uint8_t bytes[4] = { uint8_t(bits), uint8_t(bits >> 8), uint8_t(bits >> 16), uint8_t(bits >> 24) };
+			out.insert(out.end(), bytes, bytes + 4);
+			bits >>= 32;
+			count -= 32;
+		}
+	}
+
+	void align()
+	{
+		while (count > 0)
+		{
+			out.push_back(uint8_t(bits));
+			bits >>= 8;
+			count = count > 8 ? count - 8 : 0;
+		}
+		bits = 0;
+	}
+
+	std::vector<uint8_t> &out;
+	uint64_t bits = 0;
+	unsigned count = 0;
+};
+}
+
+static uint32_t adler32(uint32_t adler, const uint8_t *data, size_t size)
+{
+	uint32_t a = adler & 0xffff;
+	uint32_t b = adler >> 16;
+	while (size)
+	{
+		// Largest block which cannot overflow b before the modulo.
+		size_t block = std::min<size_t>(size, 5552);
+		size -= block;
+		while (block--)
+		{
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return a | (b << 16);
+}
+
+static uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t len2)
+{
+	const uint32_t base = 65521;
+	uint32_t rem = uint32_t(len2 % base);
+	uint32_t sum1 = adler1 & 0xffff;
+	uint32_t sum2 = uint32_t((uint64_t(rem) * sum1) % base);
+	sum1 += (adler2 & 0xffff) + base - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+	if (sum1 >= base)
+		sum1 -= base;
+	if (sum1 >= base)
+		sum1 -= base;
+	if (sum2 >= (base << 1))
+		sum2 -= (base << 1);
+	if (sum2 >= base)
+		sum2 -= base;
+	return sum1 | (sum2 << 16);
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size)
+{
+	auto &tables = get_tables();
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = tables.crc[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static inline uint8_t paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return uint8_t(a);
+	else if (pb <= pc)
+		return uint8_t(b);
+	else
+		return uint8_t(c);
+}
+
+// Picks the filter with the smallest sum of absolute signed residuals, the usual PNG heuristic.
+static void filter_row(uint8_t *out, const uint8_t *row, const uint8_t *prev, unsigned stride, uint8_t *scratch)
+{
+	unsigned best_filter = 0;
+	unsigned best_sum = UINT32_MAX;
+
+	for (unsigned filter = 0; filter < 5; filter++)
+	{
+		unsigned sum = 0;
+		for (unsigned i = 0; i < stride; i++)
+		{
+			int a = i >= 4 ? row[i - 4] : 0;
+			int b = prev[i];
+			int c = i >= 4 ? prev[i - 4] : 0;
+			uint8_t pred;
+
+			switch (filter)
+			{
+			default:
+				pred = 0;
+				break;
+			case 1:
+				pred = uint8_t(a);
+				break;
+			case 2:
+				pred = uint8_t(b);
+				break;
+			case 3:
+				pred = uint8_t((a + b) >> 1);
+				break;
+			case 4:
+				pred = paeth(a, b, c);
+				break;
+			}
+
+			uint8_t v = uint8_t(row[i] - pred);
+			scratch[filter * stride + i] = v;
+			sum += unsigned(abs(int(int8_t(v))));
+		}
+
+		if (sum < best_sum)
+		{
+			best_sum = sum;
+			best_filter = filter;
+		}
+	}
+
+	out[0] = uint8_t(best_filter);
+	memcpy(out + 1, scratch + best_filter * stride, stride);
+}
+
+static void deflate_fixed(BitWriter &writer, const uint8_t *data, size_t size)
+{
+	constexpr unsigned HashBits = 15;
+	constexpr unsigned WindowSize = 32768;
+	constexpr unsigned MaxChain = 8;
+	constexpr unsigned MinMatch = 3;
+	constexpr unsigned MaxMatch = 258;
+
+	auto &tables = get_tables();
+	std::vector<int32_t> head(1u << HashBits, -1);
+	std::vector<int32_t> prev(WindowSize, -1);
+
+	const auto hash = [&](size_t pos) -> uint32_t {
+		uint32_t v = uint32_t(data[pos]) | (uint32_t(data[pos + 1]) << 8) | (uint32_t(data[pos + 2]) << 16);
+		return (v * 2654435761u) >> (32 - HashBits);
+	};
+
+	const auto insert = [&](size_t pos) {
+		if (pos + MinMatch > size)
+			return;
+		uint32_t h = hash(pos);
+		prev[pos & (WindowSize - 1)] = head[h];
+		head[h] = int32_t(pos);
+	};
+
+	const auto emit_literal = [&](uint8_t v) {
+		writer.put(tables.lit_code[v], tables.lit_bits[v]);
+	};
+
+	size_t pos = 0;
+	while (pos < size)
+	{
+		unsigned best_len = 0;
+		unsigned best_dist = 0;
+
+		if (pos + MinMatch <= size)
+		{
+			unsigned max_len = unsigned(std::min<size_t>(MaxMatch, size - pos));
+			int32_t candidate = head[hash(pos)];
+			for (unsigned chain = 0; chain < MaxChain && candidate >= 0; chain++)
+			{
+				size_t dist = pos - size_t(candidate);
+				if (dist > WindowSize - 1 || dist == 0)
+					break;
+
+				const uint8_t *a = data + candidate;
+				const uint8_t *b = data + pos;
+				if (a[best_len] == b[best_len])
+				{
+					unsigned len = 0;
+					while (len < max_len && a[len] == b[len])
+						len++;
+
+					if (len > best_len)
+					{
+						best_len = len;
+						best_dist = unsigned(dist);
+						if (len == max_len)
+							break;
+					}
+				}
+
+				int32_t next = prev[size_t(candidate) & (WindowSize - 1)];
+				if (next >= candidate)
+					break;
+				candidate = next;
+			}
+		}
+
+		if (best_len >= MinMatch)
+		{
+			unsigned len_sym = tables.length_symbol[best_len];
+			writer.put(tables.lit_code[257 + len_sym], tables.lit_bits[257 + len_sym]);
+			if (DeflateTables::length_extra[len_sym])
+				writer.put(best_len - DeflateTables::length_base[len_sym], DeflateTables::length_extra[len_sym]);
+
+			unsigned dist_index = best_dist - 1 < 256 ? best_dist - 1 : 256 + ((best_dist - 1) >> 7);
+			unsigned dist_sym = tables.distance_symbol[dist_index];
+			writer.put(tables.dist_code[dist_sym], 5);
+			if (DeflateTables::distance_extra[dist_sym])
+				writer.put(best_dist - DeflateTables::distance_base[dist_sym], DeflateTables::distance_extra[dist_sym]);
+
+			for (unsigned i = 0; i < best_len; i++)
+				insert(pos + i);
+			pos += best_len;
+		}
+		else
+		{
+			emit_literal(data[pos]);
+			insert(pos);
+			pos++;
+		}
+	}
+}
+
+void encode_png_stripe(Stripe &stripe, const uint8_t *rgba, unsigned width, unsigned height,
+                       unsigned first_row, unsigned num_rows, bool compress, bool force_opaque, bool last)
+{
+	unsigned stride = width * 4;
+	size_t raw_size = size_t(num_rows) * (stride + 1);
+	std::vector<uint8_t> raw(raw_size);
+	std::vector<uint8_t> rows(2 * stride);
+	std::vector<uint8_t> scratch(compress ? 5 * stride : 0);
+
+	const auto load_row = [&](uint8_t *dst, unsigned y) {
+		memcpy(dst, rgba + size_t(y) * stride, stride);
+		if (force_opaque)
+			for (unsigned x = 0; x < width; x++)
+				dst[4 * x + 3] = 0xff;
+	};
+
+	// Filters refer to the row above, which may belong to another stripe. Read it from the source.
+	uint8_t *prev = rows.data();
+	uint8_t *cur = rows.data() + stride;
+	if (first_row > 0 && first_row <= height)
+		load_row(prev, first_row - 1);
+	else
+		memset(prev, 0, stride);
+
+	for (unsigned y = 0; y < num_rows; y++)
+	{
+		uint8_t *out = raw.data() + size_t(y) * (stride + 1);
+		load_row(cur, first_row + y);
+
+		if (compress)
+			filter_row(out, cur, prev, stride, scratch.data());
+		else
+		{
+			out[0] = 0;
+			memcpy(out + 1, cur, stride);
+		}
+
+		std::swap(prev, cur);
+	}
+
+	stripe.adler = adler32(1, raw.data(), raw_size);
+	stripe.raw_size = raw_size;
+	stripe.data.clear();
+
+	BitWriter writer(stripe.data);
+
+	if (compress)
+	{
+		stripe.data.reserve(raw_size / 2);
+		writer.put(last ? 1 : 0, 1);
+		writer.put(1, 2);
+		deflate_fixed(writer, raw.data(), raw_size);
+		writer.put(get_tables().lit_code[256], get_tables().lit_bits[256]);
+
+		// An empty stored block byte-aligns the segment, like Z_SYNC_FLUSH.
+		if (!last)
+		{
+			writer.put(0, 3);
+			writer.align();
+			writer.put(0x0000, 16);
+			writer.put(0xffff, 16);
+		}
+		writer.align();
+	}
+	else
+	{
+		stripe.data.reserve(raw_size + 5 * (raw_size / 65535 + 1));
+		size_t offset = 0;
+		do
+		{
+			size_t block = std::min<size_t>(raw_size - offset, 65535);
+			bool final_block = last && offset + block == raw_size;
+			writer.put(final_block ? 1 : 0, 1);
+			writer.put(0, 2);
+			writer.align();
+			writer.put(uint32_t(block), 16);
+			writer.put(uint32_t(~block & 0xffff), 16);
+			writer.align();
+			stripe.data.insert(stripe.data.end(), raw.data() + offset, raw.data() + offset + block);
+			offset += block;
+		} while (offset < raw_size);
+	}
+}
+
+static void append_be32(std::vector<uint8_t> &out, uint32_t v)
+{
+	uint8_t bytes[4] = { uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v) };
+	out.insert(out.end(), bytes, bytes + 4);
+}
+
+static void append_chunk(std::vector<uint8_t> &out, const char *type, const Stripe *stripes, unsigned num_stripes,
+                         const uint8_t *prefix, size_t prefix_size, const uint8_t *suffix, size_t suffix_size)
+{
+	size_t size = prefix_size + suffix_size;
+	for (unsigned i = 0; i < num_stripes; i++)
+		size += stripes[i].data.size();
+
+	append_be32(out, uint32_t(size));
+	size_t crc_begin = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), prefix, prefix + prefix_size);
+	for (unsigned i = 0; i < num_stripes; i++)
+		out.insert(out.end(), stripes[i].data.begin(), stripes[i].data.end());
+	out.insert(out.end(), suffix, suffix + suffix_size);
+	append_be32(out, crc32(0, out.data() + crc_begin, out.size() - crc_begin));
+}
+
+void assemble_png(std::vector<uint8_t> &png, unsigned width, unsigned height, const Stripe *stripes, unsigned num_stripes)
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+	size_t total = 64;
+	for (unsigned i = 0; i < num_stripes; i++)
+		total += stripes[i].data.size();
+	png.clear();
+	png.reserve(total);
+	png.insert(png.end(), signature, signature + sizeof(signature));
+
+	const uint8_t ihdr[13] = {
+		uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+		uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+		8, 6, 0, 0, 0,
+	};
+	append_chunk(png, "IHDR", nullptr, 0, ihdr, sizeof(ihdr), nullptr, 0);
+
+	uint32_t adler = 1;
+	for (unsigned i = 0; i < num_stripes; i++)
+		adler = adler32_combine(adler, stripes[i].adler, stripes[i].raw_size);
+
+	const uint8_t zlib_header[2] = { 0x78, 0x01 };
+	const uint8_t zlib_trailer[4] = { uint8_t(adler >> 24), uint8_t(adler >> 16), uint8_t(adler >> 8), uint8_t(adler) };
+	append_chunk(png, "IDAT", stripes, num_stripes, zlib_header, sizeof(zlib_header), zlib_trailer, sizeof(zlib_trailer));
+	append_chunk(png, "IEND", nullptr, 0, nullptr, 0, nullptr, 0);
+}
+
+void encode_qoi(std::vector<uint8_t> &qoi, const uint8_t *rgba, unsigned width, unsigned height, bool force_opaque)
+{
+	size_t num_pixels = size_t(width) * height;
+	qoi.clear();
+	qoi.reserve(14 + num_pixels * 5 + 8);
+
+	const uint8_t header[14] = {
+		'q', 'o', 'i', 'f',
+		uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+		uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+		4, 0,
+	};
+	qoi.insert(qoi.end(), header, header + sizeof(header));
+
+	uint8_t index[64][4] = {};
+	uint8_t prev[4] = { 0, 0, 0, 0xff };
+	unsigned run = 0;
+
+	for (size_t i = 0; i < num_pixels; i++)
+	{
+		uint8_t px[4] = { rgba[4 * i + 0], rgba[4 * i + 1], rgba[4 * i + 2], rgba[4 * i + 3] };
+		if (force_opaque)
+			px[3] = 0xff;
+
+		if (memcmp(px, prev, 4) == 0)
+		{
+			run++;
+			if (run == 62 || i + 1 == num_pixels)
+			{
+				qoi.push_back(uint8_t(0xc0 | (run - 1)));
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run)
+		{
+			qoi.push_back(uint8_t(0xc0 | (run - 1)));
+			run = 0;
+		}
+
+		unsigned slot = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) & 63;
+		if (memcmp(index[slot], px, 4) == 0)
+			qoi.push_back(uint8_t(slot));
+		else
+		{
+			memcpy(index[slot], px, 4);
+
+			if (px[3] == prev[3])
+			{
+				int vr = int8_t(px[0] - prev[0]);
+				int vg = int8_t(px[1] - prev[1]);
+				int vb = int8_t(px[2] - prev[2]);
+				int vg_r = vr - vg;
+				int vg_b = vb - vg;
+
+				if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1)
+				{
+					qoi.push_back(uint8_t(0x40 | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2)));
+				}
+				else if (vg_r >= -8 && vg_r <= 7 && vg >= -32 && vg <= 31 && vg_b >= -8 && vg_b <= 7)
+				{
+					qoi.push_back(uint8_t(0x80 | (vg + 32)));
+					qoi.push_back(uint8_t(((vg_r + 8) << 4) | (vg_b + 8)));
+				}
+				else
+				{
+					const uint8_t op[4] = { 0xfe, px[0], px[1], px[2] };
+					qoi.insert(qoi.end(), op, op + 4);
+				}
+			}
+			else
+			{
+				const uint8_t op[5] = { 0xff, px[0], px[1], px[2], px[3] };
+				qoi.insert(qoi.end(), op, op + 5);
+			}
+		}
+
+		memcpy(prev, px, 4);
+	}
+
+	static const uint8_t padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	qoi.insert(qoi.end(), padding, padding + sizeof(padding));
+}
+
+static bool write_file(const std::string &path, const std::vector<uint8_t> &data)
+{
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		LOGE("Failed to open %s for writing.\n", path.c_str());
+		return false;
+	}
+
+	bool ret = fwrite(data.data(), 1, data.size(), file) == data.size();
+	if (fclose(file) != 0)
+		ret = false;
+	if (!ret)
+		LOGE("Failed to write %s.\n", path.c_str());
+	return ret;
+}
+
+namespace
+{
+struct EncodeJob : Util::ThreadSafeIntrusivePtrEnabled<EncodeJob>
+{
+	EncodeInfo info;
+	std::vector<Stripe> stripes;
+	unsigned rows_per_stripe = 0;
+	std::function<void (bool)> on_complete;
+};
+}
+
+void encode_async(ThreadGroup &group, const EncodeInfo &info, std::function<void (bool)> on_complete)
+{
+	auto job = Util::make_handle<EncodeJob>();
+	job->info = info;
+	job->on_complete = std::move(on_complete);
+
+	auto write_task = group.create_task([job]() mutable {
+		auto &encode = job->info;
+		std::vector<uint8_t> encoded;
+		if (encode.format == FrameCaptureFormat::QOI)
+			encode_qoi(encoded, encode.rgba, encode.width, encode.height, encode.force_opaque);
+		else
+			assemble_png(encoded, encode.width, encode.height, job->stripes.data(), unsigned(job->stripes.size()));
+
+		job->stripes.clear();
+		bool ret = write_file(encode.path, encoded);
+		if (job->on_complete)
+			job->on_complete(ret);
+	});
+	write_task->set_desc("frame-encode-write");
+	write_task->set_task_class(TaskClass::Background);
+
+	if (info.format != FrameCaptureFormat::QOI)
+	{
+		// Stripes of at least 64 rows keep deflate efficient, and there is no point in more stripes than threads.
+		unsigned max_stripes = std::max(1u, group.get_num_threads());
+		unsigned num_stripes = std::max(1u, std::min(max_stripes, info.height / 64));
+		job->rows_per_stripe = (info.height + num_stripes - 1) / num_stripes;
+		num_stripes = (info.height + job->rows_per_stripe - 1) / job->rows_per_stripe;
+		job->stripes.resize(num_stripes);
+
+		auto stripe_task = group.create_task();
+		stripe_task->set_desc("frame-encode-png-stripes");
+		stripe_task->set_task_class(TaskClass::Background);
+
+		for (unsigned i = 0; i < num_stripes; i++)
+		{
+			stripe_task->enqueue_task([job, i]() mutable {
+				auto &encode = job->info;
+				unsigned first_row = i * job->rows_per_stripe;
+				unsigned num_rows = std::min(job->rows_per_stripe, encode.height - first_row);
+				bool last = i + 1 == job->stripes.size();
+				encode_png_stripe(job->stripes[i], encode.rgba, encode.width, encode.height,
+				                  first_row, num_rows, encode.format == FrameCaptureFormat::PNG,
+				                  encode.force_opaque, last);
+			});
+		}
+
+		group.add_dependency(*write_task, *stripe_task);
+		stripe_task->flush();
+	}
+
+	write_task->flush();
+}
+
+FrameCaptureFormat format_from_path(const std::string &path, FrameCaptureFormat fallback)
+{
+	auto dot = path.find_last_of('.');
+	if (dot != std::string::npos && path.compare(dot, std::string::npos, ".qoi") == 0)
+		return FrameCaptureFormat::QOI;
+	else if (fallback == FrameCaptureFormat::QOI)
+		return FrameCaptureFormat::PNG;
+	else
+		return fallback;
+}
+
+const char *format_extension(FrameCaptureFormat format)
+{
+	return format == FrameCaptureFormat::QOI ? "qoi" : "png";
+}
+}
+}
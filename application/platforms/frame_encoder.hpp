@@ -0,0 +1,80 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "thread_group.hpp"
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace Granite
+{
+enum class FrameCaptureFormat
+{
+	// Deflated PNG, encoded in parallel row stripes.
+	PNG,
+	// PNG with stored deflate blocks. Large files, but close to memcpy speed.
+	PNGUncompressed,
+	// Quite OK Image format. Sequential, but much cheaper than deflate.
+	QOI
+};
+
+namespace FrameEncoder
+{
+struct Stripe
+{
+	std::vector<uint8_t> data;
+	uint32_t adler = 1;
+	size_t raw_size = 0;
+};
+
+// Filters and deflates rows [first_row, first_row + num_rows) of tightly packed RGBA8 pixels.
+// Every stripe is a byte-aligned deflate segment which references no data outside itself,
+// so stripes can be encoded independently and concatenated with assemble_png().
+void encode_png_stripe(Stripe &stripe, const uint8_t *rgba, unsigned width, unsigned height,
+                       unsigned first_row, unsigned num_rows, bool compress, bool force_opaque, bool last);
+void assemble_png(std::vector<uint8_t> &png, unsigned width, unsigned height, const Stripe *stripes, unsigned num_stripes);
+
+void encode_qoi(std::vector<uint8_t> &qoi, const uint8_t *rgba, unsigned width, unsigned height, bool force_opaque);
+
+struct EncodeInfo
+{
+	std::string path;
+	const uint8_t *rgba = nullptr;
+	unsigned width = 0;
+	unsigned height = 0;
+	FrameCaptureFormat format = FrameCaptureFormat::PNG;
+	bool force_opaque = true;
+};
+
+// Encodes and writes the image on background threads. PNG stripes run in parallel.
+// rgba must remain valid until on_complete is called. on_complete is called from a worker thread
+// with the result of writing the file.
+void encode_async(ThreadGroup &group, const EncodeInfo &info, std::function<void (bool)> on_complete);
+
+FrameCaptureFormat format_from_path(const std::string &path, FrameCaptureFormat fallback);
+const char *format_extension(FrameCaptureFormat format);
+}
+}
@@ -195,6 +195,9 @@ void SceneViewerApplication::read_config(const std::string &path)
 	if (doc.HasMember("debugProbes"))
 		config.debug_probes = doc["debugProbes"].GetBool();
 
+	if (doc.HasMember("gbufferParallelCommandBuffers"))
+		config.gbuffer_parallel_command_buffers = doc["gbufferParallelCommandBuffers"].GetUint();
+
 	if (doc.HasMember("directionalLightShadows"))
 		config.directional_light_shadows = doc["directionalLightShadows"].GetBool();
 
@@ -919,6 +922,7 @@ void SceneViewerApplication::add_main_pass_deferred(Device &device, const std::s
 			setup.flags |= SCENE_RENDERER_DEBUG_PROBES_BIT;
 
 		renderer->init(setup);
+		renderer->set_num_parallel_command_buffers(config.gbuffer_parallel_command_buffers);
 
 		gbuffer.set_render_pass_interface(std::move(renderer));
 	}
@@ -1376,6 +1380,11 @@ void SceneViewerApplication::update_scene(TaskComposer &composer, double frame_t
 		}
 	});
 
+	// Node transforms are final at this point, so the camera's view of the scene can drive residency.
+	updates.enqueue_task([this, frame_time]() {
+		residency_feedback.update(scene_loader.get_scene(), *selected_camera, frame_time);
+	});
+
 	need_shadow_map_update = false;
 	scene.refresh_per_frame(context, composer);
 }
@@ -1466,6 +1475,9 @@ void SceneViewerApplication::render_scene(TaskComposer &composer)
 
 void SceneViewerApplication::post_frame()
 {
+	// Must happen before the asset manager iterates.
+	if (auto *manager = GRANITE_ASSET_MANAGER())
+		residency_feedback.commit(*manager);
 	Application::post_frame();
 	scene_loader.get_scene().destroy_queued_entities();
 }
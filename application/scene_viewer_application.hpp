@@ -34,6 +34,7 @@
 #include "render_graph.hpp"
 #include "mesh_util.hpp"
 #include "scene_renderer.hpp"
+#include "asset_residency.hpp"
 #include "lights/clusterer.hpp"
 #include "lights/volumetric_fog.hpp"
 #include "lights/deferred_lights.hpp"
@@ -80,6 +81,7 @@ protected:
 	FPSCamera cam;
 	SceneLoader scene_loader;
 	std::unique_ptr<AnimationSystem> animation_system;
+	AssetResidencyFeedback residency_feedback;
 
 	Camera *selected_camera = nullptr;
 	DirectionalLightComponent *selected_directional = nullptr;
@@ -155,6 +157,7 @@ private:
 		bool volumetric_diffuse = false;
 		bool ssao = true;
 		bool debug_probes = false;
+		unsigned gbuffer_parallel_command_buffers = 1;
 		bool ssr = false;
 		PostAAType postaa_type = PostAAType::None;
 	};
@@ -5,6 +5,10 @@ precision highp int;
 #include "inc/render_target.h"
 #include "inc/two_component_normal.h"
 
+#if defined(VARIANT_BIT_1) && VARIANT_BIT_1
+#define CLIPMAP
+#endif
+
 #if defined(VARIANT_BIT_0) && VARIANT_BIT_0
 #define BANDLIMITED_PIXEL
 #include "inc/bandlimited_pixel_filter.h"
@@ -21,8 +25,13 @@ layout(push_constant, std430) uniform Constants
 
 layout(location = 1) in highp vec2 vUV;
 
+#ifdef CLIPMAP
+layout(location = 2) in highp vec3 vClipUV;
+layout(set = 2, binding = 1) uniform mediump sampler2DArray uNormalsTerrain;
+#else
 layout(set = 2, binding = 1) uniform mediump sampler2D uNormalsTerrain;
 layout(set = 2, binding = 2) uniform mediump sampler2D uOcclusionTerrain;
+#endif
 layout(set = 2, binding = 4) uniform mediump sampler2DArray uBaseColor;
 layout(set = 2, binding = 5) uniform mediump sampler2D uSplatMap;
 layout(set = 2, binding = 6) uniform mediump sampler2D uDeepRoughNormals;
@@ -68,10 +77,16 @@ void main()
         types.w * texture(uBaseColor, vec3(uv, 3.0)).rgb;
 #endif
 
+#ifdef CLIPMAP
+    mediump vec3 terrain = two_component_normal(texture(uNormalsTerrain, vClipUV).xy * 2.0 - 1.0);
+    mediump float occlusion = 1.0;
+#else
     mediump vec3 terrain = two_component_normal(texture(uNormalsTerrain, vUV).xy * 2.0 - 1.0);
+    mediump float occlusion = texture(uOcclusionTerrain, vUV).x;
+#endif
     terrain.xy += types.w * 0.5 * (texture(uDeepRoughNormals, uv).xy * 2.0 - 1.0);
     mediump vec3 normal = normalize(mat3(registers.Normal) * terrain.xzy); // Normal is +Y, Bitangent is +Z.
 
-    emit_render_target(vec3(0.0), vec4(base_color, 1.0), normal, 0.0, 1.0, texture(uOcclusionTerrain, vUV).x, vPos);
+    emit_render_target(vec3(0.0), vec4(base_color, 1.0), normal, 0.0, 1.0, occlusion, vPos);
 }
 
@@ -1,22 +1,33 @@
 #version 450
 #include "inc/render_parameters.h"
 
+#if defined(VARIANT_BIT_1) && VARIANT_BIT_1
+#define CLIPMAP
+#endif
+
 layout(location = 0) in uvec4 aPosition;
 layout(location = 1) in vec4 aLODWeights;
 
 #ifndef RENDERER_DEPTH
 layout(location = 0) out highp vec3 vPos;
 layout(location = 1) out highp vec2 vUV;
+#ifdef CLIPMAP
+layout(location = 2) out highp vec3 vClipUV;
+#endif
 #endif
 
+#ifdef CLIPMAP
+layout(set = 2, binding = 0) uniform sampler2DArray uHeightmap;
+#else
 layout(set = 2, binding = 0) uniform sampler2D uHeightmap;
 layout(set = 2, binding = 3) uniform sampler2D uLodMap;
+#endif
 
 struct PatchData
 {
     vec2 Offsets;
     float InnerLOD;
-    float Padding;
+    float Level;
     vec4 LODs;
 };
 
@@ -31,6 +42,8 @@ layout(std140, set = 3, binding = 1) uniform GroundData
     vec2 uUVShift;
     vec2 uUVTilingScale;
     vec2 uTangentScale;
+    vec4 uColorSize;
+    vec2 uInvClipmapSize;
 };
 
 layout(push_constant, std430) uniform Constants
@@ -51,8 +64,39 @@ vec2 warp_position()
     uvec2 mask = (uvec2(1u) << uvec2(ufloor_lod, ufloor_lod + 1u)) - 1u;
     uvec4 rounding = aPosition.zwzw * mask.xxyy;
     vec4 lower_upper_snapped = vec4((aPosition.xyxy + rounding) & ~mask.xxyy);
-    return mix(lower_upper_snapped.xy, lower_upper_snapped.zw, fract_lod) + patches.data[gl_InstanceIndex].Offsets;
+    vec2 grid = mix(lower_upper_snapped.xy, lower_upper_snapped.zw, fract_lod);
+#ifdef CLIPMAP
+    // Clipmap patches are a fixed vertex grid scaled up by their ring level.
+    grid *= exp2(patches.data[gl_InstanceIndex].Level);
+#endif
+    return grid + patches.data[gl_InstanceIndex].Offsets;
+}
+
+#ifdef CLIPMAP
+void main()
+{
+    vec2 texel = warp_position();
+    vec2 pos = texel * uInvHeightmapSize;
+    float level = patches.data[gl_InstanceIndex].Level;
+
+    // Rings are stored toroidally, so wrapping the level-local texel coordinate finds the slot.
+    // The far world edge has no tile beyond it, so clamp to the last texel of the level.
+    vec2 level_texel = min(texel, 1.0 / uInvHeightmapSize - exp2(level)) * exp2(-level);
+    vec3 clip_uv = vec3((level_texel + 0.5) * uInvClipmapSize, level);
+    float height_displacement = clamp(textureLod(uHeightmap, clip_uv, 0.0).x, -1.0, 1.0);
+
+#ifndef RENDERER_DEPTH
+    vUV = pos + uUVShift;
+    vClipUV = clip_uv;
+#endif
+
+    vec4 world = registers.Model * vec4(pos.x, height_displacement, pos.y, 1.0);
+#ifndef RENDERER_DEPTH
+    vPos = world.xyz;
+#endif
+    gl_Position = global.view_projection * world;
 }
+#else
 
 mediump vec2 lod_factor(vec2 uv)
 {
@@ -91,3 +135,4 @@ void main()
 #endif
     gl_Position = global.view_projection * world;
 }
+#endif
@@ -43,7 +43,7 @@ layout(set = MESHLET_RENDER_DESCRIPTOR_SET, binding = MESHLET_RENDER_AABB_BINDIN
 
 layout(set = MESHLET_RENDER_DESCRIPTOR_SET, binding = MESHLET_RENDER_TRANSFORM_BINDING, std430) readonly buffer Transforms
 {
-	mat4 data[];
+	mat3x4 data[];
 } transforms;
 
 #ifdef MESHLET_RENDER_HIZ_BINDING
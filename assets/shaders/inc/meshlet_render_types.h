@@ -51,4 +51,10 @@ struct IndirectDrawMesh
 	uint vertex_count;
 };
 
+// Node transforms are 3x4 affine matrices where each column holds one row of the transform.
+mat4 affine_to_mat4(mat3x4 m)
+{
+	return transpose(mat4(m));
+}
+
 #endif
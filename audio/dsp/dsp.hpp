@@ -25,6 +25,7 @@
 #include <math.h>
 #include <stdint.h>
 #include "simd_headers.hpp"
+#include "simd_dispatch.hpp"
 
 namespace Granite
 {
@@ -38,7 +39,7 @@ static inline void accumulate_channel_deinterleave_stereo(float * __restrict lef
                                                           size_t count) noexcept
 {
 #if defined(__SSE__)
-	size_t rounded_count = count & ~4;
+	size_t rounded_count = count & ~size_t(3);
 	__m128 gain_left_splat = _mm_set1_ps(gain[0]);
 	__m128 gain_right_splat = _mm_set1_ps(gain[1]);
 	for (size_t i = 0; i < rounded_count; i += 4)
@@ -76,43 +77,7 @@ static inline void accumulate_channel_deinterleave_stereo(float * __restrict lef
 
 static inline void accumulate_channel(float * __restrict output, const float * __restrict input, float gain, size_t count) noexcept
 {
-#ifdef __ARM_NEON
-	size_t rounded_count = count & ~3;
-	for (size_t i = 0; i < rounded_count; i += 4)
-	{
-		float32x4_t acc = vld1q_f32(output);
-		float32x4_t in = vld1q_f32(input);
-		acc = vmlaq_n_f32(acc, in, gain);
-		vst1q_f32(output, acc);
-
-		output += 4;
-		input += 4;
-	}
-
-	size_t overflow_count = count & 3;
-	for (size_t i = 0; i < overflow_count; i++)
-		output[i] += input[i] * gain;
-#elif defined(__SSE__)
-	size_t rounded_count = count & ~3;
-	__m128 gain_splat = _mm_set1_ps(gain);
-	for (size_t i = 0; i < rounded_count; i += 4)
-	{
-		__m128 acc = _mm_loadu_ps(output);
-		__m128 in = _mm_loadu_ps(input);
-		acc = _mm_add_ps(acc, _mm_mul_ps(in, gain_splat));
-		_mm_storeu_ps(output, acc);
-
-		output += 4;
-		input += 4;
-	}
-
-	size_t overflow_count = count & 3;
-	for (size_t i = 0; i < overflow_count; i++)
-		output[i] += input[i] * gain;
-#else
-	for (size_t i = 0; i < count; i++)
-		output[i] += input[i] * gain;
-#endif
+	SIMD::get_dispatch().accumulate(output, input, gain, count);
 }
 
 static inline void accumulate_channel_s32(float * __restrict output, const int32_t * __restrict input,
@@ -88,10 +88,10 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
-#include "simd_headers.hpp"
 #include "sinc_resampler.hpp"
 #include "aligned_alloc.hpp"
 #include "dsp.hpp"
+#include "simd_dispatch.hpp"
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -213,6 +213,7 @@ SincResampler::SincResampler(float out_rate, float in_rate, Quality quality)
 
 	init_table_kaiser(cutoff, 1u << phase_bits, taps, kaiser_beta);
 	set_sample_rate_ratio(bandwidth_mod);
+	sinc_dot = SIMD::get_dispatch().sinc_dot;
 }
 
 void SincResampler::set_sample_rate_ratio(float ratio) noexcept
@@ -259,62 +260,13 @@ inline void SincResampler::process(float *output) const noexcept
 	const float *sample_phase_table = phase_table + phase * num_taps * 2;
 	const float *delta_table = sample_phase_table + num_taps;
 
-#ifdef __SSE__
-	__m128 sum = _mm_setzero_ps();
-	__m128 delta = _mm_set1_ps(float(time & subphase_mask) * subphase_mod);
-	for (unsigned i = 0; i < num_taps; i += 4)
-	{
-		__m128 buf = _mm_loadu_ps(buffer + i);
-		__m128 deltas = _mm_load_ps(delta_table + i);
-		__m128 _sinc  = _mm_add_ps(_mm_load_ps(sample_phase_table + i), _mm_mul_ps(deltas, delta));
-		sum = _mm_add_ps(sum, _mm_mul_ps(buf, _sinc));
-	}
-
-	// Horizontal add.
-	sum = _mm_add_ps(_mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 2, 3)), sum);
-	sum = _mm_add_ss(_mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)), sum);
-
-	if (accumulate)
-		_mm_store_ss(output, _mm_add_ss(_mm_load_ss(output), sum));
-	else
-		_mm_store_ss(output, sum);
-#elif defined(__ARM_NEON)
-	float delta = float(time & subphase_mask) * subphase_mod;
-	float32x4_t sum = vdupq_n_f32(0.0f);
-	for (unsigned i = 0; i < taps; i += 4)
-	{
-		float32x4_t _phases = vld1q_f32(phase_table + i);
-		float32x4_t deltas = vld1q_f32(delta_table + i);
-		float32x4_t buf = vld1q_f32(buffer + i);
-		float32x4_t _sinc = vmlaq_n_f32(_phases, deltas, delta);
-		sum = vmlaq_f32(sum, buf, _sinc);
-	}
-
-	float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
-	float32x2_t res = vpadd_f32(half, half);
-
-	if (accumulate)
-	{
-		float32x2_t o = vld1_dup_f32(output);
-		res = vadd_f32(o, res);
-		vst1_lane_f32(output, res, 0);
-	}
-	else
-		vst1_lane_f32(output, res, 0);
-#else
 	float delta = float(time & subphase_mask) * subphase_mod;
-	float sum = 0.0f;
-	for (unsigned i = 0; i < taps; i++)
-	{
-		float sinc_val = phase_table[i] + delta_table[i] * delta;
-		sum += buffer[i] * sinc_val;
-	}
+	float sum = sinc_dot(buffer, sample_phase_table, delta_table, delta, num_taps);
 
 	if (accumulate)
 		*output += sum;
 	else
 		*output = sum;
-#endif
 }
 
 template <bool accumulate>
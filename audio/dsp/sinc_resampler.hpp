@@ -73,6 +73,9 @@ private:
 	float *phase_table = nullptr;
 	float *window_buffer = nullptr;
 
+	// Resolved once from the SIMD dispatch table.
+	float (*sinc_dot)(const float *buffer, const float *phases, const float *deltas, float delta, unsigned taps) = nullptr;
+
 	void init_table_kaiser(double cutoff, unsigned phase_count, unsigned num_taps, double beta);
 
 	template <bool accumulate>
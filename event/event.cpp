@@ -21,11 +21,52 @@
  */
 
 #include "event.hpp"
+#include "aligned_alloc.hpp"
 #include <algorithm>
+#include <atomic>
 #include <assert.h>
 
 namespace Granite
 {
+static constexpr size_t EventBucketBlockSize = 16 * 1024;
+
+EventBucket::EventBucket(size_t stride_, size_t alignment_,
+                         void (*destroy_)(Event *), Event *(*get_event_)(void *))
+	: stride(stride_), alignment(alignment_), destroy(destroy_), get_event(get_event_)
+{
+	events_per_block = std::max<size_t>(1, EventBucketBlockSize / stride);
+}
+
+EventBucket::~EventBucket()
+{
+	clear();
+	for (auto *block : blocks)
+		Util::memalign_free(block);
+}
+
+void *EventBucket::allocate()
+{
+	size_t block_index = count / events_per_block;
+	if (block_index == blocks.size())
+	{
+		auto *block = static_cast<uint8_t *>(Util::memalign_alloc(alignment, events_per_block * stride));
+		if (!block)
+			throw std::bad_alloc();
+		blocks.push_back(block);
+	}
+
+	void *ptr = blocks[block_index] + (count % events_per_block) * stride;
+	count++;
+	return ptr;
+}
+
+void EventBucket::clear()
+{
+	for (size_t i = 0; i < count; i++)
+		destroy(&get(i));
+	count = 0;
+}
+
 EventManager::~EventManager()
 {
 	dispatch();
@@ -42,25 +83,69 @@ EventManager::~EventManager()
 
 void EventManager::dispatch()
 {
-	for (auto &event_type : events)
+	// A handler calling dispatch() would swap the buckets while we iterate over them.
+	// Anything it expects to be delivered is already queued for the next dispatch().
+	if (dispatching_queued)
+		return;
+	dispatching_queued = true;
+
+	dispatch_buckets.clear();
+	for (auto &shard : queue_shards)
 	{
-		auto &handlers = event_type.handlers;
-		auto &queued_events = event_type.queued_events;
-		auto itr = remove_if(begin(handlers), end(handlers), [&](const Handler &handler) {
-			for (auto &event : queued_events)
-			{
-				if (!handler.mem_fn(handler.handler, *event))
+		unsigned dispatch_index;
+		{
+			std::lock_guard<std::mutex> holder{shard.lock};
+			dispatch_index = shard.index;
+			shard.index ^= 1;
+		}
+
+		for (auto &bucket : shard.buckets[dispatch_index])
+			if (bucket.size())
+				dispatch_buckets.push_back(&bucket);
+	}
+
+	// Keep the batches of one type together. Stable, so each thread's events stay in order.
+	std::stable_sort(dispatch_buckets.begin(), dispatch_buckets.end(), [](const EventBucket *a, const EventBucket *b) {
+		return a->get_hash() < b->get_hash();
+	});
+
+	for (auto *bucket : dispatch_buckets)
+	{
+		auto *event_type = events.find(bucket->get_hash());
+		if (event_type)
+		{
+			// Handlers registered from within a handler are added once the batch is done.
+			event_type->dispatching = true;
+			auto &handlers = event_type->handlers;
+			auto itr = remove_if(begin(handlers), end(handlers), [&](const Handler &handler) {
+				for (size_t i = 0, n = bucket->size(); i < n; i++)
 				{
-					handler.unregister_key->release_manager_reference();
-					return true;
+					if (!handler.mem_fn(handler.handler, bucket->get(i)))
+					{
+						handler.unregister_key->release_manager_reference();
+						return true;
+					}
 				}
-			}
-			return false;
-		});
+				return false;
+			});
+
+			handlers.erase(itr, end(handlers));
+			event_type->flush_recursive_handlers();
+			event_type->dispatching = false;
+		}
 
-		handlers.erase(itr, end(handlers));
-		queued_events.clear();
+		bucket->clear();
 	}
+
+	dispatching_queued = false;
+}
+
+EventManager::QueueShard &EventManager::get_queue_shard()
+{
+	// Threads are spread round-robin over the shards in the order they first enqueue.
+	static std::atomic<unsigned> shard_counter;
+	static thread_local unsigned shard_index = shard_counter.fetch_add(1, std::memory_order_relaxed) % NumQueueShards;
+	return queue_shards[shard_index];
 }
 
 void EventManager::dispatch_event(std::vector<Handler> &handlers, const Event &e)
@@ -26,8 +26,11 @@
 #include <memory>
 #include <stdexcept>
 #include <utility>
+#include <mutex>
+#include <new>
 #include "compile_time_hash.hpp"
 #include "intrusive_hash_map.hpp"
+#include "small_vector.hpp"
 #include "global_managers.hpp"
 
 #define EVENT_MANAGER_REGISTER(clazz, member, event) \
@@ -109,17 +112,66 @@ private:
 	uint32_t event_manager_ref_count = 0;
 };
 
+// Queued events of one type are constructed in place in fixed size blocks.
+// Blocks are retained after dispatch, so steady-state queueing does not allocate.
+class EventBucket : public Util::IntrusiveHashMapEnabled<EventBucket>
+{
+public:
+	EventBucket(size_t stride, size_t alignment,
+	            void (*destroy)(Event *), Event *(*get_event)(void *));
+	~EventBucket();
+	EventBucket(const EventBucket &) = delete;
+	void operator=(const EventBucket &) = delete;
+
+	template<typename T, typename... P>
+	void emplace(P&&... p)
+	{
+		new (allocate()) T(std::forward<P>(p)...);
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	Event &get(size_t index) const
+	{
+		return *get_event(blocks[index / events_per_block] + (index % events_per_block) * stride);
+	}
+
+	void clear();
+
+private:
+	Util::SmallVector<uint8_t *> blocks;
+	size_t count = 0;
+	size_t stride;
+	size_t alignment;
+	size_t events_per_block;
+	void (*destroy)(Event *);
+	Event *(*get_event)(void *);
+
+	void *allocate();
+};
+
 class EventManager final : public EventManagerInterface
 {
 public:
+	// Thread-safe. Events are dispatched in batches per type on the next dispatch().
+	// Events queued while dispatching are deferred to the next dispatch().
+	// Events from one thread are delivered in order per type, there is no ordering between threads.
 	template<typename T, typename... P>
 	void enqueue(P&&... p)
 	{
 		static constexpr auto type = T::get_type_id();
-		auto &l = events[type];
-
-		auto ptr = std::unique_ptr<Event>(new T(std::forward<P>(p)...));
-		l.queued_events.emplace_back(std::move(ptr));
+		auto &shard = get_queue_shard();
+		std::lock_guard<std::mutex> holder{shard.lock};
+		auto *bucket = shard.buckets[shard.index].find(type);
+		if (!bucket)
+		{
+			bucket = shard.buckets[shard.index].emplace_yield(
+					type, sizeof(T), alignof(T), destroy_event<T>, get_event<T>);
+		}
+		bucket->template emplace<T>(std::forward<P>(p)...);
 	}
 
 	template<typename T, typename... P>
@@ -160,6 +212,8 @@ public:
 		dispatch_event(l.handlers, e);
 	}
 
+	// Not thread-safe. Calls from within an event handler return immediately,
+	// the events are delivered by the next dispatch() instead.
 	void dispatch();
 
 	template<typename T, typename EventType, bool (T::*mem_fn)(const EventType &)>
@@ -218,7 +272,6 @@ private:
 
 	struct EventTypeData : Util::IntrusiveHashMapEnabled<EventTypeData>
 	{
-		std::vector<std::unique_ptr<Event>> queued_events;
 		std::vector<Handler> handlers;
 		std::vector<Handler> recursive_handlers;
 		bool enqueueing = false;
@@ -244,8 +297,38 @@ private:
 	void dispatch_up_event(LatchEventTypeData &event_type, const Event &event);
 	void dispatch_down_event(LatchEventTypeData &event_type, const Event &event);
 
+	template<typename T>
+	static void destroy_event(Event *e)
+	{
+		static_cast<T *>(e)->~T();
+	}
+
+	template<typename T>
+	static Event *get_event(void *storage)
+	{
+		return static_cast<T *>(storage);
+	}
+
 	Util::IntrusiveHashMap<EventTypeData> events;
 	Util::IntrusiveHashMap<LatchEventTypeData> latched_events;
 	uint64_t cookie_counter = 0;
+
+	// Every thread appends to one of a fixed set of shards, so producers on different threads
+	// rarely contend on the same lock. Each shard is double buffered so that enqueue can proceed
+	// while the other set of buckets is dispatched.
+	struct QueueShard
+	{
+		std::mutex lock;
+		Util::IntrusiveHashMap<EventBucket> buckets[2];
+		unsigned index = 0;
+	};
+
+	enum { NumQueueShards = 16 };
+	QueueShard queue_shards[NumQueueShards];
+	QueueShard &get_queue_shard();
+
+	// Buckets of all shards, grouped by type for dispatch. Retained to avoid allocating every dispatch().
+	std::vector<EventBucket *> dispatch_buckets;
+	bool dispatching_queued = false;
 };
 }
@@ -46,13 +46,25 @@ AssetManager::~AssetManager()
 
 AssetID AssetManager::register_asset_nolock(FileHandle file, AssetClass asset_class, int prio)
 {
-	auto *info = pool.allocate();
+	AssetInfo *info;
+	if (!free_ids.empty())
+	{
+		// Reclaimed assets are already reset.
+		info = asset_bank[free_ids.back()];
+		free_ids.pop_back();
+		info->unregistered = false;
+	}
+	else
+	{
+		info = pool.allocate();
+		info->id.id = id_count;
+		asset_bank[id_count++] = info;
+	}
+
 	info->handle = std::move(file);
-	info->id.id = id_count;
 	info->prio = prio;
 	info->asset_class = asset_class;
 	AssetID ret = info->id;
-	asset_bank[id_count++] = info;
 	if (iface)
 	{
 		iface->set_id_bounds(id_count);
@@ -65,6 +77,10 @@ void AssetInstantiatorInterface::set_asset_class(AssetID, AssetClass)
 {
 }
 
+void AssetInstantiatorInterface::instantiate_asset_level(AssetManager &, TaskGroup *, AssetID, File &, unsigned)
+{
+}
+
 AssetID AssetManager::register_asset(FileHandle file, AssetClass asset_class, int prio)
 {
 	std::lock_guard<std::mutex> holder{asset_bank_lock};
@@ -90,10 +106,80 @@ AssetID AssetManager::register_asset(Filesystem &fs, const std::string &path, As
 	return id;
 }
 
-void AssetManager::update_cost(AssetID id, uint64_t cost)
+void AssetManager::unregister_asset(AssetID id)
+{
+	std::lock_guard<std::mutex> holder{asset_bank_lock};
+	if (id.id >= id_count || asset_bank[id.id]->unregistered)
+		return;
+
+	auto *info = asset_bank[id.id];
+	info->unregistered = true;
+	info->prio = 0;
+
+	// The path may be registered again right away, and must get a fresh ID.
+	if (info->get_hash())
+	{
+		file_to_assets.erase(info);
+		info->set_hash(0);
+	}
+
+	// Without an instantiator, nothing can be resident or in flight.
+	if (!iface)
+		reclaim_locked(info);
+	else
+		unregistered_assets.push_back(info);
+}
+
+bool AssetManager::reclaim_locked(AssetInfo *info)
+{
+	// In-flight instantiation still reads from the file, and will report back through update_cost().
+	if (info->pending_consumed != 0 || has_pending_level(info))
+		return false;
+
+	if (info->consumed)
+		release_locked(info);
+
+	info->handle.reset();
+	info->last_used = 0;
+	info->num_levels = 0;
+	info->pinned_level = 0;
+	info->resident_level = 0;
+	info->requested_level = 0;
+	info->target_level = 0;
+	free_ids.push_back(info->id.id);
+	return true;
+}
+
+void AssetManager::reclaim_unregistered_locked()
 {
+	auto itr = std::remove_if(unregistered_assets.begin(), unregistered_assets.end(),
+	                          [this](AssetInfo *info) { return reclaim_locked(info); });
+	unregistered_assets.erase(itr, unregistered_assets.end());
+}
+
+void AssetManager::update_cost(AssetID id, uint64_t cost, unsigned resident_level)
+{
+	std::lock_guard<std::mutex> holder{cost_update_lock};
+	thread_cost_updates.push_back({ id, cost, resident_level });
+}
+
+void AssetManager::update_level_costs(AssetID id, unsigned num_levels, unsigned pinned_level,
+                                      const uint64_t *level_costs)
+{
+	if (num_levels > MaxResidencyLevels || pinned_level >= num_levels)
+	{
+		LOGE("Invalid residency levels for ID %u.\n", id.id);
+		return;
+	}
+
+	LevelUpdate update;
+	update.id = id;
+	update.num_levels = num_levels;
+	update.pinned_level = pinned_level;
+	std::copy(level_costs, level_costs + num_levels, update.level_costs);
+
 	std::lock_guard<std::mutex> holder{cost_update_lock};
-	thread_cost_updates.push_back({ id, cost });
+	thread_level_updates.push_back(update);
 }
 
 void AssetManager::set_asset_instantiator_interface(AssetInstantiatorInterface *iface_)
@@ -111,9 +197,15 @@ void AssetManager::set_asset_instantiator_interface(AssetInstantiatorInterface *
 		a->consumed = 0;
 		a->pending_consumed = 0;
 		a->last_used = 0;
+		a->num_levels = 0;
+		a->resident_level = 0;
+		a->requested_level = 0;
 	}
 	total_consumed = 0;
 
+	// Nothing is in flight anymore.
+	reclaim_unregistered_locked();
+
 	iface = iface_;
 	if (iface)
 	{
@@ -141,12 +233,29 @@ void AssetManager::set_asset_budget_per_iteration(uint64_t cost)
 bool AssetManager::set_asset_residency_priority(AssetID id, int prio)
 {
 	std::lock_guard<std::mutex> holder{asset_bank_lock};
-	if (id.id >= id_count)
+	if (id.id >= id_count || asset_bank[id.id]->unregistered)
 		return false;
 	asset_bank[id.id]->prio = prio;
 	return true;
 }
 
+int AssetManager::get_asset_residency_priority(AssetID id) const
+{
+	std::lock_guard<std::mutex> holder{asset_bank_lock};
+	if (id.id >= id_count)
+		return -1;
+	return asset_bank[id.id]->prio;
+}
+
+bool AssetManager::set_asset_residency_target_level(AssetID id, unsigned level)
+{
+	std::lock_guard<std::mutex> holder{asset_bank_lock};
+	if (id.id >= id_count || asset_bank[id.id]->unregistered)
+		return false;
+	asset_bank[id.id]->target_level = level;
+	return true;
+}
+
 void AssetManager::adjust_update(const CostUpdate &update)
 {
 	if (update.id.id < id_count)
@@ -156,24 +265,97 @@ void AssetManager::adjust_update(const CostUpdate &update)
 		a->consumed = update.cost;
 		a->pending_consumed = 0;
 
+		if (update.resident_level != UINT32_MAX)
+		{
+			a->resident_level = update.resident_level;
+			a->requested_level = update.resident_level;
+		}
+
 		// A recently paged in image shouldn't be paged out right away in a situation where we're thrashing,
 		// that'd be very dumb.
 		a->last_used = timestamp;
 	}
 }
 
+void AssetManager::adjust_level_update(const LevelUpdate &update)
+{
+	if (update.id.id < id_count)
+	{
+		auto *a = asset_bank[update.id.id];
+		a->num_levels = update.num_levels;
+		a->pinned_level = update.pinned_level;
+		std::copy(update.level_costs, update.level_costs + update.num_levels, a->level_costs);
+	}
+}
+
 uint64_t AssetManager::get_current_total_consumed() const
 {
 	return total_consumed;
 }
 
+bool AssetManager::has_pending_level(const AssetInfo *info)
+{
+	return info->requested_level != info->resident_level;
+}
+
+void AssetManager::release_locked(AssetInfo *info)
+{
+	iface->release_asset(info->id);
+	total_consumed -= info->consumed;
+	info->consumed = 0;
+	info->resident_level = 0;
+	info->requested_level = 0;
+}
+
+bool AssetManager::can_trim_levels(const AssetInfo *info) const
+{
+	return info->consumed != 0 && info->num_levels != 0 &&
+	       info->resident_level < info->pinned_level && !has_pending_level(info);
+}
+
+uint64_t AssetManager::trim_levels(TaskGroup *task, AssetInfo *info, uint64_t required)
+{
+	// Drop the finest levels first until enough is freed, but never the pinned tail.
+	unsigned level = info->resident_level;
+	uint64_t freed = 0;
+	while (level < info->pinned_level && freed < required)
+		freed += info->level_costs[level++];
+
+	return trim_to_level(task, info, level);
+}
+
+uint64_t AssetManager::trim_to_level(TaskGroup *task, AssetInfo *info, unsigned level)
+{
+	level = std::min(level, info->pinned_level);
+	if (level <= info->resident_level)
+		return 0;
+
+	uint64_t freed = 0;
+	for (unsigned i = info->resident_level; i < level; i++)
+		freed += info->level_costs[i];
+
+	// The real cost is corrected when the instantiator reports back.
+	freed = std::min(freed, info->consumed);
+	iface->instantiate_asset_level(*this, task, info->id, *info->handle, level);
+	info->requested_level = level;
+	info->consumed -= freed;
+	total_consumed -= freed;
+	return freed;
+}
+
 void AssetManager::update_costs_locked_assets()
 {
 	{
 		std::lock_guard<std::mutex> holder_cost{cost_update_lock};
 		std::swap(cost_updates, thread_cost_updates);
+		std::swap(level_updates, thread_level_updates);
 	}
 
+	// Level layouts are reported before the cost update of the initial instantiation.
+	for (auto &update : level_updates)
+		adjust_level_update(update);
+	level_updates.clear();
+
 	for (auto &update : cost_updates)
 		adjust_update(update);
 	cost_updates.clear();
@@ -198,7 +380,7 @@ bool AssetManager::iterate_blocking(ThreadGroup &group, AssetID id)
 	update_costs_locked_assets();
 	update_lru_locked_assets();
 
-	if (id.id >= id_count)
+	if (id.id >= id_count || asset_bank[id.id]->unregistered)
 		return false;
 
 	auto *candidate = asset_bank[id.id];
@@ -253,6 +435,7 @@ void AssetManager::iterate(ThreadGroup *group)
 	std::lock_guard<std::mutex> holder{asset_bank_lock};
 	update_costs_locked_assets();
 	update_lru_locked_assets();
+	reclaim_unregistered_locked();
 
 	memcpy(sorted_assets.data(), asset_bank.data(), id_count * sizeof(sorted_assets[0]));
 	std::sort(sorted_assets.data(), sorted_assets.data() + id_count, [](const AssetInfo *a, const AssetInfo *b) -> bool {
@@ -305,12 +488,10 @@ void AssetManager::iterate(ThreadGroup *group)
 		while (!can_activate && activate_index + 1 != release_index)
 		{
 			auto *release_candidate = sorted_assets[--release_index];
-			if (release_candidate->consumed)
+			if (release_candidate->consumed && !has_pending_level(release_candidate))
 			{
 				LOGI("Releasing ID %u due to page-in pressure.\n", release_candidate->id.id);
-				iface->release_asset(release_candidate->id);
-				total_consumed -= release_candidate->consumed;
-				release_candidate->consumed = 0;
+				release_locked(release_candidate);
 			}
 			can_activate = total_consumed + estimate <= transfer_budget;
 		}
@@ -330,6 +511,63 @@ void AssetManager::iterate(ThreadGroup *group)
 		}
 	}
 
+	// Refine assets with residency levels one level at a time, most important first.
+	// To make room, trim streamed levels of less important assets rather than releasing them outright.
+	uint64_t refined_cost_this_iteration = 0;
+	unsigned refine_count = 0;
+	size_t trim_index = release_index;
+	for (size_t i = 0; i < release_index && activated_cost_this_iteration < transfer_budget_per_iteration; i++)
+	{
+		auto *candidate = sorted_assets[i];
+		if (candidate->prio <= 0)
+			break;
+
+		if (candidate->consumed == 0 || candidate->num_levels == 0 ||
+		    candidate->resident_level <= candidate->target_level || has_pending_level(candidate))
+		{
+			continue;
+		}
+
+		unsigned level = candidate->resident_level - 1;
+		uint64_t cost = candidate->level_costs[level];
+
+		while (total_consumed + cost > transfer_budget && trim_index > i + 1)
+		{
+			auto *victim = sorted_assets[trim_index - 1];
+			bool less_important = victim->prio < candidate->prio ||
+			                      (victim->prio == candidate->prio && victim->last_used < candidate->last_used);
+
+			if (!less_important)
+				break;
+
+			if (can_trim_levels(victim))
+				trim_levels(task.get(), victim, total_consumed + cost - transfer_budget);
+			else
+				trim_index--;
+		}
+
+		// Everything after this is less important, so stop here.
+		if (total_consumed + cost > transfer_budget)
+			break;
+
+		iface->instantiate_asset_level(*this, task.get(), candidate->id, *candidate->handle, level);
+		candidate->requested_level = level;
+		candidate->pending_consumed = cost;
+		total_consumed += cost;
+		activated_cost_this_iteration += cost;
+		refined_cost_this_iteration += cost;
+		refine_count++;
+	}
+
+	// Levels finer than what the asset is expected to need are dropped even when in budget,
+	// so that memory tracks what is actually visible.
+	for (size_t i = 0; i < release_index; i++)
+	{
+		auto *candidate = sorted_assets[i];
+		if (candidate->target_level > candidate->resident_level && can_trim_levels(candidate))
+			trim_to_level(task.get(), candidate, candidate->target_level);
+	}
+
 	// If we're 75% of budget, start garbage collecting non-resident resources ahead of time.
 	const uint64_t low_image_budget = (transfer_budget * 3) / 4;
 
@@ -347,24 +585,38 @@ void AssetManager::iterate(ThreadGroup *group)
 		return false;
 	};
 
-	// If we're over budget, deactivate resources.
+	// If we're over budget, degrade gracefully by trimming streamed levels before releasing whole resources.
+	for (size_t i = release_index; i > activate_index && total_consumed > transfer_budget; i--)
+	{
+		auto *candidate = sorted_assets[i - 1];
+		if (candidate->prio == persistent_prio())
+			break;
+		if (can_trim_levels(candidate))
+			trim_levels(task.get(), candidate, total_consumed - transfer_budget);
+	}
+
+	// If we're still over budget, deactivate resources.
 	while (should_release())
 	{
 		auto *candidate = sorted_assets[--release_index];
-		if (candidate->consumed)
+		if (candidate->consumed && !has_pending_level(candidate))
 		{
 			LOGI("Releasing 0-prio ID %u due to page-in pressure.\n", candidate->id.id);
-			iface->release_asset(candidate->id);
-			total_consumed -= candidate->consumed;
-			candidate->consumed = 0;
+			release_locked(candidate);
 			candidate->last_used = 0;
 		}
 	}
 
-	if (activated_cost_this_iteration)
+	if (activated_cost_this_iteration - refined_cost_this_iteration)
 	{
 		LOGI("Activated %u resources for %llu KiB.\n", activation_count,
-		     static_cast<unsigned long long>(activated_cost_this_iteration / 1024));
+		     static_cast<unsigned long long>((activated_cost_this_iteration - refined_cost_this_iteration) / 1024));
+	}
+
+	if (refined_cost_this_iteration)
+	{
+		LOGI("Streamed in %u levels for %llu KiB.\n", refine_count,
+		     static_cast<unsigned long long>(refined_cost_this_iteration / 1024));
 	}
 
 	iface->latch_handles();
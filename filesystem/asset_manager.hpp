@@ -30,6 +30,7 @@
 #include <vector>
 #include <mutex>
 #include <memory>
+#include <stdint.h>
 
 namespace Granite
 {
@@ -86,6 +87,12 @@ public:
 	virtual void set_id_bounds(uint32_t bound) = 0;
 	virtual void set_asset_class(AssetID id, AssetClass asset_class);
 
+	// Only called for assets which reported levels through manager.update_level_costs().
+	// Moves the finest resident level of an instantiated asset to level, either streaming in or trimming.
+	// When the transition completes, manager.update_cost() must be called with the new cost and resident level.
+	virtual void instantiate_asset_level(AssetManager &manager, TaskGroup *group, AssetID id, File &mapping,
+	                                     unsigned level);
+
 	// Called in AssetManager::iterate().
 	virtual void latch_handles() = 0;
 };
@@ -96,6 +103,9 @@ public:
 	// Persistent prio means the resource is treated as an internal LUT that must always be resident, no matter what.
 	constexpr static int persistent_prio() { return 0x7fffffff; }
 
+	// Upper bound for mip-granular residency levels of a single asset.
+	enum { MaxResidencyLevels = 16 };
+
 	AssetManager();
 	~AssetManager() override;
 
@@ -110,8 +120,18 @@ public:
 	AssetID register_asset(FileHandle file, AssetClass asset_class, int prio = 1);
 	AssetID register_asset(Filesystem &fs, const std::string &path, AssetClass asset_class, int prio = 1);
 
+	// The ID must not be used afterwards. The asset is released and its ID recycled in the next iterate(),
+	// or a later one if it is still being instantiated.
+	void unregister_asset(AssetID id);
+
 	// Prio 0: Not resident, resource may not exist.
 	bool set_asset_residency_priority(AssetID id, int prio);
+	// Returns -1 for unknown IDs.
+	int get_asset_residency_priority(AssetID id) const;
+
+	// For assets with residency levels, the finest level which is worth streaming in, e.g. from projected size.
+	// Finer levels are not refined, and resident levels finer than this are trimmed. Defaults to level 0.
+	bool set_asset_residency_target_level(AssetID id, unsigned level);
 
 	// Intended to be called in Application::post_frame(). Not thread safe.
 	// This function updates internal state.
@@ -119,7 +139,13 @@ public:
 	bool iterate_blocking(ThreadGroup &group, AssetID id);
 
 	// Always thread safe, used by AssetInstantiatorInterfaces to update cost estimates.
-	void update_cost(AssetID id, uint64_t cost);
+	// For assets with residency levels, resident_level is the finest level which is now resident.
+	void update_cost(AssetID id, uint64_t cost, unsigned resident_level = UINT32_MAX);
+
+	// Always thread safe. Opts an asset into mip-granular residency, with level 0 being the finest.
+	// Levels [pinned_level, num_levels) are loaded on instantiation and only released with the asset.
+	// Finer levels are streamed in by priority and trimmed under budget pressure before whole assets are released.
+	void update_level_costs(AssetID id, unsigned num_levels, unsigned pinned_level, const uint64_t *level_costs);
 
 	// May be called concurrently, except when calling iterate().
 	uint64_t get_current_total_consumed() const;
@@ -139,14 +165,24 @@ private:
 		AssetID id = {};
 		AssetClass asset_class = AssetClass::ImageZeroable;
 		int prio = 0;
+
+		uint64_t level_costs[MaxResidencyLevels] = {};
+		uint32_t num_levels = 0;
+		uint32_t pinned_level = 0;
+		uint32_t resident_level = 0;
+		uint32_t requested_level = 0;
+		uint32_t target_level = 0;
+		bool unregistered = false;
 	};
 
 	Util::DynamicArray<AssetInfo *> sorted_assets;
 	Util::DynamicArray<AssetInfo *> asset_bank;
-	std::mutex asset_bank_lock;
+	mutable std::mutex asset_bank_lock;
 	Util::ObjectPool<AssetInfo> pool;
 	Util::AtomicAppendBuffer<AssetID> lru_append;
 	Util::IntrusiveHashMapHolder<AssetInfo> file_to_assets;
+	std::vector<AssetInfo *> unregistered_assets;
+	std::vector<uint32_t> free_ids;
 
 	AssetInstantiatorInterface *iface = nullptr;
 	uint32_t id_count = 0;
@@ -160,12 +196,32 @@ private:
 	{
 		AssetID id;
 		uint64_t cost = 0;
+		uint32_t resident_level = UINT32_MAX;
 	};
+
+	struct LevelUpdate
+	{
+		AssetID id;
+		uint32_t num_levels = 0;
+		uint32_t pinned_level = 0;
+		uint64_t level_costs[MaxResidencyLevels] = {};
+	};
+
 	std::mutex cost_update_lock;
 	std::vector<CostUpdate> thread_cost_updates;
 	std::vector<CostUpdate> cost_updates;
+	std::vector<LevelUpdate> thread_level_updates;
+	std::vector<LevelUpdate> level_updates;
 
 	void adjust_update(const CostUpdate &update);
+	void adjust_level_update(const LevelUpdate &update);
+	void release_locked(AssetInfo *info);
+	bool reclaim_locked(AssetInfo *info);
+	void reclaim_unregistered_locked();
+	bool can_trim_levels(const AssetInfo *info) const;
+	uint64_t trim_levels(TaskGroup *task, AssetInfo *info, uint64_t required);
+	uint64_t trim_to_level(TaskGroup *task, AssetInfo *info, unsigned level);
+	static bool has_pending_level(const AssetInfo *info);
 	std::unique_ptr<TaskSignal> signal;
 	AssetID register_asset_nolock(FileHandle file, AssetClass asset_class, int prio);
 
@@ -23,7 +23,11 @@
 #include "fs-netfs.hpp"
 #include "path_utils.hpp"
 #include "logging.hpp"
+#include "hash.hpp"
+#include "lz4_block.hpp"
+#include "os_filesystem.hpp"
 #include <assert.h>
+#include <stdlib.h>
 #include <queue>
 
 #define HOST_IP "localhost"
@@ -32,8 +36,8 @@ namespace Granite
 {
 struct FSNotifyCommand : LooperHandler
 {
-	FSNotifyCommand(const string &protocol, unique_ptr<Socket> socket_)
-		: LooperHandler(move(socket_)), expected(false)
+	FSNotifyCommand(const std::string &protocol, std::unique_ptr<Socket> socket_)
+		: LooperHandler(std::move(socket_)), expected(false)
 	{
 		reply_queue.emplace();
 		auto &reply = reply_queue.back();
@@ -56,15 +60,15 @@ struct FSNotifyCommand : LooperHandler
 	~FSNotifyCommand()
 	{
 		if (!expected)
-			terminate();
+			std::terminate();
 	}
 
-	void set_notify_cb(function<void (const FileNotifyInfo &)> func)
+	void set_notify_cb(std::function<void (const FileNotifyInfo &)> func)
 	{
-		notify_cb = move(func);
+		notify_cb = std::move(func);
 	}
 
-	void push_register_notification(const string &path, promise<FileNotifyHandle> result)
+	void push_register_notification(const std::string &path, std::promise<FileNotifyHandle> result)
 	{
 		if (reply_queue.empty() && socket->get_parent_looper())
 			socket->get_parent_looper()->modify_handler(EVENT_IN | EVENT_OUT, *this);
@@ -75,10 +79,10 @@ struct FSNotifyCommand : LooperHandler
 		reply.builder.add_string(path);
 		reply.writer.start(reply.builder.get_buffer());
 
-		replies.push(move(result));
+		replies.push(std::move(result));
 	}
 
-	void push_unregister_notification(FileNotifyHandle handler, promise<FileNotifyHandle> result)
+	void push_unregister_notification(FileNotifyHandle handler, std::promise<FileNotifyHandle> result)
 	{
 		if (reply_queue.empty() && socket->get_parent_looper())
 			socket->get_parent_looper()->modify_handler(EVENT_IN | EVENT_OUT, *this);
@@ -89,7 +93,7 @@ struct FSNotifyCommand : LooperHandler
 		reply.builder.add_u64(8);
 		reply.builder.add_u64(uint64_t(handler));
 		reply.writer.start(reply.builder.get_buffer());
-		replies.push(move(result));
+		replies.push(std::move(result));
 	}
 
 	void modify_looper(Looper &looper)
@@ -259,18 +263,18 @@ struct FSNotifyCommand : LooperHandler
 		SocketWriter writer;
 		ReplyBuilder builder;
 	};
-	queue<NotificationReply> reply_queue;
-	queue<promise<FileNotifyHandle>> replies;
-	function<void (const FileNotifyInfo &info)> notify_cb;
-	atomic_bool expected;
+	std::queue<NotificationReply> reply_queue;
+	std::queue<std::promise<FileNotifyHandle>> replies;
+	std::function<void (const FileNotifyInfo &info)> notify_cb;
+	std::atomic_bool expected;
 };
 
 struct FSReadCommand : LooperHandler
 {
 	virtual ~FSReadCommand() = default;
 
-	FSReadCommand(const string &path, NetFSCommand command, unique_ptr<Socket> socket_)
-		: LooperHandler(move(socket_))
+	FSReadCommand(const std::string &path, NetFSCommand command, std::unique_ptr<Socket> socket_)
+		: LooperHandler(std::move(socket_))
 	{
 		reply_builder.begin();
 		reply_builder.add_u32(command);
@@ -357,52 +361,23 @@ struct FSReadCommand : LooperHandler
 	virtual void parse_reply() = 0;
 };
 
-struct FSReader : FSReadCommand
-{
-	FSReader(const string &path, unique_ptr<Socket> socket_)
-		: FSReadCommand(path, NETFS_READ_FILE, move(socket_))
-	{
-	}
-
-	~FSReader()
-	{
-		if (!got_reply)
-			result.set_exception(make_exception_ptr(runtime_error("file read")));
-	}
-
-	void parse_reply() override
-	{
-		got_reply = true;
-		try
-		{
-			result.set_value(reply_builder.consume_buffer());
-		}
-		catch (...)
-		{
-		}
-	}
-
-	promise<vector<uint8_t>> result;
-	bool got_reply = false;
-};
-
 struct FSList : FSReadCommand
 {
-	FSList(const string &path, unique_ptr<Socket> socket_)
-		: FSReadCommand(path, NETFS_LIST, move(socket_))
+	FSList(const std::string &path, std::unique_ptr<Socket> socket_)
+		: FSReadCommand(path, NETFS_LIST, std::move(socket_))
 	{
 	}
 
 	~FSList()
 	{
 		if (!got_reply)
-			result.set_exception(make_exception_ptr(runtime_error("List failed")));
+			result.set_exception(std::make_exception_ptr(std::runtime_error("List failed")));
 	}
 
 	void parse_reply() override
 	{
 		uint32_t entries = reply_builder.read_u32();
-		vector<ListEntry> list;
+		std::vector<ListEntry> list;
 		for (uint32_t i = 0; i < entries; i++)
 		{
 			auto path = reply_builder.read_string();
@@ -411,13 +386,13 @@ struct FSList : FSReadCommand
 			switch (type)
 			{
 			case NETFS_FILE_TYPE_PLAIN:
-				list.push_back({ move(path), PathType::File });
+				list.push_back({ std::move(path), PathType::File });
 				break;
 			case NETFS_FILE_TYPE_DIRECTORY:
-				list.push_back({ move(path), PathType::Directory });
+				list.push_back({ std::move(path), PathType::Directory });
 				break;
 			case NETFS_FILE_TYPE_SPECIAL:
-				list.push_back({ move(path), PathType::Special });
+				list.push_back({ std::move(path), PathType::Special });
 				break;
 			}
 		}
@@ -425,73 +400,23 @@ struct FSList : FSReadCommand
 		got_reply = true;
 		try
 		{
-			result.set_value(move(list));
+			result.set_value(std::move(list));
 		}
 		catch (...)
 		{
 		}
 	}
 
-	promise<vector<ListEntry>> result;
-	bool got_reply = false;
-};
-
-struct FSStat : FSReadCommand
-{
-	FSStat(const string &path, unique_ptr<Socket> socket_)
-		: FSReadCommand(path, NETFS_STAT, move(socket_))
-	{
-	}
-
-	~FSStat()
-	{
-		// Throw exception instead in calling thread.
-		if (!got_reply)
-			result.set_exception(make_exception_ptr(runtime_error("Failed stat")));
-	}
-
-	void parse_reply() override
-	{
-		uint64_t size = reply_builder.read_u64();
-		uint32_t type = reply_builder.read_u32();
-		uint64_t last_modified = reply_builder.read_u64();
-		FileStat s;
-		s.size = size;
-		s.last_modified = last_modified;
-
-		switch (type)
-		{
-		case NETFS_FILE_TYPE_PLAIN:
-			s.type = PathType::File;
-			break;
-		case NETFS_FILE_TYPE_DIRECTORY:
-			s.type = PathType::Directory;
-			break;
-		case NETFS_FILE_TYPE_SPECIAL:
-			s.type = PathType::Special;
-			break;
-		}
-
-		got_reply = true;
-		try
-		{
-			result.set_value(s);
-		}
-		catch (...)
-		{
-		}
-	}
-
-	std::promise<FileStat> result;
+	std::promise<std::vector<ListEntry>> result;
 	bool got_reply = false;
 };
 
 struct FSWriteCommand : LooperHandler
 {
-	FSWriteCommand(const string &path, const vector<uint8_t> &buffer, unique_ptr<Socket> socket_)
-		: LooperHandler(move(socket_))
+	FSWriteCommand(const std::string &path, const void *data, size_t size, std::unique_ptr<Socket> socket_)
+		: LooperHandler(std::move(socket_))
 	{
-		target_size = buffer.size();
+		target_size = size;
 
 		reply_builder.begin();
 		result_reply.begin(4 * sizeof(uint32_t));
@@ -500,8 +425,8 @@ struct FSWriteCommand : LooperHandler
 		reply_builder.add_u32(NETFS_BEGIN_CHUNK_REQUEST);
 		reply_builder.add_string(path);
 		reply_builder.add_u32(NETFS_BEGIN_CHUNK_REQUEST);
-		reply_builder.add_u64(buffer.size());
-		reply_builder.add_buffer(buffer);
+		reply_builder.add_u64(size);
+		reply_builder.add_data(data, size);
 		command_writer.start(reply_builder.get_buffer());
 		command_reader.start(result_reply.get_buffer());
 		state = WriteCommand;
@@ -537,7 +462,7 @@ struct FSWriteCommand : LooperHandler
 	~FSWriteCommand()
 	{
 		if (!got_reply)
-			result.set_exception(make_exception_ptr(runtime_error("Failed write")));
+			result.set_exception(std::make_exception_ptr(std::runtime_error("Failed write")));
 	}
 
 	bool read_reply(Looper &)
@@ -589,13 +514,392 @@ struct FSWriteCommand : LooperHandler
 	ReplyBuilder result_reply;
 	size_t target_size = 0;
 
-	promise<NetFSError> result;
+	std::promise<NetFSError> result;
 	bool got_reply = false;
 };
 
-NetworkFilesystem::NetworkFilesystem()
+static bool parse_stat_reply(ReplyBuilder &reply, FileStat &s)
 {
-	looper_thread = thread(&NetworkFilesystem::looper_entry, this);
+	s.size = reply.read_u64();
+	uint32_t type = reply.read_u32();
+	s.last_modified = reply.read_u64();
+
+	switch (type)
+	{
+	case NETFS_FILE_TYPE_PLAIN:
+		s.type = PathType::File;
+		break;
+	case NETFS_FILE_TYPE_DIRECTORY:
+		s.type = PathType::Directory;
+		break;
+	case NETFS_FILE_TYPE_SPECIAL:
+		s.type = PathType::Special;
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+// Persistent connection where requests from any thread are tagged and pipelined,
+// so many reads can be in flight without paying a connection and round-trip per request.
+struct FSSession : LooperHandler
+{
+	FSSession(NetworkFilesystem &fs_, const std::string &protocol, std::unique_ptr<Socket> socket_)
+		: LooperHandler(std::move(socket_)), fs(fs_)
+	{
+		write_queue.emplace();
+		auto &handshake = write_queue.back();
+		handshake.builder.add_u32(NETFS_BEGIN_SESSION);
+		handshake.builder.add_u32(NETFS_BEGIN_CHUNK_REQUEST);
+		handshake.builder.add_string(protocol);
+		handshake.writer.start(handshake.builder.get_buffer());
+
+		reply_builder.begin(NetFSSessionHeaderSize);
+		command_reader.start(reply_builder.get_buffer());
+	}
+
+	~FSSession()
+	{
+		if (fs.session == this)
+			fs.session = nullptr;
+
+		for (auto &request : pending)
+			request.second.set_exception(std::make_exception_ptr(std::runtime_error("NetFS session closed")));
+	}
+
+	void push_request(uint64_t tag, NetFSCommand command, ReplyBuilder &payload,
+	                  std::promise<std::vector<uint8_t>> result)
+	{
+		if (write_queue.empty() && socket->get_parent_looper())
+			socket->get_parent_looper()->modify_handler(EVENT_IN | EVENT_OUT, *this);
+
+		write_queue.emplace();
+		auto &frame = write_queue.back();
+		frame.builder.add_u32(NETFS_SESSION_REQUEST);
+		frame.builder.add_u32(command);
+		frame.builder.add_u64(tag);
+		frame.builder.add_u64(payload.get_buffer().size());
+		frame.builder.add_buffer(payload.get_buffer());
+		frame.writer.start(frame.builder.get_buffer());
+
+		pending[tag] = std::move(result);
+	}
+
+	void modify_looper(Looper &looper)
+	{
+		uint32_t mask = write_queue.empty() ? EVENT_IN : (EVENT_IN | EVENT_OUT);
+		looper.modify_handler(mask, *this);
+	}
+
+	void complete_request(std::vector<uint8_t> payload)
+	{
+		auto itr = pending.find(reply_tag);
+		if (itr == std::end(pending))
+		{
+			LOGE("Got NetFS reply for unknown tag %llu.\n", static_cast<unsigned long long>(reply_tag));
+			return;
+		}
+
+		if (reply_error == NETFS_ERROR_OK)
+			itr->second.set_value(std::move(payload));
+		else
+			itr->second.set_exception(std::make_exception_ptr(std::runtime_error("NetFS request failed")));
+		pending.erase(itr);
+	}
+
+	bool handle(Looper &looper, EventFlags flags) override
+	{
+		if (flags & EVENT_OUT)
+		{
+			if (!write_queue.empty())
+			{
+				auto ret = write_queue.front().writer.process(*socket);
+				if (write_queue.front().writer.complete())
+					write_queue.pop();
+				else if (ret < 0 && ret != Socket::ErrorWouldBlock)
+					return false;
+			}
+
+			modify_looper(looper);
+		}
+
+		if (flags & EVENT_IN)
+		{
+			auto ret = command_reader.process(*socket);
+			if (command_reader.complete())
+			{
+				if (state == ReadHeader)
+				{
+					if (reply_builder.read_u32() != NETFS_SESSION_REPLY)
+						return false;
+
+					reply_error = reply_builder.read_u32();
+					reply_tag = reply_builder.read_u64();
+					uint64_t size = reply_builder.read_u64();
+
+					if (size)
+					{
+						reply_builder.begin(size);
+						command_reader.start(reply_builder.get_buffer());
+						state = ReadPayload;
+						return true;
+					}
+
+					complete_request({});
+				}
+				else
+					complete_request(reply_builder.consume_buffer());
+
+				reply_builder.begin(NetFSSessionHeaderSize);
+				command_reader.start(reply_builder.get_buffer());
+				state = ReadHeader;
+				return true;
+			}
+
+			return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+		}
+
+		return !(flags & (EVENT_HANGUP | EVENT_ERROR));
+	}
+
+	enum State
+	{
+		ReadHeader,
+		ReadPayload
+	};
+
+	NetworkFilesystem &fs;
+	State state = ReadHeader;
+	SocketReader command_reader;
+	ReplyBuilder reply_builder;
+	uint32_t reply_error = 0;
+	uint64_t reply_tag = 0;
+
+	struct Frame
+	{
+		SocketWriter writer;
+		ReplyBuilder builder;
+	};
+	std::queue<Frame> write_queue;
+	std::unordered_map<uint64_t, std::promise<std::vector<uint8_t>>> pending;
+};
+
+NetworkFilesystem::NetworkFilesystem(const std::string &cache_directory, uint16_t port_)
+	: use_compression(false), port(port_),
+	  range_reads(0), wire_bytes(0), data_bytes(0), cache_hits(0)
+{
+	if (!cache_directory.empty())
+		cache.reset(new OSFilesystem(cache_directory));
+	looper_thread = std::thread(&NetworkFilesystem::looper_entry, this);
+}
+
+void NetworkFilesystem::set_compression(bool enable)
+{
+	use_compression = enable;
+}
+
+NetworkFilesystem::TransferStats NetworkFilesystem::get_transfer_stats() const
+{
+	TransferStats stats = {};
+	stats.range_reads = range_reads.load(std::memory_order_relaxed);
+	stats.wire_bytes = wire_bytes.load(std::memory_order_relaxed);
+	stats.data_bytes = data_bytes.load(std::memory_order_relaxed);
+	stats.cache_hits = cache_hits.load(std::memory_order_relaxed);
+	return stats;
+}
+
+std::future<std::vector<uint8_t>> NetworkFilesystem::submit_session_request(NetFSCommand command, ReplyBuilder payload)
+{
+	auto *result = new std::promise<std::vector<uint8_t>>;
+	auto *request = new ReplyBuilder(std::move(payload));
+	auto fut = result->get_future();
+
+	// Move capture would be nice ...
+	looper.run_in_looper([this, command, result, request]() {
+		if (!session)
+		{
+			auto socket = Socket::connect(HOST_IP, port);
+			if (socket)
+			{
+				session = new FSSession(*this, protocol, std::move(socket));
+				looper.register_handler(EVENT_OUT | EVENT_IN, std::unique_ptr<FSSession>(session));
+			}
+		}
+
+		if (session)
+			session->push_request(++session_tag, command, *request, std::move(*result));
+		else
+			result->set_exception(std::make_exception_ptr(std::runtime_error("Failed to connect to server.")));
+
+		delete result;
+		delete request;
+	});
+
+	return fut;
+}
+
+bool NetworkFilesystem::read_range(const std::string &path, uint64_t offset, size_t range, void *data)
+{
+	ReplyBuilder request;
+	request.add_u64(offset);
+	request.add_u64(range);
+	request.add_u32(use_compression ? NETFS_COMPRESSION_LZ4 : NETFS_COMPRESSION_NONE);
+	request.add_data(path.data(), path.size());
+
+	auto fut = submit_session_request(NETFS_READ_FILE_RANGE, std::move(request));
+
+	try
+	{
+		ReplyBuilder reply;
+		reply.get_buffer() = fut.get();
+
+		auto compression = reply.read_u32();
+		if (reply.read_u64() != range)
+		{
+			LOGE("Short read for %s.\n", path.c_str());
+			return false;
+		}
+
+		size_t payload_size = reply.get_remaining();
+		auto *payload = reply.read_data(payload_size);
+
+		range_reads.fetch_add(1, std::memory_order_relaxed);
+		wire_bytes.fetch_add(payload_size, std::memory_order_relaxed);
+		data_bytes.fetch_add(range, std::memory_order_relaxed);
+
+		switch (compression)
+		{
+		case NETFS_COMPRESSION_NONE:
+			if (payload_size != range)
+				return false;
+			if (range)
+				memcpy(data, payload, range);
+			return true;
+
+		case NETFS_COMPRESSION_LZ4:
+			return Util::lz4_decompress(data, range, payload, payload_size);
+
+		default:
+			return false;
+		}
+	}
+	catch (...)
+	{
+		LOGE("Failed to read %s.\n", path.c_str());
+		return false;
+	}
+}
+
+bool NetworkFilesystem::session_stat(const std::string &path, FileStat &s)
+{
+	ReplyBuilder request;
+	request.add_data(path.data(), path.size());
+	auto fut = submit_session_request(NETFS_STAT, std::move(request));
+
+	try
+	{
+		ReplyBuilder reply;
+		reply.get_buffer() = fut.get();
+		return parse_stat_reply(reply, s);
+	}
+	catch (...)
+	{
+		return false;
+	}
+}
+
+bool NetworkFilesystem::write_file(const std::string &path, const void *data, size_t size)
+{
+	auto socket = Socket::connect(HOST_IP, port);
+	if (!socket)
+		return false;
+
+	auto *handler = new FSWriteCommand(path, data, size, std::move(socket));
+	auto reply = handler->result.get_future();
+	looper.run_in_looper([handler, this]() {
+		looper.register_handler(EVENT_OUT | EVENT_IN, std::unique_ptr<FSWriteCommand>(handler));
+	});
+
+	try
+	{
+		return reply.get() == NETFS_ERROR_OK;
+	}
+	catch (...)
+	{
+		return false;
+	}
+}
+
+std::string NetworkFilesystem::get_cache_path(const std::string &path)
+{
+	Util::Hasher h;
+	h.string(path);
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(h.get()));
+	return name;
+}
+
+FileHandle NetworkFilesystem::open_cached(const std::string &path, const FileStat &s)
+{
+	if (!cache)
+		return {};
+
+	auto cache_path = get_cache_path(path);
+	std::lock_guard<std::mutex> holder{cache_lock};
+
+	auto meta = cache->open(cache_path + ".meta", FileMode::ReadOnly);
+	if (!meta)
+		return {};
+
+	auto mapping = meta->map();
+	if (!mapping)
+		return {};
+
+	ReplyBuilder reader;
+	reader.add_data(mapping->data(), mapping->get_size());
+	if (reader.read_u64() != s.size ||
+	    reader.read_u64() != s.last_modified ||
+	    reader.read_string_implicit_count() != path)
+	{
+		return {};
+	}
+
+	auto data = cache->open(cache_path + ".data", FileMode::ReadOnly);
+	if (!data || data->get_size() != s.size)
+		return {};
+
+	return data;
+}
+
+void NetworkFilesystem::write_cached(const std::string &path, const FileStat &s, const void *data, size_t size)
+{
+	// Empty files are not worth caching, and cannot be mapped for writing.
+	if (!cache || !size)
+		return;
+
+	auto cache_path = get_cache_path(path);
+	std::lock_guard<std::mutex> holder{cache_lock};
+
+	// Data is committed before the metadata which validates it.
+	{
+		auto file = cache->open(cache_path + ".data", FileMode::WriteOnlyTransactional);
+		auto mapping = file ? file->map_write(size) : FileMappingHandle{};
+		if (!mapping)
+			return;
+		memcpy(mapping->mutable_data(), data, size);
+	}
+
+	ReplyBuilder meta;
+	meta.add_u64(s.size);
+	meta.add_u64(s.last_modified);
+	meta.add_data(path.data(), path.size());
+
+	auto file = cache->open(cache_path + ".meta", FileMode::WriteOnlyTransactional);
+	auto mapping = file ? file->map_write(meta.get_buffer().size()) : FileMappingHandle{};
+	if (mapping)
+		memcpy(mapping->mutable_data(), meta.get_buffer().data(), meta.get_buffer().size());
 }
 
 void NetworkFilesystem::looper_entry()
@@ -605,17 +909,17 @@ void NetworkFilesystem::looper_entry()
 
 void NetworkFilesystem::setup_notification()
 {
-	auto socket = Socket::connect(HOST_IP, 7070);
+	auto socket = Socket::connect(HOST_IP, port);
 	if (!socket)
 		return;
-	notify = new FSNotifyCommand(protocol, move(socket));
+	notify = new FSNotifyCommand(protocol, std::move(socket));
 	notify->set_notify_cb([this](const FileNotifyInfo &info) {
 		signal_notification(info);
 	});
 
 	// Move capture would be nice ...
 	looper.run_in_looper([this]() {
-		looper.register_handler(EVENT_OUT, unique_ptr<FSNotifyCommand>(notify));
+		looper.register_handler(EVENT_OUT, std::unique_ptr<FSNotifyCommand>(notify));
 	});
 }
 
@@ -627,14 +931,14 @@ void NetworkFilesystem::uninstall_notification(FileNotifyHandle handle)
 		return;
 
 	auto itr = handlers.find(handle);
-	if (itr == end(handlers))
+	if (itr == std::end(handlers))
 		return;
 	handlers.erase(itr);
 
-	auto *value = new promise<FileNotifyHandle>;
+	auto *value = new std::promise<FileNotifyHandle>;
 	auto result = value->get_future();
 	looper.run_in_looper([this, value, handle]() {
-		notify->push_unregister_notification(handle, move(*value));
+		notify->push_unregister_notification(handle, std::move(*value));
 		delete value;
 	});
 
@@ -649,16 +953,16 @@ void NetworkFilesystem::uninstall_notification(FileNotifyHandle handle)
 
 void NetworkFilesystem::signal_notification(const FileNotifyInfo &info)
 {
-	lock_guard<mutex> holder{lock};
+	std::lock_guard<std::mutex> holder{lock};
 	pending.push_back(info);
 }
 
 void NetworkFilesystem::poll_notifications()
 {
-	vector<FileNotifyInfo> tmp_pending;
+	std::vector<FileNotifyInfo> tmp_pending;
 	{
-		lock_guard<mutex> holder{lock};
-		swap(tmp_pending, pending);
+		std::lock_guard<std::mutex> holder{lock};
+		std::swap(tmp_pending, pending);
 	}
 
 	for (auto &notification : tmp_pending)
@@ -677,18 +981,18 @@ FileNotifyHandle NetworkFilesystem::install_notification(const std::string &path
 	if (!notify)
 		return -1;
 
-	auto *value = new promise<FileNotifyHandle>;
+	auto *value = new std::promise<FileNotifyHandle>;
 	auto result = value->get_future();
 
 	looper.run_in_looper([this, value, path]() {
-		notify->push_register_notification(path, move(*value));
+		notify->push_register_notification(path, std::move(*value));
 		delete value;
 	});
 
 	try
 	{
 		auto handle = result.get();
-		handlers[handle] = move(func);
+		handlers[handle] = std::move(func);
 		return handle;
 	}
 	catch (...)
@@ -697,18 +1001,18 @@ FileNotifyHandle NetworkFilesystem::install_notification(const std::string &path
 	}
 }
 
-vector<ListEntry> NetworkFilesystem::list(const std::string &path)
+std::vector<ListEntry> NetworkFilesystem::list(const std::string &path)
 {
 	auto joined = protocol + "://" + path;
-	auto socket = Socket::connect(HOST_IP, 7070);
+	auto socket = Socket::connect(HOST_IP, port);
 	if (!socket)
 		return {};
 
-	unique_ptr<FSList> handler(new FSList(joined, move(socket)));
+	std::unique_ptr<FSList> handler(new FSList(joined, std::move(socket)));
 	auto fut = handler->result.get_future();
 
 	looper.run_in_looper([&]() {
-		looper.register_handler(EVENT_OUT, move(handler));
+		looper.register_handler(EVENT_OUT, std::move(handler));
 	});
 
 	try
@@ -723,26 +1027,21 @@ vector<ListEntry> NetworkFilesystem::list(const std::string &path)
 
 NetworkFile::~NetworkFile()
 {
-	unmap();
 }
 
-NetworkFile *NetworkFile::open(Granite::Looper &looper, const std::string &path, Granite::FileMode mode)
+FileHandle NetworkFile::open(NetworkFilesystem &fs, const std::string &path, FileMode mode)
 {
-	auto *file = new NetworkFile;
-	if (!file->init(looper, path, mode))
-	{
-		delete file;
-		return nullptr;
-	}
-	else
-		return file;
+	auto file = Util::make_handle<NetworkFile>();
+	if (!file->init(fs, path, mode))
+		file.reset();
+	return file;
 }
 
-bool NetworkFile::init(Looper &looper_, const std::string &path_, FileMode mode_)
+bool NetworkFile::init(NetworkFilesystem &fs_, const std::string &path_, FileMode mode_)
 {
+	fs = &fs_;
 	path = path_;
 	mode = mode_;
-	looper = &looper_;
 
 	if (mode == FileMode::ReadWrite)
 	{
@@ -752,135 +1051,86 @@ bool NetworkFile::init(Looper &looper_, const std::string &path_, FileMode mode_
 
 	if (mode == FileMode::ReadOnly)
 	{
-		if (!reopen())
+		if (!fs->session_stat(path, file_stat) || file_stat.type != PathType::File)
 		{
-			LOGE("Failed to connect to server.\n");
+			LOGE("Failed to stat %s.\n", path.c_str());
 			return false;
 		}
+
+		cached = fs->open_cached(path, file_stat);
+		if (cached)
+			fs->cache_hits.fetch_add(1, std::memory_order_relaxed);
 	}
 
 	return true;
 }
 
-void NetworkFile::unmap()
+FileMappingHandle NetworkFile::map_subset(uint64_t offset, size_t range)
 {
-	if (mode == FileMode::WriteOnly && has_buffer && need_flush)
-	{
-		need_flush = false;
-		auto socket = Socket::connect(HOST_IP, 7070);
-		if (!socket)
-			throw runtime_error("Failed to connect to server.");
+	if (mode != FileMode::ReadOnly || offset + range > file_stat.size)
+		return {};
 
-		auto handler = unique_ptr<FSWriteCommand>(new FSWriteCommand(path, buffer, move(socket)));
-		auto reply = handler->result.get_future();
-		looper->run_in_looper([&handler, this]() {
-			looper->register_handler(EVENT_OUT | EVENT_IN, move(handler));
-		});
+	if (cached)
+		return cached->map_subset(offset, range);
 
-		try
-		{
-			NetFSError error = reply.get();
-			if (error != NETFS_ERROR_OK)
-				LOGE("Failed to write file: %s\n", path.c_str());
-		}
-		catch (...)
-		{
-			LOGE("Failed to write file: %s\n", path.c_str());
-		}
-	}
-}
+	auto *data = static_cast<uint8_t *>(malloc(range ? range : 1));
+	if (!data)
+		return {};
 
-bool NetworkFile::reopen()
-{
-	if (mode == FileMode::ReadOnly)
+	if (!fs->read_range(path, offset, range, data))
 	{
-		has_buffer = false;
-		auto socket = Socket::connect(HOST_IP, 7070);
-		if (!socket)
-			return false;
+		free(data);
+		return {};
+	}
 
-		auto *handler = new FSReader(path, move(socket));
-		future = handler->result.get_future();
+	// Only whole-file reads populate the content cache, so entries are always complete.
+	if (offset == 0 && range == file_stat.size)
+		fs->write_cached(path, file_stat, data, range);
 
-		// Capture-by-move would be nice here.
-		looper->run_in_looper([handler, this]() {
-			looper->register_handler(EVENT_OUT, unique_ptr<FSReader>(handler));
-		});
-	}
-	return true;
+	return Util::make_handle<FileMapping>(
+		reference_from_this(), offset,
+		data, range,
+		0, range);
 }
 
-void *NetworkFile::map_write(size_t size)
+FileMappingHandle NetworkFile::map_write(size_t size)
 {
-	has_buffer = true;
-	need_flush = true;
-	buffer.resize(size);
-	return buffer.empty() ? nullptr : buffer.data();
+	if (mode == FileMode::ReadOnly)
+		return {};
+
+	auto *data = static_cast<uint8_t *>(malloc(size ? size : 1));
+	if (!data)
+		return {};
+
+	file_stat.size = size;
+	return Util::make_handle<FileMapping>(
+		reference_from_this(), 0,
+		data, size,
+		0, size);
 }
 
-void *NetworkFile::map()
+void NetworkFile::unmap(void *mapped, size_t range)
 {
-	try
-	{
-		if (!has_buffer)
-		{
-			buffer = future.get();
-			has_buffer = true;
-		}
-		return buffer.empty() ? nullptr : buffer.data();
-	}
-	catch (...)
-	{
-		return nullptr;
-	}
+	if (mode != FileMode::ReadOnly && !fs->write_file(path, mapped, range))
+		LOGE("Failed to write file: %s\n", path.c_str());
+	free(mapped);
 }
 
-size_t NetworkFile::get_size()
+uint64_t NetworkFile::get_size()
 {
-	try
-	{
-		if (!has_buffer)
-		{
-			buffer = future.get();
-			has_buffer = true;
-		}
-		return buffer.size();
-	}
-	catch (...)
-	{
-		return 0;
-	}
+	return file_stat.size;
 }
 
-unique_ptr<File> NetworkFilesystem::open(const std::string &path, FileMode mode)
+FileHandle NetworkFilesystem::open(const std::string &path, FileMode mode)
 {
 	auto joined = protocol + "://" + path;
-	return unique_ptr<File>(NetworkFile::open(looper, move(joined), mode));
+	return NetworkFile::open(*this, joined, mode);
 }
 
 bool NetworkFilesystem::stat(const std::string &path, FileStat &stat)
 {
 	auto joined = protocol + "://" + path;
-	auto socket = Socket::connect(HOST_IP, 7070);
-	if (!socket)
-		return false;
-
-	unique_ptr<FSStat> handler(new FSStat(joined, move(socket)));
-	auto fut = handler->result.get_future();
-
-	looper.run_in_looper([&]() {
-		looper.register_handler(EVENT_OUT, move(handler));
-	});
-
-	try
-	{
-		stat = fut.get();
-		return true;
-	}
-	catch (...)
-	{
-		return false;
-	}
+	return session_stat(joined, stat);
 }
 
 NetworkFilesystem::~NetworkFilesystem()
@@ -21,48 +21,50 @@
  */
 
 #pragma once
-#include "fs-netfs.hpp"
 #include "network.hpp"
 #include "../filesystem.hpp"
 #include "netfs.hpp"
 #include <unordered_map>
 #include <future>
 #include <thread>
+#include <atomic>
 
 namespace Granite
 {
-struct FSReader;
-class NetworkFile : public File
+class NetworkFilesystem;
+struct FSSession;
+
+class NetworkFile final : public File
 {
 public:
-	static NetworkFile *open(Looper &looper, const std::string &path, FileMode mode);
-	~NetworkFile();
-	void *map() override;
-	void *map_write(size_t size) override;
-	void unmap() override;
-	size_t get_size() override;
-	bool reopen() override;
+	static FileHandle open(NetworkFilesystem &fs, const std::string &path, FileMode mode);
+	~NetworkFile() override;
+	FileMappingHandle map_subset(uint64_t offset, size_t range) override;
+	FileMappingHandle map_write(size_t size) override;
+	void unmap(void *mapped, size_t range) override;
+	uint64_t get_size() override;
 
 private:
-	NetworkFile() = default;
-	bool init(Looper &looper, const std::string &path, FileMode mode);
+	bool init(NetworkFilesystem &fs, const std::string &path, FileMode mode);
+	NetworkFilesystem *fs = nullptr;
 	std::string path;
-	FileMode mode;
-	Looper *looper = nullptr;
-	std::future<std::vector<uint8_t>> future;
-	std::vector<uint8_t> buffer;
-	bool has_buffer = false;
-	bool need_flush = false;
+	FileMode mode = FileMode::ReadOnly;
+	FileStat file_stat = {};
+
+	// If the content cache has an up-to-date copy, all reads are served from it.
+	FileHandle cached;
 };
 
 struct FSNotifyCommand;
 class NetworkFilesystem : public FilesystemBackend
 {
 public:
-	NetworkFilesystem();
+	// If cache_directory is non-empty, whole-file reads are persisted there
+	// and reused as long as the remote size and modification time match.
+	explicit NetworkFilesystem(const std::string &cache_directory = "", uint16_t port = NetFSDefaultPort);
 	~NetworkFilesystem();
 	std::vector<ListEntry> list(const std::string &path) override;
-	std::unique_ptr<File> open(const std::string &path, FileMode mode) override;
+	FileHandle open(const std::string &path, FileMode mode) override;
 	bool stat(const std::string &path, FileStat &stat) override;
 
 	FileNotifyHandle install_notification(const std::string &path, std::function<void (const FileNotifyInfo &)> func) override;
@@ -76,7 +78,31 @@ public:
 		return -1;
 	}
 
+	// Requests LZ4 compressed payloads for ranged reads.
+	// The server falls back to plain data for incompressible ranges.
+	void set_compression(bool enable);
+
+	struct TransferStats
+	{
+		// Ranged reads which went to the server.
+		uint64_t range_reads;
+		// Payload bytes received for ranged reads, after compression.
+		uint64_t wire_bytes;
+		// Bytes delivered by ranged reads, after decompression.
+		uint64_t data_bytes;
+		// Files which were opened from the content cache.
+		uint64_t cache_hits;
+	};
+	TransferStats get_transfer_stats() const;
+
 private:
+	friend class NetworkFile;
+	friend struct FSSession;
+
+	// Only accessed on the looper thread.
+	FSSession *session = nullptr;
+	uint64_t session_tag = 0;
+
 	std::thread looper_thread;
 	Looper looper;
 	void looper_entry();
@@ -88,5 +114,23 @@ private:
 
 	void setup_notification();
 	void signal_notification(const FileNotifyInfo &info);
+
+	std::future<std::vector<uint8_t>> submit_session_request(NetFSCommand command, ReplyBuilder payload);
+	bool read_range(const std::string &path, uint64_t offset, size_t range, void *data);
+	bool session_stat(const std::string &path, FileStat &stat);
+	bool write_file(const std::string &path, const void *data, size_t size);
+	std::atomic_bool use_compression;
+	uint16_t port;
+
+	std::atomic<uint64_t> range_reads;
+	std::atomic<uint64_t> wire_bytes;
+	std::atomic<uint64_t> data_bytes;
+	std::atomic<uint64_t> cache_hits;
+
+	std::unique_ptr<FilesystemBackend> cache;
+	std::mutex cache_lock;
+	static std::string get_cache_path(const std::string &path);
+	FileHandle open_cached(const std::string &path, const FileStat &stat);
+	void write_cached(const std::string &path, const FileStat &stat, const void *data, size_t size);
 };
 }
@@ -28,6 +28,7 @@ namespace muglm
 {
 mat4 mat4_cast(const quat &q);
 mat3 mat3_cast(const quat &q);
+mat4 mat4_cast(const mat_affine &m);
 mat4 translate(const vec3 &v);
 mat4 scale(const vec3 &v);
 mat4 frustum(float left, float right, float bottom, float top, float near, float far);
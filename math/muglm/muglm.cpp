@@ -60,6 +60,15 @@ mat4 mat4_cast(const quat &q)
 	return mat4(mat3_cast(q));
 }
 
+mat4 mat4_cast(const mat_affine &m)
+{
+	return mat4(
+			vec4(m[0].x, m[1].x, m[2].x, 0.0f),
+			vec4(m[0].y, m[1].y, m[2].y, 0.0f),
+			vec4(m[0].z, m[1].z, m[2].z, 0.0f),
+			vec4(m[0].w, m[1].w, m[2].w, 1.0f));
+}
+
 mat4 translate(const vec3 &v)
 {
 	return mat4(
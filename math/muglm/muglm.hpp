@@ -893,6 +893,54 @@ using bvec2 = tvec2<bool>;
 using bvec3 = tvec3<bool>;
 using bvec4 = tvec4<bool>;
 
+// 3x4 affine transform stored as three rows. The implied fourth row is (0, 0, 0, 1).
+// Translation lives in the w component of each row.
+// Memory layout matches a GLSL mat3x4 which is applied as vec4(pos, 1.0) * M.
+struct mat_affine
+{
+	mat_affine() = default;
+	mat_affine(const mat_affine &) = default;
+	mat_affine &operator=(const mat_affine &) = default;
+
+	explicit inline mat_affine(float v) noexcept
+	{
+		rows[0] = vec4(v, 0.0f, 0.0f, 0.0f);
+		rows[1] = vec4(0.0f, v, 0.0f, 0.0f);
+		rows[2] = vec4(0.0f, 0.0f, v, 0.0f);
+	}
+
+	explicit inline mat_affine(const mat4 &m) noexcept
+	{
+		for (int i = 0; i < 3; i++)
+			rows[i] = vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	}
+
+	inline mat_affine(const vec4 &a, const vec4 &b, const vec4 &c) noexcept
+	{
+		rows[0] = a;
+		rows[1] = b;
+		rows[2] = c;
+	}
+
+	inline vec4 &operator[](size_t index)
+	{
+		return rows[index];
+	}
+
+	inline const vec4 &operator[](size_t index) const
+	{
+		return rows[index];
+	}
+
+	inline vec3 get_translation() const
+	{
+		return vec3(rows[0].w, rows[1].w, rows[2].w);
+	}
+
+private:
+	vec4 rows[3];
+};
+
 struct quat : private vec4
 {
 	quat() = default;
@@ -237,17 +237,12 @@ static inline void mul(mat4 &c, const mat4 &a, const mat4 &b)
 #endif
 }
 
-static inline void transform_aabb(AABB &output, const AABB &aabb, const mat4 &m)
-{
 #if defined(__SSE__)
+static inline void transform_aabb_columns(AABB &output, const AABB &aabb, __m128 m0, __m128 m1, __m128 m2, __m128 m3)
+{
 	__m128 lo = _mm_loadu_ps(aabb.get_minimum4().data);
 	__m128 hi = _mm_loadu_ps(aabb.get_maximum4().data);
 
-	__m128 m0 = _mm_loadu_ps(m[0].data);
-	__m128 m1 = _mm_loadu_ps(m[1].data);
-	__m128 m2 = _mm_loadu_ps(m[2].data);
-	__m128 m3 = _mm_loadu_ps(m[3].data);
-
 	__m128 m0_pos = _mm_cmpgt_ps(m0, _mm_setzero_ps());
 	__m128 m1_pos = _mm_cmpgt_ps(m1, _mm_setzero_ps());
 	__m128 m2_pos = _mm_cmpgt_ps(m2, _mm_setzero_ps());
@@ -271,15 +266,14 @@ static inline void transform_aabb(AABB &output, const AABB &aabb, const mat4 &m)
 
 	_mm_storeu_ps(output.get_minimum4().data, lo_result);
 	_mm_storeu_ps(output.get_maximum4().data, hi_result);
+}
 #elif defined(__ARM_NEON)
+static inline void transform_aabb_columns(AABB &output, const AABB &aabb,
+                                          float32x4_t m0, float32x4_t m1, float32x4_t m2, float32x4_t m3)
+{
 	float32x4_t lo = vld1q_f32(aabb.get_minimum4().data);
 	float32x4_t hi = vld1q_f32(aabb.get_maximum4().data);
 
-	float32x4_t m0 = vld1q_f32(m[0].data);
-	float32x4_t m1 = vld1q_f32(m[1].data);
-	float32x4_t m2 = vld1q_f32(m[2].data);
-	float32x4_t m3 = vld1q_f32(m[3].data);
-
 	uint32x4_t m0_pos = vcgtq_f32(m0, vdupq_n_f32(0.0f));
 	uint32x4_t m1_pos = vcgtq_f32(m1, vdupq_n_f32(0.0f));
 	uint32x4_t m2_pos = vcgtq_f32(m2, vdupq_n_f32(0.0f));
@@ -303,33 +297,145 @@ static inline void transform_aabb(AABB &output, const AABB &aabb, const mat4 &m)
 
 	vst1q_f32(output.get_minimum4().data, lo_result);
 	vst1q_f32(output.get_maximum4().data, hi_result);
+}
+
+static inline void transpose_affine(float32x4_t &c0, float32x4_t &c1, float32x4_t &c2, float32x4_t &c3,
+                                    float32x4_t r0, float32x4_t r1, float32x4_t r2, float32x4_t r3)
+{
+	float32x4x2_t t01 = vtrnq_f32(r0, r1);
+	float32x4x2_t t23 = vtrnq_f32(r2, r3);
+	c0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+	c1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+	c2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+	c3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+#endif
+
+static inline void transform_aabb(AABB &output, const AABB &aabb, const mat4 &m)
+{
+#if defined(__SSE__)
+	transform_aabb_columns(output, aabb,
+	                       _mm_loadu_ps(m[0].data), _mm_loadu_ps(m[1].data),
+	                       _mm_loadu_ps(m[2].data), _mm_loadu_ps(m[3].data));
+#elif defined(__ARM_NEON)
+	transform_aabb_columns(output, aabb,
+	                       vld1q_f32(m[0].data), vld1q_f32(m[1].data),
+	                       vld1q_f32(m[2].data), vld1q_f32(m[3].data));
 #else
 	output = aabb.transform(m);
 #endif
 }
 
-static inline void transform_and_expand_aabb(AABB &expandee, const AABB &aabb, const mat4 &m)
+static inline void transform_aabb(AABB &output, const AABB &aabb, const mat_affine &m)
+{
+#if defined(__SSE__)
+	__m128 m0 = _mm_loadu_ps(m[0].data);
+	__m128 m1 = _mm_loadu_ps(m[1].data);
+	__m128 m2 = _mm_loadu_ps(m[2].data);
+	__m128 m3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+	_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+	transform_aabb_columns(output, aabb, m0, m1, m2, m3);
+#elif defined(__ARM_NEON)
+	float32x4_t m0, m1, m2, m3;
+	transpose_affine(m0, m1, m2, m3,
+	                 vld1q_f32(m[0].data), vld1q_f32(m[1].data), vld1q_f32(m[2].data),
+	                 vsetq_lane_f32(1.0f, vdupq_n_f32(0.0f), 3));
+	transform_aabb_columns(output, aabb, m0, m1, m2, m3);
+#else
+	output = aabb.transform(mat4_cast(m));
+#endif
+}
+
+static inline void expand_aabb(AABB &expandee, const AABB &aabb)
 {
-	alignas(16) AABB tmp;
-	transform_aabb(tmp, aabb, m);
 #if defined(__SSE__)
-	__m128 lo = _mm_min_ps(_mm_load_ps(tmp.get_minimum4().data), _mm_loadu_ps(expandee.get_minimum4().data));
-	__m128 hi = _mm_max_ps(_mm_load_ps(tmp.get_maximum4().data), _mm_loadu_ps(expandee.get_maximum4().data));
+	__m128 lo = _mm_min_ps(_mm_loadu_ps(aabb.get_minimum4().data), _mm_loadu_ps(expandee.get_minimum4().data));
+	__m128 hi = _mm_max_ps(_mm_loadu_ps(aabb.get_maximum4().data), _mm_loadu_ps(expandee.get_maximum4().data));
 	_mm_storeu_ps(expandee.get_minimum4().data, lo);
 	_mm_storeu_ps(expandee.get_maximum4().data, hi);
 #elif defined(__ARM_NEON)
-	float32x4_t lo = vminq_f32(vld1q_f32(tmp.get_minimum4().data), vld1q_f32(expandee.get_minimum4().data));
-	float32x4_t hi = vmaxq_f32(vld1q_f32(tmp.get_maximum4().data), vld1q_f32(expandee.get_maximum4().data));
+	float32x4_t lo = vminq_f32(vld1q_f32(aabb.get_minimum4().data), vld1q_f32(expandee.get_minimum4().data));
+	float32x4_t hi = vmaxq_f32(vld1q_f32(aabb.get_maximum4().data), vld1q_f32(expandee.get_maximum4().data));
 	vst1q_f32(expandee.get_minimum4().data, lo);
 	vst1q_f32(expandee.get_maximum4().data, hi);
 #else
 	auto &output_min = expandee.get_minimum4();
 	auto &output_max = expandee.get_maximum4();
-	output_min = min<vec4>(output_min, tmp.get_minimum4());
-	output_max = max<vec4>(output_max, tmp.get_maximum4());
+	output_min = min<vec4>(output_min, aabb.get_minimum4());
+	output_max = max<vec4>(output_max, aabb.get_maximum4());
 #endif
 }
 
+static inline void transform_and_expand_aabb(AABB &expandee, const AABB &aabb, const mat4 &m)
+{
+	alignas(16) AABB tmp;
+	transform_aabb(tmp, aabb, m);
+	expand_aabb(expandee, tmp);
+}
+
+// Expands by the AABB transformed with every matrix in the array, e.g. all bones of a skin.
+static inline void transform_and_expand_aabb(AABB &expandee, const AABB &aabb, const mat_affine *m, size_t count)
+{
+	alignas(16) AABB tmp;
+	for (size_t i = 0; i < count; i++)
+	{
+		transform_aabb(tmp, aabb, m[i]);
+		expand_aabb(expandee, tmp);
+	}
+}
+
+static inline void mul(mat_affine &c, const mat_affine &a, const mat_affine &b)
+{
+#if defined(__SSE__)
+	__m128 b0 = _mm_loadu_ps(b[0].data);
+	__m128 b1 = _mm_loadu_ps(b[1].data);
+	__m128 b2 = _mm_loadu_ps(b[2].data);
+	__m128 w_select = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+
+#define COMPUTE_ROW(i) \
+	__m128 a##i = _mm_loadu_ps(a[i].data); \
+	__m128 row##i = _mm_mul_ps(a##i, w_select); \
+	row##i = _mm_add_ps(row##i, _mm_mul_ps(b0, _mm_shuffle_ps(a##i, a##i, _MM_SHUFFLE(0, 0, 0, 0)))); \
+	row##i = _mm_add_ps(row##i, _mm_mul_ps(b1, _mm_shuffle_ps(a##i, a##i, _MM_SHUFFLE(1, 1, 1, 1)))); \
+	row##i = _mm_add_ps(row##i, _mm_mul_ps(b2, _mm_shuffle_ps(a##i, a##i, _MM_SHUFFLE(2, 2, 2, 2)))); \
+	_mm_storeu_ps(c[i].data, row##i)
+	COMPUTE_ROW(0);
+	COMPUTE_ROW(1);
+	COMPUTE_ROW(2);
+#undef COMPUTE_ROW
+#elif defined(__ARM_NEON)
+	float32x4_t b0 = vld1q_f32(b[0].data);
+	float32x4_t b1 = vld1q_f32(b[1].data);
+	float32x4_t b2 = vld1q_f32(b[2].data);
+	float32x4_t w_select = vsetq_lane_f32(1.0f, vdupq_n_f32(0.0f), 3);
+
+#define COMPUTE_ROW(i) \
+	float32x4_t a##i = vld1q_f32(a[i].data); \
+	float32x4_t row##i = vmulq_f32(a##i, w_select); \
+	row##i = vmlaq_n_f32(row##i, b0, vgetq_lane_f32(a##i, 0)); \
+	row##i = vmlaq_n_f32(row##i, b1, vgetq_lane_f32(a##i, 1)); \
+	row##i = vmlaq_n_f32(row##i, b2, vgetq_lane_f32(a##i, 2)); \
+	vst1q_f32(c[i].data, row##i)
+	COMPUTE_ROW(0);
+	COMPUTE_ROW(1);
+	COMPUTE_ROW(2);
+#undef COMPUTE_ROW
+#else
+	mat_affine tmp;
+	for (int i = 0; i < 3; i++)
+		tmp[i] = vec4(0.0f, 0.0f, 0.0f, a[i].w) + a[i].x * b[0] + a[i].y * b[1] + a[i].z * b[2];
+	c = tmp;
+#endif
+}
+
+// Composes c[i] = a[i] * b[i]. Outputs and parents are typically scattered through the transform arrays,
+// while the right-hand side is a packed array of freshly computed local transforms.
+static inline void mul_batch(mat_affine * const *c, const mat_affine * const *a, const mat_affine *b, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		mul(*c[i], *a[i], b[i]);
+}
+
 static inline void convert_quaternion_with_scale(vec4 *cols, const quat &q, const vec3 &scale)
 {
 #if defined(__SSE3__)
@@ -367,5 +473,32 @@ static inline void convert_quaternion_with_scale(vec4 *cols, const quat &q, cons
 	cols[2] = vec4(m[2] * scale.z, 0.0f);
 #endif
 }
+
+static inline void convert_transform(mat_affine &m, const quat &q, const vec3 &scale, const vec3 &translation)
+{
+	vec4 cols[3];
+	convert_quaternion_with_scale(cols, q, scale);
+#if defined(__SSE__)
+	__m128 c0 = _mm_loadu_ps(cols[0].data);
+	__m128 c1 = _mm_loadu_ps(cols[1].data);
+	__m128 c2 = _mm_loadu_ps(cols[2].data);
+	__m128 c3 = _mm_set_ps(1.0f, translation.z, translation.y, translation.x);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	_mm_storeu_ps(m[0].data, c0);
+	_mm_storeu_ps(m[1].data, c1);
+	_mm_storeu_ps(m[2].data, c2);
+#elif defined(__ARM_NEON)
+	float32x4_t r0, r1, r2, r3;
+	transpose_affine(r0, r1, r2, r3,
+	                 vld1q_f32(cols[0].data), vld1q_f32(cols[1].data), vld1q_f32(cols[2].data),
+	                 vld1q_f32(vec4(translation, 1.0f).data));
+	vst1q_f32(m[0].data, r0);
+	vst1q_f32(m[1].data, r1);
+	vst1q_f32(m[2].data, r2);
+#else
+	for (int i = 0; i < 3; i++)
+		m[i] = vec4(cols[0][i], cols[1][i], cols[2][i], translation[i]);
+#endif
+}
 }
 }
@@ -0,0 +1,599 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "simd_dispatch.hpp"
+#include "simd_headers.hpp"
+#include "logging.hpp"
+#include "environment.hpp"
+#include <string.h>
+#include <string>
+
+#if defined(GRANITE_SIMD_DISPATCH_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(GRANITE_SIMD_DISPATCH_X86)
+#include <cpuid.h>
+#endif
+
+namespace Granite
+{
+namespace SIMD
+{
+#ifdef GRANITE_SIMD_DISPATCH_X86
+// Implemented in translation units which are built with the corresponding instruction set enabled.
+void fill_dispatch_avx2(DispatchKernels &kernels);
+void fill_dispatch_avx512(DispatchKernels &kernels);
+#endif
+
+static void frustum_cull_scalar(uint8_t *visible, const float * const *aabbs, size_t count, const float *planes)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const float *lo = aabbs[i];
+		const float *hi = aabbs[i] + 4;
+		bool inside = true;
+
+		for (unsigned p = 0; p < 6 && inside; p++)
+		{
+			const float *plane = planes + 4 * p;
+			float major[4];
+			for (unsigned c = 0; c < 4; c++)
+				major[c] = plane[c] > 0.0f ? hi[c] : lo[c];
+			float d = (plane[0] * major[0] + plane[1] * major[1]) + (plane[2] * major[2] + plane[3] * major[3]);
+			inside = d >= 0.0f;
+		}
+
+		visible[i] = inside ? 1 : 0;
+	}
+}
+
+static void mul_affine_scalar(float * const *c, const float * const *a, const float *b, size_t count)
+{
+	for (size_t i = 0; i < count; i++, b += 12)
+	{
+		const float *m = a[i];
+		float tmp[12];
+		for (unsigned row = 0; row < 3; row++)
+		{
+			const float *r = m + 4 * row;
+			for (unsigned col = 0; col < 4; col++)
+				tmp[4 * row + col] = r[0] * b[col] + r[1] * b[4 + col] + r[2] * b[8 + col];
+			tmp[4 * row + 3] += r[3];
+		}
+		memcpy(c[i], tmp, sizeof(tmp));
+	}
+}
+
+static void transform_expand_aabb_scalar(float *expandee, const float *aabb, const float *affine, size_t count)
+{
+	const float *lo = aabb;
+	const float *hi = aabb + 4;
+
+	for (size_t i = 0; i < count; i++, affine += 12)
+	{
+		for (unsigned row = 0; row < 3; row++)
+		{
+			const float *r = affine + 4 * row;
+			float lo_result = r[3];
+			float hi_result = r[3];
+			for (unsigned k = 0; k < 3; k++)
+			{
+				bool pos = r[k] > 0.0f;
+				hi_result += r[k] * (pos ? hi[k] : lo[k]);
+				lo_result += r[k] * (pos ? lo[k] : hi[k]);
+			}
+
+			if (lo_result < expandee[row])
+				expandee[row] = lo_result;
+			if (hi_result > expandee[4 + row])
+				expandee[4 + row] = hi_result;
+		}
+
+		// Affine transforms keep w at 1.
+		if (1.0f < expandee[3])
+			expandee[3] = 1.0f;
+		if (1.0f > expandee[7])
+			expandee[7] = 1.0f;
+	}
+}
+
+static void accumulate_scalar(float *output, const float *input, float gain, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		output[i] += input[i] * gain;
+}
+
+static float sinc_dot_scalar(const float *buffer, const float *phases, const float *deltas, float delta, unsigned taps)
+{
+	float sum = 0.0f;
+	for (unsigned i = 0; i < taps; i++)
+		sum += buffer[i] * (phases[i] + deltas[i] * delta);
+	return sum;
+}
+
+static void downsample_rgba8_scalar(uint8_t *dst, const uint8_t *row0, const uint8_t *row1, size_t dst_width)
+{
+	for (size_t i = 0; i < 4 * dst_width; i++)
+	{
+		size_t src = 8 * (i >> 2) + (i & 3);
+		dst[i] = uint8_t((row0[src] + row0[src + 4] + row1[src] + row1[src + 4] + 2) >> 2);
+	}
+}
+
+#if defined(__SSE3__)
+static void frustum_cull_sse3(uint8_t *visible, const float * const *aabbs, size_t count, const float *planes)
+{
+	__m128 p0 = _mm_loadu_ps(planes + 0);
+	__m128 p1 = _mm_loadu_ps(planes + 4);
+	__m128 p2 = _mm_loadu_ps(planes + 8);
+	__m128 p3 = _mm_loadu_ps(planes + 12);
+	__m128 p4 = _mm_loadu_ps(planes + 16);
+	__m128 p5 = _mm_loadu_ps(planes + 20);
+	__m128 mask0 = _mm_cmpgt_ps(p0, _mm_setzero_ps());
+	__m128 mask1 = _mm_cmpgt_ps(p1, _mm_setzero_ps());
+	__m128 mask2 = _mm_cmpgt_ps(p2, _mm_setzero_ps());
+	__m128 mask3 = _mm_cmpgt_ps(p3, _mm_setzero_ps());
+	__m128 mask4 = _mm_cmpgt_ps(p4, _mm_setzero_ps());
+	__m128 mask5 = _mm_cmpgt_ps(p5, _mm_setzero_ps());
+
+	for (size_t i = 0; i < count; i++)
+	{
+		__m128 lo = _mm_loadu_ps(aabbs[i]);
+		__m128 hi = _mm_loadu_ps(aabbs[i] + 4);
+
+#define COMPUTE_PLANE(i) \
+	__m128 major_axis##i = _mm_or_ps(_mm_and_ps(mask##i, hi), _mm_andnot_ps(mask##i, lo)); \
+	__m128 dotted##i = _mm_mul_ps(p##i, major_axis##i)
+		COMPUTE_PLANE(0);
+		COMPUTE_PLANE(1);
+		COMPUTE_PLANE(2);
+		COMPUTE_PLANE(3);
+		COMPUTE_PLANE(4);
+		COMPUTE_PLANE(5);
+#undef COMPUTE_PLANE
+
+		__m128 merged01 = _mm_hadd_ps(dotted0, dotted1);
+		__m128 merged23 = _mm_hadd_ps(dotted2, dotted3);
+		__m128 merged45 = _mm_hadd_ps(dotted4, dotted5);
+		__m128 merged0123 = _mm_hadd_ps(merged01, merged23);
+		merged45 = _mm_hadd_ps(merged45, merged45);
+		__m128 merged = _mm_or_ps(merged0123, merged45);
+		visible[i] = _mm_movemask_ps(merged) == 0 ? 1 : 0;
+	}
+}
+
+static void mul_affine_sse3(float * const *c, const float * const *a, const float *b, size_t count)
+{
+	__m128 w_select = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+	for (size_t i = 0; i < count; i++, b += 12)
+	{
+		__m128 b0 = _mm_loadu_ps(b + 0);
+		__m128 b1 = _mm_loadu_ps(b + 4);
+		__m128 b2 = _mm_loadu_ps(b + 8);
+		const float *m = a[i];
+
+#define COMPUTE_ROW(r) \
+	__m128 a##r = _mm_loadu_ps(m + 4 * r); \
+	__m128 row##r = _mm_mul_ps(a##r, w_select); \
+	row##r = _mm_add_ps(row##r, _mm_mul_ps(b0, _mm_shuffle_ps(a##r, a##r, _MM_SHUFFLE(0, 0, 0, 0)))); \
+	row##r = _mm_add_ps(row##r, _mm_mul_ps(b1, _mm_shuffle_ps(a##r, a##r, _MM_SHUFFLE(1, 1, 1, 1)))); \
+	row##r = _mm_add_ps(row##r, _mm_mul_ps(b2, _mm_shuffle_ps(a##r, a##r, _MM_SHUFFLE(2, 2, 2, 2))))
+		COMPUTE_ROW(0);
+		COMPUTE_ROW(1);
+		COMPUTE_ROW(2);
+#undef COMPUTE_ROW
+
+		_mm_storeu_ps(c[i] + 0, row0);
+		_mm_storeu_ps(c[i] + 4, row1);
+		_mm_storeu_ps(c[i] + 8, row2);
+	}
+}
+
+static void transform_expand_aabb_sse3(float *expandee, const float *aabb, const float *affine, size_t count)
+{
+	__m128 lo = _mm_loadu_ps(aabb);
+	__m128 hi = _mm_loadu_ps(aabb + 4);
+	__m128 hi0 = _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 hi1 = _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 hi2 = _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 lo0 = _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 lo1 = _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 lo2 = _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 2, 2, 2));
+
+	__m128 lo_expand = _mm_loadu_ps(expandee);
+	__m128 hi_expand = _mm_loadu_ps(expandee + 4);
+
+	for (size_t i = 0; i < count; i++, affine += 12)
+	{
+		__m128 m0 = _mm_loadu_ps(affine + 0);
+		__m128 m1 = _mm_loadu_ps(affine + 4);
+		__m128 m2 = _mm_loadu_ps(affine + 8);
+		__m128 m3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+		_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+
+		__m128 m0_pos = _mm_cmpgt_ps(m0, _mm_setzero_ps());
+		__m128 m1_pos = _mm_cmpgt_ps(m1, _mm_setzero_ps());
+		__m128 m2_pos = _mm_cmpgt_ps(m2, _mm_setzero_ps());
+
+		__m128 hi_result = m3;
+		hi_result = _mm_add_ps(hi_result, _mm_mul_ps(m0, _mm_or_ps(_mm_and_ps(m0_pos, hi0), _mm_andnot_ps(m0_pos, lo0))));
+		hi_result = _mm_add_ps(hi_result, _mm_mul_ps(m1, _mm_or_ps(_mm_and_ps(m1_pos, hi1), _mm_andnot_ps(m1_pos, lo1))));
+		hi_result = _mm_add_ps(hi_result, _mm_mul_ps(m2, _mm_or_ps(_mm_and_ps(m2_pos, hi2), _mm_andnot_ps(m2_pos, lo2))));
+
+		__m128 lo_result = m3;
+		lo_result = _mm_add_ps(lo_result, _mm_mul_ps(m0, _mm_or_ps(_mm_andnot_ps(m0_pos, hi0), _mm_and_ps(m0_pos, lo0))));
+		lo_result = _mm_add_ps(lo_result, _mm_mul_ps(m1, _mm_or_ps(_mm_andnot_ps(m1_pos, hi1), _mm_and_ps(m1_pos, lo1))));
+		lo_result = _mm_add_ps(lo_result, _mm_mul_ps(m2, _mm_or_ps(_mm_andnot_ps(m2_pos, hi2), _mm_and_ps(m2_pos, lo2))));
+
+		lo_expand = _mm_min_ps(lo_expand, lo_result);
+		hi_expand = _mm_max_ps(hi_expand, hi_result);
+	}
+
+	_mm_storeu_ps(expandee, lo_expand);
+	_mm_storeu_ps(expandee + 4, hi_expand);
+}
+
+static void accumulate_sse3(float *output, const float *input, float gain, size_t count)
+{
+	size_t rounded_count = count & ~size_t(3);
+	__m128 gain_splat = _mm_set1_ps(gain);
+	for (size_t i = 0; i < rounded_count; i += 4)
+	{
+		__m128 acc = _mm_loadu_ps(output + i);
+		__m128 in = _mm_loadu_ps(input + i);
+		acc = _mm_add_ps(acc, _mm_mul_ps(in, gain_splat));
+		_mm_storeu_ps(output + i, acc);
+	}
+
+	for (size_t i = rounded_count; i < count; i++)
+		output[i] += input[i] * gain;
+}
+
+static float sinc_dot_sse3(const float *buffer, const float *phases, const float *deltas, float delta, unsigned taps)
+{
+	__m128 sum = _mm_setzero_ps();
+	__m128 delta_splat = _mm_set1_ps(delta);
+	for (unsigned i = 0; i < taps; i += 4)
+	{
+		__m128 buf = _mm_loadu_ps(buffer + i);
+		__m128 sinc = _mm_add_ps(_mm_loadu_ps(phases + i), _mm_mul_ps(_mm_loadu_ps(deltas + i), delta_splat));
+		sum = _mm_add_ps(sum, _mm_mul_ps(buf, sinc));
+	}
+
+	sum = _mm_hadd_ps(sum, sum);
+	sum = _mm_hadd_ps(sum, sum);
+	return _mm_cvtss_f32(sum);
+}
+
+static void downsample_rgba8_sse3(uint8_t *dst, const uint8_t *row0, const uint8_t *row1, size_t dst_width)
+{
+	size_t rounded_width = dst_width & ~size_t(3);
+	__m128i zero = _mm_setzero_si128();
+	__m128i round = _mm_set1_epi16(2);
+
+	for (size_t x = 0; x < rounded_width; x += 4)
+	{
+		__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 8 * x));
+		__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + 8 * x + 16));
+		__m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 8 * x));
+		__m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + 8 * x + 16));
+
+		// Vertical sums, two texels per register.
+		__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+		__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+		__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+		__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+		// Horizontal sums of neighbor texels.
+		__m128i h0 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+		__m128i h1 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+		h0 = _mm_srli_epi16(_mm_add_epi16(h0, round), 2);
+		h1 = _mm_srli_epi16(_mm_add_epi16(h1, round), 2);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4 * x), _mm_packus_epi16(h0, h1));
+	}
+
+	downsample_rgba8_scalar(dst + 4 * rounded_width, row0 + 8 * rounded_width, row1 + 8 * rounded_width,
+	                        dst_width - rounded_width);
+}
+#endif
+
+#if defined(__ARM_NEON)
+static void frustum_cull_neon(uint8_t *visible, const float * const *aabbs, size_t count, const float *planes)
+{
+	float32x4_t p[6];
+	uint32x4_t mask[6];
+	for (unsigned i = 0; i < 6; i++)
+	{
+		p[i] = vld1q_f32(planes + 4 * i);
+		mask[i] = vcgtq_f32(p[i], vdupq_n_f32(0.0f));
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		float32x4_t lo = vld1q_f32(aabbs[i]);
+		float32x4_t hi = vld1q_f32(aabbs[i] + 4);
+		float32x4_t dotted[6];
+		for (unsigned j = 0; j < 6; j++)
+			dotted[j] = vmulq_f32(p[j], vbslq_f32(mask[j], hi, lo));
+
+		float32x2_t merged[6];
+		for (unsigned j = 0; j < 6; j++)
+			merged[j] = vpadd_f32(vget_low_f32(dotted[j]), vget_high_f32(dotted[j]));
+		float32x2_t merged01 = vpadd_f32(merged[0], merged[1]);
+		float32x2_t merged23 = vpadd_f32(merged[2], merged[3]);
+		float32x2_t merged45 = vpadd_f32(merged[4], merged[5]);
+		float32x2_t min_merged = vmin_f32(vmin_f32(merged01, merged23), merged45);
+		min_merged = vpmin_f32(min_merged, min_merged);
+		visible[i] = vget_lane_f32(min_merged, 0) >= 0.0f ? 1 : 0;
+	}
+}
+
+static void mul_affine_neon(float * const *c, const float * const *a, const float *b, size_t count)
+{
+	float32x4_t w_select = vsetq_lane_f32(1.0f, vdupq_n_f32(0.0f), 3);
+	for (size_t i = 0; i < count; i++, b += 12)
+	{
+		float32x4_t b0 = vld1q_f32(b + 0);
+		float32x4_t b1 = vld1q_f32(b + 4);
+		float32x4_t b2 = vld1q_f32(b + 8);
+		const float *m = a[i];
+		float32x4_t rows[3];
+
+		for (unsigned r = 0; r < 3; r++)
+		{
+			float32x4_t ar = vld1q_f32(m + 4 * r);
+			float32x4_t row = vmulq_f32(ar, w_select);
+			row = vmlaq_n_f32(row, b0, vgetq_lane_f32(ar, 0));
+			row = vmlaq_n_f32(row, b1, vgetq_lane_f32(ar, 1));
+			row = vmlaq_n_f32(row, b2, vgetq_lane_f32(ar, 2));
+			rows[r] = row;
+		}
+
+		vst1q_f32(c[i] + 0, rows[0]);
+		vst1q_f32(c[i] + 4, rows[1]);
+		vst1q_f32(c[i] + 8, rows[2]);
+	}
+}
+
+static void accumulate_neon(float *output, const float *input, float gain, size_t count)
+{
+	size_t rounded_count = count & ~size_t(3);
+	for (size_t i = 0; i < rounded_count; i += 4)
+	{
+		float32x4_t acc = vld1q_f32(output + i);
+		float32x4_t in = vld1q_f32(input + i);
+		vst1q_f32(output + i, vmlaq_n_f32(acc, in, gain));
+	}
+
+	for (size_t i = rounded_count; i < count; i++)
+		output[i] += input[i] * gain;
+}
+
+static float sinc_dot_neon(const float *buffer, const float *phases, const float *deltas, float delta, unsigned taps)
+{
+	float32x4_t sum = vdupq_n_f32(0.0f);
+	for (unsigned i = 0; i < taps; i += 4)
+	{
+		float32x4_t sinc = vmlaq_n_f32(vld1q_f32(phases + i), vld1q_f32(deltas + i), delta);
+		sum = vmlaq_f32(sum, vld1q_f32(buffer + i), sinc);
+	}
+
+	float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+	return vget_lane_f32(vpadd_f32(half, half), 0);
+}
+
+static void downsample_rgba8_neon(uint8_t *dst, const uint8_t *row0, const uint8_t *row1, size_t dst_width)
+{
+	size_t rounded_width = dst_width & ~size_t(3);
+	for (size_t x = 0; x < rounded_width; x += 4)
+	{
+		// De-interleave even and odd texels, then widen and sum.
+		uint32x4x2_t a = vld2q_u32(reinterpret_cast<const uint32_t *>(row0 + 8 * x));
+		uint32x4x2_t b = vld2q_u32(reinterpret_cast<const uint32_t *>(row1 + 8 * x));
+		uint8x16_t a0 = vreinterpretq_u8_u32(a.val[0]);
+		uint8x16_t a1 = vreinterpretq_u8_u32(a.val[1]);
+		uint8x16_t b0 = vreinterpretq_u8_u32(b.val[0]);
+		uint8x16_t b1 = vreinterpretq_u8_u32(b.val[1]);
+
+		uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a0), vget_low_u8(a1)),
+		                          vaddl_u8(vget_low_u8(b0), vget_low_u8(b1)));
+		uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a0), vget_high_u8(a1)),
+		                          vaddl_u8(vget_high_u8(b0), vget_high_u8(b1)));
+
+		vst1q_u8(dst + 4 * x, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+	}
+
+	downsample_rgba8_scalar(dst + 4 * rounded_width, row0 + 8 * rounded_width, row1 + 8 * rounded_width,
+	                        dst_width - rounded_width);
+}
+#endif
+
+#ifdef GRANITE_SIMD_DISPATCH_X86
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+	int r[4];
+	__cpuidex(r, int(leaf), int(subleaf));
+	for (int i = 0; i < 4; i++)
+		regs[i] = uint32_t(r[i]);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t read_xcr0()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (uint64_t(edx) << 32) | eax;
+#endif
+}
+
+static void detect_x86(bool &has_avx2, bool &has_avx512)
+{
+	has_avx2 = false;
+	has_avx512 = false;
+
+	uint32_t regs[4];
+	cpuid(0, 0, regs);
+	uint32_t max_leaf = regs[0];
+	if (max_leaf < 7)
+		return;
+
+	cpuid(1, 0, regs);
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	bool avx = (regs[2] & (1u << 28)) != 0;
+	bool fma = (regs[2] & (1u << 12)) != 0;
+	if (!osxsave || !avx || !fma)
+		return;
+
+	// The OS must preserve YMM state, and for AVX-512 also the opmask and ZMM state.
+	uint64_t xcr0 = read_xcr0();
+	bool os_avx = (xcr0 & 0x6) == 0x6;
+	bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+
+	cpuid(7, 0, regs);
+	has_avx2 = os_avx && (regs[1] & (1u << 5)) != 0;
+	has_avx512 = has_avx2 && os_avx512 && (regs[1] & (1u << 16)) != 0;
+}
+#endif
+
+struct DispatchTables
+{
+	DispatchTables();
+	DispatchKernels tables[int(DispatchISA::Count)];
+	bool supported[int(DispatchISA::Count)] = {};
+	const DispatchKernels *best = nullptr;
+};
+
+DispatchTables::DispatchTables()
+{
+	auto &scalar = tables[int(DispatchISA::Scalar)];
+	scalar.isa = DispatchISA::Scalar;
+	scalar.name = "scalar";
+	scalar.frustum_cull = frustum_cull_scalar;
+	scalar.mul_affine = mul_affine_scalar;
+	scalar.transform_expand_aabb = transform_expand_aabb_scalar;
+	scalar.accumulate = accumulate_scalar;
+	scalar.sinc_dot = sinc_dot_scalar;
+	scalar.downsample_rgba8 = downsample_rgba8_scalar;
+	supported[int(DispatchISA::Scalar)] = true;
+	const DispatchKernels *base = &scalar;
+
+#if defined(__SSE3__)
+	auto &sse3 = tables[int(DispatchISA::SSE3)];
+	sse3 = *base;
+	sse3.isa = DispatchISA::SSE3;
+	sse3.name = "sse3";
+	sse3.frustum_cull = frustum_cull_sse3;
+	sse3.mul_affine = mul_affine_sse3;
+	sse3.transform_expand_aabb = transform_expand_aabb_sse3;
+	sse3.accumulate = accumulate_sse3;
+	sse3.sinc_dot = sinc_dot_sse3;
+	sse3.downsample_rgba8 = downsample_rgba8_sse3;
+	supported[int(DispatchISA::SSE3)] = true;
+	base = &sse3;
+#endif
+
+#if defined(__ARM_NEON)
+	auto &neon = tables[int(DispatchISA::NEON)];
+	neon = *base;
+	neon.isa = DispatchISA::NEON;
+	neon.name = "neon";
+	neon.frustum_cull = frustum_cull_neon;
+	neon.mul_affine = mul_affine_neon;
+	neon.accumulate = accumulate_neon;
+	neon.sinc_dot = sinc_dot_neon;
+	neon.downsample_rgba8 = downsample_rgba8_neon;
+	supported[int(DispatchISA::NEON)] = true;
+	base = &neon;
+#endif
+
+#ifdef GRANITE_SIMD_DISPATCH_X86
+	bool has_avx2, has_avx512;
+	detect_x86(has_avx2, has_avx512);
+
+	if (has_avx2)
+	{
+		auto &avx2 = tables[int(DispatchISA::AVX2)];
+		avx2 = *base;
+		avx2.isa = DispatchISA::AVX2;
+		avx2.name = "avx2";
+		fill_dispatch_avx2(avx2);
+		supported[int(DispatchISA::AVX2)] = true;
+		base = &avx2;
+	}
+
+	if (has_avx512)
+	{
+		auto &avx512 = tables[int(DispatchISA::AVX512)];
+		avx512 = *base;
+		avx512.isa = DispatchISA::AVX512;
+		avx512.name = "avx512";
+		fill_dispatch_avx512(avx512);
+		supported[int(DispatchISA::AVX512)] = true;
+		base = &avx512;
+	}
+#endif
+
+	best = base;
+
+	std::string cap;
+	if (Util::get_environment("GRANITE_SIMD_DISPATCH", cap))
+	{
+		const DispatchKernels *requested = nullptr;
+		for (int i = 0; i < int(DispatchISA::Count); i++)
+			if (supported[i] && cap == tables[i].name)
+				requested = &tables[i];
+
+		if (requested)
+			best = requested;
+		else
+			LOGW("SIMD dispatch: %s is not supported, ignoring.\n", cap.c_str());
+	}
+
+	LOGI("SIMD dispatch: using %s kernels.\n", best->name);
+}
+
+static const DispatchTables &get_tables()
+{
+	static DispatchTables tables;
+	return tables;
+}
+
+const DispatchKernels &get_dispatch()
+{
+	return *get_tables().best;
+}
+
+const DispatchKernels *get_dispatch(DispatchISA isa)
+{
+	auto &tables = get_tables();
+	if (int(isa) >= int(DispatchISA::Count) || !tables.supported[int(isa)])
+		return nullptr;
+	return &tables.tables[int(isa)];
+}
+}
+}
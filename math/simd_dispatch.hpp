@@ -0,0 +1,83 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Granite
+{
+namespace SIMD
+{
+// Hot kernels which are compiled for several instruction sets into the same binary.
+// The best variant the CPU supports is selected once at startup.
+// The baseline (SSE3 on x86, NEON on ARM) matches the inline kernels in simd.hpp.
+enum class DispatchISA
+{
+	Scalar,
+	SSE3,
+	AVX2,
+	AVX512,
+	NEON,
+	Count
+};
+
+// Kernels take raw data so that translation units built with wider instruction sets
+// never instantiate shared inline code which the linker could pick for other callers.
+// Layouts:
+// - An AABB is 8 floats: minimum.xyzw followed by maximum.xyzw.
+// - An affine transform is 12 floats: three rows, as in mat_affine.
+// - A frustum is 6 planes of 4 floats.
+struct DispatchKernels
+{
+	DispatchISA isa;
+	const char *name;
+
+	// visible[i] is set to 1 if *aabbs[i] intersects the frustum, 0 otherwise.
+	void (*frustum_cull)(uint8_t *visible, const float * const *aabbs, size_t count, const float *planes);
+
+	// *c[i] = *a[i] * b[i] for affine transforms.
+	void (*mul_affine)(float * const *c, const float * const *a, const float *b, size_t count);
+
+	// Expands expandee to contain aabb transformed by each of the count affine transforms.
+	void (*transform_expand_aabb)(float *expandee, const float *aabb, const float *affine, size_t count);
+
+	// output[i] += input[i] * gain.
+	void (*accumulate)(float *output, const float *input, float gain, size_t count);
+
+	// Returns sum(buffer[i] * (phases[i] + deltas[i] * delta)). taps must be a multiple of 4.
+	float (*sinc_dot)(const float *buffer, const float *phases, const float *deltas, float delta, unsigned taps);
+
+	// 2x2 box filter of RGBA8 texels, rounding to nearest.
+	// row0 and row1 hold 2 * dst_width texels each.
+	void (*downsample_rgba8)(uint8_t *dst, const uint8_t *row0, const uint8_t *row1, size_t dst_width);
+};
+
+// Best variant supported by the CPU.
+// GRANITE_SIMD_DISPATCH=scalar|sse3|avx2|avx512|neon overrides the selection for debugging.
+const DispatchKernels &get_dispatch();
+
+// Returns nullptr if the variant was not compiled in or is not supported by the CPU.
+const DispatchKernels *get_dispatch(DispatchISA isa);
+}
+}
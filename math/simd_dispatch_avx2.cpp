@@ -0,0 +1,199 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Built with AVX2 and FMA enabled. Only called after CPUID confirms support.
+#include "simd_dispatch.hpp"
+#include <immintrin.h>
+
+namespace Granite
+{
+namespace SIMD
+{
+static inline __m256 load_pair(const float *a, const float *b)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)), _mm_loadu_ps(b), 1);
+}
+
+static void frustum_cull_avx2(uint8_t *visible, const float * const *aabbs, size_t count, const float *planes)
+{
+	__m256 p[6], mask[6];
+	for (unsigned i = 0; i < 6; i++)
+	{
+		p[i] = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(planes + 4 * i));
+		mask[i] = _mm256_cmp_ps(p[i], _mm256_setzero_ps(), _CMP_GT_OQ);
+	}
+
+	// Two AABBs per iteration, one in each 128-bit lane.
+	for (size_t i = 0; i < count; i += 2)
+	{
+		const float *a = aabbs[i];
+		const float *b = i + 1 < count ? aabbs[i + 1] : a;
+		__m256 lo = load_pair(a, b);
+		__m256 hi = load_pair(a + 4, b + 4);
+
+		__m256 dotted[6];
+		for (unsigned j = 0; j < 6; j++)
+			dotted[j] = _mm256_mul_ps(p[j], _mm256_blendv_ps(lo, hi, mask[j]));
+
+		__m256 merged01 = _mm256_hadd_ps(dotted[0], dotted[1]);
+		__m256 merged23 = _mm256_hadd_ps(dotted[2], dotted[3]);
+		__m256 merged45 = _mm256_hadd_ps(dotted[4], dotted[5]);
+		__m256 merged0123 = _mm256_hadd_ps(merged01, merged23);
+		merged45 = _mm256_hadd_ps(merged45, merged45);
+		int sign_mask = _mm256_movemask_ps(_mm256_or_ps(merged0123, merged45));
+
+		visible[i] = (sign_mask & 0xf) == 0 ? 1 : 0;
+		if (i + 1 < count)
+			visible[i + 1] = (sign_mask & 0xf0) == 0 ? 1 : 0;
+	}
+}
+
+static void mul_affine_avx2(float * const *c, const float * const *a, const float *b, size_t count)
+{
+	__m128 w_select = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+	for (size_t i = 0; i < count; i++, b += 12)
+	{
+		__m128 b0 = _mm_loadu_ps(b + 0);
+		__m128 b1 = _mm_loadu_ps(b + 4);
+		__m128 b2 = _mm_loadu_ps(b + 8);
+		const float *m = a[i];
+		__m128 rows[3];
+
+		for (unsigned r = 0; r < 3; r++)
+		{
+			__m128 ar = _mm_loadu_ps(m + 4 * r);
+			__m128 row = _mm_mul_ps(ar, w_select);
+			row = _mm_fmadd_ps(b0, _mm_permute_ps(ar, _MM_SHUFFLE(0, 0, 0, 0)), row);
+			row = _mm_fmadd_ps(b1, _mm_permute_ps(ar, _MM_SHUFFLE(1, 1, 1, 1)), row);
+			row = _mm_fmadd_ps(b2, _mm_permute_ps(ar, _MM_SHUFFLE(2, 2, 2, 2)), row);
+			rows[r] = row;
+		}
+
+		_mm_storeu_ps(c[i] + 0, rows[0]);
+		_mm_storeu_ps(c[i] + 4, rows[1]);
+		_mm_storeu_ps(c[i] + 8, rows[2]);
+	}
+}
+
+static void transform_expand_aabb_avx2(float *expandee, const float *aabb, const float *affine, size_t count)
+{
+	__m256 lo = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(aabb));
+	__m256 hi = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(aabb + 4));
+	__m256 lo0 = _mm256_permute_ps(lo, _MM_SHUFFLE(0, 0, 0, 0));
+	__m256 lo1 = _mm256_permute_ps(lo, _MM_SHUFFLE(1, 1, 1, 1));
+	__m256 lo2 = _mm256_permute_ps(lo, _MM_SHUFFLE(2, 2, 2, 2));
+	__m256 hi0 = _mm256_permute_ps(hi, _MM_SHUFFLE(0, 0, 0, 0));
+	__m256 hi1 = _mm256_permute_ps(hi, _MM_SHUFFLE(1, 1, 1, 1));
+	__m256 hi2 = _mm256_permute_ps(hi, _MM_SHUFFLE(2, 2, 2, 2));
+	__m256 r3 = _mm256_set_ps(1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f);
+
+	__m256 lo_expand = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(expandee));
+	__m256 hi_expand = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(expandee + 4));
+
+	// Two transforms per iteration, one in each 128-bit lane.
+	for (size_t i = 0; i < count; i += 2)
+	{
+		const float *a = affine + 12 * i;
+		const float *b = i + 1 < count ? a + 12 : a;
+		__m256 r0 = load_pair(a + 0, b + 0);
+		__m256 r1 = load_pair(a + 4, b + 4);
+		__m256 r2 = load_pair(a + 8, b + 8);
+
+		// In-lane transpose to columns.
+		__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+		__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+		__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+		__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+		__m256 m0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 m1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 m2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 m3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+		__m256 m0_pos = _mm256_cmp_ps(m0, _mm256_setzero_ps(), _CMP_GT_OQ);
+		__m256 m1_pos = _mm256_cmp_ps(m1, _mm256_setzero_ps(), _CMP_GT_OQ);
+		__m256 m2_pos = _mm256_cmp_ps(m2, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+		__m256 hi_result = _mm256_fmadd_ps(m0, _mm256_blendv_ps(lo0, hi0, m0_pos), m3);
+		hi_result = _mm256_fmadd_ps(m1, _mm256_blendv_ps(lo1, hi1, m1_pos), hi_result);
+		hi_result = _mm256_fmadd_ps(m2, _mm256_blendv_ps(lo2, hi2, m2_pos), hi_result);
+
+		__m256 lo_result = _mm256_fmadd_ps(m0, _mm256_blendv_ps(hi0, lo0, m0_pos), m3);
+		lo_result = _mm256_fmadd_ps(m1, _mm256_blendv_ps(hi1, lo1, m1_pos), lo_result);
+		lo_result = _mm256_fmadd_ps(m2, _mm256_blendv_ps(hi2, lo2, m2_pos), lo_result);
+
+		lo_expand = _mm256_min_ps(lo_expand, lo_result);
+		hi_expand = _mm256_max_ps(hi_expand, hi_result);
+	}
+
+	_mm_storeu_ps(expandee, _mm_min_ps(_mm256_castps256_ps128(lo_expand), _mm256_extractf128_ps(lo_expand, 1)));
+	_mm_storeu_ps(expandee + 4, _mm_max_ps(_mm256_castps256_ps128(hi_expand), _mm256_extractf128_ps(hi_expand, 1)));
+}
+
+static void accumulate_avx2(float *output, const float *input, float gain, size_t count)
+{
+	size_t rounded_count = count & ~size_t(7);
+	__m256 gain_splat = _mm256_set1_ps(gain);
+	for (size_t i = 0; i < rounded_count; i += 8)
+	{
+		__m256 acc = _mm256_loadu_ps(output + i);
+		acc = _mm256_fmadd_ps(_mm256_loadu_ps(input + i), gain_splat, acc);
+		_mm256_storeu_ps(output + i, acc);
+	}
+
+	for (size_t i = rounded_count; i < count; i++)
+		output[i] += input[i] * gain;
+}
+
+static float sinc_dot_avx2(const float *buffer, const float *phases, const float *deltas, float delta, unsigned taps)
+{
+	unsigned rounded_taps = taps & ~7u;
+	__m256 sum = _mm256_setzero_ps();
+	__m256 delta_splat = _mm256_set1_ps(delta);
+	for (unsigned i = 0; i < rounded_taps; i += 8)
+	{
+		__m256 sinc = _mm256_fmadd_ps(_mm256_loadu_ps(deltas + i), delta_splat, _mm256_loadu_ps(phases + i));
+		sum = _mm256_fmadd_ps(_mm256_loadu_ps(buffer + i), sinc, sum);
+	}
+
+	__m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+	if (rounded_taps != taps)
+	{
+		__m128 sinc = _mm_fmadd_ps(_mm_loadu_ps(deltas + rounded_taps), _mm256_castps256_ps128(delta_splat),
+		                           _mm_loadu_ps(phases + rounded_taps));
+		sum4 = _mm_fmadd_ps(_mm_loadu_ps(buffer + rounded_taps), sinc, sum4);
+	}
+
+	sum4 = _mm_hadd_ps(sum4, sum4);
+	sum4 = _mm_hadd_ps(sum4, sum4);
+	return _mm_cvtss_f32(sum4);
+}
+
+void fill_dispatch_avx2(DispatchKernels &kernels)
+{
+	kernels.frustum_cull = frustum_cull_avx2;
+	kernels.mul_affine = mul_affine_avx2;
+	kernels.transform_expand_aabb = transform_expand_aabb_avx2;
+	kernels.accumulate = accumulate_avx2;
+	kernels.sinc_dot = sinc_dot_avx2;
+}
+}
+}
@@ -0,0 +1,137 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Built with AVX-512F enabled. Only called after CPUID confirms support.
+// Kernels which do not benefit from 512-bit vectors are inherited from the AVX2 table.
+// Some unmasked intrinsics are implemented with _mm512_undefined_*() and trip -Wuninitialized on GCC 12.
+// Their all-ones maskz forms compile to the same instructions, so those are used instead.
+#include "simd_dispatch.hpp"
+#include <immintrin.h>
+
+namespace Granite
+{
+namespace SIMD
+{
+static inline __mmask16 tail_mask(size_t count)
+{
+	return __mmask16((1u << count) - 1u);
+}
+
+static void frustum_cull_avx512(uint8_t *visible, const float * const *aabbs, size_t count, const float *planes)
+{
+	__m512 p[6];
+	__mmask16 mask[6];
+	for (unsigned i = 0; i < 6; i++)
+	{
+		p[i] = _mm512_maskz_broadcast_f32x4(0xffff, _mm_loadu_ps(planes + 4 * i));
+		mask[i] = _mm512_cmp_ps_mask(p[i], _mm512_setzero_ps(), _CMP_GT_OQ);
+	}
+
+	// Four AABBs per iteration, one in each 128-bit lane.
+	for (size_t i = 0; i < count; i += 4)
+	{
+		const float *aabb[4];
+		for (unsigned j = 0; j < 4; j++)
+			aabb[j] = aabbs[i + j < count ? i + j : i];
+
+		__m512 lo = _mm512_castps128_ps512(_mm_loadu_ps(aabb[0]));
+		lo = _mm512_insertf32x4(lo, _mm_loadu_ps(aabb[1]), 1);
+		lo = _mm512_insertf32x4(lo, _mm_loadu_ps(aabb[2]), 2);
+		lo = _mm512_insertf32x4(lo, _mm_loadu_ps(aabb[3]), 3);
+		__m512 hi = _mm512_castps128_ps512(_mm_loadu_ps(aabb[0] + 4));
+		hi = _mm512_insertf32x4(hi, _mm_loadu_ps(aabb[1] + 4), 1);
+		hi = _mm512_insertf32x4(hi, _mm_loadu_ps(aabb[2] + 4), 2);
+		hi = _mm512_insertf32x4(hi, _mm_loadu_ps(aabb[3] + 4), 3);
+
+		// Sums each plane distance in the order hadd would, so results match the narrower variants.
+		__m512 merged = _mm512_setzero_ps();
+		for (unsigned j = 0; j < 6; j++)
+		{
+			__m512 dotted = _mm512_mul_ps(p[j], _mm512_mask_blend_ps(mask[j], lo, hi));
+			dotted = _mm512_add_ps(dotted, _mm512_shuffle_ps(dotted, dotted, _MM_SHUFFLE(2, 3, 0, 1)));
+			dotted = _mm512_add_ps(dotted, _mm512_shuffle_ps(dotted, dotted, _MM_SHUFFLE(1, 0, 3, 2)));
+			merged = _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(merged), _mm512_castps_si512(dotted)));
+		}
+
+		unsigned sign_mask = _mm512_cmplt_epi32_mask(_mm512_castps_si512(merged), _mm512_setzero_si512());
+		for (unsigned j = 0; j < 4 && i + j < count; j++)
+			visible[i + j] = ((sign_mask >> (4 * j)) & 0xf) == 0 ? 1 : 0;
+	}
+}
+
+static void accumulate_avx512(float *output, const float *input, float gain, size_t count)
+{
+	__m512 gain_splat = _mm512_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m512 acc = _mm512_loadu_ps(output + i);
+		acc = _mm512_fmadd_ps(_mm512_loadu_ps(input + i), gain_splat, acc);
+		_mm512_storeu_ps(output + i, acc);
+	}
+
+	if (i < count)
+	{
+		__mmask16 mask = tail_mask(count - i);
+		__m512 acc = _mm512_maskz_loadu_ps(mask, output + i);
+		acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, input + i), gain_splat, acc);
+		_mm512_mask_storeu_ps(output + i, mask, acc);
+	}
+}
+
+static float sinc_dot_avx512(const float *buffer, const float *phases, const float *deltas, float delta, unsigned taps)
+{
+	__m512 sum = _mm512_setzero_ps();
+	__m512 delta_splat = _mm512_set1_ps(delta);
+	unsigned i = 0;
+	for (; i + 16 <= taps; i += 16)
+	{
+		__m512 sinc = _mm512_fmadd_ps(_mm512_loadu_ps(deltas + i), delta_splat, _mm512_loadu_ps(phases + i));
+		sum = _mm512_fmadd_ps(_mm512_loadu_ps(buffer + i), sinc, sum);
+	}
+
+	if (i < taps)
+	{
+		__mmask16 mask = tail_mask(taps - i);
+		__m512 sinc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, deltas + i), delta_splat,
+		                              _mm512_maskz_loadu_ps(mask, phases + i));
+		sum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, buffer + i), sinc, sum);
+	}
+
+	// Reduce by hand through the 256-bit halves. Only AVX-512F is assumed, so go through the 64-bit lane extract.
+	__m256 lo = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, _mm512_castps_pd(sum), 0));
+	__m256 hi = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xff, _mm512_castps_pd(sum), 1));
+	__m256 sum8 = _mm256_add_ps(lo, hi);
+	__m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum8), _mm256_extractf128_ps(sum8, 1));
+	sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+	sum4 = _mm_add_ss(sum4, _mm_shuffle_ps(sum4, sum4, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtss_f32(sum4);
+}
+
+void fill_dispatch_avx512(DispatchKernels &kernels)
+{
+	kernels.frustum_cull = frustum_cull_avx512;
+	kernels.accumulate = accumulate_avx512;
+	kernels.sinc_dot = sinc_dot_avx512;
+}
+}
+}
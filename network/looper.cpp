@@ -37,7 +37,7 @@
 namespace Granite
 {
 LooperHandler::LooperHandler(std::unique_ptr<Socket> socket_)
-	: socket(move(socket_))
+	: socket(std::move(socket_))
 {
 }
 
@@ -46,17 +46,17 @@ Looper::Looper()
 #ifdef __linux__
 	fd = epoll_create1(0);
 	if (fd < 0)
-		throw runtime_error("Failed to create epoller.");
+		throw std::runtime_error("Failed to create epoller.");
 
 	event_fd = ::eventfd(0, EFD_NONBLOCK);
 	if (event_fd < 0)
-		throw runtime_error("Failed to create eventfd.");
+		throw std::runtime_error("Failed to create eventfd.");
 
 	epoll_event event = {};
 	event.events = EPOLLIN;
 	event.data.ptr = nullptr;
 	if (epoll_ctl(fd, EPOLL_CTL_ADD, event_fd, &event) < 0)
-		throw runtime_error("Failed to add event fd to epoll.");
+		throw std::runtime_error("Failed to add event fd to epoll.");
 #else
 	throw std::runtime_error("Unimplemented feature on Windows.");
 #endif
@@ -97,7 +97,7 @@ bool Looper::modify_handler(EventFlags events, LooperHandler &handler)
 #endif
 }
 
-bool Looper::register_handler(EventFlags events, unique_ptr<LooperHandler> handler)
+bool Looper::register_handler(EventFlags events, std::unique_ptr<LooperHandler> handler)
 {
 #ifdef __linux__
 	int flags = 0;
@@ -113,7 +113,7 @@ bool Looper::register_handler(EventFlags events, unique_ptr<LooperHandler> handl
 		return false;
 
 	handler->get_socket().set_parent_looper(this);
-	handlers[handler->get_socket().get_fd()] = move(handler);
+	handlers[handler->get_socket().get_fd()] = std::move(handler);
 	return true;
 #else
 	return false;
@@ -135,8 +135,8 @@ void Looper::run_in_looper(std::function<void()> func)
 {
 #ifdef __linux__
 	{
-		lock_guard<mutex> holder{queue_lock};
-		func_queue.push_back(move(func));
+		std::lock_guard<std::mutex> holder{queue_lock};
+		func_queue.push_back(std::move(func));
 	}
 
 	uint64_t one = 1;
@@ -148,7 +148,7 @@ void Looper::kill()
 {
 #ifdef __linux__
 	{
-		lock_guard<mutex> holder{queue_lock};
+		std::lock_guard<std::mutex> holder{queue_lock};
 		func_queue.push_back([this]() {
 			dead = true;
 		});
@@ -167,7 +167,7 @@ void Looper::handle_deferred_funcs()
 	if (!count)
 		return;
 
-	lock_guard<mutex> holder{queue_lock};
+	std::lock_guard<std::mutex> holder{queue_lock};
 	for (auto &func : func_queue)
 		func();
 	func_queue.clear();
@@ -28,11 +28,14 @@
 #else
 #include <arpa/inet.h>
 #endif
+#include <stdint.h>
 #include <string.h>
 #include <string>
 
 namespace Granite
 {
+static constexpr uint16_t NetFSDefaultPort = 7070;
+
 enum NetFSCommand
 {
 	NETFS_READ_FILE = 1,
@@ -45,7 +48,30 @@ enum NetFSCommand
 	NETFS_UNREGISTER_NOTIFICATION = 8,
 	NETFS_BEGIN_CHUNK_REQUEST = 9,
 	NETFS_BEGIN_CHUNK_REPLY = 10,
-	NETFS_BEGIN_CHUNK_NOTIFICATION = 11
+	NETFS_BEGIN_CHUNK_NOTIFICATION = 11,
+	NETFS_BEGIN_SESSION = 12,
+	NETFS_READ_FILE_RANGE = 13,
+	NETFS_SESSION_REQUEST = 14,
+	NETFS_SESSION_REPLY = 15
+};
+
+// A session is a persistent connection where requests are tagged and pipelined.
+// After NETFS_BEGIN_SESSION, both sides exchange frames with a fixed header:
+// u32 NETFS_SESSION_REQUEST/NETFS_SESSION_REPLY, u32 command (request) or error (reply),
+// u64 tag, u64 payload size, followed by payload.
+// Replies may arrive in any order, the tag identifies which request is completed.
+// NETFS_READ_FILE_RANGE payload: u64 offset, u64 size, u32 NetFSCompression, path (implicit count).
+// NETFS_READ_FILE_RANGE reply: u32 NetFSCompression, u64 decompressed size, data.
+// NETFS_STAT payload: path (implicit count). Reply is same as plain NETFS_STAT.
+static constexpr size_t NetFSSessionHeaderSize = 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+// Request payloads are a few parameters and a path. The server rejects anything larger
+// before allocating for it, so a bogus size cannot make it allocate arbitrary amounts of memory.
+static constexpr uint64_t NetFSMaxRequestPayloadSize = 64 * 1024;
+
+enum NetFSCompression
+{
+	NETFS_COMPRESSION_NONE = 0,
+	NETFS_COMPRESSION_LZ4 = 1
 };
 
 enum NetFSError
@@ -148,6 +174,21 @@ public:
 		return ret;
 	}
 
+	const uint8_t *read_data(size_t size)
+	{
+		if (offset + size > buffer.size())
+			return nullptr;
+
+		auto *ret = buffer.data() + offset;
+		offset += size;
+		return ret;
+	}
+
+	size_t get_remaining() const
+	{
+		return buffer.size() - offset;
+	}
+
 	std::string read_string_implicit_count()
 	{
 		auto ret = std::string(reinterpret_cast<const char *>(buffer.data() + offset),
@@ -162,6 +203,12 @@ public:
 		buffer.insert(std::end(buffer), std::begin(other), std::end(other));
 	}
 
+	void add_data(const void *data, size_t size)
+	{
+		auto *bytes = static_cast<const uint8_t *>(data);
+		buffer.insert(std::end(buffer), bytes, bytes + size);
+	}
+
 	std::vector<uint8_t> &get_buffer()
 	{
 		return buffer;
@@ -169,7 +216,7 @@ public:
 
 	std::vector<uint8_t> &&consume_buffer()
 	{
-		return move(buffer);
+		return std::move(buffer);
 	}
 
 	void begin(size_t size = 0)
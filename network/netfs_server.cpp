@@ -20,29 +20,29 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
-#include "network.hpp"
+#include "netfs_server.hpp"
 #include "logging.hpp"
-#include "netfs.hpp"
 #include "filesystem.hpp"
-#include "event.hpp"
+#include "lz4_block.hpp"
+#include <algorithm>
 #include <unordered_set>
 #include <queue>
 
-using namespace Granite;
-
+namespace Granite
+{
 struct FSHandler;
 
 struct FilesystemHandler : LooperHandler
 {
-	FilesystemHandler(unique_ptr<Socket> socket_, FilesystemBackend &backend_)
-		: LooperHandler(move(socket_)), backend(backend_)
+	FilesystemHandler(std::unique_ptr<Socket> socket_, FilesystemBackend &backend_)
+		: LooperHandler(std::move(socket_)), backend(backend_)
 	{
 	}
 
 	bool handle(Looper &, EventFlags flags) override
 	{
 		if (flags & EVENT_IN)
-			Global::filesystem()->poll_notifications();
+			backend.poll_notifications();
 
 		return true;
 	}
@@ -55,46 +55,33 @@ struct FilesystemHandler : LooperHandler
 	FilesystemBackend &backend;
 };
 
-struct NotificationSystem : EventHandler
+struct NotificationSystem
 {
-	explicit NotificationSystem(Looper &looper_)
-		: looper(looper_)
+	NotificationSystem(Looper &looper_, Filesystem &fs_)
+		: looper(looper_), fs(fs_)
 	{
-		EVENT_MANAGER_REGISTER(NotificationSystem, on_filesystem, FilesystemProtocolEvent);
-		for (auto &proto : Global::filesystem()->get_protocols())
+		// Protocols are registered up front, so there is no need to track new ones.
+		for (auto &proto : fs.get_protocols())
 		{
-			auto &fs = proto.second;
-			if (fs->get_notification_fd() >= 0)
+			auto &backend = proto.second;
+			if (backend->get_notification_fd() >= 0)
 			{
-				auto socket = unique_ptr<Socket>(new Socket(fs->get_notification_fd(), false));
-				auto handler = unique_ptr<FilesystemHandler>(new FilesystemHandler(move(socket), *fs));
+				auto socket = std::unique_ptr<Socket>(new Socket(backend->get_notification_fd(), false));
+				auto handler = std::unique_ptr<FilesystemHandler>(new FilesystemHandler(std::move(socket), *backend));
 				auto *ptr = handler.get();
-				looper.register_handler(EVENT_IN, move(handler));
+				looper.register_handler(EVENT_IN, std::move(handler));
 				protocols[proto.first] = ptr;
 			}
 		}
 	}
 
-	bool on_filesystem(const FilesystemProtocolEvent &fs)
-	{
-		if (fs.get_backend().get_notification_fd() >= 0)
-		{
-			auto socket = unique_ptr<Socket>(new Socket(fs.get_backend().get_notification_fd(), false));
-			auto handler = unique_ptr<FilesystemHandler>(new FilesystemHandler(move(socket), fs.get_backend()));
-			auto *ptr = handler.get();
-			looper.register_handler(EVENT_IN, move(handler));
-			protocols[fs.get_protocol()] = ptr;
-		}
-		return true;
-	}
-
 	void uninstall_all_notifications(FSHandler *handler)
 	{
 		for (auto &proto : protocols)
 			proto.second->uninstall_all_notifications(handler);
 	}
 
-	FileNotifyHandle install_notification(FSHandler *handler, const string &protocol, const string &path)
+	FileNotifyHandle install_notification(FSHandler *handler, const std::string &protocol, const std::string &path)
 	{
 		auto *proto = protocols[protocol];
 		if (!proto)
@@ -103,7 +90,7 @@ struct NotificationSystem : EventHandler
 		return proto->install_notification(path, handler);
 	}
 
-	void uninstall_notification(FSHandler *handler, const string &protocol, FileNotifyHandle handle)
+	void uninstall_notification(FSHandler *handler, const std::string &protocol, FileNotifyHandle handle)
 	{
 		auto *proto = protocols[protocol];
 		if (!proto)
@@ -113,13 +100,14 @@ struct NotificationSystem : EventHandler
 	}
 
 	Looper &looper;
+	Filesystem &fs;
 	std::unordered_map<std::string, FilesystemHandler *> protocols;
 };
 
 struct FSHandler : LooperHandler
 {
-	FSHandler(NotificationSystem &notify_system_, unique_ptr<Socket> socket_)
-		: LooperHandler(move(socket_)), notify_system(notify_system_)
+	FSHandler(NotificationSystem &notify_system_, std::unique_ptr<Socket> socket_)
+		: LooperHandler(std::move(socket_)), notify_system(notify_system_)
 	{
 		reply_builder.begin(4);
 		command_reader.start(reply_builder.get_buffer());
@@ -179,6 +167,7 @@ struct FSHandler : LooperHandler
 		case NETFS_WRITE_FILE:
 		case NETFS_STAT:
 		case NETFS_NOTIFICATION:
+		case NETFS_BEGIN_SESSION:
 			state = ReadChunkSize;
 			reply_builder.begin(3 * sizeof(uint32_t));
 			command_reader.start(reply_builder.get_buffer());
@@ -207,6 +196,12 @@ struct FSHandler : LooperHandler
 				return false;
 			}
 
+			if (chunk_size > NetFSMaxRequestPayloadSize)
+			{
+				LOGE("Request chunk of %llu bytes is too large.\n", static_cast<unsigned long long>(chunk_size));
+				return false;
+			}
+
 			reply_builder.begin(chunk_size);
 			command_reader.start(reply_builder.get_buffer());
 			state = ReadChunkData;
@@ -224,7 +219,7 @@ struct FSHandler : LooperHandler
 			reply_builder.begin();
 			reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
 			reply_builder.add_u32(NETFS_ERROR_OK);
-			reply_builder.add_u64(file->get_size());
+			reply_builder.add_u64(mapping->get_size());
 			command_writer.start(reply_builder.get_buffer());
 			state = WriteReplyChunk;
 			looper.modify_handler(EVENT_OUT, *this);
@@ -252,8 +247,8 @@ struct FSHandler : LooperHandler
 				return false;
 			}
 
-			mapped = file->map_write(chunk_size);
-			if (!mapped)
+			mapping = file->map_write(chunk_size);
+			if (!mapping)
 			{
 				reply_builder.begin();
 				reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
@@ -266,7 +261,7 @@ struct FSHandler : LooperHandler
 			else
 			{
 				reply_builder.begin(chunk_size);
-				command_reader.start(mapped, chunk_size);
+				command_reader.start(mapping->mutable_data(), chunk_size);
 				state = ReadChunkData2;
 			}
 			return true;
@@ -275,9 +270,9 @@ struct FSHandler : LooperHandler
 		return (ret > 0) || (ret == Socket::ErrorWouldBlock);
 	}
 
-	bool begin_write_file(Looper &looper, const string &arg)
+	bool begin_write_file(Looper &looper, const std::string &arg)
 	{
-		file = Global::filesystem()->open(arg, FileMode::WriteOnly);
+		file = notify_system.fs.open(arg, FileMode::WriteOnly);
 		if (!file)
 		{
 			reply_builder.begin();
@@ -297,19 +292,19 @@ struct FSHandler : LooperHandler
 		return true;
 	}
 
-	bool begin_read_file(const string &arg)
+	bool begin_read_file(const std::string &arg)
 	{
-		file = Global::filesystem()->open(arg);
-		mapped = nullptr;
+		file = notify_system.fs.open(arg);
+		mapping.reset();
 		if (file)
-			mapped = file->map();
+			mapping = file->map();
 
 		reply_builder.begin();
-		if (mapped)
+		if (mapping)
 		{
 			reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
 			reply_builder.add_u32(NETFS_ERROR_OK);
-			reply_builder.add_u64(file->get_size());
+			reply_builder.add_u64(mapping->get_size());
 		}
 		else
 		{
@@ -321,7 +316,7 @@ struct FSHandler : LooperHandler
 		return true;
 	}
 
-	void write_string_list(const vector<ListEntry> &list)
+	void write_string_list(const std::vector<ListEntry> &list)
 	{
 		reply_builder.begin();
 		reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
@@ -348,12 +343,12 @@ struct FSHandler : LooperHandler
 		command_writer.start(reply_builder.get_buffer());
 	}
 
-	bool begin_stat(const string &arg)
+	bool begin_stat(const std::string &arg)
 	{
 		FileStat s;
 		reply_builder.begin();
 		reply_builder.add_u32(NETFS_BEGIN_CHUNK_REPLY);
-		if (Global::filesystem()->stat(arg, s))
+		if (notify_system.fs.stat(arg, s))
 		{
 			reply_builder.add_u32(NETFS_ERROR_OK);
 			reply_builder.add_u64(8 + 4 + 8);
@@ -381,16 +376,16 @@ struct FSHandler : LooperHandler
 		return true;
 	}
 
-	bool begin_list(const string &arg)
+	bool begin_list(const std::string &arg)
 	{
-		auto list = Global::filesystem()->list(arg);
+		auto list = notify_system.fs.list(arg);
 		write_string_list(list);
 		return true;
 	}
 
-	bool begin_walk(const string &arg)
+	bool begin_walk(const std::string &arg)
 	{
-		auto list = Global::filesystem()->walk(arg);
+		auto list = notify_system.fs.walk(arg);
 		write_string_list(list);
 		return true;
 	}
@@ -433,13 +428,21 @@ struct FSHandler : LooperHandler
 				break;
 
 			case NETFS_NOTIFICATION:
-				protocol = move(str);
+				protocol = std::move(str);
 				looper.modify_handler(EVENT_IN, *this);
 				reply_builder.begin(3 * sizeof(uint32_t));
 				command_reader.start(reply_builder.get_buffer());
 				state = NotificationLoop;
 				break;
 
+			case NETFS_BEGIN_SESSION:
+				protocol = std::move(str);
+				looper.modify_handler(EVENT_IN, *this);
+				reply_builder.begin(NetFSSessionHeaderSize);
+				command_reader.start(reply_builder.get_buffer());
+				state = SessionLoop;
+				break;
+
 			default:
 				return false;
 			}
@@ -467,9 +470,9 @@ struct FSHandler : LooperHandler
 			switch (command_id)
 			{
 			case NETFS_READ_FILE:
-				if (mapped)
+				if (mapping)
 				{
-					command_writer.start(mapped, file->get_size());
+					command_writer.start(mapping->data(), mapping->get_size());
 					state = WriteReplyData;
 					return true;
 				}
@@ -477,8 +480,9 @@ struct FSHandler : LooperHandler
 					return false;
 
 			case NETFS_WRITE_FILE:
-				if (file && mapped)
-					file->unmap();
+				// Releasing the mapping commits the write.
+				mapping.reset();
+				file.reset();
 				return false;
 
 			default:
@@ -617,6 +621,201 @@ struct FSHandler : LooperHandler
 		return true;
 	}
 
+	ReplyBuilder &begin_session_reply(uint64_t tag)
+	{
+		reply_queue.emplace();
+		auto &builder = reply_queue.back().builder;
+		builder.add_u32(NETFS_SESSION_REPLY);
+		builder.add_u32(NETFS_ERROR_OK);
+		builder.add_u64(tag);
+		builder.add_u64(0);
+		return builder;
+	}
+
+	void end_session_reply(NetFSError error)
+	{
+		auto &reply = reply_queue.back();
+		auto &builder = reply.builder;
+		if (error != NETFS_ERROR_OK)
+			builder.get_buffer().resize(NetFSSessionHeaderSize);
+
+		builder.poke_u32(sizeof(uint32_t), error);
+		builder.poke_u64(2 * sizeof(uint32_t) + sizeof(uint64_t),
+		                 builder.get_buffer().size() - NetFSSessionHeaderSize);
+		reply.writer.start(builder.get_buffer());
+	}
+
+	void session_read_range(uint64_t tag)
+	{
+		uint64_t offset = reply_builder.read_u64();
+		uint64_t size = reply_builder.read_u64();
+		auto compression = reply_builder.read_u32();
+		auto path = reply_builder.read_string_implicit_count();
+
+		auto &builder = begin_session_reply(tag);
+
+		auto range_file = notify_system.fs.open(path);
+		if (!range_file || offset > range_file->get_size())
+		{
+			end_session_reply(NETFS_ERROR_IO);
+			return;
+		}
+
+		// Clamp reads past EOF, the client sees how much it got through the decompressed size.
+		size = std::min<uint64_t>(size, range_file->get_size() - offset);
+
+		FileMappingHandle range_mapping;
+		if (size)
+		{
+			range_mapping = range_file->map_subset(offset, size);
+			if (!range_mapping)
+			{
+				end_session_reply(NETFS_ERROR_IO);
+				return;
+			}
+		}
+
+		auto compression_offset = builder.add_u32(NETFS_COMPRESSION_NONE);
+		builder.add_u64(size);
+		if (!size)
+		{
+			end_session_reply(NETFS_ERROR_OK);
+			return;
+		}
+
+		auto &buffer = builder.get_buffer();
+		size_t base = buffer.size();
+
+		if (compression == NETFS_COMPRESSION_LZ4)
+		{
+			buffer.resize(base + Util::lz4_compress_bound(size));
+			// Ranges are small, so a small match table keeps per-request setup cheap.
+			size_t compressed_size = Util::lz4_compress(buffer.data() + base, buffer.size() - base,
+			                                            range_mapping->data(), size, 12);
+
+			// Fall back to plain data if the payload does not compress.
+			if (compressed_size && compressed_size < size)
+			{
+				buffer.resize(base + compressed_size);
+				builder.poke_u32(compression_offset, NETFS_COMPRESSION_LZ4);
+				end_session_reply(NETFS_ERROR_OK);
+				return;
+			}
+
+			buffer.resize(base);
+		}
+
+		builder.add_data(range_mapping->data(), size);
+		end_session_reply(NETFS_ERROR_OK);
+	}
+
+	void session_stat(uint64_t tag)
+	{
+		auto path = reply_builder.read_string_implicit_count();
+		auto &builder = begin_session_reply(tag);
+
+		FileStat s;
+		if (!notify_system.fs.stat(path, s))
+		{
+			end_session_reply(NETFS_ERROR_IO);
+			return;
+		}
+
+		builder.add_u64(s.size);
+		switch (s.type)
+		{
+		case PathType::File:
+			builder.add_u32(NETFS_FILE_TYPE_PLAIN);
+			break;
+		case PathType::Directory:
+			builder.add_u32(NETFS_FILE_TYPE_DIRECTORY);
+			break;
+		case PathType::Special:
+			builder.add_u32(NETFS_FILE_TYPE_SPECIAL);
+			break;
+		}
+		builder.add_u64(s.last_modified);
+		end_session_reply(NETFS_ERROR_OK);
+	}
+
+	bool session_loop(Looper &looper, EventFlags flags)
+	{
+		if (flags & EVENT_OUT)
+		{
+			if (!reply_queue.empty())
+			{
+				auto ret = reply_queue.front().writer.process(*socket);
+				if (reply_queue.front().writer.complete())
+					reply_queue.pop();
+				else if (ret < 0 && ret != Socket::ErrorWouldBlock)
+					return false;
+			}
+
+			modify_looper(looper);
+		}
+
+		if (flags & EVENT_IN)
+		{
+			auto ret = command_reader.process(*socket);
+			if (command_reader.complete())
+			{
+				if (state == SessionLoop)
+				{
+					if (reply_builder.read_u32() != NETFS_SESSION_REQUEST)
+					{
+						LOGE("Got wrong frame in session loop.\n");
+						return false;
+					}
+
+					session_command = reply_builder.read_u32();
+					session_tag = reply_builder.read_u64();
+					uint64_t size = reply_builder.read_u64();
+					if (!size)
+					{
+						LOGE("Got empty session request.\n");
+						return false;
+					}
+
+					if (size > NetFSMaxRequestPayloadSize)
+					{
+						LOGE("Session request of %llu bytes is too large.\n", static_cast<unsigned long long>(size));
+						return false;
+					}
+
+					reply_builder.begin(size);
+					command_reader.start(reply_builder.get_buffer());
+					state = SessionLoopPayload;
+					return true;
+				}
+
+				switch (session_command)
+				{
+				case NETFS_READ_FILE_RANGE:
+					session_read_range(session_tag);
+					break;
+
+				case NETFS_STAT:
+					session_stat(session_tag);
+					break;
+
+				default:
+					LOGE("Unsupported session command %u.\n", session_command);
+					return false;
+				}
+
+				reply_builder.begin(NetFSSessionHeaderSize);
+				command_reader.start(reply_builder.get_buffer());
+				state = SessionLoop;
+				modify_looper(looper);
+				return true;
+			}
+
+			return (ret > 0) || (ret == Socket::ErrorWouldBlock);
+		}
+
+		return true;
+	}
+
 	bool handle(Looper &looper, EventFlags flags) override
 	{
 		if (state == ReadCommand)
@@ -639,6 +838,8 @@ struct FSHandler : LooperHandler
 			return notification_loop_register_notification(looper);
 		else if (state == NotificationLoopUnregister)
 			return notification_loop_unregister_notification(looper);
+		else if (state == SessionLoop || state == SessionLoopPayload)
+			return session_loop(looper, flags);
 		else
 			return false;
 	}
@@ -654,7 +855,9 @@ struct FSHandler : LooperHandler
 		WriteReplyData,
 		NotificationLoop,
 		NotificationLoopRegister,
-		NotificationLoopUnregister
+		NotificationLoopUnregister,
+		SessionLoop,
+		SessionLoopPayload
 	};
 
 	NotificationSystem &notify_system;
@@ -663,6 +866,8 @@ struct FSHandler : LooperHandler
 	SocketWriter command_writer;
 	ReplyBuilder reply_builder;
 	uint32_t command_id = 0;
+	uint32_t session_command = 0;
+	uint64_t session_tag = 0;
 
 	struct NotificationReply
 	{
@@ -672,8 +877,8 @@ struct FSHandler : LooperHandler
 	std::queue<NotificationReply> reply_queue;
 	std::string protocol;
 
-	unique_ptr<File> file;
-	void *mapped = nullptr;
+	FileHandle file;
+	FileMappingHandle mapping;
 
 	bool is_notify_fs = false;
 };
@@ -719,19 +924,31 @@ struct ListenerHandler : TCPListener
 	{
 		auto client = accept();
 		if (client)
-			looper.register_handler(EVENT_IN, unique_ptr<FSHandler>(new FSHandler(notify_system, move(client))));
+			looper.register_handler(EVENT_IN, std::unique_ptr<FSHandler>(new FSHandler(notify_system, std::move(client))));
 		return true;
 	}
 
 	NotificationSystem &notify_system;
 };
 
-int main()
+NetFSServer::NetFSServer(Filesystem &fs, uint16_t port)
+{
+	notify.reset(new NotificationSystem(looper, fs));
+	auto listener = std::unique_ptr<LooperHandler>(new ListenerHandler(*notify, port));
+	looper.register_handler(EVENT_IN, std::move(listener));
+}
+
+NetFSServer::~NetFSServer()
 {
-	Looper looper;
-	auto notify = unique_ptr<NotificationSystem>(new NotificationSystem(looper));
-	auto listener = unique_ptr<LooperHandler>(new ListenerHandler(*notify, 7070));
+}
 
-	looper.register_handler(EVENT_IN, move(listener));
-	while (looper.wait(-1) >= 0);
+bool NetFSServer::iterate(int timeout)
+{
+	return looper.wait_idle(timeout) >= 0;
+}
+
+void NetFSServer::kill()
+{
+	looper.kill();
+}
 }
@@ -0,0 +1,48 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "netfs_server.hpp"
+#include "filesystem.hpp"
+#include "os_filesystem.hpp"
+#include "logging.hpp"
+#include <stdlib.h>
+
+using namespace Granite;
+
+int main(int argc, char **argv)
+{
+	if (argc > 3)
+	{
+		LOGE("Usage: netfs-server [asset directory] [port]\n");
+		return EXIT_FAILURE;
+	}
+
+	Filesystem fs;
+	if (argc >= 2)
+		fs.register_protocol("assets", std::make_unique<OSFilesystem>(argv[1]));
+
+	uint16_t port = argc >= 3 ? uint16_t(strtoul(argv[2], nullptr, 0)) : NetFSDefaultPort;
+	NetFSServer server(fs, port);
+	LOGI("Serving NetFS on port %u.\n", unsigned(port));
+	while (server.iterate());
+}
@@ -75,7 +75,7 @@ Socket::Socket(int fd_, bool owned_)
 {
 }
 
-unique_ptr<Socket> Socket::connect(const char *addr, uint16_t port)
+std::unique_ptr<Socket> Socket::connect(const char *addr, uint16_t port)
 {
 #ifdef __linux__
 	SocketGlobal::get();
@@ -121,7 +121,7 @@ unique_ptr<Socket> Socket::connect(const char *addr, uint16_t port)
 		return {};
 	}
 
-	return unique_ptr<Socket>(new Socket(fd));
+	return std::unique_ptr<Socket>(new Socket(fd));
 #else
 	return {};
 #endif
@@ -47,6 +47,7 @@ TCPListener::TCPListener(uint16_t port)
 }
 #else
 #include <string>
+#include <stdexcept>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -67,7 +68,7 @@ SocketGlobal &SocketGlobal::get()
 	return global;
 }
 
-unique_ptr<Socket> TCPListener::accept()
+std::unique_ptr<Socket> TCPListener::accept()
 {
 	sockaddr_storage their;
 	socklen_t their_size = sizeof(their);
@@ -81,7 +82,7 @@ unique_ptr<Socket> TCPListener::accept()
 		return {};
 	}
 
-	return unique_ptr<Socket>(new Socket(new_fd));
+	return std::unique_ptr<Socket>(new Socket(new_fd));
 }
 
 TCPListener::TCPListener(uint16_t port)
@@ -97,7 +98,7 @@ TCPListener::TCPListener(uint16_t port)
 
 	int res = getaddrinfo(nullptr, std::to_string(port).c_str(), &hints, &servinfo);
 	if (res < 0)
-		throw runtime_error("getaddrinfo");
+		throw std::runtime_error("getaddrinfo");
 
 	int fd = -1;
 
@@ -130,15 +131,15 @@ TCPListener::TCPListener(uint16_t port)
 	freeaddrinfo(servinfo);
 
 	if (!walk)
-		throw runtime_error("bind");
+		throw std::runtime_error("bind");
 
 	if (listen(fd, 64) < 0)
 	{
 		close(fd);
-		throw runtime_error("listen");
+		throw std::runtime_error("listen");
 	}
 
-	socket = unique_ptr<Socket>(new Socket(fd));
+	socket = std::unique_ptr<Socket>(new Socket(fd));
 }
 }
 #endif
\ No newline at end of file
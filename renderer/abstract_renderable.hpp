@@ -32,6 +32,7 @@ class RenderContext;
 class ShaderSuite;
 struct RenderInfoComponent;
 struct SpriteTransformInfo;
+struct AssetID;
 
 enum class DrawPipeline : unsigned char
 {
@@ -89,6 +90,20 @@ public:
 		return DrawPipeline::Opaque;
 	}
 
+	// Assets sampled when rendering, used to drive residency from visibility. May contain invalid IDs.
+	virtual const AssetID *get_asset_dependencies(unsigned &count) const
+	{
+		count = 0;
+		return nullptr;
+	}
+
+	// Geometry assets whose residency level follows projected size, e.g. meshlet LODs. May contain invalid IDs.
+	virtual const AssetID *get_geometry_asset_dependencies(unsigned &count) const
+	{
+		count = 0;
+		return nullptr;
+	}
+
 	RenderableFlags flags = 0;
 };
 using AbstractRenderableHandle = Util::IntrusivePtr<AbstractRenderable>;
@@ -0,0 +1,259 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "asset_residency.hpp"
+#include "scene.hpp"
+#include "camera.hpp"
+#include "render_components.hpp"
+#include "abstract_renderable.hpp"
+#include "frustum.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Granite
+{
+void AssetResidencyFeedback::add_demand(AssetID id, int prio)
+{
+	if (!id)
+		return;
+
+	if (id.id >= entries.size())
+		entries.resize(id.id + 1);
+
+	auto &entry = entries[id.id];
+	if (entry.frame_prio < 0)
+		touched_ids.push_back(id.id);
+	entry.frame_prio = std::max(entry.frame_prio, prio);
+}
+
+void AssetResidencyFeedback::add_level_demand(AssetID id, int level)
+{
+	if (!id)
+		return;
+
+	// The finest level wins when an asset is drawn by multiple renderables.
+	auto &entry = entries[id.id];
+	if (entry.frame_level < 0 || level < entry.frame_level)
+		entry.frame_level = level;
+}
+
+void AssetResidencyFeedback::gather(const Scene &scene, const mat4 &projection, const mat4 &view, bool prefetch)
+{
+	Frustum frustum;
+	frustum.build_planes(inverse(projection * view));
+
+	visible.clear();
+	scene.gather_visible_opaque_renderables(frustum, visible);
+	scene.gather_visible_transparent_renderables(frustum, visible);
+
+	for (auto &info : visible)
+	{
+		unsigned count = 0;
+		unsigned geometry_count = 0;
+		auto *ids = info.renderable->get_asset_dependencies(count);
+		auto *geometry_ids = info.renderable->get_geometry_asset_dependencies(geometry_count);
+		if (!count && !geometry_count)
+			continue;
+
+		int prio = PrefetchPriority;
+		int level = -1;
+		if (!prefetch)
+		{
+			// Projected radius relative to the screen height. Unbounded renderables cover the screen.
+			float size = 1.0f;
+			if (info.transform)
+			{
+				auto &aabb = info.transform->get_aabb();
+				float radius = aabb.get_radius();
+				float depth = -(view * vec4(aabb.get_center(), 1.0f)).z;
+				if (depth > radius)
+					size = std::min(1.0f, radius * projection[1][1] / depth);
+			}
+
+			// Each bucket is one octave of projected size, so it roughly tracks which mip is needed.
+			float octaves = std::log2(std::max(size, 1.0f / 1024.0f));
+			float bucket = octaves + float(NumSizeBuckets);
+			prio = VisiblePriority + std::max(0, std::min(int(bucket), int(NumSizeBuckets) - 1));
+
+			// LOD levels halve in detail, so one level per octave of projected size.
+			level = std::max(0, int(-octaves) - int(GeometryDetailOctaves));
+		}
+
+		for (unsigned i = 0; i < count; i++)
+			add_demand(ids[i], prio);
+
+		// Prefetched geometry keeps its current target level, it is only refined once visible.
+		for (unsigned i = 0; i < geometry_count; i++)
+		{
+			add_demand(geometry_ids[i], prio);
+			if (level >= 0)
+				add_level_demand(geometry_ids[i], level);
+		}
+	}
+}
+
+void AssetResidencyFeedback::update(const Scene &scene, const Camera &camera, double frame_time)
+{
+	mat4 projection = camera.get_projection();
+	mat4 view = camera.get_view();
+	gather(scene, projection, view, false);
+
+	vec3 position = camera.get_position();
+	quat rotation = camera.get_rotation();
+
+	if (has_history && frame_time > 0.0)
+	{
+		float dt = float(frame_time);
+		quat delta = rotation * conjugate(prev_rotation);
+		if (delta.w < 0.0f)
+			delta = quat(-delta.as_vec4());
+
+		// Smooth out jitter in camera motion.
+		constexpr float Smoothing = 0.25f;
+		velocity = mix(velocity, (position - prev_position) / dt, Smoothing);
+		angular_velocity = mix(angular_velocity, quat_log(delta) / dt, Smoothing);
+	}
+
+	prev_position = position;
+	prev_rotation = rotation;
+	has_history = true;
+
+	vec3 offset = velocity * prefetch_time;
+	vec3 half_angle = angular_velocity * prefetch_time;
+
+	// Don't extrapolate rotation beyond 90 degrees, the prediction is meaningless by then.
+	float angle = length(half_angle);
+	if (angle > 0.25f * pi<float>())
+		half_angle *= 0.25f * pi<float>() / angle;
+
+	if (dot(offset, offset) > 0.0001f || angle > 0.001f)
+	{
+		quat predicted_rotation = normalize(quat_exp(half_angle) * rotation);
+		mat4 predicted_view = mat4_cast(predicted_rotation) * translate(-(position + offset));
+		gather(scene, projection, predicted_view, true);
+	}
+}
+
+void AssetResidencyFeedback::commit_level(AssetManager &manager, uint32_t id, Entry &entry)
+{
+	int target = entry.frame_level;
+	entry.frame_level = -1;
+	if (target < 0)
+		return;
+
+	// Same hysteresis as priorities. Refine immediately, only coarsen after a while.
+	int level = entry.level;
+	if (level < 0 || target < level)
+	{
+		level = target;
+		entry.last_refine_frame = frame_count;
+	}
+	else if (target > level && frame_count - entry.last_refine_frame >= HoldFrames)
+	{
+		level = target;
+		entry.last_refine_frame = frame_count;
+	}
+
+	if (level != entry.level)
+	{
+		entry.level = level;
+		manager.set_asset_residency_target_level(AssetID{id}, unsigned(level));
+	}
+}
+
+void AssetResidencyFeedback::commit(AssetManager &manager)
+{
+	for (auto id : touched_ids)
+	{
+		auto &entry = entries[id];
+		int target = entry.frame_prio;
+		entry.frame_prio = -1;
+		entry.last_seen_frame = frame_count;
+
+		if (!entry.tracked)
+		{
+			entry.tracked = true;
+			entry.prio = -1;
+			tracked_ids.push_back(id);
+		}
+
+		// Raise immediately, but only lower after a while.
+		int prio = entry.prio;
+		if (target > prio)
+		{
+			prio = target;
+			entry.last_raise_frame = frame_count;
+		}
+		else if (target < prio && frame_count - entry.last_raise_frame >= HoldFrames)
+		{
+			prio = target;
+			entry.last_raise_frame = frame_count;
+		}
+
+		if (prio != entry.prio)
+		{
+			entry.prio = prio;
+			manager.set_asset_residency_priority(AssetID{id}, prio);
+		}
+
+		commit_level(manager, id, entry);
+		manager.mark_used_asset(AssetID{id});
+	}
+	touched_ids.clear();
+
+	// Off-screen assets decay to the lowest priority which is still paged in, and eventually to 0,
+	// which makes them the first to go under memory pressure.
+	auto itr = std::remove_if(tracked_ids.begin(), tracked_ids.end(), [&](uint32_t id) -> bool {
+		auto &entry = entries[id];
+		uint32_t unseen = frame_count - entry.last_seen_frame;
+
+		int prio = entry.prio;
+		if (unseen >= EvictFrames)
+			prio = 0;
+		else if (unseen >= HoldFrames)
+			prio = std::min(prio, 1);
+
+		if (prio != entry.prio)
+		{
+			entry.prio = prio;
+			manager.set_asset_residency_priority(AssetID{id}, prio);
+		}
+
+		// Off-screen geometry only needs its coarse fallback. The asset manager clamps this to the pinned level.
+		if (entry.level >= 0 && unseen >= HoldFrames)
+		{
+			entry.level = -1;
+			manager.set_asset_residency_target_level(AssetID{id}, AssetManager::MaxResidencyLevels - 1);
+		}
+
+		if (prio == 0)
+		{
+			entry.tracked = false;
+			return true;
+		}
+		else
+			return false;
+	});
+	tracked_ids.erase(itr, tracked_ids.end());
+	frame_count++;
+}
+}
@@ -0,0 +1,106 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "asset_manager.hpp"
+#include "render_queue.hpp"
+#include "math.hpp"
+#include <vector>
+
+namespace Granite
+{
+class Scene;
+class Camera;
+
+// Turns what the camera sees, and what it is about to see, into asset residency priorities.
+// Only assets which have been seen through AbstractRenderable::get_asset_dependencies() are touched,
+// other priorities are left alone.
+// Geometry assets seen through AbstractRenderable::get_geometry_asset_dependencies() also get a target
+// residency level, so that only the LOD levels which are actually drawn get streamed in.
+class AssetResidencyFeedback
+{
+public:
+	// Gathers visible renderables for the camera, and for the camera extrapolated prefetch_time seconds ahead.
+	// Not thread safe, but may run in a task as long as it completes before commit().
+	void update(const Scene &scene, const Camera &camera, double frame_time);
+
+	// Applies priorities and marks assets as used, then advances to the next frame.
+	// Call right before AssetManager::iterate().
+	void commit(AssetManager &manager);
+
+	// Demand for assets which are not drawn through the scene, e.g. UI. Applies to the next commit().
+	void add_demand(AssetID id, int prio);
+
+	void set_prefetch_time(float seconds)
+	{
+		prefetch_time = seconds;
+	}
+
+	enum
+	{
+		// Assets about to enter view are prioritized just below anything which is visible.
+		PrefetchPriority = 2,
+		// Visible assets are bucketed above this by projected size.
+		VisiblePriority = 3,
+		NumSizeBuckets = 7,
+		// Lowered priorities only take effect after this many frames, which avoids thrashing at the frustum edge.
+		HoldFrames = 60,
+		// Off-screen for this long means the asset is among the first to be evicted.
+		EvictFrames = 600,
+		// Geometry covering this many octaves below the full screen height still wants full detail.
+		// Every further octave drops one LOD level.
+		GeometryDetailOctaves = 2
+	};
+
+private:
+	struct Entry
+	{
+		uint32_t last_seen_frame = 0;
+		uint32_t last_raise_frame = 0;
+		int prio = 0;
+		int frame_prio = -1;
+		uint32_t last_refine_frame = 0;
+		int level = -1;
+		int frame_level = -1;
+		bool tracked = false;
+	};
+
+	std::vector<Entry> entries;
+	std::vector<uint32_t> tracked_ids;
+	std::vector<uint32_t> touched_ids;
+	VisibilityList visible;
+
+	vec3 prev_position = vec3(0.0f);
+	quat prev_rotation = quat(1.0f, 0.0f, 0.0f, 0.0f);
+	vec3 velocity = vec3(0.0f);
+	vec3 angular_velocity = vec3(0.0f);
+	bool has_history = false;
+
+	uint32_t frame_count = 0;
+	float prefetch_time = 0.5f;
+
+	void gather(const Scene &scene, const mat4 &projection, const mat4 &view, bool prefetch);
+	void add_level_demand(AssetID id, int level);
+	void commit_level(AssetManager &manager, uint32_t id, Entry &entry);
+};
+}
@@ -0,0 +1,85 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "clipmap_ring.hpp"
+#include "muglm/muglm_impl.hpp"
+#include <algorithm>
+
+namespace Granite
+{
+static int wrap_tile(int v, int n)
+{
+	int r = v % n;
+	return r < 0 ? r + n : r;
+}
+
+void ClipmapRing::init(unsigned ring_, int num_tiles_)
+{
+	ring = std::max(ring_ & ~1u, 4u);
+	num_tiles = num_tiles_;
+	origin = ivec2(INT32_MIN);
+	slots.clear();
+	slots.resize(ring * ring);
+}
+
+unsigned ClipmapRing::get_slot_index(ivec2 tile) const
+{
+	return unsigned(wrap_tile(tile.y, int(ring))) * ring + unsigned(wrap_tile(tile.x, int(ring)));
+}
+
+bool ClipmapRing::contains(ivec2 tile, int margin) const
+{
+	if (origin.x == INT32_MIN)
+		return false;
+	return tile.x >= origin.x - margin && tile.y >= origin.y - margin &&
+	       tile.x < origin.x + int(ring) + margin && tile.y < origin.y + int(ring) + margin;
+}
+
+bool ClipmapRing::recenter(vec2 center, std::vector<Update> &updates)
+{
+	vec2 rounded = muglm::floor(center + vec2(0.5f));
+	ivec2 new_origin = ivec2(int(rounded.x), int(rounded.y)) - ivec2(int(ring / 2));
+	if (new_origin.x == origin.x && new_origin.y == origin.y)
+		return false;
+	origin = new_origin;
+
+	for (int z = 0; z < int(ring); z++)
+	{
+		for (int x = 0; x < int(ring); x++)
+		{
+			ivec2 coord = origin + ivec2(x, z);
+			unsigned index = get_slot_index(coord);
+			auto &slot = slots[index];
+			if (slot.tile.x == coord.x && slot.tile.y == coord.y)
+				continue;
+
+			updates.push_back({ index, slot.tile, slot.requested });
+			slot.tile = coord;
+			slot.valid = false;
+			slot.requested = coord.x >= 0 && coord.y >= 0 && coord.x < num_tiles && coord.y < num_tiles;
+		}
+	}
+
+	return true;
+}
+}
@@ -0,0 +1,105 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "math.hpp"
+#include <vector>
+
+namespace Granite
+{
+// A tile-aligned window of ring x ring tiles around the camera, for one clipmap level.
+// The window is updated toroidally: tile (x, z) always lands in slot (x mod ring, z mod ring),
+// so moving the window only touches the slots which scrolled into view.
+class ClipmapRing
+{
+public:
+	struct Slot
+	{
+		ivec2 tile = ivec2(-1);
+		// The tile is inside the world and should be streamed in.
+		bool requested = false;
+		// The tile has been copied into the slot.
+		bool valid = false;
+	};
+
+	struct Update
+	{
+		unsigned slot;
+		// What the slot held before it was reset.
+		ivec2 old_tile;
+		bool old_requested;
+	};
+
+	// ring is rounded down to an even number, and is at least 4.
+	void init(unsigned ring, int num_tiles);
+
+	// Centers the window on a position in units of tiles. Slots which now hold a different tile are reset
+	// and appended to updates. Returns false if the window did not move.
+	bool recenter(vec2 center, std::vector<Update> &updates);
+
+	bool contains(ivec2 tile, int margin = 0) const;
+	unsigned get_slot_index(ivec2 tile) const;
+
+	Slot &get_slot(ivec2 tile)
+	{
+		return slots[get_slot_index(tile)];
+	}
+
+	const Slot &get_slot(ivec2 tile) const
+	{
+		return slots[get_slot_index(tile)];
+	}
+
+	std::vector<Slot> &get_slots()
+	{
+		return slots;
+	}
+
+	const std::vector<Slot> &get_slots() const
+	{
+		return slots;
+	}
+
+	ivec2 get_origin() const
+	{
+		return origin;
+	}
+
+	unsigned get_ring_size() const
+	{
+		return ring;
+	}
+
+	int get_num_tiles() const
+	{
+		return num_tiles;
+	}
+
+private:
+	std::vector<Slot> slots;
+	ivec2 origin = ivec2(INT32_MIN);
+	unsigned ring = 0;
+	int num_tiles = 0;
+};
+}
@@ -28,6 +28,9 @@
 #include "muglm/matrix_helper.hpp"
 #include "transforms.hpp"
 #include "asset_manager.hpp"
+#include "path_utils.hpp"
+#include "string_helpers.hpp"
+#include "simd.hpp"
 
 using namespace Vulkan;
 using namespace Util;
@@ -40,6 +43,7 @@ struct PatchInstanceInfo
 	vec4 lods;
 	vec2 offsets;
 	float inner_lod;
+	float level;
 };
 
 struct PatchInfo
@@ -63,6 +67,8 @@ struct PatchInfo
 	vec2 inv_heightmap_size;
 	vec2 tiling_factor;
 	vec2 tangent_scale;
+	vec2 inv_clipmap_size;
+	bool clipmap;
 };
 
 struct GroundVertex
@@ -78,13 +84,14 @@ struct GroundData
 	vec2 uv_tiling_scale;
 	vec2 tangent_scale;
 	vec4 texture_info;
+	vec2 inv_clipmap_size;
 };
 
 struct PatchData
 {
     vec2 Offset;
 	float InnerLOD;
-	float Padding;
+	float Level;
     vec4 LODs;
 };
 
@@ -104,10 +111,19 @@ static void ground_patch_render(Vulkan::CommandBuffer &cmd, const RenderQueueDat
 	cmd.set_vertex_attrib(0, 0, VK_FORMAT_R8G8B8A8_UINT, offsetof(GroundVertex, pos));
 	cmd.set_vertex_attrib(1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(GroundVertex, weights));
 
-	cmd.set_texture(2, 0, *patch.heights, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
-	cmd.set_texture(2, 1, *patch.normals, cmd.get_device().get_stock_sampler(StockSampler::TrilinearClamp));
-	cmd.set_texture(2, 2, *patch.occlusion, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
-	cmd.set_texture(2, 3, *patch.lod_map, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
+	if (patch.clipmap)
+	{
+		// Rings are updated toroidally, so sampling has to wrap around.
+		cmd.set_texture(2, 0, *patch.heights, cmd.get_device().get_stock_sampler(StockSampler::LinearWrap));
+		cmd.set_texture(2, 1, *patch.normals, cmd.get_device().get_stock_sampler(StockSampler::LinearWrap));
+	}
+	else
+	{
+		cmd.set_texture(2, 0, *patch.heights, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
+		cmd.set_texture(2, 1, *patch.normals, cmd.get_device().get_stock_sampler(StockSampler::TrilinearClamp));
+		cmd.set_texture(2, 2, *patch.occlusion, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
+		cmd.set_texture(2, 3, *patch.lod_map, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
+	}
 	cmd.set_texture(2, 4, *patch.base_color, cmd.get_device().get_stock_sampler(StockSampler::TrilinearWrap));
 	cmd.set_texture(2, 5, *patch.type_map, cmd.get_device().get_stock_sampler(StockSampler::LinearClamp));
 	cmd.set_texture(2, 6, *patch.normals_fine, cmd.get_device().get_stock_sampler(StockSampler::TrilinearWrap));
@@ -121,6 +137,7 @@ static void ground_patch_render(Vulkan::CommandBuffer &cmd, const RenderQueueDat
 	data->texture_info.y = float(patch.base_color->get_image().get_height(0));
 	data->texture_info.z = 1.0f / float(patch.base_color->get_image().get_width(0));
 	data->texture_info.w = 1.0f / float(patch.base_color->get_image().get_height(0));
+	data->inv_clipmap_size = patch.inv_clipmap_size;
 
 	cmd.push_constants(patch.push, 0, sizeof(patch.push));
 
@@ -134,6 +151,7 @@ static void ground_patch_render(Vulkan::CommandBuffer &cmd, const RenderQueueDat
 			auto &patch_info = *static_cast<const PatchInstanceInfo *>(infos[i + j].instance_data);
 			patches->LODs = patch_info.lods;
 			patches->InnerLOD = patch_info.inner_lod;
+			patches->Level = patch_info.level;
 			patches->Offset = patch_info.offsets;
 			patches++;
 		}
@@ -178,14 +196,20 @@ Ground::Ground(unsigned size_, const TerrainInfo &info_)
 	: size(size_), info(info_)
 {
 	assert(size % info.base_patch_size == 0);
-	num_patches_x = size / info.base_patch_size;
-	num_patches_z = size / info.base_patch_size;
-	patch_lods.resize(num_patches_x * num_patches_z);
-
-	heights = GRANITE_ASSET_MANAGER()->register_asset(*GRANITE_FILESYSTEM(), info.heightmap, AssetClass::ImageZeroable);
-	normals = GRANITE_ASSET_MANAGER()->register_asset(*GRANITE_FILESYSTEM(), info.normalmap, AssetClass::ImageNormal);
-	occlusion = GRANITE_ASSET_MANAGER()->register_asset(*GRANITE_FILESYSTEM(), info.occlusionmap,
-	                                                    AssetClass::ImageZeroable);
+
+	// Clipmaps select their own patches and stream heights and normals per tile.
+	if (!is_clipmap())
+	{
+		num_patches_x = size / info.base_patch_size;
+		num_patches_z = size / info.base_patch_size;
+		patch_lods.resize(num_patches_x * num_patches_z);
+
+		heights = GRANITE_ASSET_MANAGER()->register_asset(*GRANITE_FILESYSTEM(), info.heightmap, AssetClass::ImageZeroable);
+		normals = GRANITE_ASSET_MANAGER()->register_asset(*GRANITE_FILESYSTEM(), info.normalmap, AssetClass::ImageNormal);
+		occlusion = GRANITE_ASSET_MANAGER()->register_asset(*GRANITE_FILESYSTEM(), info.occlusionmap,
+		                                                    AssetClass::ImageZeroable);
+	}
+
 	normals_fine = GRANITE_ASSET_MANAGER()->register_asset(*GRANITE_FILESYSTEM(), info.normalmap_fine,
 	                                                       AssetClass::ImageNormal);
 	base_color = GRANITE_ASSET_MANAGER()->register_asset(*GRANITE_FILESYSTEM(), info.base_color, AssetClass::ImageColor);
@@ -199,6 +223,8 @@ void Ground::on_device_created(const DeviceCreatedEvent &created)
 	auto &device = created.get_device();
 
 	build_buffers(device);
+	if (is_clipmap())
+		return;
 
 	ImageCreateInfo image_info = {};
 	image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
@@ -318,6 +344,7 @@ void Ground::get_render_info(const RenderContext &context, const RenderInfoCompo
 		*ground_patch.pz->lod);
 	instance_data->inner_lod = *ground_patch.lod;
 	instance_data->lods = max(vec4(instance_data->inner_lod), instance_data->lods);
+	instance_data->level = 0.0f;
 	instance_data->offsets = ground_patch.offset * vec2(size);
 
 	int base_lod = int(instance_data->inner_lod);
@@ -341,6 +368,8 @@ void Ground::get_render_info(const RenderContext &context, const RenderInfoCompo
 	patch.lod_map = &lod_map->get_view();
 	patch.inv_heightmap_size = vec2(1.0f / size);
 	patch.tiling_factor = tiling_factor;
+	patch.inv_clipmap_size = vec2(0.0f);
+	patch.clipmap = false;
 
 	Util::Hasher hasher;
 	hasher.string("ground");
@@ -361,7 +390,7 @@ void Ground::get_render_info(const RenderContext &context, const RenderInfoCompo
 
 	// Allow promotion to push constant for transforms.
 	// We'll instance a lot of patches belonging to the same ground.
-	hasher.pointer(&transform->get_world_transform());
+	hasher.pointer(&transform->get_affine_world_transform());
 
 	auto instance_key = hasher.get();
 
@@ -387,6 +416,9 @@ void Ground::get_render_info(const RenderContext &context, const RenderInfoCompo
 
 void Ground::refresh(const RenderContext &context, TaskComposer &)
 {
+	if (!lod_map)
+		return;
+
 	auto &device = context.get_device();
 	auto cmd = device.request_command_buffer();
 
@@ -408,6 +440,556 @@ void Ground::refresh(const RenderContext &context, TaskComposer &)
 	device.submit(cmd);
 }
 
+static uint64_t clipmap_tile_key(unsigned level, ivec2 tile)
+{
+	return (uint64_t(level) << 56) | (uint64_t(uint32_t(tile.y)) << 28) | uint64_t(uint32_t(tile.x));
+}
+
+GroundClipmap::GroundClipmap(Util::IntrusivePtr<Ground> ground_)
+	: ground(std::move(ground_))
+{
+	auto &info = ground->get_info();
+	tile_size = info.tile_size;
+	ring = std::max(info.clipmap_ring_tiles & ~1u, 4u);
+	aabb = AABB(vec3(0.0f, -1.01f, 0.0f), vec3(1.0f, 1.01f, 1.0f));
+
+	if (tile_size == 0 || tile_size % info.base_patch_size != 0)
+	{
+		LOGE("Clipmap tile size %u is not a multiple of patch size %u.\n", tile_size, info.base_patch_size);
+		return;
+	}
+
+	auto &fs = *GRANITE_FILESYSTEM();
+	for (unsigned level = 0; level < info.clipmap_levels; level++)
+	{
+		unsigned level_size = ground->get_size() >> level;
+		if (level_size < tile_size || level_size % tile_size != 0)
+			break;
+
+		Level l;
+		l.num_tiles = int(level_size / tile_size);
+		l.heights_file = fs.open(Path::join(info.tile_directory, Util::join("heights_L", level, ".tiles")));
+		l.normals_file = fs.open(Path::join(info.tile_directory, Util::join("normals_L", level, ".tiles")));
+		if (!l.heights_file || !l.normals_file)
+		{
+			LOGE("Failed to open clipmap tiles for level %u in %s.\n", level, info.tile_directory.c_str());
+			break;
+		}
+
+		// Tile files are a row-major array of equally sized GTX files.
+		uint64_t count = uint64_t(l.num_tiles) * uint64_t(l.num_tiles);
+		l.heights_stride = l.heights_file->get_size() / count;
+		l.normals_stride = l.normals_file->get_size() / count;
+		if (l.heights_stride == 0 || l.normals_stride == 0 ||
+		    l.heights_stride * count != l.heights_file->get_size() ||
+		    l.normals_stride * count != l.normals_file->get_size())
+		{
+			LOGE("Clipmap tiles for level %u do not match %u x %u tiles.\n", level, l.num_tiles, l.num_tiles);
+			break;
+		}
+
+		l.ring.init(ring, l.num_tiles);
+		levels.push_back(std::move(l));
+	}
+
+	if (levels.empty())
+		LOGE("No usable clipmap levels in %s.\n", info.tile_directory.c_str());
+
+	EVENT_MANAGER_REGISTER_LATCH(GroundClipmap, on_device_created, on_device_destroyed, DeviceCreatedEvent);
+}
+
+GroundClipmap::~GroundClipmap()
+{
+	// Tile IDs are only meaningful to us, so give them back.
+	if (auto *manager = GRANITE_ASSET_MANAGER())
+	{
+		for (auto &tile : tiles)
+		{
+			manager->unregister_asset(tile.second.heights);
+			manager->unregister_asset(tile.second.normals);
+		}
+	}
+}
+
+void GroundClipmap::on_device_created(const DeviceCreatedEvent &created)
+{
+	auto &device = created.get_device();
+	if (levels.empty())
+		return;
+
+	if (!device.image_format_is_supported(VK_FORMAT_R16_SFLOAT, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) ||
+	    !device.image_format_is_supported(VK_FORMAT_R8G8_UNORM, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT))
+	{
+		LOGE("Clipmap formats are not supported as storage images.\n");
+		return;
+	}
+
+	unsigned dim = ring * tile_size;
+	auto image_info = ImageCreateInfo::immutable_2d_image(dim, dim, VK_FORMAT_R16_SFLOAT);
+	image_info.layers = unsigned(levels.size());
+	image_info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+	image_info.misc = IMAGE_MISC_FORCE_ARRAY_BIT;
+	image_info.initial_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	heights = device.create_image(image_info, nullptr);
+	device.set_name(*heights, "ground-clipmap-heights");
+
+	image_info.format = VK_FORMAT_R8G8_UNORM;
+	normals = device.create_image(image_info, nullptr);
+	device.set_name(*normals, "ground-clipmap-normals");
+}
+
+void GroundClipmap::on_device_destroyed(const DeviceCreatedEvent &)
+{
+	heights.reset();
+	normals.reset();
+	nodes.clear();
+	selected.clear();
+
+	// Ring contents are lost, so every tile in the windows has to be streamed in again.
+	auto &manager = *GRANITE_ASSET_MANAGER();
+	for (unsigned level = 0; level < levels.size(); level++)
+	{
+		for (auto &slot : levels[level].ring.get_slots())
+		{
+			if (slot.requested)
+			{
+				auto &tile = get_tile(level, slot.tile);
+				manager.set_asset_residency_priority(tile.heights, 1 + int(level));
+				manager.set_asset_residency_priority(tile.normals, 1 + int(level));
+			}
+			slot.valid = false;
+		}
+	}
+}
+
+GroundClipmap::Tile &GroundClipmap::get_tile(unsigned level, ivec2 coord)
+{
+	auto &tile = tiles[clipmap_tile_key(level, coord)];
+	if (!tile.heights)
+	{
+		// Tiles are registered lazily as the windows first reach them, and start out non-resident.
+		auto &l = levels[level];
+		uint64_t index = uint64_t(coord.y) * uint64_t(l.num_tiles) + uint64_t(coord.x);
+		auto *manager = GRANITE_ASSET_MANAGER();
+		tile.coord = coord;
+		tile.level = level;
+		tile.heights = manager->register_asset(
+				Util::make_handle<FileSlice>(l.heights_file, index * l.heights_stride, l.heights_stride),
+				AssetClass::ImageZeroable, 0);
+		tile.normals = manager->register_asset(
+				Util::make_handle<FileSlice>(l.normals_file, index * l.normals_stride, l.normals_stride),
+				AssetClass::ImageNormal, 0);
+	}
+	return tile;
+}
+
+void GroundClipmap::retire_tiles(unsigned level)
+{
+	// Tiles which scrolled out of the window stay registered for a while, so they remain cached
+	// if the camera turns back. Beyond that, they are unregistered so the number of asset IDs stays bounded.
+	auto &ring_window = levels[level].ring;
+	int margin = int(ring / 2);
+	auto &manager = *GRANITE_ASSET_MANAGER();
+
+	for (auto itr = tiles.begin(); itr != tiles.end(); )
+	{
+		auto &tile = itr->second;
+		if (tile.level == level && !ring_window.contains(tile.coord, margin))
+		{
+			manager.unregister_asset(tile.heights);
+			manager.unregister_asset(tile.normals);
+			itr = tiles.erase(itr);
+		}
+		else
+			++itr;
+	}
+}
+
+void GroundClipmap::update_window(unsigned level, vec2 camera_texel)
+{
+	auto &l = levels[level];
+	window_updates.clear();
+	if (!l.ring.recenter(camera_texel / float(tile_size << level), window_updates))
+		return;
+
+	// Coarse levels cover the most ground, so they are paged in first.
+	auto &manager = *GRANITE_ASSET_MANAGER();
+	int prio = 1 + int(level);
+
+	for (auto &update : window_updates)
+	{
+		if (update.old_requested)
+		{
+			auto &old_tile = get_tile(level, update.old_tile);
+			manager.set_asset_residency_priority(old_tile.heights, 0);
+			manager.set_asset_residency_priority(old_tile.normals, 0);
+		}
+
+		auto &slot = l.ring.get_slots()[update.slot];
+		if (slot.requested)
+		{
+			auto &tile = get_tile(level, slot.tile);
+			manager.set_asset_residency_priority(tile.heights, prio);
+			manager.set_asset_residency_priority(tile.normals, prio);
+		}
+	}
+
+	retire_tiles(level);
+}
+
+void GroundClipmap::stream_tiles(Device &device)
+{
+	// Bounds the per-frame update cost when the camera teleports.
+	constexpr unsigned MaxTileUpdatesPerFrame = 16;
+
+	auto &manager = *GRANITE_ASSET_MANAGER();
+	auto &res = device.get_resource_manager();
+	CommandBufferHandle cmd;
+	unsigned updates = 0;
+
+	struct Registers
+	{
+		ivec2 slot_offset;
+		int32_t layer;
+		int32_t tile_size;
+	} push = {};
+	push.tile_size = int32_t(tile_size);
+
+	for (unsigned level = unsigned(levels.size()); level && updates < MaxTileUpdatesPerFrame; level--)
+	{
+		auto &slots = levels[level - 1].ring.get_slots();
+		for (unsigned index = 0; index < slots.size(); index++)
+		{
+			auto &slot = slots[index];
+			if (!slot.requested || slot.valid)
+				continue;
+
+			auto &tile = get_tile(level - 1, slot.tile);
+			if (!res.is_image_resident(tile.heights) || !res.is_image_resident(tile.normals))
+				continue;
+
+			auto *height_view = res.get_image_view(tile.heights);
+			auto *normal_view = res.get_image_view(tile.normals);
+
+			// Once a tile is copied into its ring, it is no longer needed by us and may be evicted.
+			manager.set_asset_residency_priority(tile.heights, 0);
+			manager.set_asset_residency_priority(tile.normals, 0);
+
+			if (height_view->get_image().get_width() != tile_size ||
+			    height_view->get_image().get_height() != tile_size ||
+			    normal_view->get_image().get_width() != tile_size ||
+			    normal_view->get_image().get_height() != tile_size)
+			{
+				LOGE("Clipmap tile (%d, %d) in level %u is not %u x %u.\n",
+				     slot.tile.x, slot.tile.y, level - 1, tile_size, tile_size);
+				slot.requested = false;
+				continue;
+			}
+
+			if (!cmd)
+			{
+				cmd = device.request_command_buffer();
+				cmd->image_barrier(*heights, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+				                   VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, 0,
+				                   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+				cmd->image_barrier(*normals, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+				                   VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, 0,
+				                   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+				cmd->set_program("builtin://shaders/ground_clipmap_update.comp");
+				cmd->set_storage_texture(0, 2, heights->get_view());
+				cmd->set_storage_texture(0, 3, normals->get_view());
+			}
+
+			cmd->set_texture(0, 0, *height_view, StockSampler::NearestClamp);
+			cmd->set_texture(0, 1, *normal_view, StockSampler::NearestClamp);
+			push.slot_offset = ivec2(int(index % ring), int(index / ring)) * ivec2(int(tile_size));
+			push.layer = int32_t(level - 1);
+			cmd->push_constants(&push, 0, sizeof(push));
+			cmd->dispatch((tile_size + 7) / 8, (tile_size + 7) / 8, 1);
+
+			slot.valid = true;
+			if (++updates == MaxTileUpdatesPerFrame)
+				break;
+		}
+	}
+
+	if (cmd)
+	{
+		cmd->image_barrier(*heights, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		                   VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+		                   VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+		cmd->image_barrier(*normals, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		                   VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+		device.submit(cmd);
+	}
+}
+
+bool GroundClipmap::node_is_renderable(ivec2 offset, unsigned level) const
+{
+	// Every tile the node's vertices sample from must be in the window and streamed in.
+	// Vertices on the far edge of the node sample the first texel of the next tile.
+	auto &l = levels[level];
+	int tile_span = int(tile_size << level);
+	int span = int(ground->get_info().base_patch_size << level);
+	int last_texel = int(ground->get_size()) - (1 << level);
+
+	ivec2 lo = ivec2(offset.x / tile_span, offset.y / tile_span);
+	ivec2 hi = ivec2(std::min(offset.x + span, last_texel) / tile_span,
+	                 std::min(offset.y + span, last_texel) / tile_span);
+
+	for (int z = lo.y; z <= hi.y; z++)
+	{
+		for (int x = lo.x; x <= hi.x; x++)
+		{
+			if (!l.ring.contains(ivec2(x, z)))
+				return false;
+
+			auto &slot = l.ring.get_slot(ivec2(x, z));
+			if (!slot.valid || slot.tile.x != x || slot.tile.y != z)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+void GroundClipmap::subdivide(unsigned index, vec2 camera_texel)
+{
+	auto node = nodes[index];
+	if (node.level == 0)
+		return;
+
+	auto &info = ground->get_info();
+	int span = int(info.base_patch_size << node.level);
+	vec2 lo = vec2(node.offset);
+	vec2 hi = lo + vec2(float(span));
+	vec2 dist = max(max(lo - camera_texel, camera_texel - hi), vec2(0.0f));
+	if (length(dist) > float(span) * muglm::exp2(1.0f - info.lod_bias))
+		return;
+
+	// Only refine when all children can be drawn, so the selection never has holes.
+	unsigned child_level = node.level - 1;
+	int half_span = span >> 1;
+	const ivec2 children[4] = {
+		node.offset,
+		node.offset + ivec2(half_span, 0),
+		node.offset + ivec2(0, half_span),
+		node.offset + ivec2(half_span, half_span),
+	};
+
+	for (auto &child : children)
+		if (!node_is_renderable(child, child_level))
+			return;
+
+	unsigned first_child = unsigned(nodes.size());
+	nodes[index].first_child = int(first_child);
+	for (auto &child : children)
+		nodes.push_back({ child, child_level, -1, true });
+	for (unsigned i = 0; i < 4; i++)
+		subdivide(first_child + i, camera_texel);
+}
+
+int GroundClipmap::lookup_level(ivec2 texel) const
+{
+	unsigned top = unsigned(levels.size() - 1);
+	int root_span = int(ground->get_info().base_patch_size << top);
+	ivec2 rel = texel - root_offset;
+	if (rel.x < 0 || rel.y < 0)
+		return -1;
+
+	ivec2 root = ivec2(rel.x / root_span, rel.y / root_span);
+	if (root.x >= num_roots.x || root.y >= num_roots.y)
+		return -1;
+
+	unsigned index = root.y * num_roots.x + root.x;
+	while (nodes[index].first_child >= 0)
+	{
+		auto &node = nodes[index];
+		int half_span = int(ground->get_info().base_patch_size << (node.level - 1));
+		index = unsigned(node.first_child);
+		if (texel.x >= node.offset.x + half_span)
+			index += 1;
+		if (texel.y >= node.offset.y + half_span)
+			index += 2;
+	}
+
+	return nodes[index].renderable ? int(nodes[index].level) : -1;
+}
+
+void GroundClipmap::select_patches(vec2 camera_texel)
+{
+	nodes.clear();
+	selected.clear();
+	num_roots = ivec2(0);
+
+	// Roots tile the coarsest window, clipped to the world.
+	unsigned top = unsigned(levels.size() - 1);
+	auto &l = levels[top];
+	int base_patch_size = int(ground->get_info().base_patch_size);
+	int root_span = base_patch_size << top;
+	int tile_span = int(tile_size << top);
+	int world_size = int(ground->get_size());
+
+	ivec2 origin = l.ring.get_origin();
+	ivec2 lo = ivec2(std::max(origin.x * tile_span, 0), std::max(origin.y * tile_span, 0));
+	ivec2 hi = ivec2(std::min((origin.x + int(ring)) * tile_span, world_size),
+	                 std::min((origin.y + int(ring)) * tile_span, world_size));
+	if (hi.x <= lo.x || hi.y <= lo.y)
+		return;
+
+	root_offset = lo;
+	num_roots = ivec2((hi.x - lo.x) / root_span, (hi.y - lo.y) / root_span);
+
+	for (int z = 0; z < num_roots.y; z++)
+	{
+		for (int x = 0; x < num_roots.x; x++)
+		{
+			ivec2 offset = lo + ivec2(x, z) * ivec2(root_span);
+			nodes.push_back({ offset, top, -1, node_is_renderable(offset, top) });
+		}
+	}
+
+	unsigned num_root_nodes = unsigned(nodes.size());
+	for (unsigned i = 0; i < num_root_nodes; i++)
+		if (nodes[i].renderable)
+			subdivide(i, camera_texel);
+
+	// Leaves are drawn. Edges facing a coarser neighbor snap to its vertex spacing to avoid cracks.
+	for (auto &node : nodes)
+	{
+		if (!node.renderable || node.first_child >= 0)
+			continue;
+
+		int span = base_patch_size << node.level;
+		int half_span = span >> 1;
+		vec4 neighbors = vec4(
+				float(lookup_level(node.offset + ivec2(-1, half_span))),
+				float(lookup_level(node.offset + ivec2(span, half_span))),
+				float(lookup_level(node.offset + ivec2(half_span, -1))),
+				float(lookup_level(node.offset + ivec2(half_span, span))));
+
+		SelectedPatch patch;
+		patch.offset = vec2(node.offset);
+		patch.level = float(node.level);
+		patch.lods = max(neighbors - vec4(patch.level), vec4(0.0f));
+		selected.push_back(patch);
+	}
+}
+
+void GroundClipmap::refresh(const RenderContext &context, const RenderInfoComponent *transform, TaskComposer &)
+{
+	if (!heights || !normals)
+		return;
+
+	vec3 camera_pos = context.get_render_parameters().camera_position;
+	vec4 local = inverse(transform->get_world_transform()) * vec4(camera_pos, 1.0f);
+	vec2 camera_texel = vec2(local.x, local.z) * float(ground->get_size());
+
+	for (unsigned level = 0; level < levels.size(); level++)
+		update_window(level, camera_texel);
+	stream_tiles(context.get_device());
+	select_patches(camera_texel);
+}
+
+void GroundClipmap::get_render_info(const RenderContext &context, const RenderInfoComponent *transform,
+                                    RenderQueue &queue) const
+{
+	if (selected.empty())
+		return;
+
+	auto &info = ground->get_info();
+	float inv_size = 1.0f / float(ground->get_size());
+	auto &res = queue.get_resource_manager();
+
+	PatchInfo patch;
+	patch.push[0] = transform->get_world_transform();
+
+	// terrain-tiler writes slopes relative to the level 0 texel spacing for every level.
+	mat4 normal_transform;
+	compute_normal_transform(normal_transform, transform->get_world_transform());
+	patch.push[1] = normal_transform * scale(vec3(float(ground->get_size()), 1.0f, float(ground->get_size())));
+	patch.tangent_scale = vec2(1.0f / 10.0f);
+
+	// Every patch is a full resolution grid, scaled by its level.
+	auto &lod = ground->quad_lod.front();
+	patch.vbo = lod.vbo.get();
+	patch.ibo = lod.ibo.get();
+	patch.count = lod.count;
+
+	patch.heights = &heights->get_view();
+	patch.normals = &normals->get_view();
+	patch.occlusion = nullptr;
+	patch.lod_map = nullptr;
+	patch.normals_fine = res.get_image_view(ground->normals_fine);
+	patch.base_color = res.get_image_view(ground->base_color);
+	patch.type_map = res.get_image_view(ground->type_map);
+	patch.inv_heightmap_size = vec2(inv_size);
+	patch.tiling_factor = ground->tiling_factor;
+	patch.inv_clipmap_size = vec2(1.0f / float(ring * tile_size));
+	patch.clipmap = true;
+
+	Util::Hasher hasher;
+	hasher.string("ground");
+	auto pipe_hash = hasher.get();
+	hasher.s32(0);
+	hasher.s32(info.bandlimited_pixel);
+	hasher.s32(1);
+	auto state_hash = hasher.get();
+
+	hasher.u64(heights->get_cookie());
+	hasher.u64(normals->get_cookie());
+	hasher.u64(patch.normals_fine->get_cookie());
+	hasher.u64(patch.base_color->get_cookie());
+	hasher.u64(patch.type_map->get_cookie());
+	hasher.pointer(&transform->get_affine_world_transform());
+	auto instance_key = hasher.get();
+
+	Program *program = nullptr;
+	for (auto &s : selected)
+	{
+		float span = float(info.base_patch_size << unsigned(s.level)) * inv_size;
+		vec2 lo = s.offset * inv_size;
+		alignas(16) AABB local_aabb(vec3(lo.x, -1.01f, lo.y), vec3(lo.x + span, 1.01f, lo.y + span));
+		alignas(16) AABB world_aabb;
+		SIMD::transform_aabb(world_aabb, local_aabb, transform->get_affine_world_transform());
+		if (!SIMD::frustum_cull(world_aabb, context.get_visibility_frustum().get_planes()))
+			continue;
+
+		auto *instance_data = queue.allocate_one<PatchInstanceInfo>();
+		instance_data->lods = s.lods;
+		instance_data->inner_lod = 0.0f;
+		instance_data->offsets = s.offset;
+		instance_data->level = s.level;
+
+		auto sorting_key = RenderInfo::get_sort_key(context, Queue::Opaque, pipe_hash, state_hash,
+		                                            world_aabb.get_center(), StaticLayer::Last);
+		auto *patch_data = queue.push<PatchInfo>(Queue::Opaque, instance_key, sorting_key,
+		                                         RenderFunctions::ground_patch_render,
+		                                         instance_data);
+
+		if (patch_data)
+		{
+			if (!program)
+			{
+				uint32_t flags = 1u << 1;
+				if (info.bandlimited_pixel)
+					flags |= 1u << 0;
+
+				program = queue.get_shader_suites()[ecast(RenderableType::Ground)].get_program(
+						VariantSignatureKey::build(DrawPipeline::Opaque,
+						                           MESH_ATTRIBUTE_POSITION_BIT,
+						                           MATERIAL_TEXTURE_BASE_COLOR_BIT,
+						                           flags));
+			}
+
+			patch.program = program;
+			*patch_data = patch;
+		}
+	}
+}
+
 Ground::Handles Ground::add_to_scene(Scene &scene, unsigned size, float tiling_factor, const TerrainInfo &info)
 {
 	Handles handles;
@@ -429,6 +1011,16 @@ Ground::Handles Ground::add_to_scene(Scene &scene, unsigned size, float tiling_f
 
 	handles.ground = ground.get();
 
+	if (ground->is_clipmap())
+	{
+		auto clipmap = make_handle<GroundClipmap>(ground);
+		auto *clipmap_entity = scene.create_renderable(clipmap, handles.node.get());
+		clipmap_entity->free_component<CastsStaticShadowComponent>();
+		auto *transforms = clipmap_entity->allocate_component<PerFrameUpdateTransformComponent>();
+		transforms->refresh = clipmap.get();
+		return handles;
+	}
+
 	vec2 inv_patches = vec2(1.0f / ground->get_num_patches_x(), 1.0f / ground->get_num_patches_z());
 
 	std::vector<GroundPatch *> patches;
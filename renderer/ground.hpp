@@ -25,6 +25,9 @@
 #include "abstract_renderable.hpp"
 #include "scene.hpp"
 #include "application_wsi_events.hpp"
+#include "asset_manager.hpp"
+#include "clipmap_ring.hpp"
+#include <unordered_map>
 
 namespace Granite
 {
@@ -98,6 +101,13 @@ public:
 		std::vector<float> patch_lod_bias;
 		std::vector<vec2> patch_range;
 		bool bandlimited_pixel = false;
+
+		// Clipmap mode. If tile_directory is set, heights and normals are streamed from the tile pyramid
+		// written by terrain-tiler, and heightmap, normalmap and occlusionmap are ignored.
+		std::string tile_directory;
+		unsigned tile_size = 256;
+		unsigned clipmap_levels = 4;
+		unsigned clipmap_ring_tiles = 4;
 	};
 	Ground(unsigned size, const TerrainInfo &info);
 
@@ -143,7 +153,18 @@ public:
 		return info;
 	}
 
+	bool is_clipmap() const
+	{
+		return !info.tile_directory.empty();
+	}
+
+	unsigned get_size() const
+	{
+		return size;
+	}
+
 private:
+	friend class GroundClipmap;
 	unsigned size;
 	TerrainInfo info;
 
@@ -171,4 +192,94 @@ private:
 
 	vec2 tiling_factor = vec2(1.0f);
 };
+
+// Streams the terrain as a stack of toroidally updated rings, one per level, where level L has
+// a texel spacing of 2^L heightmap texels. Patches are selected from a quadtree over the rings every frame,
+// so neither memory nor CPU cost depends on the size of the world.
+// Terrain outside the coarsest ring is not rendered.
+class GroundClipmap : public AbstractRenderable, public PerFrameRefreshableTransform, public EventHandler
+{
+public:
+	explicit GroundClipmap(Util::IntrusivePtr<Ground> ground);
+	~GroundClipmap();
+
+	unsigned get_num_levels() const
+	{
+		return unsigned(levels.size());
+	}
+
+private:
+	Util::IntrusivePtr<Ground> ground;
+	AABB aabb;
+
+	unsigned tile_size = 0;
+	unsigned ring = 0;
+
+	struct Tile
+	{
+		AssetID heights;
+		AssetID normals;
+		ivec2 coord;
+		unsigned level;
+	};
+
+	struct Level
+	{
+		FileHandle heights_file;
+		FileHandle normals_file;
+		uint64_t heights_stride = 0;
+		uint64_t normals_stride = 0;
+		int num_tiles = 0;
+		ClipmapRing ring;
+	};
+	std::vector<Level> levels;
+	std::unordered_map<uint64_t, Tile> tiles;
+	std::vector<ClipmapRing::Update> window_updates;
+
+	Vulkan::ImageHandle heights;
+	Vulkan::ImageHandle normals;
+	void on_device_created(const Vulkan::DeviceCreatedEvent &e);
+	void on_device_destroyed(const Vulkan::DeviceCreatedEvent &e);
+
+	struct QuadNode
+	{
+		ivec2 offset;
+		unsigned level;
+		int first_child;
+		bool renderable;
+	};
+	std::vector<QuadNode> nodes;
+	ivec2 root_offset = ivec2(0);
+	ivec2 num_roots = ivec2(0);
+
+	struct SelectedPatch
+	{
+		vec2 offset;
+		float level;
+		vec4 lods;
+	};
+	std::vector<SelectedPatch> selected;
+
+	Tile &get_tile(unsigned level, ivec2 tile);
+	void retire_tiles(unsigned level);
+	void update_window(unsigned level, vec2 camera_texel);
+	void stream_tiles(Vulkan::Device &device);
+	bool node_is_renderable(ivec2 offset, unsigned level) const;
+	void subdivide(unsigned index, vec2 camera_texel);
+	int lookup_level(ivec2 texel) const;
+	void select_patches(vec2 camera_texel);
+
+	bool has_static_aabb() const override
+	{
+		return true;
+	}
+
+	const AABB *get_static_aabb() const override
+	{
+		return &aabb;
+	}
+
+	void get_render_info(const RenderContext &context, const RenderInfoComponent *transform, RenderQueue &queue) const override;
+	void refresh(const RenderContext &context, const RenderInfoComponent *transform, TaskComposer &composer) override;
+};
 }
@@ -66,8 +66,8 @@ struct MeshAttributeLayout
 
 struct StaticMeshVertex
 {
-	mat4 Model;
-	mat4 *PrevModel = nullptr;
+	mat_affine Model;
+	mat_affine *PrevModel = nullptr;
 	//mat4 Normal;
 	enum
 	{
@@ -104,8 +104,8 @@ struct StaticMeshInstanceInfo
 
 struct SkinnedMeshInstanceInfo
 {
-	mat4 *world_transforms = nullptr;
-	mat4 *prev_world_transforms = nullptr;
+	mat_affine *world_transforms = nullptr;
+	mat_affine *prev_world_transforms = nullptr;
 	//mat4 *normal_transforms = nullptr;
 	uint32_t num_bones = 0;
 };
@@ -178,6 +178,12 @@ struct StaticMesh : AbstractRenderable
 		return material.get_info().pipeline;
 	}
 
+	const AssetID *get_asset_dependencies(unsigned &num_assets) const override
+	{
+		num_assets = Util::ecast(TextureKind::Count);
+		return material.textures;
+	}
+
 	void bake();
 
 protected:
@@ -200,6 +200,12 @@ public:
 	void get_render_info(const RenderContext &context, const RenderInfoComponent *transform,
 	                     RenderQueue &queue) const override;
 
+	const AssetID *get_asset_dependencies(unsigned &count) const override
+	{
+		count = 1;
+		return &texture;
+	}
+
 	void set_color_mod(const vec3 &color_)
 	{
 		color = color_;
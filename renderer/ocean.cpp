@@ -29,12 +29,11 @@
 #include "muglm/matrix_helper.hpp"
 #include "timer.hpp"
 #include "post/spd.hpp"
-#include <random>
 
 namespace Granite
 {
 static constexpr unsigned MaxLODIndirect = 8;
-static constexpr float G = 9.81f;
+using namespace OceanSpectrum;
 
 struct OceanVertex
 {
@@ -50,12 +49,11 @@ Ocean::Ocean(const OceanConfig &config_, NodeHandle node_)
 
 	wind_direction = normalize(config.wind_velocity);
 	phillips_L = dot(config.wind_velocity, config.wind_velocity) / G;
+	config.amplitude = normalized_amplitude(config);
 
-	// Normalize amplitude based on how dense the FFT frequency space is.
-	vec2 base_freq = 1.0f / heightmap_world_size();
-
-	// We're modelling noise, so assume we're integrating energy, not amplitude.
-	config.amplitude *= muglm::sqrt(base_freq.x * base_freq.y);
+	// The query mirrors the spectrum from the user facing config, not the normalized one.
+	if (config.cpu_query_resolution)
+		cpu_query.reset(new OceanQuery(config_, config.cpu_query_resolution));
 
 	if (!config.heightmap)
 	{
@@ -74,11 +72,19 @@ void Ocean::set_frequency_band_amplitude(unsigned band, float amplitude)
 {
 	assert(band < FrequencyBands);
 	frequency_bands[band] = amplitude;
+	update_cpu_query_bands();
 }
 
 void Ocean::set_frequency_band_modulation(bool enable)
 {
 	freq_band_modulation = enable;
+	update_cpu_query_bands();
+}
+
+void Ocean::update_cpu_query_bands()
+{
+	if (cpu_query)
+		cpu_query->set_frequency_band_modulation(freq_band_modulation ? frequency_bands : nullptr, FrequencyBands);
 }
 
 Ocean::Handles Ocean::add_to_scene(Scene &scene, const OceanConfig &config, NodeHandle node)
@@ -103,9 +109,6 @@ Ocean::Handles Ocean::add_to_scene(Scene &scene, const OceanConfig &config, Node
 	return handles;
 }
 
-static constexpr double AnimationPeriod = 256.0;
-static constexpr double AnimationPeriodScaled = AnimationPeriod / (2.0 * muglm::pi<double>());
-
 void Ocean::on_pipeline_created(const Vulkan::DevicePipelineReadyEvent &e)
 {
 	FFT::Options options = {};
@@ -156,9 +159,15 @@ void Ocean::refresh(const RenderContext &context_, TaskComposer &)
 	last_camera_position = context_.get_render_parameters().camera_position;
 
 	if (node)
-		node_center_position = node->get_cached_transform()[3].xyz();
+		node_center_position = node->get_cached_transform().get_translation();
 	else
 		node_center_position = vec3(0.0f);
+
+	if (cpu_query)
+	{
+		cpu_query->set_world_offset(get_world_offset());
+		cpu_query->evaluate_async(context_.get_frame_parameters().elapsed_time);
+	}
 }
 
 void Ocean::set_base_renderer(const RendererSuite *)
@@ -417,7 +426,7 @@ void Ocean::update_lod_pass(Vulkan::CommandBuffer &cmd)
 
 vec2 Ocean::heightmap_world_size() const
 {
-	return get_grid_size() * float(config.fft_resolution) / float(config.grid_resolution);
+	return OceanSpectrum::heightmap_world_size(config);
 }
 
 vec2 Ocean::normalmap_world_size() const
@@ -1505,75 +1514,6 @@ static inline unsigned square(unsigned x)
 	return x * x;
 }
 
-static inline int alias(int x, int N)
-{
-	if (x > N / 2)
-		x -= N;
-	return x;
-}
-
-static float phillips(const vec2 &k, float max_l, const vec2 &wind_dir, float L)
-{
-	float k_len = length(k);
-	if (k_len == 0.0f)
-		return 0.0f;
-
-	float kL = k_len * L;
-	vec2 k_dir = normalize(k);
-	float kw = dot(k_dir, wind_dir);
-
-	return
-		muglm::pow(kw * kw, 1.0f) *
-		muglm::exp(-1.0f * k_len  * k_len * max_l * max_l) *
-		muglm::exp(-1.0f / (kL * kL)) *
-		muglm::pow(k_len, -4.0f);
-}
-
-static void downsample_distribution(vec2 *output, const vec2 *input,
-                                    unsigned Nx, unsigned Nz, unsigned rate_log2)
-{
-	unsigned out_width = Nx >> rate_log2;
-	unsigned out_height = Nz >> rate_log2;
-
-	for (unsigned z = 0; z < out_height; z++)
-	{
-		for (unsigned x = 0; x < out_width; x++)
-		{
-			int alias_x = alias(x, out_width);
-			int alias_z = alias(z, out_height);
-
-			if (alias_x < 0)
-				alias_x += Nx;
-			if (alias_z < 0)
-				alias_z += Nz;
-
-			output[z * out_width + x] = input[alias_z * Nx + alias_x];
-		}
-	}
-}
-
-static void generate_distribution(vec2 *output, const vec2 &mod, unsigned Nx, unsigned Nz,
-                                  float amplitude, float max_l, const vec2 &wind_dir, float L)
-{
-	std::normal_distribution<float> normal_dist(0.0f, 1.0f);
-	std::default_random_engine engine;
-
-	for (unsigned z = 0; z < Nz; z++)
-	{
-		for (unsigned x = 0; x < Nx; x++)
-		{
-			auto &v = output[z * Nx + x];
-			vec2 k = mod * vec2(alias(x, Nx), alias(z, Nz));
-
-			vec2 dist;
-			dist.x = normal_dist(engine);
-			dist.y = normal_dist(engine);
-
-			v = dist * amplitude * muglm::sqrt(0.5f * phillips(k, max_l, wind_dir, L));
-		}
-	}
-}
-
 void Ocean::init_distributions(Vulkan::Device &device)
 {
 	Vulkan::BufferCreateInfo height_distribution = {};
@@ -1590,12 +1530,12 @@ void Ocean::init_distributions(Vulkan::Device &device)
 	generate_distribution(init_height.data(),
 	                      vec2(2.0f * pi<float>()) / heightmap_world_size(),
 	                      config.fft_resolution, config.fft_resolution,
-	                      config.amplitude, 0.02f, wind_direction, phillips_L);
+	                      config.amplitude, MaxL, wind_direction, phillips_L);
 
 	generate_distribution(init_normal.data(),
 	                      vec2(2.0f * pi<float>()) / normalmap_world_size(),
 	                      config.fft_resolution, config.fft_resolution,
-	                      config.amplitude * config.normal_mod, 0.02f, wind_direction, phillips_L);
+	                      config.amplitude * config.normal_mod, MaxL, wind_direction, phillips_L);
 
 	downsample_distribution(init_displacement.data(), init_height.data(),
 	                        config.fft_resolution, config.fft_resolution,
@@ -26,6 +26,7 @@
 #include "scene.hpp"
 #include "application_wsi_events.hpp"
 #include "fft/fft.hpp"
+#include "ocean_query.hpp"
 #include "application_events.hpp"
 #include <vector>
 
@@ -75,6 +76,10 @@ struct OceanConfig
 	// Fudge factor.
 	float lod_bias = -3.5f;
 
+	// If non-zero, heightmap and displacement are also evaluated on the CPU at this resolution
+	// for gameplay queries, see OceanQuery. Should be POT, and is clamped to fft_resolution.
+	unsigned cpu_query_resolution = 0;
+
 	struct
 	{
 		std::string input;
@@ -107,6 +112,13 @@ public:
 	void set_frequency_band_amplitude(unsigned band, float amplitude);
 	void set_frequency_band_modulation(bool enable);
 
+	// nullptr unless OceanConfig::cpu_query_resolution is set.
+	// Refreshed asynchronously every frame.
+	OceanQuery *get_cpu_query()
+	{
+		return cpu_query.get();
+	}
+
 private:
 	OceanConfig config;
 
@@ -119,6 +131,9 @@ private:
 	float frequency_bands[FrequencyBands];
 	bool freq_band_modulation = false;
 
+	std::unique_ptr<OceanQuery> cpu_query;
+	void update_cpu_query_bands();
+
 	bool has_static_aabb() const override
 	{
 		return false;
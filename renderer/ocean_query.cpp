@@ -0,0 +1,540 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#define NOMINMAX
+#include "ocean_query.hpp"
+#include "ocean.hpp"
+#include "bitops.hpp"
+#include "muglm/muglm_impl.hpp"
+#include <random>
+#include <algorithm>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace Granite
+{
+namespace OceanSpectrum
+{
+vec2 heightmap_world_size(const OceanConfig &config)
+{
+	vec2 grid_size = config.ocean_size / vec2(config.grid_count);
+	return grid_size * float(config.fft_resolution) / float(config.grid_resolution);
+}
+
+float normalized_amplitude(const OceanConfig &config)
+{
+	// Normalize amplitude based on how dense the FFT frequency space is.
+	vec2 base_freq = 1.0f / heightmap_world_size(config);
+
+	// We're modelling noise, so assume we're integrating energy, not amplitude.
+	return config.amplitude * muglm::sqrt(base_freq.x * base_freq.y);
+}
+
+static inline int alias(int x, int N)
+{
+	if (x > N / 2)
+		x -= N;
+	return x;
+}
+
+static float phillips(const vec2 &k, float max_l, const vec2 &wind_dir, float L)
+{
+	float k_len = length(k);
+	if (k_len == 0.0f)
+		return 0.0f;
+
+	float kL = k_len * L;
+	vec2 k_dir = normalize(k);
+	float kw = dot(k_dir, wind_dir);
+
+	return
+		muglm::pow(kw * kw, 1.0f) *
+		muglm::exp(-1.0f * k_len  * k_len * max_l * max_l) *
+		muglm::exp(-1.0f / (kL * kL)) *
+		muglm::pow(k_len, -4.0f);
+}
+
+void downsample_distribution(vec2 *output, const vec2 *input,
+                             unsigned Nx, unsigned Nz, unsigned rate_log2)
+{
+	unsigned out_width = Nx >> rate_log2;
+	unsigned out_height = Nz >> rate_log2;
+
+	for (unsigned z = 0; z < out_height; z++)
+	{
+		for (unsigned x = 0; x < out_width; x++)
+		{
+			int alias_x = alias(x, out_width);
+			int alias_z = alias(z, out_height);
+
+			if (alias_x < 0)
+				alias_x += Nx;
+			if (alias_z < 0)
+				alias_z += Nz;
+
+			output[z * out_width + x] = input[alias_z * Nx + alias_x];
+		}
+	}
+}
+
+void generate_distribution(vec2 *output, const vec2 &mod, unsigned Nx, unsigned Nz,
+                           float amplitude, float max_l, const vec2 &wind_dir, float L)
+{
+	std::normal_distribution<float> normal_dist(0.0f, 1.0f);
+	std::default_random_engine engine;
+
+	for (unsigned z = 0; z < Nz; z++)
+	{
+		for (unsigned x = 0; x < Nx; x++)
+		{
+			auto &v = output[z * Nx + x];
+			vec2 k = mod * vec2(alias(x, Nx), alias(z, Nz));
+
+			vec2 dist;
+			dist.x = normal_dist(engine);
+			dist.y = normal_dist(engine);
+
+			v = dist * amplitude * muglm::sqrt(0.5f * phillips(k, max_l, wind_dir, L));
+		}
+	}
+}
+}
+
+OceanQuery::OceanQuery(const OceanConfig &config, unsigned resolution)
+{
+	fft_resolution = config.fft_resolution;
+	resolution = std::max(4u, std::min(resolution, fft_resolution));
+	resolution = 1u << Util::floor_log2(resolution);
+
+	height_resolution = resolution;
+	displacement_resolution = std::max(4u, std::min(resolution, fft_resolution >> config.displacement_downsample));
+	world_size = OceanSpectrum::heightmap_world_size(config);
+
+	vec2 wind_direction = normalize(config.wind_velocity);
+	float phillips_L = dot(config.wind_velocity, config.wind_velocity) / OceanSpectrum::G;
+
+	// The random sequence depends on the full resolution, so generate the full spectrum
+	// and keep the low-frequency band, exactly like the GPU displacement spectrum.
+	std::vector<vec2> full(fft_resolution * fft_resolution);
+	OceanSpectrum::generate_distribution(full.data(), vec2(2.0f * pi<float>()) / world_size,
+	                                     fft_resolution, fft_resolution,
+	                                     OceanSpectrum::normalized_amplitude(config),
+	                                     OceanSpectrum::MaxL, wind_direction, phillips_L);
+
+	height_distribution.resize(height_resolution * height_resolution);
+	displacement_distribution.resize(displacement_resolution * displacement_resolution);
+
+	OceanSpectrum::downsample_distribution(height_distribution.data(), full.data(),
+	                                       fft_resolution, fft_resolution,
+	                                       Util::floor_log2(fft_resolution / height_resolution));
+	OceanSpectrum::downsample_distribution(displacement_distribution.data(), full.data(),
+	                                       fft_resolution, fft_resolution,
+	                                       Util::floor_log2(fft_resolution / displacement_resolution));
+
+	init_bins(height_bins, height_resolution, {});
+	init_bins(displacement_bins, displacement_resolution, {});
+
+	// Inverse transform, twiddle for stride p and phase j lives in twiddles[p + j].
+	twiddles.resize(height_resolution);
+	for (unsigned p = 1; p < height_resolution; p <<= 1)
+	{
+		for (unsigned j = 0; j < p; j++)
+		{
+			double phase = muglm::pi<double>() * double(j) / double(p);
+			twiddles[p + j] = vec2(float(std::cos(phase)), float(std::sin(phase)));
+		}
+	}
+
+	for (auto &real : fft_real)
+		real.resize(height_resolution * height_resolution);
+	for (auto &imag : fft_imag)
+		imag.resize(height_resolution * height_resolution);
+}
+
+OceanQuery::~OceanQuery()
+{
+	wait();
+}
+
+void OceanQuery::init_bins(std::vector<Bin> &bins, unsigned N, const std::vector<float> &bands)
+{
+	bins.resize(N * N);
+
+	vec2 mod = vec2(2.0f * pi<float>()) / world_size;
+	float period = float(OceanSpectrum::AnimationPeriodScaled);
+	float freq_to_band_mod = bands.empty() ? 0.0f : (float(bands.size() - 1) * 2.0f) / float(fft_resolution);
+
+	for (unsigned z = 0; z < N; z++)
+	{
+		for (unsigned x = 0; x < N; x++)
+		{
+			auto &bin = bins[z * N + x];
+			vec2 aliased_freq = vec2(float(OceanSpectrum::alias(int(x), int(N))),
+			                         float(OceanSpectrum::alias(int(z), int(N))));
+			bin.k = mod * aliased_freq;
+
+			// Ensures that we can wrap time to avoid FP rounding errors, same as the GPU.
+			float angular_velocity = muglm::sqrt(OceanSpectrum::G * length(bin.k));
+			bin.angular_velocity = muglm::round(angular_velocity * period) / period;
+
+			bin.band_amplitude = 1.0f;
+			if (!bands.empty())
+			{
+				vec2 F = aliased_freq * freq_to_band_mod;
+				float band = muglm::max(F.x, F.y);
+				band = muglm::clamp(band, 0.0f, float(bands.size()) - 1.001f);
+				auto low_band = unsigned(band);
+				bin.band_amplitude = muglm::mix(bands[low_band], bands[low_band + 1], band - float(low_band));
+			}
+		}
+	}
+}
+
+void OceanQuery::set_world_offset(const vec3 &offset)
+{
+	std::lock_guard<std::mutex> holder{parameter_lock};
+	world_offset = offset;
+}
+
+void OceanQuery::set_frequency_band_modulation(const float *amplitudes, unsigned count)
+{
+	std::lock_guard<std::mutex> holder{parameter_lock};
+	if (amplitudes)
+		frequency_bands.assign(amplitudes, amplitudes + count);
+	else
+		frequency_bands.clear();
+	bands_dirty = true;
+}
+
+void OceanQuery::evolve_spectrum(const std::vector<vec2> &distribution, const std::vector<Bin> &bins,
+                                 unsigned N, float time, bool gradient)
+{
+	// Mirrors generate_fft.comp.
+	float *real = fft_real[0].data();
+	float *imag = fft_imag[0].data();
+
+	for (unsigned z = 0; z < N; z++)
+	{
+		for (unsigned x = 0; x < N; x++)
+		{
+			unsigned i = z * N + x;
+			unsigned wi = ((N - z) & (N - 1)) * N + ((N - x) & (N - 1));
+			auto &bin = bins[i];
+
+			float w = bin.angular_velocity * time;
+			float cw = muglm::cos(w);
+			float sw = muglm::sin(w);
+
+			vec2 a = distribution[i];
+			vec2 b = distribution[wi];
+			a = vec2(a.x * cw - a.y * sw, a.x * sw + a.y * cw);
+			b = vec2(b.x * cw - b.y * sw, b.x * sw + b.y * cw);
+			vec2 res = vec2(a.x + b.x, a.y - b.y);
+
+			if (gradient)
+			{
+				float inv_k_len = 1.0f / (length(bin.k) + 0.00001f);
+				vec2 g = vec2(-bin.k.y, bin.k.x) * inv_k_len;
+				res = vec2(res.x * g.x - res.y * g.y, res.x * g.y + res.y * g.x);
+			}
+
+			res = res * bin.band_amplitude;
+			real[i] = res.x;
+			imag[i] = res.y;
+		}
+	}
+}
+
+// out0 = a + w * b, out1 = a - w * b for entire rows.
+static void butterfly_rows(float *out0_re, float *out0_im, float *out1_re, float *out1_im,
+                           const float *a_re, const float *a_im,
+                           const float *b_re, const float *b_im,
+                           vec2 w, unsigned count)
+{
+	unsigned i = 0;
+
+#if defined(__SSE2__)
+	__m128 w_re = _mm_set1_ps(w.x);
+	__m128 w_im = _mm_set1_ps(w.y);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 ar = _mm_loadu_ps(a_re + i);
+		__m128 ai = _mm_loadu_ps(a_im + i);
+		__m128 br = _mm_loadu_ps(b_re + i);
+		__m128 bi = _mm_loadu_ps(b_im + i);
+		__m128 tr = _mm_sub_ps(_mm_mul_ps(br, w_re), _mm_mul_ps(bi, w_im));
+		__m128 ti = _mm_add_ps(_mm_mul_ps(br, w_im), _mm_mul_ps(bi, w_re));
+		_mm_storeu_ps(out0_re + i, _mm_add_ps(ar, tr));
+		_mm_storeu_ps(out0_im + i, _mm_add_ps(ai, ti));
+		_mm_storeu_ps(out1_re + i, _mm_sub_ps(ar, tr));
+		_mm_storeu_ps(out1_im + i, _mm_sub_ps(ai, ti));
+	}
+#elif defined(__ARM_NEON)
+	float32x4_t w_re = vdupq_n_f32(w.x);
+	float32x4_t w_im = vdupq_n_f32(w.y);
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t ar = vld1q_f32(a_re + i);
+		float32x4_t ai = vld1q_f32(a_im + i);
+		float32x4_t br = vld1q_f32(b_re + i);
+		float32x4_t bi = vld1q_f32(b_im + i);
+		float32x4_t tr = vsubq_f32(vmulq_f32(br, w_re), vmulq_f32(bi, w_im));
+		float32x4_t ti = vaddq_f32(vmulq_f32(br, w_im), vmulq_f32(bi, w_re));
+		vst1q_f32(out0_re + i, vaddq_f32(ar, tr));
+		vst1q_f32(out0_im + i, vaddq_f32(ai, ti));
+		vst1q_f32(out1_re + i, vsubq_f32(ar, tr));
+		vst1q_f32(out1_im + i, vsubq_f32(ai, ti));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float tr = b_re[i] * w.x - b_im[i] * w.y;
+		float ti = b_re[i] * w.y + b_im[i] * w.x;
+		out0_re[i] = a_re[i] + tr;
+		out0_im[i] = a_im[i] + ti;
+		out1_re[i] = a_re[i] - tr;
+		out1_im[i] = a_im[i] - ti;
+	}
+}
+
+static void transpose(float *dst, const float *src, unsigned N)
+{
+	constexpr unsigned Block = 16;
+	for (unsigned by = 0; by < N; by += Block)
+		for (unsigned bx = 0; bx < N; bx += Block)
+			for (unsigned y = by; y < std::min(by + Block, N); y++)
+				for (unsigned x = bx; x < std::min(bx + Block, N); x++)
+					dst[x * N + y] = src[y * N + x];
+}
+
+void OceanQuery::inverse_fft_columns(unsigned N, unsigned &src)
+{
+	// Radix-2 Stockham along Z. Every butterfly operates on entire rows,
+	// so all columns are transformed in lock-step and the inner loop is trivially vectorized.
+	unsigned half_N = N >> 1;
+	for (unsigned p = 1; p < N; p <<= 1)
+	{
+		unsigned dst = src ^ 1;
+		const float *in_re = fft_real[src].data();
+		const float *in_im = fft_imag[src].data();
+		float *out_re = fft_real[dst].data();
+		float *out_im = fft_imag[dst].data();
+
+		for (unsigned k = 0; k < half_N; k++)
+		{
+			unsigned j = k & (p - 1);
+			unsigned out0 = 2 * k - j;
+			unsigned out1 = out0 + p;
+			butterfly_rows(out_re + out0 * N, out_im + out0 * N,
+			               out_re + out1 * N, out_im + out1 * N,
+			               in_re + k * N, in_im + k * N,
+			               in_re + (k + half_N) * N, in_im + (k + half_N) * N,
+			               twiddles[p + j], N);
+		}
+
+		src = dst;
+	}
+}
+
+void OceanQuery::inverse_fft_2d(unsigned N)
+{
+	unsigned src = 0;
+	inverse_fft_columns(N, src);
+	transpose(fft_real[src ^ 1].data(), fft_real[src].data(), N);
+	transpose(fft_imag[src ^ 1].data(), fft_imag[src].data(), N);
+	src ^= 1;
+	inverse_fft_columns(N, src);
+	transpose(fft_real[src ^ 1].data(), fft_real[src].data(), N);
+	transpose(fft_imag[src ^ 1].data(), fft_imag[src].data(), N);
+	src ^= 1;
+
+	// Always leave the result in the first buffer to keep the callers simple.
+	if (src != 0)
+	{
+		std::swap(fft_real[0], fft_real[1]);
+		std::swap(fft_imag[0], fft_imag[1]);
+	}
+}
+
+void OceanQuery::evaluate(double time)
+{
+	std::lock_guard<std::mutex> holder{evaluate_lock};
+
+	{
+		std::lock_guard<std::mutex> param_holder{parameter_lock};
+		pending.world_offset = world_offset;
+		if (bands_dirty)
+		{
+			init_bins(height_bins, height_resolution, frequency_bands);
+			init_bins(displacement_bins, displacement_resolution, frequency_bands);
+			bands_dirty = false;
+		}
+	}
+
+	auto wrapped_time = float(muglm::mod(time, OceanSpectrum::AnimationPeriod));
+
+	evolve_spectrum(height_distribution, height_bins, height_resolution, wrapped_time, false);
+	inverse_fft_2d(height_resolution);
+	pending.height.resize(height_resolution * height_resolution);
+	memcpy(pending.height.data(), fft_real[0].data(), pending.height.size() * sizeof(float));
+
+	evolve_spectrum(displacement_distribution, displacement_bins, displacement_resolution, wrapped_time, true);
+	inverse_fft_2d(displacement_resolution);
+	pending.displacement.resize(displacement_resolution * displacement_resolution);
+	for (size_t i = 0, n = pending.displacement.size(); i < n; i++)
+		pending.displacement[i] = OceanSpectrum::DisplacementLambda * vec2(fft_real[0][i], fft_imag[0][i]);
+
+	pending.time = time;
+	pending.valid = true;
+
+	// Publishing is just a few swaps, so readers are never blocked for long.
+	Util::RWSpinLockWriteHolder write_holder{snapshot_lock};
+	unsigned next_snapshot = current_snapshot ^ 1;
+	std::swap(snapshots[next_snapshot], pending);
+	current_snapshot = next_snapshot;
+}
+
+bool OceanQuery::evaluate_async(double time)
+{
+	if (pending_task && !pending_task->poll())
+		return false;
+
+	auto *group = GRANITE_THREAD_GROUP();
+	if (!group)
+	{
+		evaluate(time);
+		return true;
+	}
+
+	pending_task = group->create_task([this, time]() {
+		evaluate(time);
+	});
+	pending_task->set_desc("ocean-query-evaluate");
+	pending_task->set_task_class(TaskClass::Background);
+	pending_task->flush();
+	return true;
+}
+
+void OceanQuery::wait()
+{
+	if (pending_task)
+	{
+		pending_task->wait();
+		pending_task.reset();
+	}
+}
+
+bool OceanQuery::has_data() const
+{
+	Util::RWSpinLockReadHolder holder{snapshot_lock};
+	return snapshots[current_snapshot].valid;
+}
+
+template <typename T>
+static T sample_bilinear(const std::vector<T> &field, unsigned N, vec2 coord)
+{
+	vec2 base = floor(coord);
+	vec2 l = coord - base;
+	int x = int(base.x);
+	int y = int(base.y);
+	int mask = int(N - 1);
+
+	int x0 = x & mask;
+	int x1 = (x + 1) & mask;
+	int y0 = y & mask;
+	int y1 = (y + 1) & mask;
+
+	T top = mix(field[y0 * N + x0], field[y0 * N + x1], l.x);
+	T bottom = mix(field[y1 * N + x0], field[y1 * N + x1], l.x);
+	return mix(top, bottom, l.y);
+}
+
+vec2 OceanQuery::sample_displacement_locked(const Snapshot &snap, vec2 pos) const
+{
+	vec2 coord = (pos - snap.world_offset.xz()) * (float(displacement_resolution) / world_size);
+	return sample_bilinear(snap.displacement, displacement_resolution, coord);
+}
+
+float OceanQuery::sample_height_locked(const Snapshot &snap, vec2 pos) const
+{
+	// The surface is displaced horizontally, so find the undisplaced position which lands on pos.
+	// A few fixed-point iterations converge quickly for non-breaking waves.
+	vec2 p = pos;
+	for (unsigned i = 0; i < 3; i++)
+		p = pos - sample_displacement_locked(snap, p);
+
+	vec2 coord = (p - snap.world_offset.xz()) * (float(height_resolution) / world_size);
+	return sample_bilinear(snap.height, height_resolution, coord) + snap.world_offset.y;
+}
+
+void OceanQuery::sample_heights(const vec2 *positions, float *heights, size_t count, double time) const
+{
+	Util::RWSpinLockReadHolder holder{snapshot_lock};
+	auto &current = snapshots[current_snapshot];
+	auto &previous = snapshots[current_snapshot ^ 1];
+
+	if (!current.valid)
+	{
+		for (size_t i = 0; i < count; i++)
+			heights[i] = 0.0f;
+		return;
+	}
+
+	float lerp = 1.0f;
+	if (previous.valid && previous.time < current.time)
+		lerp = muglm::clamp(float((time - previous.time) / (current.time - previous.time)), 0.0f, 1.0f);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		float h = sample_height_locked(current, positions[i]);
+		if (lerp < 1.0f)
+			h = mix(sample_height_locked(previous, positions[i]), h, lerp);
+		heights[i] = h;
+	}
+}
+
+float OceanQuery::sample_height(float x, float z, double time) const
+{
+	vec2 pos(x, z);
+	float height;
+	sample_heights(&pos, &height, 1, time);
+	return height;
+}
+
+void OceanQuery::get_height_field(std::vector<float> &height) const
+{
+	Util::RWSpinLockReadHolder holder{snapshot_lock};
+	height = snapshots[current_snapshot].height;
+}
+
+void OceanQuery::get_displacement_field(std::vector<vec2> &displacement) const
+{
+	Util::RWSpinLockReadHolder holder{snapshot_lock};
+	displacement = snapshots[current_snapshot].displacement;
+}
+}
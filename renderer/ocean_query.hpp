@@ -0,0 +1,166 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "math.hpp"
+#include "read_write_lock.hpp"
+#include "thread_group.hpp"
+#include <mutex>
+#include <vector>
+
+namespace Granite
+{
+struct OceanConfig;
+
+// Spectrum helpers shared between the GPU ocean and the CPU mirror.
+// Both must generate bit-identical initial distributions from the same OceanConfig.
+namespace OceanSpectrum
+{
+static constexpr float G = 9.81f;
+static constexpr double AnimationPeriod = 256.0;
+static constexpr double AnimationPeriodScaled = AnimationPeriod / (2.0 * muglm::pi<double>());
+static constexpr float DisplacementLambda = 1.2f;
+static constexpr float MaxL = 0.02f;
+
+vec2 heightmap_world_size(const OceanConfig &config);
+float normalized_amplitude(const OceanConfig &config);
+
+void generate_distribution(vec2 *output, const vec2 &mod, unsigned Nx, unsigned Nz,
+                           float amplitude, float max_l, const vec2 &wind_dir, float L);
+void downsample_distribution(vec2 *output, const vec2 *input,
+                             unsigned Nx, unsigned Nz, unsigned rate_log2);
+}
+
+// CPU mirror of the ocean heightmap and displacement FFTs.
+// The spectrum is the low-frequency band of the GPU spectrum, so the result is a band-limited
+// version of what the vertex shader sees at LOD 0. Intended for buoyancy and gameplay queries
+// which cannot afford to stall on a GPU readback.
+class OceanQuery
+{
+public:
+	// resolution is clamped to a POT in [4, fft_resolution].
+	OceanQuery(const OceanConfig &config, unsigned resolution);
+	~OceanQuery();
+
+	OceanQuery(const OceanQuery &) = delete;
+	void operator=(const OceanQuery &) = delete;
+
+	// Kicks off an evaluation on a background task.
+	// If the previous evaluation is still in flight, the request is dropped and false is returned.
+	bool evaluate_async(double time);
+	// Evaluates on the calling thread.
+	void evaluate(double time);
+	void wait();
+
+	// Must match Ocean::get_world_offset(), i.e. the world space position of heightmap texel (0, 0).
+	void set_world_offset(const vec3 &offset);
+	void set_frequency_band_modulation(const float *amplitudes, unsigned count);
+
+	bool has_data() const;
+
+	// Height of the displaced surface at world position (x, z).
+	// Two snapshots are kept around, and time is interpolated between them (clamped).
+	// Thread-safe, can be called concurrently with evaluation.
+	float sample_height(float x, float z, double time) const;
+	void sample_heights(const vec2 *positions, float *heights, size_t count, double time) const;
+
+	// Raw fields of the newest snapshot, laid out as the GPU would after bake_maps.
+	// Displacement includes the lambda factor.
+	void get_height_field(std::vector<float> &height) const;
+	void get_displacement_field(std::vector<vec2> &displacement) const;
+
+	unsigned get_height_resolution() const
+	{
+		return height_resolution;
+	}
+
+	unsigned get_displacement_resolution() const
+	{
+		return displacement_resolution;
+	}
+
+	const std::vector<vec2> &get_height_distribution() const
+	{
+		return height_distribution;
+	}
+
+	const std::vector<vec2> &get_displacement_distribution() const
+	{
+		return displacement_distribution;
+	}
+
+private:
+	struct Snapshot
+	{
+		std::vector<float> height;
+		std::vector<vec2> displacement;
+		vec3 world_offset = vec3(0.0f);
+		double time = 0.0;
+		bool valid = false;
+	};
+
+	struct Bin
+	{
+		vec2 k;
+		float angular_velocity;
+		float band_amplitude;
+	};
+
+	unsigned height_resolution = 0;
+	unsigned displacement_resolution = 0;
+	unsigned fft_resolution = 0;
+	vec2 world_size;
+
+	std::vector<vec2> height_distribution;
+	std::vector<vec2> displacement_distribution;
+	std::vector<Bin> height_bins;
+	std::vector<Bin> displacement_bins;
+	std::vector<vec2> twiddles;
+
+	// Scratch buffers for the FFT, only touched with evaluate_lock held.
+	std::vector<float> fft_real[2];
+	std::vector<float> fft_imag[2];
+
+	Snapshot snapshots[2];
+	Snapshot pending;
+	unsigned current_snapshot = 0;
+	mutable Util::RWSpinLock snapshot_lock;
+
+	std::mutex evaluate_lock;
+	std::mutex parameter_lock;
+	vec3 world_offset = vec3(0.0f);
+	std::vector<float> frequency_bands;
+	bool bands_dirty = false;
+
+	TaskGroupHandle pending_task;
+
+	void init_bins(std::vector<Bin> &bins, unsigned N, const std::vector<float> &bands);
+	void evolve_spectrum(const std::vector<vec2> &distribution, const std::vector<Bin> &bins,
+	                     unsigned N, float time, bool gradient);
+	void inverse_fft_2d(unsigned N);
+	void inverse_fft_columns(unsigned N, unsigned &src);
+
+	float sample_height_locked(const Snapshot &snap, vec2 pos) const;
+	vec2 sample_displacement_locked(const Snapshot &snap, vec2 pos) const;
+};
+}
@@ -22,21 +22,32 @@
 
 #include "render_components.hpp"
 #include "scene.hpp"
+#include "muglm/matrix_helper.hpp"
 
 namespace Granite
 {
-const mat4 &RenderInfoComponent::get_world_transform() const
+const mat_affine &RenderInfoComponent::get_affine_world_transform() const
 {
 	assert(scene_node->transform.count);
 	return scene_node->parent_scene.get_transforms().get_cached_transforms()[scene_node->transform.offset];
 }
 
-const mat4 &RenderInfoComponent::get_prev_world_transform() const
+const mat_affine &RenderInfoComponent::get_affine_prev_world_transform() const
 {
 	assert(scene_node->transform.count);
 	return scene_node->parent_scene.get_transforms().get_cached_prev_transforms()[scene_node->transform.offset];
 }
 
+mat4 RenderInfoComponent::get_world_transform() const
+{
+	return mat4_cast(get_affine_world_transform());
+}
+
+mat4 RenderInfoComponent::get_prev_world_transform() const
+{
+	return mat4_cast(get_affine_prev_world_transform());
+}
+
 const AABB &RenderInfoComponent::get_aabb() const
 {
 	assert(aabb.count);
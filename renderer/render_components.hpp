@@ -172,8 +172,11 @@ struct RenderInfoComponent : ComponentBase
 	// e.g. per instance material information.
 	const void *extra_data = nullptr;
 
-	const mat4 &get_world_transform() const;
-	const mat4 &get_prev_world_transform() const;
+	// Expanded to mat4 for convenience. Hot paths should consume the affine transforms directly.
+	mat4 get_world_transform() const;
+	mat4 get_prev_world_transform() const;
+	const mat_affine &get_affine_world_transform() const;
+	const mat_affine &get_affine_prev_world_transform() const;
 	const AABB &get_aabb() const;
 
 	inline const Node::Skinning *get_skin() const
@@ -190,7 +193,7 @@ struct RenderInfoComponent : ComponentBase
 struct CachedTransformComponent : ComponentBase
 {
 	GRANITE_COMPONENT_TYPE_DECL(CachedTransformComponent)
-	mat4 *transform = nullptr;
+	const mat_affine *transform = nullptr;
 };
 
 struct CachedSpatialTransformTimestampComponent : ComponentBase
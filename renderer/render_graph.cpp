@@ -28,6 +28,7 @@
 #include "thread_group.hpp"
 #include "task_composer.hpp"
 #include "vulkan_prerotate.hpp"
+#include "thread_id.hpp"
 #include <algorithm>
 
 namespace Granite
@@ -69,6 +70,17 @@ void RenderPassInterface::build_render_pass_separate_layer(Vulkan::CommandBuffer
 {
 }
 
+unsigned RenderPassInterface::get_num_parallel_command_buffers() const
+{
+	return 1;
+}
+
+void RenderPassInterface::build_render_pass_parallel(Vulkan::CommandBuffer &cmd, unsigned index, unsigned)
+{
+	if (index == 0)
+		build_render_pass(cmd);
+}
+
 void RenderPassInterface::enqueue_prepare_render_pass(RenderGraph &, TaskComposer &)
 {
 }
@@ -1787,6 +1799,56 @@ void RenderGraph::build_aliases()
 				physical_passes[pass_range[chain[i]].last_used_pass()].alias_transfer.push_back(std::make_pair(chain[i], chain[0]));
 		}
 	}
+
+	// Images which did not alias above can still share memory with images of other dimensions
+	// if lifetimes are disjoint. Placement needs memory requirements, so it is deferred to setup_attachments().
+	memory_alias_candidates.clear();
+	memory_alias_dirty = true;
+	if (!enabled_memory_aliasing)
+		return;
+
+	unsigned backbuffer_physical_index = resources[resource_to_index[backbuffer_source]]->get_physical_index();
+
+	for (unsigned i = 0; i < physical_dimensions.size(); i++)
+	{
+		auto &dim = physical_dimensions[i];
+		auto &range = pass_range[i];
+
+		if (dim.buffer_info.size || dim.is_storage_image())
+			continue;
+		if (physical_image_has_history[i] || physical_aliases[i] != RenderResource::Unused || !alias_chains[i].empty())
+			continue;
+		// Backbuffer is read after the last pass to blit to swapchain.
+		if (i == swapchain_physical_index || i == backbuffer_physical_index)
+			continue;
+		if ((dim.flags & (ATTACHMENT_INFO_INTERNAL_TRANSIENT_BIT | ATTACHMENT_INFO_INTERNAL_PROXY_BIT)) != 0)
+			continue;
+		if ((dim.flags & ATTACHMENT_INFO_PERSISTENT_BIT) == 0)
+			continue;
+		// Same reasoning as above, only pass aliasing barriers within one queue.
+		if ((dim.queues & (dim.queues - 1)) != 0)
+			continue;
+		if (!range.is_used() || !range.can_alias())
+			continue;
+
+		MemoryAliasCandidate candidate = {};
+		candidate.physical_index = i;
+		candidate.first_pass = range.first_used_pass();
+		candidate.last_pass = range.last_used_pass();
+
+		// The next image in the same memory has to wait for every access in the last pass, not only writes.
+		auto &last_pass = physical_passes[candidate.last_pass];
+		for (auto &barrier : last_pass.invalidate)
+			if (barrier.resource_index == i && !barrier.history)
+				candidate.last_stages |= barrier.stages;
+		for (auto &barrier : last_pass.flush)
+			if (barrier.resource_index == i && !barrier.history)
+				candidate.last_stages |= barrier.stages;
+		if (!candidate.last_stages)
+			candidate.last_stages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+		memory_alias_candidates.push_back(candidate);
+	}
 }
 
 bool RenderGraph::need_invalidate(const Barrier &barrier, const PipelineEvent &event)
@@ -1826,6 +1888,21 @@ void RenderGraph::physical_pass_transfer_ownership(const PhysicalPass &pass)
 		phys_events.to_flush_access = 0;
 		phys_events.layout = VK_IMAGE_LAYOUT_UNDEFINED;
 	}
+
+	// Different images sharing memory. Unlike the plain aliases above, an image can overlap with multiple
+	// previous images, so accumulate the dependencies. Any pending writes must be flushed before reuse.
+	// Contents are discarded by transitioning from UNDEFINED on the next use.
+	for (auto &transfer : pass.memory_alias_transfer)
+	{
+		auto &src_events = physical_events[transfer.from];
+		auto &phys_events = physical_events[transfer.to];
+		phys_events.pipeline_barrier_src_stages |= transfer.stages | src_events.pipeline_barrier_src_stages;
+		phys_events.to_flush_access |= src_events.to_flush_access;
+		for (auto &e : phys_events.invalidated_in_stage)
+			e = 0;
+		phys_events.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		phys_events.memory_alias_pending = true;
+	}
 }
 
 static void get_queue_type(Vulkan::CommandBuffer::Type &queue_type, bool &graphics, RenderGraphQueueFlagBits flag)
@@ -2023,6 +2100,11 @@ void RenderGraph::physical_pass_handle_invalidate_barrier(const Barrier &barrier
 				b.srcStageMask = event.pipeline_barrier_src_stages;
 				state.image_barriers.push_back(b);
 				need_pipeline_barrier = true;
+				if (event.memory_alias_pending)
+				{
+					memory_alias_barrier_count++;
+					event.memory_alias_pending = false;
+				}
 			}
 			else if (wait_semaphore)
 			{
@@ -2146,8 +2228,11 @@ void RenderGraph::physical_pass_enqueue_graphics_commands(const PhysicalPass &ph
 				physical_pass.depth_clear_request.target);
 	}
 
+	// Benchmarking through frame samples wants per-pass GPU time even if the application did not ask for it.
+	bool timestamps = enabled_timestamps || device->timestamp_log_frame_samples_enabled();
+
 	Vulkan::QueryPoolHandle start_graphics, end_graphics;
-	if (enabled_timestamps)
+	if (timestamps)
 		start_graphics = cmd.write_timestamp(VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
 
 	VK_ASSERT(physical_pass.layers != ~0u);
@@ -2212,9 +2297,19 @@ void RenderGraph::physical_pass_enqueue_graphics_commands(const PhysicalPass &ph
 			// due to clearing and so on.
 			// This should be an extremely unlikely scenario.
 			// Either you need all subpasses or none.
-			cmd.begin_region(pass.get_name().c_str());
-			pass.build_render_pass(cmd, layer);
-			cmd.end_region();
+			if (state.subpass_contents[subpass_index] == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+			{
+				// Recorded ahead of time in parallel, see physical_pass_handle_gpu_timeline.
+				for (auto &secondary : state.secondary_cmds[subpass_index])
+					cmd.submit_secondary(std::move(secondary));
+				state.secondary_cmds[subpass_index].clear();
+			}
+			else
+			{
+				cmd.begin_region(pass.get_name().c_str());
+				pass.build_render_pass(cmd, layer);
+				cmd.end_region();
+			}
 
 			if (&subpass != &physical_pass.passes.back())
 				cmd.next_subpass(state.subpass_contents[subpass_index + 1]);
@@ -2225,7 +2320,7 @@ void RenderGraph::physical_pass_enqueue_graphics_commands(const PhysicalPass &ph
 		cmd.end_region();
 	}
 
-	if (enabled_timestamps)
+	if (timestamps)
 	{
 		end_graphics = cmd.write_timestamp(VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
 		std::string name;
@@ -2251,13 +2346,15 @@ void RenderGraph::physical_pass_enqueue_compute_commands(const PhysicalPass &phy
 
 	auto &cmd = *state.cmd;
 	auto &pass = *passes[physical_pass.passes.front()];
+	bool timestamps = enabled_timestamps || device->timestamp_log_frame_samples_enabled();
+
 	Vulkan::QueryPoolHandle start_ts, end_ts;
-	if (enabled_timestamps)
+	if (timestamps)
 		start_ts = cmd.write_timestamp(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 	cmd.begin_region(pass.get_name().c_str());
 	pass.build_render_pass(cmd, 0);
 	cmd.end_region();
-	if (enabled_timestamps)
+	if (timestamps)
 	{
 		end_ts = cmd.write_timestamp(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 		device->register_time_interval("compute", std::move(start_ts), std::move(end_ts), pass.get_name());
@@ -2304,8 +2401,28 @@ void RenderGraph::physical_pass_handle_cpu_timeline(Vulkan::Device &device_,
 	state.subpass_contents.resize(physical_pass.passes.size());
 	for (auto &c : state.subpass_contents)
 		c = VK_SUBPASS_CONTENTS_INLINE;
+	state.secondary_cmds.resize(physical_pass.passes.size());
+	for (auto &cmds : state.secondary_cmds)
+		cmds.clear();
 
 	auto &group = incoming_composer.get_thread_group();
+
+	// Subpasses which can be split are recorded in parallel to secondary command buffers.
+	// Secondary command buffers are allocated against the physical pass' render pass info directly,
+	// so this only works when we render the pass once, and there are no inline commands in the subpass.
+	if (state.graphics && physical_pass.layers == 1)
+	{
+		for (auto &pass : physical_pass.passes)
+		{
+			auto subpass_index = unsigned(&pass - physical_pass.passes.data());
+			unsigned count = std::min(passes[pass]->get_num_parallel_command_buffers(), group.get_num_threads());
+			if (count > 1 && physical_pass.scaled_clear_requests[subpass_index].empty())
+			{
+				state.subpass_contents[subpass_index] = VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+				state.secondary_cmds[subpass_index].resize(count);
+			}
+		}
+	}
 	TaskComposer composer(group);
 	composer.set_incoming_task(incoming_composer.get_pipeline_stage_dependency());
 	composer.begin_pipeline_stage();
@@ -2324,6 +2441,7 @@ void RenderGraph::physical_pass_handle_gpu_timeline(ThreadGroup &group, Vulkan::
                                                     PassSubmissionState &state)
 {
 	auto task = group.create_task([&]() {
+		auto start_ts = device_.write_calibrated_timestamp();
 		state.cmd = device_.request_command_buffer(state.queue_type);
 		state.emit_pre_pass_barriers();
 
@@ -2336,11 +2454,42 @@ void RenderGraph::physical_pass_handle_gpu_timeline(ThreadGroup &group, Vulkan::
 		// in the submission task.
 		state.cmd->end_debug_channel();
 		state.cmd->end_threaded_recording();
+		device_.register_time_interval("CPU", std::move(start_ts), device_.write_calibrated_timestamp(),
+		                               "command recording");
 	});
 
 	task->set_desc((passes[physical_pass.passes.front()]->get_name() + "-build-gpu-commands").c_str());
 	if (state.rendering_dependency)
 		group.add_dependency(*task, *state.rendering_dependency);
+
+	for (auto &cmds : state.secondary_cmds)
+	{
+		auto subpass_index = unsigned(&cmds - state.secondary_cmds.data());
+		auto &pass = *passes[physical_pass.passes[subpass_index]];
+		auto num_indices = unsigned(cmds.size());
+
+		for (unsigned i = 0; i < num_indices; i++)
+		{
+			auto secondary_task = group.create_task([&, subpass_index, i, num_indices]() {
+				auto start_ts = device_.write_calibrated_timestamp();
+				auto secondary = Vulkan::CommandBuffer::request_secondary_command_buffer(
+						device_, physical_pass.render_pass_info, Util::get_current_thread_index(), subpass_index);
+				secondary->begin_region(pass.get_name().c_str());
+				pass.build_render_pass_parallel(*secondary, i, num_indices);
+				secondary->end_region();
+				secondary->end_threaded_recording();
+				state.secondary_cmds[subpass_index][i] = std::move(secondary);
+				device_.register_time_interval("CPU", std::move(start_ts), device_.write_calibrated_timestamp(),
+				                               "command recording");
+			});
+
+			secondary_task->set_desc((pass.get_name() + "-build-secondary-gpu-commands").c_str());
+			if (state.rendering_dependency)
+				group.add_dependency(*secondary_task, *state.rendering_dependency);
+			group.add_dependency(*task, *secondary_task);
+		}
+	}
+
 	state.rendering_dependency = task;
 }
 
@@ -2456,6 +2605,7 @@ void RenderGraph::enqueue_swapchain_scale_pass(Vulkan::Device &device_)
 void RenderGraph::enqueue_render_passes(Vulkan::Device &device_, TaskComposer &composer)
 {
 	pass_submission_state.clear();
+	memory_alias_barrier_count = 0;
 	size_t count = physical_passes.size();
 	pass_submission_state.resize(count);
 	auto &thread_group = composer.get_thread_group();
@@ -2536,6 +2686,37 @@ void RenderGraph::setup_physical_buffer(Vulkan::Device &device_, unsigned attach
 	}
 }
 
+static Vulkan::ImageCreateInfo get_physical_image_create_info(const ResourceDimensions &att)
+{
+	Vulkan::ImageCreateInfo info;
+	info.format = att.format;
+	info.type = att.depth > 1 ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+	info.width = att.width;
+	info.height = att.height;
+	info.depth = att.depth;
+	info.domain = Vulkan::ImageDomain::Physical;
+	info.levels = att.levels;
+	info.layers = att.layers;
+	info.usage = att.image_usage;
+	info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	info.samples = static_cast<VkSampleCountFlagBits>(att.samples);
+
+	if (att.is_storage_image())
+		info.flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+
+	if (Vulkan::format_has_depth_or_stencil_aspect(info.format))
+		info.usage &= ~VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+	if ((att.flags & ATTACHMENT_INFO_UNORM_SRGB_ALIAS_BIT) != 0)
+		info.misc |= Vulkan::IMAGE_MISC_MUTABLE_SRGB_BIT;
+	if (att.queues & (RENDER_GRAPH_QUEUE_GRAPHICS_BIT | RENDER_GRAPH_QUEUE_COMPUTE_BIT))
+		info.misc |= Vulkan::IMAGE_MISC_CONCURRENT_QUEUE_GRAPHICS_BIT;
+	if (att.queues & RENDER_GRAPH_QUEUE_ASYNC_COMPUTE_BIT)
+		info.misc |= Vulkan::IMAGE_MISC_CONCURRENT_QUEUE_ASYNC_COMPUTE_BIT;
+
+	return info;
+}
+
 void RenderGraph::setup_physical_image(Vulkan::Device &device_, unsigned attachment)
 {
 	auto &att = physical_dimensions[attachment];
@@ -2550,11 +2731,8 @@ void RenderGraph::setup_physical_image(Vulkan::Device &device_, unsigned attachm
 
 	bool need_image = true;
 	VkImageUsageFlags usage = att.image_usage;
-	Vulkan::ImageMiscFlags misc = 0;
 	VkImageCreateFlags flags = 0;
 
-	if ((att.flags & ATTACHMENT_INFO_UNORM_SRGB_ALIAS_BIT) != 0)
-		misc |= Vulkan::IMAGE_MISC_MUTABLE_SRGB_BIT;
 	if (att.is_storage_image())
 		flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
 
@@ -2575,29 +2753,7 @@ void RenderGraph::setup_physical_image(Vulkan::Device &device_, unsigned attachm
 
 	if (need_image)
 	{
-		Vulkan::ImageCreateInfo info;
-		info.format = att.format;
-		info.type = att.depth > 1 ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
-		info.width = att.width;
-		info.height = att.height;
-		info.depth = att.depth;
-		info.domain = Vulkan::ImageDomain::Physical;
-		info.levels = att.levels;
-		info.layers = att.layers;
-		info.usage = usage;
-		info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-		info.samples = static_cast<VkSampleCountFlagBits>(att.samples);
-		info.flags = flags;
-
-		if (Vulkan::format_has_depth_or_stencil_aspect(info.format))
-			info.usage &= ~VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-		info.misc = misc;
-		if (att.queues & (RENDER_GRAPH_QUEUE_GRAPHICS_BIT | RENDER_GRAPH_QUEUE_COMPUTE_BIT))
-			info.misc |= Vulkan::IMAGE_MISC_CONCURRENT_QUEUE_GRAPHICS_BIT;
-		if (att.queues & RENDER_GRAPH_QUEUE_ASYNC_COMPUTE_BIT)
-			info.misc |= Vulkan::IMAGE_MISC_CONCURRENT_QUEUE_ASYNC_COMPUTE_BIT;
-
+		auto info = get_physical_image_create_info(att);
 		physical_image_attachments[attachment] = device_.create_image(info, nullptr);
 		physical_image_attachments[attachment]->set_surface_transform(att.transform);
 
@@ -2614,6 +2770,214 @@ void RenderGraph::setup_physical_image(Vulkan::Device &device_, unsigned attachm
 	physical_attachments[attachment] = &physical_image_attachments[attachment]->get_view();
 }
 
+void RenderGraph::setup_memory_aliased_images(Vulkan::Device &device_)
+{
+	if (!memory_alias_dirty)
+		return;
+	memory_alias_dirty = false;
+
+	// Images placed in the old heaps must not be reused as regular images.
+	for (size_t i = 0; i < physical_image_memory_aliased.size() && i < physical_image_attachments.size(); i++)
+		if (physical_image_memory_aliased[i])
+			physical_image_attachments[i].reset();
+
+	memory_alias_heaps.clear();
+	physical_image_memory_aliased.clear();
+	physical_image_memory_aliased.resize(physical_dimensions.size());
+	for (auto &physical_pass : physical_passes)
+		physical_pass.memory_alias_transfer.clear();
+	transient_memory_stats = {};
+
+	struct Placement
+	{
+		const MemoryAliasCandidate *candidate;
+		Vulkan::ImageCreateInfo info;
+		VkMemoryRequirements reqs;
+		VkDeviceSize offset;
+		unsigned heap;
+	};
+	std::vector<Placement> placements;
+	placements.reserve(memory_alias_candidates.size());
+
+	for (auto &candidate : memory_alias_candidates)
+	{
+		Placement placement = {};
+		placement.candidate = &candidate;
+		placement.info = get_physical_image_create_info(physical_dimensions[candidate.physical_index]);
+		placement.heap = RenderResource::Unused;
+		if (device_.get_image_memory_requirements(placement.info, &placement.reqs))
+		{
+			placements.push_back(placement);
+			transient_memory_stats.unaliased_size += placement.reqs.size;
+		}
+	}
+
+	transient_memory_stats.num_images = unsigned(placements.size());
+	transient_memory_stats.aliased_size = transient_memory_stats.unaliased_size;
+	if (placements.size() < 2)
+		return;
+
+	// Largest first, then place every image at the lowest offset where it does not overlap
+	// with any other image whose lifetime intersects. This is the usual greedy interval packing.
+	std::stable_sort(placements.begin(), placements.end(), [](const Placement &a, const Placement &b) {
+		return a.reqs.size > b.reqs.size;
+	});
+
+	const auto lifetimes_overlap = [](const Placement &a, const Placement &b) {
+		return a.candidate->first_pass <= b.candidate->last_pass && b.candidate->first_pass <= a.candidate->last_pass;
+	};
+
+	const auto memory_overlaps = [](const Placement &a, const Placement &b) {
+		return a.heap == b.heap &&
+		       a.offset < b.offset + b.reqs.size &&
+		       b.offset < a.offset + a.reqs.size;
+	};
+
+	struct Heap
+	{
+		uint32_t memory_type_bits;
+		VkDeviceSize size;
+		VkDeviceSize alignment;
+	};
+	std::vector<Heap> heaps;
+	std::vector<std::pair<VkDeviceSize, VkDeviceSize>> occupied;
+
+	for (auto &placement : placements)
+	{
+		// Images with different memory type requirements cannot share a heap.
+		for (auto &heap : heaps)
+		{
+			if (heap.memory_type_bits == placement.reqs.memoryTypeBits)
+			{
+				placement.heap = unsigned(&heap - heaps.data());
+				break;
+			}
+		}
+
+		if (placement.heap == RenderResource::Unused)
+		{
+			placement.heap = unsigned(heaps.size());
+			heaps.push_back({ placement.reqs.memoryTypeBits, 0, 1 });
+		}
+
+		occupied.clear();
+		for (auto &other : placements)
+		{
+			if (&other == &placement)
+				break;
+			if (other.heap == placement.heap && lifetimes_overlap(placement, other))
+				occupied.emplace_back(other.offset, other.offset + other.reqs.size);
+		}
+		std::sort(occupied.begin(), occupied.end());
+
+		VkDeviceSize alignment = placement.reqs.alignment ? placement.reqs.alignment : 1;
+		VkDeviceSize offset = 0;
+		for (auto &range : occupied)
+		{
+			VkDeviceSize aligned_offset = (offset + alignment - 1) & ~(alignment - 1);
+			if (aligned_offset + placement.reqs.size <= range.first)
+				break;
+			offset = std::max(offset, range.second);
+		}
+		placement.offset = (offset + alignment - 1) & ~(alignment - 1);
+
+		auto &heap = heaps[placement.heap];
+		heap.size = std::max(heap.size, placement.offset + placement.reqs.size);
+		heap.alignment = std::max(heap.alignment, alignment);
+	}
+
+	std::vector<Vulkan::DeviceAllocationOwnerHandle> allocations(heaps.size());
+	for (auto &heap : heaps)
+	{
+		unsigned heap_index = unsigned(&heap - heaps.data());
+		unsigned num_images = 0;
+		for (auto &placement : placements)
+			if (placement.heap == heap_index)
+				num_images++;
+
+		// Not worth it, and DeviceAllocation is limited to 32-bit.
+		if (num_images < 2 || heap.size > UINT32_MAX)
+			continue;
+
+		Vulkan::MemoryAllocateInfo info;
+		info.requirements.size = heap.size;
+		info.requirements.alignment = heap.alignment;
+		info.requirements.memoryTypeBits = heap.memory_type_bits;
+		info.required_properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		info.mode = Vulkan::AllocationMode::OptimalRenderTarget;
+		allocations[heap_index] = device_.allocate_memory(info);
+		if (!allocations[heap_index])
+			LOGW("Failed to allocate render graph aliasing heap of %llu bytes.\n", static_cast<unsigned long long>(heap.size));
+	}
+
+	for (auto &placement : placements)
+	{
+		auto &allocation = allocations[placement.heap];
+		if (!allocation)
+		{
+			placement.heap = RenderResource::Unused;
+			continue;
+		}
+
+		unsigned index = placement.candidate->physical_index;
+		auto &att = physical_dimensions[index];
+
+		auto sub_allocation = allocation->get_allocation().make_sub_allocation(
+				uint32_t(placement.offset), uint32_t(placement.reqs.size));
+		const Vulkan::DeviceAllocation *aliases[] = { &sub_allocation };
+		placement.info.memory_aliases = aliases;
+		placement.info.num_memory_aliases = 1;
+
+		auto image = device_.create_image(placement.info, nullptr);
+		if (!image)
+		{
+			// setup_physical_image() will allocate it normally instead.
+			placement.heap = RenderResource::Unused;
+			continue;
+		}
+
+		image->set_surface_transform(att.transform);
+		device_.set_name(*image, att.name.c_str());
+		physical_image_attachments[index] = std::move(image);
+		physical_events[index] = {};
+		physical_image_memory_aliased[index] = true;
+	}
+
+	// Every pair of images which share memory needs an aliasing barrier both ways.
+	// Within the frame the later image waits for the earlier one,
+	// and in the next frame the earlier image waits for the later one.
+	for (auto &a : placements)
+	{
+		for (auto &b : placements)
+		{
+			if (&a == &b || a.heap == RenderResource::Unused || !memory_overlaps(a, b))
+				continue;
+			physical_passes[a.candidate->last_pass].memory_alias_transfer.push_back(
+					{ a.candidate->physical_index, b.candidate->physical_index, a.candidate->last_stages });
+		}
+	}
+
+	transient_memory_stats.aliased_size = 0;
+	for (auto &placement : placements)
+		if (placement.heap == RenderResource::Unused)
+			transient_memory_stats.aliased_size += placement.reqs.size;
+	for (auto &allocation : allocations)
+	{
+		if (allocation)
+		{
+			transient_memory_stats.aliased_size += allocation->get_allocation().get_size();
+			transient_memory_stats.num_heaps++;
+			memory_alias_heaps.push_back(std::move(allocation));
+		}
+	}
+
+	LOGI("Render graph memory aliasing: %u images, %.3f MiB -> %.3f MiB in %u heaps.\n",
+	     transient_memory_stats.num_images,
+	     double(transient_memory_stats.unaliased_size) / (1024.0 * 1024.0),
+	     double(transient_memory_stats.aliased_size) / (1024.0 * 1024.0),
+	     transient_memory_stats.num_heaps);
+}
+
 void RenderGraph::setup_attachments(Vulkan::Device &device_, Vulkan::ImageView *swapchain)
 {
 	physical_attachments.clear();
@@ -2630,6 +2994,8 @@ void RenderGraph::setup_attachments(Vulkan::Device &device_, Vulkan::ImageView *
 
 	swapchain_attachment = swapchain;
 
+	setup_memory_aliased_images(device_);
+
 	unsigned num_attachments = physical_dimensions.size();
 	for (unsigned i = 0; i < num_attachments; i++)
 	{
@@ -2645,6 +3011,12 @@ void RenderGraph::setup_attachments(Vulkan::Device &device_, Vulkan::ImageView *
 		if ((att.flags & ATTACHMENT_INFO_INTERNAL_PROXY_BIT) != 0)
 			continue;
 
+		if (physical_image_memory_aliased[i])
+		{
+			physical_attachments[i] = &physical_image_attachments[i]->get_view();
+			continue;
+		}
+
 		if (att.buffer_info.size != 0)
 		{
 			setup_physical_buffer(device_, i);
@@ -3697,6 +4069,11 @@ void RenderGraph::enable_timestamps(bool enable)
 	enabled_timestamps = enable;
 }
 
+void RenderGraph::enable_memory_aliasing(bool enable)
+{
+	enabled_memory_aliasing = enable;
+}
+
 void RenderGraph::add_external_lock_interface(const std::string &name, RenderPassExternalLockInterface *iface)
 {
 	external_lock_interfaces[name] = iface;
@@ -3726,6 +4103,11 @@ void RenderGraph::reset()
 	physical_events.clear();
 	physical_history_events.clear();
 	physical_history_image_attachments.clear();
+	physical_image_memory_aliased.clear();
+	memory_alias_candidates.clear();
+	memory_alias_heaps.clear();
+	memory_alias_dirty = false;
+	memory_alias_barrier_count = 0;
 }
 
 }
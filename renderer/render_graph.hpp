@@ -70,6 +70,13 @@ public:
 
 	virtual void build_render_pass(Vulkan::CommandBuffer &cmd);
 	virtual void build_render_pass_separate_layer(Vulkan::CommandBuffer &cmd, unsigned layer);
+
+	// Can change per frame. If more than 1 is returned, the subpass is recorded as that many
+	// secondary command buffers in parallel, which are executed in order.
+	// Only considered for passes which are not separately layered.
+	virtual unsigned get_num_parallel_command_buffers() const;
+	// Called from worker threads, one call per secondary command buffer.
+	virtual void build_render_pass_parallel(Vulkan::CommandBuffer &cmd, unsigned index, unsigned num_indices);
 };
 using RenderPassInterfaceHandle = Util::IntrusivePtr<RenderPassInterface>;
 
@@ -669,6 +676,20 @@ public:
 			build_render_pass_cb(cmd);
 	}
 
+	unsigned get_num_parallel_command_buffers() const
+	{
+		if (render_pass_handle && !render_pass_handle->render_pass_is_separate_layered())
+			return render_pass_handle->get_num_parallel_command_buffers();
+		else
+			return 1;
+	}
+
+	void build_render_pass_parallel(Vulkan::CommandBuffer &cmd, unsigned index_, unsigned num_indices)
+	{
+		if (render_pass_handle)
+			render_pass_handle->build_render_pass_parallel(cmd, index_, num_indices);
+	}
+
 	void set_render_pass_interface(RenderPassInterfaceHandle handle)
 	{
 		render_pass_handle = std::move(handle);
@@ -782,6 +803,32 @@ public:
 
 	void enable_timestamps(bool enable);
 
+	// Lets images with disjoint lifetimes share memory even if their dimensions differ.
+	// Enabled by default, must be set before bake().
+	// Only images are placed, buffers keep their own memory.
+	void enable_memory_aliasing(bool enable);
+
+	struct TransientMemoryStats
+	{
+		// Images which are candidates for memory aliasing.
+		unsigned num_images = 0;
+		unsigned num_heaps = 0;
+		VkDeviceSize unaliased_size = 0;
+		VkDeviceSize aliased_size = 0;
+	};
+	// Valid after setup_attachments().
+	const TransientMemoryStats &get_transient_memory_stats() const
+	{
+		return transient_memory_stats;
+	}
+
+	// Barriers recorded by the last enqueue_render_passes() where an image waited for
+	// the previous image placed in the same memory.
+	unsigned get_memory_alias_barrier_count() const
+	{
+		return memory_alias_barrier_count;
+	}
+
 	void bake();
 	void reset();
 	void log();
@@ -929,6 +976,14 @@ private:
 		VkImageLayout layout;
 	};
 
+	struct MemoryAliasTransfer
+	{
+		unsigned from;
+		unsigned to;
+		// Stages which access the resource in the pass where it is last used.
+		VkPipelineStageFlags2 stages;
+	};
+
 	struct PhysicalPass
 	{
 		std::vector<unsigned> passes;
@@ -937,6 +992,7 @@ private:
 		std::vector<Barrier> flush;
 		std::vector<Barrier> history;
 		std::vector<std::pair<unsigned, unsigned>> alias_transfer;
+		std::vector<MemoryAliasTransfer> memory_alias_transfer;
 
 		Vulkan::RenderPassInfo render_pass_info;
 		std::vector<Vulkan::RenderPassInfo::Subpass> subpasses;
@@ -960,6 +1016,22 @@ private:
 
 	bool enabled_timestamps = false;
 
+	struct MemoryAliasCandidate
+	{
+		unsigned physical_index;
+		unsigned first_pass;
+		unsigned last_pass;
+		VkPipelineStageFlags2 last_stages;
+	};
+	std::vector<MemoryAliasCandidate> memory_alias_candidates;
+	std::vector<Vulkan::DeviceAllocationOwnerHandle> memory_alias_heaps;
+	std::vector<bool> physical_image_memory_aliased;
+	TransientMemoryStats transient_memory_stats;
+	bool enabled_memory_aliasing = true;
+	bool memory_alias_dirty = false;
+	unsigned memory_alias_barrier_count = 0;
+	void setup_memory_aliased_images(Vulkan::Device &device);
+
 	std::vector<ResourceDimensions> physical_dimensions;
 	std::vector<Vulkan::ImageView *> physical_attachments;
 	std::vector<Vulkan::BufferHandle> physical_buffers;
@@ -979,6 +1051,8 @@ private:
 		VkAccessFlags2 to_flush_access = 0;
 		VkAccessFlags2 invalidated_in_stage[64] = {};
 		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// Memory was handed over from another image, the next barrier is an aliasing barrier.
+		bool memory_alias_pending = false;
 	};
 
 	std::vector<PipelineEvent> physical_events;
@@ -1018,6 +1092,8 @@ private:
 		Util::SmallVector<VkImageMemoryBarrier2> image_barriers;
 
 		Util::SmallVector<VkSubpassContents> subpass_contents;
+		// Per subpass, non-empty if the subpass is recorded in parallel.
+		Util::SmallVector<Util::SmallVector<Vulkan::CommandBufferHandle>> secondary_cmds;
 
 		Util::SmallVector<Vulkan::Semaphore> wait_semaphores;
 		Util::SmallVector<VkPipelineStageFlags2> wait_semaphore_stages;
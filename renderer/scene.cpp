@@ -24,6 +24,7 @@
 #include "transforms.hpp"
 #include "lights/lights.hpp"
 #include "simd.hpp"
+#include "simd_dispatch.hpp"
 #include "task_composer.hpp"
 #include <limits>
 
@@ -69,32 +70,51 @@ template <typename T, typename Func>
 static void gather_visible_renderables(const Frustum &frustum, VisibilityList &list, const T &objects,
                                        size_t begin_index, size_t end_index, const Func &filter_func)
 {
-	for (size_t i = begin_index; i < end_index; i++)
-	{
-		auto &o = objects[i];
-		auto *transform = get_component<RenderInfoComponent>(o);
-
-		auto *renderable = get_component<RenderableComponent>(o);
-		auto flags = renderable->renderable->flags;
-		if (!filter_func(transform, flags))
-			continue;
+	// Gather candidates in batches so the dispatched kernel can test several AABBs at once.
+	// Candidates which skip culling still take a slot so the output order is preserved.
+	constexpr size_t BatchSize = 64;
+	RenderableInfo candidates[BatchSize];
+	bool forced[BatchSize];
+	const float *aabbs[BatchSize];
+	uint8_t visible[BatchSize];
 
-		auto *timestamp = get_component<CachedSpatialTransformTimestampComponent>(o);
-
-		Util::Hasher h;
-		h.u64(timestamp->cookie);
-		h.u32(timestamp->last_timestamp);
+	const AABB dummy_aabb(vec3(0.0f), vec3(0.0f));
+	auto *cull = SIMD::get_dispatch().frustum_cull;
+	const float *planes = frustum.get_planes()[0].data;
 
-		if (transform->has_scene_node())
+	size_t i = begin_index;
+	while (i < end_index)
+	{
+		size_t num_candidates = 0;
+		for (; i < end_index && num_candidates < BatchSize; i++)
 		{
-			if ((flags & RENDERABLE_FORCE_VISIBLE_BIT) != 0 ||
-			    SIMD::frustum_cull(transform->get_aabb(), frustum.get_planes()))
-			{
-				list.push_back({ renderable->renderable.get(), transform, h.get() });
-			}
+			auto &o = objects[i];
+			auto *transform = get_component<RenderInfoComponent>(o);
+
+			auto *renderable = get_component<RenderableComponent>(o);
+			auto flags = renderable->renderable->flags;
+			if (!filter_func(transform, flags))
+				continue;
+
+			auto *timestamp = get_component<CachedSpatialTransformTimestampComponent>(o);
+
+			Util::Hasher h;
+			h.u64(timestamp->cookie);
+			h.u32(timestamp->last_timestamp);
+
+			bool has_node = transform->has_scene_node();
+			candidates[num_candidates] = { renderable->renderable.get(), has_node ? transform : nullptr, h.get() };
+			forced[num_candidates] = !has_node || (flags & RENDERABLE_FORCE_VISIBLE_BIT) != 0;
+			aabbs[num_candidates] = forced[num_candidates] ?
+			                        dummy_aabb.get_minimum4().data : transform->get_aabb().get_minimum4().data;
+			num_candidates++;
 		}
-		else
-			list.push_back({ renderable->renderable.get(), nullptr, h.get() });
+
+		cull(visible, aabbs, num_candidates, planes);
+
+		for (size_t j = 0; j < num_candidates; j++)
+			if (forced[j] || visible[j])
+				list.push_back(candidates[j]);
 	}
 }
 
@@ -554,7 +574,7 @@ static void update_skinning(Node &node)
 	}
 }
 
-static const mat4 identity_transform(1.0f);
+static const mat_affine identity_transform(1.0f);
 
 size_t Scene::get_cached_transforms_count() const
 {
@@ -689,7 +709,7 @@ void Scene::update_transform_listener_components()
 		CameraComponent *cam;
 		CachedTransformComponent *transform;
 		std::tie(cam, transform) = c;
-		cam->camera.set_transform(*transform->transform);
+		cam->camera.set_transform(mat4_cast(*transform->transform));
 	}
 
 	// Update directional light transforms.
@@ -700,7 +720,8 @@ void Scene::update_transform_listener_components()
 		std::tie(l, transform) = light;
 
 		// v = [0, 0, 1, 0].
-		l->direction = normalize((*transform->transform)[2].xyz());
+		auto &m = *transform->transform;
+		l->direction = normalize(vec3(m[0].z, m[1].z, m[2].z));
 	}
 
 	for (auto &light : volumetric_diffuse_lights)
@@ -804,13 +825,14 @@ void Scene::update_cached_transforms_range(size_t begin_range, size_t end_range)
 					// TODO: Isolate the AABB per bone.
 					bb = AABB(vec3(std::numeric_limits<float>::max()), vec3(-std::numeric_limits<float>::max()));
 
-					auto *cached_skin = cached_transform->scene_node->get_skin_cached();
-					for (size_t j = 0, n = cached_transform->get_skin()->transform.count; j < n; j++)
-						SIMD::transform_and_expand_aabb(bb, *aabb->aabb, cached_skin[j]);
+					SIMD::get_dispatch().transform_expand_aabb(
+							bb.get_minimum4().data, aabb->aabb->get_minimum4().data,
+							cached_transform->scene_node->get_skin_cached()[0][0].data,
+							cached_transform->get_skin()->transform.count);
 				}
 				else
 				{
-					SIMD::transform_aabb(bb, *aabb->aabb, cached_transform->get_world_transform());
+					SIMD::transform_aabb(bb, *aabb->aabb, cached_transform->get_affine_world_transform());
 				}
 			}
 
@@ -875,24 +897,40 @@ void Scene::distribute_per_level_updates(TaskGroup *group)
 	}
 }
 
-static void update_transform_tree_node(Node &node, const mat4 &transform)
-{
-	node.get_cached_prev_transform() = node.get_cached_transform();
-	auto &t = node.get_transform();
-	compute_model_transform(node.get_cached_transform(), t.scale, t.rotation, t.translation, transform);
-
-	node.update_timestamp();
-	node.clear_pending_update_no_atomic();
-}
-
 static void perform_updates(Node * const *updates, size_t count)
 {
-	for (size_t i = 0; i < count; i++)
+	// All nodes within a level are independent, so compute local transforms for a batch of nodes
+	// up front and compose them with their parents in one go.
+	constexpr size_t BatchSize = 64;
+	mat_affine locals[BatchSize];
+	const float *parents[BatchSize];
+	float *outputs[BatchSize];
+
+	for (size_t base = 0; base < count; base += BatchSize)
 	{
-		auto *update = updates[i];
-		auto *parent = update->get_parent();
-		auto &transform = parent ? parent->get_cached_transform() : identity_transform;
-		update_transform_tree_node(*update, transform);
+		size_t to_update = std::min(count - base, BatchSize);
+
+		for (size_t i = 0; i < to_update; i++)
+		{
+			auto &node = *updates[base + i];
+			auto *parent = node.get_parent();
+			auto &cached = node.get_cached_transform();
+			auto &t = node.get_transform();
+
+			node.get_cached_prev_transform() = cached;
+			SIMD::convert_transform(locals[i], t.rotation, t.scale, t.translation);
+			parents[i] = (parent ? parent->get_cached_transform() : identity_transform)[0].data;
+			outputs[i] = cached[0].data;
+		}
+
+		SIMD::get_dispatch().mul_affine(outputs, parents, locals[0][0].data, to_update);
+
+		for (size_t i = 0; i < to_update; i++)
+		{
+			auto &node = *updates[base + i];
+			node.update_timestamp();
+			node.clear_pending_update_no_atomic();
+		}
 	}
 }
 
@@ -954,7 +992,7 @@ NodeHandle Scene::create_skinned_node(const SceneFormats::Skin &skin)
 	for (size_t i = 0; i < skin.joint_transforms.size(); i++)
 	{
 		pskin->skin.push_back(bones[i]->transform.offset);
-		pskin->inverse_bind_poses.push_back(skin.inverse_bind_pose[i]);
+		pskin->inverse_bind_poses.push_back(mat_affine(skin.inverse_bind_pose[i]));
 	}
 	node->set_skin(pskin);
 
@@ -605,9 +605,22 @@ NodeHandle SceneLoader::parse_scene_format(const std::string &path, const std::s
 		auto &terrain = doc["terrain"];
 
 		Ground::TerrainInfo info;
-		info.heightmap = Path::relpath(path, terrain["heightmap"].GetString());
-		info.normalmap = Path::relpath(path, terrain["normalmap"].GetString());
-		info.occlusionmap = Path::relpath(path, terrain["occlusionmap"].GetString());
+		if (terrain.HasMember("tileDirectory"))
+		{
+			info.tile_directory = Path::relpath(path, terrain["tileDirectory"].GetString());
+			if (terrain.HasMember("tileSize"))
+				info.tile_size = terrain["tileSize"].GetUint();
+			if (terrain.HasMember("clipmapLevels"))
+				info.clipmap_levels = terrain["clipmapLevels"].GetUint();
+			if (terrain.HasMember("clipmapRingTiles"))
+				info.clipmap_ring_tiles = terrain["clipmapRingTiles"].GetUint();
+		}
+		else
+		{
+			info.heightmap = Path::relpath(path, terrain["heightmap"].GetString());
+			info.normalmap = Path::relpath(path, terrain["normalmap"].GetString());
+			info.occlusionmap = Path::relpath(path, terrain["occlusionmap"].GetString());
+		}
 		info.base_color = Path::relpath(path, terrain["baseColorTexture"].GetString());
 		info.normalmap_fine = Path::relpath(path, terrain["normalTexture"].GetString());
 		info.splatmap = Path::relpath(path, terrain["splatmapTexture"].GetString());
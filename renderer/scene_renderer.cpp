@@ -24,6 +24,7 @@
 #include "threaded_scene.hpp"
 #include "mesh_util.hpp"
 #include "muglm/matrix_helper.hpp"
+#include <algorithm>
 
 namespace Granite
 {
@@ -267,9 +268,9 @@ void RenderPassSceneRenderer::enqueue_prepare_render_pass(RenderGraph &, TaskCom
 		}
 
 		if (setup_data.flags & (SCENE_RENDERER_FORWARD_OPAQUE_BIT | SCENE_RENDERER_FORWARD_Z_PREPASS_BIT))
-			Threaded::scene_gather_opaque_renderables(*setup_data.scene, composer, setup_data.context->get_visibility_frustum(), visible_per_task, MaxTasks);
+			Threaded::scene_gather_opaque_renderables(*setup_data.scene, composer, setup_data.context->get_visibility_frustum(), visible_per_task, MaxTasks, &setup_data.context->get_device());
 		else if (setup_data.flags & SCENE_RENDERER_MOTION_VECTOR_BIT)
-			Threaded::scene_gather_motion_vector_renderables(*setup_data.scene, composer, setup_data.context->get_visibility_frustum(), visible_per_task, MaxTasks);
+			Threaded::scene_gather_motion_vector_renderables(*setup_data.scene, composer, setup_data.context->get_visibility_frustum(), visible_per_task, MaxTasks, &setup_data.context->get_device());
 
 		if (setup_data.flags & SCENE_RENDERER_FORWARD_Z_PREPASS_BIT)
 		{
@@ -311,7 +312,7 @@ void RenderPassSceneRenderer::enqueue_prepare_render_pass(RenderGraph &, TaskCom
 					setup_data.scene->gather_unbounded_renderables(visible_per_task[0]);
 			});
 		}
-		Threaded::scene_gather_opaque_renderables(*setup_data.scene, composer, setup_data.context->get_visibility_frustum(), visible_per_task, MaxTasks);
+		Threaded::scene_gather_opaque_renderables(*setup_data.scene, composer, setup_data.context->get_visibility_frustum(), visible_per_task, MaxTasks, &setup_data.context->get_device());
 		Threaded::compose_parallel_push_renderables(composer, *setup_data.context, queue_per_task_opaque,
 		                                            visible_per_task, MaxTasks,
 		                                            Threaded::PushType::Normal);
@@ -319,7 +320,7 @@ void RenderPassSceneRenderer::enqueue_prepare_render_pass(RenderGraph &, TaskCom
 
 	if (setup_data.flags & SCENE_RENDERER_FORWARD_TRANSPARENT_BIT)
 	{
-		Threaded::scene_gather_transparent_renderables(*setup_data.scene, composer, setup_data.context->get_visibility_frustum(), visible_per_task_transparent, MaxTasks);
+		Threaded::scene_gather_transparent_renderables(*setup_data.scene, composer, setup_data.context->get_visibility_frustum(), visible_per_task_transparent, MaxTasks, &setup_data.context->get_device());
 		Threaded::compose_parallel_push_renderables(composer, *setup_data.context, queue_per_task_transparent,
 		                                            visible_per_task_transparent, MaxTasks,
 		                                            Threaded::PushType::Normal);
@@ -331,14 +332,14 @@ void RenderPassSceneRenderer::enqueue_prepare_render_pass(RenderGraph &, TaskCom
 		{
 			Threaded::scene_gather_dynamic_shadow_renderables(*setup_data.scene, composer,
 			                                                  setup_data.context->get_visibility_frustum(),
-			                                                  visible_per_task, nullptr, MaxTasks);
+			                                                  visible_per_task, nullptr, MaxTasks, &setup_data.context->get_device());
 		}
 
 		if (setup_data.flags & SCENE_RENDERER_DEPTH_STATIC_BIT)
 		{
 			Threaded::scene_gather_static_shadow_renderables(*setup_data.scene, composer,
 			                                                 setup_data.context->get_visibility_frustum(),
-			                                                 visible_per_task, nullptr, MaxTasks);
+			                                                 visible_per_task, nullptr, MaxTasks, &setup_data.context->get_device());
 		}
 
 		Threaded::compose_parallel_push_renderables(composer, *setup_data.context, queue_per_task_depth,
@@ -347,17 +348,22 @@ void RenderPassSceneRenderer::enqueue_prepare_render_pass(RenderGraph &, TaskCom
 	}
 }
 
-void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd) const
+void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd, unsigned index, unsigned num_indices) const
 {
 	auto *suite = setup_data.suite;
 
+	// When recording in parallel, only the render queue is split.
+	// Anything recorded before or after it goes to the first or last command buffer respectively.
+	bool first = index == 0;
+	bool last = index + 1 == num_indices;
+
 	if (setup_data.flags & (SCENE_RENDERER_FORWARD_OPAQUE_BIT | SCENE_RENDERER_FORWARD_Z_PREPASS_BIT))
 	{
 		if (setup_data.flags & SCENE_RENDERER_FORWARD_Z_PREPASS_BIT)
 		{
-			suite->get_renderer(RendererSuite::Type::PrepassDepth).flush(cmd, queue_per_task_depth[0], *setup_data.context,
-			                                                             Renderer::NO_COLOR_BIT | Renderer::SKIP_SORTING_BIT |
-			                                                             flush_flags);
+			suite->get_renderer(RendererSuite::Type::PrepassDepth).flush_subset(cmd, queue_per_task_depth[0], *setup_data.context,
+			                                                                    Renderer::NO_COLOR_BIT | Renderer::SKIP_SORTING_BIT |
+			                                                                    flush_flags, nullptr, index, num_indices);
 		}
 
 		if (setup_data.flags & SCENE_RENDERER_FORWARD_OPAQUE_BIT)
@@ -365,9 +371,10 @@ void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd
 			Renderer::RendererOptionFlags opt = Renderer::SKIP_SORTING_BIT | flush_flags;
 			if (setup_data.flags & (SCENE_RENDERER_FORWARD_Z_PREPASS_BIT | SCENE_RENDERER_FORWARD_Z_EXISTING_PREPASS_BIT))
 				opt |= Renderer::DEPTH_STENCIL_READ_ONLY_BIT | Renderer::DEPTH_TEST_EQUAL_BIT;
-			suite->get_renderer(RendererSuite::Type::ForwardOpaque).flush(cmd, queue_per_task_opaque[0], *setup_data.context, opt);
+			suite->get_renderer(RendererSuite::Type::ForwardOpaque).flush_subset(cmd, queue_per_task_opaque[0], *setup_data.context,
+			                                                                    opt, nullptr, index, num_indices);
 
-			if (setup_data.flags & SCENE_RENDERER_DEBUG_PROBES_BIT)
+			if (last && (setup_data.flags & SCENE_RENDERER_DEBUG_PROBES_BIT))
 			{
 				render_debug_probes(suite->get_renderer(RendererSuite::Type::ForwardOpaque), cmd,
 				                    queue_non_tasked,
@@ -378,22 +385,24 @@ void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd
 
 	if (setup_data.flags & SCENE_RENDERER_MOTION_VECTOR_BIT)
 	{
-		if (setup_data.flags & SCENE_RENDERER_MOTION_VECTOR_FULL_BIT)
+		if (first && (setup_data.flags & SCENE_RENDERER_MOTION_VECTOR_FULL_BIT))
 			resolve_full_motion_vectors(cmd, *setup_data.context);
 
 		Renderer::RendererOptionFlags opt = Renderer::SKIP_SORTING_BIT |
 		                                    Renderer::DEPTH_STENCIL_READ_ONLY_BIT |
 		                                    Renderer::DEPTH_TEST_EQUAL_BIT |
 		                                    flush_flags;
-		suite->get_renderer(RendererSuite::Type::MotionVector).flush(cmd, queue_per_task_opaque[0], *setup_data.context, opt);
+		suite->get_renderer(RendererSuite::Type::MotionVector).flush_subset(cmd, queue_per_task_opaque[0], *setup_data.context,
+		                                                                   opt, nullptr, index, num_indices);
 	}
 
 	if (setup_data.flags & SCENE_RENDERER_DEFERRED_GBUFFER_BIT)
 	{
-		suite->get_renderer(RendererSuite::Type::Deferred).flush(cmd, queue_per_task_opaque[0], *setup_data.context,
-		                                                         Renderer::SKIP_SORTING_BIT | flush_flags);
+		suite->get_renderer(RendererSuite::Type::Deferred).flush_subset(cmd, queue_per_task_opaque[0], *setup_data.context,
+		                                                                Renderer::SKIP_SORTING_BIT | flush_flags,
+		                                                                nullptr, index, num_indices);
 
-		if (setup_data.flags & SCENE_RENDERER_DEBUG_PROBES_BIT)
+		if (last && (setup_data.flags & SCENE_RENDERER_DEBUG_PROBES_BIT))
 		{
 			render_debug_probes(suite->get_renderer(RendererSuite::Type::Deferred), cmd,
 			                    queue_non_tasked,
@@ -401,10 +410,10 @@ void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd
 		}
 	}
 
-	if (setup_data.flags & SCENE_RENDERER_DEFERRED_GBUFFER_LIGHT_PREPASS_BIT)
+	if (last && (setup_data.flags & SCENE_RENDERER_DEFERRED_GBUFFER_LIGHT_PREPASS_BIT))
 		setup_data.deferred_lights->render_prepass_lights(cmd, queue_non_tasked, *setup_data.context);
 
-	if (setup_data.flags & SCENE_RENDERER_DEFERRED_LIGHTING_BIT)
+	if (last && (setup_data.flags & SCENE_RENDERER_DEFERRED_LIGHTING_BIT))
 	{
 		if (!(setup_data.flags & SCENE_RENDERER_DEFERRED_CLUSTER_BIT))
 			setup_data.deferred_lights->render_lights(cmd, queue_non_tasked, *setup_data.context);
@@ -413,27 +422,68 @@ void RenderPassSceneRenderer::build_render_pass_inner(Vulkan::CommandBuffer &cmd
 
 	if (setup_data.flags & SCENE_RENDERER_FORWARD_TRANSPARENT_BIT)
 	{
-		suite->get_renderer(RendererSuite::Type::ForwardTransparent).flush(cmd, queue_per_task_transparent[0], *setup_data.context,
-		                                                                   Renderer::DEPTH_STENCIL_READ_ONLY_BIT | Renderer::SKIP_SORTING_BIT |
-		                                                                   flush_flags);
+		suite->get_renderer(RendererSuite::Type::ForwardTransparent).flush_subset(cmd, queue_per_task_transparent[0], *setup_data.context,
+		                                                                          Renderer::DEPTH_STENCIL_READ_ONLY_BIT | Renderer::SKIP_SORTING_BIT |
+		                                                                          flush_flags, nullptr, index, num_indices);
 	}
 
 	if (setup_data.flags & SCENE_RENDERER_DEPTH_BIT)
 	{
 		auto type = get_depth_renderer_type(setup_data.flags);
-		suite->get_renderer(type).flush(cmd, queue_per_task_depth[0], *setup_data.context,
-		                                Renderer::DEPTH_BIAS_BIT | Renderer::SKIP_SORTING_BIT | flush_flags);
+		suite->get_renderer(type).flush_subset(cmd, queue_per_task_depth[0], *setup_data.context,
+		                                       Renderer::DEPTH_BIAS_BIT | Renderer::SKIP_SORTING_BIT | flush_flags,
+		                                       nullptr, index, num_indices);
 	}
 }
 
 void RenderPassSceneRenderer::build_render_pass(Vulkan::CommandBuffer &cmd) const
 {
-	build_render_pass_inner(cmd);
+	build_render_pass_inner(cmd, 0, 1);
 }
 
 void RenderPassSceneRenderer::build_render_pass(Vulkan::CommandBuffer &cmd)
 {
-	build_render_pass_inner(cmd);
+	build_render_pass_inner(cmd, 0, 1);
+}
+
+void RenderPassSceneRenderer::build_render_pass_parallel(Vulkan::CommandBuffer &cmd, unsigned index, unsigned num_indices)
+{
+	build_render_pass_inner(cmd, index, num_indices);
+}
+
+unsigned RenderPassSceneRenderer::get_num_parallel_command_buffers() const
+{
+	// Subsets of different queues cannot be interleaved, since the second queue must be recorded after the first.
+	unsigned num_queues = 0;
+	if (setup_data.flags & SCENE_RENDERER_FORWARD_Z_PREPASS_BIT)
+		num_queues++;
+	if (setup_data.flags & SCENE_RENDERER_FORWARD_OPAQUE_BIT)
+		num_queues++;
+	if (setup_data.flags & SCENE_RENDERER_MOTION_VECTOR_BIT)
+		num_queues++;
+	if (setup_data.flags & SCENE_RENDERER_DEFERRED_GBUFFER_BIT)
+		num_queues++;
+	if (setup_data.flags & SCENE_RENDERER_FORWARD_TRANSPARENT_BIT)
+		num_queues++;
+	if (setup_data.flags & SCENE_RENDERER_DEPTH_BIT)
+		num_queues++;
+
+	if (num_queues != 1)
+		return 1;
+
+	// Lighting is recorded before these queues, which does not fit the first/last split.
+	if ((setup_data.flags & (SCENE_RENDERER_FORWARD_TRANSPARENT_BIT | SCENE_RENDERER_DEPTH_BIT)) != 0 &&
+	    (setup_data.flags & (SCENE_RENDERER_DEFERRED_GBUFFER_LIGHT_PREPASS_BIT | SCENE_RENDERER_DEFERRED_LIGHTING_BIT)) != 0)
+	{
+		return 1;
+	}
+
+	return num_parallel_command_buffers;
+}
+
+void RenderPassSceneRenderer::set_num_parallel_command_buffers(unsigned count)
+{
+	num_parallel_command_buffers = std::max(count, 1u);
 }
 
 void RenderPassSceneRenderer::set_clear_color(const VkClearColorValue &value)
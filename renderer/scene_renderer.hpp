@@ -69,10 +69,15 @@ public:
 	void init(const Setup &setup);
 	void set_clear_color(const VkClearColorValue &value);
 	void set_extra_flush_flags(Renderer::RendererFlushFlags flags);
+	// Splits the render queue into contiguous ranges which are recorded in parallel.
+	// Only takes effect if the pass flushes a single render queue.
+	void set_num_parallel_command_buffers(unsigned count);
 
 	void build_render_pass(Vulkan::CommandBuffer &cmd) const;
 	void build_render_pass(Vulkan::CommandBuffer &cmd) override;
 	bool get_clear_color(unsigned attachment, VkClearColorValue *value) const override;
+	unsigned get_num_parallel_command_buffers() const override;
+	void build_render_pass_parallel(Vulkan::CommandBuffer &cmd, unsigned index, unsigned num_indices) override;
 	void enqueue_prepare_render_pass(RenderGraph &graph, TaskComposer &composer) override;
 
 	// An immediate version of enqueue_prepare_render_pass.
@@ -82,6 +87,7 @@ protected:
 	Setup setup_data = {};
 	VkClearColorValue clear_color_value = {};
 	Renderer::RendererFlushFlags flush_flags = 0;
+	unsigned num_parallel_command_buffers = 1;
 
 	// These need to be per-thread, and thus are hoisted out as state in RenderPassSceneRenderer.
 	enum { MaxTasks = 4 };
@@ -92,7 +98,7 @@ protected:
 	RenderQueue queue_per_task_transparent[MaxTasks];
 	mutable RenderQueue queue_non_tasked;
 
-	void build_render_pass_inner(Vulkan::CommandBuffer &cmd) const;
+	void build_render_pass_inner(Vulkan::CommandBuffer &cmd, unsigned index, unsigned num_indices) const;
 	void setup_debug_probes();
 	void render_debug_probes(const Renderer &renderer, Vulkan::CommandBuffer &cmd, RenderQueue &queue,
 	                         const RenderContext &context) const;
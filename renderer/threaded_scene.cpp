@@ -22,59 +22,81 @@
 
 #include "threaded_scene.hpp"
 #include "render_context.hpp"
+#include "device.hpp"
 #include <algorithm>
 
 namespace Granite
 {
 namespace Threaded
 {
+// CPU intervals only resolve to anything if the device consumes CPU timestamps,
+// either through timeline tracing or frame samples.
+static Vulkan::QueryPoolHandle begin_cpu_interval(Vulkan::Device *device)
+{
+	return device ? device->write_calibrated_timestamp() : Vulkan::QueryPoolHandle{};
+}
+
+static void end_cpu_interval(Vulkan::Device *device, Vulkan::QueryPoolHandle start_ts, const char *tag)
+{
+	if (start_ts)
+		device->register_time_interval("CPU", std::move(start_ts), device->write_calibrated_timestamp(), tag);
+}
+
 void scene_gather_opaque_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
-                                     VisibilityList *lists, unsigned num_tasks)
+                                     VisibilityList *lists, unsigned num_tasks, Vulkan::Device *device)
 {
 	auto &group = composer.begin_pipeline_stage();
 	group.set_desc("gather-opaque-renderables");
 	for (unsigned i = 0; i < num_tasks; i++)
 	{
-		group.enqueue_task([&frustum, lists, &scene, i, num_tasks]() {
+		group.enqueue_task([&frustum, lists, &scene, i, num_tasks, device]() {
+			auto start_ts = begin_cpu_interval(device);
 			scene.gather_visible_opaque_renderables_subset(frustum, lists[i], i, num_tasks);
+			end_cpu_interval(device, std::move(start_ts), "culling");
 		});
 	}
 }
 
 void scene_gather_motion_vector_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
-                                            VisibilityList *lists, unsigned num_tasks)
+                                            VisibilityList *lists, unsigned num_tasks, Vulkan::Device *device)
 {
 	auto &group = composer.begin_pipeline_stage();
 	group.set_desc("gather-motion-vector-renderables");
 	for (unsigned i = 0; i < num_tasks; i++)
 	{
-		group.enqueue_task([&frustum, lists, &scene, i, num_tasks]() {
+		group.enqueue_task([&frustum, lists, &scene, i, num_tasks, device]() {
+			auto start_ts = begin_cpu_interval(device);
 			scene.gather_visible_motion_vector_renderables_subset(frustum, lists[i], i, num_tasks);
+			end_cpu_interval(device, std::move(start_ts), "culling");
 		});
 	}
 }
 
 void scene_gather_transparent_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
-                                          VisibilityList *lists, unsigned num_tasks)
+                                          VisibilityList *lists, unsigned num_tasks, Vulkan::Device *device)
 {
 	auto &group = composer.begin_pipeline_stage();
 	group.set_desc("gather-transparent-renderables");
 	for (unsigned i = 0; i < num_tasks; i++)
 	{
-		group.enqueue_task([&frustum, lists, &scene, i, num_tasks]() {
+		group.enqueue_task([&frustum, lists, &scene, i, num_tasks, device]() {
+			auto start_ts = begin_cpu_interval(device);
 			scene.gather_visible_transparent_renderables_subset(frustum, lists[i], i, num_tasks);
+			end_cpu_interval(device, std::move(start_ts), "culling");
 		});
 	}
 }
 
 void scene_gather_static_shadow_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
-                                            VisibilityList *lists, Util::Hash *transform_hashes, unsigned num_tasks)
+                                            VisibilityList *lists, Util::Hash *transform_hashes, unsigned num_tasks,
+                                            Vulkan::Device *device)
 {
 	auto &group = composer.begin_pipeline_stage();
 	group.set_desc("gather-static-shadow-renderables");
 	for (unsigned i = 0; i < num_tasks; i++)
 	{
-		group.enqueue_task([&frustum, lists, &scene, i, num_tasks, transform_hashes]() {
+		group.enqueue_task([&frustum, lists, &scene, i, num_tasks, transform_hashes, device]() {
+			auto start_ts = begin_cpu_interval(device);
 			if (transform_hashes)
 				transform_hashes[i] = 0;
 
@@ -84,18 +106,21 @@ void scene_gather_static_shadow_renderables(const Scene &scene, TaskComposer &co
 			if (transform_hashes)
 				for (auto &v : lists[i])
 					transform_hashes[i] ^= v.transform_hash;
+			end_cpu_interval(device, std::move(start_ts), "culling");
 		});
 	}
 }
 
 void scene_gather_dynamic_shadow_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
-                                             VisibilityList *lists, Util::Hash *transform_hashes, unsigned num_tasks)
+                                             VisibilityList *lists, Util::Hash *transform_hashes, unsigned num_tasks,
+                                             Vulkan::Device *device)
 {
 	auto &group = composer.begin_pipeline_stage();
 	group.set_desc("gather-dynamic-shadow-renderables");
 	for (unsigned i = 0; i < num_tasks; i++)
 	{
-		group.enqueue_task([&frustum, lists, &scene, i, num_tasks, transform_hashes]() {
+		group.enqueue_task([&frustum, lists, &scene, i, num_tasks, transform_hashes, device]() {
+			auto start_ts = begin_cpu_interval(device);
 			if (transform_hashes)
 				transform_hashes[i] = 0;
 
@@ -105,6 +130,7 @@ void scene_gather_dynamic_shadow_renderables(const Scene &scene, TaskComposer &c
 			if (transform_hashes)
 				for (auto &v : lists[i])
 					transform_hashes[i] ^= v.transform_hash;
+			end_cpu_interval(device, std::move(start_ts), "culling");
 		});
 	}
 }
@@ -155,8 +181,8 @@ void scene_gather_positional_light_renderables_sorted(const Scene &scene, TaskCo
 			std::sort(lights.begin(), lights.end(), [&context](const auto &a, const auto &b) -> bool {
 				auto *transform_a = a.transform;
 				auto *transform_b = b.transform;
-				vec3 pos_a = transform_a->get_world_transform()[3].xyz();
-				vec3 pos_b = transform_b->get_world_transform()[3].xyz();
+				vec3 pos_a = transform_a->get_affine_world_transform().get_translation();
+				vec3 pos_b = transform_b->get_affine_world_transform().get_translation();
 				float dist_a = dot(pos_a, context.get_render_parameters().camera_front);
 				float dist_b = dot(pos_b, context.get_render_parameters().camera_front);
 				return dist_a < dist_b;
@@ -175,6 +201,8 @@ void compose_parallel_push_renderables(TaskComposer &composer, const RenderConte
 		for (unsigned i = 0; i < count; i++)
 		{
 			group.enqueue_task([i, &context, visibility, queues, type]() {
+				auto *device = &context.get_device();
+				auto start_ts = begin_cpu_interval(device);
 				switch (type)
 				{
 				default:
@@ -189,6 +217,7 @@ void compose_parallel_push_renderables(TaskComposer &composer, const RenderConte
 					queues[i].push_motion_vector_renderables(context, visibility[i].data(), visibility[i].size());
 					break;
 				}
+				end_cpu_interval(device, std::move(start_ts), "render queue push");
 			});
 		}
 	}
@@ -196,10 +225,13 @@ void compose_parallel_push_renderables(TaskComposer &composer, const RenderConte
 	{
 		auto &group = composer.begin_pipeline_stage();
 		group.set_desc("parallel-push-renderables-sort");
-		group.enqueue_task([=]() {
+		group.enqueue_task([=, &context]() {
+			auto *device = &context.get_device();
+			auto start_ts = begin_cpu_interval(device);
 			for (unsigned i = 1; i < count; i++)
 				queues[0].combine_render_info(queues[i]);
 			queues[0].sort();
+			end_cpu_interval(device, std::move(start_ts), "render queue sort");
 		});
 	}
 }
@@ -34,17 +34,20 @@ namespace Granite
 namespace Threaded
 {
 void scene_gather_opaque_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
-                                     VisibilityList *lists, unsigned num_tasks);
+                                     VisibilityList *lists, unsigned num_tasks,
+                                     Vulkan::Device *device = nullptr);
 void scene_gather_motion_vector_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
-                                            VisibilityList *lists, unsigned num_tasks);
+                                            VisibilityList *lists, unsigned num_tasks,
+                                            Vulkan::Device *device = nullptr);
 void scene_gather_transparent_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
-                                          VisibilityList *lists, unsigned num_tasks);
+                                          VisibilityList *lists, unsigned num_tasks,
+                                          Vulkan::Device *device = nullptr);
 void scene_gather_static_shadow_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
                                             VisibilityList *lists, Util::Hash *transform_hashes,
-                                            unsigned num_tasks);
+                                            unsigned num_tasks, Vulkan::Device *device = nullptr);
 void scene_gather_dynamic_shadow_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
                                              VisibilityList *lists, Util::Hash *transform_hashes,
-                                             unsigned num_tasks);
+                                             unsigned num_tasks, Vulkan::Device *device = nullptr);
 void scene_gather_positional_light_renderables(const Scene &scene, TaskComposer &composer, const Frustum &frustum,
                                                VisibilityList *lists, unsigned num_tasks);
 void scene_gather_positional_light_renderables_sorted(const Scene &scene, TaskComposer &composer, const RenderContext &context,
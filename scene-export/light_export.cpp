@@ -59,7 +59,7 @@ std::string export_lights_to_json(const DirectionalParameters &dir, Scene &scene
 	for (auto &light : pos)
 	{
 		auto *l = get_component<PositionalLightComponent>(light)->light;
-		auto &world_transform = get_component<RenderInfoComponent>(light)->get_world_transform();
+		auto world_transform = get_component<RenderInfoComponent>(light)->get_world_transform();
 
 		Value light_pos(kArrayType);
 		light_pos.PushBack(world_transform[3].x, allocator);
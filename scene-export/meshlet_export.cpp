@@ -24,10 +24,13 @@
 #include "meshoptimizer.h"
 #include "enum_cast.hpp"
 #include "math.hpp"
+#include "muglm/muglm_impl.hpp"
 #include "filesystem.hpp"
 #include "meshlet.hpp"
+#include "thread_group.hpp"
 #include <type_traits>
 #include <limits>
+#include <algorithm>
 
 namespace Granite
 {
@@ -59,12 +62,24 @@ struct Meshlet
 {
 	uint32_t global_indices_offset;
 	uint32_t primitive_count;
-	uint32_t vertex_count;
+	uint32_t vertex_count = 0;
 
 	const unsigned char *local_indices;
 	const uint32_t *attribute_remap;
 };
 
+struct LodLevel
+{
+	std::vector<meshopt_Meshlet> raw_meshlets;
+	std::vector<uint32_t> vertex_redirection_buffer;
+	std::vector<unsigned char> local_index_buffer;
+
+	std::vector<Meshlet> meshlets;
+	std::vector<uvec3> index_buffer;
+	std::vector<LodBound> lod_bounds;
+	Encoded encoded;
+};
+
 static i16vec3 encode_vec3_to_snorm_exp(vec3 v, int scale_log2)
 {
 	v.x = ldexpf(v.x, scale_log2);
@@ -109,9 +124,8 @@ static void adjust_quant(std::vector<T> &values, int &exp)
 	exp += extra_shift;
 }
 
-static std::vector<i16vec3> mesh_extract_position_snorm_exp(const SceneFormats::Mesh &mesh, int &exp)
+static std::vector<vec3> mesh_extract_positions(const SceneFormats::Mesh &mesh)
 {
-	std::vector<i16vec3> encoded_positions;
 	std::vector<vec3> positions;
 
 	size_t num_positions = mesh.positions.size() / mesh.position_stride;
@@ -136,6 +150,16 @@ static std::vector<i16vec3> mesh_extract_position_snorm_exp(const SceneFormats::
 		return {};
 	}
 
+	return positions;
+}
+
+static std::vector<i16vec3> mesh_extract_position_snorm_exp(const SceneFormats::Mesh &mesh, int &exp)
+{
+	std::vector<i16vec3> encoded_positions;
+	std::vector<vec3> positions = mesh_extract_positions(mesh);
+	if (positions.empty())
+		return {};
+
 	vec3 max_extent = vec3(0.0f);
 	for (auto &p : positions)
 		max_extent = max(max_extent, abs(p));
@@ -162,11 +186,9 @@ struct NormalTangent
 	bool t_sign;
 };
 
-static std::vector<NormalTangent> mesh_extract_normal_tangent_oct8(const SceneFormats::Mesh &mesh)
+static bool mesh_extract_normals_tangents(const SceneFormats::Mesh &mesh,
+                                          std::vector<vec4> &normals, std::vector<vec4> &tangents)
 {
-	std::vector<NormalTangent> encoded_attributes;
-	std::vector<vec4> normals;
-	std::vector<vec4> tangents;
 
 	auto &normal = mesh.attribute_layout[Util::ecast(MeshAttribute::Normal)];
 	auto &tangent = mesh.attribute_layout[Util::ecast(MeshAttribute::Tangent)];
@@ -192,7 +214,7 @@ static std::vector<NormalTangent> mesh_extract_normal_tangent_oct8(const SceneFo
 	else
 	{
 		LOGE("Unexpected format %u.\n", normal.format);
-		return {};
+		return false;
 	}
 
 	if (tangent.format == VK_FORMAT_R32G32B32_SFLOAT)
@@ -222,9 +244,21 @@ static std::vector<NormalTangent> mesh_extract_normal_tangent_oct8(const SceneFo
 	else
 	{
 		LOGE("Unexpected format %u.\n", tangent.format);
-		return {};
+		return false;
 	}
 
+	return true;
+}
+
+static std::vector<NormalTangent> mesh_extract_normal_tangent_oct8(const SceneFormats::Mesh &mesh)
+{
+	std::vector<NormalTangent> encoded_attributes;
+	std::vector<vec4> normals;
+	std::vector<vec4> tangents;
+
+	if (!mesh_extract_normals_tangents(mesh, normals, tangents))
+		return {};
+
 	encoded_attributes.reserve(normals.size());
 
 	std::vector<i8vec4> n(normals.size());
@@ -238,9 +272,8 @@ static std::vector<NormalTangent> mesh_extract_normal_tangent_oct8(const SceneFo
 	return encoded_attributes;
 }
 
-static std::vector<i16vec2> mesh_extract_uv_snorm_scale(const SceneFormats::Mesh &mesh, int &exp)
+static std::vector<vec2> mesh_extract_uvs(const SceneFormats::Mesh &mesh)
 {
-	std::vector<i16vec2> encoded_uvs;
 	std::vector<vec2> uvs;
 
 	size_t num_uvs = mesh.attributes.size() / mesh.attribute_stride;
@@ -273,6 +306,14 @@ static std::vector<i16vec2> mesh_extract_uv_snorm_scale(const SceneFormats::Mesh
 		return {};
 	}
 
+	return uvs;
+}
+
+static std::vector<i16vec2> mesh_extract_uv_snorm_scale(const SceneFormats::Mesh &mesh, int &exp)
+{
+	std::vector<i16vec2> encoded_uvs;
+	std::vector<vec2> uvs = mesh_extract_uvs(mesh);
+
 	vec2 max_extent = vec2(0.0f);
 	for (auto &uv : uvs)
 	{
@@ -452,117 +493,178 @@ static void encode_attribute_stream(std::vector<PayloadWord> &out_payload_buffer
 	encode_bitplane(out_payload_buffer, attributes, bits, num_attributes);
 }
 
-static void encode_mesh(Encoded &encoded,
-                        const Meshlet *meshlets, size_t num_meshlets,
-						const void * const *pp_data,
-						const int *p_aux,
-                        unsigned num_streams)
+struct EncodeBatch
 {
-	encoded = {};
-	auto &mesh = encoded.mesh;
-	assert(num_streams > 0);
-	mesh.stream_count = num_streams;
-
-	mesh.meshlets.reserve(num_meshlets);
-	uint32_t base_vertex_offset = 0;
+	std::vector<PayloadWord> payload;
 	uint32_t stream_payload_count[MaxStreams] = {};
+	uint32_t vertex_count = 0;
+};
+
+// Stream offsets are relative to the batch payload until batches are concatenated.
+static void encode_meshlet(EncodeBatch &batch, Metadata &out_meshlet, const Meshlet &meshlet,
+                           const void * const *pp_data, const int *p_aux, unsigned num_streams)
+{
+	out_meshlet = {};
 
-	for (uint32_t meshlet_index = 0; meshlet_index < num_meshlets; meshlet_index++)
 	{
-		auto &meshlet = meshlets[meshlet_index];
-		Metadata out_meshlet = {};
+		auto &index_stream = out_meshlet.streams[int(StreamType::Primitive)];
+		index_stream.offset_in_words = uint32_t(batch.payload.size());
 
-		{
-			auto &index_stream = out_meshlet.streams[int(StreamType::Primitive)];
-			index_stream.offset_in_words = uint32_t(encoded.payload.size());
+		u8vec3 index_stream_buffer[MaxElements];
+		for (uint32_t i = 0; i < meshlet.primitive_count; i++)
+			memcpy(index_stream_buffer[i].data, meshlet.local_indices + 3 * i, 3);
+		for (uint32_t i = meshlet.primitive_count; i < MaxElements; i++)
+			index_stream_buffer[i] = u8vec3(0);
 
-			u8vec3 index_stream_buffer[MaxElements];
-			for (uint32_t i = 0; i < meshlet.primitive_count; i++)
-				memcpy(index_stream_buffer[i].data, meshlet.local_indices + 3 * i, 3);
-			for (uint32_t i = meshlet.primitive_count; i < MaxElements; i++)
-				index_stream_buffer[i] = u8vec3(0);
+		auto &counts = index_stream.u.counts;
+		counts.prim_count = meshlet.primitive_count;
+		counts.vert_count = meshlet.vertex_count;
 
-			auto &counts = index_stream.u.counts;
-			counts.prim_count = meshlet.primitive_count;
-			counts.vert_count = meshlet.vertex_count;
+		auto start_count = batch.payload.size();
+		encode_index_stream(batch.payload, index_stream_buffer, meshlet.primitive_count);
+		auto end_count = batch.payload.size();
 
-			auto start_count = encoded.payload.size();
-			encode_index_stream(encoded.payload, index_stream_buffer, meshlet.primitive_count);
-			auto end_count = encoded.payload.size();
+		batch.stream_payload_count[int(StreamType::Primitive)] += end_count - start_count;
+		batch.vertex_count += meshlet.vertex_count;
+	}
 
-			stream_payload_count[int(StreamType::Primitive)] += end_count - start_count;
-			base_vertex_offset += meshlet.vertex_count;
-		}
+	for (uint32_t stream_index = 1; stream_index < num_streams; stream_index++)
+	{
+		auto &stream = out_meshlet.streams[stream_index];
+		stream.offset_in_words = uint32_t(batch.payload.size());
 
-		for (uint32_t stream_index = 1; stream_index < num_streams; stream_index++)
+		uint32_t start_count = batch.payload.size();
+		switch (StreamType(stream_index))
+		{
+		case StreamType::Position:
+			encode_attribute_stream(batch.payload, stream,
+			                        static_cast<const u16vec3 *>(pp_data[stream_index]),
+			                        meshlet.attribute_remap, meshlet.vertex_count);
+			stream.bits |= uint32_t(p_aux[stream_index] << 16);
+			break;
+
+		case StreamType::UV:
+			encode_attribute_stream(batch.payload, stream,
+			                        static_cast<const u16vec2 *>(pp_data[stream_index]),
+			                        meshlet.attribute_remap, meshlet.vertex_count);
+			stream.bits |= uint32_t(p_aux[stream_index] << 16);
+			break;
+
+		case StreamType::NormalTangentOct8:
 		{
-			auto &stream = out_meshlet.streams[stream_index];
-			stream.offset_in_words = uint32_t(encoded.payload.size());
+			u8vec4 nts[MaxElements]{};
+			uint32_t sign_mask = 0;
+			auto *nt = static_cast<const NormalTangent *>(pp_data[stream_index]);
+			for (unsigned i = 0; i < meshlet.vertex_count; i++)
+			{
+				const auto &mapped_nt = nt[meshlet.attribute_remap[i]];
+				sign_mask |= uint32_t(mapped_nt.t_sign) << i;
+				nts[i] = u8vec4(u8vec2(mapped_nt.n), u8vec2(mapped_nt.t));
+			}
 
-			uint32_t start_count = encoded.payload.size();
-			switch (StreamType(stream_index))
+			if (meshlet.vertex_count < MaxElements && sign_mask == (1u << meshlet.vertex_count) - 1)
+				sign_mask = UINT32_MAX;
+
+			uint32_t aux;
+			if (sign_mask == 0)
 			{
-			case StreamType::Position:
-				encode_attribute_stream(encoded.payload, stream,
-				                        static_cast<const u16vec3 *>(pp_data[stream_index]),
-				                        meshlet.attribute_remap, meshlet.vertex_count);
-				stream.bits |= uint32_t(p_aux[stream_index] << 16);
-				break;
-
-			case StreamType::UV:
-				encode_attribute_stream(encoded.payload, stream,
-				                        static_cast<const u16vec2 *>(pp_data[stream_index]),
-				                        meshlet.attribute_remap, meshlet.vertex_count);
-				stream.bits |= uint32_t(p_aux[stream_index] << 16);
-				break;
-
-			case StreamType::NormalTangentOct8:
+				aux = 1;
+			}
+			else if (sign_mask == UINT32_MAX)
 			{
-				u8vec4 nts[MaxElements]{};
-				uint32_t sign_mask = 0;
-				auto *nt = static_cast<const NormalTangent *>(pp_data[stream_index]);
+				aux = 2;
+			}
+			else
+			{
+				// Sign bits must be embedded before encoding.
+				aux = 3;
 				for (unsigned i = 0; i < meshlet.vertex_count; i++)
 				{
-					const auto &mapped_nt = nt[meshlet.attribute_remap[i]];
-					sign_mask |= uint32_t(mapped_nt.t_sign) << i;
-					nts[i] = u8vec4(u8vec2(mapped_nt.n), u8vec2(mapped_nt.t));
+					nts[i].w &= ~1;
+					nts[i].w |= (sign_mask >> i) & 1u;
 				}
+			}
 
-				if (meshlet.vertex_count < MaxElements && sign_mask == (1u << meshlet.vertex_count) - 1)
-					sign_mask = UINT32_MAX;
+			encode_attribute_stream(batch.payload, stream, nts, nullptr, meshlet.vertex_count);
+			stream.bits |= aux << 16;
 
-				encode_attribute_stream(encoded.payload, stream, nts, nullptr, meshlet.vertex_count);
+			break;
+		}
 
-				if (sign_mask == 0)
-				{
-					stream.bits |= 1 << 16;
-				}
-				else if (sign_mask == UINT32_MAX)
-				{
-					stream.bits |= 2 << 16;
-				}
-				else
-				{
-					stream.bits |= 3 << 16;
-					for (unsigned i = 0; i < meshlet.vertex_count; i++)
-					{
-						nts[i].w &= ~1;
-						nts[i].w |= (sign_mask >> i) & 1u;
-					}
-				}
+		default:
+			break;
+		}
 
-				break;
-			}
+		uint32_t end_count = batch.payload.size();
+		batch.stream_payload_count[stream_index] += end_count - start_count;
+	}
+}
 
-			default:
-				break;
-			}
+static void encode_mesh(Encoded &encoded,
+                        const Meshlet *meshlets, size_t num_meshlets,
+                        const void * const *pp_data,
+                        const int *p_aux,
+                        unsigned num_streams,
+                        bool serial)
+{
+	encoded = {};
+	auto &mesh = encoded.mesh;
+	assert(num_streams > 0);
+	mesh.stream_count = num_streams;
+	mesh.meshlets.resize(num_meshlets);
+
+	// Batches are fixed size, so the output is the same no matter how many threads end up encoding.
+	// Batch payloads are rebased when concatenated, so a serial encode as one batch matches as well.
+	const size_t meshlets_per_batch = serial ? std::max<size_t>(num_meshlets, 1) : 1024;
+	size_t num_batches = (num_meshlets + meshlets_per_batch - 1) / meshlets_per_batch;
+	std::vector<EncodeBatch> batches(num_batches);
+
+	const auto encode_batch = [&](size_t batch_index) {
+		auto &batch = batches[batch_index];
+		size_t begin_index = batch_index * meshlets_per_batch;
+		size_t end_index = std::min(begin_index + meshlets_per_batch, num_meshlets);
+		for (size_t i = begin_index; i < end_index; i++)
+			encode_meshlet(batch, mesh.meshlets[i], meshlets[i], pp_data, p_aux, num_streams);
+	};
+
+	auto *group = serial ? nullptr : GRANITE_THREAD_GROUP();
+	if (group && num_batches > 1)
+	{
+		auto task = group->create_task();
+		task->set_desc("meshlet-encode");
+		for (size_t i = 0; i < num_batches; i++)
+			task->enqueue_task([&encode_batch, i]() { encode_batch(i); });
+		task->flush();
+		task->wait();
+	}
+	else
+	{
+		for (size_t i = 0; i < num_batches; i++)
+			encode_batch(i);
+	}
 
-			uint32_t end_count = encoded.payload.size();
-			stream_payload_count[stream_index] += end_count - start_count;
-		}
+	uint32_t base_vertex_offset = 0;
+	size_t stream_payload_count[MaxStreams] = {};
+	size_t total_payload_words = 0;
+	for (auto &batch : batches)
+		total_payload_words += batch.payload.size();
+	encoded.payload.reserve(total_payload_words);
 
-		mesh.meshlets.push_back(out_meshlet);
+	for (size_t batch_index = 0; batch_index < num_batches; batch_index++)
+	{
+		auto &batch = batches[batch_index];
+		auto base_offset = uint32_t(encoded.payload.size());
+
+		size_t begin_index = batch_index * meshlets_per_batch;
+		size_t end_index = std::min(begin_index + meshlets_per_batch, num_meshlets);
+		for (size_t i = begin_index; i < end_index; i++)
+			for (unsigned stream_index = 0; stream_index < num_streams; stream_index++)
+				mesh.meshlets[i].streams[stream_index].offset_in_words += base_offset;
+
+		encoded.payload.insert(encoded.payload.end(), batch.payload.begin(), batch.payload.end());
+		for (unsigned i = 0; i < MaxStreams; i++)
+			stream_payload_count[i] += batch.stream_payload_count[i];
+		base_vertex_offset += batch.vertex_count;
 	}
 
 	for (unsigned i = 0; i < MaxStreams; i++)
@@ -571,29 +673,67 @@ static void encode_mesh(Encoded &encoded,
 	LOGI("Total encoded vertices: %u\n", base_vertex_offset);
 }
 
-static bool export_encoded_mesh(const std::string &path, const Encoded &encoded)
+static size_t compute_mesh_block_size(const Encoded &encoded)
 {
-	size_t required_size = 0;
+	size_t size = sizeof(FormatHeader);
+	size += encoded.bounds.size() * sizeof(Bound);
+	size += encoded.mesh.stream_count * encoded.mesh.meshlets.size() * sizeof(Stream);
+	return size;
+}
 
+static unsigned char *write_mesh_block(unsigned char *ptr, const Encoded &encoded,
+                                       uint32_t payload_size_words, uint32_t payload_offset)
+{
 	FormatHeader header = {};
 
 	header.style = encoded.mesh.mesh_style;
 	header.stream_count = encoded.mesh.stream_count;
 	header.meshlet_count = uint32_t(encoded.mesh.meshlets.size());
-	header.payload_size_words = uint32_t(encoded.payload.size());
+	header.payload_size_words = payload_size_words;
 
-	required_size += sizeof(magic);
-	required_size += sizeof(FormatHeader);
+	memcpy(ptr, &header, sizeof(header));
+	ptr += sizeof(header);
+
+	memcpy(ptr, encoded.bounds.data(), encoded.bounds.size() * sizeof(Bound));
+	ptr += encoded.bounds.size() * sizeof(Bound);
+
+	for (uint32_t i = 0; i < header.meshlet_count; i++)
+	{
+		for (uint32_t j = 0; j < header.stream_count; j++)
+		{
+			auto stream = encoded.mesh.meshlets[i].streams[j];
+			stream.offset_in_words += payload_offset;
+			memcpy(ptr, &stream, sizeof(Stream));
+			ptr += sizeof(Stream);
+		}
+	}
+
+	return ptr;
+}
 
-	// Bounds.
-	required_size += encoded.bounds.size() * sizeof(Bound);
+static bool export_encoded_mesh(const std::string &path, const std::vector<LodLevel> &levels)
+{
+	size_t required_size = 0;
+	size_t payload_size_words = 0;
 
-	// Stream metadata.
-	required_size += encoded.mesh.stream_count * encoded.mesh.meshlets.size() * sizeof(Stream);
+	for (auto &level : levels)
+		payload_size_words += level.encoded.payload.size();
+
+	required_size += sizeof(magic);
+	required_size += compute_mesh_block_size(levels.front().encoded);
 
 	// Payload.
 	// Need a padding word to speed up decoder.
-	required_size += (encoded.payload.size() + 1) * sizeof(PayloadWord);
+	required_size += (payload_size_words + 1) * sizeof(PayloadWord);
+
+	// LOD section. The base level only needs its LOD bounds.
+	required_size += sizeof(lod_magic) + sizeof(LodFormatHeader);
+	required_size += levels.front().lod_bounds.size() * sizeof(LodBound);
+	for (size_t i = 1; i < levels.size(); i++)
+	{
+		required_size += compute_mesh_block_size(levels[i].encoded);
+		required_size += levels[i].lod_bounds.size() * sizeof(LodBound);
+	}
 
 	auto file = GRANITE_FILESYSTEM()->open(path, FileMode::WriteOnly);
 	if (!file)
@@ -607,77 +747,148 @@ static bool export_encoded_mesh(const std::string &path, const Encoded &encoded)
 
 	memcpy(ptr, magic, sizeof(magic));
 	ptr += sizeof(magic);
-	memcpy(ptr, &header, sizeof(header));
-	ptr += sizeof(header);
+	ptr = write_mesh_block(ptr, levels.front().encoded, uint32_t(payload_size_words), 0);
 
-	memcpy(ptr, encoded.bounds.data(), encoded.bounds.size() * sizeof(Bound));
-	ptr += encoded.bounds.size() * sizeof(Bound);
+	// All levels share one payload, so every level can be decoded with the same payload buffer.
+	for (auto &level : levels)
+	{
+		memcpy(ptr, level.encoded.payload.data(), level.encoded.payload.size() * sizeof(PayloadWord));
+		ptr += level.encoded.payload.size() * sizeof(PayloadWord);
+	}
+	memset(ptr, 0, sizeof(PayloadWord));
+	ptr += sizeof(PayloadWord);
 
-	for (uint32_t i = 0; i < header.meshlet_count; i++)
+	LodFormatHeader lod_header = {};
+	lod_header.level_count = uint32_t(levels.size());
+	memcpy(ptr, lod_magic, sizeof(lod_magic));
+	ptr += sizeof(lod_magic);
+	memcpy(ptr, &lod_header, sizeof(lod_header));
+	ptr += sizeof(lod_header);
+
+	memcpy(ptr, levels.front().lod_bounds.data(), levels.front().lod_bounds.size() * sizeof(LodBound));
+	ptr += levels.front().lod_bounds.size() * sizeof(LodBound);
+
+	uint32_t payload_offset = uint32_t(levels.front().encoded.payload.size());
+	for (size_t i = 1; i < levels.size(); i++)
 	{
-		for (uint32_t j = 0; j < header.stream_count; j++)
-		{
-			memcpy(ptr, &encoded.mesh.meshlets[i].streams[j], sizeof(Stream));
-			ptr += sizeof(Stream);
-		}
+		auto &level = levels[i];
+		ptr = write_mesh_block(ptr, level.encoded, uint32_t(payload_size_words), payload_offset);
+		memcpy(ptr, level.lod_bounds.data(), level.lod_bounds.size() * sizeof(LodBound));
+		ptr += level.lod_bounds.size() * sizeof(LodBound);
+		payload_offset += uint32_t(level.encoded.payload.size());
 	}
 
-	memcpy(ptr, encoded.payload.data(), encoded.payload.size() * sizeof(PayloadWord));
-	ptr += encoded.payload.size() * sizeof(PayloadWord);
-	memset(ptr, 0, sizeof(PayloadWord));
 	return true;
 }
 
-static float compute_sq_dist(const Bound &a, const Bound &b)
+// Average radius of a sphere enclosing each chunk, relative to the average meshlet radius.
+// Lower is better. 1.0 would mean chunks are no larger than their meshlets.
+static float compute_chunk_locality(const Bound *bounds, const uint32_t *order, size_t num_bounds)
 {
-	float dx = a.center[0] - b.center[0];
-	float dy = a.center[1] - b.center[1];
-	float dz = a.center[2] - b.center[2];
-	return dx * dx + dy * dy + dz * dz;
-}
+	if (!num_bounds)
+		return 0.0f;
 
-static size_t find_closest_sphere(const Bound *bounds, size_t num_bounds, const Bound &reference_bound)
-{
-	size_t best_index = 0;
-	float best_sq_dist = compute_sq_dist(bounds[0], reference_bound);
-	for (size_t i = 1; i < num_bounds; i++)
+	float total_chunk_radius = 0.0f;
+	float total_radius = 0.0f;
+	size_t num_chunks = 0;
+
+	for (size_t i = 0; i < num_bounds; i += ChunkFactor)
 	{
-		float sq_dist = compute_sq_dist(bounds[i], reference_bound);
-		if (sq_dist < best_sq_dist)
+		size_t count = std::min<size_t>(num_bounds - i, ChunkFactor);
+
+		vec3 center = vec3(0.0f);
+		for (size_t j = 0; j < count; j++)
 		{
-			best_index = i;
-			best_sq_dist = sq_dist;
+			auto &bound = bounds[order[i + j]];
+			center = center + vec3(bound.center[0], bound.center[1], bound.center[2]);
 		}
+		center = center / float(count);
+
+		float chunk_radius = 0.0f;
+		for (size_t j = 0; j < count; j++)
+		{
+			auto &bound = bounds[order[i + j]];
+			float dist = distance(center, vec3(bound.center[0], bound.center[1], bound.center[2]));
+			chunk_radius = std::max(chunk_radius, dist + bound.radius);
+			total_radius += bound.radius;
+		}
+
+		total_chunk_radius += chunk_radius;
+		num_chunks++;
 	}
 
-	return best_index;
+	float avg_radius = total_radius / float(num_bounds);
+	float avg_chunk_radius = total_chunk_radius / float(num_chunks);
+	return avg_radius > 0.0f ? avg_chunk_radius / avg_radius : 0.0f;
 }
 
-// FIXME: O(n^2). Revisit if this becomes a real problem.
-static void sort_bounds(Bound *bound, size_t num_bounds,
-                        Meshlet *meshlets, Metadata *metadata)
+// Recursive median split along the longest axis, like a k-d tree build.
+// Split points are aligned to ChunkFactor, so every chunk except the last one is full
+// and contains meshlets from a single leaf.
+static void partition_bounds(const Bound *bounds, uint32_t *order, size_t count)
 {
-	for (size_t offset = 1; offset < num_bounds; offset++)
+	if (count <= ChunkFactor)
 	{
-		size_t cluster_offset = offset & ~(ChunkFactor - 1);
+		// Keep the original order within a chunk, meshoptimizer already emits meshlets with good locality.
+		std::sort(order, order + count);
+		return;
+	}
 
-		// Starts a new cluster.
-		if (cluster_offset == offset)
-			continue;
+	vec3 lo = vec3(std::numeric_limits<float>::max());
+	vec3 hi = vec3(-std::numeric_limits<float>::max());
+	for (size_t i = 0; i < count; i++)
+	{
+		auto &bound = bounds[order[i]];
+		vec3 c = vec3(bound.center[0], bound.center[1], bound.center[2]);
+		lo = min(lo, c);
+		hi = max(hi, c);
+	}
 
-		size_t index = find_closest_sphere(
-				bound + offset, num_bounds - offset,
-				bound[cluster_offset]);
+	vec3 extent = hi - lo;
+	unsigned axis = 0;
+	if (extent.y > extent.x)
+		axis = 1;
+	if (extent.z > extent[axis])
+		axis = 2;
+
+	size_t num_chunks = (count + ChunkFactor - 1) / ChunkFactor;
+	size_t split = (num_chunks / 2) * ChunkFactor;
+
+	// Break ties on index so the partition is deterministic.
+	std::nth_element(order, order + split, order + count, [&](uint32_t a, uint32_t b) {
+		float ca = bounds[a].center[axis];
+		float cb = bounds[b].center[axis];
+		return ca < cb || (ca == cb && a < b);
+	});
+
+	partition_bounds(bounds, order, split);
+	partition_bounds(bounds, order + split, count - split);
+}
 
-		index += offset;
+template <typename T>
+static void apply_permutation(T *values, const uint32_t *order, size_t count)
+{
+	std::vector<T> tmp(values, values + count);
+	for (size_t i = 0; i < count; i++)
+		values[i] = tmp[order[i]];
+}
 
-		if (index != offset)
-		{
-			std::swap(bound[offset], bound[index]);
-			std::swap(meshlets[offset], meshlets[index]);
-			std::swap(metadata[offset], metadata[index]);
-		}
-	}
+static void sort_bounds(Bound *bound, size_t num_bounds,
+                        Meshlet *meshlets, Metadata *metadata, LodBound *lod_bounds)
+{
+	std::vector<uint32_t> order(num_bounds);
+	for (size_t i = 0; i < num_bounds; i++)
+		order[i] = uint32_t(i);
+
+	float locality_before = compute_chunk_locality(bound, order.data(), num_bounds);
+	partition_bounds(bound, order.data(), num_bounds);
+	float locality_after = compute_chunk_locality(bound, order.data(), num_bounds);
+	LOGI("Chunk locality (chunk radius / meshlet radius): %.3f -> %.3f\n", locality_before, locality_after);
+
+	apply_permutation(bound, order.data(), num_bounds);
+	apply_permutation(meshlets, order.data(), num_bounds);
+	apply_permutation(metadata, order.data(), num_bounds);
+	apply_permutation(lod_bounds, order.data(), num_bounds);
 }
 
 static void encode_bounds(std::vector<Bound> &bounds,
@@ -729,7 +940,311 @@ static void encode_bounds(std::vector<Bound> &bounds,
 	LOGI("Average cutoff %.3f (%zu bounds)\n", total_cutoff, num_new_bounds);
 }
 
-bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, MeshStyle style)
+// Clusters the triangles, all new meshlets share the same LOD bound.
+static void append_meshlets(LodLevel &level, const uint32_t *indices, size_t index_count,
+                            const vec3 *position_buffer, size_t position_count,
+                            const LodBound &lod)
+{
+	constexpr unsigned max_vertices = MaxElements;
+	constexpr unsigned max_primitives = MaxElements;
+	size_t num_meshlets = meshopt_buildMeshletsBound(index_count, max_vertices, max_primitives);
+
+	size_t meshlet_base = level.raw_meshlets.size();
+	size_t vertex_base = level.vertex_redirection_buffer.size();
+	size_t triangle_base = level.local_index_buffer.size();
+
+	level.raw_meshlets.resize(meshlet_base + num_meshlets);
+	level.vertex_redirection_buffer.resize(vertex_base + num_meshlets * max_vertices);
+	level.local_index_buffer.resize(triangle_base + num_meshlets * max_primitives * 3);
+
+	num_meshlets = meshopt_buildMeshlets(level.raw_meshlets.data() + meshlet_base,
+	                                     level.vertex_redirection_buffer.data() + vertex_base,
+	                                     level.local_index_buffer.data() + triangle_base,
+	                                     indices, index_count,
+	                                     position_buffer[0].data, position_count, sizeof(vec3),
+	                                     max_vertices, max_primitives, 0.5f);
+
+	level.raw_meshlets.resize(meshlet_base + num_meshlets);
+	for (size_t i = meshlet_base; i < level.raw_meshlets.size(); i++)
+	{
+		level.raw_meshlets[i].vertex_offset += vertex_base;
+		level.raw_meshlets[i].triangle_offset += triangle_base;
+	}
+
+	if (num_meshlets)
+	{
+		auto &last = level.raw_meshlets.back();
+		level.vertex_redirection_buffer.resize(last.vertex_offset + last.vertex_count);
+		level.local_index_buffer.resize(last.triangle_offset + last.triangle_count * 3);
+	}
+	else
+	{
+		level.vertex_redirection_buffer.resize(vertex_base);
+		level.local_index_buffer.resize(triangle_base);
+	}
+
+	level.lod_bounds.insert(level.lod_bounds.end(), num_meshlets, lod);
+}
+
+// Resolves pointers once the level is complete, since appending invalidates them.
+static void finalize_meshlets(LodLevel &level)
+{
+	level.meshlets.clear();
+	level.index_buffer.clear();
+	level.meshlets.reserve(level.raw_meshlets.size());
+
+	for (auto &meshlet : level.raw_meshlets)
+	{
+		Meshlet m = {};
+
+		auto *local_indices = level.local_index_buffer.data() + meshlet.triangle_offset;
+		auto *remap = level.vertex_redirection_buffer.data() + meshlet.vertex_offset;
+		m.local_indices = local_indices;
+		m.attribute_remap = remap;
+		m.primitive_count = meshlet.triangle_count;
+		m.vertex_count = meshlet.vertex_count;
+		m.global_indices_offset = uint32_t(level.index_buffer.size());
+
+		for (unsigned i = 0; i < meshlet.triangle_count; i++)
+		{
+			level.index_buffer.emplace_back(
+					remap[local_indices[3 * i + 0]],
+					remap[local_indices[3 * i + 1]],
+					remap[local_indices[3 * i + 2]]);
+		}
+
+		level.meshlets.push_back(m);
+	}
+}
+
+// Sphere enclosing all cluster spheres. Error is the maximum error of the clusters,
+// so that error never decreases when moving up the hierarchy.
+static LodBound merge_lod_bounds(const LodBound *lods, size_t count)
+{
+	vec3 center = vec3(0.0f);
+	for (size_t i = 0; i < count; i++)
+		center = center + vec3(lods[i].center[0], lods[i].center[1], lods[i].center[2]);
+	center = center / float(count);
+
+	LodBound merged = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		float dist = distance(center, vec3(lods[i].center[0], lods[i].center[1], lods[i].center[2]));
+		merged.radius = std::max(merged.radius, dist + lods[i].radius);
+		merged.error = std::max(merged.error, lods[i].error);
+	}
+
+	memcpy(merged.center, center.data, sizeof(merged.center));
+	merged.parent_error = std::numeric_limits<float>::max();
+	return merged;
+}
+
+// Groups neighboring clusters, simplifies each group with locked borders and re-clusters the result.
+// Group borders stay intact, so any cut through the hierarchy is crack-free.
+// Returns false if no group could be simplified any further.
+static bool build_lod_level(LodLevel &level, LodLevel &next_level,
+                            const vec3 *position_buffer, size_t position_count, float error_scale)
+{
+	// Meshlets are sorted spatially at this point, so chunks make reasonable groups.
+	constexpr size_t GroupSize = ChunkFactor;
+	std::vector<uint32_t> group_indices;
+	std::vector<uint32_t> simplified;
+	bool progress = false;
+
+	for (size_t group = 0; group < level.meshlets.size(); group += GroupSize)
+	{
+		size_t count = std::min<size_t>(level.meshlets.size() - group, GroupSize);
+
+		group_indices.clear();
+		for (size_t i = group; i < group + count; i++)
+		{
+			auto &meshlet = level.meshlets[i];
+			auto *indices = level.index_buffer[meshlet.global_indices_offset].data;
+			group_indices.insert(group_indices.end(), indices, indices + 3 * meshlet.primitive_count);
+		}
+
+		size_t target_index_count = (group_indices.size() / 6) * 3;
+		simplified.resize(group_indices.size());
+		float simplify_error = 0.0f;
+		size_t simplified_count = meshopt_simplify(simplified.data(), group_indices.data(), group_indices.size(),
+		                                           position_buffer[0].data, position_count, sizeof(vec3),
+		                                           target_index_count, std::numeric_limits<float>::max(),
+		                                           meshopt_SimplifyLockBorder, &simplify_error);
+
+		// If locked borders prevent meaningful simplification, these clusters become roots.
+		if (simplified_count == 0 || simplified_count > (group_indices.size() * 85) / 100)
+			continue;
+
+		LodBound group_bound = merge_lod_bounds(level.lod_bounds.data() + group, count);
+		group_bound.error += simplify_error * error_scale;
+
+		for (size_t i = group; i < group + count; i++)
+		{
+			auto &lod = level.lod_bounds[i];
+			memcpy(lod.parent_center, group_bound.center, sizeof(lod.parent_center));
+			lod.parent_radius = group_bound.radius;
+			lod.parent_error = group_bound.error;
+		}
+
+		append_meshlets(next_level, simplified.data(), simplified_count,
+		                position_buffer, position_count, group_bound);
+		progress = true;
+	}
+
+	return progress;
+}
+
+static bool verify_decoded_level(const SceneFormats::Mesh &mesh, MeshStyle style, const LodLevel &level,
+                                 const DecodedMesh &decoded, int position_exp, int uv_exp)
+{
+	auto positions = mesh_extract_positions(mesh);
+	std::vector<vec2> uvs;
+	std::vector<vec4> normals, tangents;
+	if (style != MeshStyle::Wireframe)
+	{
+		uvs = mesh_extract_uvs(mesh);
+		if (!mesh_extract_normals_tangents(mesh, normals, tangents))
+			return false;
+	}
+
+	// Rounding to nearest, so error is at most half a quantization step.
+	// UVs are encoded as 2 * uv - 1, which halves the error again.
+	float position_tolerance = ldexpf(0.5f, position_exp) * 1.0001f;
+	float uv_tolerance = ldexpf(0.25f, uv_exp) * 1.0001f + 1e-6f;
+	constexpr float normal_tolerance = 0.02f;
+
+	float max_position_error = 0.0f;
+	float max_uv_error = 0.0f;
+	float max_normal_error = 0.0f;
+
+	uint32_t base_vertex = 0;
+	uint32_t base_primitive = 0;
+
+	for (size_t meshlet_index = 0; meshlet_index < level.meshlets.size(); meshlet_index++)
+	{
+		auto &meshlet = level.meshlets[meshlet_index];
+
+		for (uint32_t i = 0; i < meshlet.primitive_count; i++)
+		{
+			auto &ref = level.index_buffer[meshlet.global_indices_offset + i];
+			for (unsigned c = 0; c < 3; c++)
+			{
+				uint32_t local_index = decoded.indices[3 * (base_primitive + i) + c] - base_vertex;
+				if (local_index >= meshlet.vertex_count || meshlet.attribute_remap[local_index] != ref[c])
+				{
+					LOGE("Verify: index mismatch in meshlet %zu, primitive %u.\n", meshlet_index, i);
+					return false;
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < meshlet.vertex_count; i++)
+		{
+			uint32_t src = meshlet.attribute_remap[i];
+			uint32_t dst = base_vertex + i;
+
+			vec3 pos = vec3(decoded.positions[3 * dst + 0], decoded.positions[3 * dst + 1], decoded.positions[3 * dst + 2]);
+			float pos_error = max_component(abs(pos - positions[src]));
+			max_position_error = std::max(max_position_error, pos_error);
+			if (pos_error > position_tolerance)
+			{
+				LOGE("Verify: position error %.6f exceeds %.6f in meshlet %zu, vertex %u.\n",
+				     pos_error, position_tolerance, meshlet_index, i);
+				return false;
+			}
+
+			if (style == MeshStyle::Wireframe)
+				continue;
+
+			vec2 uv = vec2(decoded.uvs[2 * dst + 0], decoded.uvs[2 * dst + 1]);
+			float uv_error = max_component(abs(uv - uvs[src]));
+			max_uv_error = std::max(max_uv_error, uv_error);
+			if (uv_error > uv_tolerance)
+			{
+				LOGE("Verify: UV error %.6f exceeds %.6f in meshlet %zu, vertex %u.\n",
+				     uv_error, uv_tolerance, meshlet_index, i);
+				return false;
+			}
+
+			// Degenerate inputs have no meaningful encoding.
+			vec3 n = normals[src].xyz();
+			if (dot(n, n) > 1e-8f)
+			{
+				vec3 decoded_n = vec3(decoded.normals[3 * dst + 0], decoded.normals[3 * dst + 1], decoded.normals[3 * dst + 2]);
+				float n_error = max_component(abs(decoded_n - normalize(n)));
+				max_normal_error = std::max(max_normal_error, n_error);
+				if (n_error > normal_tolerance)
+				{
+					LOGE("Verify: normal error %.6f in meshlet %zu, vertex %u.\n", n_error, meshlet_index, i);
+					return false;
+				}
+			}
+
+			vec3 t = tangents[src].xyz();
+			if (dot(t, t) > 1e-8f)
+			{
+				auto *decoded_t = &decoded.tangents[4 * dst];
+				float t_error = max_component(abs(vec3(decoded_t[0], decoded_t[1], decoded_t[2]) - normalize(t)));
+				max_normal_error = std::max(max_normal_error, t_error);
+				if (t_error > normal_tolerance || (decoded_t[3] < 0.0f) != (tangents[src].w < 0.0f))
+				{
+					LOGE("Verify: tangent mismatch in meshlet %zu, vertex %u.\n", meshlet_index, i);
+					return false;
+				}
+			}
+		}
+
+		base_vertex += meshlet.vertex_count;
+		base_primitive += meshlet.primitive_count;
+	}
+
+	LOGI("Verify: max error position %.6f, UV %.6f, normal/tangent %.6f.\n",
+	     max_position_error, max_uv_error, max_normal_error);
+	return true;
+}
+
+// Decodes every level on the CPU. The full detail level is also compared against the source mesh.
+static bool verify_exported_mesh(const std::string &path, const SceneFormats::Mesh &mesh, MeshStyle style,
+                                 const std::vector<LodLevel> &levels, int position_exp, int uv_exp)
+{
+	auto file = GRANITE_FILESYSTEM()->open(path, FileMode::ReadOnly);
+	if (!file)
+		return false;
+
+	auto mapping = file->map();
+	if (!mapping)
+		return false;
+
+	for (uint32_t level = 0; level < levels.size(); level++)
+	{
+		auto view = create_mesh_view(*mapping, level);
+		if (!view.format_header || view.num_lod_levels != levels.size())
+		{
+			LOGE("Verify: failed to create view for LOD %u.\n", level);
+			return false;
+		}
+
+		DecodedMesh decoded;
+		if (!decode_mesh_cpu(view, decoded))
+		{
+			LOGE("Verify: failed to decode LOD %u.\n", level);
+			return false;
+		}
+
+		if (decoded.indices.size() != levels[level].index_buffer.size() * 3)
+		{
+			LOGE("Verify: primitive count mismatch in LOD %u.\n", level);
+			return false;
+		}
+
+		if (level == 0 && !verify_decoded_level(mesh, style, levels[level], decoded, position_exp, uv_exp))
+			return false;
+	}
+
+	return true;
+}
+
+bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, MeshStyle style, ExportFlags flags)
 {
 	mesh_deduplicate_vertices(mesh);
 	if (!mesh_optimize_index_buffer(mesh, {}))
@@ -787,65 +1302,72 @@ bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, Me
 	for (auto &p : positions)
 		position_buffer.push_back(decode_snorm_exp(p, aux[int(StreamType::Position)]));
 
-	constexpr unsigned max_vertices = MaxElements;
-	constexpr unsigned max_primitives = MaxElements;
-	size_t num_meshlets = meshopt_buildMeshletsBound(mesh.count, max_vertices, max_primitives);
-
-	std::vector<unsigned> out_vertex_redirection_buffer(num_meshlets * max_vertices);
-	std::vector<unsigned char> local_index_buffer(num_meshlets * max_primitives * 3);
-	std::vector<meshopt_Meshlet> meshlets(num_meshlets);
+	std::vector<LodLevel> levels;
+	levels.reserve(MaxLodLevels);
+	levels.emplace_back();
 
-	num_meshlets = meshopt_buildMeshlets(meshlets.data(),
-	                                     out_vertex_redirection_buffer.data(), local_index_buffer.data(),
-	                                     reinterpret_cast<const uint32_t *>(mesh.indices.data()), mesh.count,
-	                                     position_buffer[0].data, positions.size(), sizeof(vec3),
-	                                     max_vertices, max_primitives, 0.5f);
+	LodBound root_bound = {};
+	root_bound.parent_error = std::numeric_limits<float>::max();
+	append_meshlets(levels.front(), reinterpret_cast<const uint32_t *>(mesh.indices.data()), mesh.count,
+	                position_buffer.data(), positions.size(), root_bound);
 
-	meshlets.resize(num_meshlets);
+	// Simplification error is relative to mesh extents.
+	float error_scale = meshopt_simplifyScale(position_buffer[0].data, positions.size(), sizeof(vec3));
 
-	std::vector<Meshlet> out_meshlets;
-	std::vector<uvec3> out_index_buffer;
+	for (size_t level_index = 0; level_index < levels.size(); level_index++)
+	{
+		auto &level = levels[level_index];
+		finalize_meshlets(level);
 
-	out_meshlets.reserve(num_meshlets);
+		auto &encoded = level.encoded;
+		encode_mesh(encoded, level.meshlets.data(), level.meshlets.size(),
+		            p_data, aux, num_attribute_streams + 1,
+		            (flags & EXPORT_SERIAL_ENCODE_BIT) != 0);
+		encoded.mesh.mesh_style = style;
 
-	for (auto &meshlet : meshlets)
-	{
-		Meshlet m = {};
+		// Compute bounds
+		encode_bounds(encoded.bounds, level.meshlets.data(), level.meshlets.size(),
+		              level.index_buffer.data(), position_buffer.data(), positions.size(),
+		              1);
 
-		auto *local_indices = local_index_buffer.data() + meshlet.triangle_offset;
-		m.local_indices = local_indices;
-		m.attribute_remap = out_vertex_redirection_buffer.data() + meshlet.vertex_offset;
-		m.primitive_count = meshlet.triangle_count;
-		m.vertex_count = meshlet.vertex_count;
-		m.global_indices_offset = uint32_t(out_index_buffer.size());
+		sort_bounds(encoded.bounds.data(), encoded.bounds.size(),
+		            level.meshlets.data(), encoded.mesh.meshlets.data(), level.lod_bounds.data());
 
-		for (unsigned i = 0; i < meshlet.triangle_count; i++)
+		// Full detail clusters have no error, their LOD bound is just the cluster bound.
+		if (level_index == 0)
 		{
-			out_index_buffer.emplace_back(
-					out_vertex_redirection_buffer[local_indices[3 * i + 0] + meshlet.vertex_offset],
-					out_vertex_redirection_buffer[local_indices[3 * i + 1] + meshlet.vertex_offset],
-					out_vertex_redirection_buffer[local_indices[3 * i + 2] + meshlet.vertex_offset]);
+			for (size_t i = 0; i < level.lod_bounds.size(); i++)
+			{
+				memcpy(level.lod_bounds[i].center, encoded.bounds[i].center, sizeof(encoded.bounds[i].center));
+				level.lod_bounds[i].radius = encoded.bounds[i].radius;
+			}
 		}
 
-		out_meshlets.push_back(m);
-	}
-
-	Encoded encoded;
-	encode_mesh(encoded, out_meshlets.data(), out_meshlets.size(),
-	            p_data, aux, num_attribute_streams + 1);
-	encoded.mesh.mesh_style = style;
+		encode_bounds(encoded.bounds, level.meshlets.data(), level.meshlets.size(),
+		              level.index_buffer.data(), position_buffer.data(), positions.size(),
+		              ChunkFactor);
 
-	// Compute bounds
-	encode_bounds(encoded.bounds, out_meshlets.data(), out_meshlets.size(),
-	              out_index_buffer.data(), position_buffer.data(), positions.size(),
-	              1);
+		if (levels.size() < MaxLodLevels && level.meshlets.size() > 1)
+		{
+			levels.emplace_back();
+			if (!build_lod_level(levels[level_index], levels.back(),
+			                     position_buffer.data(), positions.size(), error_scale))
+			{
+				levels.pop_back();
+			}
+		}
+	}
 
-	sort_bounds(encoded.bounds.data(), encoded.bounds.size(),
-	            out_meshlets.data(), encoded.mesh.meshlets.data());
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		float max_error = 0.0f;
+		for (auto &lod : levels[i].lod_bounds)
+			max_error = std::max(max_error, lod.error);
+		LOGI("LOD %zu: %zu meshlets, %zu primitives, max error %.6f\n",
+		     i, levels[i].meshlets.size(), levels[i].index_buffer.size(), max_error);
+	}
 
-	encode_bounds(encoded.bounds, out_meshlets.data(), out_meshlets.size(),
-	              out_index_buffer.data(), position_buffer.data(), positions.size(),
-				  ChunkFactor);
+	auto &encoded = levels.front().encoded;
 
 	LOGI("Exported meshlet:\n");
 	LOGI("  %zu meshlets\n", encoded.mesh.meshlets.size());
@@ -860,7 +1382,17 @@ bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, Me
 
 	LOGI("  %zu uncompressed bytes\n\n\n", uncompressed_bytes);
 
-	return export_encoded_mesh(path, encoded);
+	if (!export_encoded_mesh(path, levels))
+		return false;
+
+	if ((flags & EXPORT_VERIFY_DECODE_BIT) != 0 &&
+	    !verify_exported_mesh(path, mesh, style, levels, aux[int(StreamType::Position)], aux[int(StreamType::UV)]))
+	{
+		LOGE("Verification of %s failed.\n", path.c_str());
+		return false;
+	}
+
+	return true;
 }
 }
 }
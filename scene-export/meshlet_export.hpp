@@ -31,6 +31,17 @@ namespace Granite
 {
 namespace Meshlet
 {
-bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, Vulkan::Meshlet::MeshStyle style);
+enum ExportFlagBits : uint32_t
+{
+	// Decodes the exported file on the CPU and compares it against the source mesh within quantization error.
+	EXPORT_VERIFY_DECODE_BIT = 1 << 0,
+	// Encodes each LOD level as one batch on the calling thread, like a plain sequential encoder would.
+	// Output is identical to the default batched encode, so this is mostly useful to verify that.
+	EXPORT_SERIAL_ENCODE_BIT = 1 << 1
+};
+using ExportFlags = uint32_t;
+
+bool export_mesh_to_meshlet(const std::string &path, SceneFormats::Mesh mesh, Vulkan::Meshlet::MeshStyle style,
+                            ExportFlags flags = 0);
 }
 }
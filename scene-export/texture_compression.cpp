@@ -931,7 +931,14 @@ void CompressorState::enqueue_compression(ThreadGroup &group)
 	}
 
 	// Pass down ownership to final task.
-	auto write_task = group.create_task([state = shared_from_this()]() {
+	auto write_task = group.create_task([&group, state = shared_from_this()]() {
+		if (state->args.supercompression != Vulkan::TextureSupercompression::None &&
+		    !state->output->copy_to_path(*GRANITE_FILESYSTEM(), state->args.output,
+		                                 state->args.supercompression, &group))
+		{
+			LOGE("Failed to write supercompressed texture: %s\n", state->args.output.c_str());
+		}
+
 		if (state->total_error[0] != 0.0)
 			LOGI("Red PSNR: %.f dB\n", 10.0 * log10(255.0 * 255.0 / state->total_error[0]));
 		if (state->total_error[1] != 0.0)
@@ -993,7 +1000,12 @@ bool compress_texture(ThreadGroup &group, const CompressorArguments &args,
 			return;
 		}
 
-		if (!output->output->map_write(*GRANITE_FILESYSTEM(), output->args.output))
+		// Supercompressed textures are encoded to scratch memory first and written out at the end.
+		bool mapped = output->args.supercompression != Vulkan::TextureSupercompression::None ?
+		              output->output->map_write_scratch() :
+		              output->output->map_write(*GRANITE_FILESYSTEM(), output->args.output);
+
+		if (!mapped)
 		{
 			LOGE("Failed to map output texture for writing.\n");
 			if (output->signal)
@@ -55,6 +55,7 @@ struct CompressorArguments
 		VK_COMPONENT_SWIZZLE_A,
 	};
 	bool deferred_mipgen = false;
+	Vulkan::TextureSupercompression supercompression = Vulkan::TextureSupercompression::None;
 };
 
 VkFormat string_to_format(const std::string &s);
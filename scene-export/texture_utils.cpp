@@ -22,6 +22,7 @@
 
 #define NOMINMAX
 #include "texture_utils.hpp"
+#include "simd_dispatch.hpp"
 
 namespace Granite
 {
@@ -42,6 +43,10 @@ struct TextureFormatUnorm8
 		float q = muglm::clamp(muglm::round(v.x * 255.0f), 0.0f, 255.0f);
 		*layout.data_generic<uint8_t>(coord.x, coord.y, layer, mip) = uint8_t(q);
 	}
+	inline bool downsample_2x2(const Vulkan::TextureFormatLayout &, uint32_t, uint32_t, uint32_t, uint32_t) const
+	{
+		return false;
+	}
 };
 
 struct TextureFormatRG8Unorm
@@ -59,6 +64,10 @@ struct TextureFormatRG8Unorm
 		auto q = clamp(round(v.xy() * 255.0f), vec2(0.0f), vec2(255.0f));
 		*layout.data_generic<u8vec2>(coord.x, coord.y, layer, mip) = u8vec2(q);
 	}
+	inline bool downsample_2x2(const Vulkan::TextureFormatLayout &, uint32_t, uint32_t, uint32_t, uint32_t) const
+	{
+		return false;
+	}
 };
 
 struct TextureFormatRGBA8Unorm
@@ -76,6 +85,21 @@ struct TextureFormatRGBA8Unorm
 		auto q = clamp(round(v * 255.0f), vec4(0.0f), vec4(255.0f));
 		*layout.data_generic<u8vec4>(coord.x, coord.y, layer, mip) = u8vec4(q);
 	}
+
+	// Exact 2x2 box filter from level - 1, which is what the bilinear path computes when halving.
+	inline bool downsample_2x2(const Vulkan::TextureFormatLayout &layout, uint32_t width, uint32_t height,
+	                           uint32_t layer, uint32_t level) const
+	{
+		auto *downsample = SIMD::get_dispatch().downsample_rgba8;
+		for (uint32_t y = 0; y < height; y++)
+		{
+			auto *dst = layout.data_generic<u8vec4>(0, y, layer, level);
+			auto *row0 = layout.data_generic<u8vec4>(0, 2 * y + 0, layer, level - 1);
+			auto *row1 = layout.data_generic<u8vec4>(0, 2 * y + 1, layer, level - 1);
+			downsample(dst->data, row0->data, row1->data, width);
+		}
+		return true;
+	}
 };
 
 struct TextureFormatRGBA8Srgb
@@ -125,6 +149,10 @@ struct TextureFormatRGBA8Srgb
 		auto q = clamp(round(srgb_linear_to_gamma(v) * 255.0f), vec4(0.0f), vec4(255.0f));
 		*layout.data_generic<u8vec4>(coord.x, coord.y, layer, mip) = u8vec4(q);
 	}
+	inline bool downsample_2x2(const Vulkan::TextureFormatLayout &, uint32_t, uint32_t, uint32_t, uint32_t) const
+	{
+		return false;
+	}
 };
 
 template <typename Ops>
@@ -151,8 +179,13 @@ inline void generate_mipmaps(const Vulkan::TextureFormatLayout &dst_layout,
 		float rescale_width = src_width_f / float(dst_width);
 		float rescale_height = src_height_f / float(dst_height);
 
+		bool exact_halving = src_width == 2 * dst_width && src_height == 2 * dst_height;
+
 		for (uint32_t layer = 0; layer < dst_layout.get_layers(); layer++)
 		{
+			if (exact_halving && op.downsample_2x2(dst_layout, dst_width, dst_height, layer, level))
+				continue;
+
 			for (uint32_t y = 0; y < dst_height; y++)
 			{
 				float coord_y = (float(y) + 0.5f) * rescale_height - 0.5f;
@@ -1,6 +1,8 @@
 #include "asset_manager.hpp"
 #include "filesystem.hpp"
 #include "logging.hpp"
+#include <stdlib.h>
+#include <vector>
 
 using namespace Granite;
 
@@ -35,6 +37,256 @@ struct ActivationInterface final : AssetInstantiatorInterface
 	uint32_t bound = 0;
 };
 
+// Each asset has four levels, where the two coarsest form the pinned tail.
+struct LevelInterface final : AssetInstantiatorInterface
+{
+	uint64_t estimate_cost_asset(AssetID, File &) override
+	{
+		return level_cost(2);
+	}
+
+	void instantiate_asset(AssetManager &manager, TaskGroup *, AssetID id, File &) override
+	{
+		LOGI("Instantiating tail of ID: %u\n", id.id);
+		resident[id.id] = 2;
+		manager.update_level_costs(id, 4, 2, costs);
+		manager.update_cost(id, level_cost(2), 2);
+	}
+
+	void instantiate_asset_level(AssetManager &manager, TaskGroup *, AssetID id, File &, unsigned level) override
+	{
+		LOGI("ID: %u -> level %u\n", id.id, level);
+		resident[id.id] = level;
+		manager.update_cost(id, level_cost(level), level);
+	}
+
+	void release_asset(AssetID id) override
+	{
+		LOGI("Releasing ID: %u\n", id.id);
+	}
+
+	void set_id_bounds(uint32_t) override
+	{
+	}
+
+	void latch_handles() override
+	{
+	}
+
+	static uint64_t level_cost(unsigned level)
+	{
+		uint64_t cost = 0;
+		for (unsigned i = level; i < 4; i++)
+			cost += costs[i];
+		return cost;
+	}
+
+	static const uint64_t costs[4];
+	unsigned resident[2] = {};
+};
+
+const uint64_t LevelInterface::costs[4] = { 64, 16, 4, 1 };
+
+static bool check_residency(const AssetManager &manager, const LevelInterface &iface,
+                            unsigned level_x, unsigned level_y)
+{
+	uint64_t expected = LevelInterface::level_cost(level_x) + LevelInterface::level_cost(level_y);
+	uint64_t consumed = manager.get_current_total_consumed();
+	LOGI("Cost: %u\n", unsigned(consumed));
+
+	if (iface.resident[0] != level_x || iface.resident[1] != level_y || consumed != expected)
+	{
+		LOGE("Expected levels %u, %u for cost %u, got levels %u, %u for cost %u.\n",
+		     level_x, level_y, unsigned(expected),
+		     iface.resident[0], iface.resident[1], unsigned(consumed));
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_residency_levels(Filesystem &fs)
+{
+	LOGI("=== Residency levels ===\n");
+	AssetManager manager;
+	LevelInterface iface;
+
+	{ auto x = fs.open_writeonly_mapping("tmp://x", 1); }
+	{ auto y = fs.open_writeonly_mapping("tmp://y", 1); }
+	auto id_x = manager.register_asset(fs.open("tmp://x"), AssetClass::ImageColor);
+	auto id_y = manager.register_asset(fs.open("tmp://y"), AssetClass::ImageColor);
+	manager.set_asset_instantiator_interface(&iface);
+
+	// Not enough for both to be fully resident, so one of them should degrade rather than be released.
+	// X gets all its levels, and Y gets what is left over.
+	manager.set_asset_budget(120);
+	manager.set_asset_budget_per_iteration(1000);
+	manager.set_asset_residency_priority(id_x, 2);
+	manager.set_asset_residency_priority(id_y, 1);
+
+	for (unsigned i = 0; i < 5; i++)
+		manager.iterate(nullptr);
+	if (!check_residency(manager, iface, 0, 1))
+		return false;
+
+	// Y becomes more important, X should be trimmed to make room.
+	manager.set_asset_residency_priority(id_x, 1);
+	manager.set_asset_residency_priority(id_y, 2);
+	for (unsigned i = 0; i < 5; i++)
+		manager.iterate(nullptr);
+	if (!check_residency(manager, iface, 1, 0))
+		return false;
+
+	// Over budget, both should keep their tails.
+	manager.set_asset_budget(20);
+	for (unsigned i = 0; i < 3; i++)
+		manager.iterate(nullptr);
+	if (!check_residency(manager, iface, 2, 2))
+		return false;
+
+	// Plenty of budget. Y streams all its levels back in, but X only needs level 1.
+	manager.set_asset_budget(1000);
+	manager.set_asset_residency_target_level(id_x, 1);
+	for (unsigned i = 0; i < 3; i++)
+		manager.iterate(nullptr);
+	if (!check_residency(manager, iface, 1, 0))
+		return false;
+
+	// A coarser target trims Y back down to its tail, even though there is budget to spare.
+	manager.set_asset_residency_target_level(id_y, 2);
+	for (unsigned i = 0; i < 3; i++)
+		manager.iterate(nullptr);
+	if (!check_residency(manager, iface, 1, 2))
+		return false;
+
+	manager.set_asset_instantiator_interface(nullptr);
+	return true;
+}
+
+// Uploads only complete when the test says so.
+struct DeferredInterface final : AssetInstantiatorInterface
+{
+	uint64_t estimate_cost_asset(AssetID, File &) override
+	{
+		return 10;
+	}
+
+	void instantiate_asset(AssetManager &, TaskGroup *, AssetID id, File &) override
+	{
+		pending.push_back(id);
+	}
+
+	void release_asset(AssetID id) override
+	{
+		released.push_back(id);
+	}
+
+	void set_id_bounds(uint32_t) override
+	{
+	}
+
+	void latch_handles() override
+	{
+	}
+
+	void complete(AssetManager &manager)
+	{
+		for (auto id : pending)
+			manager.update_cost(id, 10);
+		pending.clear();
+	}
+
+	std::vector<AssetID> pending;
+	std::vector<AssetID> released;
+};
+
+static bool check_consumed(const AssetManager &manager, uint64_t expected)
+{
+	if (manager.get_current_total_consumed() != expected)
+	{
+		LOGE("Expected cost %u, got %u.\n", unsigned(expected), unsigned(manager.get_current_total_consumed()));
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_unregister(Filesystem &fs)
+{
+	LOGI("=== Unregister ===\n");
+	AssetManager manager;
+	DeferredInterface iface;
+
+	{ auto u0 = fs.open_writeonly_mapping("tmp://u0", 1); }
+	{ auto u1 = fs.open_writeonly_mapping("tmp://u1", 1); }
+	auto id_a = manager.register_asset(fs, "tmp://u0", AssetClass::ImageColor);
+	auto id_b = manager.register_asset(fs.open("tmp://u1"), AssetClass::ImageColor);
+	manager.set_asset_instantiator_interface(&iface);
+	manager.set_asset_budget(1000);
+	manager.set_asset_budget_per_iteration(1000);
+
+	manager.iterate(nullptr);
+	if (iface.pending.size() != 2)
+		return false;
+
+	// Still uploading, so it is only reclaimed once the upload lands.
+	manager.unregister_asset(id_a);
+	if (manager.set_asset_residency_priority(id_a, 1))
+	{
+		LOGE("Unregistered ID accepted a priority.\n");
+		return false;
+	}
+
+	// The path gets a fresh ID right away.
+	auto id_c = manager.register_asset(fs, "tmp://u0", AssetClass::ImageColor);
+	if (id_c.id == id_a.id || id_c.id == id_b.id)
+	{
+		LOGE("Path was not registered again.\n");
+		return false;
+	}
+
+	manager.iterate(nullptr);
+	if (!iface.released.empty() || !check_consumed(manager, 30))
+		return false;
+
+	iface.complete(manager);
+	manager.iterate(nullptr);
+	if (iface.released.size() != 1 || iface.released.front().id != id_a.id || !check_consumed(manager, 20))
+	{
+		LOGE("Unregistered asset was not released.\n");
+		return false;
+	}
+
+	// Reclaimed IDs are handed out again, and work like any other.
+	auto id_d = manager.register_asset(fs.open("tmp://u1"), AssetClass::ImageColor);
+	if (id_d.id != id_a.id)
+	{
+		LOGE("Expected ID %u to be recycled, got %u.\n", id_a.id, id_d.id);
+		return false;
+	}
+
+	if (!manager.set_asset_residency_priority(id_d, 1))
+	{
+		LOGE("Recycled ID rejected a priority.\n");
+		return false;
+	}
+
+	manager.iterate(nullptr);
+	iface.complete(manager);
+	manager.iterate(nullptr);
+	if (!check_consumed(manager, 30))
+		return false;
+
+	// Unregistering a resident asset releases it on the next iteration.
+	manager.unregister_asset(id_b);
+	manager.iterate(nullptr);
+	if (iface.released.size() != 2 || iface.released.back().id != id_b.id || !check_consumed(manager, 20))
+		return false;
+
+	manager.set_asset_instantiator_interface(nullptr);
+	return true;
+}
+
 int main()
 {
 	Filesystem fs;
@@ -79,4 +331,10 @@ int main()
 	manager.set_asset_budget(10);
 	manager.iterate(nullptr);
 	LOGI("Cost: %u\n", unsigned(manager.get_current_total_consumed()));
-}
\ No newline at end of file
+
+	if (!test_residency_levels(fs))
+		return EXIT_FAILURE;
+	if (!test_unregister(fs))
+		return EXIT_FAILURE;
+	return EXIT_SUCCESS;
+}
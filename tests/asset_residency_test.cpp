@@ -0,0 +1,115 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "asset_residency.hpp"
+#include "filesystem.hpp"
+#include "logging.hpp"
+#include <stdlib.h>
+
+using namespace Granite;
+
+static bool expect_priority(const AssetManager &manager, AssetID id, int prio, unsigned frame)
+{
+	int current = manager.get_asset_residency_priority(id);
+	if (current != prio)
+	{
+		LOGE("Frame %u: expected priority %d for ID %u, got %d.\n", frame, prio, id.id, current);
+		return false;
+	}
+
+	return true;
+}
+
+// Drives the feedback one frame at a time, with demand injected directly rather than gathered from a scene.
+// Returns false on the first frame where the priority does not match.
+static bool run_frames(AssetResidencyFeedback &feedback, AssetManager &manager, unsigned &frame,
+                       AssetID id, int demand, unsigned count, int prio)
+{
+	for (unsigned i = 0; i < count; i++, frame++)
+	{
+		if (demand >= 0)
+			feedback.add_demand(id, demand);
+		feedback.commit(manager);
+		if (!expect_priority(manager, id, prio, frame))
+			return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	Filesystem fs;
+	fs.register_protocol("tmp", std::make_unique<ScratchFilesystem>());
+	{ auto a = fs.open_writeonly_mapping("tmp://a", 1); }
+	{ auto b = fs.open_writeonly_mapping("tmp://b", 1); }
+
+	AssetManager manager;
+	auto id = manager.register_asset(fs.open("tmp://a"), AssetClass::ImageColor);
+	auto untouched = manager.register_asset(fs.open("tmp://b"), AssetClass::ImageColor, 2);
+
+	AssetResidencyFeedback feedback;
+	constexpr int Hold = AssetResidencyFeedback::HoldFrames;
+	constexpr int Evict = AssetResidencyFeedback::EvictFrames;
+	constexpr int Near = AssetResidencyFeedback::VisiblePriority + AssetResidencyFeedback::NumSizeBuckets - 1;
+	constexpr int Far = AssetResidencyFeedback::VisiblePriority;
+	unsigned frame = 0;
+
+	// First sighting raises the priority right away.
+	if (!run_frames(feedback, manager, frame, id, Near, 1, Near))
+		return EXIT_FAILURE;
+
+	// Moving away only lowers it once the raise has been held for HoldFrames.
+	if (!run_frames(feedback, manager, frame, id, Far, Hold - 1, Near))
+		return EXIT_FAILURE;
+	if (!run_frames(feedback, manager, frame, id, Far, 1, Far))
+		return EXIT_FAILURE;
+
+	// Coming back close is immediate again.
+	if (!run_frames(feedback, manager, frame, id, Near, 1, Near))
+		return EXIT_FAILURE;
+
+	// Out of view. Held for HoldFrames, then the lowest paged-in priority, then 0 after EvictFrames.
+	if (!run_frames(feedback, manager, frame, id, -1, Hold - 1, Near))
+		return EXIT_FAILURE;
+	if (!run_frames(feedback, manager, frame, id, -1, Evict - Hold, 1))
+		return EXIT_FAILURE;
+	if (!run_frames(feedback, manager, frame, id, -1, 1, 0))
+		return EXIT_FAILURE;
+
+	// Evicted assets are no longer tracked, so nothing overrides a priority set elsewhere.
+	manager.set_asset_residency_priority(id, 1);
+	if (!run_frames(feedback, manager, frame, id, -1, Evict + 1, 1))
+		return EXIT_FAILURE;
+
+	// Seen again, it starts over from scratch.
+	if (!run_frames(feedback, manager, frame, id, Far, 1, Far))
+		return EXIT_FAILURE;
+
+	// Assets never seen through the feedback keep whatever priority they were registered with.
+	if (!expect_priority(manager, untouched, 2, frame))
+		return EXIT_FAILURE;
+
+	LOGI("Residency feedback hysteresis OK.\n");
+	return EXIT_SUCCESS;
+}
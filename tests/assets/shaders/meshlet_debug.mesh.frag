@@ -22,7 +22,7 @@ layout(set = 0, binding = 2, std430) readonly buffer VBOATTR
 
 layout(set = 0, binding = 5, std430) readonly buffer Transforms
 {
-    mat4 data[];
+    mat3x4 data[];
 } transforms;
 #else
 layout(location = 0) in mediump vec3 vNormal;
@@ -55,7 +55,7 @@ void main()
     mediump vec3 normal = gl_BaryCoordEXT.x * decode_rgb10a2(na) +
         gl_BaryCoordEXT.y * decode_rgb10a2(nb) +
         gl_BaryCoordEXT.z * decode_rgb10a2(nc);
-    normal = mat3(transforms.data[vTransformIndex]) * normal;
+    normal = normal * mat3(transforms.data[vTransformIndex]);
     normal = normalize(normal);
 #else
     vec3 normal = normalize(vNormal);
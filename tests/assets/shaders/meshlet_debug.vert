@@ -36,14 +36,14 @@ layout(set = 0, binding = 0) readonly buffer DrawParameters
 
 layout(set = 0, binding = 1) readonly buffer Transforms
 {
-    mat4 data[];
+    mat3x4 data[];
 } transforms;
 #endif
 
 void main()
 {
 #if !SINGLE_INSTANCE_RENDER
-    mat4 M = transforms.data[draw_info.data[gl_DrawIDARB].node_offset];
+    mat4 M = affine_to_mat4(transforms.data[draw_info.data[gl_DrawIDARB].node_offset]);
 #endif
     vec3 world_pos = (M * vec4(POS, 1.0)).xyz;
     vNormal = mat3(M) * NORMAL;
@@ -0,0 +1,195 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "clipmap_ring.hpp"
+#include "muglm/muglm_impl.hpp"
+#include "logging.hpp"
+#include <random>
+#include <stdlib.h>
+
+using namespace Granite;
+
+static constexpr unsigned Ring = 6;
+static constexpr int NumTiles = 32;
+
+// Every tile in the window must map to its own slot, and only tiles inside the world are requested.
+static bool check_window(const ClipmapRing &ring)
+{
+	ivec2 origin = ring.get_origin();
+	std::vector<bool> seen(Ring * Ring);
+
+	for (int z = origin.y; z < origin.y + int(Ring); z++)
+	{
+		for (int x = origin.x; x < origin.x + int(Ring); x++)
+		{
+			unsigned index = ring.get_slot_index(ivec2(x, z));
+			if (seen[index])
+			{
+				LOGE("Tile (%d, %d) shares slot %u.\n", x, z, index);
+				return false;
+			}
+			seen[index] = true;
+
+			auto &slot = ring.get_slot(ivec2(x, z));
+			bool inside = x >= 0 && z >= 0 && x < NumTiles && z < NumTiles;
+			if (slot.tile.x != x || slot.tile.y != z || slot.requested != inside)
+			{
+				LOGE("Slot %u holds (%d, %d), requested %d, expected (%d, %d), requested %d.\n",
+				     index, slot.tile.x, slot.tile.y, int(slot.requested), x, z, int(inside));
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Moves the window, and checks that exactly the slots which changed tile were reported and invalidated.
+static bool move(ClipmapRing &ring, vec2 center, unsigned expected_updates)
+{
+	for (auto &slot : ring.get_slots())
+		slot.valid = true;
+	auto before = ring.get_slots();
+
+	std::vector<ClipmapRing::Update> updates;
+	bool moved = ring.recenter(center, updates);
+	if (moved != (expected_updates != 0) || updates.size() != expected_updates)
+	{
+		LOGE("Center (%.2f, %.2f): expected %u updates, got %u.\n",
+		     center.x, center.y, expected_updates, unsigned(updates.size()));
+		return false;
+	}
+
+	std::vector<bool> updated(Ring * Ring);
+	for (auto &update : updates)
+	{
+		auto &old = before[update.slot];
+		if (updated[update.slot] || old.tile.x != update.old_tile.x || old.tile.y != update.old_tile.y ||
+		    old.requested != update.old_requested)
+		{
+			LOGE("Slot %u was reported with the wrong previous tile.\n", update.slot);
+			return false;
+		}
+		updated[update.slot] = true;
+	}
+
+	auto &after = ring.get_slots();
+	for (unsigned i = 0; i < Ring * Ring; i++)
+	{
+		bool changed = after[i].tile.x != before[i].tile.x || after[i].tile.y != before[i].tile.y;
+		if (changed != updated[i] || after[i].valid == updated[i])
+		{
+			LOGE("Slot %u: changed %d, updated %d, valid %d.\n",
+			     i, int(changed), int(updated[i]), int(after[i].valid));
+			return false;
+		}
+	}
+
+	return check_window(ring);
+}
+
+int main()
+{
+	ClipmapRing ring;
+	ring.init(Ring, NumTiles);
+	if (ring.get_ring_size() != Ring || ring.get_slots().size() != Ring * Ring)
+		return EXIT_FAILURE;
+
+	// First placement fills every slot.
+	if (!move(ring, vec2(16.0f), Ring * Ring))
+		return EXIT_FAILURE;
+	if (ring.get_origin().x != 16 - int(Ring / 2) || ring.get_origin().y != 16 - int(Ring / 2))
+		return EXIT_FAILURE;
+
+	// Moving within the center tile does nothing.
+	if (!move(ring, vec2(16.4f, 15.6f), 0))
+		return EXIT_FAILURE;
+
+	// One tile along an axis only replaces the row or column which scrolled into view.
+	if (!move(ring, vec2(17.0f, 16.0f), Ring))
+		return EXIT_FAILURE;
+	if (!move(ring, vec2(17.0f, 15.0f), Ring))
+		return EXIT_FAILURE;
+
+	// Diagonally, a row and a column which share a corner.
+	if (!move(ring, vec2(16.0f, 16.0f), 2 * Ring - 1))
+		return EXIT_FAILURE;
+
+	// Moving further than the ring is wide replaces everything.
+	if (!move(ring, vec2(4.0f, 27.0f), Ring * Ring))
+		return EXIT_FAILURE;
+
+	// Across the world edge, with negative tile coordinates wrapping into the ring.
+	if (!move(ring, vec2(0.0f, 0.0f), Ring * Ring))
+		return EXIT_FAILURE;
+	if (!move(ring, vec2(-1.0f, 0.0f), Ring))
+		return EXIT_FAILURE;
+
+	unsigned requested = 0;
+	for (auto &slot : ring.get_slots())
+		if (slot.requested)
+			requested++;
+	if (requested != (Ring / 2 - 1) * (Ring / 2))
+	{
+		LOGE("Expected %u requested slots at the corner, got %u.\n", (Ring / 2 - 1) * (Ring / 2), requested);
+		return EXIT_FAILURE;
+	}
+
+	// Random walk, where each step moves by at most one tile per axis.
+	std::mt19937 rnd(1234);
+	vec2 center = vec2(16.0f);
+	if (!move(ring, center, Ring * Ring))
+		return EXIT_FAILURE;
+
+	for (unsigned i = 0; i < 1000; i++)
+	{
+		ivec2 old_origin = ring.get_origin();
+		vec2 next = center + vec2(float(int(rnd() % 3) - 1), float(int(rnd() % 3) - 1));
+		ivec2 delta = ivec2(int(next.x - center.x), int(next.y - center.y));
+		unsigned expected = 0;
+		if (delta.x && delta.y)
+			expected = 2 * Ring - 1;
+		else if (delta.x || delta.y)
+			expected = Ring;
+
+		center = next;
+		if (!move(ring, center, expected))
+			return EXIT_FAILURE;
+
+		ivec2 new_origin = ring.get_origin();
+		if (new_origin.x - old_origin.x != delta.x || new_origin.y - old_origin.y != delta.y)
+			return EXIT_FAILURE;
+	}
+
+	// Retirement margin around the window.
+	ivec2 origin = ring.get_origin();
+	if (!ring.contains(origin) || ring.contains(origin - ivec2(1)) || !ring.contains(origin - ivec2(1), 1) ||
+	    ring.contains(origin + ivec2(int(Ring)), 0) || !ring.contains(origin + ivec2(int(Ring)), 1))
+	{
+		LOGE("Window bounds are wrong.\n");
+		return EXIT_FAILURE;
+	}
+
+	LOGI("Clipmap ring OK.\n");
+	return EXIT_SUCCESS;
+}
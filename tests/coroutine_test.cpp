@@ -0,0 +1,108 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "task_coroutine.hpp"
+#include "logging.hpp"
+#include <atomic>
+#include <stdexcept>
+#include <stdlib.h>
+
+using namespace Granite;
+
+static CoTask<int> square(ThreadGroup &group, int v)
+{
+	co_await schedule_on(group, TaskClass::Background);
+	co_return v * v;
+}
+
+static CoTask<void> throws()
+{
+	throw std::runtime_error("expected");
+	co_return;
+}
+
+static CoTask<void> run(ThreadGroup &group, TaskSignal &signal, std::atomic_uint &counter, bool &ok)
+{
+	// Await a regular task group.
+	auto work = group.create_task([&counter]() {
+		counter.fetch_add(1, std::memory_order_relaxed);
+	});
+	co_await work;
+	ok = counter.load(std::memory_order_relaxed) == 1;
+
+	// Await a group which has already completed.
+	co_await work;
+
+	// Await nested coroutines.
+	int sum = 0;
+	for (int i = 0; i < 16; i++)
+		sum += co_await square(group, i);
+	ok = ok && sum == 1240;
+
+	bool caught = false;
+	try
+	{
+		co_await throws();
+	}
+	catch (const std::runtime_error &)
+	{
+		caught = true;
+	}
+	ok = ok && caught;
+
+	// Await a signal which is incremented by another task.
+	auto signaller = group.create_task([&signal]() {
+		signal.signal_increment();
+		signal.signal_increment();
+	});
+	group.submit(signaller);
+	co_await wait_for_signal(group, signal, 2);
+	ok = ok && signal.get_count() >= 2;
+}
+
+int main()
+{
+	ThreadGroup group;
+	group.start(4, 1, {});
+
+	TaskSignal signal;
+	std::atomic_uint counter{0};
+	bool ok = false;
+
+	auto task = spawn(group, run(group, signal, counter, ok));
+	auto after = group.create_task([&ok]() {
+		if (ok)
+			LOGI("Continuation ran after coroutine.\n");
+	});
+	group.add_dependency(*after, *task);
+	group.submit(after);
+	task->wait();
+	group.wait_idle();
+
+	if (!ok)
+	{
+		LOGE("Coroutine test failed!\n");
+		return EXIT_FAILURE;
+	}
+
+	LOGI("Coroutine test passed.\n");
+}
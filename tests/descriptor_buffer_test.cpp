@@ -0,0 +1,206 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "global_managers_init.hpp"
+#include "os_filesystem.hpp"
+#include "context.hpp"
+#include "device.hpp"
+#include "command_buffer.hpp"
+#include "environment.hpp"
+#include <cmath>
+#include <stdlib.h>
+
+using namespace Granite;
+using namespace Vulkan;
+
+static constexpr unsigned NumInputs = 64;
+// Enough UBO updates to run through more than one descriptor buffer block.
+static constexpr unsigned NumDispatches = 4096;
+static constexpr uint8_t TexelValue = 64;
+
+struct Params
+{
+	float scale;
+	float bias;
+	uint32_t base;
+};
+
+static bool init_context(Context &ctx, ContextCreationFlags flags)
+{
+	Context::SystemHandles handles = {};
+	handles.filesystem = GRANITE_FILESYSTEM();
+	ctx.set_system_handles(handles);
+	return ctx.init_instance_and_device(nullptr, 0, nullptr, 0, flags);
+}
+
+static bool check_layout(Device &device, const PipelineLayout &layout, bool descriptor_buffer_requested)
+{
+	auto &features = device.get_device_features();
+	bool expect_descriptor_buffer = descriptor_buffer_requested && features.supports_descriptor_buffer;
+
+	if (layout.uses_descriptor_buffer() != expect_descriptor_buffer)
+	{
+		LOGE("Expected the layout to %s descriptor buffers.\n", expect_descriptor_buffer ? "use" : "not use");
+		return false;
+	}
+
+	// Push descriptors are the fallback when descriptor buffers are not available.
+	bool expect_push_descriptor = !expect_descriptor_buffer && features.supports_push_descriptor;
+	if ((layout.get_push_descriptor_set_mask() != 0) != expect_push_descriptor)
+	{
+		LOGE("Expected the layout to %s push descriptors.\n", expect_push_descriptor ? "use" : "not use");
+		return false;
+	}
+
+	return true;
+}
+
+static bool run_dispatches(Device &device, bool descriptor_buffer_requested)
+{
+	std::vector<std::pair<std::string, int>> defines;
+	auto *program = device.get_shader_manager().register_compute("assets://shaders/descriptor_buffer.comp");
+	auto *variant = program ? program->register_variant(defines) : nullptr;
+	if (!variant || !variant->get_program())
+	{
+		LOGE("Failed to compile shader.\n");
+		return false;
+	}
+
+	if (!check_layout(device, *variant->get_program()->get_pipeline_layout(), descriptor_buffer_requested))
+		return false;
+
+	float input_data[NumInputs];
+	for (unsigned i = 0; i < NumInputs; i++)
+		input_data[i] = float(i) - 0.5f * float(NumInputs);
+
+	BufferCreateInfo info;
+	info.size = sizeof(input_data);
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	info.domain = BufferDomain::Device;
+	auto inputs = device.create_buffer(info, input_data);
+
+	info.size = NumDispatches * NumInputs * sizeof(float);
+	info.domain = BufferDomain::CachedHost;
+	auto outputs = device.create_buffer(info);
+
+	const uint8_t pixel[] = { TexelValue, 0, 0, 0 };
+	ImageInitialData data = { pixel };
+	auto image = device.create_image(ImageCreateInfo::immutable_2d_image(1, 1, VK_FORMAT_R8G8B8A8_UNORM), &data);
+
+	if (!inputs || !outputs || !image)
+	{
+		LOGE("Failed to create resources.\n");
+		return false;
+	}
+
+	auto cmd = device.request_command_buffer();
+	cmd->set_program(variant->get_program());
+	cmd->set_texture(0, 0, image->get_view(), StockSampler::NearestClamp);
+	cmd->set_storage_buffer(0, 1, *inputs);
+	cmd->set_storage_buffer(1, 1, *outputs);
+
+	// Only the UBO changes between dispatches.
+	for (unsigned i = 0; i < NumDispatches; i++)
+	{
+		auto *params = cmd->allocate_typed_constant_data<Params>(1, 0, 1);
+		params->scale = float(i % 7 + 1);
+		params->bias = 0.25f * float(i);
+		params->base = i * NumInputs;
+		cmd->dispatch(1, 1, 1);
+	}
+
+	cmd->barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+	             VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+	device.submit(cmd);
+	device.wait_idle();
+
+	auto *ptr = static_cast<const float *>(device.map_host_buffer(*outputs, MEMORY_ACCESS_READ_BIT));
+	float texel = float(TexelValue) / 255.0f;
+	for (unsigned i = 0; i < NumDispatches; i++)
+	{
+		for (unsigned j = 0; j < NumInputs; j++)
+		{
+			float expected = input_data[j] * float(i % 7 + 1) + 0.25f * float(i) + texel;
+			float value = ptr[i * NumInputs + j];
+			if (std::abs(value - expected) > 0.01f)
+			{
+				LOGE("Dispatch %u, element %u: expected %f, got %f.\n", i, j, expected, value);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static int main_inner()
+{
+	if (!Context::init_loader(nullptr))
+		return EXIT_FAILURE;
+
+	static const struct
+	{
+		ContextCreationFlags flags;
+		const char *name;
+	} configs[] = {
+		{ 0, "descriptor sets" },
+		{ CONTEXT_CREATION_ENABLE_PUSH_DESCRIPTOR_BIT, "push descriptors" },
+		{ CONTEXT_CREATION_ENABLE_PUSH_DESCRIPTOR_BIT | CONTEXT_CREATION_ENABLE_DESCRIPTOR_BUFFER_BIT, "descriptor buffers" },
+	};
+
+	for (auto &config : configs)
+	{
+		Context ctx;
+		if (!init_context(ctx, config.flags))
+			return EXIT_FAILURE;
+		Device device;
+		device.set_context(ctx);
+
+		bool descriptor_buffer_requested = (config.flags & CONTEXT_CREATION_ENABLE_DESCRIPTOR_BUFFER_BIT) != 0;
+		if (descriptor_buffer_requested && !device.get_device_features().supports_descriptor_buffer)
+			LOGI("Descriptor buffers are not supported, testing the fallback.\n");
+
+		if (!run_dispatches(device, descriptor_buffer_requested))
+		{
+			LOGE("Failed with %s.\n", config.name);
+			return EXIT_FAILURE;
+		}
+
+		LOGI("Results match with %s.\n", config.name);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int main()
+{
+	Global::init(Global::MANAGER_FEATURE_DEFAULT_BITS, 1);
+
+#ifdef ASSET_DIRECTORY
+	auto asset_dir = Util::get_environment_string("ASSET_DIRECTORY", ASSET_DIRECTORY);
+	GRANITE_FILESYSTEM()->register_protocol("assets", std::unique_ptr<FilesystemBackend>(new OSFilesystem(asset_dir)));
+#endif
+	int ret = main_inner();
+	Global::deinit();
+	return ret;
+}
@@ -0,0 +1,254 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "event.hpp"
+#include "logging.hpp"
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+
+using namespace Granite;
+
+struct CountEvent : Event
+{
+	GRANITE_EVENT_TYPE_DECL(CountEvent)
+
+	explicit CountEvent(unsigned value_)
+		: value(value_)
+	{
+	}
+
+	unsigned value;
+};
+
+struct OtherEvent : Event
+{
+	GRANITE_EVENT_TYPE_DECL(OtherEvent)
+};
+
+struct SequenceEvent : Event
+{
+	GRANITE_EVENT_TYPE_DECL(SequenceEvent)
+
+	SequenceEvent(unsigned thread_, unsigned seq_)
+		: thread(thread_), seq(seq_)
+	{
+	}
+
+	unsigned thread;
+	unsigned seq;
+};
+
+#define CHECK(x) do { if (!(x)) { LOGE("Check failed: %s (line %d).\n", #x, __LINE__); return false; } } while (0)
+
+// Events enqueued by a handler go out on the next dispatch(), not the current one.
+static bool test_deferred_enqueue()
+{
+	struct Listener : EventHandler
+	{
+		bool on_count(const CountEvent &e)
+		{
+			received.push_back(e.value);
+			manager->enqueue<CountEvent>(e.value + 1);
+			return true;
+		}
+
+		EventManager *manager = nullptr;
+		std::vector<unsigned> received;
+	};
+
+	EventManager manager;
+	Listener listener;
+	listener.manager = &manager;
+	manager.register_handler<Listener, CountEvent, &Listener::on_count>(&listener);
+
+	manager.enqueue<CountEvent>(0u);
+	manager.dispatch();
+	CHECK(listener.received.size() == 1 && listener.received[0] == 0);
+
+	manager.dispatch();
+	CHECK(listener.received.size() == 2 && listener.received[1] == 1);
+
+	manager.dispatch();
+	CHECK(listener.received.size() == 3 && listener.received[2] == 2);
+	return true;
+}
+
+// dispatch() from within a handler returns without delivering anything,
+// and the outer dispatch() still delivers the rest of its batch.
+static bool test_reentrant_dispatch()
+{
+	struct Listener : EventHandler
+	{
+		bool on_count(const CountEvent &)
+		{
+			count_events++;
+			manager->enqueue<OtherEvent>();
+			manager->dispatch();
+			if (other_events != 0)
+				nested_delivered = true;
+			return true;
+		}
+
+		bool on_other(const OtherEvent &)
+		{
+			other_events++;
+			return true;
+		}
+
+		EventManager *manager = nullptr;
+		unsigned count_events = 0;
+		unsigned other_events = 0;
+		bool nested_delivered = false;
+	};
+
+	EventManager manager;
+	Listener listener;
+	listener.manager = &manager;
+	manager.register_handler<Listener, CountEvent, &Listener::on_count>(&listener);
+	manager.register_handler<Listener, OtherEvent, &Listener::on_other>(&listener);
+
+	for (unsigned i = 0; i < 3; i++)
+		manager.enqueue<CountEvent>(i);
+	manager.dispatch();
+	CHECK(listener.count_events == 3);
+	CHECK(listener.other_events == 0);
+	CHECK(!listener.nested_delivered);
+
+	manager.dispatch();
+	CHECK(listener.count_events == 3);
+	CHECK(listener.other_events == 3);
+	return true;
+}
+
+// A handler returning false is removed at once and sees nothing more, even within the same batch.
+// A handler registered while dispatching starts receiving events on the next dispatch().
+static bool test_handler_removal()
+{
+	struct Listener : EventHandler
+	{
+		bool on_count(const CountEvent &)
+		{
+			count++;
+			if (late && !late_registered)
+			{
+				manager->register_handler<Listener, CountEvent, &Listener::on_count>(late);
+				late_registered = true;
+			}
+			return count < remove_after;
+		}
+
+		EventManager *manager = nullptr;
+		Listener *late = nullptr;
+		bool late_registered = false;
+		unsigned count = 0;
+		unsigned remove_after = ~0u;
+	};
+
+	EventManager manager;
+	Listener removed, kept, late;
+	removed.remove_after = 2;
+	kept.manager = &manager;
+	kept.late = &late;
+
+	manager.register_handler<Listener, CountEvent, &Listener::on_count>(&removed);
+	manager.register_handler<Listener, CountEvent, &Listener::on_count>(&kept);
+
+	for (unsigned i = 0; i < 4; i++)
+		manager.enqueue<CountEvent>(i);
+	manager.dispatch();
+	CHECK(removed.count == 2);
+	CHECK(kept.count == 4);
+	CHECK(late.count == 0);
+
+	for (unsigned i = 0; i < 2; i++)
+		manager.enqueue<CountEvent>(i);
+	manager.dispatch();
+	CHECK(removed.count == 2);
+	CHECK(kept.count == 6);
+	CHECK(late.count == 2);
+	return true;
+}
+
+// Producers on many threads, every event is delivered once, and in order per thread.
+static bool test_threaded_enqueue()
+{
+	constexpr unsigned NumThreads = 24;
+	constexpr unsigned NumEvents = 2000;
+
+	struct Listener : EventHandler
+	{
+		bool on_sequence(const SequenceEvent &e)
+		{
+			if (e.thread >= NumThreads || e.seq != next[e.thread])
+				out_of_order = true;
+			else
+				next[e.thread]++;
+			return true;
+		}
+
+		unsigned next[NumThreads] = {};
+		bool out_of_order = false;
+	};
+
+	EventManager manager;
+	Listener listener;
+	manager.register_handler<Listener, SequenceEvent, &Listener::on_sequence>(&listener);
+
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < NumThreads; t++)
+	{
+		threads.emplace_back([&manager, t]() {
+			for (unsigned i = 0; i < NumEvents; i++)
+				manager.enqueue<SequenceEvent>(t, i);
+		});
+	}
+
+	// Dispatch while producers are still running, nothing may be lost or reordered.
+	for (unsigned i = 0; i < 16; i++)
+		manager.dispatch();
+
+	for (auto &thr : threads)
+		thr.join();
+	manager.dispatch();
+
+	CHECK(!listener.out_of_order);
+	for (unsigned t = 0; t < NumThreads; t++)
+		CHECK(listener.next[t] == NumEvents);
+	return true;
+}
+
+int main()
+{
+	if (!test_deferred_enqueue())
+		return EXIT_FAILURE;
+	if (!test_reentrant_dispatch())
+		return EXIT_FAILURE;
+	if (!test_handler_removal())
+		return EXIT_FAILURE;
+	if (!test_threaded_enqueue())
+		return EXIT_FAILURE;
+
+	LOGI("Event manager OK.\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "event.hpp"
+#include "logging.hpp"
+#include "timer.hpp"
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Granite;
+
+struct AxisEvent : Event
+{
+	GRANITE_EVENT_TYPE_DECL(AxisEvent)
+
+	AxisEvent(unsigned index_, float value_)
+		: index(index_), value(value_)
+	{
+	}
+
+	unsigned index;
+	float value;
+};
+
+struct TextEvent : Event
+{
+	GRANITE_EVENT_TYPE_DECL(TextEvent)
+
+	explicit TextEvent(std::string str_)
+		: str(std::move(str_))
+	{
+	}
+
+	std::string str;
+};
+
+struct Listener : EventHandler
+{
+	bool on_axis(const AxisEvent &e)
+	{
+		axis_count++;
+		axis_sum += e.value;
+		return true;
+	}
+
+	bool on_text(const TextEvent &e)
+	{
+		text_count++;
+		text_length += e.str.size();
+		return true;
+	}
+
+	size_t axis_count = 0;
+	double axis_sum = 0.0;
+	size_t text_count = 0;
+	size_t text_length = 0;
+};
+
+static constexpr unsigned NumEvents = 100000;
+static constexpr unsigned NumIterations = 20;
+
+int main()
+{
+	EventManager manager;
+	Listener listener;
+	manager.register_handler<Listener, AxisEvent, &Listener::on_axis>(&listener);
+	manager.register_handler<Listener, TextEvent, &Listener::on_text>(&listener);
+
+	// Reference: what enqueue used to do, one heap allocation per event.
+	{
+		std::vector<std::unique_ptr<Event>> queue;
+		double sum = 0.0;
+		auto start = Util::get_current_time_nsecs();
+		for (unsigned iter = 0; iter < NumIterations; iter++)
+		{
+			for (unsigned i = 0; i < NumEvents; i++)
+				queue.emplace_back(new AxisEvent(i & 3, float(i)));
+			for (auto &e : queue)
+				sum += static_cast<const AxisEvent &>(*e).value;
+			queue.clear();
+		}
+		auto end = Util::get_current_time_nsecs();
+		LOGI("Reference unique_ptr queue: %.2f ns / event (%f).\n",
+		     double(end - start) / double(NumEvents * NumIterations), sum);
+	}
+
+	// Single producer.
+	{
+		auto start = Util::get_current_time_nsecs();
+		for (unsigned iter = 0; iter < NumIterations; iter++)
+		{
+			for (unsigned i = 0; i < NumEvents; i++)
+				manager.enqueue<AxisEvent>(i & 3, float(i));
+			manager.dispatch();
+		}
+		auto end = Util::get_current_time_nsecs();
+		LOGI("Enqueue + dispatch: %.2f ns / event.\n",
+		     double(end - start) / double(NumEvents * NumIterations));
+
+		if (listener.axis_count != size_t(NumEvents) * NumIterations)
+		{
+			LOGE("Expected %zu events, got %zu.\n", size_t(NumEvents) * NumIterations, listener.axis_count);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Multiple producers, non-trivial event type.
+	{
+		constexpr unsigned NumThreads = 4;
+		listener.text_count = 0;
+		listener.text_length = 0;
+
+		auto start = Util::get_current_time_nsecs();
+		for (unsigned iter = 0; iter < NumIterations; iter++)
+		{
+			std::vector<std::thread> threads;
+			for (unsigned t = 0; t < NumThreads; t++)
+			{
+				threads.emplace_back([&manager]() {
+					for (unsigned i = 0; i < NumEvents / NumThreads; i++)
+						manager.enqueue<TextEvent>("this string does not fit in SSO storage");
+				});
+			}
+
+			for (auto &thr : threads)
+				thr.join();
+			manager.dispatch();
+		}
+		auto end = Util::get_current_time_nsecs();
+		LOGI("Threaded enqueue + dispatch: %.2f ns / event.\n",
+		     double(end - start) / double(NumEvents * NumIterations));
+
+		if (listener.text_count != size_t(NumEvents) * NumIterations ||
+		    listener.text_length != listener.text_count * strlen("this string does not fit in SSO storage"))
+		{
+			LOGE("Mismatch in threaded events.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "global_managers_init.hpp"
+#include "context.hpp"
+#include "device.hpp"
+#include "command_buffer.hpp"
+#include <stdlib.h>
+
+using namespace Granite;
+using namespace Vulkan;
+
+static bool init_context(Context &ctx, ContextCreationFlags flags)
+{
+	Context::SystemHandles handles = {};
+	handles.filesystem = GRANITE_FILESYSTEM();
+	ctx.set_system_handles(handles);
+	return ctx.init_instance_and_device(nullptr, 0, nullptr, 0, flags);
+}
+
+struct StateVariant
+{
+	VkCullModeFlags cull_mode;
+	VkFrontFace front_face;
+	bool depth_test;
+	bool depth_write;
+	VkCompareOp depth_compare;
+};
+
+// Only differ in state which extended dynamic state 1 covers.
+static const StateVariant variants[] = {
+	{ VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, false, false, VK_COMPARE_OP_ALWAYS },
+	{ VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE, false, false, VK_COMPARE_OP_ALWAYS },
+	{ VK_CULL_MODE_FRONT_BIT, VK_FRONT_FACE_CLOCKWISE, false, false, VK_COMPARE_OP_ALWAYS },
+	{ VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, true, true, VK_COMPARE_OP_LESS_OR_EQUAL },
+	{ VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, true, false, VK_COMPARE_OP_GREATER },
+};
+
+// Draws every variant in one render pass and counts the distinct pipelines which got bound.
+static bool draw_variants(Device &device, unsigned &num_pipelines, bool &dynamic_rendering)
+{
+	auto color = device.create_image(ImageCreateInfo::render_target(64, 64, VK_FORMAT_R8G8B8A8_UNORM));
+	auto depth = device.create_image(ImageCreateInfo::render_target(64, 64, device.get_default_depth_format()));
+	if (!color || !depth)
+	{
+		LOGE("Failed to create render targets.\n");
+		return false;
+	}
+
+	auto cmd = device.request_command_buffer();
+
+	RenderPassInfo rp;
+	rp.color_attachments[0] = &color->get_view();
+	rp.num_color_attachments = 1;
+	rp.depth_stencil = &depth->get_view();
+	rp.clear_attachments = 1;
+	rp.store_attachments = 1;
+	rp.op_flags = RENDER_PASS_OP_CLEAR_DEPTH_STENCIL_BIT;
+	cmd->begin_render_pass(rp);
+
+	VkPipeline pipelines[sizeof(variants) / sizeof(variants[0])];
+	num_pipelines = 0;
+
+	for (auto &variant : variants)
+	{
+		CommandBufferUtil::setup_fullscreen_quad(*cmd, "builtin://shaders/quad.vert", "builtin://shaders/dummy.frag", {},
+		                                         variant.depth_test, variant.depth_write, variant.depth_compare);
+		cmd->set_cull_mode(variant.cull_mode);
+		cmd->set_front_face(variant.front_face);
+
+		VkPipeline pipeline = cmd->get_current_graphics_pipeline();
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			LOGE("Failed to compile pipeline.\n");
+			cmd->end_render_pass();
+			device.submit_discard(cmd);
+			return false;
+		}
+
+		bool seen = false;
+		for (unsigned i = 0; i < num_pipelines; i++)
+			if (pipelines[i] == pipeline)
+				seen = true;
+		if (!seen)
+			pipelines[num_pipelines++] = pipeline;
+
+		CommandBufferUtil::draw_fullscreen_quad(*cmd);
+	}
+
+	DeferredPipelineCompile compile;
+	cmd->extract_pipeline_state(compile);
+	dynamic_rendering = compile.dynamic_rendering;
+
+	cmd->end_render_pass();
+	device.submit(cmd);
+	device.wait_idle();
+	return true;
+}
+
+int main()
+{
+	Global::init(Global::MANAGER_FEATURE_DEFAULT_BITS, 1);
+	if (!Context::init_loader(nullptr))
+		return EXIT_FAILURE;
+
+	// Without extended dynamic state, every variant is its own pipeline.
+	{
+		Context ctx;
+		if (!init_context(ctx, 0))
+			return EXIT_FAILURE;
+		Device device;
+		device.set_context(ctx);
+
+		unsigned num_pipelines = 0;
+		bool dynamic_rendering = false;
+		if (!draw_variants(device, num_pipelines, dynamic_rendering))
+			return EXIT_FAILURE;
+
+		if (num_pipelines != sizeof(variants) / sizeof(variants[0]) || dynamic_rendering)
+		{
+			LOGE("Expected one render pass pipeline per variant, got %u.\n", num_pipelines);
+			return EXIT_FAILURE;
+		}
+	}
+
+	Context ctx;
+	if (!init_context(ctx, CONTEXT_CREATION_ENABLE_EXTENDED_DYNAMIC_STATE_BIT))
+		return EXIT_FAILURE;
+	Device device;
+	device.set_context(ctx);
+
+	auto &features = device.get_device_features();
+	if (!features.supports_extended_dynamic_state)
+	{
+		LOGI("Extended dynamic state is not supported, skipping.\n");
+		return EXIT_SUCCESS;
+	}
+
+	unsigned num_pipelines = 0;
+	bool dynamic_rendering = false;
+	if (!draw_variants(device, num_pipelines, dynamic_rendering))
+		return EXIT_FAILURE;
+
+	if (num_pipelines != 1)
+	{
+		LOGE("Dynamic state changes created %u pipelines, expected 1.\n", num_pipelines);
+		return EXIT_FAILURE;
+	}
+
+	if (dynamic_rendering != features.supports_dynamic_rendering)
+	{
+		LOGE("Expected the render pass to %s dynamic rendering.\n",
+		     features.supports_dynamic_rendering ? "use" : "not use");
+		return EXIT_FAILURE;
+	}
+
+	LOGI("Extended dynamic state kept a single pipeline%s.\n",
+	     dynamic_rendering ? " with dynamic rendering" : "");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "platforms/frame_encoder.hpp"
+#include "logging.hpp"
+#include "stb_image.h"
+#include <random>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace Granite;
+
+// Gradients, runs and noise, so every filter and QOI op gets exercised. Alpha varies unless opaque.
+static std::vector<uint8_t> create_image(unsigned width, unsigned height, bool alpha)
+{
+	std::vector<uint8_t> rgba(size_t(width) * height * 4);
+	std::mt19937 rnd(width * 131 + height);
+
+	for (unsigned y = 0; y < height; y++)
+	{
+		for (unsigned x = 0; x < width; x++)
+		{
+			auto *px = &rgba[4 * (size_t(y) * width + x)];
+			switch ((y / 8) % 4)
+			{
+			case 0:
+				px[0] = uint8_t(x);
+				px[1] = uint8_t(y);
+				px[2] = uint8_t(x + y);
+				break;
+			case 1:
+				px[0] = 10;
+				px[1] = 20;
+				px[2] = 30;
+				break;
+			case 2:
+				px[0] = uint8_t(rnd());
+				px[1] = uint8_t(rnd());
+				px[2] = uint8_t(rnd());
+				break;
+			default:
+				px[0] = uint8_t(x * 3 + (rnd() & 1));
+				px[1] = uint8_t(x * 3);
+				px[2] = uint8_t(x * 3 - 1);
+				break;
+			}
+
+			px[3] = alpha ? uint8_t((x / 4) * 37 + y) : 0xff;
+		}
+	}
+
+	return rgba;
+}
+
+static bool compare_image(const char *tag, const uint8_t *expected, const uint8_t *decoded,
+                          unsigned width, unsigned height, bool force_opaque)
+{
+	for (size_t i = 0, n = size_t(width) * height; i < n; i++)
+	{
+		uint8_t ref[4] = { expected[4 * i + 0], expected[4 * i + 1], expected[4 * i + 2], expected[4 * i + 3] };
+		if (force_opaque)
+			ref[3] = 0xff;
+
+		if (memcmp(ref, decoded + 4 * i, 4) != 0)
+		{
+			LOGE("%s: mismatch at (%u, %u).\n", tag, unsigned(i % width), unsigned(i / width));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool test_png(const std::vector<uint8_t> &rgba, unsigned width, unsigned height,
+                     unsigned rows_per_stripe, bool compress, bool force_opaque)
+{
+	unsigned num_stripes = (height + rows_per_stripe - 1) / rows_per_stripe;
+	std::vector<FrameEncoder::Stripe> stripes(num_stripes);
+	for (unsigned i = 0; i < num_stripes; i++)
+	{
+		unsigned first_row = i * rows_per_stripe;
+		FrameEncoder::encode_png_stripe(stripes[i], rgba.data(), width, height, first_row,
+		                                std::min(rows_per_stripe, height - first_row),
+		                                compress, force_opaque, i + 1 == num_stripes);
+	}
+
+	std::vector<uint8_t> png;
+	FrameEncoder::assemble_png(png, width, height, stripes.data(), num_stripes);
+
+	int w, h, comp;
+	auto *decoded = stbi_load_from_memory(png.data(), int(png.size()), &w, &h, &comp, 4);
+	if (!decoded)
+	{
+		LOGE("PNG %ux%u: failed to decode (%s).\n", width, height, stbi_failure_reason());
+		return false;
+	}
+
+	bool ret = unsigned(w) == width && unsigned(h) == height &&
+	           compare_image("PNG", rgba.data(), decoded, width, height, force_opaque);
+	stbi_image_free(decoded);
+	return ret;
+}
+
+// Straight from the QOI specification, independent of the encoder.
+static bool decode_qoi(std::vector<uint8_t> &rgba, const std::vector<uint8_t> &qoi, unsigned width, unsigned height)
+{
+	if (qoi.size() < 14 + 8 || memcmp(qoi.data(), "qoif", 4) != 0)
+		return false;
+
+	uint32_t w = (uint32_t(qoi[4]) << 24) | (uint32_t(qoi[5]) << 16) | (uint32_t(qoi[6]) << 8) | qoi[7];
+	uint32_t h = (uint32_t(qoi[8]) << 24) | (uint32_t(qoi[9]) << 16) | (uint32_t(qoi[10]) << 8) | qoi[11];
+	if (w != width || h != height)
+		return false;
+
+	rgba.resize(size_t(width) * height * 4);
+	uint8_t index[64][4] = {};
+	uint8_t px[4] = { 0, 0, 0, 0xff };
+	size_t pos = 14;
+	size_t end = qoi.size() - 8;
+	unsigned run = 0;
+
+	for (size_t i = 0, n = size_t(width) * height; i < n; i++)
+	{
+		if (run)
+			run--;
+		else
+		{
+			if (pos >= end)
+				return false;
+
+			uint8_t b = qoi[pos++];
+			if (b == 0xfe || b == 0xff)
+			{
+				unsigned count = b == 0xff ? 4 : 3;
+				if (pos + count > end)
+					return false;
+				memcpy(px, &qoi[pos], count);
+				pos += count;
+			}
+			else if ((b & 0xc0) == 0x00)
+				memcpy(px, index[b], 4);
+			else if ((b & 0xc0) == 0x40)
+			{
+				px[0] += ((b >> 4) & 3) - 2;
+				px[1] += ((b >> 2) & 3) - 2;
+				px[2] += (b & 3) - 2;
+			}
+			else if ((b & 0xc0) == 0x80)
+			{
+				if (pos >= end)
+					return false;
+				int vg = (b & 0x3f) - 32;
+				uint8_t b2 = qoi[pos++];
+				px[0] += vg - 8 + ((b2 >> 4) & 0xf);
+				px[1] += vg;
+				px[2] += vg - 8 + (b2 & 0xf);
+			}
+			else
+				run = b & 0x3f;
+
+			memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) & 63], px, 4);
+		}
+
+		memcpy(&rgba[4 * i], px, 4);
+	}
+
+	static const uint8_t padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	return pos == end && memcmp(&qoi[end], padding, sizeof(padding)) == 0;
+}
+
+static bool test_qoi(const std::vector<uint8_t> &rgba, unsigned width, unsigned height, bool force_opaque)
+{
+	std::vector<uint8_t> qoi, decoded;
+	FrameEncoder::encode_qoi(qoi, rgba.data(), width, height, force_opaque);
+	if (!decode_qoi(decoded, qoi, width, height))
+	{
+		LOGE("QOI %ux%u: failed to decode.\n", width, height);
+		return false;
+	}
+
+	return compare_image("QOI", rgba.data(), decoded.data(), width, height, force_opaque);
+}
+
+int main()
+{
+	static const struct { unsigned width, height; } sizes[] = {
+		{ 1, 1 }, { 3, 5 }, { 33, 17 }, { 257, 131 },
+	};
+
+	for (auto &size : sizes)
+	{
+		for (bool alpha : { false, true })
+		{
+			auto rgba = create_image(size.width, size.height, alpha);
+			for (bool force_opaque : { false, true })
+			{
+				// Several stripes check that stripe boundaries and the combined checksum are valid.
+				for (unsigned rows_per_stripe : { 64u, 7u })
+				{
+					if (!test_png(rgba, size.width, size.height, rows_per_stripe, true, force_opaque) ||
+					    !test_png(rgba, size.width, size.height, rows_per_stripe, false, force_opaque))
+					{
+						LOGE("PNG round-trip failed for %ux%u, alpha %d, force opaque %d.\n",
+						     size.width, size.height, int(alpha), int(force_opaque));
+						return EXIT_FAILURE;
+					}
+				}
+
+				if (!test_qoi(rgba, size.width, size.height, force_opaque))
+				{
+					LOGE("QOI round-trip failed for %ux%u, alpha %d, force opaque %d.\n",
+					     size.width, size.height, int(alpha), int(force_opaque));
+					return EXIT_FAILURE;
+				}
+			}
+		}
+	}
+
+	LOGI("Frame encoder round-trip OK.\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,268 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "texture_supercompression.hpp"
+#include "logging.hpp"
+#include <random>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace Vulkan;
+
+// Exercises the v2 chunk index and chunk decoding directly on bytes, without any image layout.
+static constexpr size_t IndexOffset = 64;
+static constexpr size_t ChunkSize = 16 * 1024;
+static constexpr size_t Stride = 4;
+static constexpr uint32_t NumChunks = 3;
+
+struct Container
+{
+	std::vector<uint8_t> bytes;
+	std::vector<uint8_t> inputs[NumChunks];
+};
+
+static SupercompressedChunk *get_index(Container &container)
+{
+	return reinterpret_cast<SupercompressedChunk *>(container.bytes.data() + IndexOffset);
+}
+
+static bool build_container(Container &container)
+{
+	std::mt19937 rnd(1234);
+	for (auto &input : container.inputs)
+		input.resize(ChunkSize);
+
+	for (size_t i = 0; i < ChunkSize; i++)
+	{
+		// Raw, LZ4 and LZ4 with block shuffle respectively.
+		container.inputs[0][i] = uint8_t(rnd());
+		container.inputs[1][i] = uint8_t(i & 3);
+		container.inputs[2][i] = (i & 3) == 0 ? uint8_t(rnd()) : uint8_t(i & 3);
+	}
+
+	SupercompressedChunk index[NumChunks] = {};
+	std::vector<uint8_t> payloads[NumChunks];
+	size_t offset = IndexOffset + sizeof(index);
+
+	for (uint32_t i = 0; i < NumChunks; i++)
+	{
+		if (!compress_supercompressed_chunk(payloads[i], index[i], container.inputs[i].data(), ChunkSize, Stride))
+			return false;
+		index[i].offset = offset;
+		offset += payloads[i].size();
+	}
+
+	if (index[0].compression != TextureSupercompression::None ||
+	    index[1].compression != TextureSupercompression::LZ4 || index[1].filter != ChunkFilter::None ||
+	    index[2].compression != TextureSupercompression::LZ4 || index[2].filter != ChunkFilter::BlockShuffle)
+	{
+		LOGE("Chunks did not pick the expected encodings.\n");
+		return false;
+	}
+
+	container.bytes.resize(offset);
+	memcpy(container.bytes.data() + IndexOffset, index, sizeof(index));
+	for (uint32_t i = 0; i < NumChunks; i++)
+		memcpy(container.bytes.data() + index[i].offset, payloads[i].data(), payloads[i].size());
+
+	return true;
+}
+
+static bool decode_chunk(const Container &container, const SupercompressedChunk *index, uint32_t chunk,
+                         std::vector<uint8_t> &output)
+{
+	output.assign(ChunkSize, 0);
+	return decompress_supercompressed_chunk(output.data(), ChunkSize,
+	                                        container.bytes.data() + index[chunk].offset, index[chunk], Stride);
+}
+
+static bool test_round_trip(const Container &container)
+{
+	auto *index = parse_supercompressed_index(container.bytes.data(), container.bytes.size(), IndexOffset, NumChunks);
+	if (!index)
+	{
+		LOGE("Valid index was rejected.\n");
+		return false;
+	}
+
+	std::vector<uint8_t> output;
+	for (uint32_t i = 0; i < NumChunks; i++)
+	{
+		if (!decode_chunk(container, index, i, output) || output != container.inputs[i])
+		{
+			LOGE("Chunk %u does not round-trip.\n", i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool test_truncated(const Container &container)
+{
+	// The last chunk ends at the end of the file, so every truncation must be caught by the index.
+	for (size_t size = 0; size < container.bytes.size(); size++)
+	{
+		if (parse_supercompressed_index(container.bytes.data(), size, IndexOffset, NumChunks))
+		{
+			LOGE("Index truncated to %zu bytes was accepted.\n", size);
+			return false;
+		}
+	}
+
+	// Chunk counts which would overflow the index size computation.
+	const uint64_t bad_counts[] = { UINT64_MAX, UINT64_MAX / sizeof(SupercompressedChunk) + 1, NumChunks + 1 };
+	for (auto count : bad_counts)
+	{
+		if (parse_supercompressed_index(container.bytes.data(), container.bytes.size(), IndexOffset, count))
+		{
+			LOGE("Chunk count %llu was accepted.\n", static_cast<unsigned long long>(count));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool test_corrupt_index(const Container &container)
+{
+	uint64_t payload_begin = IndexOffset + NumChunks * sizeof(SupercompressedChunk);
+	uint64_t size = container.bytes.size();
+
+	const struct
+	{
+		uint64_t offset;
+		uint64_t compressed_size;
+	} bad_ranges[] = {
+		{ size + 1, 0 },
+		{ size, 1 },
+		{ payload_begin, size },
+		{ UINT64_MAX, 2 },
+		// offset + size wraps around.
+		{ payload_begin, UINT64_MAX - payload_begin + 1 },
+		// Overlaps the header and index.
+		{ 0, 16 },
+		{ payload_begin - 1, 1 },
+	};
+
+	for (uint32_t chunk = 0; chunk < NumChunks; chunk++)
+	{
+		for (auto &range : bad_ranges)
+		{
+			Container corrupt = container;
+			get_index(corrupt)[chunk].offset = range.offset;
+			get_index(corrupt)[chunk].compressed_size = range.compressed_size;
+			if (parse_supercompressed_index(corrupt.bytes.data(), corrupt.bytes.size(), IndexOffset, NumChunks))
+			{
+				LOGE("Chunk %u with range [%llu, +%llu) was accepted.\n", chunk,
+				     static_cast<unsigned long long>(range.offset),
+				     static_cast<unsigned long long>(range.compressed_size));
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool test_corrupt_chunks(const Container &container)
+{
+	// These pass index validation, since they stay within the file, but must fail to decode.
+	std::vector<uint8_t> output;
+	for (uint32_t chunk = 0; chunk < NumChunks; chunk++)
+	{
+		for (unsigned variant = 0; variant < 4; variant++)
+		{
+			Container corrupt = container;
+			auto &entry = get_index(corrupt)[chunk];
+			switch (variant)
+			{
+			case 0:
+				entry.compression = TextureSupercompression(7);
+				break;
+			case 1:
+				entry.filter = ChunkFilter(7);
+				break;
+			case 2:
+				entry.compressed_size--;
+				break;
+			case 3:
+				// A raw chunk with a filter, or a compressed chunk read as raw.
+				if (entry.compression == TextureSupercompression::None)
+					entry.filter = ChunkFilter::BlockShuffle;
+				else
+					entry.compression = TextureSupercompression::None;
+				break;
+			}
+
+			auto *index = parse_supercompressed_index(corrupt.bytes.data(), corrupt.bytes.size(), IndexOffset, NumChunks);
+			if (!index)
+			{
+				LOGE("Index rejected, but only the chunk encoding is corrupt.\n");
+				return false;
+			}
+
+			if (decode_chunk(corrupt, index, chunk, output))
+			{
+				LOGE("Corrupt chunk %u (variant %u) decoded successfully.\n", chunk, variant);
+				return false;
+			}
+		}
+	}
+
+	// Random damage to compressed payloads may or may not decode, but must stay in bounds.
+	std::mt19937 rnd(5678);
+	for (unsigned iteration = 0; iteration < 2000; iteration++)
+	{
+		Container corrupt = container;
+		uint32_t chunk = 1 + rnd() % (NumChunks - 1);
+		auto &entry = get_index(corrupt)[chunk];
+		unsigned num_flips = 1 + rnd() % 4;
+		for (unsigned i = 0; i < num_flips; i++)
+			corrupt.bytes[entry.offset + rnd() % entry.compressed_size] ^= uint8_t(1u << (rnd() % 8));
+
+		auto *index = parse_supercompressed_index(corrupt.bytes.data(), corrupt.bytes.size(), IndexOffset, NumChunks);
+		if (!index)
+			return false;
+		decode_chunk(corrupt, index, chunk, output);
+	}
+
+	return true;
+}
+
+int main()
+{
+	Container container;
+	if (!build_container(container))
+		return EXIT_FAILURE;
+
+	if (!test_round_trip(container) || !test_truncated(container) ||
+	    !test_corrupt_index(container) || !test_corrupt_chunks(container))
+	{
+		LOGE("GTX container test failed.\n");
+		return EXIT_FAILURE;
+	}
+
+	LOGI("GTX container test passed.\n");
+	return EXIT_SUCCESS;
+}
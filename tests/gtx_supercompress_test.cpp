@@ -0,0 +1,189 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "memory_mapped_texture.hpp"
+#include "filesystem.hpp"
+#include "logging.hpp"
+#include <random>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace Granite;
+using namespace Vulkan;
+
+// Mirrors the v2 file layout in memory_mapped_texture.cpp, so the test can check which encoding every chunk got.
+static constexpr size_t HeaderSize = 64;
+struct ChunkRecord
+{
+	uint64_t offset;
+	uint64_t compressed_size;
+	uint32_t compression;
+	uint32_t filter;
+};
+static_assert(sizeof(ChunkRecord) == 24, "Unexpected chunk record size.");
+
+enum { FilterNone = 0, FilterBlockShuffle = 1 };
+
+static constexpr uint32_t Width = 64;
+static constexpr uint32_t Height = 64;
+static constexpr uint32_t Layers = 3;
+
+// One layer per chunk encoding the writer can pick.
+static void fill_layers(const TextureFormatLayout &layout)
+{
+	std::mt19937 rnd(1234);
+	auto *noise = static_cast<uint8_t *>(layout.data(0, 0));
+	auto *constant = static_cast<uint8_t *>(layout.data(1, 0));
+	auto *planar = static_cast<uint8_t *>(layout.data(2, 0));
+
+	for (uint32_t i = 0; i < Width * Height; i++)
+	{
+		// Incompressible, must be stored raw.
+		for (unsigned c = 0; c < 4; c++)
+			noise[4 * i + c] = uint8_t(rnd());
+
+		// One long match, shuffling would only split it into four runs.
+		constant[4 * i + 0] = 1;
+		constant[4 * i + 1] = 2;
+		constant[4 * i + 2] = 3;
+		constant[4 * i + 3] = 4;
+
+		// Noisy red channel breaks up every match, unless channels are separated.
+		planar[4 * i + 0] = uint8_t(rnd());
+		planar[4 * i + 1] = 0x10;
+		planar[4 * i + 2] = 0x20;
+		planar[4 * i + 3] = 0xff;
+	}
+}
+
+static bool check_chunks(Filesystem &fs, const std::string &path)
+{
+	auto file = fs.open(path, FileMode::ReadOnly);
+	if (!file)
+		return false;
+	auto mapping = file->map();
+	if (!mapping || mapping->get_size() < HeaderSize + Layers * sizeof(ChunkRecord))
+		return false;
+
+	ChunkRecord chunks[Layers];
+	memcpy(chunks, mapping->data<uint8_t>() + HeaderSize, sizeof(chunks));
+
+	static const struct
+	{
+		TextureSupercompression compression;
+		uint32_t filter;
+		const char *name;
+	} expected[Layers] = {
+		{ TextureSupercompression::None, FilterNone, "raw" },
+		{ TextureSupercompression::LZ4, FilterNone, "LZ4" },
+		{ TextureSupercompression::LZ4, FilterBlockShuffle, "LZ4 + block shuffle" },
+	};
+
+	size_t layer_size = Width * Height * 4;
+	for (uint32_t i = 0; i < Layers; i++)
+	{
+		if (chunks[i].compression != uint32_t(expected[i].compression) || chunks[i].filter != expected[i].filter)
+		{
+			LOGE("Layer %u: expected %s chunk, got compression %u, filter %u.\n",
+			     i, expected[i].name, chunks[i].compression, chunks[i].filter);
+			return false;
+		}
+
+		bool raw = expected[i].compression == TextureSupercompression::None;
+		if (raw ? chunks[i].compressed_size != layer_size : chunks[i].compressed_size >= layer_size)
+		{
+			LOGE("Layer %u: unexpected compressed size %llu.\n",
+			     i, static_cast<unsigned long long>(chunks[i].compressed_size));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool compare_layers(const void *a, const void *b, size_t size)
+{
+	for (uint32_t i = 0; i < Layers; i++)
+	{
+		size_t layer_size = size / Layers;
+		if (memcmp(static_cast<const uint8_t *>(a) + i * layer_size,
+		           static_cast<const uint8_t *>(b) + i * layer_size, layer_size) != 0)
+		{
+			LOGE("Layer %u does not round-trip.\n", i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main()
+{
+	Filesystem fs;
+	const std::string path = "memory://supercompressed.gtx";
+
+	MemoryMappedTexture tex;
+	tex.set_2d(VK_FORMAT_R8G8B8A8_UNORM, Width, Height, Layers);
+	if (!tex.map_write_scratch())
+		return EXIT_FAILURE;
+	fill_layers(tex.get_layout());
+
+	if (!tex.copy_to_path(fs, path, TextureSupercompression::LZ4))
+	{
+		LOGE("Failed to write supercompressed texture.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!check_chunks(fs, path))
+		return EXIT_FAILURE;
+
+	size_t size = tex.get_layout().get_required_size();
+
+	// Eager path, decompressed to a local copy on read.
+	MemoryMappedTexture eager;
+	if (!eager.map_read(fs, path) || eager.is_supercompressed())
+	{
+		LOGE("Failed to read back supercompressed texture.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (eager.get_layout().get_required_size() != size ||
+	    !compare_layers(tex.get_layout().data(), eager.get_layout().data(), size))
+		return EXIT_FAILURE;
+
+	// Deferred path, as used by streaming.
+	MemoryMappedTexture deferred;
+	if (!deferred.map_read(fs, path, true) || !deferred.is_supercompressed())
+	{
+		LOGE("Failed to read back deferred supercompressed texture.\n");
+		return EXIT_FAILURE;
+	}
+
+	std::vector<uint8_t> decompressed(size);
+	if (!deferred.decompress_levels(decompressed.data(), 0) ||
+	    !compare_layers(tex.get_layout().data(), decompressed.data(), size))
+		return EXIT_FAILURE;
+
+	LOGI("Supercompressed texture round-trip OK.\n");
+	return EXIT_SUCCESS;
+}
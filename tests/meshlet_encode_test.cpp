@@ -0,0 +1,120 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "meshlet_export.hpp"
+#include "meshlet.hpp"
+#include "global_managers_init.hpp"
+#include "filesystem.hpp"
+#include "logging.hpp"
+#include "math.hpp"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace Granite;
+using namespace Vulkan::Meshlet;
+
+// Rolling terrain, large enough that the finest LOD level is encoded in several batches.
+static constexpr unsigned GridSize = 256;
+
+static SceneFormats::Mesh build_grid_mesh()
+{
+	std::vector<vec3> positions;
+	std::vector<uint32_t> indices;
+
+	for (unsigned y = 0; y <= GridSize; y++)
+	{
+		for (unsigned x = 0; x <= GridSize; x++)
+		{
+			float fx = float(x) / float(GridSize);
+			float fy = float(y) / float(GridSize);
+			positions.push_back(vec3(fx, 0.05f * sinf(20.0f * fx) * cosf(13.0f * fy), fy));
+		}
+	}
+
+	for (unsigned y = 0; y < GridSize; y++)
+	{
+		for (unsigned x = 0; x < GridSize; x++)
+		{
+			uint32_t i = y * (GridSize + 1) + x;
+			indices.insert(indices.end(), { i, i + GridSize + 1, i + 1, i + 1, i + GridSize + 1, i + GridSize + 2 });
+		}
+	}
+
+	SceneFormats::Mesh mesh;
+	mesh.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	mesh.index_type = VK_INDEX_TYPE_UINT32;
+	mesh.count = uint32_t(indices.size());
+	mesh.indices.resize(indices.size() * sizeof(uint32_t));
+	memcpy(mesh.indices.data(), indices.data(), mesh.indices.size());
+
+	mesh.attribute_layout[int(MeshAttribute::Position)].format = VK_FORMAT_R32G32B32_SFLOAT;
+	mesh.position_stride = sizeof(vec3);
+	mesh.positions.resize(positions.size() * sizeof(vec3));
+	memcpy(mesh.positions.data(), positions.data(), mesh.positions.size());
+	return mesh;
+}
+
+static FileMappingHandle export_mesh(const SceneFormats::Mesh &mesh, const char *path, Meshlet::ExportFlags flags)
+{
+	if (!Meshlet::export_mesh_to_meshlet(path, mesh, MeshStyle::Wireframe, flags))
+	{
+		LOGE("Failed to export %s.\n", path);
+		return {};
+	}
+
+	auto file = GRANITE_FILESYSTEM()->open(path, FileMode::ReadOnly);
+	return file ? file->map() : FileMappingHandle{};
+}
+
+int main()
+{
+	Global::init(Global::MANAGER_FEATURE_FILESYSTEM_BIT | Global::MANAGER_FEATURE_THREAD_GROUP_BIT, 4);
+	auto mesh = build_grid_mesh();
+
+	auto batched = export_mesh(mesh, "memory://batched.msh4", 0);
+	auto serial = export_mesh(mesh, "memory://serial.msh4", Meshlet::EXPORT_SERIAL_ENCODE_BIT);
+	if (!batched || !serial)
+		return EXIT_FAILURE;
+
+	// Batches are 1024 meshlets, make sure several of them were encoded in parallel.
+	auto view = create_mesh_view(*batched);
+	if (!view.format_header || view.format_header->meshlet_count <= 2 * 1024)
+	{
+		LOGE("Expected more than two batches of meshlets.\n");
+		return EXIT_FAILURE;
+	}
+
+	if (batched->get_size() != serial->get_size() ||
+	    memcmp(batched->data(), serial->data(), batched->get_size()) != 0)
+	{
+		LOGE("Batched encode does not match serial encode.\n");
+		return EXIT_FAILURE;
+	}
+
+	LOGI("Batched encode of %u meshlets matches serial encode.\n", view.format_header->meshlet_count);
+	batched.reset();
+	serial.reset();
+	Global::deinit();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,254 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "meshlet.hpp"
+#include "logging.hpp"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace Vulkan;
+using namespace Vulkan::Meshlet;
+
+// A small cluster DAG, built the way the exporter builds it:
+// LOD 0 has eight clusters in two groups of four, A on the left and B on the right.
+// Each group is simplified into two LOD 1 clusters, and all of LOD 1 forms one group which becomes the LOD 2 root.
+// A cluster's own bound and error are those of the group it was simplified from,
+// and its parent bound and error are those of the group it is part of.
+static constexpr uint32_t NumLevels = 3;
+static constexpr uint32_t ClusterCount[NumLevels] = { 8, 4, 1 };
+static constexpr uint32_t TrianglesPerCluster = 32;
+
+static constexpr float GroupError[NumLevels] = { 0.0f, 0.01f, 0.05f };
+
+struct Sphere
+{
+	float center[3];
+	float radius;
+};
+
+static const Sphere GroupA = { { -1.0f, 0.0f, 0.0f }, 1.0f };
+static const Sphere GroupB = { { 1.0f, 0.0f, 0.0f }, 1.0f };
+static const Sphere GroupC = { { 0.0f, 0.0f, 0.0f }, 2.0f };
+
+struct Dag
+{
+	FormatHeader headers[NumLevels] = {};
+	std::vector<Stream> streams[NumLevels];
+	std::vector<LodBound> lods[NumLevels];
+	MeshView views[NumLevels] = {};
+};
+
+static void set_bound(LodBound &lod, const Sphere &self, float error, const Sphere &parent, float parent_error)
+{
+	memcpy(lod.center, self.center, sizeof(lod.center));
+	lod.radius = self.radius;
+	lod.error = error;
+	memcpy(lod.parent_center, parent.center, sizeof(lod.parent_center));
+	lod.parent_radius = parent.radius;
+	lod.parent_error = parent_error;
+}
+
+// Index of the LOD 0 group, or the LOD 1 group it was simplified from.
+static uint32_t get_group(uint32_t level, uint32_t cluster)
+{
+	return level == 0 ? cluster / 4 : cluster / 2;
+}
+
+static void build_dag(Dag &dag)
+{
+	for (uint32_t level = 0; level < NumLevels; level++)
+	{
+		auto &lods = dag.lods[level];
+		lods.resize(ClusterCount[level]);
+		for (uint32_t i = 0; i < ClusterCount[level]; i++)
+		{
+			const Sphere &group = get_group(level, i) ? GroupB : GroupA;
+			if (level == 0)
+				set_bound(lods[i], group, 0.0f, group, GroupError[1]);
+			else if (level == 1)
+				set_bound(lods[i], group, GroupError[1], GroupC, GroupError[2]);
+			else
+				set_bound(lods[i], GroupC, GroupError[2], GroupC, FLT_MAX);
+		}
+
+		Stream stream = {};
+		stream.u.counts.prim_count = TrianglesPerCluster;
+		stream.u.counts.vert_count = TrianglesPerCluster;
+		dag.streams[level].assign(ClusterCount[level], stream);
+
+		dag.headers[level].style = MeshStyle::Wireframe;
+		dag.headers[level].stream_count = 1;
+		dag.headers[level].meshlet_count = ClusterCount[level];
+
+		auto &view = dag.views[level];
+		view.format_header = &dag.headers[level];
+		view.streams = dag.streams[level].data();
+		view.lod_bounds = lods.data();
+		view.num_bounds = ClusterCount[level];
+		view.lod_level = level;
+		view.num_lod_levels = NumLevels;
+	}
+}
+
+struct CutState
+{
+	bool selected[NumLevels][8] = {};
+	uint32_t triangles = 0;
+};
+
+static bool all_or_none(const bool *selected, uint32_t begin, uint32_t end, bool &state)
+{
+	state = selected[begin];
+	for (uint32_t i = begin + 1; i < end; i++)
+		if (selected[i] != state)
+			return false;
+	return true;
+}
+
+// Siblings always switch together, and every part of the surface is covered by exactly one level.
+static bool check_cut(const Dag &dag, const std::vector<LodSelection> &selection, CutState &state)
+{
+	state = {};
+	for (auto &sel : selection)
+	{
+		if (sel.lod_level >= NumLevels || sel.meshlet_index >= ClusterCount[sel.lod_level] ||
+		    state.selected[sel.lod_level][sel.meshlet_index])
+		{
+			LOGE("Invalid or duplicate selection.\n");
+			return false;
+		}
+
+		state.selected[sel.lod_level][sel.meshlet_index] = true;
+		state.triangles += dag.streams[sel.lod_level][sel.meshlet_index].u.counts.prim_count;
+	}
+
+	bool root = state.selected[2][0];
+	for (uint32_t group = 0; group < 2; group++)
+	{
+		bool leaves, simplified;
+		if (!all_or_none(state.selected[0], group * 4, group * 4 + 4, leaves) ||
+		    !all_or_none(state.selected[1], group * 2, group * 2 + 2, simplified))
+		{
+			LOGE("Group %u is split across levels.\n", group);
+			return false;
+		}
+
+		if (int(leaves) + int(simplified) + int(root) != 1)
+		{
+			LOGE("Group %u is covered %d times.\n", group, int(leaves) + int(simplified) + int(root));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main()
+{
+	Dag dag;
+	build_dag(dag);
+
+	LodCutInfo info = {};
+	info.error_scale = 1000.0f;
+	info.error_threshold = 1.0f;
+
+	std::vector<LodSelection> selection;
+	uint32_t prev_triangles = UINT32_MAX;
+	uint32_t prev_level_triangles = UINT32_MAX;
+	bool saw_mixed_cut = false;
+	bool saw_levels[NumLevels] = {};
+
+	// Move the camera away from group A. Group B is further away and coarsens first.
+	for (float dist = 1.5f; dist < 1000.0f; dist *= 1.05f)
+	{
+		info.camera_position[0] = GroupA.center[0] - dist;
+		select_lod_cut(dag.views, NumLevels, info, selection);
+
+		CutState state;
+		if (!check_cut(dag, selection, state))
+		{
+			LOGE("Inconsistent cut at distance %.3f.\n", dist);
+			return EXIT_FAILURE;
+		}
+
+		if (state.triangles > prev_triangles)
+		{
+			LOGE("Triangle count increased from %u to %u at distance %.3f.\n", prev_triangles, state.triangles, dist);
+			return EXIT_FAILURE;
+		}
+
+		// When the cut is a single level, each coarser level has fewer triangles than the previous.
+		for (uint32_t level = 0; level < NumLevels; level++)
+		{
+			bool whole_level = true;
+			for (uint32_t i = 0; i < ClusterCount[level]; i++)
+				whole_level = whole_level && state.selected[level][i];
+
+			if (whole_level && !saw_levels[level])
+			{
+				if (state.triangles >= prev_level_triangles)
+				{
+					LOGE("LOD %u has %u triangles, not fewer than the finer level.\n", level, state.triangles);
+					return EXIT_FAILURE;
+				}
+				prev_level_triangles = state.triangles;
+				saw_levels[level] = true;
+			}
+		}
+
+		if (state.selected[0][0] && state.selected[1][2])
+			saw_mixed_cut = true;
+
+		prev_triangles = state.triangles;
+	}
+
+	for (uint32_t level = 0; level < NumLevels; level++)
+	{
+		if (!saw_levels[level])
+		{
+			LOGE("Never selected all of LOD %u.\n", level);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!saw_mixed_cut)
+	{
+		LOGE("Never selected a cut across LOD levels.\n");
+		return EXIT_FAILURE;
+	}
+
+	// Inside a group's bound, its error is unbounded and the full detail clusters must be used.
+	info.camera_position[0] = GroupB.center[0];
+	select_lod_cut(dag.views, NumLevels, info, selection);
+	CutState state;
+	if (!check_cut(dag, selection, state) || !state.selected[0][4])
+	{
+		LOGE("Expected full detail inside group B.\n");
+		return EXIT_FAILURE;
+	}
+
+	LOGI("LOD cut OK.\n");
+	return EXIT_SUCCESS;
+}
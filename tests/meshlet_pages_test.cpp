@@ -0,0 +1,416 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "meshlet.hpp"
+#include "logging.hpp"
+#include <random>
+#include <float.h>
+#include <string.h>
+#include <stdlib.h>
+
+using namespace Vulkan;
+using namespace Vulkan::Meshlet;
+
+// Wireframe meshlets with random payload. With 32 vertices, every 5-bit index is in range,
+// so any payload decodes. Primitive counts vary to give meshlets of different sizes.
+static constexpr uint32_t VertexCount = 32;
+static constexpr uint32_t PositionBits = 16;
+static constexpr uint32_t PositionWords = (VertexCount * PositionBits * 3 + 31) / 32;
+
+struct SyntheticLevel
+{
+	FormatHeader header = {};
+	std::vector<Bound> bounds;
+	std::vector<Bound> bounds_256;
+	std::vector<Stream> streams;
+	std::vector<LodBound> lods;
+	std::vector<uint32_t> sizes;
+};
+
+struct SyntheticMesh
+{
+	std::vector<PayloadWord> payload;
+	std::vector<SyntheticLevel> levels;
+	std::vector<MeshView> views;
+};
+
+// Primitive counts are random unless given.
+static void add_level(SyntheticMesh &mesh, std::mt19937 &rnd, uint32_t meshlet_count,
+                      uint32_t first_root_chunk, const uint32_t *prim_counts = nullptr)
+{
+	mesh.levels.emplace_back();
+	auto &level = mesh.levels.back();
+	uint32_t lod_level = uint32_t(mesh.levels.size() - 1);
+
+	for (uint32_t i = 0; i < meshlet_count; i++)
+	{
+		uint32_t prim_count = prim_counts ? prim_counts[i] : 1 + rnd() % MaxElements;
+		uint32_t prim_words = (prim_count * 15 + 31) / 32;
+
+		Stream prim = {};
+		prim.u.counts.prim_count = prim_count;
+		prim.u.counts.vert_count = VertexCount;
+		prim.offset_in_words = uint32_t(mesh.payload.size());
+
+		Stream pos = {};
+		pos.u.base_value[0] = rnd();
+		pos.u.base_value[1] = rnd();
+		pos.bits = PositionBits;
+		pos.offset_in_words = prim.offset_in_words + prim_words;
+
+		level.streams.push_back(prim);
+		level.streams.push_back(pos);
+		level.sizes.push_back(prim_words + PositionWords);
+
+		for (uint32_t j = 0; j < prim_words + PositionWords; j++)
+			mesh.payload.push_back(rnd());
+
+		LodBound lod = {};
+		lod.error = float(lod_level);
+		lod.parent_error = i / ChunkFactor >= first_root_chunk ? FLT_MAX : float(lod_level + 1);
+		level.lods.push_back(lod);
+	}
+
+	level.header.style = MeshStyle::Wireframe;
+	level.header.stream_count = 2;
+	level.header.meshlet_count = meshlet_count;
+	level.bounds.resize(meshlet_count);
+	level.bounds_256.resize((meshlet_count + ChunkFactor - 1) / ChunkFactor);
+}
+
+static void finalize_views(SyntheticMesh &mesh)
+{
+	uint32_t payload_size_words = uint32_t(mesh.payload.size());
+	// Padding word, like in the file.
+	mesh.payload.push_back(0);
+
+	mesh.views.clear();
+	for (auto &level : mesh.levels)
+	{
+		level.header.payload_size_words = payload_size_words;
+
+		MeshView view = {};
+		view.format_header = &level.header;
+		view.bounds = level.bounds.data();
+		view.bounds_256 = level.bounds_256.data();
+		view.streams = level.streams.data();
+		view.payload = mesh.payload.data();
+		view.lod_bounds = level.lods.data();
+		view.num_bounds = level.header.meshlet_count;
+		view.num_bounds_256 = uint32_t(level.bounds_256.size());
+		view.lod_level = uint32_t(mesh.views.size());
+		view.num_lod_levels = uint32_t(mesh.levels.size());
+		mesh.views.push_back(view);
+	}
+}
+
+static bool check_chunks(const std::vector<ResidencyChunk> &chunks, const std::vector<ResidencyChunk> &expected,
+                         uint32_t residency_level)
+{
+	bool equal = chunks.size() == expected.size();
+	for (size_t i = 0; equal && i < chunks.size(); i++)
+		equal = chunks[i].lod_level == expected[i].lod_level && chunks[i].chunk_index == expected[i].chunk_index;
+
+	if (!equal)
+		LOGE("Residency level %u does not hold the expected chunks.\n", residency_level);
+	return equal;
+}
+
+static bool test_residency_levels(SyntheticMesh &mesh)
+{
+	auto num_levels = uint32_t(mesh.views.size());
+	std::vector<ResidencyChunk> residency_levels[MaxLodLevels];
+
+	if (build_residency_levels(mesh.views.data(), num_levels, residency_levels) != num_levels)
+	{
+		LOGE("Mesh should be streamable.\n");
+		return false;
+	}
+
+	// LOD 0 chunks 22 to 24 are roots, and go into the coarsest level along with all of LOD 2.
+	std::vector<ResidencyChunk> expected[3];
+	for (uint32_t i = 0; i < 22; i++)
+		expected[0].push_back({ 0, i });
+	for (uint32_t i = 0; i < 8; i++)
+		expected[1].push_back({ 1, i });
+	for (uint32_t i = 22; i < 25; i++)
+		expected[2].push_back({ 0, i });
+	expected[2].push_back({ 2, 0 });
+	expected[2].push_back({ 2, 1 });
+
+	for (uint32_t i = 0; i < num_levels; i++)
+		if (!check_chunks(residency_levels[i], expected[i], i))
+			return false;
+
+	// A chunk which straddles groups makes the mesh unstreamable, and it falls back to the full detail mesh.
+	mesh.levels[0].lods[3 * ChunkFactor + 1].parent_error = FLT_MAX;
+	uint32_t count = build_residency_levels(mesh.views.data(), num_levels, residency_levels);
+	mesh.levels[0].lods[3 * ChunkFactor + 1].parent_error = 1.0f;
+
+	if (count != 1)
+	{
+		LOGE("Straddling chunk should not be streamable.\n");
+		return false;
+	}
+
+	expected[0].clear();
+	for (uint32_t i = 0; i < mesh.views[0].num_bounds_256; i++)
+		expected[0].push_back({ 0, i });
+	if (!check_chunks(residency_levels[0], expected[0], 0))
+		return false;
+
+	// A single LOD level is never split.
+	if (build_residency_levels(mesh.views.data(), 1, residency_levels) != 1 ||
+	    !check_chunks(residency_levels[0], expected[0], 0))
+		return false;
+
+	return true;
+}
+
+// Gathers the streams of the chunks in the same layout as the pages, but pointing into the original payload.
+static void gather_reference_streams(const SyntheticMesh &mesh, const std::vector<ResidencyChunk> &chunks,
+                                     std::vector<Stream> &streams)
+{
+	streams.clear();
+	streams.resize(chunks.size() * ChunkFactor * 2);
+	for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+	{
+		auto &view = mesh.views[chunks[chunk].lod_level];
+		uint32_t begin = chunks[chunk].chunk_index * ChunkFactor;
+		uint32_t end = std::min(begin + ChunkFactor, view.num_bounds);
+		for (uint32_t i = begin; i < end; i++)
+			memcpy(&streams[(chunk * ChunkFactor + i - begin) * 2], view.streams + 2 * i, 2 * sizeof(Stream));
+	}
+}
+
+static bool check_page_boundaries(const SyntheticMesh &mesh, const std::vector<ResidencyChunk> &chunks,
+                                  const PayloadPages &pages)
+{
+	uint32_t prev_page = 0;
+	uint32_t prev_end = 0;
+	bool first = true;
+
+	for (size_t chunk = 0; chunk < chunks.size(); chunk++)
+	{
+		auto &level = mesh.levels[chunks[chunk].lod_level];
+		uint32_t begin = chunks[chunk].chunk_index * ChunkFactor;
+		uint32_t end = std::min(begin + ChunkFactor, level.header.meshlet_count);
+
+		for (uint32_t i = begin; i < end; i++)
+		{
+			auto *streams = &pages.streams[(chunk * ChunkFactor + i - begin) * 2];
+			uint32_t start = std::min(streams[0].offset_in_words, streams[1].offset_in_words);
+			uint32_t page = start / PayloadPageWords;
+			uint32_t offset = start % PayloadPageWords;
+			uint32_t size = level.sizes[i];
+
+			// Meshlets never cross into the padding word at the end of a page.
+			if (offset + size > PayloadPageWords - 1)
+			{
+				LOGE("Meshlet %u of LOD %u crosses a page boundary.\n", i, chunks[chunk].lod_level);
+				return false;
+			}
+
+			// Meshlets are packed back to back, and a new page is only started when the next meshlet does not fit.
+			bool packed;
+			if (first)
+				packed = start == 0;
+			else if (page == prev_page)
+				packed = offset == prev_end;
+			else
+				packed = page == prev_page + 1 && offset == 0 && prev_end + size > PayloadPageWords - 1;
+
+			if (!packed)
+			{
+				LOGE("Meshlet %u of LOD %u is not packed.\n", i, chunks[chunk].lod_level);
+				return false;
+			}
+
+			prev_page = page;
+			prev_end = offset + size;
+			first = false;
+		}
+	}
+
+	if (pages.num_pages != prev_page + 1)
+	{
+		LOGE("Expected %u pages, got %u.\n", prev_page + 1, pages.num_pages);
+		return false;
+	}
+
+	return true;
+}
+
+static bool compare_decoded(const DecodedMesh &a, const DecodedMesh &b)
+{
+	return a.indices == b.indices && a.positions.size() == b.positions.size() &&
+	       memcmp(a.positions.data(), b.positions.data(), a.positions.size() * sizeof(float)) == 0;
+}
+
+static bool test_payload_pages(const SyntheticMesh &mesh)
+{
+	auto num_levels = uint32_t(mesh.views.size());
+	std::vector<ResidencyChunk> residency_levels[MaxLodLevels];
+	build_residency_levels(mesh.views.data(), num_levels, residency_levels);
+
+	for (uint32_t residency_level = 0; residency_level < num_levels; residency_level++)
+	{
+		auto &chunks = residency_levels[residency_level];
+
+		PayloadPages pages, layout_only;
+		if (!build_payload_pages(mesh.views.data(), num_levels, chunks.data(), chunks.size(), true, pages) ||
+		    !build_payload_pages(mesh.views.data(), num_levels, chunks.data(), chunks.size(), false, layout_only))
+		{
+			LOGE("Failed to build pages for residency level %u.\n", residency_level);
+			return false;
+		}
+
+		// The finest level is large enough to span pages.
+		if (residency_level == 0 && pages.num_pages < 2)
+		{
+			LOGE("Expected multiple pages, got %u.\n", pages.num_pages);
+			return false;
+		}
+
+		if (pages.payload.size() != size_t(pages.num_pages) * PayloadPageWords)
+		{
+			LOGE("Unexpected payload size.\n");
+			return false;
+		}
+
+		// Computing the layout alone must not change it.
+		if (layout_only.num_pages != pages.num_pages || !layout_only.payload.empty() ||
+		    layout_only.streams.size() != pages.streams.size() ||
+		    memcmp(layout_only.streams.data(), pages.streams.data(), pages.streams.size() * sizeof(Stream)) != 0)
+		{
+			LOGE("Layout differs without payload for residency level %u.\n", residency_level);
+			return false;
+		}
+
+		if (!check_page_boundaries(mesh, chunks, pages))
+			return false;
+
+		FormatHeader header = mesh.levels[0].header;
+		header.meshlet_count = uint32_t(chunks.size() * ChunkFactor);
+
+		std::vector<Stream> reference_streams;
+		gather_reference_streams(mesh, chunks, reference_streams);
+		MeshView reference = {};
+		reference.format_header = &header;
+		reference.streams = reference_streams.data();
+		reference.payload = mesh.payload.data();
+
+		FormatHeader paged_header = header;
+		paged_header.payload_size_words = uint32_t(pages.payload.size());
+		MeshView paged = {};
+		paged.format_header = &paged_header;
+		paged.streams = pages.streams.data();
+		paged.payload = pages.payload.data();
+
+		DecodedMesh reference_mesh, paged_mesh;
+		if (!decode_mesh_cpu(reference, reference_mesh) || !decode_mesh_cpu(paged, paged_mesh))
+		{
+			LOGE("Failed to decode residency level %u.\n", residency_level);
+			return false;
+		}
+
+		if (reference_mesh.indices.empty() || !compare_decoded(reference_mesh, paged_mesh))
+		{
+			LOGE("Pages of residency level %u do not decode to the original meshlets.\n", residency_level);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Meshlets of 63 and 62 words, sized to land exactly on the end of a page.
+static constexpr uint32_t PrimCount63 = 32;
+static constexpr uint32_t PrimCount62 = 28;
+
+static bool test_page_boundary(std::mt19937 &rnd, const std::vector<uint32_t> &prim_counts,
+                               uint32_t expected_first_page_meshlets)
+{
+	SyntheticMesh mesh;
+	add_level(mesh, rnd, uint32_t(prim_counts.size()), 0, prim_counts.data());
+	finalize_views(mesh);
+
+	std::vector<ResidencyChunk> chunks;
+	for (uint32_t i = 0; i < mesh.views[0].num_bounds_256; i++)
+		chunks.push_back({ 0, i });
+
+	PayloadPages pages;
+	if (!build_payload_pages(mesh.views.data(), 1, chunks.data(), chunks.size(), true, pages) ||
+	    !check_page_boundaries(mesh, chunks, pages))
+		return false;
+
+	auto &first_on_next_page = pages.streams[expected_first_page_meshlets * 2];
+	auto &last_on_first_page = pages.streams[(expected_first_page_meshlets - 1) * 2];
+	if (first_on_next_page.offset_in_words != PayloadPageWords ||
+	    last_on_first_page.offset_in_words >= PayloadPageWords)
+	{
+		LOGE("Expected %u meshlets in the first page.\n", expected_first_page_meshlets);
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_page_boundaries(std::mt19937 &rnd)
+{
+	// 65 meshlets of 63 words fill the page up to the padding word.
+	std::vector<uint32_t> exact_fill(72, PrimCount63);
+	if (!test_page_boundary(rnd, exact_fill, 65))
+		return false;
+
+	// The 66th meshlet would end exactly at PayloadPageWords, which overlaps the padding word.
+	std::vector<uint32_t> overlap_padding(72, PrimCount62);
+	for (unsigned i = 0; i < 4; i++)
+		overlap_padding[i] = PrimCount63;
+	if (!test_page_boundary(rnd, overlap_padding, 65))
+		return false;
+
+	return true;
+}
+
+int main()
+{
+	std::mt19937 rnd(1234);
+	SyntheticMesh mesh;
+
+	// The finest level has a partial last chunk.
+	add_level(mesh, rnd, 197, 22);
+	add_level(mesh, rnd, 64, UINT32_MAX);
+	add_level(mesh, rnd, 16, 0);
+	finalize_views(mesh);
+
+	if (!test_residency_levels(mesh))
+		return EXIT_FAILURE;
+	if (!test_payload_pages(mesh))
+		return EXIT_FAILURE;
+	if (!test_page_boundaries(rnd))
+		return EXIT_FAILURE;
+
+	LOGI("Meshlet payload pages OK.\n");
+	return EXIT_SUCCESS;
+}
@@ -41,6 +41,7 @@
 #include "gltf.hpp"
 #include "cli_parser.hpp"
 #include "environment.hpp"
+#include "asset_residency.hpp"
 #include <string.h>
 #include <float.h>
 #include <stdexcept>
@@ -69,6 +70,12 @@ struct MeshletRenderable : AbstractRenderable
 	{
 		return &aabb;
 	}
+
+	const AssetID *get_geometry_asset_dependencies(unsigned &count) const override
+	{
+		count = 1;
+		return &mesh;
+	}
 };
 
 struct MeshletViewerApplication : Granite::Application, Granite::EventHandler //, Vulkan::DebugChannelInterface
@@ -226,6 +233,7 @@ struct MeshletViewerApplication : Granite::Application, Granite::EventHandler //
 	Scene scene;
 	RenderContext render_context;
 	VisibilityList list;
+	AssetResidencyFeedback residency_feedback;
 	BindlessAllocator allocator;
 
 	BufferHandle occluder_buffer;
@@ -888,6 +896,7 @@ struct MeshletViewerApplication : Granite::Application, Granite::EventHandler //
 	void render_frame(double frame_time, double) override
 	{
 		scene.update_all_transforms();
+		residency_feedback.update(scene, camera, frame_time);
 		LOGI("Frame time: %.3f ms.\n", frame_time * 1e3);
 
 		auto &wsi = get_wsi();
@@ -1169,6 +1178,14 @@ struct MeshletViewerApplication : Granite::Application, Granite::EventHandler //
 		}
 	}
 
+	void post_frame() override
+	{
+		// Must happen before the asset manager iterates.
+		if (auto *manager = GRANITE_ASSET_MANAGER())
+			residency_feedback.commit(*manager);
+		Application::post_frame();
+	}
+
 	BufferHandle readback_ring_phase1[4];
 	BufferHandle readback_ring_phase2[4];
 	BufferHandle aabb_visibility_ring_phase1[4];
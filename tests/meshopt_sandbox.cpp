@@ -67,8 +67,8 @@ static void decode_attribute_buffer(std::vector<vec3> &out_positions, const Mesh
 	u16vec3 base;
 	decode_bits(base.data, 3, stream.u.base_value, 0, 16);
 
-	for (auto &p : positions)
-		p += base;
+	for (uint32_t i = 0; i < num_attributes; i++)
+		positions[i] += base;
 
 	int exp = int(stream.bits) >> 16;
 
@@ -96,8 +96,8 @@ static void decode_attribute_buffer(std::vector<vec2> &out_uvs, const MeshView &
 	u16vec2 base;
 	decode_bits(base.data, 2, stream.u.base_value, 0, 16);
 
-	for (auto &p : uvs)
-		p += base;
+	for (uint32_t i = 0; i < num_attributes; i++)
+		uvs[i] += base;
 
 	int exp = int(stream.bits) >> 16;
 
@@ -153,8 +153,8 @@ static void decode_attribute_buffer(std::vector<vec3> &out_normals, std::vector<
 	u8vec4 base;
 	decode_bits(base.data, 4, stream.u.base_value, 0, 8);
 
-	for (auto &p : nts)
-		p += base;
+	for (uint32_t i = 0; i < num_attributes; i++)
+		nts[i] += base;
 
 	if (aux == 3)
 	{
@@ -174,12 +174,13 @@ static void decode_attribute_buffer(std::vector<vec3> &out_normals, std::vector<
 	}
 }
 
-static void decode_mesh(std::vector<uvec3> &out_index_buffer,
-                        std::vector<vec3> &out_positions,
-						std::vector<vec2> &out_uvs,
-						std::vector<vec3> &out_normals,
-						std::vector<vec4> &out_tangents,
-                        const MeshView &mesh)
+// Straightforward bit-by-bit decoder which is kept independent of decode_mesh_cpu() to cross-check it.
+static void decode_mesh_reference(std::vector<uvec3> &out_index_buffer,
+                                  std::vector<vec3> &out_positions,
+                                  std::vector<vec2> &out_uvs,
+                                  std::vector<vec3> &out_normals,
+                                  std::vector<vec4> &out_tangents,
+                                  const MeshView &mesh)
 {
 	uint32_t base_vertex_offset = 0;
 	for (uint32_t meshlet_index = 0; meshlet_index < mesh.format_header->meshlet_count; meshlet_index++)
@@ -191,6 +192,33 @@ static void decode_mesh(std::vector<uvec3> &out_index_buffer,
 	}
 }
 
+static bool decode_mesh(std::vector<uvec3> &out_index_buffer,
+                        std::vector<vec3> &out_positions,
+                        std::vector<vec2> &out_uvs,
+                        std::vector<vec3> &out_normals,
+                        std::vector<vec4> &out_tangents,
+                        const MeshView &mesh)
+{
+	DecodedMesh decoded;
+	if (!decode_mesh_cpu(mesh, decoded))
+		return false;
+
+	out_index_buffer.resize(decoded.indices.size() / 3);
+	memcpy(out_index_buffer.data(), decoded.indices.data(), decoded.indices.size() * sizeof(uint32_t));
+
+	size_t num_vertices = decoded.positions.size() / 3;
+	out_positions.resize(num_vertices);
+	out_uvs.resize(num_vertices);
+	out_normals.resize(num_vertices);
+	out_tangents.resize(num_vertices);
+
+	memcpy(out_positions.data(), decoded.positions.data(), decoded.positions.size() * sizeof(float));
+	memcpy(out_uvs.data(), decoded.uvs.data(), decoded.uvs.size() * sizeof(float));
+	memcpy(out_normals.data(), decoded.normals.data(), decoded.normals.size() * sizeof(float));
+	memcpy(out_tangents.data(), decoded.tangents.data(), decoded.tangents.size() * sizeof(float));
+	return true;
+}
+
 static vec4 decode_bgr10a2(uint32_t v)
 {
 	vec4 fvalue = vec4(ivec4((uvec4(v) >> uvec4(0, 10, 20, 30)) & 0x3ffu) - ivec4(512, 512, 512, 2)) *
@@ -528,7 +556,8 @@ int main(int argc, char **argv)
 		memcpy(mesh.attributes.data(), reference_attributes.data(), mesh.attributes.size());
 	}
 
-	if (!Meshlet::export_mesh_to_meshlet("export.msh3", std::move(mesh), MeshStyle::Textured))
+	if (!Meshlet::export_mesh_to_meshlet("export.msh3", std::move(mesh), MeshStyle::Textured,
+	                                     Meshlet::EXPORT_VERIFY_DECODE_BIT))
 		return EXIT_FAILURE;
 
 	auto file = GRANITE_FILESYSTEM()->open("export.msh3", FileMode::ReadOnly);
@@ -545,7 +574,32 @@ int main(int argc, char **argv)
 	std::vector<vec3> decoded_normals;
 	std::vector<vec4> decoded_tangents;
 	auto view = create_mesh_view(*mapped);
-	decode_mesh(decoded_index_buffer, decoded_positions, decoded_uvs, decoded_normals, decoded_tangents, view);
+	if (!decode_mesh(decoded_index_buffer, decoded_positions, decoded_uvs, decoded_normals, decoded_tangents, view))
+		return EXIT_FAILURE;
+
+	{
+		std::vector<uvec3> ref_index_buffer;
+		std::vector<vec3> ref_positions;
+		std::vector<vec2> ref_uvs;
+		std::vector<vec3> ref_normals;
+		std::vector<vec4> ref_tangents;
+		decode_mesh_reference(ref_index_buffer, ref_positions, ref_uvs, ref_normals, ref_tangents, view);
+
+		if (ref_index_buffer != decoded_index_buffer)
+		{
+			LOGE("Mismatch in index buffer between reference and CPU decoder.\n");
+			return EXIT_FAILURE;
+		}
+
+		if (!validate_mesh(ref_index_buffer, ref_positions, decoded_index_buffer, decoded_positions, false))
+			return EXIT_FAILURE;
+		if (!validate_mesh_attribute(ref_index_buffer, ref_uvs, decoded_index_buffer, decoded_uvs, 0.0f))
+			return EXIT_FAILURE;
+		if (!validate_mesh_attribute(ref_index_buffer, ref_normals, decoded_index_buffer, decoded_normals, 1e-5f))
+			return EXIT_FAILURE;
+		if (!validate_mesh_attribute(ref_index_buffer, ref_tangents, decoded_index_buffer, decoded_tangents, 1e-5f))
+			return EXIT_FAILURE;
+	}
 
 #define TEST_GPU 1
 
@@ -0,0 +1,240 @@
+#include "netfs_server.hpp"
+#include "fs-netfs.hpp"
+#include "os_filesystem.hpp"
+#include "logging.hpp"
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+using namespace Granite;
+
+// Don't collide with a NetFS server which is already running on the default port.
+static constexpr uint16_t TestPort = NetFSDefaultPort + 1;
+
+static std::vector<uint8_t> make_payload(size_t size, unsigned seed)
+{
+	// Compressible, but not trivially so.
+	std::vector<uint8_t> data(size);
+	for (size_t i = 0; i < size; i++)
+		data[i] = uint8_t(((i / 64) * seed) ^ (i % 7));
+	return data;
+}
+
+static bool write_payload(OSFilesystem &fs, const std::string &path, const std::vector<uint8_t> &data)
+{
+	auto file = fs.open(path, FileMode::WriteOnlyTransactional);
+	auto mapping = file ? file->map_write(data.size()) : FileMappingHandle{};
+	if (!mapping)
+		return false;
+	memcpy(mapping->mutable_data(), data.data(), data.size());
+	return true;
+}
+
+static bool check_mapping(File &file, uint64_t offset, size_t size, const std::vector<uint8_t> &expected)
+{
+	auto mapping = file.map_subset(offset, size);
+	if (!mapping)
+	{
+		LOGE("Failed to map [%llu, +%zu).\n", static_cast<unsigned long long>(offset), size);
+		return false;
+	}
+
+	if (mapping->get_size() != size || memcmp(mapping->data(), expected.data() + offset, size) != 0)
+	{
+		LOGE("Mismatch in [%llu, +%zu).\n", static_cast<unsigned long long>(offset), size);
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_compressed_read(const std::string &cache_dir, const std::vector<uint8_t> &payload)
+{
+	NetworkFilesystem client(cache_dir, TestPort);
+	client.set_protocol("netfs-test");
+	client.set_compression(true);
+
+	auto file = client.open("payload.bin", FileMode::ReadOnly);
+	if (!file || file->get_size() != payload.size())
+	{
+		LOGE("Failed to open payload.bin.\n");
+		return false;
+	}
+
+	// Ranged read, only the range goes over the wire, and it must come back compressed.
+	if (!check_mapping(*file, 4096, 64 * 1024, payload))
+		return false;
+
+	auto stats = client.get_transfer_stats();
+	if (stats.range_reads != 1 || stats.data_bytes != 64 * 1024 || stats.wire_bytes >= stats.data_bytes)
+	{
+		LOGE("Unexpected stats for compressed read: %llu reads, %llu wire bytes, %llu data bytes.\n",
+		     static_cast<unsigned long long>(stats.range_reads),
+		     static_cast<unsigned long long>(stats.wire_bytes),
+		     static_cast<unsigned long long>(stats.data_bytes));
+		return false;
+	}
+
+	// Whole file read populates the content cache.
+	if (!check_mapping(*file, 0, payload.size(), payload))
+		return false;
+
+	stats = client.get_transfer_stats();
+	if (stats.range_reads != 2 || stats.cache_hits != 0)
+	{
+		LOGE("Unexpected stats after full read.\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_cache_hit(const std::string &cache_dir, const std::vector<uint8_t> &payload)
+{
+	// A new client must find the file in the cache, and never read from the server.
+	NetworkFilesystem client(cache_dir, TestPort);
+	client.set_protocol("netfs-test");
+
+	auto file = client.open("payload.bin", FileMode::ReadOnly);
+	if (!file || !check_mapping(*file, 0, payload.size(), payload) || !check_mapping(*file, 100, 1000, payload))
+		return false;
+
+	auto stats = client.get_transfer_stats();
+	if (stats.cache_hits != 1 || stats.range_reads != 0)
+	{
+		LOGE("Expected a cache hit, got %llu hits and %llu reads.\n",
+		     static_cast<unsigned long long>(stats.cache_hits),
+		     static_cast<unsigned long long>(stats.range_reads));
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_cache_invalidation(const std::string &cache_dir, const std::vector<uint8_t> &payload)
+{
+	// The remote file changed, so the cached copy is stale.
+	NetworkFilesystem client(cache_dir, TestPort);
+	client.set_protocol("netfs-test");
+
+	auto file = client.open("payload.bin", FileMode::ReadOnly);
+	if (!file || !check_mapping(*file, 0, payload.size(), payload))
+		return false;
+
+	// Without compression the payload is sent as-is.
+	auto stats = client.get_transfer_stats();
+	if (stats.cache_hits != 0 || stats.range_reads != 1 || stats.wire_bytes != payload.size())
+	{
+		LOGE("Stale cache entry was used.\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_oversized_request()
+{
+	// A session request announcing a huge payload must be rejected before the server allocates for it.
+	auto socket = Socket::connect("127.0.0.1", TestPort);
+	if (!socket)
+	{
+		LOGE("Failed to connect.\n");
+		return false;
+	}
+
+	int fd = socket->get_fd();
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+	struct timeval timeout = { 5, 0 };
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	ReplyBuilder builder;
+	builder.add_u32(NETFS_BEGIN_SESSION);
+	builder.add_u32(NETFS_BEGIN_CHUNK_REQUEST);
+	builder.add_string("netfs-test");
+	builder.add_u32(NETFS_SESSION_REQUEST);
+	builder.add_u32(NETFS_READ_FILE_RANGE);
+	builder.add_u64(1);
+	builder.add_u64(uint64_t(1) << 40);
+
+	auto &buffer = builder.get_buffer();
+	if (::send(fd, buffer.data(), buffer.size(), MSG_NOSIGNAL) != ssize_t(buffer.size()))
+	{
+		LOGE("Failed to send request.\n");
+		return false;
+	}
+
+	// The server closes the connection rather than replying.
+	uint8_t dummy;
+	if (::recv(fd, &dummy, sizeof(dummy), 0) != 0)
+	{
+		LOGE("Server did not drop a session with an oversized request.\n");
+		return false;
+	}
+
+	return true;
+}
+
+static void remove_directory(OSFilesystem &fs, const std::string &root, const std::string &dir)
+{
+	for (auto &entry : fs.list(dir))
+		fs.remove(entry.path);
+	rmdir((root + "/" + dir).c_str());
+}
+
+int main()
+{
+	char root_template[] = "/tmp/netfs-test-XXXXXX";
+	if (!mkdtemp(root_template))
+	{
+		LOGE("Failed to create temporary directory.\n");
+		return EXIT_FAILURE;
+	}
+
+	std::string root = root_template;
+	std::string cache_dir = root + "/cache";
+	OSFilesystem root_fs(root);
+
+	auto payload = make_payload(1024 * 1024 + 123, 3);
+	if (!write_payload(root_fs, "data/payload.bin", payload))
+	{
+		LOGE("Failed to write payload.\n");
+		return EXIT_FAILURE;
+	}
+
+	Filesystem server_fs;
+	server_fs.register_protocol("netfs-test", std::make_unique<OSFilesystem>(root + "/data"));
+	NetFSServer server(server_fs, TestPort);
+	std::thread server_thread([&server]() {
+		while (server.iterate());
+	});
+
+	// The server must keep serving other clients after dropping a bad one.
+	bool ret = test_oversized_request() &&
+	           test_compressed_read(cache_dir, payload) && test_cache_hit(cache_dir, payload);
+
+	if (ret)
+	{
+		payload = make_payload(512 * 1024 + 7, 5);
+		ret = write_payload(root_fs, "data/payload.bin", payload) &&
+		      test_cache_invalidation(cache_dir, payload);
+	}
+
+	server.kill();
+	server_thread.join();
+
+	remove_directory(root_fs, root, "data");
+	remove_directory(root_fs, root, "cache");
+	rmdir(root.c_str());
+
+	if (!ret)
+	{
+		LOGE("NetFS test failed.\n");
+		return EXIT_FAILURE;
+	}
+
+	LOGI("NetFS test passed.\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "device.hpp"
+#include "context.hpp"
+#include "global_managers_init.hpp"
+#include "ocean.hpp"
+#include "ocean_query.hpp"
+#include "fft.hpp"
+#include "math.hpp"
+#include "muglm/muglm_impl.hpp"
+#include "thread_group.hpp"
+#include <stdlib.h>
+
+using namespace Granite;
+using namespace Vulkan;
+
+// Runs the same spectrum through generate_fft.comp and the GPU FFT, like Ocean::update_fft_input() and
+// Ocean::compute_fft() do, and reads back the result.
+static bool compute_gpu_field(Device &device, const OceanConfig &config,
+                              const std::vector<vec2> &distribution, unsigned N,
+                              bool displacement, double time, std::vector<vec2> &output)
+{
+	BufferCreateInfo info = {};
+	info.domain = BufferDomain::Device;
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	info.size = distribution.size() * sizeof(vec2);
+	auto distribution_buffer = device.create_buffer(info, distribution.data());
+	info.size = N * N * sizeof(uint32_t);
+	auto fft_input = device.create_buffer(info);
+
+	auto image_info = ImageCreateInfo::immutable_2d_image(
+			N, N, displacement ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R16_SFLOAT);
+	image_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	auto image = device.create_image(image_info);
+
+	FFT fft;
+	FFT::Options options = {};
+	options.data_type = FFT::DataType::FP16;
+	options.dimensions = 2;
+	options.input_resource = FFT::ResourceType::Buffer;
+	options.output_resource = FFT::ResourceType::Texture;
+	options.mode = displacement ? FFT::Mode::InverseComplexToComplex : FFT::Mode::ComplexToReal;
+	options.Nx = N;
+	options.Ny = N;
+	if (!fft.plan(&device, options))
+	{
+		LOGE("Failed to plan FFT.\n");
+		return false;
+	}
+
+	struct Push
+	{
+		vec2 mod;
+		uvec2 N;
+		float freq_to_band_mod;
+		float time;
+		float period;
+	} push = {};
+
+	push.mod = vec2(2.0f * pi<float>()) / OceanSpectrum::heightmap_world_size(config);
+	push.N = uvec2(N);
+	push.time = float(muglm::mod(time, OceanSpectrum::AnimationPeriod));
+	push.period = float(OceanSpectrum::AnimationPeriodScaled);
+
+	// The shader checks for GRADIENT_DISPLACEMENT with #ifdef, so only define it when needed.
+	std::vector<std::pair<std::string, int>> defines;
+	if (displacement)
+		defines.emplace_back("GRADIENT_DISPLACEMENT", 1);
+
+	auto cmd = device.request_command_buffer();
+	cmd->set_program("builtin://shaders/ocean/generate_fft.comp", defines);
+	cmd->set_storage_buffer(0, 0, *distribution_buffer);
+	cmd->set_storage_buffer(0, 1, *fft_input);
+	cmd->push_constants(&push, 0, sizeof(push));
+	cmd->dispatch(N / 64, N, 1);
+
+	cmd->barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+	             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+	cmd->image_barrier(*image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+	                   VK_PIPELINE_STAGE_2_NONE, 0,
+	                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+	FFT::Resource src = {}, dst = {};
+	src.buffer.buffer = fft_input.get();
+	src.buffer.size = fft_input->get_create_info().size;
+	src.buffer.row_stride = N;
+	dst.image.view = &image->get_view();
+	fft.execute(*cmd, dst, src);
+
+	cmd->image_barrier(*image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+	                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+	BufferCreateInfo readback_info = {};
+	readback_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	readback_info.domain = BufferDomain::CachedHost;
+	readback_info.size = N * N * (displacement ? sizeof(u16vec2) : sizeof(uint16_t));
+	auto readback = device.create_buffer(readback_info);
+
+	cmd->copy_image_to_buffer(*readback, *image, 0, {}, { N, N, 1 }, 0, 0,
+	                          { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 });
+	cmd->barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	             VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+	Fence fence;
+	device.submit(cmd, &fence);
+	fence->wait();
+
+	output.resize(N * N);
+	auto *mapped = static_cast<const uint16_t *>(device.map_host_buffer(*readback, MEMORY_ACCESS_READ_BIT));
+	for (unsigned i = 0; i < N * N; i++)
+	{
+		if (displacement)
+			output[i] = halfToFloat(u16vec2(mapped[2 * i + 0], mapped[2 * i + 1]));
+		else
+			output[i] = vec2(halfToFloat(mapped[i]), 0.0f);
+	}
+	device.unmap_host_buffer(*readback, MEMORY_ACCESS_READ_BIT);
+	return true;
+}
+
+static bool compare_fields(const char *tag, const std::vector<vec2> &gpu, const std::vector<vec2> &cpu, float scale)
+{
+	float max_error = 0.0f;
+	float max_value = 0.0f;
+
+	for (size_t i = 0, n = gpu.size(); i < n; i++)
+	{
+		vec2 g = gpu[i] * scale;
+		max_error = muglm::max(max_error, muglm::max(muglm::abs(g.x - cpu[i].x), muglm::abs(g.y - cpu[i].y)));
+		max_value = muglm::max(max_value, muglm::max(muglm::abs(g.x), muglm::abs(g.y)));
+	}
+
+	// Input spectrum and output are FP16 on the GPU.
+	float tolerance = 0.01f * max_value;
+	LOGI("%s: max value %.6f, max error %.6f (tolerance %.6f).\n", tag, max_value, max_error, tolerance);
+	if (max_value == 0.0f || max_error > tolerance)
+	{
+		LOGE("%s: CPU and GPU ocean fields diverge.\n", tag);
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_ocean(Device &device, const OceanConfig &config, double time)
+{
+	// Full resolution, so the CPU and GPU spectra are identical.
+	OceanQuery query(config, config.fft_resolution);
+	query.evaluate(time);
+
+	std::vector<vec2> gpu;
+	if (!compute_gpu_field(device, config, query.get_height_distribution(),
+	                       query.get_height_resolution(), false, time, gpu))
+		return false;
+
+	std::vector<float> height;
+	query.get_height_field(height);
+	std::vector<vec2> cpu(height.size());
+	for (size_t i = 0; i < height.size(); i++)
+		cpu[i] = vec2(height[i], 0.0f);
+	if (!compare_fields("height", gpu, cpu, 1.0f))
+		return false;
+
+	if (!compute_gpu_field(device, config, query.get_displacement_distribution(),
+	                       query.get_displacement_resolution(), true, time, gpu))
+		return false;
+
+	// bake_maps applies lambda.
+	query.get_displacement_field(cpu);
+	if (!compare_fields("displacement", gpu, cpu, OceanSpectrum::DisplacementLambda))
+		return false;
+
+	return true;
+}
+
+int main()
+{
+	Global::init(Global::MANAGER_FEATURE_DEFAULT_BITS, 1);
+
+	if (!Context::init_loader(nullptr))
+		return EXIT_FAILURE;
+
+	Context ctx;
+
+	Context::SystemHandles handles;
+	handles.filesystem = GRANITE_FILESYSTEM();
+	handles.thread_group = GRANITE_THREAD_GROUP();
+	ctx.set_system_handles(handles);
+
+	if (!ctx.init_instance_and_device(nullptr, 0, nullptr, 0))
+		return EXIT_FAILURE;
+
+	Device device;
+	device.set_context(ctx);
+
+	OceanConfig config;
+	config.fft_resolution = 256;
+	config.grid_count = 16;
+	config.grid_resolution = 64;
+	config.ocean_size = vec2(256.0f);
+
+	for (double time : { 0.0, 1.5, 317.25 })
+	{
+		if (!test_ocean(device, config, time))
+			return EXIT_FAILURE;
+		device.wait_idle();
+	}
+
+	LOGI("CPU ocean query matches GPU.\n");
+	return EXIT_SUCCESS;
+}
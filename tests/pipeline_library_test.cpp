@@ -0,0 +1,194 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "global_managers_init.hpp"
+#include "thread_group.hpp"
+#include "context.hpp"
+#include "device.hpp"
+#include "command_buffer.hpp"
+#include <future>
+#include <stdlib.h>
+
+using namespace Granite;
+using namespace Vulkan;
+
+static bool init_context(Context &ctx, ThreadGroup &group)
+{
+	Context::SystemHandles handles = {};
+	handles.filesystem = GRANITE_FILESYSTEM();
+	handles.thread_group = &group;
+	ctx.set_system_handles(handles);
+
+	if (!ctx.init_instance_and_device(nullptr, 0, nullptr, 0, CONTEXT_CREATION_ENABLE_PIPELINE_LIBRARY_BIT))
+		return false;
+	return true;
+}
+
+static bool supports_fast_link(const Device &device)
+{
+	auto &features = device.get_device_features();
+	return features.graphics_pipeline_library_features.graphicsPipelineLibrary &&
+	       features.graphics_pipeline_library_properties.graphicsPipelineLibraryFastLinking;
+}
+
+// Records a draw and returns the pipeline it was bound with.
+static VkPipeline draw_quad(Device &device, const ImageView &view, DeferredPipelineCompile *compile = nullptr)
+{
+	auto cmd = device.request_command_buffer();
+
+	RenderPassInfo rp;
+	rp.color_attachments[0] = &view;
+	rp.num_color_attachments = 1;
+	rp.store_attachments = 1;
+	rp.clear_attachments = 1;
+	cmd->image_barrier(view.get_image(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+	                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+	                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+	cmd->begin_render_pass(rp);
+	CommandBufferUtil::setup_fullscreen_quad(*cmd, "builtin://shaders/quad.vert", "builtin://shaders/dummy.frag");
+	VkPipeline pipeline = cmd->get_current_graphics_pipeline();
+	if (compile)
+		cmd->extract_pipeline_state(*compile);
+	CommandBufferUtil::draw_fullscreen_quad(*cmd);
+	cmd->end_render_pass();
+	device.submit(cmd);
+
+	return pipeline;
+}
+
+static ImageHandle create_render_target(Device &device)
+{
+	auto info = ImageCreateInfo::render_target(64, 64, VK_FORMAT_R8G8B8A8_UNORM);
+	info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	return device.create_image(info);
+}
+
+// The first draw gets a fast-linked pipeline, and once the background compile is done,
+// the same state must bind the optimized pipeline instead.
+static bool test_replacement(ThreadGroup &group, bool &supported)
+{
+	Context ctx;
+	if (!init_context(ctx, group))
+		return false;
+	Device device;
+	device.set_context(ctx);
+
+	supported = supports_fast_link(device);
+	if (!supported)
+		return true;
+
+	auto rt = create_render_target(device);
+
+	DeferredPipelineCompile compile;
+	VkPipeline linked = draw_quad(device, rt->get_view(), &compile);
+	auto stats = device.get_pipeline_library_stats();
+	if (linked == VK_NULL_HANDLE || stats.fast_linked != 1)
+	{
+		LOGE("Expected a fast-linked pipeline on first use, %u were linked.\n", stats.fast_linked);
+		return false;
+	}
+
+	device.wait_for_optimized_pipelines();
+	stats = device.get_pipeline_library_stats();
+	if (stats.optimized != 1)
+	{
+		LOGE("Expected one optimized pipeline, got %u.\n", stats.optimized);
+		return false;
+	}
+
+	VkPipeline optimized = draw_quad(device, rt->get_view());
+	stats = device.get_pipeline_library_stats();
+	if (optimized == VK_NULL_HANDLE || optimized == linked ||
+	    optimized != compile.program->get_pipeline(compile.hash).pipeline || stats.fast_linked != 1)
+	{
+		LOGE("Optimized pipeline did not replace the fast-linked one.\n");
+		return false;
+	}
+
+	device.wait_idle();
+	return true;
+}
+
+// The optimized compile is still queued behind another background task when the Device goes away.
+// Destruction must not wait for it, and the task must not touch the Device once it gets to run.
+static bool test_shutdown_with_queued_compile(ThreadGroup &group)
+{
+	std::promise<void> unblock;
+	auto unblocked = unblock.get_future().share();
+	{
+		auto blocker = group.create_task([unblocked]() {
+			unblocked.wait();
+		});
+		blocker->set_desc("block-background");
+		blocker->set_task_class(TaskClass::Background);
+	}
+
+	{
+		Context ctx;
+		if (!init_context(ctx, group))
+			return false;
+		Device device;
+		device.set_context(ctx);
+
+		auto rt = create_render_target(device);
+		if (draw_quad(device, rt->get_view()) == VK_NULL_HANDLE ||
+		    device.get_pipeline_library_stats().fast_linked != 1)
+		{
+			LOGE("Expected a fast-linked pipeline on first use.\n");
+			unblock.set_value();
+			return false;
+		}
+	}
+
+	unblock.set_value();
+	group.wait_idle();
+	return true;
+}
+
+int main()
+{
+	Global::init(Global::MANAGER_FEATURE_DEFAULT_BITS, 1);
+	if (!Context::init_loader(nullptr))
+		return EXIT_FAILURE;
+
+	// A single background thread, so the shutdown test can keep it busy.
+	ThreadGroup group;
+	group.start(2, 1, {});
+
+	bool supported = false;
+	if (!test_replacement(group, supported))
+		return EXIT_FAILURE;
+
+	if (!supported)
+	{
+		LOGI("Graphics pipeline library fast-linking is not supported, skipping.\n");
+		return EXIT_SUCCESS;
+	}
+	LOGI("Fast-linked pipeline replaced OK.\n");
+
+	if (!test_shutdown_with_queued_compile(group))
+		return EXIT_FAILURE;
+	LOGI("Shutdown with a queued compile OK.\n");
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,209 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "pipeline_usage.hpp"
+#include "logging.hpp"
+#include <stdlib.h>
+
+using namespace Vulkan;
+
+struct Pipeline
+{
+	uint64_t hash;
+};
+
+static PipelineUsage make_use(uint64_t hash, uint32_t frame, uint32_t order, uint32_t sessions)
+{
+	PipelineUsage use = {};
+	use.hash = hash;
+	use.first_use_frame = frame;
+	use.first_use_order = order;
+	use.sessions = sessions;
+	return use;
+}
+
+static bool check_order(const std::vector<Pipeline> &order, const std::vector<uint64_t> &expected)
+{
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		if (order[i].hash != expected[i])
+		{
+			LOGE("Slot %zu: expected pipeline %llu, got %llu.\n", i,
+			     static_cast<unsigned long long>(expected[i]),
+			     static_cast<unsigned long long>(order[i].hash));
+			return false;
+		}
+	}
+
+	return order.size() == expected.size();
+}
+
+static bool test_schedule()
+{
+	std::vector<Pipeline> order;
+	for (uint64_t i = 1; i <= 10; i++)
+		order.push_back({ i + (i << 40) });
+	const auto h = [](uint64_t i) { return i + (i << 40); };
+
+	PipelineUsageMap usage;
+	// Same frame window, the pipeline seen in more sessions goes first, then first use order breaks ties.
+	usage[h(7)] = make_use(h(7), 0, 0, 1);
+	usage[h(3)] = make_use(h(3), 0, 1, 3);
+	usage[h(8)] = make_use(h(8), 0, 2, 1);
+	// Frames 1 and 2 share a window, which comes after frame 0 no matter the session count.
+	usage[h(5)] = make_use(h(5), 2, 3, 1);
+	usage[h(1)] = make_use(h(1), 1, 4, 16);
+	// Long after startup.
+	usage[h(9)] = make_use(h(9), 1000, 5, 16);
+	// Not in the database, must not disturb anything.
+	usage[h(42)] = make_use(h(42), 0, 6, 16);
+
+	size_t num_used = PipelineUsageHistory::schedule(order, usage);
+	if (num_used != 6)
+	{
+		LOGE("Expected 6 used pipelines, got %zu.\n", num_used);
+		return false;
+	}
+
+	// Pipelines without history keep database order.
+	return check_order(order, { h(3), h(7), h(8), h(1), h(5), h(9), h(2), h(4), h(6), h(10) });
+}
+
+static bool test_no_history()
+{
+	std::vector<Pipeline> order = { { 3 }, { 1 }, { 2 } };
+	PipelineUsageMap usage;
+	if (PipelineUsageHistory::schedule(order, usage) != 0)
+		return false;
+	return check_order(order, { 3, 1, 2 });
+}
+
+// Runs a session which uses pipelines in the given order, all in frame 0, and returns the new history.
+static PipelineUsageMap run_session(const PipelineUsageMap &usage, const std::vector<uint64_t> &used)
+{
+	std::vector<PipelineUsage> first_uses;
+	for (auto hash : used)
+		first_uses.push_back(make_use(hash, 0, uint32_t(first_uses.size()), 1));
+
+	auto words = PipelineUsageHistory::serialize(first_uses, usage);
+	PipelineUsageMap next;
+	if (!PipelineUsageHistory::parse(words.data(), words.size() * sizeof(uint32_t), next))
+		LOGE("Failed to parse serialized history.\n");
+	return next;
+}
+
+static bool expect_sessions(const PipelineUsageMap &usage, uint64_t hash, uint32_t sessions)
+{
+	auto itr = usage.find(hash);
+	uint32_t actual = itr != usage.end() ? itr->second.sessions : 0;
+	if (actual != sessions)
+	{
+		LOGE("Pipeline %llu: expected %u sessions, got %u.\n",
+		     static_cast<unsigned long long>(hash), sessions, actual);
+		return false;
+	}
+
+	return true;
+}
+
+static bool test_sessions()
+{
+	PipelineUsageMap usage;
+
+	// A is used every session, B only in the first two.
+	usage = run_session(usage, { 1, 2 });
+	usage = run_session(usage, { 2, 1 });
+	if (!expect_sessions(usage, 1, 2) || !expect_sessions(usage, 2, 2))
+		return false;
+
+	// Order of first use is from the latest session.
+	if (usage[2].first_use_order != 0 || usage[1].first_use_order != 1)
+	{
+		LOGE("First use order was not updated.\n");
+		return false;
+	}
+
+	usage = run_session(usage, { 3, 1 });
+	if (!expect_sessions(usage, 1, 3) || !expect_sessions(usage, 2, 1) || !expect_sessions(usage, 3, 1))
+		return false;
+
+	// Frequently used pipelines win over a new pipeline which happened to be used first this time.
+	// 3 and 2 tie, so they keep database order.
+	std::vector<Pipeline> order = { { 3 }, { 2 }, { 1 }, { 4 } };
+	PipelineUsageHistory::schedule(order, usage);
+	if (!check_order(order, { 1, 3, 2, 4 }))
+		return false;
+
+	// Aged out after another session without it.
+	usage = run_session(usage, { 1 });
+	if (!expect_sessions(usage, 2, 0) || !expect_sessions(usage, 3, 0) || usage.size() != 1)
+		return false;
+
+	// Session counts saturate.
+	for (unsigned i = 0; i < 2 * PipelineUsageHistory::MaxSessions; i++)
+		usage = run_session(usage, { 1 });
+	return expect_sessions(usage, 1, PipelineUsageHistory::MaxSessions);
+}
+
+static bool test_invalid()
+{
+	std::vector<PipelineUsage> first_uses = { make_use(0x123456789abcdefull, 7, 0, 1) };
+	auto words = PipelineUsageHistory::serialize(first_uses, {});
+
+	PipelineUsageMap usage;
+	if (!PipelineUsageHistory::parse(words.data(), words.size() * sizeof(uint32_t), usage) ||
+	    usage.size() != 1 || usage.begin()->second.hash != 0x123456789abcdefull ||
+	    usage.begin()->second.first_use_frame != 7)
+	{
+		LOGE("History does not round-trip.\n");
+		return false;
+	}
+
+	// Truncated.
+	usage.clear();
+	if (PipelineUsageHistory::parse(words.data(), words.size() * sizeof(uint32_t) - 1, usage) || !usage.empty())
+		return false;
+
+	// Wrong magic.
+	auto bad = words;
+	bad[0] ^= 1;
+	if (PipelineUsageHistory::parse(bad.data(), bad.size() * sizeof(uint32_t), usage))
+		return false;
+
+	// Count which does not fit.
+	bad = words;
+	bad[2] = 0xffffffffu;
+	if (PipelineUsageHistory::parse(bad.data(), bad.size() * sizeof(uint32_t), usage))
+		return false;
+
+	return PipelineUsageHistory::parse(words.data(), 3 * sizeof(uint32_t) + 1, usage) == false;
+}
+
+int main()
+{
+	if (!test_schedule() || !test_no_history() || !test_sessions() || !test_invalid())
+		return EXIT_FAILURE;
+
+	LOGI("Pipeline usage ordering OK.\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "global_managers_init.hpp"
+#include "render_graph.hpp"
+#include "task_composer.hpp"
+#include "context.hpp"
+#include "device.hpp"
+#include <stdlib.h>
+
+using namespace Granite;
+using namespace Vulkan;
+
+static bool init_context(Context &ctx)
+{
+	Context::SystemHandles handles = {};
+	handles.filesystem = GRANITE_FILESYSTEM();
+	ctx.set_system_handles(handles);
+	return ctx.init_instance_and_device(nullptr, 0, nullptr, 0);
+}
+
+static bool clear_to_black(unsigned, VkClearColorValue *value)
+{
+	if (value)
+		*value = {};
+	return true;
+}
+
+// Chain of passes where "a" is dead by the time "c" is written, so they can share memory.
+// "b" lives across both and needs its own range.
+static void build_graph(RenderGraph &graph)
+{
+	ResourceDimensions dim;
+	dim.width = 128;
+	dim.height = 128;
+	dim.format = VK_FORMAT_R8G8B8A8_UNORM;
+	graph.set_backbuffer_dimensions(dim);
+
+	const auto absolute = [](float size) {
+		AttachmentInfo info;
+		info.format = VK_FORMAT_R8G8B8A8_UNORM;
+		info.size_class = SizeClass::Absolute;
+		info.size_x = size;
+		info.size_y = size;
+		return info;
+	};
+
+	auto &p1 = graph.add_pass("p1", RENDER_GRAPH_QUEUE_GRAPHICS_BIT);
+	p1.add_color_output("a", absolute(256.0f));
+	p1.set_get_clear_color(clear_to_black);
+
+	auto &p2 = graph.add_pass("p2", RENDER_GRAPH_QUEUE_GRAPHICS_BIT);
+	p2.add_texture_input("a");
+	p2.add_color_output("b", absolute(192.0f));
+	p2.set_get_clear_color(clear_to_black);
+
+	auto &p3 = graph.add_pass("p3", RENDER_GRAPH_QUEUE_GRAPHICS_BIT);
+	p3.add_texture_input("b");
+	p3.add_color_output("c", absolute(128.0f));
+	p3.set_get_clear_color(clear_to_black);
+
+	auto &p4 = graph.add_pass("p4", RENDER_GRAPH_QUEUE_GRAPHICS_BIT);
+	p4.add_texture_input("c");
+	p4.add_color_output("back", AttachmentInfo());
+	p4.set_get_clear_color(clear_to_black);
+
+	graph.set_backbuffer_source("back");
+}
+
+static unsigned run_frame(RenderGraph &graph, Device &device, ImageView &swapchain)
+{
+	graph.setup_attachments(device, &swapchain);
+	TaskComposer composer(*GRANITE_THREAD_GROUP());
+	graph.enqueue_render_passes(device, composer);
+	composer.get_outgoing_task()->wait();
+	device.next_frame_context();
+	return graph.get_memory_alias_barrier_count();
+}
+
+int main()
+{
+	Global::init(Global::MANAGER_FEATURE_DEFAULT_BITS, 1);
+	if (!Context::init_loader(nullptr))
+		return EXIT_FAILURE;
+
+	Context ctx;
+	if (!init_context(ctx))
+		return EXIT_FAILURE;
+	Device device;
+	device.set_context(ctx);
+
+	// Stand-in for a swapchain image.
+	auto swapchain = device.create_image(ImageCreateInfo::render_target(128, 128, VK_FORMAT_R8G8B8A8_UNORM));
+	if (!swapchain)
+		return EXIT_FAILURE;
+	swapchain->set_swapchain_layout(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+	RenderGraph graph;
+	graph.set_device(&device);
+	build_graph(graph);
+	graph.bake();
+	graph.log();
+
+	// Sizes are only known once the images are set up.
+	graph.setup_attachments(device, &swapchain->get_view());
+	auto &stats = graph.get_transient_memory_stats();
+	if (stats.num_images != 3 || stats.num_heaps != 1 || stats.aliased_size >= stats.unaliased_size)
+	{
+		LOGE("Expected 3 images in one shared heap, got %u images, %u heaps, %llu -> %llu bytes.\n",
+		     stats.num_images, stats.num_heaps,
+		     static_cast<unsigned long long>(stats.unaliased_size),
+		     static_cast<unsigned long long>(stats.aliased_size));
+		return EXIT_FAILURE;
+	}
+
+	// First frame, "c" has to wait for "a".
+	unsigned barriers = run_frame(graph, device, swapchain->get_view());
+	if (barriers < 1)
+	{
+		LOGE("Expected an aliasing barrier in the first frame, got %u.\n", barriers);
+		return EXIT_FAILURE;
+	}
+
+	// In later frames "a" also has to wait for "c" from the previous frame.
+	barriers = run_frame(graph, device, swapchain->get_view());
+	if (barriers < 2)
+	{
+		LOGE("Expected two aliasing barriers in the second frame, got %u.\n", barriers);
+		return EXIT_FAILURE;
+	}
+
+	device.wait_idle();
+	LOGI("Render graph aliased %llu bytes into %llu bytes.\n",
+	     static_cast<unsigned long long>(stats.unaliased_size),
+	     static_cast<unsigned long long>(stats.aliased_size));
+	return EXIT_SUCCESS;
+}
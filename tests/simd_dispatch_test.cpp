@@ -0,0 +1,206 @@
+#include "simd_dispatch.hpp"
+#include "logging.hpp"
+#include <random>
+#include <vector>
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+
+using namespace Granite;
+using namespace Granite::SIMD;
+
+static std::mt19937 rnd(1234);
+
+static float random_float(float lo, float hi)
+{
+	return std::uniform_real_distribution<float>(lo, hi)(rnd);
+}
+
+static void check(bool cond, const char *isa, const char *kernel)
+{
+	if (!cond)
+	{
+		LOGE("%s: %s does not match scalar reference!\n", isa, kernel);
+		exit(1);
+	}
+}
+
+static bool close(float a, float b, float tolerance)
+{
+	return fabsf(a - b) <= tolerance * (1.0f + fabsf(b));
+}
+
+static void random_affine(float *m)
+{
+	for (int i = 0; i < 12; i++)
+		m[i] = random_float(-2.0f, 2.0f);
+}
+
+static void random_aabb(float *aabb)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		float a = random_float(-50.0f, 50.0f);
+		float b = a + random_float(0.1f, 5.0f);
+		aabb[i] = a;
+		aabb[4 + i] = b;
+	}
+	aabb[3] = 1.0f;
+	aabb[7] = 1.0f;
+}
+
+static void test_frustum_cull(const DispatchKernels &ref, const DispatchKernels &k)
+{
+	float planes[6 * 4];
+	for (int p = 0; p < 6; p++)
+	{
+		float x = random_float(-1.0f, 1.0f), y = random_float(-1.0f, 1.0f), z = random_float(-1.0f, 1.0f);
+		float len = sqrtf(x * x + y * y + z * z);
+		planes[4 * p + 0] = x / len;
+		planes[4 * p + 1] = y / len;
+		planes[4 * p + 2] = z / len;
+		planes[4 * p + 3] = random_float(20.0f, 60.0f);
+	}
+
+	std::vector<float> storage(8 * 103);
+	std::vector<const float *> aabbs(103);
+	for (size_t i = 0; i < aabbs.size(); i++)
+	{
+		random_aabb(&storage[8 * i]);
+		aabbs[i] = &storage[8 * i];
+	}
+
+	// Exercise every tail length.
+	for (size_t count = 0; count <= aabbs.size(); count += 17)
+	{
+		std::vector<uint8_t> expected(count + 1, 0xff), result(count + 1, 0xff);
+		ref.frustum_cull(expected.data(), aabbs.data(), count, planes);
+		k.frustum_cull(result.data(), aabbs.data(), count, planes);
+		check(expected == result, k.name, "frustum_cull");
+	}
+}
+
+static void test_mul_affine(const DispatchKernels &ref, const DispatchKernels &k)
+{
+	const size_t count = 37;
+	std::vector<float> a(12 * count), b(12 * count), expected(12 * count), result(12 * count);
+	for (size_t i = 0; i < count; i++)
+	{
+		random_affine(&a[12 * i]);
+		random_affine(&b[12 * i]);
+	}
+
+	std::vector<const float *> a_ptrs(count);
+	std::vector<float *> expected_ptrs(count), result_ptrs(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		a_ptrs[i] = &a[12 * i];
+		expected_ptrs[i] = &expected[12 * i];
+		result_ptrs[i] = &result[12 * i];
+	}
+
+	ref.mul_affine(expected_ptrs.data(), a_ptrs.data(), b.data(), count);
+	k.mul_affine(result_ptrs.data(), a_ptrs.data(), b.data(), count);
+	for (size_t i = 0; i < expected.size(); i++)
+		check(close(expected[i], result[i], 1e-5f), k.name, "mul_affine");
+}
+
+static void test_transform_expand_aabb(const DispatchKernels &ref, const DispatchKernels &k)
+{
+	for (size_t count = 0; count < 8; count++)
+	{
+		std::vector<float> affine(12 * count);
+		for (size_t i = 0; i < count; i++)
+			random_affine(&affine[12 * i]);
+
+		float aabb[8];
+		random_aabb(aabb);
+
+		float expected[8] = { 1000.0f, 1000.0f, 1000.0f, 1.0f, -1000.0f, -1000.0f, -1000.0f, 1.0f };
+		float result[8];
+		memcpy(result, expected, sizeof(result));
+
+		ref.transform_expand_aabb(expected, aabb, affine.data(), count);
+		k.transform_expand_aabb(result, aabb, affine.data(), count);
+		for (int i = 0; i < 8; i++)
+			check(close(expected[i], result[i], 1e-5f), k.name, "transform_expand_aabb");
+	}
+}
+
+static void test_accumulate(const DispatchKernels &ref, const DispatchKernels &k)
+{
+	for (size_t count = 0; count < 70; count += 3)
+	{
+		std::vector<float> input(count), expected(count), result;
+		for (size_t i = 0; i < count; i++)
+		{
+			input[i] = random_float(-1.0f, 1.0f);
+			expected[i] = random_float(-1.0f, 1.0f);
+		}
+		result = expected;
+
+		ref.accumulate(expected.data(), input.data(), 0.7f, count);
+		k.accumulate(result.data(), input.data(), 0.7f, count);
+		for (size_t i = 0; i < count; i++)
+			check(close(expected[i], result[i], 1e-6f), k.name, "accumulate");
+	}
+}
+
+static void test_sinc_dot(const DispatchKernels &ref, const DispatchKernels &k)
+{
+	for (unsigned taps = 4; taps <= 64; taps += 4)
+	{
+		std::vector<float> buffer(taps), phases(taps), deltas(taps);
+		for (unsigned i = 0; i < taps; i++)
+		{
+			buffer[i] = random_float(-1.0f, 1.0f);
+			phases[i] = random_float(-1.0f, 1.0f);
+			deltas[i] = random_float(-0.1f, 0.1f);
+		}
+
+		float expected = ref.sinc_dot(buffer.data(), phases.data(), deltas.data(), 0.3f, taps);
+		float result = k.sinc_dot(buffer.data(), phases.data(), deltas.data(), 0.3f, taps);
+		check(fabsf(expected - result) <= 1e-4f, k.name, "sinc_dot");
+	}
+}
+
+static void test_downsample_rgba8(const DispatchKernels &ref, const DispatchKernels &k)
+{
+	for (size_t width = 1; width < 40; width += 5)
+	{
+		std::vector<uint8_t> row0(8 * width), row1(8 * width);
+		for (size_t i = 0; i < row0.size(); i++)
+		{
+			row0[i] = uint8_t(rnd());
+			row1[i] = uint8_t(rnd());
+		}
+
+		std::vector<uint8_t> expected(4 * width), result(4 * width);
+		ref.downsample_rgba8(expected.data(), row0.data(), row1.data(), width);
+		k.downsample_rgba8(result.data(), row0.data(), row1.data(), width);
+		check(expected == result, k.name, "downsample_rgba8");
+	}
+}
+
+int main()
+{
+	auto *ref = get_dispatch(DispatchISA::Scalar);
+	LOGI("Selected variant: %s\n", get_dispatch().name);
+
+	for (int i = 0; i < int(DispatchISA::Count); i++)
+	{
+		auto *kernels = get_dispatch(DispatchISA(i));
+		if (!kernels || kernels == ref)
+			continue;
+
+		LOGI("Testing %s ...\n", kernels->name);
+		test_frustum_cull(*ref, *kernels);
+		test_mul_affine(*ref, *kernels);
+		test_transform_expand_aabb(*ref, *kernels);
+		test_accumulate(*ref, *kernels);
+		test_sinc_dot(*ref, *kernels);
+		test_downsample_rgba8(*ref, *kernels);
+	}
+
+	LOGI(":D\n");
+}
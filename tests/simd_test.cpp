@@ -6,6 +6,7 @@
 #include "frustum.hpp"
 #include <assert.h>
 #include <string.h>
+#include <limits>
 
 using namespace Granite;
 
@@ -46,6 +47,71 @@ static void test_aabb_transform()
 	}
 }
 
+static bool affine_equal(const mat_affine &a, const mat4 &b)
+{
+	mat4 expanded = mat4_cast(a);
+	for (int col = 0; col < 4; col++)
+		if (distance(expanded[col], b[col]) > 0.0001f)
+			return false;
+	return true;
+}
+
+static void test_affine()
+{
+	mat4 parent, local;
+	compute_model_transform(parent, vec3(2.0f, 0.5f, -1.0f), angleAxis(0.3f, normalize(vec3(0.4f, -0.2f, 0.1f))), vec3(-3.0f, 2.0f, 9.0f), mat4(1.0f));
+	compute_model_transform(local, vec3(8.0f, 6.0f, -3.0f), angleAxis(0.8f, normalize(vec3(0.1f, 0.2f, 0.3f))), vec3(8.0f, 1.0f, -0.5f), mat4(1.0f));
+
+	mat_affine affine_parent(parent);
+	mat_affine affine_local;
+	SIMD::convert_transform(affine_local, angleAxis(0.8f, normalize(vec3(0.1f, 0.2f, 0.3f))), vec3(8.0f, 6.0f, -3.0f), vec3(8.0f, 1.0f, -0.5f));
+	if (!affine_equal(affine_local, local) || !affine_equal(affine_parent, parent))
+	{
+		LOGE("Affine conversion mismatch!\n");
+		exit(1);
+	}
+
+	mat_affine affine_world;
+	SIMD::mul(affine_world, affine_parent, affine_local);
+	if (!affine_equal(affine_world, parent * local))
+	{
+		LOGE("Affine multiply mismatch!\n");
+		exit(1);
+	}
+
+	mat_affine *outputs[2] = { &affine_world, &affine_parent };
+	const mat_affine *parents[2] = { &affine_parent, &affine_parent };
+	const mat_affine locals[2] = { affine_local, mat_affine(1.0f) };
+	SIMD::mul_batch(outputs, parents, locals, 2);
+	if (!affine_equal(affine_world, parent * local) || !affine_equal(affine_parent, parent))
+	{
+		LOGE("Affine batch multiply mismatch!\n");
+		exit(1);
+	}
+
+	AABB aabb(vec3(-10.0f, 4.0f, 2.0f), vec3(5.0f, 6.0f, 7.0f));
+	AABB ref_aabb = aabb.transform(parent * local);
+	AABB optim_aabb;
+	SIMD::transform_aabb(optim_aabb, aabb, affine_world);
+	if (distance(ref_aabb.get_minimum4(), optim_aabb.get_minimum4()) > 0.0001f ||
+	    distance(ref_aabb.get_maximum4(), optim_aabb.get_maximum4()) > 0.0001f)
+	{
+		LOGE("Error affine aabb!\n");
+		exit(1);
+	}
+
+	const mat_affine bones[2] = { affine_local, affine_world };
+	AABB expanded(vec3(std::numeric_limits<float>::max()), vec3(-std::numeric_limits<float>::max()));
+	SIMD::transform_and_expand_aabb(expanded, aabb, bones, 2);
+	ref_aabb.expand(aabb.transform(local));
+	if (distance(ref_aabb.get_minimum4(), expanded.get_minimum4()) > 0.0001f ||
+	    distance(ref_aabb.get_maximum4(), expanded.get_maximum4()) > 0.0001f)
+	{
+		LOGE("Error affine aabb expand!\n");
+		exit(1);
+	}
+}
+
 static void test_frustum_cull()
 {
 	mat4 m = projection(0.4f, 1.0f, 0.1f, 5.0f);
@@ -103,6 +169,7 @@ int main()
 	test_matrix_multiply();
 	test_frustum_cull();
 	test_aabb_transform();
+	test_affine();
 	test_quat();
 	LOGI(":D\n");
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "timeline_trace_file.hpp"
+#include "logging.hpp"
+#include "timer.hpp"
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Util;
+
+static constexpr unsigned NumEvents = 1000000;
+static constexpr unsigned NumThreads = 4;
+
+static double bench_scopes(TimelineTraceFile *trace, unsigned count)
+{
+	auto start = get_current_time_nsecs();
+	for (unsigned i = 0; i < count; i++)
+		GRANITE_SCOPED_TIMELINE_EVENT_FILE(trace, (i & 1) ? "bench-odd" : "bench-even");
+	auto end = get_current_time_nsecs();
+	return double(end - start) / double(count);
+}
+
+int main()
+{
+	const char *path = "/tmp/granite-timeline-trace-bench.bin";
+
+	// Reference: a disabled event is a null check, the clock reads are the floor for an enabled one.
+	{
+		double disabled_ns = bench_scopes(nullptr, NumEvents);
+		int64_t sum = 0;
+		auto start = get_current_time_nsecs();
+		for (unsigned i = 0; i < NumEvents; i++)
+			sum += get_current_time_nsecs() - get_current_time_nsecs();
+		auto end = get_current_time_nsecs();
+		LOGI("Disabled scope: %.2f ns / event, two clock reads: %.2f ns (%lld).\n",
+		     disabled_ns, double(end - start) / double(NumEvents), static_cast<long long>(sum));
+	}
+
+	{
+		TimelineTraceFile trace(path);
+		TimelineTraceFile::set_tid("bench");
+		LOGI("Scoped event: %.2f ns / event.\n", bench_scopes(&trace, NumEvents));
+		LOGI("  %llu records dropped.\n", static_cast<unsigned long long>(trace.get_dropped_records()));
+	}
+
+	{
+		TimelineTraceFile trace(path);
+		std::vector<std::thread> threads;
+		auto start = get_current_time_nsecs();
+		for (unsigned i = 0; i < NumThreads; i++)
+		{
+			threads.emplace_back([&trace, i]() {
+				char tid[32];
+				snprintf(tid, sizeof(tid), "bench-%u", i);
+				TimelineTraceFile::set_tid(tid);
+				bench_scopes(&trace, NumEvents);
+			});
+		}
+
+		for (auto &thr : threads)
+			thr.join();
+		auto end = get_current_time_nsecs();
+
+		// Wall time over all events, so this is throughput rather than latency when threads outnumber cores.
+		LOGI("Scoped event, %u threads: %.2f ns / event.\n", NumThreads,
+		     double(end - start) / double(NumEvents * NumThreads));
+		LOGI("  %llu records dropped.\n", static_cast<unsigned long long>(trace.get_dropped_records()));
+	}
+
+	remove(path);
+	return EXIT_SUCCESS;
+}
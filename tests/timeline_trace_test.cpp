@@ -0,0 +1,340 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "timeline_trace_file.hpp"
+#include "logging.hpp"
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Util;
+
+static constexpr unsigned NumThreads = 4;
+static constexpr unsigned NumScopes = 20000;
+static constexpr unsigned CounterInterval = 1000;
+
+// Needs escaping on the way to JSON.
+static const char EscapedDesc[] = "explicit \"gpu\" \\ event";
+
+// Mirrors the layout written by TimelineTraceFile::looper().
+static const char TraceFileMagic[4] = { 'G', 'T', 'R', 'C' };
+static constexpr uint32_t TraceFileVersion = 1;
+enum { ChunkStrings = 1, ChunkRecords = 2 };
+
+struct TraceContents
+{
+	std::vector<std::string> strings;
+	std::vector<TimelineTraceFile::Record> records;
+	uint64_t base_ns = 0;
+	unsigned string_chunks = 0;
+	unsigned record_chunks = 0;
+};
+
+static bool read_trace(const std::string &path, TraceContents &contents)
+{
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		LOGE("Failed to open %s.\n", path.c_str());
+		return false;
+	}
+
+	char magic[4];
+	uint32_t version = 0;
+	bool success = fread(magic, sizeof(magic), 1, file) == 1 &&
+	               fread(&version, sizeof(version), 1, file) == 1 &&
+	               fread(&contents.base_ns, sizeof(contents.base_ns), 1, file) == 1 &&
+	               memcmp(magic, TraceFileMagic, sizeof(magic)) == 0 &&
+	               version == TraceFileVersion;
+
+	uint32_t header[2];
+	while (success && fread(header, sizeof(header), 1, file) == 1)
+	{
+		if (header[0] == ChunkStrings)
+		{
+			contents.string_chunks++;
+			for (uint32_t i = 0; i < header[1] && success; i++)
+			{
+				uint32_t str_header[2];
+				success = fread(str_header, sizeof(str_header), 1, file) == 1 &&
+				          str_header[0] == contents.strings.size();
+				if (!success)
+					break;
+
+				std::string str(str_header[1], '\0');
+				success = !str_header[1] || fread(&str[0], 1, str.size(), file) == str.size();
+				contents.strings.push_back(std::move(str));
+			}
+		}
+		else if (header[0] == ChunkRecords)
+		{
+			contents.record_chunks++;
+			size_t offset = contents.records.size();
+			contents.records.resize(offset + header[1]);
+			success = fread(contents.records.data() + offset, sizeof(TimelineTraceFile::Record), header[1], file) == header[1];
+		}
+		else
+			success = false;
+	}
+
+	fclose(file);
+	if (!success)
+		LOGE("Trace %s is corrupt.\n", path.c_str());
+	return success;
+}
+
+static bool check_records(const TraceContents &contents)
+{
+	const auto get_string = [&](uint32_t id) -> const char * {
+		return id < contents.strings.size() ? contents.strings[id].c_str() : nullptr;
+	};
+
+	unsigned scopes[NumThreads] = {};
+	unsigned counters[NumThreads] = {};
+	unsigned explicit_events = 0;
+
+	for (auto &record : contents.records)
+	{
+		const char *desc = get_string(record.desc);
+		const char *tid = get_string(record.tid);
+		if (!desc || !tid)
+		{
+			LOGE("Record references an unknown string.\n");
+			return false;
+		}
+
+		if (record.type == TimelineTraceFile::RecordType::Scope && strcmp(desc, EscapedDesc) == 0)
+		{
+			if (strcmp(tid, "gpu") != 0 || record.pid != 1 || record.start_ns != 1000 || record.end_ns != 3000)
+			{
+				LOGE("Explicit event does not round-trip.\n");
+				return false;
+			}
+			explicit_events++;
+			continue;
+		}
+
+		unsigned thread_index;
+		if (sscanf(tid, "worker-%u", &thread_index) != 1 || thread_index >= NumThreads)
+		{
+			LOGE("Unexpected tid %s.\n", tid);
+			return false;
+		}
+
+		if (record.type == TimelineTraceFile::RecordType::Counter)
+		{
+			if (strcmp(desc, "progress") != 0 || record.end_ns != counters[thread_index] * CounterInterval)
+			{
+				LOGE("Counter %s = %llu out of order on %s.\n", desc, static_cast<unsigned long long>(record.end_ns), tid);
+				return false;
+			}
+			counters[thread_index]++;
+		}
+		else
+		{
+			const char *expected_desc = (scopes[thread_index] & 1) ? "scope-odd" : "scope-even";
+			if (strcmp(desc, expected_desc) != 0 || record.end_ns < record.start_ns)
+			{
+				LOGE("Scope %s on %s does not round-trip.\n", desc, tid);
+				return false;
+			}
+			scopes[thread_index]++;
+		}
+	}
+
+	for (unsigned i = 0; i < NumThreads; i++)
+	{
+		if (scopes[i] != NumScopes || counters[i] != NumScopes / CounterInterval)
+		{
+			LOGE("worker-%u: expected %u scopes and %u counters, got %u and %u.\n",
+			     i, NumScopes, NumScopes / CounterInterval, scopes[i], counters[i]);
+			return false;
+		}
+	}
+
+	if (explicit_events != 1)
+	{
+		LOGE("Expected one explicit event, got %u.\n", explicit_events);
+		return false;
+	}
+
+	return true;
+}
+
+static size_t count_occurrences(const std::string &str, const char *needle)
+{
+	size_t count = 0;
+	for (size_t pos = str.find(needle); pos != std::string::npos; pos = str.find(needle, pos + 1))
+		count++;
+	return count;
+}
+
+static bool read_file(const std::string &path, std::string &data)
+{
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		LOGE("Failed to open %s.\n", path.c_str());
+		return false;
+	}
+
+	char buffer[4096];
+	size_t read_size;
+	while ((read_size = fread(buffer, 1, sizeof(buffer), file)) != 0)
+		data.append(buffer, read_size);
+	fclose(file);
+	return true;
+}
+
+static bool check_json(const std::string &path, const TraceContents &contents)
+{
+	std::string json;
+	if (!read_file(path, json))
+		return false;
+
+	size_t expected_scopes = NumThreads * NumScopes + 1;
+	size_t expected_counters = NumThreads * (NumScopes / CounterInterval);
+	size_t scopes = count_occurrences(json, "\"ph\": \"X\"");
+	size_t counters = count_occurrences(json, "\"ph\": \"C\"");
+	if (scopes != expected_scopes || counters != expected_counters)
+	{
+		LOGE("JSON has %zu scopes and %zu counters, expected %zu and %zu.\n",
+		     scopes, counters, expected_scopes, expected_counters);
+		return false;
+	}
+
+	if (json.compare(0, 2, "[\n") != 0 || json.size() < 3 || json.compare(json.size() - 3, 3, "\n]\n") != 0)
+	{
+		LOGE("JSON is not a complete array.\n");
+		return false;
+	}
+
+	// Timestamps are relative to the trace start, in microseconds.
+	char expected_event[256];
+	snprintf(expected_event, sizeof(expected_event),
+	         "{ \"name\": \"explicit \\\"gpu\\\" \\\\ event\", \"ph\": \"X\", \"tid\": \"gpu\", \"pid\": \"1\", \"ts\": %.3f, \"dur\": 2.000 }",
+	         1e-3 * double(int64_t(1000 - contents.base_ns)));
+	if (json.find(expected_event) == std::string::npos)
+	{
+		LOGE("Explicit event missing or not escaped in JSON.\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool write_trace(const std::string &path, uint32_t ring_size)
+{
+	TimelineTraceFile trace(path, ring_size);
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < NumThreads; i++)
+	{
+		threads.emplace_back([&trace, i]() {
+			char tid[32];
+			snprintf(tid, sizeof(tid), "worker-%u", i);
+			TimelineTraceFile::set_tid(tid);
+
+			for (unsigned j = 0; j < NumScopes; j++)
+			{
+				if (j % CounterInterval == 0)
+					trace.write_counter("progress", j);
+				TimelineTraceFile::ScopedEvent e(&trace, (j & 1) ? "scope-odd" : "scope-even");
+			}
+		});
+	}
+
+	trace.write_event(EscapedDesc, "gpu", 1, 1000, 3000);
+
+	for (auto &thr : threads)
+		thr.join();
+
+	// Rings grow rather than drop when the writer falls behind, so nothing may be lost in a burst like this.
+	auto dropped = trace.get_dropped_records();
+	if (dropped)
+	{
+		LOGE("Dropped %llu records with ring size %u.\n", static_cast<unsigned long long>(dropped), ring_size);
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	const std::string trace_path = "/tmp/granite-timeline-trace-test.bin";
+	const std::string json_path = "/tmp/granite-timeline-trace-test.json";
+
+	// The minimum ring size is far too small for the burst, and has to grow while the writer drains it.
+	for (uint32_t ring_size : { TimelineTraceFile::DefaultRingSize, TimelineTraceFile::MinRingSize })
+	{
+		if (!write_trace(trace_path, ring_size))
+			return EXIT_FAILURE;
+
+		TraceContents contents;
+		if (!read_trace(trace_path, contents) || !check_records(contents))
+			return EXIT_FAILURE;
+
+		// The writer drains while producers are running, so the records must be spread over several chunks.
+		if (contents.record_chunks < 2 || contents.string_chunks < 1)
+		{
+			LOGE("Expected streamed chunks, got %u string and %u record chunks.\n",
+			     contents.string_chunks, contents.record_chunks);
+			return EXIT_FAILURE;
+		}
+	}
+
+	TraceContents contents;
+	if (!read_trace(trace_path, contents))
+		return EXIT_FAILURE;
+
+	if (!TimelineTraceFile::convert_to_json(trace_path, json_path) || !check_json(json_path, contents))
+		return EXIT_FAILURE;
+
+	// A trace cut off in the middle of a chunk must be reported.
+	{
+		std::string data;
+		if (!read_file(trace_path, data) || data.size() <= 16)
+			return EXIT_FAILURE;
+
+		FILE *file = fopen(trace_path.c_str(), "wb");
+		if (!file)
+			return EXIT_FAILURE;
+		fwrite(data.data(), 1, data.size() - 16, file);
+		fclose(file);
+
+		if (TimelineTraceFile::convert_to_json(trace_path, json_path))
+		{
+			LOGE("Truncated trace was not rejected.\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	remove(trace_path.c_str());
+	remove(json_path.c_str());
+	LOGI("Timeline trace round-trip OK.\n");
+	return EXIT_SUCCESS;
+}
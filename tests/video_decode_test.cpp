@@ -0,0 +1,288 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "ffmpeg_encode.hpp"
+#include "ffmpeg_decode.hpp"
+#include "context.hpp"
+#include "device.hpp"
+#include "global_managers_init.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Granite;
+
+static constexpr unsigned Width = 128;
+static constexpr unsigned Height = 96;
+static constexpr unsigned NumFrames = 30;
+static constexpr unsigned NumPooledStreams = 4;
+static constexpr unsigned ReadbackFrame = NumFrames / 2;
+
+// A flat color, so that the decoded result can be checked without caring about compression artifacts.
+static const float ClipColor[3] = { 0.1f, 0.5f, 0.9f };
+
+static bool encode_clip(Vulkan::Device &device, const std::string &path)
+{
+	VideoEncoder::Options options = {};
+	options.width = Width;
+	options.height = Height;
+	options.frame_timebase = { 1, 30 };
+
+	VideoEncoder encoder;
+	if (!encoder.init(&device, path.c_str(), options))
+	{
+		LOGE("Failed to init encoder.\n");
+		return false;
+	}
+
+	auto info = Vulkan::ImageCreateInfo::render_target(Width, Height, VK_FORMAT_R8G8B8A8_UNORM);
+	info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	info.misc = Vulkan::IMAGE_MISC_MUTABLE_SRGB_BIT;
+	auto img = device.create_image(info);
+
+	FFmpegEncode::Shaders<> shaders;
+	shaders.rgb_to_yuv = device.get_shader_manager().register_compute(
+			"builtin://shaders/util/rgb_to_yuv.comp")->register_variant({})->get_program();
+	shaders.chroma_downsample = device.get_shader_manager().register_compute(
+			"builtin://shaders/util/chroma_downsample.comp")->register_variant({})->get_program();
+	auto pipe = encoder.create_ycbcr_pipeline(shaders);
+
+	for (unsigned i = 0; i < NumFrames; i++)
+	{
+		auto cmd = device.request_command_buffer();
+		cmd->image_barrier(*img, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+		                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+		Vulkan::RenderPassInfo rp;
+		rp.color_attachments[0] = &img->get_view();
+		rp.num_color_attachments = 1;
+		rp.store_attachments = 1;
+		rp.clear_attachments = 1;
+		memcpy(rp.clear_color[0].float32, ClipColor, sizeof(ClipColor));
+		cmd->begin_render_pass(rp);
+		cmd->end_render_pass();
+
+		cmd->image_barrier(*img, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		                   VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+		encoder.process_rgb(*cmd, pipe, img->get_view());
+		encoder.submit_process_rgb(cmd, pipe);
+		if (!encoder.encode_frame(pipe, 0))
+		{
+			LOGE("Failed to encode frame %u.\n", i);
+			return false;
+		}
+		device.next_frame_context();
+	}
+
+	return true;
+}
+
+// Reads back the center texel of a decoded frame, and hands the frame back to the decoder.
+static bool read_center(Vulkan::Device &device, VideoDecoder &decoder, VideoFrame &frame, uint8_t rgba[4])
+{
+	auto &image = frame.view->get_image();
+
+	Vulkan::BufferCreateInfo info = {};
+	info.size = 4;
+	info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	info.domain = Vulkan::BufferDomain::CachedHost;
+	auto buffer = device.create_buffer(info);
+
+	device.add_wait_semaphore(Vulkan::CommandBuffer::Type::Generic, std::move(frame.sem),
+	                          VK_PIPELINE_STAGE_2_COPY_BIT, true);
+
+	auto cmd = device.request_command_buffer();
+	cmd->image_barrier(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                   VK_PIPELINE_STAGE_2_COPY_BIT, 0, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+	cmd->copy_image_to_buffer(*buffer, image, 0, { int(Width / 2), int(Height / 2), 0 }, { 1, 1, 1 },
+	                          0, 0, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 });
+	cmd->image_barrier(image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                   VK_PIPELINE_STAGE_2_COPY_BIT, 0, VK_PIPELINE_STAGE_2_COPY_BIT, 0);
+	cmd->barrier(VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+	             VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+
+	Vulkan::Fence fence;
+	Vulkan::Semaphore release;
+	device.submit(cmd, &fence, 1, &release);
+	decoder.release_video_frame(frame.index, std::move(release));
+	fence->wait();
+
+	auto *mapped = static_cast<const uint8_t *>(device.map_host_buffer(*buffer, Vulkan::MEMORY_ACCESS_READ_BIT));
+	if (!mapped)
+		return false;
+	memcpy(rgba, mapped, 4);
+	device.unmap_host_buffer(*buffer, Vulkan::MEMORY_ACCESS_READ_BIT);
+	return true;
+}
+
+struct Stream
+{
+	VideoDecoder decoder;
+	unsigned frames = 0;
+	double last_pts = -1.0;
+	bool eof = false;
+};
+
+// Decodes every stream to the end, round-robin, as a player showing all of them would.
+static bool decode_clip(Vulkan::Device &device, const std::string &path, VideoDecoderPool *pool, unsigned count)
+{
+	FFmpegDecode::Shaders<> shaders;
+	shaders.yuv_to_rgb = device.get_shader_manager().register_compute(
+			"builtin://shaders/util/yuv_to_rgb.comp")->register_variant({})->get_program();
+
+	VideoDecoder::DecodeOptions opts;
+	opts.pool = pool;
+
+	std::vector<std::unique_ptr<Stream>> streams;
+	for (unsigned i = 0; i < count; i++)
+	{
+		auto stream = std::make_unique<Stream>();
+		if (!stream->decoder.init(nullptr, path.c_str(), opts) ||
+		    !stream->decoder.begin_device_context(&device, shaders) ||
+		    !stream->decoder.play())
+		{
+			LOGE("Failed to start decoder %u.\n", i);
+			return false;
+		}
+
+		if (stream->decoder.get_width() != Width || stream->decoder.get_height() != Height)
+		{
+			LOGE("Decoded size is %u x %u.\n", stream->decoder.get_width(), stream->decoder.get_height());
+			return false;
+		}
+
+		streams.push_back(std::move(stream));
+	}
+
+	bool checked_color = false;
+	unsigned remaining = count;
+	while (remaining)
+	{
+		for (unsigned i = 0; i < count; i++)
+		{
+			auto &stream = *streams[i];
+			if (stream.eof)
+				continue;
+
+			VideoFrame frame;
+			if (!stream.decoder.acquire_video_frame(frame, 10000))
+			{
+				if (!stream.decoder.is_eof())
+				{
+					LOGE("Stream %u timed out after %u frames.\n", i, stream.frames);
+					return false;
+				}
+
+				stream.eof = true;
+				remaining--;
+				continue;
+			}
+
+			if (frame.pts <= stream.last_pts)
+			{
+				LOGE("Stream %u: PTS %.3f after %.3f.\n", i, frame.pts, stream.last_pts);
+				return false;
+			}
+			stream.last_pts = frame.pts;
+
+			if (i == 0 && stream.frames == ReadbackFrame)
+			{
+				uint8_t rgba[4];
+				if (!read_center(device, stream.decoder, frame, rgba))
+					return false;
+
+				// The exact value depends on the YUV range and transfer function, but the channels must stay ordered.
+				LOGI("Decoded center texel: %u, %u, %u.\n", rgba[0], rgba[1], rgba[2]);
+				if (rgba[0] + 32 > rgba[1] || rgba[1] + 32 > rgba[2])
+				{
+					LOGE("Decoded color does not match the encoded clip.\n");
+					return false;
+				}
+				checked_color = true;
+			}
+			else
+				stream.decoder.release_video_frame(frame.index, std::move(frame.sem));
+
+			stream.frames++;
+		}
+
+		device.next_frame_context();
+	}
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		auto &stream = *streams[i];
+		if (stream.frames != NumFrames)
+		{
+			LOGE("Stream %u decoded %u frames, expected %u.\n", i, stream.frames, NumFrames);
+			return false;
+		}
+
+		stream.decoder.stop();
+		stream.decoder.end_device_context();
+	}
+
+	return checked_color;
+}
+
+int main()
+{
+	Global::init(Global::MANAGER_FEATURE_DEFAULT_BITS, 1);
+
+	if (!Vulkan::Context::init_loader(nullptr))
+		return EXIT_FAILURE;
+	Vulkan::Context::SystemHandles handles = {};
+	handles.filesystem = GRANITE_FILESYSTEM();
+	Vulkan::Context ctx;
+	ctx.set_system_handles(handles);
+	if (!ctx.init_instance_and_device(nullptr, 0, nullptr, 0, 0))
+		return EXIT_FAILURE;
+
+	Vulkan::Device device;
+	device.set_context(ctx);
+
+	const std::string path = "/tmp/granite-video-decode-test.mkv";
+	if (!encode_clip(device, path))
+		return EXIT_FAILURE;
+
+	// Software decode with its own thread. Frames are decoded straight into host-imported buffers.
+	if (!decode_clip(device, path, nullptr, 1))
+		return EXIT_FAILURE;
+	LOGI("Dedicated decode OK.\n");
+
+	// More streams than pool threads, so workers have to be shared.
+	{
+		VideoDecoderPool pool(2);
+		if (!decode_clip(device, path, &pool, NumPooledStreams))
+			return EXIT_FAILURE;
+	}
+	LOGI("Pooled decode OK.\n");
+
+	device.wait_idle();
+	remove(path.c_str());
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "task_coroutine.hpp"
+#include "logging.hpp"
+
+namespace Granite
+{
+namespace Internal
+{
+std::coroutine_handle<> CoTaskPromiseBase::complete(std::coroutine_handle<> h) noexcept
+{
+	if (!completion)
+		return continuation ? continuation : std::noop_coroutine();
+
+	// Nothing awaits a spawned coroutine, so it cleans up after itself.
+	auto deps = std::move(completion);
+	if (exception)
+	{
+		try
+		{
+			std::rethrow_exception(exception);
+		}
+		catch (const std::exception &e)
+		{
+			LOGE("Unhandled exception in spawned coroutine: %s\n", e.what());
+		}
+		catch (...)
+		{
+			LOGE("Unhandled exception in spawned coroutine.\n");
+		}
+	}
+
+	h.destroy();
+	deps->dependency_satisfied();
+	return std::noop_coroutine();
+}
+
+TaskGroupHandle create_resume_task(ThreadGroup &group, std::coroutine_handle<> h, TaskClass task_class)
+{
+	auto task = group.create_task([h]() {
+		h.resume();
+	});
+	task->set_task_class(task_class);
+	task->set_desc("coroutine-resume");
+	return task;
+}
+}
+
+TaskGroupHandle spawn(ThreadGroup &group, CoTask<void> task, TaskClass task_class)
+{
+	auto handle = task.release();
+
+	// The coroutine holds one dependency on the completion group until it returns.
+	auto completion = group.create_task();
+	completion->deps->dependency_count.fetch_add(1, std::memory_order_relaxed);
+	handle.promise().completion = completion->deps;
+
+	auto start = Internal::create_resume_task(group, handle, task_class);
+	group.submit(start);
+	return completion;
+}
+
+void TaskGroupAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+	auto *thread_group = group->get_thread_group();
+	auto resume = Internal::create_resume_task(*thread_group, h, task_class);
+	thread_group->add_continuation(*resume, *group);
+	if (!group->flushed)
+		group->flush();
+
+	// The coroutine may resume and destroy this awaiter as soon as this is submitted.
+	thread_group->submit(resume);
+}
+
+void TaskSignalAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+	auto resume = Internal::create_resume_task(group, h, task_class);
+	group.add_continuation(*resume, signal, count);
+	group.submit(resume);
+}
+
+void ScheduleAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+	auto resume = Internal::create_resume_task(group, h, task_class);
+	group.submit(resume);
+}
+}
@@ -0,0 +1,310 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+// Optional C++20 module (GRANITE_COROUTINES). The rest of Granite stays C++14.
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include "thread_group.hpp"
+
+namespace Granite
+{
+template <typename T = void>
+class CoTask;
+
+namespace Internal
+{
+struct CoTaskPromiseBase
+{
+	struct FinalAwaiter
+	{
+		bool await_ready() noexcept
+		{
+			return false;
+		}
+
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+		{
+			return h.promise().complete(h);
+		}
+
+		void await_resume() noexcept
+		{
+		}
+	};
+
+	std::suspend_always initial_suspend() noexcept
+	{
+		return {};
+	}
+
+	FinalAwaiter final_suspend() noexcept
+	{
+		return {};
+	}
+
+	void unhandled_exception() noexcept
+	{
+		exception = std::current_exception();
+	}
+
+	std::coroutine_handle<> complete(std::coroutine_handle<> h) noexcept;
+
+	std::coroutine_handle<> continuation;
+	std::exception_ptr exception;
+	// Only set for spawned coroutines, which own their frame.
+	TaskDepsHandle completion;
+};
+
+template <typename T>
+struct CoTaskPromise : CoTaskPromiseBase
+{
+	CoTask<T> get_return_object() noexcept;
+
+	template <typename U>
+	void return_value(U &&v)
+	{
+		value.emplace(std::forward<U>(v));
+	}
+
+	T take()
+	{
+		if (exception)
+			std::rethrow_exception(exception);
+		return std::move(*value);
+	}
+
+	std::optional<T> value;
+};
+
+template <>
+struct CoTaskPromise<void> : CoTaskPromiseBase
+{
+	CoTask<void> get_return_object() noexcept;
+
+	void return_void() noexcept
+	{
+	}
+
+	void take()
+	{
+		if (exception)
+			std::rethrow_exception(exception);
+	}
+};
+
+// Creates a task group which resumes h on a worker. Dependencies may be added before it is submitted.
+TaskGroupHandle create_resume_task(ThreadGroup &group, std::coroutine_handle<> h, TaskClass task_class);
+}
+
+// Lazily started coroutine. It runs when awaited, or when handed to spawn().
+// Awaiting a CoTask resumes the awaiter on the thread which completed the task.
+template <typename T>
+class CoTask
+{
+public:
+	using promise_type = Internal::CoTaskPromise<T>;
+
+	CoTask() = default;
+
+	explicit CoTask(std::coroutine_handle<promise_type> handle_) noexcept
+		: handle(handle_)
+	{
+	}
+
+	CoTask(CoTask &&other) noexcept
+		: handle(std::exchange(other.handle, {}))
+	{
+	}
+
+	CoTask &operator=(CoTask &&other) noexcept
+	{
+		if (this != &other)
+		{
+			if (handle)
+				handle.destroy();
+			handle = std::exchange(other.handle, {});
+		}
+		return *this;
+	}
+
+	CoTask(const CoTask &) = delete;
+	void operator=(const CoTask &) = delete;
+
+	~CoTask()
+	{
+		if (handle)
+			handle.destroy();
+	}
+
+	auto operator co_await() && noexcept
+	{
+		struct Awaiter
+		{
+			std::coroutine_handle<promise_type> handle;
+
+			bool await_ready() noexcept
+			{
+				return false;
+			}
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept
+			{
+				handle.promise().continuation = h;
+				return handle;
+			}
+
+			T await_resume()
+			{
+				return handle.promise().take();
+			}
+		};
+
+		return Awaiter{ handle };
+	}
+
+	std::coroutine_handle<promise_type> release() noexcept
+	{
+		return std::exchange(handle, {});
+	}
+
+private:
+	std::coroutine_handle<promise_type> handle;
+};
+
+namespace Internal
+{
+template <typename T>
+CoTask<T> CoTaskPromise<T>::get_return_object() noexcept
+{
+	return CoTask<T>(std::coroutine_handle<CoTaskPromise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> CoTaskPromise<void>::get_return_object() noexcept
+{
+	return CoTask<void>(std::coroutine_handle<CoTaskPromise<void>>::from_promise(*this));
+}
+}
+
+// Starts task on a worker. The returned task group completes when the coroutine returns,
+// so it composes with add_dependency(), wait() and co_await like any other task group.
+// As with create_task(), it must be flushed or submitted.
+TaskGroupHandle spawn(ThreadGroup &group, CoTask<void> task, TaskClass task_class = TaskClass::Foreground);
+
+// Suspends until the task group completes. Like TaskGroup::wait(), this flushes the group.
+class TaskGroupAwaiter
+{
+public:
+	explicit TaskGroupAwaiter(TaskGroupHandle group_, TaskClass task_class_ = TaskClass::Foreground)
+		: group(std::move(group_)), task_class(task_class_)
+	{
+	}
+
+	bool await_ready() noexcept
+	{
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> h);
+
+	void await_resume() noexcept
+	{
+	}
+
+private:
+	TaskGroupHandle group;
+	TaskClass task_class;
+};
+
+inline TaskGroupAwaiter operator co_await(TaskGroupHandle group)
+{
+	return TaskGroupAwaiter(std::move(group));
+}
+
+// Suspends until signal reaches count.
+class TaskSignalAwaiter
+{
+public:
+	TaskSignalAwaiter(ThreadGroup &group_, TaskSignal &signal_, uint64_t count_, TaskClass task_class_)
+		: group(group_), signal(signal_), count(count_), task_class(task_class_)
+	{
+	}
+
+	bool await_ready()
+	{
+		return signal.get_count() >= count;
+	}
+
+	void await_suspend(std::coroutine_handle<> h);
+
+	void await_resume() noexcept
+	{
+	}
+
+private:
+	ThreadGroup &group;
+	TaskSignal &signal;
+	uint64_t count;
+	TaskClass task_class;
+};
+
+inline TaskSignalAwaiter wait_for_signal(ThreadGroup &group, TaskSignal &signal, uint64_t count,
+                                         TaskClass task_class = TaskClass::Foreground)
+{
+	return TaskSignalAwaiter(group, signal, count, task_class);
+}
+
+// Moves the coroutine to a worker of the given class,
+// e.g. to do blocking work in the background before continuing in the foreground.
+class ScheduleAwaiter
+{
+public:
+	ScheduleAwaiter(ThreadGroup &group_, TaskClass task_class_)
+		: group(group_), task_class(task_class_)
+	{
+	}
+
+	bool await_ready() noexcept
+	{
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> h);
+
+	void await_resume() noexcept
+	{
+	}
+
+private:
+	ThreadGroup &group;
+	TaskClass task_class;
+};
+
+inline ScheduleAwaiter schedule_on(ThreadGroup &group, TaskClass task_class)
+{
+	return ScheduleAwaiter(group, task_class);
+}
+}
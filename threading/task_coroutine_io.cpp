@@ -0,0 +1,95 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "task_coroutine_io.hpp"
+#include "thread_name.hpp"
+
+namespace Granite
+{
+void FileReadAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+	auto task = group.create_task([this, h]() {
+		mapping = fs.open_readonly_mapping(path);
+		h.resume();
+	});
+	task->set_task_class(task_class);
+	task->set_desc("coroutine-file-read");
+	group.submit(task);
+}
+
+FenceWaiter::FenceWaiter(ThreadGroup &group_)
+	: group(group_)
+{
+	thread = std::thread(&FenceWaiter::thread_loop, this);
+}
+
+FenceWaiter::~FenceWaiter()
+{
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		dead = true;
+		cond.notify_one();
+	}
+	thread.join();
+}
+
+void FenceWaiter::Awaiter::await_suspend(std::coroutine_handle<> h)
+{
+	waiter.enqueue(std::move(fence), Internal::create_resume_task(waiter.group, h, task_class));
+}
+
+void FenceWaiter::enqueue(Vulkan::Fence fence, TaskGroupHandle resume)
+{
+	std::lock_guard<std::mutex> holder{lock};
+	pending.push({ std::move(fence), std::move(resume) });
+	cond.notify_one();
+}
+
+void FenceWaiter::thread_loop()
+{
+	Util::set_current_thread_name("FenceWaiter");
+
+	for (;;)
+	{
+		Pending p;
+
+		{
+			std::unique_lock<std::mutex> holder{lock};
+			cond.wait(holder, [this]() {
+				return dead || !pending.empty();
+			});
+
+			// Drain everything before exiting so no coroutine is left suspended.
+			if (pending.empty())
+				break;
+
+			p = std::move(pending.front());
+			pending.pop();
+		}
+
+		// Fences are generally signalled in submission order, so waiting in order is cheap.
+		p.fence->wait();
+		p.fence.reset();
+		group.submit(p.resume);
+	}
+}
+}
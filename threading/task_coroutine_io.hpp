@@ -0,0 +1,127 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "task_coroutine.hpp"
+#include "filesystem.hpp"
+#include "fence.hpp"
+#include <queue>
+#include <string>
+#include <thread>
+
+namespace Granite
+{
+// Maps a file on a worker, background by default, and continues the coroutine there.
+class FileReadAwaiter
+{
+public:
+	FileReadAwaiter(ThreadGroup &group_, Filesystem &fs_, std::string path_, TaskClass task_class_)
+		: group(group_), fs(fs_), path(std::move(path_)), task_class(task_class_)
+	{
+	}
+
+	bool await_ready() noexcept
+	{
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> h);
+
+	FileMappingHandle await_resume() noexcept
+	{
+		return std::move(mapping);
+	}
+
+private:
+	ThreadGroup &group;
+	Filesystem &fs;
+	std::string path;
+	TaskClass task_class;
+	FileMappingHandle mapping;
+};
+
+inline FileReadAwaiter read_file(ThreadGroup &group, Filesystem &fs, std::string path,
+                                 TaskClass task_class = TaskClass::Background)
+{
+	return FileReadAwaiter(group, fs, std::move(path), task_class);
+}
+
+// Waits for GPU fences on a dedicated thread, so no worker blocks on the GPU.
+// Coroutines awaiting a fence are resumed on a worker once it signals.
+class FenceWaiter
+{
+public:
+	explicit FenceWaiter(ThreadGroup &group);
+	~FenceWaiter();
+
+	FenceWaiter(const FenceWaiter &) = delete;
+	void operator=(const FenceWaiter &) = delete;
+
+	class Awaiter
+	{
+	public:
+		Awaiter(FenceWaiter &waiter_, Vulkan::Fence fence_, TaskClass task_class_)
+			: waiter(waiter_), fence(std::move(fence_)), task_class(task_class_)
+		{
+		}
+
+		bool await_ready()
+		{
+			return fence->wait_timeout(0);
+		}
+
+		void await_suspend(std::coroutine_handle<> h);
+
+		void await_resume() noexcept
+		{
+		}
+
+	private:
+		FenceWaiter &waiter;
+		Vulkan::Fence fence;
+		TaskClass task_class;
+	};
+
+	Awaiter wait(Vulkan::Fence fence, TaskClass task_class = TaskClass::Foreground)
+	{
+		return Awaiter(*this, std::move(fence), task_class);
+	}
+
+private:
+	struct Pending
+	{
+		Vulkan::Fence fence;
+		TaskGroupHandle resume;
+	};
+
+	ThreadGroup &group;
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable cond;
+	std::queue<Pending> pending;
+	bool dead = false;
+
+	void enqueue(Vulkan::Fence fence, TaskGroupHandle resume);
+	void thread_loop();
+};
+}
@@ -45,11 +45,17 @@ void TaskDeps::notify_dependees()
 		dep->dependency_satisfied();
 	pending.clear();
 
+	Util::SmallVector<TaskDepsHandle> satisfied_continuations;
+
 	{
 		std::lock_guard<std::mutex> holder{cond_lock};
 		done = true;
+		satisfied_continuations = std::move(continuations);
 		cond.notify_all();
 	}
+
+	for (auto &dep : satisfied_continuations)
+		dep->dependency_satisfied();
 }
 
 void TaskDeps::task_completed()
@@ -173,8 +179,10 @@ void ThreadGroup::start(unsigned num_threads_foreground,
 	std::string path;
 	if (Util::get_environment("GRANITE_TIMELINE_TRACE", path))
 	{
-		LOGI("Enabling JSON timeline tracing to %s.\n", path.c_str());
-		timeline_trace_file = std::make_unique<Util::TimelineTraceFile>(path);
+		LOGI("Enabling binary timeline tracing to %s. Use timeline-trace-convert to get JSON.\n", path.c_str());
+		unsigned ring_size = Util::get_environment_uint("GRANITE_TIMELINE_TRACE_RING_SIZE",
+		                                                Util::TimelineTraceFile::DefaultRingSize);
+		timeline_trace_file = std::make_unique<Util::TimelineTraceFile>(path, ring_size);
 	}
 #endif
 
@@ -224,6 +232,33 @@ void ThreadGroup::add_dependency(TaskGroup &dependee, TaskGroup &dependency)
 	dependee.deps->dependency_count.fetch_add(1, std::memory_order_relaxed);
 }
 
+void ThreadGroup::add_continuation(TaskGroup &continuation, TaskGroup &dependency)
+{
+	if (continuation.flushed)
+		throw std::logic_error("Cannot add continuation to task group which has been flushed.");
+
+	auto &deps = *dependency.deps;
+	std::lock_guard<std::mutex> holder{deps.cond_lock};
+	if (!deps.done)
+	{
+		deps.continuations.push_back(continuation.deps);
+		continuation.deps->dependency_count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void ThreadGroup::add_continuation(TaskGroup &continuation, TaskSignal &signal, uint64_t count)
+{
+	if (continuation.flushed)
+		throw std::logic_error("Cannot add continuation to task group which has been flushed.");
+
+	std::lock_guard<std::mutex> holder{signal.lock};
+	if (signal.counter < count)
+	{
+		signal.continuations.push_back({ count, continuation.deps });
+		continuation.deps->dependency_count.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
 void ThreadGroup::move_to_ready_tasks(const Util::SmallVector<Internal::Task *> &list)
 {
 	unsigned fg_task_count = 0;
@@ -293,9 +328,28 @@ void ThreadGroup::free_task_deps(Internal::TaskDeps *deps)
 
 void TaskSignal::signal_increment()
 {
-	std::lock_guard<std::mutex> holder{lock};
-	counter++;
-	cond.notify_all();
+	Util::SmallVector<Internal::TaskDepsHandle> satisfied_continuations;
+
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		counter++;
+		cond.notify_all();
+
+		for (size_t i = 0; i < continuations.size(); )
+		{
+			if (continuations[i].count <= counter)
+			{
+				satisfied_continuations.push_back(std::move(continuations[i].deps));
+				continuations[i] = std::move(continuations.back());
+				continuations.pop_back();
+			}
+			else
+				i++;
+		}
+	}
+
+	for (auto &dep : satisfied_continuations)
+		dep->dependency_satisfied();
 }
 
 void TaskSignal::wait_until_at_least(uint64_t count)
@@ -40,17 +40,7 @@
 namespace Granite
 {
 class ThreadGroup;
-
-struct TaskSignal
-{
-	std::condition_variable cond;
-	std::mutex lock;
-	uint64_t counter = 0;
-
-	void signal_increment();
-	void wait_until_at_least(uint64_t count);
-	uint64_t get_count();
-};
+struct TaskSignal;
 
 enum class TaskClass : uint8_t
 {
@@ -100,6 +90,8 @@ struct TaskDeps : Util::IntrusivePtrEnabled<TaskDeps, TaskDepsDeleter, Util::Mul
 	std::condition_variable cond;
 	std::mutex cond_lock;
 	bool done = false;
+	// Unlike pending, these may be added after flush. Protected by cond_lock.
+	Util::SmallVector<Util::IntrusivePtr<TaskDeps>> continuations;
 	TaskClass task_class = TaskClass::Foreground;
 
 	char desc[64];
@@ -123,6 +115,24 @@ struct Task
 static_assert(sizeof(Task) == 64, "sizeof(Task) is unexpected.");
 }
 
+struct TaskSignal
+{
+	std::condition_variable cond;
+	std::mutex lock;
+	uint64_t counter = 0;
+
+	struct Continuation
+	{
+		uint64_t count;
+		Internal::TaskDepsHandle deps;
+	};
+	Util::SmallVector<Continuation> continuations;
+
+	void signal_increment();
+	void wait_until_at_least(uint64_t count);
+	uint64_t get_count();
+};
+
 struct TaskGroup : Util::IntrusivePtrEnabled<TaskGroup, Internal::TaskGroupDeleter, Util::MultiThreadCounter>
 {
 	explicit TaskGroup(ThreadGroup *group);
@@ -178,6 +188,12 @@ public:
 
 	void add_dependency(TaskGroup &dependee, TaskGroup &dependency);
 
+	// Like add_dependency, but dependency may already be flushed or even completed.
+	// In the latter case, continuation is not held back.
+	void add_continuation(TaskGroup &continuation, TaskGroup &dependency);
+	// continuation is held back until signal reaches count.
+	void add_continuation(TaskGroup &continuation, TaskSignal &signal, uint64_t count);
+
 	void free_task_group(TaskGroup *group);
 	void free_task_deps(Internal::TaskDeps *deps);
 
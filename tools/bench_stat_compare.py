@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+
+import sys
+import argparse
+import json
+
+def read_stat_file(path):
+    with open(path, 'r') as f:
+        json_data = f.read()
+        parsed = json.loads(json_data)
+        return parsed
+
+def gather_series(stats):
+    series = {}
+    if 'frameTimeUs' in stats:
+        series['frame'] = stats['frameTimeUs']
+    elif 'averageFrameTimeUs' in stats:
+        # Older stat files only have the average.
+        avg = stats['averageFrameTimeUs']
+        series['frame'] = { 'mean' : avg, 'p50' : avg, 'p95' : avg, 'p99' : avg, 'stddev' : 0.0 }
+
+    for domain, key in [('cpu', 'cpuPhasesUs'), ('gpu', 'gpuPassesUs')]:
+        if key in stats:
+            for name, value in stats[key].items():
+                series[domain + ':' + name] = value
+    return series
+
+def main():
+    parser = argparse.ArgumentParser(description = 'Script for comparing headless benchmark stat files.')
+    parser.add_argument('baseline',
+                        help = 'Baseline stat file')
+    parser.add_argument('candidate',
+                        help = 'Candidate stat file')
+    parser.add_argument('--metrics',
+                        help = 'Statistics to compare',
+                        nargs = '+',
+                        default = ['p50', 'p95', 'p99'])
+    parser.add_argument('--threshold',
+                        help = 'Relative slowdown in percent which is considered a regression',
+                        type = float,
+                        default = 5.0)
+    parser.add_argument('--min-time',
+                        help = 'Ignore series where the baseline is below this time in microseconds',
+                        type = float,
+                        default = 10.0)
+    parser.add_argument('--stddev-scale',
+                        help = 'Also require the difference to exceed this many baseline standard deviations',
+                        type = float,
+                        default = 0.0)
+
+    args = parser.parse_args()
+
+    baseline = gather_series(read_stat_file(args.baseline))
+    candidate = gather_series(read_stat_file(args.candidate))
+
+    regressions = 0
+    print('{:<50} {:>6} {:>12} {:>12} {:>9}'.format('Series', 'Stat', 'Baseline', 'Candidate', 'Delta'))
+    for name in sorted(set(baseline.keys()) | set(candidate.keys())):
+        if name not in baseline:
+            print('{:<50} only in candidate'.format(name))
+            continue
+        if name not in candidate:
+            print('{:<50} only in baseline'.format(name))
+            continue
+
+        base = baseline[name]
+        cand = candidate[name]
+        for metric in args.metrics:
+            if metric not in base or metric not in cand:
+                continue
+
+            b = base[metric]
+            c = cand[metric]
+            if b < args.min_time:
+                continue
+
+            delta = 100.0 * (c - b) / b
+            noise = args.stddev_scale * base.get('stddev', 0.0)
+            regressed = delta > args.threshold and (c - b) > noise
+            improved = delta < -args.threshold and (b - c) > noise
+
+            tag = ''
+            if regressed:
+                tag = ' REGRESSION'
+                regressions += 1
+            elif improved:
+                tag = ' improvement'
+
+            print('{:<50} {:>6} {:>12.3f} {:>12.3f} {:>+8.2f}%{}'.format(name, metric, b, c, delta, tag))
+
+    if regressions != 0:
+        print('{} regression(s) above {:.2f}% threshold.'.format(regressions, args.threshold))
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
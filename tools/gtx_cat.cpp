@@ -23,17 +23,40 @@
 #include "logging.hpp"
 #include "memory_mapped_texture.hpp"
 #include "global_managers_init.hpp"
+#include "thread_group.hpp"
 #include <string.h>
 #include <vector>
 #include <utility>
 
 using namespace Granite;
 
+static void print_help(const char *name)
+{
+	LOGE("Usage: %s [--supercompress <none|lz4>] <output> <cube|2D> <inputs>...\n", name);
+}
+
 int main(int argc, char *argv[])
 {
+	const char *name = argv[0];
+	auto supercompression = Vulkan::TextureSupercompression::None;
+
+	if (argc >= 3 && strcmp(argv[1], "--supercompress") == 0)
+	{
+		if (strcmp(argv[2], "lz4") == 0)
+			supercompression = Vulkan::TextureSupercompression::LZ4;
+		else if (strcmp(argv[2], "none") != 0)
+		{
+			LOGE("Invalid supercompression %s.\n", argv[2]);
+			return 1;
+		}
+
+		argc -= 2;
+		argv += 2;
+	}
+
 	if (argc < 4)
 	{
-		LOGE("Usage: %s <output> <cube|2D> <inputs>...\n", argv[0]);
+		print_help(name);
 		return 1;
 	}
 
@@ -52,7 +75,7 @@ int main(int argc, char *argv[])
 	bool type_2d = strcmp(argv[2], "2D") == 0;
 	if (!type_2d && !cube)
 	{
-		LOGE("Usage: %s <output> <cube|2D> <inputs>...\n", argv[0]);
+		print_help(name);
 		return 1;
 	}
 
@@ -137,7 +160,11 @@ int main(int argc, char *argv[])
 	if (generate_mips)
 		array.set_generate_mipmaps_on_load(true);
 
-	if (!array.map_write(*GRANITE_FILESYSTEM(), argv[1]))
+	// Supercompressed output is assembled in scratch memory and written out at the end.
+	bool mapped = supercompression != Vulkan::TextureSupercompression::None ?
+	              array.map_write_scratch() : array.map_write(*GRANITE_FILESYSTEM(), argv[1]);
+
+	if (!mapped)
 	{
 		LOGE("Failed to save file: %s\n", argv[1]);
 		return 1;
@@ -161,5 +188,12 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (supercompression != Vulkan::TextureSupercompression::None &&
+	    !array.copy_to_path(*GRANITE_FILESYSTEM(), argv[1], supercompression, GRANITE_THREAD_GROUP()))
+	{
+		LOGE("Failed to save file: %s\n", argv[1]);
+		return 1;
+	}
+
 	return 0;
 }
\ No newline at end of file
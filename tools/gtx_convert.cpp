@@ -44,8 +44,21 @@ static void print_help()
 	     "\t[--swizzle <rgba01>x4]\n"
 	     "\t[--normal-la]\n"
 	     "\t[--mask-la]\n"
+	     "\t[--supercompress <none|lz4>]\n"
 	     "\t--output <out.gtx>\n"
-	     "\t<in.gtx>\n");
+	     "\t<in.gtx>\n"
+	     "Without --format, the input is written out as-is, which can be used to (de)supercompress existing textures.\n");
+}
+
+static Vulkan::TextureSupercompression parse_supercompression(const char *str)
+{
+	if (strcmp(str, "none") == 0)
+		return Vulkan::TextureSupercompression::None;
+	else if (strcmp(str, "lz4") == 0)
+		return Vulkan::TextureSupercompression::LZ4;
+
+	LOGE("Invalid supercompression %s.\n", str);
+	exit(EXIT_FAILURE);
 }
 
 static VkComponentSwizzle parse_swizzle(const char c)
@@ -130,6 +143,7 @@ int main(int argc, char *argv[])
 	cbs.add("--mipgen", [&](CLIParser &) { generate_mipmap = true; });
 	cbs.add("--deferred-mipgen", [&](CLIParser &) { deferred_generate_mipmap = true; });
 	cbs.add("--swizzle", [&](CLIParser &parser) { swizzle = parse_swizzle(parser.next_string()); });
+	cbs.add("--supercompress", [&](CLIParser &parser) { args.supercompression = parse_supercompression(parser.next_string()); });
 	cbs.default_handler = [&](const char *arg) { input_path = arg; };
 	cbs.error_handler = []() { print_help(); };
 	CLIParser parser(std::move(cbs), argc - 1, argv + 1);
@@ -139,16 +153,30 @@ int main(int argc, char *argv[])
 	else if (parser.is_ended_state())
 		return 0;
 
-	if (args.format == VK_FORMAT_UNDEFINED)
+	if (args.output.empty() || input_path.empty())
 	{
-		LOGE("Must provide a format.\n");
+		LOGE("Must provide input and output paths.\n");
 		return 1;
 	}
 
-	if (args.output.empty() || input_path.empty())
+	ThreadGroup &group = *GRANITE_THREAD_GROUP();
+
+	if (args.format == VK_FORMAT_UNDEFINED)
 	{
-		LOGE("Must provide input and output paths.\n");
-		return 1;
+		Vulkan::MemoryMappedTexture input;
+		if (!input.map_read(*GRANITE_FILESYSTEM(), input_path) || input.empty())
+		{
+			LOGE("Must provide a format, or a GTX texture to repack.\n");
+			return 1;
+		}
+
+		if (!input.copy_to_path(*GRANITE_FILESYSTEM(), args.output, args.supercompression, &group))
+		{
+			LOGE("Failed to save texture: %s\n", args.output.c_str());
+			return 1;
+		}
+
+		return 0;
 	}
 
 	Vulkan::ColorSpace color = Vulkan::format_is_srgb(args.format) ?
@@ -194,8 +222,6 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	ThreadGroup &group = *GRANITE_THREAD_GROUP();
-
 	auto dummy = group.create_task();
 	compress_texture(group, args, input, dummy, nullptr);
 	dummy->flush();
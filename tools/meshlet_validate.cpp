@@ -0,0 +1,113 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "logging.hpp"
+#include "meshlet.hpp"
+#include "filesystem.hpp"
+#include "global_managers_init.hpp"
+#include "cli_parser.hpp"
+#include "timer.hpp"
+#include <string>
+
+using namespace Granite;
+using namespace Vulkan::Meshlet;
+using namespace Util;
+
+static void print_help()
+{
+	LOGI("Usage: meshlet-validate [--iterations <count>] <mesh.msh>\n");
+}
+
+// Decodes every LOD level on the CPU, which validates all streams.
+// With --iterations, also measures decode throughput of the full detail level.
+int main(int argc, char *argv[])
+{
+	std::string input;
+	unsigned iterations = 0;
+
+	CLICallbacks cbs;
+	cbs.add("--iterations", [&](CLIParser &parser) { iterations = parser.next_uint(); });
+	cbs.add("--help", [](CLIParser &parser) { print_help(); parser.end(); });
+	cbs.default_handler = [&](const char *arg) { input = arg; };
+	CLIParser cli_parser(std::move(cbs), argc - 1, argv + 1);
+	if (!cli_parser.parse())
+	{
+		print_help();
+		return 1;
+	}
+	else if (cli_parser.is_ended_state())
+		return 0;
+
+	if (input.empty())
+	{
+		print_help();
+		return 1;
+	}
+
+	Global::init(Global::MANAGER_FEATURE_FILESYSTEM_BIT);
+
+	auto file = GRANITE_FILESYSTEM()->open(input, FileMode::ReadOnly);
+	if (!file)
+	{
+		LOGE("Failed to open %s.\n", input.c_str());
+		return 1;
+	}
+
+	auto mapping = file->map();
+	if (!mapping)
+	{
+		LOGE("Failed to map %s.\n", input.c_str());
+		return 1;
+	}
+
+	auto base_view = create_mesh_view(*mapping);
+	if (!base_view.format_header)
+		return 1;
+
+	DecodedMesh decoded;
+	for (uint32_t level = 0; level < base_view.num_lod_levels; level++)
+	{
+		auto view = create_mesh_view(*mapping, level);
+		if (!view.format_header || !decode_mesh_cpu(view, decoded))
+		{
+			LOGE("LOD %u failed to decode.\n", level);
+			return 1;
+		}
+
+		LOGI("LOD %u: %u meshlets, %u primitives, %u vertices.\n",
+		     level, view.format_header->meshlet_count, view.total_primitives, view.total_vertices);
+	}
+
+	if (iterations)
+	{
+		auto start_ns = Util::get_current_time_nsecs();
+		for (unsigned i = 0; i < iterations; i++)
+			decode_mesh_cpu(base_view, decoded);
+		double seconds = double(Util::get_current_time_nsecs() - start_ns) * 1e-9;
+
+		LOGI("Primitives / s: %.3f M\n", 1e-6 * base_view.total_primitives * iterations / seconds);
+		LOGI("Vertices / s: %.3f M\n", 1e-6 * base_view.total_vertices * iterations / seconds);
+	}
+
+	LOGI("%s is valid.\n", input.c_str());
+	return 0;
+}
@@ -0,0 +1,235 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "logging.hpp"
+#include "cli_parser.hpp"
+#include "memory_mapped_texture.hpp"
+#include "global_managers_init.hpp"
+#include "filesystem.hpp"
+#include "path_utils.hpp"
+#include "string_helpers.hpp"
+#include "muglm/muglm_impl.hpp"
+#include <string.h>
+#include <vector>
+
+using namespace Granite;
+using namespace Util;
+
+// Writes the tile pyramid consumed by Ground in clipmap mode.
+// Level L is the heightmap decimated by 2^L, so that vertices shared between levels sample identical heights.
+// Each level is stored as heights_L<L>.tiles (R16_SFLOAT) and normals_L<L>.tiles (RG8_UNORM),
+// a row-major array of equally sized GTX files which are streamed in individually.
+
+static void print_help()
+{
+	LOGI("Usage: \n"
+	     "\t[--tile-size <size>]\n"
+	     "\t[--levels <count>]\n"
+	     "\t--output <directory>\n"
+	     "\t<heightmap.gtx>\n");
+}
+
+static bool load_heights(const Vulkan::MemoryMappedTexture &tex, std::vector<float> &heights)
+{
+	auto &layout = tex.get_layout();
+	unsigned width = layout.get_width();
+	unsigned height = layout.get_height();
+	heights.resize(width * height);
+
+	switch (layout.get_format())
+	{
+	case VK_FORMAT_R16_SFLOAT:
+		for (unsigned y = 0; y < height; y++)
+		{
+			auto *src = layout.data_generic<const uint16_t>(0, y, 0, 0);
+			for (unsigned x = 0; x < width; x++)
+				heights[y * width + x] = muglm::halfToFloat(src[x]);
+		}
+		return true;
+
+	case VK_FORMAT_R32_SFLOAT:
+		for (unsigned y = 0; y < height; y++)
+			memcpy(&heights[y * width], layout.data_generic<const float>(0, y, 0, 0), width * sizeof(float));
+		return true;
+
+	default:
+		LOGE("Heightmap must be R16_SFLOAT or R32_SFLOAT.\n");
+		return false;
+	}
+}
+
+struct LevelWriter
+{
+	FileHandle file;
+	FileMappingHandle mapping;
+	size_t stride = 0;
+
+	bool begin(const std::string &path, VkFormat format, unsigned tile_size, unsigned num_tiles)
+	{
+		Vulkan::MemoryMappedTexture probe;
+		probe.set_2d(format, tile_size, tile_size);
+		stride = probe.get_required_size();
+
+		file = GRANITE_FILESYSTEM()->open(path, FileMode::WriteOnly);
+		if (!file)
+		{
+			LOGE("Failed to open %s for writing.\n", path.c_str());
+			return false;
+		}
+
+		mapping = file->map_write(stride * num_tiles * num_tiles);
+		if (!mapping)
+		{
+			LOGE("Failed to map %s for writing.\n", path.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+	// Each tile writes through a non-owning view into the level mapping.
+	Vulkan::MemoryMappedTexture tile(VkFormat format, unsigned tile_size, unsigned index)
+	{
+		auto *ptr = mapping->mutable_data<uint8_t>() + index * stride;
+		Vulkan::MemoryMappedTexture tex;
+		tex.set_2d(format, tile_size, tile_size);
+		tex.map_write(make_handle<FileMapping>(FileHandle{}, 0, ptr, stride, 0, stride));
+		return tex;
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	Global::init(Global::MANAGER_FEATURE_FILESYSTEM_BIT);
+
+	std::string input_path;
+	std::string output_dir;
+	unsigned tile_size = 256;
+	unsigned max_levels = 16;
+
+	CLICallbacks cbs;
+	cbs.add("--help", [&](CLIParser &parser) { print_help(); parser.end(); });
+	cbs.add("--tile-size", [&](CLIParser &parser) { tile_size = parser.next_uint(); });
+	cbs.add("--levels", [&](CLIParser &parser) { max_levels = parser.next_uint(); });
+	cbs.add("--output", [&](CLIParser &parser) { output_dir = parser.next_string(); });
+	cbs.default_handler = [&](const char *arg) { input_path = arg; };
+	cbs.error_handler = []() { print_help(); };
+	CLIParser parser(std::move(cbs), argc - 1, argv + 1);
+
+	if (!parser.parse())
+		return 1;
+	else if (parser.is_ended_state())
+		return 0;
+
+	if (input_path.empty() || output_dir.empty())
+	{
+		LOGE("Must provide input and output paths.\n");
+		return 1;
+	}
+
+	Vulkan::MemoryMappedTexture input;
+	if (!input.map_read(*GRANITE_FILESYSTEM(), input_path) || input.empty())
+	{
+		LOGE("Failed to load heightmap: %s\n", input_path.c_str());
+		return 1;
+	}
+
+	unsigned size = input.get_layout().get_width();
+	if (input.get_layout().get_height() != size || tile_size == 0 || size % tile_size != 0)
+	{
+		LOGE("Heightmap must be square and a multiple of the tile size %u.\n", tile_size);
+		return 1;
+	}
+
+	std::vector<float> heights;
+	if (!load_heights(input, heights))
+		return 1;
+
+	unsigned level = 0;
+	for (; level < max_levels; level++)
+	{
+		unsigned level_size = size >> level;
+		if (level_size < tile_size || level_size % tile_size != 0)
+			break;
+
+		unsigned stride = 1u << level;
+		unsigned num_tiles = level_size / tile_size;
+		const auto sample = [&](int x, int y) -> float {
+			x = clamp(x, 0, int(level_size) - 1);
+			y = clamp(y, 0, int(level_size) - 1);
+			return heights[(y * stride) * size + x * stride];
+		};
+
+		LevelWriter height_writer, normal_writer;
+		if (!height_writer.begin(Path::join(output_dir, join("heights_L", level, ".tiles")),
+		                         VK_FORMAT_R16_SFLOAT, tile_size, num_tiles) ||
+		    !normal_writer.begin(Path::join(output_dir, join("normals_L", level, ".tiles")),
+		                         VK_FORMAT_R8G8_UNORM, tile_size, num_tiles))
+		{
+			return 1;
+		}
+
+		// Slopes are expressed per level 0 texel so that one normal transform works for every level.
+		float inv_spacing = 0.5f / float(stride);
+
+		for (unsigned tile_y = 0; tile_y < num_tiles; tile_y++)
+		{
+			for (unsigned tile_x = 0; tile_x < num_tiles; tile_x++)
+			{
+				unsigned index = tile_y * num_tiles + tile_x;
+				auto height_tile = height_writer.tile(VK_FORMAT_R16_SFLOAT, tile_size, index);
+				auto normal_tile = normal_writer.tile(VK_FORMAT_R8G8_UNORM, tile_size, index);
+
+				for (unsigned y = 0; y < tile_size; y++)
+				{
+					auto *h = height_tile.get_layout().data_generic<uint16_t>(0, y, 0, 0);
+					auto *n = static_cast<uint8_t *>(normal_tile.get_layout().data_opaque(0, y, 0, 0));
+					int sy = int(tile_y * tile_size + y);
+
+					for (unsigned x = 0; x < tile_size; x++)
+					{
+						int sx = int(tile_x * tile_size + x);
+						h[x] = muglm::floatToHalf(sample(sx, sy));
+
+						float dx = (sample(sx + 1, sy) - sample(sx - 1, sy)) * inv_spacing;
+						float dy = (sample(sx, sy + 1) - sample(sx, sy - 1)) * inv_spacing;
+						vec3 normal = normalize(vec3(-dx, -dy, 1.0f));
+						n[2 * x + 0] = uint8_t(clamp(normal.x * 127.5f + 127.5f, 0.0f, 255.0f) + 0.5f);
+						n[2 * x + 1] = uint8_t(clamp(normal.y * 127.5f + 127.5f, 0.0f, 255.0f) + 0.5f);
+					}
+				}
+			}
+		}
+
+		LOGI("Wrote level %u: %u x %u tiles.\n", level, num_tiles, num_tiles);
+	}
+
+	if (level == 0)
+	{
+		LOGE("Heightmap is smaller than a tile.\n");
+		return 1;
+	}
+
+	LOGI("Use \"tileDirectory\", \"tileSize\": %u, \"clipmapLevels\": %u and \"size\": %u in the terrain description.\n",
+	     tile_size, level, size);
+	return 0;
+}
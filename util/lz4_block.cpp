@@ -0,0 +1,250 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lz4_block.hpp"
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+namespace Util
+{
+static constexpr size_t MinMatch = 4;
+// The last match must start at least this many bytes before the end of the block.
+static constexpr size_t MatchFindLimit = 12;
+// The last bytes of a block are always literals.
+static constexpr size_t LastLiterals = 5;
+static constexpr size_t MaxOffset = 65535;
+static constexpr unsigned MinHashBits = 8;
+static constexpr unsigned MaxHashBits = 20;
+
+size_t lz4_compress_bound(size_t src_size)
+{
+	return src_size + src_size / 255 + 16;
+}
+
+static inline uint32_t read32(const uint8_t *ptr)
+{
+	uint32_t v;
+	memcpy(&v, ptr, sizeof(v));
+	return v;
+}
+
+static inline uint32_t hash_sequence(uint32_t v, unsigned hash_bits)
+{
+	return (v * 2654435761u) >> (32 - hash_bits);
+}
+
+static uint8_t *write_length(uint8_t *op, const uint8_t *oend, size_t len)
+{
+	while (len >= 255)
+	{
+		if (op >= oend)
+			return nullptr;
+		*op++ = 255;
+		len -= 255;
+	}
+
+	if (op >= oend)
+		return nullptr;
+	*op++ = uint8_t(len);
+	return op;
+}
+
+static uint8_t *write_sequence(uint8_t *op, const uint8_t *oend,
+                               const uint8_t *literals, size_t literal_len,
+                               size_t offset, size_t match_len)
+{
+	if (op >= oend)
+		return nullptr;
+
+	uint8_t *token = op++;
+	*token = uint8_t((literal_len >= 15 ? 15 : literal_len) << 4);
+	if (literal_len >= 15 && !(op = write_length(op, oend, literal_len - 15)))
+		return nullptr;
+
+	if (size_t(oend - op) < literal_len)
+		return nullptr;
+	if (literal_len)
+		memcpy(op, literals, literal_len);
+	op += literal_len;
+
+	// Final sequence has no match.
+	if (!match_len)
+		return op;
+
+	if (size_t(oend - op) < 2)
+		return nullptr;
+	*op++ = uint8_t(offset & 0xff);
+	*op++ = uint8_t(offset >> 8);
+
+	match_len -= MinMatch;
+	*token |= uint8_t(match_len >= 15 ? 15 : match_len);
+	if (match_len >= 15 && !(op = write_length(op, oend, match_len - 15)))
+		return nullptr;
+
+	return op;
+}
+
+size_t lz4_compress(void *dst_, size_t dst_size, const void *src_, size_t src_size, unsigned hash_bits)
+{
+	auto *dst = static_cast<uint8_t *>(dst_);
+	auto *src = static_cast<const uint8_t *>(src_);
+	uint8_t *op = dst;
+	const uint8_t *oend = dst + dst_size;
+
+	const uint8_t *ip = src;
+	const uint8_t *anchor = src;
+	const uint8_t *iend = src + src_size;
+
+	if (src_size > MatchFindLimit)
+	{
+		if (hash_bits < MinHashBits)
+			hash_bits = MinHashBits;
+		else if (hash_bits > MaxHashBits)
+			hash_bits = MaxHashBits;
+
+		// Positions are stored relative to src, +1 so that 0 means empty.
+		std::vector<uint32_t> table(1u << hash_bits);
+		const uint8_t *match_limit = iend - MatchFindLimit;
+		const uint8_t *match_end_limit = iend - LastLiterals;
+
+		while (ip < match_limit)
+		{
+			uint32_t seq = read32(ip);
+			uint32_t &entry = table[hash_sequence(seq, hash_bits)];
+			const uint8_t *ref = entry ? src + entry - 1 : nullptr;
+			entry = uint32_t(ip - src) + 1;
+
+			if (!ref || size_t(ip - ref) > MaxOffset || read32(ref) != seq)
+			{
+				ip++;
+				continue;
+			}
+
+			// Extend the match backwards into pending literals.
+			while (ip > anchor && ref > src && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+
+			const uint8_t *match_end = ip + MinMatch;
+			const uint8_t *ref_end = ref + MinMatch;
+			while (match_end < match_end_limit && *match_end == *ref_end)
+			{
+				match_end++;
+				ref_end++;
+			}
+
+			op = write_sequence(op, oend, anchor, size_t(ip - anchor), size_t(ip - ref), size_t(match_end - ip));
+			if (!op)
+				return 0;
+
+			// Seed the table with a position inside the match to help the next search.
+			if (match_end - 2 > ip && match_end - 2 < match_limit)
+				table[hash_sequence(read32(match_end - 2), hash_bits)] = uint32_t(match_end - 2 - src) + 1;
+
+			ip = match_end;
+			anchor = ip;
+		}
+	}
+
+	op = write_sequence(op, oend, anchor, size_t(iend - anchor), 0, 0);
+	if (!op)
+		return 0;
+	return size_t(op - dst);
+}
+
+static bool read_length(const uint8_t *&ip, const uint8_t *iend, size_t &len)
+{
+	uint8_t v;
+	do
+	{
+		if (ip >= iend)
+			return false;
+		v = *ip++;
+		len += v;
+	} while (v == 255);
+	return true;
+}
+
+bool lz4_decompress(void *dst_, size_t dst_size, const void *src_, size_t src_size)
+{
+	auto *dst = static_cast<uint8_t *>(dst_);
+	auto *src = static_cast<const uint8_t *>(src_);
+	uint8_t *op = dst;
+	uint8_t *oend = dst + dst_size;
+	const uint8_t *ip = src;
+	const uint8_t *iend = src + src_size;
+
+	for (;;)
+	{
+		if (ip >= iend)
+			return false;
+
+		uint8_t token = *ip++;
+		size_t literal_len = token >> 4;
+		if (literal_len == 15 && !read_length(ip, iend, literal_len))
+			return false;
+
+		if (size_t(iend - ip) < literal_len || size_t(oend - op) < literal_len)
+			return false;
+		if (literal_len)
+			memcpy(op, ip, literal_len);
+		op += literal_len;
+		ip += literal_len;
+
+		// The last sequence ends the block after its literals.
+		if (ip == iend)
+			return op == oend;
+
+		if (size_t(iend - ip) < 2)
+			return false;
+		size_t offset = ip[0] | (size_t(ip[1]) << 8);
+		ip += 2;
+
+		if (offset == 0 || offset > size_t(op - dst))
+			return false;
+
+		size_t match_len = token & 15;
+		if (match_len == 15 && !read_length(ip, iend, match_len))
+			return false;
+		match_len += MinMatch;
+
+		if (size_t(oend - op) < match_len)
+			return false;
+
+		const uint8_t *ref = op - offset;
+		if (offset >= match_len)
+		{
+			memcpy(op, ref, match_len);
+			op += match_len;
+		}
+		else
+		{
+			// Overlapping copies replicate the pattern, so they must go byte by byte.
+			for (size_t i = 0; i < match_len; i++)
+				*op++ = *ref++;
+		}
+	}
+}
+}
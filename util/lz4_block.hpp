@@ -0,0 +1,43 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+namespace Util
+{
+// Compressor and decompressor for the LZ4 block format.
+// Blocks are raw LZ4 blocks without frame headers, so sizes must be tracked externally.
+
+// Worst case size of compressing src_size bytes.
+size_t lz4_compress_bound(size_t src_size);
+
+// Returns compressed size, or 0 if dst_size is too small.
+// hash_bits sizes the match finder table (clamped to [8, 20]). Smaller tables are cheaper
+// to set up for small blocks, larger tables find more matches in large blocks.
+size_t lz4_compress(void *dst, size_t dst_size, const void *src, size_t src_size, unsigned hash_bits = 16);
+
+// Succeeds only if the block decompresses to exactly dst_size bytes.
+// Safe against malformed input.
+bool lz4_decompress(void *dst, size_t dst_size, const void *src, size_t src_size);
+}
@@ -24,17 +24,81 @@
 #include "timeline_trace_file.hpp"
 #include "thread_name.hpp"
 #include "timer.hpp"
+#include "bitops.hpp"
 #include <string.h>
 #include <stdio.h>
+#include <algorithm>
 
 namespace Util
 {
+static constexpr uint32_t TraceFileVersion = 1;
+static const char TraceFileMagic[4] = { 'G', 'T', 'R', 'C' };
+
+enum TraceChunkType : uint32_t
+{
+	TRACE_CHUNK_STRINGS = 1,
+	TRACE_CHUNK_RECORDS = 2
+};
+
+// If a ring fills up before the writer gets to it, the producer links in a ring twice the size and continues there.
+// The writer drains the old ring to completion before following the link and freeing it.
+struct TimelineTraceFile::ThreadRing
+{
+	explicit ThreadRing(uint32_t size_)
+		: records(new Record[size_]), size(size_)
+	{
+		write_index.store(0, std::memory_order_relaxed);
+		read_index.store(0, std::memory_order_relaxed);
+		next.store(nullptr, std::memory_order_relaxed);
+	}
+
+	~ThreadRing()
+	{
+		delete next.load(std::memory_order_relaxed);
+	}
+
+	std::unique_ptr<Record[]> records;
+	uint32_t size;
+
+	// Producer side. The read index is only reloaded when the ring appears to be full,
+	// so the producer does not have to touch the consumer's cache line on every push.
+	std::atomic_uint32_t write_index;
+	uint32_t cached_read_index = 0;
+	std::atomic<ThreadRing *> next;
+	uint8_t producer_padding[64 - 2 * sizeof(uint32_t) - sizeof(void *)];
+
+	// Consumer side.
+	std::atomic_uint32_t read_index;
+	uint8_t consumer_padding[64 - sizeof(uint32_t)];
+};
+
+static constexpr uint32_t TraceStringCacheSize = 256;
+
+struct TimelineTraceFile::ThreadState
+{
+	uint64_t instance_id = 0;
+	ThreadRing *ring = nullptr;
+
+	// Direct mapped cache of interned strings. Misses fall back to the global table.
+	struct
+	{
+		Hash hash;
+		uint32_t id_plus_one;
+	} string_cache[TraceStringCacheSize];
+
+	uint32_t tid = 0;
+	bool tid_valid = false;
+};
+
+thread_local TimelineTraceFile::ThreadState TimelineTraceFile::thread_state;
 static thread_local char trace_tid[32];
 static thread_local TimelineTraceFile *trace_file;
+static std::atomic_uint64_t trace_instance_counter;
 
 void TimelineTraceFile::set_tid(const char *tid)
 {
 	snprintf(trace_tid, sizeof(trace_tid), "%s", tid);
+	thread_state.tid_valid = false;
 }
 
 void TimelineTraceFile::set_per_thread(TimelineTraceFile *file)
@@ -47,120 +111,452 @@ TimelineTraceFile *TimelineTraceFile::get_per_thread()
 	return trace_file;
 }
 
-void TimelineTraceFile::Event::set_desc(const char *desc_)
+TimelineTraceFile::ThreadState &TimelineTraceFile::get_thread_state()
+{
+	auto &state = thread_state;
+	if (state.instance_id != instance_id)
+	{
+		// First use of this file on this thread. Only path which needs to lock.
+		auto ring = std::make_unique<ThreadRing>(ring_size);
+
+		state.instance_id = instance_id;
+		state.ring = ring.get();
+		memset(state.string_cache, 0, sizeof(state.string_cache));
+		state.tid_valid = false;
+
+		std::lock_guard<std::mutex> holder{lock};
+		rings.push_back(std::move(ring));
+	}
+
+	return state;
+}
+
+uint32_t TimelineTraceFile::intern_string(const char *str)
+{
+	Hasher h;
+	h.string(str);
+	auto hash = h.get();
+
+	auto &state = get_thread_state();
+	auto &entry = state.string_cache[hash & (TraceStringCacheSize - 1)];
+	if (entry.id_plus_one && entry.hash == hash)
+		return entry.id_plus_one - 1;
+
+	uint32_t id;
+	{
+		std::lock_guard<std::mutex> holder{string_lock};
+		auto global_itr = string_ids.find(hash);
+		if (global_itr != string_ids.end())
+		{
+			id = global_itr->second;
+		}
+		else
+		{
+			id = uint32_t(strings.size());
+			strings.emplace_back(str);
+			string_ids[hash] = id;
+		}
+	}
+
+	entry.hash = hash;
+	entry.id_plus_one = id + 1;
+	return id;
+}
+
+uint32_t TimelineTraceFile::get_thread_tid()
 {
-	snprintf(desc, sizeof(desc), "%s", desc_);
+	auto &state = get_thread_state();
+	if (!state.tid_valid)
+	{
+		state.tid = intern_string(trace_tid);
+		state.tid_valid = true;
+	}
+	return state.tid;
 }
 
-void TimelineTraceFile::Event::set_tid(const char *tid_)
+void TimelineTraceFile::request_drain()
 {
-	snprintf(tid, sizeof(tid), "%s", tid_);
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		drain_requested = true;
+	}
+	cond.notify_one();
 }
 
-TimelineTraceFile::Event *TimelineTraceFile::begin_event(const char *desc, uint32_t pid)
+void TimelineTraceFile::push_record(const Record &record)
 {
-	auto *e = event_pool.allocate();
-	e->pid = pid;
-	e->set_tid(trace_tid);
-	e->set_desc(desc);
-	e->start_ns = get_current_time_nsecs();
-	return e;
+	auto &state = get_thread_state();
+	auto &ring = *state.ring;
+	uint32_t write_index = ring.write_index.load(std::memory_order_relaxed);
+
+	if (write_index - ring.cached_read_index >= ring.size)
+	{
+		ring.cached_read_index = ring.read_index.load(std::memory_order_acquire);
+
+		// The writer may simply not have been scheduled yet, e.g. when producers saturate every core.
+		// Never block the producer, grow instead. Only drop records once the ring cannot grow any further.
+		if (write_index - ring.cached_read_index >= ring.size)
+		{
+			if (ring.size >= MaxRingSize)
+			{
+				dropped_records.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			auto *grown = new ThreadRing(ring.size * 2);
+			grown->records[0] = record;
+			grown->write_index.store(1, std::memory_order_relaxed);
+			ring.next.store(grown, std::memory_order_release);
+			state.ring = grown;
+			request_drain();
+			return;
+		}
+	}
+
+	ring.records[write_index & (ring.size - 1)] = record;
+	ring.write_index.store(write_index + 1, std::memory_order_release);
+
+	// Wake the writer every half ring rather than letting a burst fill the ring between polls.
+	// This is rare enough that taking the lock is fine, and it avoids a lost wakeup.
+	if (((write_index + 1) & (ring.size / 2 - 1)) == 0)
+		request_drain();
 }
 
-TimelineTraceFile::Event *TimelineTraceFile::allocate_event()
+void TimelineTraceFile::write_event(const char *desc, const char *tid, uint32_t pid, uint64_t start_ns, uint64_t end_ns)
 {
-	auto *e = event_pool.allocate();
-	e->desc[0] = '\0';
-	e->tid[0] = '\0';
-	e->pid = 0;
-	e->start_ns = 0;
-	e->end_ns = 0;
-	return e;
+	Record record = {};
+	record.type = RecordType::Scope;
+	record.desc = intern_string(desc);
+	record.tid = intern_string(tid);
+	record.pid = pid;
+	record.start_ns = start_ns;
+	record.end_ns = end_ns;
+	push_record(record);
 }
 
-void TimelineTraceFile::submit_event(Event *e)
+void TimelineTraceFile::write_counter(const char *desc, uint64_t value, uint32_t pid)
 {
-	std::lock_guard<std::mutex> holder{lock};
-	queued_events.push(e);
-	cond.notify_one();
+	Record record = {};
+	record.type = RecordType::Counter;
+	record.desc = intern_string(desc);
+	record.tid = get_thread_tid();
+	record.pid = pid;
+	record.start_ns = get_current_time_nsecs();
+	record.end_ns = value;
+	push_record(record);
 }
 
-void TimelineTraceFile::end_event(Event *e)
+void TimelineTraceFile::end_scoped_event(const ScopedEvent &event)
 {
-	e->end_ns = get_current_time_nsecs();
-	submit_event(e);
+	Record record = {};
+	record.type = RecordType::Scope;
+	record.desc = event.desc;
+	record.tid = get_thread_tid();
+	record.pid = event.pid;
+	record.start_ns = event.start_ns;
+	record.end_ns = get_current_time_nsecs();
+	push_record(record);
 }
 
-TimelineTraceFile::TimelineTraceFile(const std::string &path)
+TimelineTraceFile::TimelineTraceFile(const std::string &path, uint32_t ring_size_)
 {
+	ring_size = next_pow2(std::min<uint32_t>(std::max<uint32_t>(ring_size_, MinRingSize), MaxRingSize));
+	instance_id = trace_instance_counter.fetch_add(1, std::memory_order_relaxed) + 1;
+	dropped_records.store(0, std::memory_order_relaxed);
 	thr = std::thread(&TimelineTraceFile::looper, this, path);
 }
 
 void TimelineTraceFile::looper(std::string path)
 {
-	set_current_thread_name("json-trace-io");
+	set_current_thread_name("trace-io");
 
-	FILE *file = fopen(path.c_str(), "w");
+	FILE *file = fopen(path.c_str(), "wb");
 	if (!file)
 		LOGE("Failed to open file: %s.\n", path.c_str());
 
 	if (file)
-		fputs("[\n", file);
+	{
+		uint64_t base_ns = get_current_time_nsecs();
+		fwrite(TraceFileMagic, sizeof(TraceFileMagic), 1, file);
+		fwrite(&TraceFileVersion, sizeof(TraceFileVersion), 1, file);
+		fwrite(&base_ns, sizeof(base_ns), 1, file);
+	}
 
-	uint64_t base_ts = get_current_time_nsecs();
+	std::vector<ThreadRing *> active_rings;
+	std::vector<Record> records;
+	std::vector<std::string> new_strings;
+	size_t written_strings = 0;
+	uint64_t reported_dropped = 0;
+	uint64_t last_report_ns = 0;
 
 	for (;;)
 	{
-		Event *e;
+		bool is_dead;
 		{
 			std::unique_lock<std::mutex> holder{lock};
-			cond.wait(holder, [this]() {
-				return !queued_events.empty();
+			cond.wait_for(holder, std::chrono::milliseconds(1), [this]() {
+				return dead || drain_requested;
 			});
-			e = queued_events.front();
-			queued_events.pop();
+			drain_requested = false;
+			is_dead = dead;
+
+			active_rings.clear();
+			for (auto &ring : rings)
+				active_rings.push_back(ring.get());
 		}
 
-		if (!e)
-			break;
+		records.clear();
+		for (size_t ring_index = 0; ring_index < active_rings.size(); ring_index++)
+		{
+			for (;;)
+			{
+				auto *ring = active_rings[ring_index];
 
-		auto start_us = int64_t(e->start_ns - base_ts) * 1e-3;
-		auto end_us = int64_t(e->end_ns - base_ts) * 1e-3;
+				// Once the producer has moved on to a grown ring, it never writes to this one again.
+				// Observing the link first means the write index loaded below is final.
+				auto *next = ring->next.load(std::memory_order_acquire);
+				uint32_t read_index = ring->read_index.load(std::memory_order_relaxed);
+				uint32_t write_index = ring->write_index.load(std::memory_order_acquire);
+				for (uint32_t i = read_index; i != write_index; i++)
+					records.push_back(ring->records[i & (ring->size - 1)]);
+				ring->read_index.store(write_index, std::memory_order_release);
+
+				if (!next)
+					break;
+
+				ring->next.store(nullptr, std::memory_order_relaxed);
+				active_rings[ring_index] = next;
+				std::lock_guard<std::mutex> holder{lock};
+				rings[ring_index].reset(next);
+			}
+		}
 
-		if (file && start_us <= end_us)
+		// Any string referenced by a drained record has been interned before the record was published.
+		new_strings.clear();
 		{
-			fprintf(file, "{ \"name\": \"%s\", \"ph\": \"B\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %f },\n",
-			        e->desc, e->tid, e->pid, start_us);
-			fprintf(file, "{ \"name\": \"%s\", \"ph\": \"E\", \"tid\": \"%s\", \"pid\": \"%u\", \"ts\": %f },\n",
-			        e->desc, e->tid, e->pid, end_us);
+			std::lock_guard<std::mutex> holder{string_lock};
+			new_strings.insert(new_strings.end(), strings.begin() + ptrdiff_t(written_strings), strings.end());
 		}
 
-		event_pool.free(e);
+		if (file && !new_strings.empty())
+		{
+			uint32_t header[2] = { TRACE_CHUNK_STRINGS, uint32_t(new_strings.size()) };
+			fwrite(header, sizeof(header), 1, file);
+			for (auto &str : new_strings)
+			{
+				uint32_t str_header[2] = { uint32_t(written_strings++), uint32_t(str.size()) };
+				fwrite(str_header, sizeof(str_header), 1, file);
+				fwrite(str.data(), 1, str.size(), file);
+			}
+		}
+		else
+			written_strings += new_strings.size();
+
+		if (file && !records.empty())
+		{
+			uint32_t header[2] = { TRACE_CHUNK_RECORDS, uint32_t(records.size()) };
+			fwrite(header, sizeof(header), 1, file);
+			fwrite(records.data(), sizeof(Record), records.size(), file);
+		}
+
+		if (is_dead)
+			break;
+
+		// Report losses while tracing rather than only on shutdown, but at most once a second.
+		auto dropped = dropped_records.load(std::memory_order_relaxed);
+		if (dropped != reported_dropped)
+		{
+			uint64_t current_ns = get_current_time_nsecs();
+			if (current_ns - last_report_ns >= 1000000000ull)
+			{
+				LOGW("Timeline trace dropped %llu records so far, the writer cannot keep up.\n",
+				     static_cast<unsigned long long>(dropped));
+				reported_dropped = dropped;
+				last_report_ns = current_ns;
+			}
+		}
 	}
 
-	// Intentionally truncate the JSON so that we can emit "," after the last element.
 	if (file)
 		fclose(file);
+
+	auto dropped = dropped_records.load(std::memory_order_relaxed);
+	if (dropped)
+		LOGW("Timeline trace dropped %llu records.\n", static_cast<unsigned long long>(dropped));
+}
+
+uint64_t TimelineTraceFile::get_dropped_records() const
+{
+	return dropped_records.load(std::memory_order_relaxed);
 }
 
 TimelineTraceFile::~TimelineTraceFile()
 {
-	submit_event(nullptr);
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		dead = true;
+		cond.notify_one();
+	}
+
 	if (thr.joinable())
 		thr.join();
 }
 
-TimelineTraceFile::ScopedEvent::ScopedEvent(TimelineTraceFile *file_, const char *tag, uint32_t pid)
-	: file(file_)
+static void write_json_string(FILE *file, const std::string &str)
 {
-	if (file && tag && *tag != '\0')
-		event = file->begin_event(tag, pid);
+	fputc('"', file);
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			fputc('\\', file);
+			fputc(c, file);
+		}
+		else if (uint8_t(c) < 0x20)
+			fprintf(file, "\\u%04x", unsigned(uint8_t(c)));
+		else
+			fputc(c, file);
+	}
+	fputc('"', file);
+}
+
+bool TimelineTraceFile::convert_to_json(const std::string &input_path, const std::string &output_path)
+{
+	FILE *input = fopen(input_path.c_str(), "rb");
+	if (!input)
+	{
+		LOGE("Failed to open %s for reading.\n", input_path.c_str());
+		return false;
+	}
+
+	char magic[4];
+	uint32_t version = 0;
+	uint64_t base_ns = 0;
+	if (fread(magic, sizeof(magic), 1, input) != 1 ||
+	    fread(&version, sizeof(version), 1, input) != 1 ||
+	    fread(&base_ns, sizeof(base_ns), 1, input) != 1 ||
+	    memcmp(magic, TraceFileMagic, sizeof(magic)) != 0 ||
+	    version != TraceFileVersion)
+	{
+		LOGE("%s is not a valid timeline trace.\n", input_path.c_str());
+		fclose(input);
+		return false;
+	}
+
+	FILE *output = fopen(output_path.c_str(), "w");
+	if (!output)
+	{
+		LOGE("Failed to open %s for writing.\n", output_path.c_str());
+		fclose(input);
+		return false;
+	}
+
+	std::vector<std::string> strings;
+	std::vector<Record> records;
+	bool first = true;
+	bool success = true;
+
+	const auto get_string = [&](uint32_t id) -> const std::string & {
+		static const std::string empty;
+		return id < strings.size() ? strings[id] : empty;
+	};
+
+	fputs("[\n", output);
+
+	uint32_t header[2];
+	while (fread(header, sizeof(header), 1, input) == 1)
+	{
+		if (header[0] == TRACE_CHUNK_STRINGS)
+		{
+			for (uint32_t i = 0; i < header[1]; i++)
+			{
+				uint32_t str_header[2];
+				if (fread(str_header, sizeof(str_header), 1, input) != 1)
+				{
+					success = false;
+					break;
+				}
+
+				std::string str(str_header[1], '\0');
+				if (str_header[1] && fread(&str[0], 1, str.size(), input) != str.size())
+				{
+					success = false;
+					break;
+				}
+
+				if (str_header[0] >= strings.size())
+					strings.resize(str_header[0] + 1);
+				strings[str_header[0]] = std::move(str);
+			}
+		}
+		else if (header[0] == TRACE_CHUNK_RECORDS)
+		{
+			records.resize(header[1]);
+			if (fread(records.data(), sizeof(Record), records.size(), input) != records.size())
+			{
+				success = false;
+				break;
+			}
+
+			for (auto &record : records)
+			{
+				double start_us = 1e-3 * double(int64_t(record.start_ns - base_ns));
+
+				if (!first)
+					fputs(",\n", output);
+				first = false;
+
+				fputs("{ \"name\": ", output);
+				write_json_string(output, get_string(record.desc));
+
+				if (record.type == RecordType::Counter)
+				{
+					fprintf(output, ", \"ph\": \"C\", \"pid\": \"%u\", \"ts\": %.3f, \"args\": { \"value\": %llu } }",
+					        record.pid, start_us, static_cast<unsigned long long>(record.end_ns));
+				}
+				else
+				{
+					double dur_us = record.end_ns >= record.start_ns ? 1e-3 * double(record.end_ns - record.start_ns) : 0.0;
+					fputs(", \"ph\": \"X\", \"tid\": ", output);
+					write_json_string(output, get_string(record.tid));
+					fprintf(output, ", \"pid\": \"%u\", \"ts\": %.3f, \"dur\": %.3f }", record.pid, start_us, dur_us);
+				}
+			}
+		}
+		else
+		{
+			success = false;
+		}
+
+		if (!success)
+			break;
+	}
+
+	fputs("\n]\n", output);
+
+	if (!success)
+		LOGE("Timeline trace %s is truncated or corrupt.\n", input_path.c_str());
+
+	fclose(input);
+	fclose(output);
+	return success;
+}
+
+TimelineTraceFile::ScopedEvent::ScopedEvent(TimelineTraceFile *file_, const char *tag, uint32_t pid_)
+{
+	if (file_ && tag && *tag != '\0')
+	{
+		file = file_;
+		desc = file->intern_string(tag);
+		pid = pid_;
+		start_ns = get_current_time_nsecs();
+	}
 }
 
 TimelineTraceFile::ScopedEvent::~ScopedEvent()
 {
-	if (event)
-		file->end_event(event);
+	if (file)
+		file->end_scoped_event(*this);
 }
 
 TimelineTraceFile::ScopedEvent &
@@ -168,11 +564,12 @@ TimelineTraceFile::ScopedEvent::operator=(TimelineTraceFile::ScopedEvent &&other
 {
 	if (this != &other)
 	{
-		if (event)
-			file->end_event(event);
-		event = other.event;
+		if (file)
+			file->end_scoped_event(*this);
 		file = other.file;
-		other.event = nullptr;
+		start_ns = other.start_ns;
+		desc = other.desc;
+		pid = other.pid;
 		other.file = nullptr;
 	}
 	return *this;
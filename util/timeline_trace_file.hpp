@@ -27,36 +27,57 @@
 #include <condition_variable>
 #include <mutex>
 #include <memory>
-#include <queue>
-#include "object_pool.hpp"
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+#include "hashmap.hpp"
 
 namespace Util
 {
+// Records are written to per-thread SPSC ring buffers without locking and drained by a writer thread
+// into a compact binary file. Strings are interned once and referenced by ID.
+// Use convert_to_json() (or the timeline-trace-convert tool) to get a Chrome / Perfetto compatible trace.
 class TimelineTraceFile
 {
 public:
-	explicit TimelineTraceFile(const std::string &path);
+	// Initial records per thread ring, rounded up to a power of two.
+	// A ring which fills up before the writer drains it grows, up to MaxRingSize, after which records are dropped.
+	static constexpr uint32_t DefaultRingSize = 8 * 1024;
+	static constexpr uint32_t MinRingSize = 64;
+	static constexpr uint32_t MaxRingSize = 1024 * 1024;
+
+	explicit TimelineTraceFile(const std::string &path, uint32_t ring_size = DefaultRingSize);
 	~TimelineTraceFile();
 
 	static void set_tid(const char *tid);
 	static TimelineTraceFile *get_per_thread();
 	static void set_per_thread(TimelineTraceFile *file);
 
-	struct Event
+	enum class RecordType : uint32_t
 	{
-		char desc[256];
-		char tid[32];
-		uint32_t pid;
-		uint64_t start_ns, end_ns;
+		Scope = 0,
+		Counter = 1
+	};
 
-		void set_desc(const char *desc);
-		void set_tid(const char *tid);
+	struct Record
+	{
+		uint64_t start_ns;
+		// For counters, this is the counter value.
+		uint64_t end_ns;
+		uint32_t desc;
+		uint32_t tid;
+		uint32_t pid;
+		RecordType type;
 	};
-	Event *begin_event(const char *desc, uint32_t pid = 0);
-	void end_event(Event *e);
+	static_assert(sizeof(Record) == 32, "Unexpected size of Record.");
+
+	// Interning is lock-free after a string has been seen once on a thread.
+	uint32_t intern_string(const char *str);
 
-	Event *allocate_event();
-	void submit_event(Event *e);
+	// Records a complete event with explicit timeline. Used for events which are not scoped on the CPU,
+	// e.g. GPU timestamps.
+	void write_event(const char *desc, const char *tid, uint32_t pid, uint64_t start_ns, uint64_t end_ns);
+	void write_counter(const char *desc, uint64_t value, uint32_t pid = 0);
 
 	struct ScopedEvent
 	{
@@ -68,17 +89,42 @@ public:
 		ScopedEvent(ScopedEvent &&other) noexcept;
 		ScopedEvent &operator=(ScopedEvent &&other) noexcept;
 		TimelineTraceFile *file = nullptr;
-		Event *event = nullptr;
+		uint64_t start_ns = 0;
+		uint32_t desc = 0;
+		uint32_t pid = 0;
 	};
 
+	static bool convert_to_json(const std::string &input_path, const std::string &output_path);
+
+	// Records which were lost because a ring was full when they were pushed.
+	uint64_t get_dropped_records() const;
+
 private:
+	struct ThreadRing;
+	struct ThreadState;
+	static thread_local ThreadState thread_state;
+
+	ThreadState &get_thread_state();
+	uint32_t get_thread_tid();
+	void push_record(const Record &record);
+	void request_drain();
+	void end_scoped_event(const ScopedEvent &event);
+
 	void looper(std::string path);
 	std::thread thr;
 	std::mutex lock;
 	std::condition_variable cond;
+	bool dead = false;
+	bool drain_requested = false;
+	std::vector<std::unique_ptr<ThreadRing>> rings;
+
+	std::mutex string_lock;
+	std::vector<std::string> strings;
+	HashMap<uint32_t> string_ids;
 
-	ThreadSafeObjectPool<Event> event_pool;
-	std::queue<Event *> queued_events;
+	uint64_t instance_id;
+	uint32_t ring_size;
+	std::atomic_uint64_t dropped_records;
 };
 
 #ifndef GRANITE_SHIPPING
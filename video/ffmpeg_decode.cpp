@@ -35,10 +35,13 @@
 #include "timeline_trace_file.hpp"
 #include "timer.hpp"
 #include "thread_name.hpp"
+#include "intrusive.hpp"
 #include <condition_variable>
 #include <mutex>
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <string>
 #ifdef HAVE_GRANITE_AUDIO
 #include "audio_mixer.hpp"
 #include "dsp/dsp.hpp"
@@ -52,6 +55,7 @@ extern "C"
 #include <libavutil/avutil.h>
 #include <libavutil/channel_layout.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 #ifdef HAVE_FFMPEG_VULKAN
 #include <libavutil/hwcontext_vulkan.h>
 #endif
@@ -81,6 +85,181 @@ static void free_av_objects(CodecStream &stream)
 		avcodec_free_context(&stream.av_ctx);
 }
 
+// Software decoders write their frames straight into persistently mapped, GPU visible buffers,
+// so planes can be copied into images on the GPU rather than going through a CPU staging copy.
+// Every AVBuffer handed out holds a reference, so the allocator outlives the codec context if need be.
+struct HostFrameAllocator : Util::ThreadSafeIntrusivePtrEnabled<HostFrameAllocator>
+{
+	explicit HostFrameAllocator(Vulkan::Device &device);
+
+	struct Block
+	{
+		HostFrameAllocator *allocator;
+		Vulkan::BufferHandle buffer;
+		uint8_t *host;
+		size_t size;
+	};
+
+	Block *allocate_block(size_t size);
+	void free_block(Block *block);
+	// Returns nullptr if the frame was not allocated here.
+	const Block *find_block(const AVFrame *frame);
+
+	static int get_buffer2(AVCodecContext *ctx, AVFrame *frame, int flags);
+	static void free_buffer(void *opaque, uint8_t *data);
+
+	// Covers SIMD alignment of decoders as well as copy offset and row length requirements.
+	enum { FrameAlignment = 64 };
+
+	Vulkan::Device &device;
+	std::mutex lock;
+	std::vector<std::unique_ptr<Block>> blocks;
+	std::vector<Block *> free_blocks;
+};
+
+HostFrameAllocator::HostFrameAllocator(Vulkan::Device &device_)
+	: device(device_)
+{
+}
+
+HostFrameAllocator::Block *HostFrameAllocator::allocate_block(size_t size)
+{
+	std::lock_guard<std::mutex> holder{lock};
+
+	for (auto itr = free_blocks.begin(); itr != free_blocks.end(); ++itr)
+	{
+		if ((*itr)->size >= size)
+		{
+			auto *block = *itr;
+			free_blocks.erase(itr);
+			return block;
+		}
+	}
+
+	// Frame size went up, the smaller blocks won't be useful anymore.
+	for (auto *block : free_blocks)
+	{
+		auto itr = std::find_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<Block> &b) {
+			return b.get() == block;
+		});
+		blocks.erase(itr);
+	}
+	free_blocks.clear();
+
+	Vulkan::BufferCreateInfo info = {};
+	info.size = size;
+	// Decoders read back reference frames, so this must not end up as write-combined memory.
+	info.domain = Vulkan::BufferDomain::CachedCoherentHostPreferCached;
+	info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	auto buffer = device.create_buffer(info);
+	if (!buffer)
+		return nullptr;
+
+	auto *host = static_cast<uint8_t *>(device.map_host_buffer(
+			*buffer, Vulkan::MEMORY_ACCESS_READ_BIT | Vulkan::MEMORY_ACCESS_WRITE_BIT));
+	if (!host)
+		return nullptr;
+
+	std::unique_ptr<Block> block{new Block};
+	block->allocator = this;
+	block->buffer = std::move(buffer);
+	block->host = host;
+	block->size = size;
+	blocks.push_back(std::move(block));
+	return blocks.back().get();
+}
+
+void HostFrameAllocator::free_block(Block *block)
+{
+	std::lock_guard<std::mutex> holder{lock};
+	free_blocks.push_back(block);
+}
+
+const HostFrameAllocator::Block *HostFrameAllocator::find_block(const AVFrame *frame)
+{
+	if (!frame->buf[0] || frame->buf[1])
+		return nullptr;
+
+	auto *opaque = av_buffer_get_opaque(frame->buf[0]);
+	std::lock_guard<std::mutex> holder{lock};
+	for (auto &block : blocks)
+		if (block.get() == opaque)
+			return block.get();
+	return nullptr;
+}
+
+void HostFrameAllocator::free_buffer(void *opaque, uint8_t *)
+{
+	auto *block = static_cast<Block *>(opaque);
+	auto *allocator = block->allocator;
+	allocator->free_block(block);
+	allocator->release_reference();
+}
+
+int HostFrameAllocator::get_buffer2(AVCodecContext *ctx, AVFrame *frame, int flags)
+{
+	auto *allocator = static_cast<HostFrameAllocator *>(ctx->opaque);
+	auto fmt = static_cast<AVPixelFormat>(frame->format);
+	auto *desc = av_pix_fmt_desc_get(fmt);
+
+	if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL)) != 0)
+		return avcodec_default_get_buffer2(ctx, frame, flags);
+
+	int width = frame->width;
+	int height = frame->height;
+	int linesize_align[AV_NUM_DATA_POINTERS];
+	avcodec_align_dimensions2(ctx, &width, &height, linesize_align);
+
+	int linesizes[4];
+	if (av_image_fill_linesizes(linesizes, fmt, width) < 0)
+		return avcodec_default_get_buffer2(ctx, frame, flags);
+
+	ptrdiff_t aligned_linesizes[4];
+	for (int i = 0; i < 4; i++)
+		aligned_linesizes[i] = (linesizes[i] + FrameAlignment - 1) & ~ptrdiff_t(FrameAlignment - 1);
+
+	size_t plane_sizes[4];
+	if (av_image_fill_plane_sizes(plane_sizes, fmt, height, aligned_linesizes) < 0)
+		return avcodec_default_get_buffer2(ctx, frame, flags);
+
+	// Planes are padded since decoders may read a little past the end.
+	const auto padded_plane_size = [](size_t plane_size) {
+		return (plane_size + AV_INPUT_BUFFER_PADDING_SIZE + FrameAlignment - 1) & ~size_t(FrameAlignment - 1);
+	};
+
+	// Mapped pointers are not necessarily aligned to what decoders want.
+	size_t total_size = FrameAlignment;
+	for (auto plane_size : plane_sizes)
+		if (plane_size)
+			total_size += padded_plane_size(plane_size);
+
+	auto *block = allocator->allocate_block(total_size);
+	if (!block)
+		return avcodec_default_get_buffer2(ctx, frame, flags);
+
+	frame->buf[0] = av_buffer_create(block->host, block->size, free_buffer, block, 0);
+	if (!frame->buf[0])
+	{
+		allocator->free_block(block);
+		return AVERROR(ENOMEM);
+	}
+	allocator->add_reference();
+
+	auto *ptr = reinterpret_cast<uint8_t *>(
+			(reinterpret_cast<uintptr_t>(block->host) + FrameAlignment - 1) & ~uintptr_t(FrameAlignment - 1));
+
+	for (int i = 0; i < 4 && plane_sizes[i]; i++)
+	{
+		frame->data[i] = ptr;
+		frame->linesize[i] = int(aligned_linesizes[i]);
+		ptr += padded_plane_size(plane_sizes[i]);
+	}
+	frame->extended_data = frame->data;
+
+	return 0;
+}
+
 #ifdef HAVE_GRANITE_AUDIO
 struct AVFrameRingStream final : Audio::MixerStream, Util::ThreadSafeIntrusivePtrEnabled<AVFrameRingStream>
 {
@@ -503,6 +682,10 @@ struct VideoDecoder::Impl
 		double pts = 0.0;
 		uint64_t done_ts = 0;
 		ImageState state = ImageState::Idle;
+
+		// Decoded frame which the transfer reads from directly, kept alive until the fence signals.
+		AVFrame *host_frame = nullptr;
+		Vulkan::Fence host_frame_fence;
 	};
 	std::vector<DecodedImage> video_queue;
 	uint64_t idle_timestamps = 0;
@@ -560,11 +743,16 @@ struct VideoDecoder::Impl
 	void process_video_frame_in_task(unsigned frame, AVFrame *av_frame);
 
 	void dispatch_conversion(Vulkan::CommandBuffer &cmd, DecodedImage &img, const Vulkan::ImageView * const *views);
-	void process_video_frame_in_task_upload(DecodedImage &img, AVFrame *av_frame, Vulkan::Semaphore &compute_to_user);
+	bool process_video_frame_in_task_upload(unsigned frame, AVFrame *av_frame);
+	void release_host_frame(DecodedImage &img, bool wait);
+
+	Util::IntrusivePtr<HostFrameAllocator> host_frames;
 #ifdef HAVE_FFMPEG_VULKAN
 	void process_video_frame_in_task_vulkan(DecodedImage &img, AVFrame *av_frame, Vulkan::Semaphore &compute_to_user);
 #endif
 
+	void complete_video_frame(unsigned frame);
+
 	void flush_codecs();
 
 	struct UBO
@@ -579,6 +767,28 @@ struct VideoDecoder::Impl
 	};
 	UBO ubo = {};
 
+	// Snapshot of the conversion setup, since a batched conversion may be recorded
+	// after a later upload task has reconfigured the planes.
+	struct ConversionState
+	{
+		Vulkan::Program *program;
+		UBO ubo;
+		unsigned num_planes;
+		AVColorSpace color_space;
+		AVPixelFormat pix_fmt;
+	};
+	ConversionState get_conversion_state() const;
+
+	// The conversion is split into phases so the pool can batch barriers and dispatches
+	// of many frames into one command buffer.
+	VkImageMemoryBarrier2 get_conversion_pre_barrier(const DecodedImage &img, const ConversionState &state) const;
+	void record_conversion(Vulkan::CommandBuffer &cmd, const DecodedImage &img,
+	                       const Vulkan::ImageView * const *views, const ConversionState &state) const;
+	// Returns false if the post barrier is part of mipmap generation, see record_conversion_mipgen().
+	bool get_conversion_post_barrier(const DecodedImage &img, const ConversionState &state,
+	                                 VkImageMemoryBarrier2 &barrier) const;
+	void record_conversion_mipgen(Vulkan::CommandBuffer &cmd, const DecodedImage &img) const;
+
 	// The decoding thread.
 	std::thread decode_thread;
 	std::condition_variable cond;
@@ -593,6 +803,21 @@ struct VideoDecoder::Impl
 	void thread_main();
 	bool iterate();
 	bool should_iterate_locked();
+	int get_sleep_ms_locked();
+	void wake_decoder_locked();
+	bool is_decoding() const;
+
+	// Pooled decoding. pool is set for the duration of a play() / stop() cycle.
+	VideoDecoderPool::Impl *pool = nullptr;
+	bool pool_active = false;
+	// Only accessed under the pool lock. Workers hold a reference while polling the decoder outside of it.
+	bool pool_busy = false;
+	unsigned pool_refs = 0;
+	// The playback position as observed through acquire.
+	double last_acquired_pts = -1.0;
+	double get_video_buffered_ahead_locked() const;
+	bool poll_pooled_iteration(double &slack, int &sleep_ms);
+	void run_pooled_iteration();
 
 	void init_yuv_to_rgb();
 	void setup_yuv_format_planes();
@@ -622,6 +847,46 @@ struct VideoDecoder::Impl
 	Granite::Global::GlobalManagersHandle managers;
 };
 
+struct VideoDecoderPool::Impl
+{
+	explicit Impl(unsigned num_threads);
+	~Impl();
+
+	std::vector<std::thread> workers;
+	std::condition_variable cond;
+	std::condition_variable idle_cond;
+	std::mutex lock;
+	std::vector<VideoDecoder::Impl *> decoders;
+	uint64_t wake_count = 0;
+	bool dead = false;
+	Granite::Global::GlobalManagersHandle managers;
+
+	// Lock order: A decoder lock may be held when taking the pool lock, never the other way around.
+	void add(VideoDecoder::Impl *decoder);
+	void remove(VideoDecoder::Impl *decoder);
+	void kick();
+	void worker_main(unsigned index);
+
+	struct PendingConversion
+	{
+		VideoDecoder::Impl *decoder;
+		unsigned frame;
+		VideoDecoder::Impl::ConversionState state;
+		Vulkan::ImageHandle planes[3];
+		Vulkan::Semaphore transfer_to_compute;
+	};
+
+	std::mutex conversion_lock;
+	// Flushes must complete in order, since frames of a decoder are signalled in order.
+	std::mutex conversion_flush_lock;
+	std::vector<PendingConversion> pending_conversions;
+	bool conversion_flush_queued = false;
+
+	void enqueue_conversion(VideoDecoder::Impl *decoder, unsigned frame, Vulkan::Semaphore transfer_to_compute);
+	void flush_conversions();
+	void flush_conversion_batch(PendingConversion * const *batch, size_t count);
+};
+
 int VideoDecoder::Impl::find_idle_decode_video_frame_locked() const
 {
 	int best_index = -1;
@@ -1059,6 +1324,15 @@ bool VideoDecoder::Impl::init_video_decoder_post_device()
 	if (!hw.init_codec_context(video.av_codec, device, video.av_ctx, opts.hwdevice))
 		LOGW("Failed to init hardware decode context. Falling back to software.\n");
 
+	// The opaque pointer is only needed by the hardware device's get_format.
+	if (hw.get_hw_device_type() == AV_HWDEVICE_TYPE_NONE &&
+	    (video.av_codec->capabilities & AV_CODEC_CAP_DR1) != 0)
+	{
+		host_frames = Util::make_handle<HostFrameAllocator>(*device);
+		video.av_ctx->opaque = host_frames.get();
+		video.av_ctx->get_buffer2 = HostFrameAllocator::get_buffer2;
+	}
+
 	if (avcodec_open2(video.av_ctx, video.av_codec, nullptr) < 0)
 	{
 		LOGE("Failed to open codec.\n");
@@ -1447,74 +1721,146 @@ void VideoDecoder::Impl::process_video_frame_in_task_vulkan(DecodedImage &img, A
 }
 #endif
 
-void VideoDecoder::Impl::dispatch_conversion(Vulkan::CommandBuffer &cmd, DecodedImage &img, const Vulkan::ImageView *const *views)
+static VkImageMemoryBarrier2 make_image_barrier(const Vulkan::Image &image,
+                                                VkImageLayout old_layout, VkImageLayout new_layout,
+                                                VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access,
+                                                VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access)
+{
+	VkImageMemoryBarrier2 b = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2 };
+	b.srcAccessMask = src_access;
+	b.dstAccessMask = dst_access;
+	b.oldLayout = old_layout;
+	b.newLayout = new_layout;
+	b.image = image.get_image();
+	b.subresourceRange.aspectMask = Vulkan::format_to_aspect_mask(image.get_create_info().format);
+	b.subresourceRange.levelCount = image.get_create_info().levels;
+	b.subresourceRange.layerCount = image.get_create_info().layers;
+	b.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	b.srcStageMask = src_stages;
+	b.dstStageMask = dst_stages;
+	return b;
+}
+
+VideoDecoder::Impl::ConversionState VideoDecoder::Impl::get_conversion_state() const
 {
-	if (num_planes)
+	return { program, ubo, num_planes, active_color_space, active_upload_pix_fmt };
+}
+
+VkImageMemoryBarrier2 VideoDecoder::Impl::get_conversion_pre_barrier(
+		const DecodedImage &img, const ConversionState &state) const
+{
+	if (state.num_planes)
+	{
+		return make_image_barrier(*img.rgb_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+		                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+	}
+	else
+	{
+		return make_image_barrier(*img.rgb_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		                          VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+}
+
+void VideoDecoder::Impl::record_conversion(Vulkan::CommandBuffer &cmd, const DecodedImage &img,
+                                           const Vulkan::ImageView *const *views,
+                                           const ConversionState &state) const
+{
+	if (state.num_planes)
 	{
 		cmd.set_storage_texture(0, 0, *img.rgb_storage_view);
 
-		for (unsigned i = 0; i < num_planes; i++)
+		for (unsigned i = 0; i < state.num_planes; i++)
 		{
 			cmd.set_texture(0, 1 + i, *views[i],
 			                i == 0 ? Vulkan::StockSampler::NearestClamp : Vulkan::StockSampler::LinearClamp);
 		}
-		for (unsigned i = num_planes; i < 3; i++)
+		for (unsigned i = state.num_planes; i < 3; i++)
 			cmd.set_texture(0, 1 + i, *views[0], Vulkan::StockSampler::NearestClamp);
 
-		cmd.set_program(program);
+		cmd.set_program(state.program);
 
 		cmd.set_specialization_constant_mask(7u);
-		cmd.set_specialization_constant(0, uint32_t(active_color_space != AVCOL_SPC_BT709));
-		cmd.set_specialization_constant(1, num_planes);
-		cmd.set_specialization_constant(2, uint32_t(active_upload_pix_fmt == AV_PIX_FMT_NV21));
-
-		memcpy(cmd.allocate_typed_constant_data<UBO>(1, 0, 1), &ubo, sizeof(ubo));
+		cmd.set_specialization_constant(0, uint32_t(state.color_space != AVCOL_SPC_BT709));
+		cmd.set_specialization_constant(1, state.num_planes);
+		cmd.set_specialization_constant(2, uint32_t(state.pix_fmt == AV_PIX_FMT_NV21));
 
-		cmd.image_barrier(*img.rgb_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-		                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
-		                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
-		cmd.dispatch((ubo.resolution.x + 7) / 8, (ubo.resolution.y + 7) / 8, 1);
-
-		if (opts.mipgen)
-		{
-			cmd.barrier_prepare_generate_mipmap(*img.rgb_image, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			                                    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, true);
-			cmd.generate_mipmap(*img.rgb_image);
-			cmd.image_barrier(*img.rgb_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			                  VK_PIPELINE_STAGE_2_BLIT_BIT, 0,
-			                  VK_PIPELINE_STAGE_NONE, 0);
-		}
-		else
-		{
-			cmd.image_barrier(*img.rgb_image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
-			                  VK_PIPELINE_STAGE_NONE, 0);
-		}
+		memcpy(cmd.allocate_typed_constant_data<UBO>(1, 0, 1), &state.ubo, sizeof(state.ubo));
+		cmd.dispatch((state.ubo.resolution.x + 7) / 8, (state.ubo.resolution.y + 7) / 8, 1);
 	}
 	else
 	{
 		// Fallback, just clear to magenta to make it obvious what went wrong.
-		cmd.image_barrier(*img.rgb_image,
-		                  VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
-		                  VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
-
 		VkClearValue color = {};
 		color.color.float32[0] = 1.0f;
 		color.color.float32[2] = 1.0f;
 		color.color.float32[3] = 1.0f;
 		cmd.clear_image(*img.rgb_image, color);
-		cmd.image_barrier(*img.rgb_image,
-		                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-		                  VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
-		                  VK_PIPELINE_STAGE_NONE, 0);
 	}
 }
 
-void VideoDecoder::Impl::process_video_frame_in_task_upload(DecodedImage &img, AVFrame *av_frame,
-                                                            Vulkan::Semaphore &compute_to_user)
+bool VideoDecoder::Impl::get_conversion_post_barrier(const DecodedImage &img, const ConversionState &state,
+                                                     VkImageMemoryBarrier2 &barrier) const
 {
+	if (!state.num_planes)
+	{
+		barrier = make_image_barrier(*img.rgb_image,
+		                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                             VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		                             VK_PIPELINE_STAGE_NONE, 0);
+		return true;
+	}
+	else if (opts.mipgen)
+	{
+		return false;
+	}
+	else
+	{
+		barrier = make_image_barrier(*img.rgb_image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		                             VK_PIPELINE_STAGE_NONE, 0);
+		return true;
+	}
+}
+
+void VideoDecoder::Impl::record_conversion_mipgen(Vulkan::CommandBuffer &cmd, const DecodedImage &img) const
+{
+	cmd.barrier_prepare_generate_mipmap(*img.rgb_image, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                                    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, true);
+	cmd.generate_mipmap(*img.rgb_image);
+	cmd.image_barrier(*img.rgb_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                  VK_PIPELINE_STAGE_2_BLIT_BIT, 0,
+	                  VK_PIPELINE_STAGE_NONE, 0);
+}
+
+void VideoDecoder::Impl::dispatch_conversion(Vulkan::CommandBuffer &cmd, DecodedImage &img, const Vulkan::ImageView *const *views)
+{
+	auto state = get_conversion_state();
+
+	auto pre_barrier = get_conversion_pre_barrier(img, state);
+	cmd.image_barriers(1, &pre_barrier);
+
+	record_conversion(cmd, img, views, state);
+
+	VkImageMemoryBarrier2 post_barrier;
+	if (get_conversion_post_barrier(img, state, post_barrier))
+		cmd.image_barriers(1, &post_barrier);
+	else
+		record_conversion_mipgen(cmd, img);
+}
+
+bool VideoDecoder::Impl::process_video_frame_in_task_upload(unsigned frame, AVFrame *av_frame)
+{
+	auto &img = video_queue[frame];
+
+	// The previous transfer from this slot is long done by now.
+	release_host_frame(img, true);
+	for (auto &queued : video_queue)
+		release_host_frame(queued, false);
+
 	for (unsigned i = 0; i < num_planes; i++)
 	{
 		auto &plane = img.planes[i];
@@ -1553,15 +1899,49 @@ void VideoDecoder::Impl::process_video_frame_in_task_upload(DecodedImage &img, A
 		                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
 	}
 
-	for (unsigned i = 0; i < num_planes; i++)
+	const HostFrameAllocator::Block *host_block = nullptr;
+	if (host_frames && av_frame)
+		host_block = host_frames->find_block(av_frame);
+
+	VkDeviceSize plane_offsets[3] = {};
+	for (unsigned i = 0; host_block && i < num_planes; i++)
 	{
-		auto *buf = static_cast<uint8_t *>(cmd->update_image(*img.planes[i]));
-		int byte_width = int(img.planes[i]->get_width());
-		byte_width *= int(Vulkan::TextureFormatLayout::format_block_size(plane_formats[i], VK_IMAGE_ASPECT_COLOR_BIT));
+		auto block_size = Vulkan::TextureFormatLayout::format_block_size(plane_formats[i], VK_IMAGE_ASPECT_COLOR_BIT);
+		auto offset = VkDeviceSize(av_frame->data[i] - host_block->host);
 
-		av_image_copy_plane(buf, byte_width,
-		                    av_frame->data[i], av_frame->linesize[i],
-		                    byte_width, int(img.planes[i]->get_height()));
+		// Cropping may leave planes where the transfer cannot read them from.
+		if ((offset & 3) != 0 || av_frame->linesize[i] <= 0 || (av_frame->linesize[i] % block_size) != 0)
+			host_block = nullptr;
+		else
+			plane_offsets[i] = offset;
+	}
+
+	if (host_block)
+	{
+		// The decoder wrote directly into GPU visible memory. Flushes if memory ended up non-coherent.
+		device->unmap_host_buffer(*host_block->buffer, Vulkan::MEMORY_ACCESS_WRITE_BIT);
+
+		for (unsigned i = 0; i < num_planes; i++)
+		{
+			auto block_size = Vulkan::TextureFormatLayout::format_block_size(plane_formats[i], VK_IMAGE_ASPECT_COLOR_BIT);
+			cmd->copy_buffer_to_image(*img.planes[i], *host_block->buffer, plane_offsets[i],
+			                          {}, { img.planes[i]->get_width(), img.planes[i]->get_height(), 1 },
+			                          unsigned(av_frame->linesize[i]) / block_size, 0,
+			                          { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 });
+		}
+	}
+	else
+	{
+		for (unsigned i = 0; i < num_planes; i++)
+		{
+			auto *buf = static_cast<uint8_t *>(cmd->update_image(*img.planes[i]));
+			int byte_width = int(img.planes[i]->get_width());
+			byte_width *= int(Vulkan::TextureFormatLayout::format_block_size(plane_formats[i], VK_IMAGE_ASPECT_COLOR_BIT));
+
+			av_image_copy_plane(buf, byte_width,
+			                    av_frame->data[i], av_frame->linesize[i],
+			                    byte_width, int(img.planes[i]->get_height()));
+		}
 	}
 
 	for (unsigned i = 0; i < num_planes; i++)
@@ -1572,7 +1952,23 @@ void VideoDecoder::Impl::process_video_frame_in_task_upload(DecodedImage &img, A
 		                   VK_PIPELINE_STAGE_NONE, 0);
 	}
 
-	device->submit(cmd, nullptr, 1, &transfer_to_compute);
+	if (host_block)
+	{
+		// Keep the frame's buffer away from the decoder until the transfer has consumed it.
+		Vulkan::Fence fence;
+		device->submit(cmd, &fence, 1, &transfer_to_compute);
+		img.host_frame = av_frame_clone(av_frame);
+		img.host_frame_fence = std::move(fence);
+	}
+	else
+		device->submit(cmd, nullptr, 1, &transfer_to_compute);
+
+	// The pool records conversions of all its streams into shared submissions.
+	if (pool)
+	{
+		pool->enqueue_conversion(this, frame, std::move(transfer_to_compute));
+		return true;
+	}
 
 	auto conversion_queue = opts.mipgen ?
 	                        Vulkan::CommandBuffer::Type::Generic :
@@ -1591,7 +1987,7 @@ void VideoDecoder::Impl::process_video_frame_in_task_upload(DecodedImage &img, A
 
 	dispatch_conversion(*cmd, img, views);
 
-	device->submit(cmd, nullptr, 1, &compute_to_user);
+	device->submit(cmd, nullptr, 1, &img.sem_to_client);
 
 	// When running in realtime mode we will run
 	// completely unlocked from the main loop, so make sure
@@ -1599,6 +1995,22 @@ void VideoDecoder::Impl::process_video_frame_in_task_upload(DecodedImage &img, A
 	// In that scenario the main thread will not pump frame contexts regularly.
 	if (opts.realtime)
 		device->next_frame_context_in_async_thread();
+
+	return false;
+}
+
+void VideoDecoder::Impl::release_host_frame(DecodedImage &img, bool wait)
+{
+	if (!img.host_frame)
+		return;
+
+	if (wait)
+		img.host_frame_fence->wait();
+	else if (!img.host_frame_fence->wait_timeout(0))
+		return;
+
+	av_frame_free(&img.host_frame);
+	img.host_frame_fence.reset();
 }
 
 void VideoDecoder::Impl::process_video_frame_in_task(unsigned frame, AVFrame *av_frame)
@@ -1682,6 +2094,8 @@ void VideoDecoder::Impl::process_video_frame_in_task(unsigned frame, AVFrame *av
 			setup_yuv_format_planes();
 	}
 
+	bool deferred = false;
+
 #ifdef HAVE_FFMPEG_VULKAN
 	if (av_frame && av_frame->format == AV_PIX_FMT_VULKAN && video.av_ctx->hw_frames_ctx)
 	{
@@ -1690,17 +2104,31 @@ void VideoDecoder::Impl::process_video_frame_in_task(unsigned frame, AVFrame *av
 	else
 #endif
 	{
-		process_video_frame_in_task_upload(img, av_frame, img.sem_to_client);
+		deferred = process_video_frame_in_task_upload(frame, av_frame);
 	}
 
 	if (av_frame)
 		av_frame_free(&av_frame);
 
-	// Can now acquire.
-	std::lock_guard<std::mutex> holder{lock};
-	img.state = ImageState::Ready;
-	img.done_ts = Util::get_current_time_nsecs();
-	cond.notify_all();
+	// If the conversion was handed over to the pool, it completes the frame.
+	if (!deferred)
+		complete_video_frame(frame);
+}
+
+void VideoDecoder::Impl::complete_video_frame(unsigned frame)
+{
+	{
+		// Can now acquire.
+		std::lock_guard<std::mutex> holder{lock};
+		auto &img = video_queue[frame];
+		img.state = ImageState::Ready;
+		img.done_ts = Util::get_current_time_nsecs();
+		cond.notify_all();
+	}
+
+	// Pooled conversions may complete after the upload task, so the counter is signalled explicitly.
+	if (pool)
+		video_upload_signal.signal_increment();
 }
 
 void VideoDecoder::Impl::process_video_frame(AVFrame *av_frame)
@@ -1720,7 +2148,9 @@ void VideoDecoder::Impl::process_video_frame(AVFrame *av_frame)
 	});
 	task->set_desc("ffmpeg-decode-upload");
 	task->set_task_class(TaskClass::Background);
-	task->set_fence_counter_signal(&video_upload_signal);
+	// Pooled decoders signal from complete_video_frame() instead.
+	if (!pool)
+		task->set_fence_counter_signal(&video_upload_signal);
 
 	// Need to make sure upload tasks are ordered to ensure that frames
 	// are acquired in order.
@@ -2002,11 +2432,51 @@ bool VideoDecoder::Impl::should_iterate_locked()
 	if (acquire_blocking)
 		return true;
 
+	// Pooled decoders share their threads with other streams,
+	// so don't decode further ahead of the playback position than needed.
+	if (pool && get_video_buffered_ahead_locked() >= double(opts.target_video_buffer_time))
+		return false;
+
 	// We're in a happy state where we only desire progress if there is anything
 	// meaningful to do.
 	return find_idle_decode_video_frame_locked() >= 0;
 }
 
+double VideoDecoder::Impl::get_video_buffered_ahead_locked() const
+{
+	// Until the first acquire we have no idea where playback is, so fill up the queue.
+	if (last_acquired_pts < 0.0)
+		return 0.0;
+
+	double last_pts = last_acquired_pts;
+	for (auto &q : video_queue)
+		if (q.state == ImageState::Ready && q.pts > last_pts)
+			last_pts = q.pts;
+	return last_pts - last_acquired_pts;
+}
+
+int VideoDecoder::Impl::get_sleep_ms_locked()
+{
+#ifdef HAVE_GRANITE_AUDIO
+	// If we're going to sleep, we need to make sure we don't sleep for so long that we drain the audio queue.
+	if (stream && mixer->get_stream_state(stream_id) == Audio::Mixer::StreamState::Playing)
+	{
+		// We want to sleep until there is ~100ms audio left.
+		// Need a decent amount of headroom since we might have to decode video before
+		// we can pump more audio frames.
+		// This could be improved with dedicated decoding threads audio and video,
+		// but that is a bit overkill.
+		// Reformulate the expression to avoid potential u32 overflow if multiplying.
+		// Shouldn't need floats here.
+		int sleep_ms = int(stream->get_num_buffered_audio_frames() / ((audio.av_ctx->sample_rate + 999) / 1000));
+		return std::max<int>(sleep_ms - 100 + 5, 0);
+	}
+#endif
+
+	// Sleep until woken up.
+	return -1;
+}
+
 void VideoDecoder::Impl::thread_main()
 {
 	Util::set_current_thread_priority(Util::ThreadPriority::High);
@@ -2023,26 +2493,11 @@ void VideoDecoder::Impl::thread_main()
 
 			while (!should_iterate_locked() && !teardown)
 			{
-#ifdef HAVE_GRANITE_AUDIO
-				// If we're going to sleep, we need to make sure we don't sleep for so long that we drain the audio queue.
-				if (stream && mixer->get_stream_state(stream_id) == Audio::Mixer::StreamState::Playing)
-				{
-					// We want to sleep until there is ~100ms audio left.
-					// Need a decent amount of headroom since we might have to decode video before
-					// we can pump more audio frames.
-					// This could be improved with dedicated decoding threads audio and video,
-					// but that is a bit overkill.
-					// Reformulate the expression to avoid potential u32 overflow if multiplying.
-					// Shouldn't need floats here.
-					int sleep_ms = int(stream->get_num_buffered_audio_frames() / ((audio.av_ctx->sample_rate + 999) / 1000));
-					sleep_ms = std::max<int>(sleep_ms - 100 + 5, 0);
+				int sleep_ms = get_sleep_ms_locked();
+				if (sleep_ms >= 0)
 					cond.wait_for(holder, std::chrono::milliseconds(sleep_ms));
-				}
 				else
-#endif
-				{
 					cond.wait(holder);
-				}
 			}
 		}
 
@@ -2064,9 +2519,68 @@ void VideoDecoder::Impl::thread_main()
 	}
 }
 
+bool VideoDecoder::Impl::poll_pooled_iteration(double &slack, int &sleep_ms)
+{
+	std::lock_guard<std::mutex> holder{lock};
+	sleep_ms = -1;
+
+	if (teardown)
+		return false;
+
+	if (!should_iterate_locked())
+	{
+		sleep_ms = get_sleep_ms_locked();
+		return false;
+	}
+
+	// The slack is how far decoded video runs ahead of playback.
+	// A blocking acquire or draining audio means we're already late.
+	if (acquire_blocking)
+		slack = -1.0;
+	else
+		slack = get_video_buffered_ahead_locked();
+
+#ifdef HAVE_GRANITE_AUDIO
+	if (stream && mixer->get_stream_state(stream_id) == Audio::Mixer::StreamState::Playing)
+	{
+		double audio_slack = double(stream->get_num_buffered_audio_frames()) / double(audio.av_ctx->sample_rate) - 0.1;
+		slack = std::min<double>(slack, audio_slack);
+	}
+#endif
+
+	return true;
+}
+
+void VideoDecoder::Impl::run_pooled_iteration()
+{
+	if (iterate())
+		return;
+
+	// Same as thread_main(). Ensure acquire thread can observe last frame
+	// if it observes the acquire_is_eof flag.
+	video_upload_signal.wait_until_at_least(video_upload_count);
+
+	std::lock_guard<std::mutex> holder{lock};
+	teardown = true;
+	acquire_is_eof = true;
+	cond.notify_one();
+}
+
+bool VideoDecoder::Impl::is_decoding() const
+{
+	return decode_thread.joinable() || pool_active;
+}
+
+void VideoDecoder::Impl::wake_decoder_locked()
+{
+	cond.notify_one();
+	if (pool_active)
+		pool->kick();
+}
+
 bool VideoDecoder::Impl::is_eof()
 {
-	if (!decode_thread.joinable())
+	if (!is_decoding())
 		return true;
 
 	std::unique_lock<std::mutex> holder{lock};
@@ -2075,7 +2589,7 @@ bool VideoDecoder::Impl::is_eof()
 
 int VideoDecoder::Impl::try_acquire_video_frame(VideoFrame &frame)
 {
-	if (!decode_thread.joinable())
+	if (!is_decoding())
 		return false;
 
 	std::unique_lock<std::mutex> holder{lock};
@@ -2092,9 +2606,10 @@ int VideoDecoder::Impl::try_acquire_video_frame(VideoFrame &frame)
 		frame.index = index;
 		frame.pts = video_queue[index].pts;
 		frame.done_ts = video_queue[index].done_ts;
+		last_acquired_pts = frame.pts;
 
 		// Progress.
-		cond.notify_one();
+		wake_decoder_locked();
 
 		return 1;
 	}
@@ -2106,7 +2621,7 @@ int VideoDecoder::Impl::try_acquire_video_frame(VideoFrame &frame)
 
 bool VideoDecoder::Impl::acquire_video_frame(VideoFrame &frame, int timeout_ms)
 {
-	if (!decode_thread.joinable())
+	if (!is_decoding())
 		return false;
 
 	std::unique_lock<std::mutex> holder{lock};
@@ -2114,7 +2629,7 @@ bool VideoDecoder::Impl::acquire_video_frame(VideoFrame &frame, int timeout_ms)
 	// Wake up decode thread to make sure it knows acquire thread
 	// is blocking and awaits forward progress.
 	acquire_blocking = true;
-	cond.notify_one();
+	wake_decoder_locked();
 
 	int index = -1;
 
@@ -2146,10 +2661,11 @@ bool VideoDecoder::Impl::acquire_video_frame(VideoFrame &frame, int timeout_ms)
 	frame.index = index;
 	frame.pts = video_queue[index].pts;
 	frame.done_ts = video_queue[index].done_ts;
+	last_acquired_pts = frame.pts;
 
 	// Progress.
 	acquire_blocking = false;
-	cond.notify_one();
+	wake_decoder_locked();
 	return true;
 }
 
@@ -2373,6 +2889,7 @@ void VideoDecoder::Impl::flush_codecs()
 {
 	for (auto &img : video_queue)
 	{
+		release_host_frame(img, true);
 		img.rgb_image.reset();
 		img.rgb_storage_view.reset();
 		for (auto &plane : img.planes)
@@ -2386,6 +2903,8 @@ void VideoDecoder::Impl::flush_codecs()
 		img.done_ts = 0;
 	}
 
+	last_acquired_pts = -1.0;
+
 	if (video.av_ctx)
 		avcodec_flush_buffers(video.av_ctx);
 	if (audio.av_ctx)
@@ -2407,6 +2926,7 @@ void VideoDecoder::Impl::end_device_context()
 
 	free_av_objects(video);
 	free_av_objects(audio);
+	host_frames.reset();
 
 	if (av_format_ctx)
 		avformat_close_input(&av_format_ctx);
@@ -2422,13 +2942,24 @@ bool VideoDecoder::Impl::play()
 {
 	if (!device)
 		return false;
-	if (decode_thread.joinable())
+	if (is_decoding())
 		return false;
 
 	teardown = false;
 	begin_audio_stream();
 
-	decode_thread = std::thread(&Impl::thread_main, this);
+	if (opts.pool)
+	{
+		pool = opts.pool->impl.get();
+		pool_active = true;
+		pool->add(this);
+	}
+	else
+	{
+		pool = nullptr;
+		decode_thread = std::thread(&Impl::thread_main, this);
+	}
+
 	return true;
 }
 
@@ -2445,7 +2976,7 @@ bool VideoDecoder::Impl::get_stream_id(Audio::StreamID &id) const
 
 bool VideoDecoder::Impl::stop()
 {
-	if (!decode_thread.joinable())
+	if (!is_decoding())
 		return false;
 
 	{
@@ -2453,7 +2984,16 @@ bool VideoDecoder::Impl::stop()
 		teardown = true;
 		cond.notify_one();
 	}
-	decode_thread.join();
+
+	if (pool_active)
+	{
+		// Waits for any pool thread which is currently iterating this decoder.
+		pool->remove(this);
+		pool_active = false;
+	}
+	else
+		decode_thread.join();
+
 	video_upload_signal.wait_until_at_least(video_upload_count);
 	upload_dependency.reset();
 	flush_codecs();
@@ -2488,7 +3028,7 @@ void VideoDecoder::Impl::set_paused(bool enable)
 			// about the stream state being playing.
 			std::lock_guard<std::mutex> holder{lock};
 			result = mixer->play_stream(stream_id);
-			cond.notify_one();
+			wake_decoder_locked();
 		}
 
 		if (!result)
@@ -2508,7 +3048,7 @@ bool VideoDecoder::Impl::seek(double ts)
 	video_upload_signal.wait_until_at_least(video_upload_count);
 
 	std::lock_guard<std::mutex> holder2{lock};
-	cond.notify_one();
+	wake_decoder_locked();
 
 	if (ts < 0.0)
 		ts = 0.0;
@@ -2520,7 +3060,7 @@ bool VideoDecoder::Impl::seek(double ts)
 		return false;
 	}
 
-	if (decode_thread.joinable())
+	if (is_decoding())
 	{
 		flush_codecs();
 		begin_audio_stream();
@@ -2535,11 +3075,304 @@ VideoDecoder::Impl::~Impl()
 	end_device_context();
 }
 
+VideoDecoderPool::Impl::Impl(unsigned num_threads)
+{
+	managers = Granite::Global::create_thread_context();
+	num_threads = std::max<unsigned>(num_threads, 1);
+	workers.reserve(num_threads);
+	for (unsigned i = 0; i < num_threads; i++)
+		workers.emplace_back(&Impl::worker_main, this, i);
+}
+
+VideoDecoderPool::Impl::~Impl()
+{
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		if (!decoders.empty())
+			LOGE("Destroying VideoDecoderPool with %u active decoders.\n", unsigned(decoders.size()));
+		dead = true;
+		cond.notify_all();
+	}
+
+	for (auto &worker : workers)
+		worker.join();
+}
+
+void VideoDecoderPool::Impl::add(VideoDecoder::Impl *decoder)
+{
+	std::lock_guard<std::mutex> holder{lock};
+	decoders.push_back(decoder);
+	wake_count++;
+	cond.notify_one();
+}
+
+void VideoDecoderPool::Impl::remove(VideoDecoder::Impl *decoder)
+{
+	std::unique_lock<std::mutex> holder{lock};
+	auto itr = std::find(decoders.begin(), decoders.end(), decoder);
+	if (itr != decoders.end())
+		decoders.erase(itr);
+
+	// No worker can observe the decoder after this.
+	idle_cond.wait(holder, [decoder]() {
+		return !decoder->pool_busy && decoder->pool_refs == 0;
+	});
+}
+
+void VideoDecoderPool::Impl::kick()
+{
+	std::lock_guard<std::mutex> holder{lock};
+	wake_count++;
+	cond.notify_one();
+}
+
+void VideoDecoderPool::Impl::worker_main(unsigned index)
+{
+	auto name = "ffmpeg-decode-" + std::to_string(index);
+	Util::set_current_thread_priority(Util::ThreadPriority::High);
+	Util::set_current_thread_name(name.c_str());
+	Util::TimelineTraceFile::set_tid(name.c_str());
+	Global::set_thread_context(*managers);
+	if (auto *tg = GRANITE_THREAD_GROUP())
+		tg->refresh_global_timeline_trace_file();
+
+	struct Candidate
+	{
+		VideoDecoder::Impl *decoder;
+		double slack;
+	};
+	std::vector<VideoDecoder::Impl *> snapshot;
+	std::vector<Candidate> candidates;
+
+	for (;;)
+	{
+		uint64_t observed_wake_count;
+		{
+			std::lock_guard<std::mutex> holder{lock};
+			if (dead)
+				break;
+			snapshot = decoders;
+			for (auto *decoder : snapshot)
+				decoder->pool_refs++;
+			observed_wake_count = wake_count;
+		}
+
+		candidates.clear();
+		int sleep_ms = -1;
+		for (auto *decoder : snapshot)
+		{
+			double slack = 0.0;
+			int decoder_sleep_ms;
+			if (decoder->poll_pooled_iteration(slack, decoder_sleep_ms))
+				candidates.push_back({ decoder, slack });
+			else if (decoder_sleep_ms >= 0 && (sleep_ms < 0 || decoder_sleep_ms < sleep_ms))
+				sleep_ms = decoder_sleep_ms;
+		}
+
+		// The stream which is closest to its presentation deadline goes first.
+		std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) {
+			return a.slack < b.slack;
+		});
+
+		VideoDecoder::Impl *selected = nullptr;
+		{
+			std::unique_lock<std::mutex> holder{lock};
+
+			// Another worker might be iterating the stream already.
+			for (auto &candidate : candidates)
+			{
+				if (!candidate.decoder->pool_busy &&
+				    std::find(decoders.begin(), decoders.end(), candidate.decoder) != decoders.end())
+				{
+					selected = candidate.decoder;
+					selected->pool_busy = true;
+					break;
+				}
+			}
+
+			for (auto *decoder : snapshot)
+				decoder->pool_refs--;
+			idle_cond.notify_all();
+
+			if (!selected)
+			{
+				auto pred = [this, observed_wake_count]() { return dead || wake_count != observed_wake_count; };
+				if (sleep_ms >= 0)
+					cond.wait_for(holder, std::chrono::milliseconds(sleep_ms), pred);
+				else
+					cond.wait(holder, pred);
+				continue;
+			}
+		}
+
+		selected->run_pooled_iteration();
+
+		std::lock_guard<std::mutex> holder{lock};
+		selected->pool_busy = false;
+		idle_cond.notify_all();
+	}
+}
+
+void VideoDecoderPool::Impl::enqueue_conversion(VideoDecoder::Impl *decoder, unsigned frame,
+                                                Vulkan::Semaphore transfer_to_compute)
+{
+	PendingConversion conversion;
+	conversion.decoder = decoder;
+	conversion.frame = frame;
+	conversion.state = decoder->get_conversion_state();
+	for (unsigned i = 0; i < 3; i++)
+		conversion.planes[i] = decoder->video_queue[frame].planes[i];
+	conversion.transfer_to_compute = std::move(transfer_to_compute);
+
+	bool need_flush;
+	{
+		std::lock_guard<std::mutex> holder{conversion_lock};
+		pending_conversions.push_back(std::move(conversion));
+		need_flush = !conversion_flush_queued;
+		conversion_flush_queued = true;
+	}
+
+	// Any conversion which is enqueued before the flush task runs is batched along with this one.
+	if (need_flush)
+	{
+		auto task = decoder->thread_group->create_task([this]() {
+			flush_conversions();
+		});
+		task->set_desc("ffmpeg-decode-conversion");
+		task->set_task_class(TaskClass::Background);
+	}
+}
+
+void VideoDecoderPool::Impl::flush_conversions()
+{
+	std::lock_guard<std::mutex> flush_holder{conversion_flush_lock};
+
+	std::vector<PendingConversion> conversions;
+	{
+		std::lock_guard<std::mutex> holder{conversion_lock};
+		conversions = std::move(pending_conversions);
+		pending_conversions.clear();
+		conversion_flush_queued = false;
+	}
+
+	// Only conversions on the same device and queue can share a submission.
+	std::vector<PendingConversion *> batch;
+	batch.reserve(conversions.size());
+	std::vector<bool> recorded(conversions.size());
+
+	for (size_t i = 0; i < conversions.size(); i++)
+	{
+		if (recorded[i])
+			continue;
+
+		auto *device = conversions[i].decoder->device;
+		bool mipgen = conversions[i].decoder->opts.mipgen;
+
+		batch.clear();
+		for (size_t j = i; j < conversions.size(); j++)
+		{
+			if (!recorded[j] && conversions[j].decoder->device == device &&
+			    conversions[j].decoder->opts.mipgen == mipgen)
+			{
+				batch.push_back(&conversions[j]);
+				recorded[j] = true;
+			}
+		}
+
+		flush_conversion_batch(batch.data(), batch.size());
+	}
+
+	for (auto &conversion : conversions)
+	{
+		// The decoder may be torn down as soon as it observes the last frame.
+		for (auto &plane : conversion.planes)
+			plane.reset();
+		conversion.decoder->complete_video_frame(conversion.frame);
+	}
+}
+
+void VideoDecoderPool::Impl::flush_conversion_batch(PendingConversion * const *batch, size_t count)
+{
+	GRANITE_SCOPED_TIMELINE_EVENT("ffmpeg-decode-conversion-batch");
+
+	auto *device = batch[0]->decoder->device;
+	auto conversion_queue = batch[0]->decoder->opts.mipgen ?
+	                        Vulkan::CommandBuffer::Type::Generic :
+	                        Vulkan::CommandBuffer::Type::AsyncCompute;
+
+	bool realtime = false;
+	for (size_t i = 0; i < count; i++)
+	{
+		device->add_wait_semaphore(conversion_queue,
+		                           std::move(batch[i]->transfer_to_compute),
+		                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                           true);
+		realtime = realtime || batch[i]->decoder->opts.realtime;
+	}
+
+	auto cmd = device->request_command_buffer(conversion_queue);
+
+	std::vector<VkImageMemoryBarrier2> barriers;
+	barriers.reserve(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		auto &conversion = *batch[i];
+		auto &img = conversion.decoder->video_queue[conversion.frame];
+		barriers.push_back(conversion.decoder->get_conversion_pre_barrier(img, conversion.state));
+	}
+	cmd->image_barriers(uint32_t(barriers.size()), barriers.data());
+
+	for (size_t i = 0; i < count; i++)
+	{
+		auto &conversion = *batch[i];
+		auto &img = conversion.decoder->video_queue[conversion.frame];
+		const Vulkan::ImageView *views[3] = {};
+		for (unsigned j = 0; j < conversion.state.num_planes; j++)
+			views[j] = &conversion.planes[j]->get_view();
+		conversion.decoder->record_conversion(*cmd, img, views, conversion.state);
+	}
+
+	barriers.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		auto &conversion = *batch[i];
+		auto &img = conversion.decoder->video_queue[conversion.frame];
+		VkImageMemoryBarrier2 barrier;
+		if (conversion.decoder->get_conversion_post_barrier(img, conversion.state, barrier))
+			barriers.push_back(barrier);
+		else
+			conversion.decoder->record_conversion_mipgen(*cmd, img);
+	}
+
+	if (!barriers.empty())
+		cmd->image_barriers(uint32_t(barriers.size()), barriers.data());
+
+	// One submission signals every stream.
+	std::vector<Vulkan::Semaphore> semaphores(count);
+	device->submit(cmd, nullptr, unsigned(count), semaphores.data());
+	for (size_t i = 0; i < count; i++)
+		batch[i]->decoder->video_queue[batch[i]->frame].sem_to_client = std::move(semaphores[i]);
+
+	// See process_video_frame_in_task_upload().
+	if (realtime)
+		device->next_frame_context_in_async_thread();
+}
+
 VideoDecoder::VideoDecoder()
 {
 	impl.reset(new Impl);
 }
 
+VideoDecoderPool::VideoDecoderPool(unsigned num_threads)
+{
+	impl.reset(new Impl(num_threads));
+}
+
+VideoDecoderPool::~VideoDecoderPool()
+{
+}
+
 VideoDecoder::~VideoDecoder()
 {
 }
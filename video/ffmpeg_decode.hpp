@@ -34,6 +34,8 @@ public:
 	virtual pyro_payload_header get_payload_header() = 0;
 };
 
+class VideoDecoderPool;
+
 class VideoDecoder
 {
 public:
@@ -48,6 +50,9 @@ public:
 		float target_video_buffer_time = 0.2f;
 		float target_realtime_audio_buffer_time = 0.5f;
 		const char *hwdevice = nullptr;
+		// If set, decoding runs on the pool's shared threads rather than a dedicated thread.
+		// The pool must outlive any play() / stop() cycle of the decoder.
+		VideoDecoderPool *pool = nullptr;
 	};
 
 	void set_io_interface(DemuxerIOInterface *iface);
@@ -63,7 +68,7 @@ public:
 	// If stop() is not called, this call with also do so.
 	void end_device_context();
 
-	// Starts decoding thread and audio stream.
+	// Starts decoding thread (or registers with the pool) and audio stream.
 	bool play();
 
 	// Can be called after play().
@@ -128,6 +133,25 @@ public:
 	uint32_t get_audio_underflow_counter() const;
 
 private:
+	friend class VideoDecoderPool;
+	struct Impl;
+	std::unique_ptr<Impl> impl;
+};
+
+// Shares a bounded number of decoding threads between many VideoDecoders.
+// Work is handed to the stream which is closest to running out of decoded frames,
+// and YUV to RGB conversions of all streams are batched into shared compute submissions.
+class VideoDecoderPool
+{
+public:
+	explicit VideoDecoderPool(unsigned num_threads);
+	~VideoDecoderPool();
+
+	VideoDecoderPool(const VideoDecoderPool &) = delete;
+	void operator=(const VideoDecoderPool &) = delete;
+
+private:
+	friend class VideoDecoder;
 	struct Impl;
 	std::unique_ptr<Impl> impl;
 };
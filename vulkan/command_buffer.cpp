@@ -29,6 +29,11 @@
 #include "indirect_layout.hpp"
 #include "timer.hpp"
 #include <string.h>
+#include <memory>
+
+#ifdef GRANITE_VULKAN_SYSTEM_HANDLES
+#include "thread_group.hpp"
+#endif
 
 using namespace Util;
 
@@ -40,6 +45,74 @@ static inline uint32_t get_combined_spec_constant_mask(const DeferredPipelineCom
 	       (compile.potential_static_state.internal_spec_constant_mask << VULKAN_NUM_USER_SPEC_CONSTANTS);
 }
 
+// With dynamic topology, the pipeline only needs to know the topology class.
+static VkPrimitiveTopology get_primitive_topology_class(VkPrimitiveTopology topology)
+{
+	switch (topology)
+	{
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+	case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+		return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+
+	case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST:
+	case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+	case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+	case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST_WITH_ADJACENCY:
+	case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP_WITH_ADJACENCY:
+		return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	default:
+		return topology;
+	}
+}
+
+// Returns the static state with everything which is set dynamically cleared out,
+// so that only state which is actually baked into the pipeline is hashed.
+static PipelineState get_hashable_static_state(const DeferredPipelineCompile &compile)
+{
+	PipelineState static_state = compile.static_state;
+	auto &state = static_state.state;
+
+	if (compile.dynamic_state_mask & PIPELINE_DYNAMIC_STATE_EXTENDED_BIT)
+	{
+		state.cull_mode = 0;
+		state.front_face = 0;
+		state.depth_test = 0;
+		state.depth_write = 0;
+		state.depth_compare = 0;
+		state.depth_bias_enable = 0;
+		state.stencil_test = 0;
+		state.stencil_front_fail = 0;
+		state.stencil_front_pass = 0;
+		state.stencil_front_depth_fail = 0;
+		state.stencil_front_compare_op = 0;
+		state.stencil_back_fail = 0;
+		state.stencil_back_pass = 0;
+		state.stencil_back_depth_fail = 0;
+		state.stencil_back_compare_op = 0;
+		state.primitive_restart = 0;
+		state.topology = get_primitive_topology_class(static_cast<VkPrimitiveTopology>(state.topology));
+	}
+
+	if (compile.dynamic_state_mask & PIPELINE_DYNAMIC_STATE_EXTENDED_3_BIT)
+	{
+		state.blend_enable = 0;
+		state.src_color_blend = 0;
+		state.dst_color_blend = 0;
+		state.color_blend_op = 0;
+		state.src_alpha_blend = 0;
+		state.dst_alpha_blend = 0;
+		state.alpha_blend_op = 0;
+		state.write_mask = 0;
+		state.wireframe = 0;
+		state.alpha_to_coverage = 0;
+	}
+
+	return static_state;
+}
+
 CommandBuffer::CommandBuffer(Device *device_, VkCommandBuffer cmd_, VkPipelineCache cache, Type type_)
     : device(device_)
     , table(device_->get_device_table())
@@ -59,6 +132,21 @@ CommandBuffer::CommandBuffer(Device *device_, VkCommandBuffer cmd_, VkPipelineCa
 			(features.vk13_props.minSubgroupSize << 0) |
 			(features.vk13_props.maxSubgroupSize << 8);
 
+	if (features.supports_extended_dynamic_state)
+	{
+		pipeline_state.dynamic_state_mask |= PIPELINE_DYNAMIC_STATE_EXTENDED_BIT;
+
+		auto &eds3 = features.extended_dynamic_state3_features;
+		if (eds3.extendedDynamicState3ColorBlendEnable &&
+		    eds3.extendedDynamicState3ColorBlendEquation &&
+		    eds3.extendedDynamicState3ColorWriteMask &&
+		    eds3.extendedDynamicState3PolygonMode &&
+		    eds3.extendedDynamicState3AlphaToCoverageEnable)
+		{
+			pipeline_state.dynamic_state_mask |= PIPELINE_DYNAMIC_STATE_EXTENDED_3_BIT;
+		}
+	}
+
 	device->lock.read_only_cache.lock_read();
 }
 
@@ -68,6 +156,7 @@ CommandBuffer::~CommandBuffer()
 	VK_ASSERT(ibo_block.mapped == nullptr);
 	VK_ASSERT(ubo_block.mapped == nullptr);
 	VK_ASSERT(staging_block.mapped == nullptr);
+	VK_ASSERT(descriptor_block.mapped == nullptr);
 	device->lock.read_only_cache.unlock_read();
 }
 
@@ -223,7 +312,6 @@ void CommandBuffer::clear_image(const Image &image, const VkClearValue &value, V
 void CommandBuffer::clear_quad(unsigned attachment, const VkClearRect &rect, const VkClearValue &value,
                                VkImageAspectFlags aspect)
 {
-	VK_ASSERT(framebuffer);
 	VK_ASSERT(actual_render_pass);
 	VkClearAttachment att = {};
 	att.clearValue = value;
@@ -232,17 +320,16 @@ void CommandBuffer::clear_quad(unsigned attachment, const VkClearRect &rect, con
 
 	auto tmp_rect = rect;
 	rect2d_transform_xy(tmp_rect.rect, current_framebuffer_surface_transform,
-						framebuffer->get_width(), framebuffer->get_height());
+						framebuffer_width, framebuffer_height);
 	table.vkCmdClearAttachments(cmd, 1, &att, 1, &tmp_rect);
 }
 
 void CommandBuffer::clear_quad(const VkClearRect &rect, const VkClearAttachment *attachments, unsigned num_attachments)
 {
-	VK_ASSERT(framebuffer);
 	VK_ASSERT(actual_render_pass);
 	auto tmp_rect = rect;
 	rect2d_transform_xy(tmp_rect.rect, current_framebuffer_surface_transform,
-	                    framebuffer->get_width(), framebuffer->get_height());
+	                    framebuffer_width, framebuffer_height);
 	table.vkCmdClearAttachments(cmd, num_attachments, attachments, 1, &tmp_rect);
 }
 
@@ -257,7 +344,8 @@ void CommandBuffer::full_barrier()
 void CommandBuffer::pixel_barrier()
 {
 	VK_ASSERT(actual_render_pass);
-	VK_ASSERT(framebuffer);
+	// Barriers inside vkCmdBeginRendering need dynamic rendering local read.
+	VK_ASSERT(!pipeline_state.dynamic_rendering);
 	VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
 	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 	barrier.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
@@ -850,12 +938,13 @@ void CommandBuffer::begin_graphics()
 		set_surface_transform_specialization_constants();
 }
 
-void CommandBuffer::init_viewport_scissor(const RenderPassInfo &info, const Framebuffer *fb)
+void CommandBuffer::init_viewport_scissor(const RenderPassInfo &info)
 {
 	VkRect2D rect = info.render_area;
 
-	uint32_t fb_width = fb->get_width();
-	uint32_t fb_height = fb->get_height();
+	Framebuffer::compute_dimensions(info, framebuffer_width, framebuffer_height);
+	uint32_t fb_width = framebuffer_width;
+	uint32_t fb_height = framebuffer_height;
 
 	// Convert fb_width / fb_height to logical width / height if need be.
 	if (surface_transform_swaps_xy(current_framebuffer_surface_transform))
@@ -892,7 +981,7 @@ CommandBufferHandle CommandBuffer::request_secondary_command_buffer(Device &devi
 	if (info.depth_stencil)
 		cmd->framebuffer_attachments[i++] = info.depth_stencil;
 
-	cmd->init_viewport_scissor(info, fb);
+	cmd->init_viewport_scissor(info);
 	cmd->pipeline_state.subpass_index = subpass;
 	cmd->current_contents = VK_SUBPASS_CONTENTS_INLINE;
 
@@ -913,6 +1002,8 @@ CommandBufferHandle CommandBuffer::request_secondary_command_buffer(unsigned thr
 	memcpy(secondary_cmd->framebuffer_attachments, framebuffer_attachments, sizeof(framebuffer_attachments));
 
 	secondary_cmd->pipeline_state.subpass_index = subpass_;
+	secondary_cmd->framebuffer_width = framebuffer_width;
+	secondary_cmd->framebuffer_height = framebuffer_height;
 	secondary_cmd->viewport = viewport;
 	secondary_cmd->scissor = scissor;
 	secondary_cmd->current_contents = VK_SUBPASS_CONTENTS_INLINE;
@@ -993,17 +1084,165 @@ void CommandBuffer::init_surface_transform(const RenderPassInfo &info)
 	current_framebuffer_surface_transform = prerorate;
 }
 
+// Dynamic rendering has no subpasses, no external dependencies and no implicit layout transitions.
+// Only passes whose VkRenderPass would not have needed any of those are eligible.
+static bool render_pass_info_supports_dynamic_rendering(const RenderPassInfo &info, VkSubpassContents contents)
+{
+	if (contents != VK_SUBPASS_CONTENTS_INLINE || info.num_layers > 1 || info.num_subpasses > 1)
+		return false;
+
+	bool ds_read_only = (info.op_flags & RENDER_PASS_OP_DEPTH_STENCIL_READ_ONLY_BIT) != 0;
+
+	if (info.num_subpasses == 1)
+	{
+		auto &subpass = info.subpasses[0];
+		if (subpass.num_input_attachments || subpass.num_resolve_attachments ||
+		    subpass.num_color_attachments != info.num_color_attachments)
+			return false;
+
+		// Every attachment must be referenced, or its load and store ops would be lost.
+		uint32_t referenced = 0;
+		for (unsigned i = 0; i < subpass.num_color_attachments; i++)
+		{
+			if (subpass.color_attachments[i] >= info.num_color_attachments)
+				return false;
+			referenced |= 1u << subpass.color_attachments[i];
+		}
+
+		if (referenced != (1u << info.num_color_attachments) - 1u)
+			return false;
+
+		auto ds_mode = ds_read_only ? RenderPassInfo::DepthStencil::ReadOnly : RenderPassInfo::DepthStencil::ReadWrite;
+		if (info.depth_stencil && subpass.depth_stencil_mode != ds_mode)
+			return false;
+	}
+
+	for (unsigned i = 0; i < info.num_color_attachments; i++)
+	{
+		auto &image = info.color_attachments[i]->get_image();
+		if (image.is_swapchain_image() || image.get_create_info().domain == ImageDomain::Transient)
+			return false;
+	}
+
+	if (info.depth_stencil && info.depth_stencil->get_image().get_create_info().domain == ImageDomain::Transient)
+		return false;
+
+	return true;
+}
+
+void CommandBuffer::begin_dynamic_rendering(const RenderPassInfo &info)
+{
+	init_surface_transform(info);
+	// Only used to describe attachment formats and sample counts, no VkFramebuffer is needed.
+	pipeline_state.compatible_render_pass = &device->request_render_pass(info, true);
+	actual_render_pass = pipeline_state.compatible_render_pass;
+	pipeline_state.subpass_index = 0;
+	pipeline_state.dynamic_rendering = true;
+	framebuffer_is_multiview = false;
+
+	memset(framebuffer_attachments, 0, sizeof(framebuffer_attachments));
+	unsigned att;
+	for (att = 0; att < info.num_color_attachments; att++)
+		framebuffer_attachments[att] = info.color_attachments[att];
+	if (info.depth_stencil)
+		framebuffer_attachments[att++] = info.depth_stencil;
+
+	init_viewport_scissor(info);
+
+	VkRenderingAttachmentInfo color_attachments[VULKAN_NUM_ATTACHMENTS];
+	VkRenderingAttachmentInfo depth_stencil = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
+	VkRenderingInfo rendering_info = { VK_STRUCTURE_TYPE_RENDERING_INFO };
+	rendering_info.renderArea = scissor;
+	rendering_info.layerCount = 1;
+	rendering_info.colorAttachmentCount = info.num_color_attachments;
+	rendering_info.pColorAttachments = color_attachments;
+
+	for (unsigned i = 0; i < info.num_color_attachments; i++)
+	{
+		unsigned index = info.num_subpasses ? info.subpasses[0].color_attachments[i] : i;
+		auto *view = info.color_attachments[index];
+		VK_ASSERT(view);
+
+		auto &color = color_attachments[i];
+		color = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
+		color.imageView = view->get_render_target_view(info.base_layer);
+		color.imageLayout = view->get_image().get_layout(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+		if (info.clear_attachments & (1u << index))
+		{
+			color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			color.clearValue.color = info.clear_color[index];
+		}
+		else if (info.load_attachments & (1u << index))
+			color.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		else
+			color.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+		if (info.store_attachments & (1u << index))
+			color.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		else
+			color.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
+
+	if (info.depth_stencil)
+	{
+		bool ds_read_only = (info.op_flags & RENDER_PASS_OP_DEPTH_STENCIL_READ_ONLY_BIT) != 0;
+		depth_stencil.imageView = info.depth_stencil->get_render_target_view(info.base_layer);
+		depth_stencil.imageLayout = info.depth_stencil->get_image().get_layout(
+				ds_read_only ?
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL :
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+		if (info.op_flags & RENDER_PASS_OP_CLEAR_DEPTH_STENCIL_BIT)
+		{
+			depth_stencil.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depth_stencil.clearValue.depthStencil = info.clear_depth_stencil;
+		}
+		else if (info.op_flags & RENDER_PASS_OP_LOAD_DEPTH_STENCIL_BIT)
+			depth_stencil.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		else
+			depth_stencil.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+		if (info.op_flags & RENDER_PASS_OP_STORE_DEPTH_STENCIL_BIT)
+			depth_stencil.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		else
+			depth_stencil.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		auto aspect = format_to_aspect_mask(info.depth_stencil->get_format());
+		if (aspect & VK_IMAGE_ASPECT_DEPTH_BIT)
+			rendering_info.pDepthAttachment = &depth_stencil;
+		if (aspect & VK_IMAGE_ASPECT_STENCIL_BIT)
+			rendering_info.pStencilAttachment = &depth_stencil;
+	}
+
+	rect2d_transform_xy(rendering_info.renderArea, current_framebuffer_surface_transform,
+	                    framebuffer_width, framebuffer_height);
+
+	table.vkCmdBeginRendering(cmd, &rendering_info);
+
+	current_contents = VK_SUBPASS_CONTENTS_INLINE;
+	begin_graphics();
+}
+
 void CommandBuffer::begin_render_pass(const RenderPassInfo &info, VkSubpassContents contents)
 {
 	VK_ASSERT(!framebuffer);
 	VK_ASSERT(!pipeline_state.compatible_render_pass);
 	VK_ASSERT(!actual_render_pass);
 
+	if (device->get_device_features().supports_dynamic_rendering &&
+	    render_pass_info_supports_dynamic_rendering(info, contents))
+	{
+		begin_dynamic_rendering(info);
+		return;
+	}
+
 	framebuffer = &device->request_framebuffer(info);
 	init_surface_transform(info);
 	pipeline_state.compatible_render_pass = &framebuffer->get_compatible_render_pass();
 	actual_render_pass = &device->request_render_pass(info, false);
 	pipeline_state.subpass_index = 0;
+	pipeline_state.dynamic_rendering = false;
 	framebuffer_is_multiview = info.num_layers > 1;
 
 	memset(framebuffer_attachments, 0, sizeof(framebuffer_attachments));
@@ -1013,7 +1252,7 @@ void CommandBuffer::begin_render_pass(const RenderPassInfo &info, VkSubpassConte
 	if (info.depth_stencil)
 		framebuffer_attachments[att++] = info.depth_stencil;
 
-	init_viewport_scissor(info, framebuffer);
+	init_viewport_scissor(info);
 
 	VkClearValue clear_values[VULKAN_NUM_ATTACHMENTS + 1];
 	unsigned num_clear_values = 0;
@@ -1047,7 +1286,7 @@ void CommandBuffer::begin_render_pass(const RenderPassInfo &info, VkSubpassConte
 	// In the render pass interface, we pretend we are rendering with normal
 	// un-rotated coordinates.
 	rect2d_transform_xy(begin_info.renderArea, current_framebuffer_surface_transform,
-	                    framebuffer->get_width(), framebuffer->get_height());
+	                    framebuffer_width, framebuffer_height);
 
 	table.vkCmdBeginRenderPass(cmd, &begin_info, contents);
 
@@ -1057,15 +1296,18 @@ void CommandBuffer::begin_render_pass(const RenderPassInfo &info, VkSubpassConte
 
 void CommandBuffer::end_render_pass()
 {
-	VK_ASSERT(framebuffer);
 	VK_ASSERT(actual_render_pass);
 	VK_ASSERT(pipeline_state.compatible_render_pass);
 
-	table.vkCmdEndRenderPass(cmd);
+	if (pipeline_state.dynamic_rendering)
+		table.vkCmdEndRendering(cmd);
+	else
+		table.vkCmdEndRenderPass(cmd);
 
 	framebuffer = nullptr;
 	actual_render_pass = nullptr;
 	pipeline_state.compatible_render_pass = nullptr;
+	pipeline_state.dynamic_rendering = false;
 	begin_compute();
 }
 
@@ -1135,6 +1377,8 @@ Pipeline CommandBuffer::build_compute_pipeline(Device *device, const DeferredPip
 	auto &shader = *compile.program->get_shader(ShaderStage::Compute);
 	VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
 	info.layout = compile.layout->get_layout();
+	if (compile.layout->uses_descriptor_buffer())
+		info.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
 	info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	info.stage.module = shader.get_module();
 	info.stage.pName = "main";
@@ -1262,62 +1506,129 @@ bool CommandBuffer::setup_subgroup_size_control(
 	return true;
 }
 
-Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPipelineCompile &compile,
-                                                CompileMode mode)
+struct GraphicsPipelineCreateState
 {
-	// This can be called from outside a CommandBuffer content, so need to hold lock.
-	Util::RWSpinLockReadHolder holder{device->lock.read_only_cache};
+	VkPipelineViewportStateCreateInfo vp;
+	VkPipelineDynamicStateCreateInfo dyn;
+	VkDynamicState states[24];
+	uint32_t dynamic_mask;
+	VkPipelineColorBlendAttachmentState blend_attachments[VULKAN_NUM_ATTACHMENTS];
+	VkPipelineColorBlendStateCreateInfo blend;
+	VkPipelineDepthStencilStateCreateInfo ds;
+	VkPipelineVertexInputStateCreateInfo vi;
+	VkVertexInputAttributeDescription vi_attribs[VULKAN_NUM_VERTEX_ATTRIBS];
+	VkVertexInputBindingDescription vi_bindings[VULKAN_NUM_VERTEX_BUFFERS];
+	VkPipelineInputAssemblyStateCreateInfo ia;
+	VkPipelineMultisampleStateCreateInfo ms;
+	VkPipelineRasterizationStateCreateInfo raster;
+	VkPipelineRasterizationConservativeStateCreateInfoEXT conservative_raster;
+	VkPipelineShaderStageCreateInfo stages[Util::ecast(ShaderStage::Count)];
+	unsigned num_stages;
+	VkSpecializationInfo spec_info[Util::ecast(ShaderStage::Count)] = {};
+	VkSpecializationMapEntry spec_entries[Util::ecast(ShaderStage::Count)][VULKAN_NUM_TOTAL_SPEC_CONSTANTS];
+	uint32_t spec_constants[Util::ecast(ShaderStage::Count)][VULKAN_NUM_TOTAL_SPEC_CONSTANTS];
+	VkPipelineShaderStageRequiredSubgroupSizeCreateInfo subgroup_size_info_task;
+	VkPipelineShaderStageRequiredSubgroupSizeCreateInfo subgroup_size_info_mesh;
+	VkPipelineRenderingCreateInfo rendering;
+	VkFormat rendering_color_formats[VULKAN_NUM_ATTACHMENTS];
+	VkGraphicsPipelineCreateInfo pipe;
+};
 
-	// If we don't have pipeline creation cache control feature,
-	// we must assume compilation can be synchronous.
-	if (mode == CompileMode::FailOnCompileRequired &&
-	    (device->get_workarounds().broken_pipeline_cache_control ||
-	     !device->get_device_features().vk13_features.pipelineCreationCacheControl))
+static void setup_pipeline_rendering_info(const DeferredPipelineCompile &compile, GraphicsPipelineCreateState &state)
+{
+	auto *rp = compile.compatible_render_pass;
+	unsigned subpass = compile.subpass_index;
+
+	state.rendering = { VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO };
+	state.rendering.colorAttachmentCount = rp->get_num_color_attachments(subpass);
+	state.rendering.pColorAttachmentFormats = state.rendering_color_formats;
+
+	for (unsigned i = 0; i < state.rendering.colorAttachmentCount; i++)
 	{
-		return {};
+		uint32_t attachment = rp->get_color_attachment(subpass, i).attachment;
+		state.rendering_color_formats[i] =
+				attachment != VK_ATTACHMENT_UNUSED ? rp->get_color_format(attachment) : VK_FORMAT_UNDEFINED;
 	}
 
-	// Unsupported. Gets pretty complicated since if any dependent pipeline fails, we have to abort.
-	if (mode == CompileMode::FailOnCompileRequired && !compile.program_group.empty())
-		return {};
+	if (rp->has_depth(subpass))
+		state.rendering.depthAttachmentFormat = rp->get_depth_stencil_format();
+	if (rp->has_stencil(subpass))
+		state.rendering.stencilAttachmentFormat = rp->get_depth_stencil_format();
+}
 
+bool CommandBuffer::setup_graphics_pipeline_state(Device *device, const DeferredPipelineCompile &compile,
+                                                  GraphicsPipelineCreateState &state)
+{
 	// Viewport state
-	VkPipelineViewportStateCreateInfo vp = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
-	vp.viewportCount = 1;
-	vp.scissorCount = 1;
+	state.vp = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+	state.vp.viewportCount = 1;
+	state.vp.scissorCount = 1;
 
 	// Dynamic state
-	VkPipelineDynamicStateCreateInfo dyn = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
-	dyn.dynamicStateCount = 2;
-	VkDynamicState states[7] = {
-		VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_VIEWPORT,
-	};
-	dyn.pDynamicStates = states;
+	state.dyn = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+	state.dyn.dynamicStateCount = 2;
+	state.states[0] = VK_DYNAMIC_STATE_SCISSOR;
+	state.states[1] = VK_DYNAMIC_STATE_VIEWPORT;
+	state.dyn.pDynamicStates = state.states;
+
+	state.dynamic_mask = COMMAND_BUFFER_DIRTY_VIEWPORT_BIT | COMMAND_BUFFER_DIRTY_SCISSOR_BIT;
 
-	uint32_t dynamic_mask = COMMAND_BUFFER_DIRTY_VIEWPORT_BIT | COMMAND_BUFFER_DIRTY_SCISSOR_BIT;
+	bool extended_dynamic_state = (compile.dynamic_state_mask & PIPELINE_DYNAMIC_STATE_EXTENDED_BIT) != 0;
 
-	if (compile.static_state.state.depth_bias_enable)
+	// With dynamic enables, we cannot know up front if depth bias or stencil will be used.
+	if (compile.static_state.state.depth_bias_enable || extended_dynamic_state)
 	{
-		states[dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_BIAS;
-		dynamic_mask |= COMMAND_BUFFER_DIRTY_DEPTH_BIAS_BIT;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_BIAS;
+		state.dynamic_mask |= COMMAND_BUFFER_DIRTY_DEPTH_BIAS_BIT;
+	}
+
+	if (compile.static_state.state.stencil_test || extended_dynamic_state)
+	{
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_STENCIL_REFERENCE;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_STENCIL_WRITE_MASK;
+		state.dynamic_mask |= COMMAND_BUFFER_DIRTY_STENCIL_REFERENCE_BIT;
+	}
+
+	if (extended_dynamic_state)
+	{
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_CULL_MODE;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_FRONT_FACE;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_COMPARE_OP;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_STENCIL_OP;
+
+		// Not allowed for mesh shading pipelines.
+		if (compile.program->get_shader(ShaderStage::Vertex))
+		{
+			state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY;
+			state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE;
+		}
+
+		state.dynamic_mask |= COMMAND_BUFFER_DIRTY_EXTENDED_DYNAMIC_STATE_BIT;
 	}
 
-	if (compile.static_state.state.stencil_test)
+	if (compile.dynamic_state_mask & PIPELINE_DYNAMIC_STATE_EXTENDED_3_BIT)
 	{
-		states[dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK;
-		states[dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_STENCIL_REFERENCE;
-		states[dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_STENCIL_WRITE_MASK;
-		dynamic_mask |= COMMAND_BUFFER_DIRTY_STENCIL_REFERENCE_BIT;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_BLEND_CONSTANTS;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_POLYGON_MODE_EXT;
+		state.states[state.dyn.dynamicStateCount++] = VK_DYNAMIC_STATE_ALPHA_TO_COVERAGE_ENABLE_EXT;
+		state.dynamic_mask |= COMMAND_BUFFER_DIRTY_EXTENDED_DYNAMIC_STATE_BIT;
 	}
 
 	// Blend state
-	VkPipelineColorBlendAttachmentState blend_attachments[VULKAN_NUM_ATTACHMENTS];
-	VkPipelineColorBlendStateCreateInfo blend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
-	blend.attachmentCount = compile.compatible_render_pass->get_num_color_attachments(compile.subpass_index);
-	blend.pAttachments = blend_attachments;
-	for (unsigned i = 0; i < blend.attachmentCount; i++)
+	state.blend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+	state.blend.attachmentCount = compile.compatible_render_pass->get_num_color_attachments(compile.subpass_index);
+	state.blend.pAttachments = state.blend_attachments;
+	for (unsigned i = 0; i < state.blend.attachmentCount; i++)
 	{
-		auto &att = blend_attachments[i];
+		auto &att = state.blend_attachments[i];
 		att = {};
 
 		if (compile.compatible_render_pass->get_color_attachment(compile.subpass_index, i).attachment != VK_ATTACHMENT_UNUSED &&
@@ -1336,41 +1647,39 @@ Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPi
 			}
 		}
 	}
-	memcpy(blend.blendConstants, compile.potential_static_state.blend_constants, sizeof(blend.blendConstants));
+	memcpy(state.blend.blendConstants, compile.potential_static_state.blend_constants, sizeof(state.blend.blendConstants));
 
 	// Depth state
-	VkPipelineDepthStencilStateCreateInfo ds = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
-	ds.stencilTestEnable = compile.compatible_render_pass->has_stencil(compile.subpass_index) && compile.static_state.state.stencil_test;
-	ds.depthTestEnable = compile.compatible_render_pass->has_depth(compile.subpass_index) && compile.static_state.state.depth_test;
-	ds.depthWriteEnable = compile.compatible_render_pass->has_depth(compile.subpass_index) && compile.static_state.state.depth_write;
+	state.ds = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
+	state.ds.stencilTestEnable = compile.compatible_render_pass->has_stencil(compile.subpass_index) && compile.static_state.state.stencil_test;
+	state.ds.depthTestEnable = compile.compatible_render_pass->has_depth(compile.subpass_index) && compile.static_state.state.depth_test;
+	state.ds.depthWriteEnable = compile.compatible_render_pass->has_depth(compile.subpass_index) && compile.static_state.state.depth_write;
 
-	if (ds.depthTestEnable)
-		ds.depthCompareOp = static_cast<VkCompareOp>(compile.static_state.state.depth_compare);
+	if (state.ds.depthTestEnable)
+		state.ds.depthCompareOp = static_cast<VkCompareOp>(compile.static_state.state.depth_compare);
 
-	if (ds.stencilTestEnable)
+	if (state.ds.stencilTestEnable)
 	{
-		ds.front.compareOp = static_cast<VkCompareOp>(compile.static_state.state.stencil_front_compare_op);
-		ds.front.passOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_front_pass);
-		ds.front.failOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_front_fail);
-		ds.front.depthFailOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_front_depth_fail);
-		ds.back.compareOp = static_cast<VkCompareOp>(compile.static_state.state.stencil_back_compare_op);
-		ds.back.passOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_back_pass);
-		ds.back.failOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_back_fail);
-		ds.back.depthFailOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_back_depth_fail);
+		state.ds.front.compareOp = static_cast<VkCompareOp>(compile.static_state.state.stencil_front_compare_op);
+		state.ds.front.passOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_front_pass);
+		state.ds.front.failOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_front_fail);
+		state.ds.front.depthFailOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_front_depth_fail);
+		state.ds.back.compareOp = static_cast<VkCompareOp>(compile.static_state.state.stencil_back_compare_op);
+		state.ds.back.passOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_back_pass);
+		state.ds.back.failOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_back_fail);
+		state.ds.back.depthFailOp = static_cast<VkStencilOp>(compile.static_state.state.stencil_back_depth_fail);
 	}
 
 	// Vertex input
-	VkPipelineVertexInputStateCreateInfo vi = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
-	VkVertexInputAttributeDescription vi_attribs[VULKAN_NUM_VERTEX_ATTRIBS];
-	VkVertexInputBindingDescription vi_bindings[VULKAN_NUM_VERTEX_BUFFERS];
+	state.vi = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
 
 	if (compile.program->get_shader(ShaderStage::Vertex))
 	{
-		vi.pVertexAttributeDescriptions = vi_attribs;
+		state.vi.pVertexAttributeDescriptions = state.vi_attribs;
 		uint32_t attr_mask = compile.layout->get_resource_layout().attribute_mask;
 		uint32_t binding_mask = 0;
 		for_each_bit(attr_mask, [&](uint32_t bit) {
-			auto &attr = vi_attribs[vi.vertexAttributeDescriptionCount++];
+			auto &attr = state.vi_attribs[state.vi.vertexAttributeDescriptionCount++];
 			attr.location = bit;
 			attr.binding = compile.attribs[bit].binding;
 			attr.format = compile.attribs[bit].format;
@@ -1378,9 +1687,9 @@ Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPi
 			binding_mask |= 1u << attr.binding;
 		});
 
-		vi.pVertexBindingDescriptions = vi_bindings;
+		state.vi.pVertexBindingDescriptions = state.vi_bindings;
 		for_each_bit(binding_mask, [&](uint32_t bit) {
-			auto &bind = vi_bindings[vi.vertexBindingDescriptionCount++];
+			auto &bind = state.vi_bindings[state.vi.vertexBindingDescriptionCount++];
 			bind.binding = bit;
 			bind.inputRate = compile.input_rates[bit];
 			bind.stride = compile.strides[bit];
@@ -1388,57 +1697,51 @@ Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPi
 	}
 
 	// Input assembly
-	VkPipelineInputAssemblyStateCreateInfo ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
-	ia.primitiveRestartEnable = compile.static_state.state.primitive_restart;
-	ia.topology = static_cast<VkPrimitiveTopology>(compile.static_state.state.topology);
+	state.ia = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+	state.ia.primitiveRestartEnable = compile.static_state.state.primitive_restart;
+	state.ia.topology = static_cast<VkPrimitiveTopology>(compile.static_state.state.topology);
+	if (extended_dynamic_state)
+		state.ia.topology = get_primitive_topology_class(state.ia.topology);
 
 	// Multisample
-	VkPipelineMultisampleStateCreateInfo ms = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
-	ms.rasterizationSamples = static_cast<VkSampleCountFlagBits>(compile.compatible_render_pass->get_sample_count(compile.subpass_index));
+	state.ms = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+	state.ms.rasterizationSamples = static_cast<VkSampleCountFlagBits>(compile.compatible_render_pass->get_sample_count(compile.subpass_index));
 
 	if (compile.compatible_render_pass->get_sample_count(compile.subpass_index) > 1)
 	{
-		ms.alphaToCoverageEnable = compile.static_state.state.alpha_to_coverage;
-		ms.alphaToOneEnable = compile.static_state.state.alpha_to_one;
-		ms.sampleShadingEnable = compile.static_state.state.sample_shading;
-		ms.minSampleShading = 1.0f;
+		state.ms.alphaToCoverageEnable = compile.static_state.state.alpha_to_coverage;
+		state.ms.alphaToOneEnable = compile.static_state.state.alpha_to_one;
+		state.ms.sampleShadingEnable = compile.static_state.state.sample_shading;
+		state.ms.minSampleShading = 1.0f;
 	}
 
 	// Raster
-	VkPipelineRasterizationStateCreateInfo raster = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
-	raster.cullMode = static_cast<VkCullModeFlags>(compile.static_state.state.cull_mode);
-	raster.frontFace = static_cast<VkFrontFace>(compile.static_state.state.front_face);
-	raster.lineWidth = 1.0f;
-	raster.polygonMode = compile.static_state.state.wireframe ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
-	raster.depthBiasEnable = compile.static_state.state.depth_bias_enable != 0;
-
-	VkPipelineRasterizationConservativeStateCreateInfoEXT conservative_raster = {
+	state.raster = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+	state.raster.cullMode = static_cast<VkCullModeFlags>(compile.static_state.state.cull_mode);
+	state.raster.frontFace = static_cast<VkFrontFace>(compile.static_state.state.front_face);
+	state.raster.lineWidth = 1.0f;
+	state.raster.polygonMode = compile.static_state.state.wireframe ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+	state.raster.depthBiasEnable = compile.static_state.state.depth_bias_enable != 0;
+
+	state.conservative_raster = {
 		VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_CONSERVATIVE_STATE_CREATE_INFO_EXT
 	};
 	if (compile.static_state.state.conservative_raster)
 	{
 		if (device->get_device_features().supports_conservative_rasterization)
 		{
-			raster.pNext = &conservative_raster;
-			conservative_raster.conservativeRasterizationMode = VK_CONSERVATIVE_RASTERIZATION_MODE_OVERESTIMATE_EXT;
+			state.raster.pNext = &state.conservative_raster;
+			state.conservative_raster.conservativeRasterizationMode = VK_CONSERVATIVE_RASTERIZATION_MODE_OVERESTIMATE_EXT;
 		}
 		else
 		{
 			LOGE("Conservative rasterization is not supported on this device.\n");
-			return {};
+			return false;
 		}
 	}
 
 	// Stages
-	VkPipelineShaderStageCreateInfo stages[Util::ecast(ShaderStage::Count)];
-	unsigned num_stages = 0;
-
-	VkSpecializationInfo spec_info[ecast(ShaderStage::Count)] = {};
-	VkSpecializationMapEntry spec_entries[ecast(ShaderStage::Count)][VULKAN_NUM_TOTAL_SPEC_CONSTANTS];
-	uint32_t spec_constants[Util::ecast(ShaderStage::Count)][VULKAN_NUM_TOTAL_SPEC_CONSTANTS];
-
-	VkPipelineShaderStageRequiredSubgroupSizeCreateInfo subgroup_size_info_task;
-	VkPipelineShaderStageRequiredSubgroupSizeCreateInfo subgroup_size_info_mesh;
+	state.num_stages = 0;
 
 	for (unsigned i = 0; i < Util::ecast(ShaderStage::Count); i++)
 	{
@@ -1447,19 +1750,19 @@ Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPi
 
 		if (mask)
 		{
-			spec_info[i].pData = spec_constants[i];
-			spec_info[i].pMapEntries = spec_entries[i];
+			state.spec_info[i].pData = state.spec_constants[i];
+			state.spec_info[i].pMapEntries = state.spec_entries[i];
 
 			for_each_bit(mask, [&](uint32_t bit)
 			{
-				auto &entry = spec_entries[i][spec_info[i].mapEntryCount];
-				entry.offset = sizeof(uint32_t) * spec_info[i].mapEntryCount;
+				auto &entry = state.spec_entries[i][state.spec_info[i].mapEntryCount];
+				entry.offset = sizeof(uint32_t) * state.spec_info[i].mapEntryCount;
 				entry.size = sizeof(uint32_t);
 				entry.constantID = bit;
-				spec_constants[i][spec_info[i].mapEntryCount] = compile.potential_static_state.spec_constants[bit];
-				spec_info[i].mapEntryCount++;
+				state.spec_constants[i][state.spec_info[i].mapEntryCount] = compile.potential_static_state.spec_constants[bit];
+				state.spec_info[i].mapEntryCount++;
 			});
-			spec_info[i].dataSize = spec_info[i].mapEntryCount * sizeof(uint32_t);
+			state.spec_info[i].dataSize = state.spec_info[i].mapEntryCount * sizeof(uint32_t);
 		}
 	}
 
@@ -1468,13 +1771,13 @@ Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPi
 		auto stage = static_cast<ShaderStage>(i);
 		if (compile.program->get_shader(stage))
 		{
-			auto &s = stages[num_stages++];
+			auto &s = state.stages[state.num_stages++];
 			s = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
 			s.module = compile.program->get_shader(stage)->get_module();
 			s.pName = "main";
 			s.stage = static_cast<VkShaderStageFlagBits>(1u << i);
-			if (spec_info[i].mapEntryCount)
-				s.pSpecializationInfo = &spec_info[i];
+			if (state.spec_info[i].mapEntryCount)
+				s.pSpecializationInfo = &state.spec_info[i];
 
 			if (stage == ShaderStage::Mesh || stage == ShaderStage::Task)
 			{
@@ -1488,7 +1791,7 @@ Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPi
 					full_group = compile.static_state.state.subgroup_full_group;
 					min_size_log2 = compile.static_state.state.subgroup_minimum_size_log2;
 					max_size_log2 = compile.static_state.state.subgroup_maximum_size_log2;
-					required_info = &subgroup_size_info_mesh;
+					required_info = &state.subgroup_size_info_mesh;
 				}
 				else
 				{
@@ -1496,7 +1799,7 @@ Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPi
 					full_group = compile.static_state.state.subgroup_full_group_task;
 					min_size_log2 = compile.static_state.state.subgroup_minimum_size_log2_task;
 					max_size_log2 = compile.static_state.state.subgroup_maximum_size_log2_task;
-					required_info = &subgroup_size_info_task;
+					required_info = &state.subgroup_size_info_task;
 				}
 
 				if (size_enabled)
@@ -1506,31 +1809,504 @@ Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPi
 							full_group, min_size_log2, max_size_log2))
 					{
 						LOGE("Subgroup size configuration not supported.\n");
-						return {};
+						return false;
 					}
 				}
 			}
 		}
 	}
 
-	VkGraphicsPipelineCreateInfo pipe = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
-	pipe.layout = compile.layout->get_layout();
-	pipe.renderPass = compile.compatible_render_pass->get_render_pass();
-	pipe.subpass = compile.subpass_index;
+	state.pipe = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	state.pipe.layout = compile.layout->get_layout();
+	if (compile.layout->uses_descriptor_buffer())
+		state.pipe.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+	if (compile.dynamic_rendering)
+	{
+		setup_pipeline_rendering_info(compile, state);
+		state.pipe.pNext = &state.rendering;
+	}
+	else
+	{
+		state.pipe.renderPass = compile.compatible_render_pass->get_render_pass();
+		state.pipe.subpass = compile.subpass_index;
+	}
 
-	pipe.pViewportState = &vp;
-	pipe.pDynamicState = &dyn;
-	pipe.pColorBlendState = &blend;
-	pipe.pDepthStencilState = &ds;
+	state.pipe.pViewportState = &state.vp;
+	state.pipe.pDynamicState = &state.dyn;
+	state.pipe.pColorBlendState = &state.blend;
+	state.pipe.pDepthStencilState = &state.ds;
 	if (compile.program->get_shader(ShaderStage::Vertex))
 	{
-		pipe.pVertexInputState = &vi;
-		pipe.pInputAssemblyState = &ia;
+		state.pipe.pVertexInputState = &state.vi;
+		state.pipe.pInputAssemblyState = &state.ia;
 	}
-	pipe.pMultisampleState = &ms;
-	pipe.pRasterizationState = &raster;
-	pipe.pStages = stages;
-	pipe.stageCount = num_stages;
+	state.pipe.pMultisampleState = &state.ms;
+	state.pipe.pRasterizationState = &state.raster;
+	state.pipe.pStages = state.stages;
+	state.pipe.stageCount = state.num_stages;
+
+	return true;
+}
+
+// Each part of a graphics pipeline library is cached in the Program alongside complete pipelines.
+// The part tag is mixed into the hash so the parts cannot alias monolithic pipelines.
+enum class PipelineLibraryPart : uint32_t
+{
+	VertexInput = 1,
+	PreRasterization,
+	FragmentShader,
+	FragmentOutput,
+	FastLink
+};
+
+static bool pipeline_state_needs_blend_constants(const PipelineState &static_state)
+{
+	const auto needs_blend_constant = [](VkBlendFactor factor) {
+		return factor == VK_BLEND_FACTOR_CONSTANT_COLOR || factor == VK_BLEND_FACTOR_CONSTANT_ALPHA;
+	};
+	bool b0 = needs_blend_constant(static_cast<VkBlendFactor>(static_state.state.src_color_blend));
+	bool b1 = needs_blend_constant(static_cast<VkBlendFactor>(static_state.state.src_alpha_blend));
+	bool b2 = needs_blend_constant(static_cast<VkBlendFactor>(static_state.state.dst_color_blend));
+	bool b3 = needs_blend_constant(static_cast<VkBlendFactor>(static_state.state.dst_alpha_blend));
+	return b0 || b1 || b2 || b3;
+}
+
+static void hash_stage_spec_constants(Hasher &h, const DeferredPipelineCompile &compile, ShaderStage stage)
+{
+	uint32_t mask = compile.layout->get_resource_layout().spec_constant_mask[Util::ecast(stage)] &
+	                get_combined_spec_constant_mask(compile);
+	h.u32(mask);
+	for_each_bit(mask, [&](uint32_t bit) {
+		h.u32(compile.potential_static_state.spec_constants[bit]);
+	});
+}
+
+static void hash_multisample_state(Hasher &h, const DeferredPipelineCompile &compile)
+{
+	auto samples = compile.compatible_render_pass->get_sample_count(compile.subpass_index);
+	h.u32(samples);
+	if (samples > 1)
+	{
+		h.u32(compile.static_state.state.alpha_to_coverage);
+		h.u32(compile.static_state.state.alpha_to_one);
+		h.u32(compile.static_state.state.sample_shading);
+	}
+}
+
+static bool dynamic_state_is_in_library_part(VkDynamicState dynamic_state, PipelineLibraryPart part)
+{
+	switch (dynamic_state)
+	{
+	case VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY:
+	case VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE:
+		return part == PipelineLibraryPart::VertexInput;
+
+	case VK_DYNAMIC_STATE_VIEWPORT:
+	case VK_DYNAMIC_STATE_SCISSOR:
+	case VK_DYNAMIC_STATE_DEPTH_BIAS:
+	case VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE:
+	case VK_DYNAMIC_STATE_CULL_MODE:
+	case VK_DYNAMIC_STATE_FRONT_FACE:
+	case VK_DYNAMIC_STATE_POLYGON_MODE_EXT:
+		return part == PipelineLibraryPart::PreRasterization;
+
+	case VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE:
+	case VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE:
+	case VK_DYNAMIC_STATE_DEPTH_COMPARE_OP:
+	case VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE:
+	case VK_DYNAMIC_STATE_STENCIL_OP:
+	case VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK:
+	case VK_DYNAMIC_STATE_STENCIL_REFERENCE:
+	case VK_DYNAMIC_STATE_STENCIL_WRITE_MASK:
+		return part == PipelineLibraryPart::FragmentShader;
+
+	case VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT:
+	case VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT:
+	case VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT:
+	case VK_DYNAMIC_STATE_BLEND_CONSTANTS:
+	case VK_DYNAMIC_STATE_ALPHA_TO_COVERAGE_ENABLE_EXT:
+		return part == PipelineLibraryPart::FragmentOutput;
+
+	default:
+		return false;
+	}
+}
+
+static Hash hash_pipeline_library_part(const DeferredPipelineCompile &compile, PipelineLibraryPart part)
+{
+	Hasher h;
+	h.u32(Util::ecast(part));
+	h.u32(compile.dynamic_state_mask);
+	auto static_state = get_hashable_static_state(compile);
+	auto &state = static_state.state;
+	auto &layout = compile.layout->get_resource_layout();
+
+	switch (part)
+	{
+	case PipelineLibraryPart::VertexInput:
+	{
+		uint32_t active_vbos = 0;
+		for_each_bit(layout.attribute_mask, [&](uint32_t bit) {
+			h.u32(bit);
+			active_vbos |= 1u << compile.attribs[bit].binding;
+			h.u32(compile.attribs[bit].binding);
+			h.u32(compile.attribs[bit].format);
+			h.u32(compile.attribs[bit].offset);
+		});
+
+		for_each_bit(active_vbos, [&](uint32_t bit) {
+			h.u32(compile.input_rates[bit]);
+			h.u32(compile.strides[bit]);
+		});
+
+		h.u32(state.topology);
+		h.u32(state.primitive_restart);
+		break;
+	}
+
+	case PipelineLibraryPart::PreRasterization:
+		h.u64(compile.program->get_shader(ShaderStage::Vertex)->get_hash());
+		h.u64(compile.layout->get_hash());
+		h.u64(compile.compatible_render_pass->get_hash());
+		h.u32(compile.subpass_index);
+		h.u32(compile.dynamic_rendering);
+		h.u32(state.cull_mode);
+		h.u32(state.front_face);
+		h.u32(state.wireframe);
+		h.u32(state.depth_bias_enable);
+		h.u32(state.conservative_raster);
+		hash_stage_spec_constants(h, compile, ShaderStage::Vertex);
+		break;
+
+	case PipelineLibraryPart::FragmentShader:
+		h.u64(compile.program->get_shader(ShaderStage::Fragment)->get_hash());
+		h.u64(compile.layout->get_hash());
+		h.u64(compile.compatible_render_pass->get_hash());
+		h.u32(compile.subpass_index);
+		h.u32(compile.dynamic_rendering);
+		h.u32(state.depth_test);
+		h.u32(state.depth_write);
+		h.u32(state.depth_compare);
+		h.u32(state.stencil_test);
+		if (state.stencil_test)
+		{
+			h.u32(state.stencil_front_fail);
+			h.u32(state.stencil_front_pass);
+			h.u32(state.stencil_front_depth_fail);
+			h.u32(state.stencil_front_compare_op);
+			h.u32(state.stencil_back_fail);
+			h.u32(state.stencil_back_pass);
+			h.u32(state.stencil_back_depth_fail);
+			h.u32(state.stencil_back_compare_op);
+		}
+		hash_multisample_state(h, compile);
+		hash_stage_spec_constants(h, compile, ShaderStage::Fragment);
+		break;
+
+	case PipelineLibraryPart::FragmentOutput:
+		h.u64(compile.compatible_render_pass->get_hash());
+		h.u32(compile.subpass_index);
+		h.u32(compile.dynamic_rendering);
+		h.u32(layout.render_target_mask);
+		h.u32(state.write_mask);
+		h.u32(state.blend_enable);
+		if (state.blend_enable)
+		{
+			h.u32(state.src_color_blend);
+			h.u32(state.dst_color_blend);
+			h.u32(state.color_blend_op);
+			h.u32(state.src_alpha_blend);
+			h.u32(state.dst_alpha_blend);
+			h.u32(state.alpha_blend_op);
+			if (pipeline_state_needs_blend_constants(compile.static_state))
+				h.data(reinterpret_cast<const uint32_t *>(compile.potential_static_state.blend_constants),
+				       sizeof(compile.potential_static_state.blend_constants));
+		}
+		hash_multisample_state(h, compile);
+		break;
+
+	default:
+		h.u64(compile.hash);
+		break;
+	}
+
+	return h.get();
+}
+
+VkPipeline CommandBuffer::build_graphics_pipeline_library(Device *device, const DeferredPipelineCompile &compile,
+                                                          const GraphicsPipelineCreateState &state,
+                                                          PipelineLibraryPart part)
+{
+	Hash hash = hash_pipeline_library_part(compile, part);
+	auto cached = compile.program->get_pipeline(hash);
+	if (cached.pipeline != VK_NULL_HANDLE)
+		return cached.pipeline;
+
+	VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	VkGraphicsPipelineLibraryCreateInfoEXT library_info =
+			{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT };
+	info.pNext = &library_info;
+	info.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR;
+	if (compile.layout->uses_descriptor_buffer())
+		info.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+
+	// Only hand each library the dynamic state which is relevant to it.
+	VkDynamicState states[24];
+	VkPipelineDynamicStateCreateInfo dyn = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
+	dyn.pDynamicStates = states;
+	for (uint32_t i = 0; i < state.dyn.dynamicStateCount; i++)
+		if (dynamic_state_is_in_library_part(state.states[i], part))
+			states[dyn.dynamicStateCount++] = state.states[i];
+	if (dyn.dynamicStateCount)
+		info.pDynamicState = &dyn;
+
+	VkPipelineShaderStageCreateInfo stage = {};
+
+	const auto find_stage = [&](VkShaderStageFlagBits bit) -> bool {
+		for (unsigned i = 0; i < state.num_stages; i++)
+		{
+			if (state.stages[i].stage == bit)
+			{
+				stage = state.stages[i];
+				return true;
+			}
+		}
+		return false;
+	};
+
+	switch (part)
+	{
+	case PipelineLibraryPart::VertexInput:
+		library_info.flags = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+		info.pVertexInputState = &state.vi;
+		info.pInputAssemblyState = &state.ia;
+		break;
+
+	case PipelineLibraryPart::PreRasterization:
+		library_info.flags = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+		if (!find_stage(VK_SHADER_STAGE_VERTEX_BIT))
+			return VK_NULL_HANDLE;
+		info.layout = compile.layout->get_layout();
+		info.renderPass = compile.compatible_render_pass->get_render_pass();
+		info.subpass = compile.subpass_index;
+		info.pStages = &stage;
+		info.stageCount = 1;
+		info.pViewportState = &state.vp;
+		info.pRasterizationState = &state.raster;
+		break;
+
+	case PipelineLibraryPart::FragmentShader:
+		library_info.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+		if (!find_stage(VK_SHADER_STAGE_FRAGMENT_BIT))
+			return VK_NULL_HANDLE;
+		info.layout = compile.layout->get_layout();
+		info.renderPass = compile.compatible_render_pass->get_render_pass();
+		info.subpass = compile.subpass_index;
+		info.pStages = &stage;
+		info.stageCount = 1;
+		info.pDepthStencilState = &state.ds;
+		info.pMultisampleState = &state.ms;
+		break;
+
+	case PipelineLibraryPart::FragmentOutput:
+		library_info.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+		info.renderPass = compile.compatible_render_pass->get_render_pass();
+		info.subpass = compile.subpass_index;
+		info.pColorBlendState = &state.blend;
+		info.pMultisampleState = &state.ms;
+		break;
+
+	default:
+		return VK_NULL_HANDLE;
+	}
+
+	// With dynamic rendering, the render pass is replaced by VkPipelineRenderingCreateInfo.
+	if (compile.dynamic_rendering && part != PipelineLibraryPart::VertexInput)
+	{
+		info.renderPass = VK_NULL_HANDLE;
+		info.subpass = 0;
+		library_info.pNext = &state.rendering;
+	}
+
+	auto &table = device->get_device_table();
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	auto start_ts = Util::get_current_time_nsecs();
+	VkResult res = table.vkCreateGraphicsPipelines(device->get_device(), compile.cache, 1, &info, nullptr, &pipeline);
+	auto end_ts = Util::get_current_time_nsecs();
+	log_compile_time("graphics-library", hash, end_ts - start_ts, res, CompileMode::Sync);
+
+	if (res != VK_SUCCESS || pipeline == VK_NULL_HANDLE)
+	{
+		LOGE("Failed to create graphics pipeline library.\n");
+		return VK_NULL_HANDLE;
+	}
+
+	auto returned_pipeline = compile.program->add_pipeline(hash, { pipeline, 0 });
+	if (returned_pipeline.pipeline != pipeline)
+		table.vkDestroyPipeline(device->get_device(), pipeline, nullptr);
+	return returned_pipeline.pipeline;
+}
+
+bool CommandBuffer::supports_graphics_pipeline_fast_link(Device *device, const DeferredPipelineCompile &compile)
+{
+	auto &features = device->get_device_features();
+	if (!features.graphics_pipeline_library_features.graphicsPipelineLibrary ||
+	    !features.graphics_pipeline_library_properties.graphicsPipelineLibraryFastLinking)
+	{
+		return false;
+	}
+
+	// Mesh shading and NV device generated commands always go through the monolithic path.
+	if (!compile.program->get_shader(ShaderStage::Vertex) ||
+	    !compile.program->get_shader(ShaderStage::Fragment) ||
+	    !compile.program_group.empty())
+	{
+		return false;
+	}
+
+#ifdef GRANITE_VULKAN_SYSTEM_HANDLES
+	// Without a thread group we would never get around to replacing the linked pipeline.
+	return device->get_system_handles().thread_group != nullptr;
+#else
+	return false;
+#endif
+}
+
+void CommandBuffer::kick_optimized_graphics_pipeline(Device *device, const DeferredPipelineCompile &compile)
+{
+#ifdef GRANITE_VULKAN_SYSTEM_HANDLES
+	auto state = device->pipeline_library;
+	{
+		std::lock_guard<std::mutex> holder{state->lock};
+		if (!state->pending.insert(compile.hash).second)
+			return;
+	}
+
+	auto task_compile = std::make_shared<DeferredPipelineCompile>(compile);
+	auto task = device->get_system_handles().thread_group->create_task([device, state, task_compile]() {
+		{
+			// The Device may be gone by the time this runs. It waits for compiles which have started,
+			// but cancels the rest.
+			std::lock_guard<std::mutex> holder{state->lock};
+			if (state->shutdown)
+			{
+				state->pending.erase(task_compile->hash);
+				state->cond.notify_all();
+				return;
+			}
+			state->compiling++;
+		}
+
+		auto pipeline = build_graphics_pipeline(device, *task_compile, CompileMode::AsyncThread);
+
+		std::lock_guard<std::mutex> holder{state->lock};
+		if (pipeline.pipeline != VK_NULL_HANDLE)
+			state->stats.optimized++;
+		state->compiling--;
+		state->pending.erase(task_compile->hash);
+		state->cond.notify_all();
+	});
+	task->set_desc("optimize-graphics-pipeline");
+	task->set_task_class(Granite::TaskClass::Background);
+#else
+	(void)device;
+	(void)compile;
+#endif
+}
+
+Pipeline CommandBuffer::build_graphics_pipeline_fast_link(Device *device, const DeferredPipelineCompile &compile)
+{
+	Util::RWSpinLockReadHolder holder{device->lock.read_only_cache};
+
+	Hash link_hash = hash_pipeline_library_part(compile, PipelineLibraryPart::FastLink);
+	auto linked = compile.program->get_pipeline(link_hash);
+	if (linked.pipeline != VK_NULL_HANDLE)
+		return linked;
+
+	GraphicsPipelineCreateState state;
+	if (!setup_graphics_pipeline_state(device, compile, state))
+		return {};
+
+	static const PipelineLibraryPart parts[] = {
+		PipelineLibraryPart::VertexInput,
+		PipelineLibraryPart::PreRasterization,
+		PipelineLibraryPart::FragmentShader,
+		PipelineLibraryPart::FragmentOutput,
+	};
+
+	VkPipeline libraries[4];
+	for (unsigned i = 0; i < 4; i++)
+	{
+		libraries[i] = build_graphics_pipeline_library(device, compile, state, parts[i]);
+		if (libraries[i] == VK_NULL_HANDLE)
+			return {};
+	}
+
+	VkPipelineLibraryCreateInfoKHR link_info = { VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR };
+	link_info.libraryCount = 4;
+	link_info.pLibraries = libraries;
+
+	VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+	info.pNext = &link_info;
+	info.layout = compile.layout->get_layout();
+	if (compile.layout->uses_descriptor_buffer())
+		info.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+
+	auto &table = device->get_device_table();
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	auto start_ts = Util::get_current_time_nsecs();
+	VkResult res = table.vkCreateGraphicsPipelines(device->get_device(), compile.cache, 1, &info, nullptr, &pipeline);
+	auto end_ts = Util::get_current_time_nsecs();
+	log_compile_time("graphics-link", link_hash, end_ts - start_ts, res, CompileMode::Sync);
+
+	if (res != VK_SUCCESS || pipeline == VK_NULL_HANDLE)
+	{
+		LOGE("Failed to link graphics pipeline libraries.\n");
+		return {};
+	}
+
+	auto returned_pipeline = compile.program->add_pipeline(link_hash, { pipeline, state.dynamic_mask });
+	if (returned_pipeline.pipeline != pipeline)
+	{
+		table.vkDestroyPipeline(device->get_device(), pipeline, nullptr);
+	}
+	else
+	{
+		{
+			std::lock_guard<std::mutex> stats_holder{device->pipeline_library->lock};
+			device->pipeline_library->stats.fast_linked++;
+		}
+		kick_optimized_graphics_pipeline(device, compile);
+	}
+
+	return returned_pipeline;
+}
+
+Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPipelineCompile &compile,
+                                                CompileMode mode)
+{
+	// This can be called from outside a CommandBuffer content, so need to hold lock.
+	Util::RWSpinLockReadHolder holder{device->lock.read_only_cache};
+
+	// If we don't have pipeline creation cache control feature,
+	// we must assume compilation can be synchronous.
+	if (mode == CompileMode::FailOnCompileRequired &&
+	    (device->get_workarounds().broken_pipeline_cache_control ||
+	     !device->get_device_features().vk13_features.pipelineCreationCacheControl))
+	{
+		return {};
+	}
+
+	// Unsupported. Gets pretty complicated since if any dependent pipeline fails, we have to abort.
+	if (mode == CompileMode::FailOnCompileRequired && !compile.program_group.empty())
+		return {};
+
+	GraphicsPipelineCreateState state;
+	if (!setup_graphics_pipeline_state(device, compile, state))
+		return {};
+	auto &pipe = state.pipe;
 
 	VkGraphicsPipelineShaderGroupsCreateInfoNV groups_info =
 			{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_SHADER_GROUPS_CREATE_INFO_NV };
@@ -1602,7 +2378,7 @@ Pipeline CommandBuffer::build_graphics_pipeline(Device *device, const DeferredPi
 		return {};
 	}
 
-	auto returned_pipeline = compile.program->add_pipeline(compile.hash, { pipeline, dynamic_mask });
+	auto returned_pipeline = compile.program->add_pipeline(compile.hash, { pipeline, state.dynamic_mask });
 	if (returned_pipeline.pipeline != pipeline)
 		table.vkDestroyPipeline(device->get_device(), pipeline, nullptr);
 	return returned_pipeline;
@@ -1618,6 +2394,10 @@ bool CommandBuffer::flush_compute_pipeline(bool synchronous)
 			device, pipeline_state,
 			synchronous ? CompileMode::Sync : CompileMode::FailOnCompileRequired);
 	}
+#ifdef GRANITE_VULKAN_FOSSILIZE
+	if (current_pipeline.replay_slot != ~0u)
+		device->register_replayed_pipeline_use(current_pipeline.replay_slot);
+#endif
 	return current_pipeline.pipeline != VK_NULL_HANDLE;
 }
 
@@ -1676,22 +2456,19 @@ void CommandBuffer::update_hash_graphics_pipeline(DeferredPipelineCompile &compi
 
 	h.u64(compile.compatible_render_pass->get_hash());
 	h.u32(compile.subpass_index);
+	h.u32(compile.dynamic_rendering);
 	h.u64(compile.program->get_hash());
 	for (auto *p : compile.program_group)
 		h.u64(p->get_hash());
 	h.u64(compile.layout->get_hash());
-	h.data(compile.static_state.words, sizeof(compile.static_state.words));
-
-	if (compile.static_state.state.blend_enable)
-	{
-		const auto needs_blend_constant = [](VkBlendFactor factor) {
-			return factor == VK_BLEND_FACTOR_CONSTANT_COLOR || factor == VK_BLEND_FACTOR_CONSTANT_ALPHA;
-		};
-		bool b0 = needs_blend_constant(static_cast<VkBlendFactor>(compile.static_state.state.src_color_blend));
-		bool b1 = needs_blend_constant(static_cast<VkBlendFactor>(compile.static_state.state.src_alpha_blend));
-		bool b2 = needs_blend_constant(static_cast<VkBlendFactor>(compile.static_state.state.dst_color_blend));
-		bool b3 = needs_blend_constant(static_cast<VkBlendFactor>(compile.static_state.state.dst_alpha_blend));
-		if (b0 || b1 || b2 || b3)
+
+	auto static_state = get_hashable_static_state(compile);
+	h.data(static_state.words, sizeof(static_state.words));
+	h.u32(compile.dynamic_state_mask);
+
+	if (static_state.state.blend_enable)
+	{
+		if (pipeline_state_needs_blend_constants(compile.static_state))
 			h.data(reinterpret_cast<const uint32_t *>(compile.potential_static_state.blend_constants),
 			       sizeof(compile.potential_static_state.blend_constants));
 	}
@@ -1745,8 +2522,21 @@ bool CommandBuffer::flush_graphics_pipeline(bool synchronous)
 	auto mode = synchronous ? CompileMode::Sync : CompileMode::FailOnCompileRequired;
 	update_hash_graphics_pipeline(pipeline_state, mode, &active_vbos);
 	current_pipeline = pipeline_state.program->get_pipeline(pipeline_state.hash);
+
+	// If the optimized pipeline is not ready yet, avoid a hitch by fast-linking pre-compiled libraries.
+	// The optimized pipeline is compiled in the background and picked up on a later flush.
+	if (current_pipeline.pipeline == VK_NULL_HANDLE && mode == CompileMode::Sync &&
+	    supports_graphics_pipeline_fast_link(device, pipeline_state))
+	{
+		current_pipeline = build_graphics_pipeline_fast_link(device, pipeline_state);
+	}
+
 	if (current_pipeline.pipeline == VK_NULL_HANDLE)
 		current_pipeline = build_graphics_pipeline(device, pipeline_state, mode);
+#ifdef GRANITE_VULKAN_FOSSILIZE
+	if (current_pipeline.replay_slot != ~0u)
+		device->register_replayed_pipeline_use(current_pipeline.replay_slot);
+#endif
 	return current_pipeline.pipeline != VK_NULL_HANDLE;
 }
 
@@ -1819,6 +2609,10 @@ VkPipeline CommandBuffer::flush_render_state(bool synchronous)
 		if (old_pipe != current_pipeline.pipeline)
 			bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, current_pipeline.pipeline, current_pipeline.dynamic_mask);
 
+		// Any static state change may have touched state which is dynamic in the pipeline.
+		if (pipeline_state.dynamic_state_mask)
+			set_dirty(COMMAND_BUFFER_DIRTY_EXTENDED_DYNAMIC_STATE_BIT);
+
 #ifdef VULKAN_DEBUG
 		if (current_framebuffer_surface_transform != VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
 		{
@@ -1853,7 +2647,7 @@ VkPipeline CommandBuffer::flush_render_state(bool synchronous)
 		{
 			auto tmp_viewport = viewport;
 			viewport_transform_xy(tmp_viewport, current_framebuffer_surface_transform,
-			                      framebuffer->get_width(), framebuffer->get_height());
+			                      framebuffer_width, framebuffer_height);
 			table.vkCmdSetViewport(cmd, 0, 1, &tmp_viewport);
 		}
 		else
@@ -1864,11 +2658,17 @@ VkPipeline CommandBuffer::flush_render_state(bool synchronous)
 	{
 		auto tmp_scissor = scissor;
 		rect2d_transform_xy(tmp_scissor, current_framebuffer_surface_transform,
-							framebuffer->get_width(), framebuffer->get_height());
+							framebuffer_width, framebuffer_height);
 		rect2d_clip(tmp_scissor);
 		table.vkCmdSetScissor(cmd, 0, 1, &tmp_scissor);
 	}
 
+	if ((current_pipeline.dynamic_mask & COMMAND_BUFFER_DIRTY_EXTENDED_DYNAMIC_STATE_BIT) &&
+	    get_and_clear(COMMAND_BUFFER_DIRTY_EXTENDED_DYNAMIC_STATE_BIT))
+	{
+		flush_extended_dynamic_state();
+	}
+
 	if (pipeline_state.static_state.state.depth_bias_enable && get_and_clear(COMMAND_BUFFER_DIRTY_DEPTH_BIAS_BIT))
 		table.vkCmdSetDepthBias(cmd, dynamic_state.depth_bias_constant, 0.0f, dynamic_state.depth_bias_slope);
 	if (pipeline_state.static_state.state.stencil_test && get_and_clear(COMMAND_BUFFER_DIRTY_STENCIL_REFERENCE_BIT))
@@ -1894,6 +2694,80 @@ VkPipeline CommandBuffer::flush_render_state(bool synchronous)
 	return current_pipeline.pipeline;
 }
 
+void CommandBuffer::flush_extended_dynamic_state()
+{
+	auto &state = pipeline_state.static_state.state;
+	auto *rp = pipeline_state.compatible_render_pass;
+	unsigned subpass = pipeline_state.subpass_index;
+
+	if (pipeline_state.dynamic_state_mask & PIPELINE_DYNAMIC_STATE_EXTENDED_BIT)
+	{
+		table.vkCmdSetCullMode(cmd, static_cast<VkCullModeFlags>(state.cull_mode));
+		table.vkCmdSetFrontFace(cmd, static_cast<VkFrontFace>(state.front_face));
+		table.vkCmdSetDepthTestEnable(cmd, rp->has_depth(subpass) && state.depth_test);
+		table.vkCmdSetDepthWriteEnable(cmd, rp->has_depth(subpass) && state.depth_write);
+		table.vkCmdSetDepthCompareOp(cmd, static_cast<VkCompareOp>(state.depth_compare));
+		table.vkCmdSetDepthBiasEnable(cmd, state.depth_bias_enable);
+		table.vkCmdSetStencilTestEnable(cmd, rp->has_stencil(subpass) && state.stencil_test);
+		table.vkCmdSetStencilOp(cmd, VK_STENCIL_FACE_FRONT_BIT,
+		                        static_cast<VkStencilOp>(state.stencil_front_fail),
+		                        static_cast<VkStencilOp>(state.stencil_front_pass),
+		                        static_cast<VkStencilOp>(state.stencil_front_depth_fail),
+		                        static_cast<VkCompareOp>(state.stencil_front_compare_op));
+		table.vkCmdSetStencilOp(cmd, VK_STENCIL_FACE_BACK_BIT,
+		                        static_cast<VkStencilOp>(state.stencil_back_fail),
+		                        static_cast<VkStencilOp>(state.stencil_back_pass),
+		                        static_cast<VkStencilOp>(state.stencil_back_depth_fail),
+		                        static_cast<VkCompareOp>(state.stencil_back_compare_op));
+
+		if (pipeline_state.program->get_shader(ShaderStage::Vertex))
+		{
+			table.vkCmdSetPrimitiveTopology(cmd, static_cast<VkPrimitiveTopology>(state.topology));
+			table.vkCmdSetPrimitiveRestartEnable(cmd, state.primitive_restart);
+		}
+	}
+
+	if (pipeline_state.dynamic_state_mask & PIPELINE_DYNAMIC_STATE_EXTENDED_3_BIT)
+	{
+		VkBool32 blend_enables[VULKAN_NUM_ATTACHMENTS] = {};
+		VkColorBlendEquationEXT equations[VULKAN_NUM_ATTACHMENTS] = {};
+		VkColorComponentFlags write_masks[VULKAN_NUM_ATTACHMENTS] = {};
+
+		// Mirrors the static blend state setup in setup_graphics_pipeline_state().
+		unsigned num_attachments = rp->get_num_color_attachments(subpass);
+		for (unsigned i = 0; i < num_attachments; i++)
+		{
+			if (rp->get_color_attachment(subpass, i).attachment != VK_ATTACHMENT_UNUSED &&
+			    (pipeline_state.layout->get_resource_layout().render_target_mask & (1u << i)))
+			{
+				write_masks[i] = (state.write_mask >> (4 * i)) & 0xf;
+				blend_enables[i] = state.blend_enable;
+				if (blend_enables[i])
+				{
+					auto &eq = equations[i];
+					eq.alphaBlendOp = static_cast<VkBlendOp>(state.alpha_blend_op);
+					eq.colorBlendOp = static_cast<VkBlendOp>(state.color_blend_op);
+					eq.dstAlphaBlendFactor = static_cast<VkBlendFactor>(state.dst_alpha_blend);
+					eq.srcAlphaBlendFactor = static_cast<VkBlendFactor>(state.src_alpha_blend);
+					eq.dstColorBlendFactor = static_cast<VkBlendFactor>(state.dst_color_blend);
+					eq.srcColorBlendFactor = static_cast<VkBlendFactor>(state.src_color_blend);
+				}
+			}
+		}
+
+		if (num_attachments)
+		{
+			table.vkCmdSetColorBlendEnableEXT(cmd, 0, num_attachments, blend_enables);
+			table.vkCmdSetColorBlendEquationEXT(cmd, 0, num_attachments, equations);
+			table.vkCmdSetColorWriteMaskEXT(cmd, 0, num_attachments, write_masks);
+		}
+
+		table.vkCmdSetBlendConstants(cmd, pipeline_state.potential_static_state.blend_constants);
+		table.vkCmdSetPolygonModeEXT(cmd, state.wireframe ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL);
+		table.vkCmdSetAlphaToCoverageEnableEXT(cmd, rp->get_sample_count(subpass) > 1 && state.alpha_to_coverage);
+	}
+}
+
 bool CommandBuffer::flush_pipeline_state_without_blocking()
 {
 	if (is_compute)
@@ -1969,7 +2843,7 @@ PipelineEvent CommandBuffer::signal_event(const VkDependencyInfo &dep)
 void CommandBuffer::set_vertex_attrib(uint32_t attrib, uint32_t binding, VkFormat format, VkDeviceSize offset)
 {
 	VK_ASSERT(attrib < VULKAN_NUM_VERTEX_ATTRIBS);
-	VK_ASSERT(framebuffer);
+	VK_ASSERT(actual_render_pass);
 
 	auto &attr = pipeline_state.attribs[attrib];
 
@@ -2002,7 +2876,7 @@ void CommandBuffer::set_vertex_binding(uint32_t binding, const Buffer &buffer, V
                                        VkVertexInputRate step_rate)
 {
 	VK_ASSERT(binding < VULKAN_NUM_VERTEX_BUFFERS);
-	VK_ASSERT(framebuffer);
+	VK_ASSERT(actual_render_pass);
 
 	VkBuffer vkbuffer = buffer.get_buffer();
 	if (vbo.buffers[binding] != vkbuffer || vbo.offsets[binding] != offset)
@@ -2018,7 +2892,7 @@ void CommandBuffer::set_vertex_binding(uint32_t binding, const Buffer &buffer, V
 
 void CommandBuffer::set_viewport(const VkViewport &viewport_)
 {
-	VK_ASSERT(framebuffer);
+	VK_ASSERT(actual_render_pass);
 	viewport = viewport_;
 	set_dirty(COMMAND_BUFFER_DIRTY_VIEWPORT_BIT);
 }
@@ -2030,7 +2904,7 @@ const VkViewport &CommandBuffer::get_viewport() const
 
 void CommandBuffer::set_scissor(const VkRect2D &rect)
 {
-	VK_ASSERT(framebuffer);
+	VK_ASSERT(actual_render_pass);
 	VK_ASSERT(rect.offset.x >= 0);
 	VK_ASSERT(rect.offset.y >= 0);
 	scissor = rect;
@@ -2097,7 +2971,7 @@ void CommandBuffer::set_program_group(Program *const *programs, unsigned num_pro
 	if (!num_programs)
 		return;
 
-	VK_ASSERT(framebuffer && pipeline_state.program->get_shader(ShaderStage::Fragment));
+	VK_ASSERT(actual_render_pass && pipeline_state.program->get_shader(ShaderStage::Fragment));
 #ifdef VULKAN_DEBUG
 	for (unsigned i = 0; i < num_programs; i++)
 		VK_ASSERT(pipeline_state.program_group[i]->get_shader(ShaderStage::Fragment));
@@ -2127,8 +3001,8 @@ void CommandBuffer::set_program(Program *program)
 	if (!program)
 		return;
 
-	VK_ASSERT((framebuffer && pipeline_state.program->get_shader(ShaderStage::Fragment)) ||
-	          (!framebuffer && pipeline_state.program->get_shader(ShaderStage::Compute)));
+	VK_ASSERT((actual_render_pass && pipeline_state.program->get_shader(ShaderStage::Fragment)) ||
+	          (!actual_render_pass && pipeline_state.program->get_shader(ShaderStage::Compute)));
 
 	set_program_layout(program->get_pipeline_layout());
 }
@@ -2294,6 +3168,8 @@ void CommandBuffer::set_uniform_buffer(unsigned set, unsigned binding, const Buf
 	{
 		b.buffer = { buffer.get_buffer(), 0, range };
 		b.dynamic_offset = offset;
+		if (device->get_device_features().supports_descriptor_buffer)
+			b.buffer_address = buffer.get_device_address();
 		bindings.cookies[set][binding] = buffer.get_cookie();
 		bindings.secondary_cookies[set][binding] = 0;
 		dirty_sets |= 1u << set;
@@ -2313,6 +3189,8 @@ void CommandBuffer::set_storage_buffer(unsigned set, unsigned binding, const Buf
 
 	b.buffer = { buffer.get_buffer(), offset, range };
 	b.dynamic_offset = 0;
+	if (device->get_device_features().supports_descriptor_buffer)
+		b.buffer_address = buffer.get_device_address();
 	bindings.cookies[set][binding] = buffer.get_cookie();
 	bindings.secondary_cookies[set][binding] = 0;
 	dirty_sets |= 1u << set;
@@ -2493,6 +3371,28 @@ void CommandBuffer::set_unorm_storage_texture(unsigned set, unsigned binding, co
 	            view.get_image().get_layout(VK_IMAGE_LAYOUT_GENERAL), view.get_cookie() | COOKIE_BIT_UNORM);
 }
 
+void CommandBuffer::push_descriptor_set(uint32_t set)
+{
+	auto &set_layout = pipeline_state.layout->get_resource_layout().sets[set];
+	auto update_template = pipeline_state.layout->get_update_template(set);
+	VK_ASSERT(update_template);
+
+	// Push descriptor UBOs are not dynamic, so resolve the dynamic offset here.
+	ResourceBinding push_bindings[VULKAN_NUM_BINDINGS];
+	memcpy(push_bindings, bindings.bindings[set], sizeof(push_bindings));
+	for_each_bit(set_layout.uniform_buffer_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.array_size[binding];
+		for (unsigned i = 0; i < array_size; i++)
+		{
+			VK_ASSERT(push_bindings[binding + i].buffer.buffer != VK_NULL_HANDLE);
+			push_bindings[binding + i].buffer.offset += push_bindings[binding + i].dynamic_offset;
+		}
+	});
+
+	table.vkCmdPushDescriptorSetWithTemplateKHR(cmd, update_template, current_pipeline_layout, set, push_bindings);
+	allocated_sets[set] = VK_NULL_HANDLE;
+}
+
 void CommandBuffer::rebind_descriptor_set(uint32_t set)
 {
 	auto &layout = pipeline_state.layout->get_resource_layout();
@@ -2504,6 +3404,12 @@ void CommandBuffer::rebind_descriptor_set(uint32_t set)
 		return;
 	}
 
+	if (pipeline_state.layout->get_push_descriptor_set_mask() & (1u << set))
+	{
+		push_descriptor_set(set);
+		return;
+	}
+
 	auto &set_layout = layout.sets[set];
 	uint32_t num_dynamic_offsets = 0;
 	uint32_t dynamic_offsets[VULKAN_NUM_BINDINGS];
@@ -2533,6 +3439,13 @@ void CommandBuffer::flush_descriptor_set(uint32_t set)
 		return;
 	}
 
+	// No hashing or set allocation required.
+	if (pipeline_state.layout->get_push_descriptor_set_mask() & (1u << set))
+	{
+		push_descriptor_set(set);
+		return;
+	}
+
 	auto &set_layout = layout.sets[set];
 	uint32_t num_dynamic_offsets = 0;
 	uint32_t dynamic_offsets[VULKAN_NUM_BINDINGS];
@@ -2652,10 +3565,203 @@ void CommandBuffer::flush_descriptor_set(uint32_t set)
 	allocated_sets[set] = allocated.first;
 }
 
+void CommandBuffer::write_descriptor_buffer_set(uint32_t set, uint8_t *data)
+{
+	auto &set_layout = pipeline_state.layout->get_resource_layout().sets[set];
+	auto *allocator = pipeline_state.layout->get_allocator(set);
+	auto &features = device->get_device_features();
+	auto &props = features.descriptor_buffer_properties;
+	auto *set_bindings = bindings.bindings[set];
+	bool robust = features.enabled_features.robustBufferAccess == VK_TRUE;
+
+	const auto write_descriptor = [&](VkDescriptorType type, const VkDescriptorDataEXT &descriptor,
+	                                  size_t size, VkDeviceSize offset) {
+		VkDescriptorGetInfoEXT info = { VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT };
+		info.type = type;
+		info.data = descriptor;
+		table.vkGetDescriptorEXT(device->get_device(), &info, size, data + offset);
+	};
+
+	// UBOs are not dynamic, so resolve the dynamic offset here.
+	for_each_bit(set_layout.uniform_buffer_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.array_size[binding];
+		size_t size = robust ? props.robustUniformBufferDescriptorSize : props.uniformBufferDescriptorSize;
+		for (unsigned i = 0; i < array_size; i++)
+		{
+			auto &b = set_bindings[binding + i];
+			VK_ASSERT(b.buffer.buffer != VK_NULL_HANDLE);
+			VkDescriptorAddressInfoEXT addr = { VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT };
+			addr.address = b.buffer_address + b.buffer.offset + b.dynamic_offset;
+			addr.range = b.buffer.range;
+			VkDescriptorDataEXT descriptor;
+			descriptor.pUniformBuffer = &addr;
+			write_descriptor(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptor, size,
+			                 allocator->get_descriptor_buffer_offset(binding) + i * size);
+		}
+	});
+
+	for_each_bit(set_layout.storage_buffer_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.array_size[binding];
+		size_t size = robust ? props.robustStorageBufferDescriptorSize : props.storageBufferDescriptorSize;
+		for (unsigned i = 0; i < array_size; i++)
+		{
+			auto &b = set_bindings[binding + i];
+			VK_ASSERT(b.buffer.buffer != VK_NULL_HANDLE);
+			VkDescriptorAddressInfoEXT addr = { VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT };
+			addr.address = b.buffer_address + b.buffer.offset;
+			addr.range = b.buffer.range;
+			VkDescriptorDataEXT descriptor;
+			descriptor.pStorageBuffer = &addr;
+			write_descriptor(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, descriptor, size,
+			                 allocator->get_descriptor_buffer_offset(binding) + i * size);
+		}
+	});
+
+	for_each_bit(set_layout.sampled_image_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.array_size[binding];
+		VkDeviceSize offset = allocator->get_descriptor_buffer_offset(binding);
+		for (unsigned i = 0; i < array_size; i++)
+		{
+			auto &b = set_bindings[binding + i];
+			auto &image = (set_layout.fp_mask & (1u << binding)) ? b.image.fp : b.image.integer;
+			VK_ASSERT(image.imageView != VK_NULL_HANDLE && image.sampler != VK_NULL_HANDLE);
+			VkDescriptorDataEXT descriptor;
+
+			// Some implementations want arrays of combined image samplers split into
+			// an array of images followed by an array of samplers.
+			if (array_size > 1 && !props.combinedImageSamplerDescriptorSingleArray)
+			{
+				descriptor.pSampledImage = &image;
+				write_descriptor(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, descriptor, props.sampledImageDescriptorSize,
+				                 offset + i * props.sampledImageDescriptorSize);
+				descriptor.pSampler = &image.sampler;
+				write_descriptor(VK_DESCRIPTOR_TYPE_SAMPLER, descriptor, props.samplerDescriptorSize,
+				                 offset + array_size * props.sampledImageDescriptorSize +
+				                 i * props.samplerDescriptorSize);
+			}
+			else
+			{
+				descriptor.pCombinedImageSampler = &image;
+				write_descriptor(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, descriptor,
+				                 props.combinedImageSamplerDescriptorSize,
+				                 offset + i * props.combinedImageSamplerDescriptorSize);
+			}
+		}
+	});
+
+	for_each_bit(set_layout.separate_image_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.array_size[binding];
+		for (unsigned i = 0; i < array_size; i++)
+		{
+			auto &b = set_bindings[binding + i];
+			auto &image = (set_layout.fp_mask & (1u << binding)) ? b.image.fp : b.image.integer;
+			VK_ASSERT(image.imageView != VK_NULL_HANDLE);
+			VkDescriptorDataEXT descriptor;
+			descriptor.pSampledImage = &image;
+			write_descriptor(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, descriptor, props.sampledImageDescriptorSize,
+			                 allocator->get_descriptor_buffer_offset(binding) + i * props.sampledImageDescriptorSize);
+		}
+	});
+
+	for_each_bit(set_layout.sampler_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.array_size[binding];
+		for (unsigned i = 0; i < array_size; i++)
+		{
+			auto &b = set_bindings[binding + i];
+			VK_ASSERT(b.image.fp.sampler != VK_NULL_HANDLE);
+			VkDescriptorDataEXT descriptor;
+			descriptor.pSampler = &b.image.fp.sampler;
+			write_descriptor(VK_DESCRIPTOR_TYPE_SAMPLER, descriptor, props.samplerDescriptorSize,
+			                 allocator->get_descriptor_buffer_offset(binding) + i * props.samplerDescriptorSize);
+		}
+	});
+
+	for_each_bit(set_layout.storage_image_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.array_size[binding];
+		for (unsigned i = 0; i < array_size; i++)
+		{
+			auto &b = set_bindings[binding + i];
+			auto &image = (set_layout.fp_mask & (1u << binding)) ? b.image.fp : b.image.integer;
+			VK_ASSERT(image.imageView != VK_NULL_HANDLE);
+			VkDescriptorDataEXT descriptor;
+			descriptor.pStorageImage = &image;
+			write_descriptor(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, descriptor, props.storageImageDescriptorSize,
+			                 allocator->get_descriptor_buffer_offset(binding) + i * props.storageImageDescriptorSize);
+		}
+	});
+
+	for_each_bit(set_layout.input_attachment_mask, [&](uint32_t binding) {
+		unsigned array_size = set_layout.array_size[binding];
+		for (unsigned i = 0; i < array_size; i++)
+		{
+			auto &b = set_bindings[binding + i];
+			auto &image = (set_layout.fp_mask & (1u << binding)) ? b.image.fp : b.image.integer;
+			VK_ASSERT(image.imageView != VK_NULL_HANDLE);
+			VkDescriptorDataEXT descriptor;
+			descriptor.pInputAttachmentImage = &image;
+			write_descriptor(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, descriptor, props.inputAttachmentDescriptorSize,
+			                 allocator->get_descriptor_buffer_offset(binding) + i * props.inputAttachmentDescriptorSize);
+		}
+	});
+}
+
+void CommandBuffer::flush_descriptor_buffer_sets(uint32_t set_mask)
+{
+	auto *layout = pipeline_state.layout;
+	VkDeviceSize alignment =
+			std::max<VkDeviceSize>(16u, device->get_device_features().descriptor_buffer_properties.descriptorBufferOffsetAlignment);
+
+	const auto required_size = [&](uint32_t mask) -> VkDeviceSize {
+		VkDeviceSize size = 0;
+		for_each_bit(mask, [&](uint32_t set) {
+			size += (layout->get_allocator(set)->get_descriptor_buffer_size() + alignment - 1) & ~(alignment - 1);
+		});
+		return size;
+	};
+
+	VkDeviceSize aligned_offset = (descriptor_block.offset + alignment - 1) & ~(alignment - 1);
+	if (!descriptor_block.mapped || aligned_offset + required_size(set_mask) > descriptor_block.size)
+	{
+		// Set offsets are relative to the bound descriptor buffer, so moving on to a new block
+		// means every set in the layout has to be written again.
+		set_mask = layout->get_resource_layout().descriptor_set_mask;
+		device->request_descriptor_block(descriptor_block, required_size(set_mask));
+
+		VkDescriptorBufferBindingInfoEXT info = { VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT };
+		info.address = descriptor_block.buffer->get_device_address();
+		info.usage = VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+		             VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT;
+		table.vkCmdBindDescriptorBuffersEXT(cmd, 1, &info);
+	}
+
+	const uint32_t buffer_index = 0;
+	for_each_bit(set_mask, [&](uint32_t set) {
+		auto data = descriptor_block.allocate(layout->get_allocator(set)->get_descriptor_buffer_size());
+		VK_ASSERT(data.host);
+		write_descriptor_buffer_set(set, data.host);
+		table.vkCmdSetDescriptorBufferOffsetsEXT(cmd,
+		                                         actual_render_pass ? VK_PIPELINE_BIND_POINT_GRAPHICS : VK_PIPELINE_BIND_POINT_COMPUTE,
+		                                         current_pipeline_layout, set, 1, &buffer_index, &data.offset);
+		allocated_sets[set] = VK_NULL_HANDLE;
+	});
+}
+
 void CommandBuffer::flush_descriptor_sets()
 {
 	auto &layout = pipeline_state.layout->get_resource_layout();
 
+	// Descriptors are written linearly, so there is nothing to hash or rebind.
+	// Dynamic UBO offsets are folded into the descriptors, so those sets are written again as well.
+	if (pipeline_state.layout->uses_descriptor_buffer())
+	{
+		uint32_t set_update = layout.descriptor_set_mask & (dirty_sets | dirty_sets_dynamic);
+		if (set_update)
+			flush_descriptor_buffer_sets(set_update);
+		dirty_sets &= ~set_update;
+		dirty_sets_dynamic &= ~set_update;
+		return;
+	}
+
 	uint32_t set_update = layout.descriptor_set_mask & dirty_sets;
 	for_each_bit(set_update, [&](uint32_t set) { flush_descriptor_set(set); });
 	dirty_sets &= ~set_update;
@@ -3125,6 +4231,8 @@ void CommandBuffer::end()
 		device->request_uniform_block_nolock(ubo_block, 0);
 	if (staging_block.mapped)
 		device->request_staging_block_nolock(staging_block, 0);
+	if (descriptor_block.mapped)
+		device->request_descriptor_block_nolock(descriptor_block, 0);
 }
 
 void CommandBuffer::begin_region(const char *name, const float *color)
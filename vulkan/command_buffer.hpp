@@ -122,12 +122,28 @@ enum CommandBufferDirtyBits
 
 	COMMAND_BUFFER_DIRTY_PUSH_CONSTANTS_BIT = 1 << 7,
 
+	COMMAND_BUFFER_DIRTY_EXTENDED_DYNAMIC_STATE_BIT = 1 << 8,
+
 	COMMAND_BUFFER_DYNAMIC_BITS = COMMAND_BUFFER_DIRTY_VIEWPORT_BIT | COMMAND_BUFFER_DIRTY_SCISSOR_BIT |
 	                              COMMAND_BUFFER_DIRTY_DEPTH_BIAS_BIT |
-	                              COMMAND_BUFFER_DIRTY_STENCIL_REFERENCE_BIT
+	                              COMMAND_BUFFER_DIRTY_STENCIL_REFERENCE_BIT |
+	                              COMMAND_BUFFER_DIRTY_EXTENDED_DYNAMIC_STATE_BIT
 };
 using CommandBufferDirtyFlags = uint32_t;
 
+// Which parts of PipelineState are set with vkCmdSet* rather than baked into the VkPipeline.
+// State covered here does not contribute to the pipeline hash.
+enum PipelineDynamicStateBits
+{
+	// Extended dynamic state 1 and 2 (core in Vulkan 1.3):
+	// cull mode, front face, topology (within its class), primitive restart, depth bias enable,
+	// depth and stencil test state.
+	PIPELINE_DYNAMIC_STATE_EXTENDED_BIT = 1 << 0,
+	// VK_EXT_extended_dynamic_state3: blending, color write mask, polygon mode and alpha-to-coverage.
+	PIPELINE_DYNAMIC_STATE_EXTENDED_3_BIT = 1 << 1
+};
+using PipelineDynamicStateFlags = uint32_t;
+
 #define COMPARE_OP_BITS 3
 #define STENCIL_OP_BITS 3
 #define BLEND_FACTOR_BITS 5
@@ -268,11 +284,18 @@ struct DeferredPipelineCompile
 	VkVertexInputRate input_rates[VULKAN_NUM_VERTEX_BUFFERS];
 
 	unsigned subpass_index;
+	// Pipeline is created against VkPipelineRenderingCreateInfo rather than compatible_render_pass.
+	// compatible_render_pass still describes the attachment formats and sample counts.
+	bool dynamic_rendering;
 	Util::Hash hash;
 	VkPipelineCache cache;
 	uint32_t subgroup_size_tag;
+	PipelineDynamicStateFlags dynamic_state_mask;
 };
 
+struct GraphicsPipelineCreateState;
+enum class PipelineLibraryPart : uint32_t;
+
 class CommandBuffer;
 struct CommandBufferDeleter
 {
@@ -834,6 +857,8 @@ private:
 	const Framebuffer *framebuffer = nullptr;
 	const RenderPass *actual_render_pass = nullptr;
 	const Vulkan::ImageView *framebuffer_attachments[VULKAN_NUM_ATTACHMENTS + 1] = {};
+	uint32_t framebuffer_width = 0;
+	uint32_t framebuffer_height = 0;
 
 	IndexState index_state = {};
 	VertexBindingState vbo = {};
@@ -889,6 +914,9 @@ private:
 	void begin_graphics();
 	void flush_descriptor_set(uint32_t set);
 	void rebind_descriptor_set(uint32_t set);
+	void push_descriptor_set(uint32_t set);
+	void flush_descriptor_buffer_sets(uint32_t set_mask);
+	void write_descriptor_buffer_set(uint32_t set, uint8_t *data);
 	void begin_compute();
 	void begin_context();
 
@@ -896,13 +924,15 @@ private:
 	BufferBlock ibo_block;
 	BufferBlock ubo_block;
 	BufferBlock staging_block;
+	BufferBlock descriptor_block;
 
 	void set_texture(unsigned set, unsigned binding, VkImageView float_view, VkImageView integer_view,
 	                 VkImageLayout layout,
 	                 uint64_t cookie);
 	void set_buffer_view_common(unsigned set, unsigned binding, const BufferView &view);
 
-	void init_viewport_scissor(const RenderPassInfo &info, const Framebuffer *framebuffer);
+	void init_viewport_scissor(const RenderPassInfo &info);
+	void begin_dynamic_rendering(const RenderPassInfo &info);
 	void init_surface_transform(const RenderPassInfo &info);
 	VkSurfaceTransformFlagBitsKHR current_framebuffer_surface_transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
 
@@ -912,6 +942,7 @@ private:
 	DebugChannelInterface *debug_channel_interface = nullptr;
 
 	void bind_pipeline(VkPipelineBindPoint bind_point, VkPipeline pipeline, uint32_t active_dynamic_state);
+	void flush_extended_dynamic_state();
 
 	static void update_hash_graphics_pipeline(DeferredPipelineCompile &compile, CompileMode mode, uint32_t *active_vbos);
 	static void update_hash_compute_pipeline(DeferredPipelineCompile &compile);
@@ -923,6 +954,18 @@ private:
 	                                        VkPipelineShaderStageRequiredSubgroupSizeCreateInfoEXT &required_info,
 	                                        VkShaderStageFlagBits stage,
 	                                        bool full_group, unsigned min_size_log2, unsigned max_size_log2);
+
+	static bool setup_graphics_pipeline_state(Device *device, const DeferredPipelineCompile &compile,
+	                                          GraphicsPipelineCreateState &state);
+
+	// VK_EXT_graphics_pipeline_library path. Pipelines are fast-linked from cached libraries,
+	// and an optimized monolithic pipeline is compiled in the background to replace it.
+	static bool supports_graphics_pipeline_fast_link(Device *device, const DeferredPipelineCompile &compile);
+	static Pipeline build_graphics_pipeline_fast_link(Device *device, const DeferredPipelineCompile &compile);
+	static VkPipeline build_graphics_pipeline_library(Device *device, const DeferredPipelineCompile &compile,
+	                                                  const GraphicsPipelineCreateState &state,
+	                                                  PipelineLibraryPart part);
+	static void kick_optimized_graphics_pipeline(Device *device, const DeferredPipelineCompile &compile);
 };
 
 #ifdef GRANITE_VULKAN_SYSTEM_HANDLES
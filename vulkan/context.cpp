@@ -1350,6 +1350,47 @@ bool Context::create_device(VkPhysicalDevice gpu_, VkSurfaceKHR surface,
 		ADD_CHAIN(ext.index_type_uint8_features, INDEX_TYPE_UINT8_FEATURES_EXT);
 	}
 
+	if (((flags & CONTEXT_CREATION_ENABLE_PIPELINE_LIBRARY_BIT) != 0 ||
+	     Util::get_environment_bool("GRANITE_VULKAN_PIPELINE_LIBRARY", false)) &&
+	    has_extension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+	    has_extension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME))
+	{
+		enabled_extensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		enabled_extensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		ADD_CHAIN(ext.graphics_pipeline_library_features, GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT);
+	}
+
+	// Extended dynamic state 1 and 2 are core in Vulkan 1.3.
+	if (((flags & CONTEXT_CREATION_ENABLE_EXTENDED_DYNAMIC_STATE_BIT) != 0 ||
+	     Util::get_environment_bool("GRANITE_VULKAN_EXTENDED_DYNAMIC_STATE", false)) &&
+	    ext.device_api_core_version >= VK_API_VERSION_1_3)
+	{
+		ext.supports_extended_dynamic_state = true;
+		if (has_extension(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME))
+		{
+			enabled_extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+			ADD_CHAIN(ext.extended_dynamic_state3_features, EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT);
+		}
+	}
+
+	if (((flags & CONTEXT_CREATION_ENABLE_PUSH_DESCRIPTOR_BIT) != 0 ||
+	     Util::get_environment_bool("GRANITE_VULKAN_PUSH_DESCRIPTOR", false)) &&
+	    has_extension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME))
+	{
+		ext.supports_push_descriptor = true;
+		enabled_extensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+	}
+
+	// Buffer descriptors are written from device addresses.
+	if (((flags & CONTEXT_CREATION_ENABLE_DESCRIPTOR_BUFFER_BIT) != 0 ||
+	     Util::get_environment_bool("GRANITE_VULKAN_DESCRIPTOR_BUFFER", false)) &&
+	    ext.device_api_core_version >= VK_API_VERSION_1_2 &&
+	    has_extension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME))
+	{
+		enabled_extensions.push_back(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+		ADD_CHAIN(ext.descriptor_buffer_features, DESCRIPTOR_BUFFER_FEATURES_EXT);
+	}
+
 	if (has_extension(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
 	{
 		ext.supports_external_memory_host = true;
@@ -1410,6 +1451,11 @@ bool Context::create_device(VkPhysicalDevice gpu_, VkSurfaceKHR surface,
 	if (ext.host_query_reset_features.hostQueryReset)
 		ext.vk12_features.hostQueryReset = VK_TRUE;
 
+	// Dynamic rendering is core in Vulkan 1.3. It rides on the extended dynamic state opt-in,
+	// since begin_render_pass() only takes that path for a subset of passes.
+	if (ext.supports_extended_dynamic_state && ext.vk13_features.dynamicRendering)
+		ext.supports_dynamic_rendering = true;
+
 	ext.vk11_features.multiviewGeometryShader = VK_FALSE;
 	ext.vk11_features.multiviewTessellationShader = VK_FALSE;
 	ext.vk11_features.protectedMemory = VK_FALSE;
@@ -1424,6 +1470,14 @@ bool Context::create_device(VkPhysicalDevice gpu_, VkSurfaceKHR surface,
 	ext.vk13_features.inlineUniformBlock = VK_FALSE;
 	ext.vk13_features.privateData = VK_FALSE;
 
+	ext.descriptor_buffer_features.descriptorBufferCaptureReplay = VK_FALSE;
+	ext.descriptor_buffer_features.descriptorBufferImageLayoutIgnored = VK_FALSE;
+	ext.descriptor_buffer_features.descriptorBufferPushDescriptors = VK_FALSE;
+	if (ext.descriptor_buffer_features.descriptorBuffer && ext.vk12_features.bufferDeviceAddress)
+		ext.supports_descriptor_buffer = true;
+	else
+		ext.descriptor_buffer_features.descriptorBuffer = VK_FALSE;
+
 	ext.device_generated_commands_compute_features.deviceGeneratedComputeCaptureReplay = VK_FALSE;
 	// TODO
 	ext.device_generated_commands_compute_features.deviceGeneratedComputePipelines = VK_FALSE;
@@ -1522,6 +1576,14 @@ bool Context::create_device(VkPhysicalDevice gpu_, VkSurfaceKHR surface,
 	if (has_extension(VK_EXT_MESH_SHADER_EXTENSION_NAME))
 		ADD_CHAIN(ext.mesh_shader_properties, MESH_SHADER_PROPERTIES_EXT);
 
+	if (ext.graphics_pipeline_library_features.graphicsPipelineLibrary)
+		ADD_CHAIN(ext.graphics_pipeline_library_properties, GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT);
+
+	if (ext.supports_push_descriptor)
+		ADD_CHAIN(ext.push_descriptor_properties, PUSH_DESCRIPTOR_PROPERTIES_KHR);
+	if (ext.supports_descriptor_buffer)
+		ADD_CHAIN(ext.descriptor_buffer_properties, DESCRIPTOR_BUFFER_PROPERTIES_EXT);
+
 	vkGetPhysicalDeviceProperties2(gpu, &props);
 
 	if (ext.device_api_core_version < VK_API_VERSION_1_2)
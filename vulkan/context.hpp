@@ -71,6 +71,10 @@ struct DeviceFeatures
 	bool supports_hdr_metadata = false;
 	bool supports_swapchain_colorspace = false;
 	bool supports_surface_maintenance1 = false;
+	bool supports_extended_dynamic_state = false;
+	bool supports_dynamic_rendering = false;
+	bool supports_push_descriptor = false;
+	bool supports_descriptor_buffer = false;
 
 	VkPhysicalDeviceFeatures enabled_features = {};
 
@@ -87,6 +91,7 @@ struct DeviceFeatures
 	VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {};
 	VkPhysicalDeviceFragmentShaderBarycentricFeaturesKHR barycentric_features = {};
 	VkPhysicalDeviceVideoMaintenance1FeaturesKHR video_maintenance1_features = {};
+	VkPhysicalDevicePushDescriptorPropertiesKHR push_descriptor_properties = {};
 
 	// EXT
 	VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_memory_properties = {};
@@ -98,6 +103,11 @@ struct DeviceFeatures
 	VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features = {};
 	VkPhysicalDeviceMeshShaderPropertiesEXT mesh_shader_properties = {};
 	VkPhysicalDeviceIndexTypeUint8FeaturesEXT index_type_uint8_features = {};
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphics_pipeline_library_features = {};
+	VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT graphics_pipeline_library_properties = {};
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT extended_dynamic_state3_features = {};
+	VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptor_buffer_features = {};
+	VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptor_buffer_properties = {};
 
 	// Vendor
 	VkPhysicalDeviceComputeShaderDerivativesFeaturesNV compute_shader_derivative_features = {};
@@ -136,7 +146,20 @@ enum ContextCreationFlagBits
 	CONTEXT_CREATION_ENABLE_VIDEO_DECODE_BIT = 1 << 1,
 	CONTEXT_CREATION_ENABLE_VIDEO_ENCODE_BIT = 1 << 2,
 	CONTEXT_CREATION_ENABLE_VIDEO_H264_BIT = 1 << 3,
-	CONTEXT_CREATION_ENABLE_VIDEO_H265_BIT = 1 << 4
+	CONTEXT_CREATION_ENABLE_VIDEO_H265_BIT = 1 << 4,
+	// Opt-in since fast-linked pipelines are slightly slower than optimized ones until
+	// the background compile completes. Can also be enabled with GRANITE_VULKAN_PIPELINE_LIBRARY=1.
+	CONTEXT_CREATION_ENABLE_PIPELINE_LIBRARY_BIT = 1 << 5,
+	// Keeps most rasterizer, depth-stencil and blend state out of the pipeline hash.
+	// Can also be enabled with GRANITE_VULKAN_EXTENDED_DYNAMIC_STATE=1.
+	CONTEXT_CREATION_ENABLE_EXTENDED_DYNAMIC_STATE_BIT = 1 << 6,
+	// One small descriptor set per pipeline layout is pushed rather than hashed and allocated.
+	// Can also be enabled with GRANITE_VULKAN_PUSH_DESCRIPTOR=1.
+	CONTEXT_CREATION_ENABLE_PUSH_DESCRIPTOR_BIT = 1 << 7,
+	// Descriptors are written straight into linearly allocated descriptor buffers and bound by offset.
+	// Layouts which cannot use descriptor buffers fall back to descriptor sets and push descriptors.
+	// Can also be enabled with GRANITE_VULKAN_DESCRIPTOR_BUFFER=1.
+	CONTEXT_CREATION_ENABLE_DESCRIPTOR_BUFFER_BIT = 1 << 8
 };
 using ContextCreationFlags = uint32_t;
 
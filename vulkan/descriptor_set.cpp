@@ -31,14 +31,21 @@ namespace Vulkan
 {
 DescriptorSetAllocator::DescriptorSetAllocator(Hash hash, Device *device_, const DescriptorSetLayout &layout,
                                                const uint32_t *stages_for_binds,
-                                               const ImmutableSampler * const *immutable_samplers)
+                                               const ImmutableSampler * const *immutable_samplers,
+                                               DescriptorSetMode mode_)
 	: IntrusiveHashMapEnabled<DescriptorSetAllocator>(hash)
 	, device(device_)
 	, table(device_->get_device_table())
+	, mode(mode_)
 {
 	bindless = layout.array_size[0] == DescriptorSetLayout::UNSIZED_ARRAY;
+	VK_ASSERT(!bindless || mode == DescriptorSetMode::Pool);
+	VK_ASSERT(mode != DescriptorSetMode::DescriptorBuffer ||
+	          (layout.immutable_sampler_mask == 0 &&
+	           layout.sampled_texel_buffer_mask == 0 &&
+	           layout.storage_texel_buffer_mask == 0));
 
-	if (!bindless)
+	if (!bindless && mode == DescriptorSetMode::Pool)
 	{
 		unsigned count = device_->num_thread_indices;
 		for (unsigned i = 0; i < count; i++)
@@ -69,6 +76,11 @@ DescriptorSetAllocator::DescriptorSetAllocator(Hash hash, Device *device_, const
 		                VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
 	}
 
+	if (mode == DescriptorSetMode::PushDescriptor)
+		info.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+	else if (mode == DescriptorSetMode::DescriptorBuffer)
+		info.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+
 	for (unsigned i = 0; i < VULKAN_NUM_BINDINGS; i++)
 	{
 		auto stages = stages_for_binds[i];
@@ -120,8 +132,12 @@ DescriptorSetAllocator::DescriptorSetAllocator(Hash hash, Device *device_, const
 
 		if (layout.uniform_buffer_mask & (1u << i))
 		{
-			bindings.push_back({ i, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, array_size, stages, nullptr });
-			pool_size.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, pool_array_size });
+			// Dynamic descriptors are not allowed with push descriptors or descriptor buffers.
+			// The dynamic offset is folded into the descriptor instead.
+			VkDescriptorType ubo_type = mode != DescriptorSetMode::Pool ?
+					VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			bindings.push_back({ i, ubo_type, array_size, stages, nullptr });
+			pool_size.push_back({ ubo_type, pool_array_size });
 			types++;
 		}
 
@@ -177,10 +193,23 @@ DescriptorSetAllocator::DescriptorSetAllocator(Hash hash, Device *device_, const
 	LOGI("Creating descriptor set layout.\n");
 #endif
 	if (table.vkCreateDescriptorSetLayout(device->get_device(), &info, nullptr, &set_layout) != VK_SUCCESS)
+	{
 		LOGE("Failed to create descriptor set layout.");
+		return;
+	}
 #ifdef GRANITE_VULKAN_FOSSILIZE
 	device->register_descriptor_set_layout(set_layout, get_hash(), info);
 #endif
+
+	if (mode == DescriptorSetMode::DescriptorBuffer)
+	{
+		table.vkGetDescriptorSetLayoutSizeEXT(device->get_device(), set_layout, &descriptor_buffer_size);
+		for (auto &binding : bindings)
+		{
+			table.vkGetDescriptorSetLayoutBindingOffsetEXT(device->get_device(), set_layout, binding.binding,
+			                                               &descriptor_buffer_offsets[binding.binding]);
+		}
+	}
 }
 
 void DescriptorSetAllocator::reset_bindless_pool(VkDescriptorPool pool)
@@ -255,6 +284,7 @@ void DescriptorSetAllocator::begin_frame()
 std::pair<VkDescriptorSet, bool> DescriptorSetAllocator::find(unsigned thread_index, Hash hash)
 {
 	VK_ASSERT(!bindless);
+	VK_ASSERT(mode == DescriptorSetMode::Pool);
 
 	auto &state = *per_thread[thread_index];
 	if (state.should_begin)
@@ -110,12 +110,23 @@ enum class BindlessResourceType
 	Image
 };
 
+enum class DescriptorSetMode
+{
+	// Sets are hashed and allocated from per-thread pools.
+	Pool,
+	// Descriptors are recorded directly into the command buffer.
+	PushDescriptor,
+	// Descriptors are written into a linearly allocated descriptor buffer and bound by offset.
+	DescriptorBuffer
+};
+
 class DescriptorSetAllocator : public HashedObject<DescriptorSetAllocator>
 {
 public:
 	DescriptorSetAllocator(Util::Hash hash, Device *device, const DescriptorSetLayout &layout,
 	                       const uint32_t *stages_for_bindings,
-	                       const ImmutableSampler * const *immutable_samplers);
+	                       const ImmutableSampler * const *immutable_samplers,
+	                       DescriptorSetMode mode = DescriptorSetMode::Pool);
 	~DescriptorSetAllocator();
 	void operator=(const DescriptorSetAllocator &) = delete;
 	DescriptorSetAllocator(const DescriptorSetAllocator &) = delete;
@@ -135,6 +146,28 @@ public:
 		return bindless;
 	}
 
+	// Push descriptor layouts never allocate sets, descriptors are recorded directly into the command buffer.
+	bool is_push_descriptor() const
+	{
+		return mode == DescriptorSetMode::PushDescriptor;
+	}
+
+	bool is_descriptor_buffer() const
+	{
+		return mode == DescriptorSetMode::DescriptorBuffer;
+	}
+
+	// Size of the set in a descriptor buffer, and where each binding starts within it.
+	VkDeviceSize get_descriptor_buffer_size() const
+	{
+		return descriptor_buffer_size;
+	}
+
+	VkDeviceSize get_descriptor_buffer_offset(unsigned binding) const
+	{
+		return descriptor_buffer_offsets[binding];
+	}
+
 	VkDescriptorPool allocate_bindless_pool(unsigned num_sets, unsigned num_descriptors);
 	VkDescriptorSet allocate_bindless_set(VkDescriptorPool pool, unsigned num_descriptors);
 	void reset_bindless_pool(VkDescriptorPool pool);
@@ -163,6 +196,9 @@ private:
 	std::vector<std::unique_ptr<PerThread>> per_thread;
 	std::vector<VkDescriptorPoolSize> pool_size;
 	bool bindless = false;
+	DescriptorSetMode mode;
+	VkDeviceSize descriptor_buffer_size = 0;
+	VkDeviceSize descriptor_buffer_offsets[VULKAN_NUM_BINDINGS] = {};
 };
 
 class BindlessAllocator
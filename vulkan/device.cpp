@@ -86,6 +86,8 @@ Device::Device()
 #endif
 {
 	cookie.store(0);
+	timestamp_frame_samples.store(false, std::memory_order_relaxed);
+	pipeline_library = std::make_shared<PipelineLibraryState>();
 }
 
 Semaphore Device::request_semaphore(VkSemaphoreType type, VkSemaphore vk_semaphore, bool transfer_ownership)
@@ -518,7 +520,8 @@ const PipelineLayout *Device::request_pipeline_layout(const CombinedResourceLayo
 }
 
 DescriptorSetAllocator *Device::request_descriptor_set_allocator(const DescriptorSetLayout &layout, const uint32_t *stages_for_bindings,
-                                                                 const ImmutableSampler * const *immutable_samplers_)
+                                                                 const ImmutableSampler * const *immutable_samplers_,
+                                                                 DescriptorSetMode mode)
 {
 	Hasher h;
 	h.data(reinterpret_cast<const uint32_t *>(&layout), sizeof(layout));
@@ -527,12 +530,16 @@ DescriptorSetAllocator *Device::request_descriptor_set_allocator(const Descripto
 		VK_ASSERT(immutable_samplers_ && immutable_samplers_[bit]);
 		h.u64(immutable_samplers_[bit]->get_hash());
 	});
+	h.s32(int(mode));
 	auto hash = h.get();
 
 	LOCK_CACHE();
 	auto *ret = descriptor_set_allocators.find(hash);
 	if (!ret)
-		ret = descriptor_set_allocators.emplace_yield(hash, hash, this, layout, stages_for_bindings, immutable_samplers_);
+	{
+		ret = descriptor_set_allocators.emplace_yield(hash, hash, this, layout, stages_for_bindings,
+		                                              immutable_samplers_, mode);
+	}
 	return ret;
 }
 
@@ -750,6 +757,20 @@ bool Device::init_pipeline_cache(const uint8_t *data, size_t size)
 	return table->vkCreatePipelineCache(device, &info, nullptr, &pipeline_cache) == VK_SUCCESS;
 }
 
+Device::PipelineLibraryStats Device::get_pipeline_library_stats()
+{
+	std::lock_guard<std::mutex> holder{pipeline_library->lock};
+	return pipeline_library->stats;
+}
+
+void Device::wait_for_optimized_pipelines()
+{
+	std::unique_lock<std::mutex> holder{pipeline_library->lock};
+	pipeline_library->cond.wait(holder, [&]() {
+		return pipeline_library->pending.empty();
+	});
+}
+
 void Device::init_pipeline_cache()
 {
 #ifdef GRANITE_VULKAN_SYSTEM_HANDLES
@@ -960,6 +981,18 @@ void Device::set_context(const Context &context)
 	managers.ubo.set_max_retained_blocks(64);
 	managers.staging.set_max_retained_blocks(32);
 
+	if (ext.supports_descriptor_buffer)
+	{
+		auto &props = ext.descriptor_buffer_properties;
+		VkDeviceSize block_size = 256 * 1024;
+		block_size = std::min<VkDeviceSize>(block_size, props.maxResourceDescriptorBufferRange);
+		block_size = std::min<VkDeviceSize>(block_size, props.maxSamplerDescriptorBufferRange);
+		managers.descriptor.init(this, block_size, std::max<VkDeviceSize>(16u, props.descriptorBufferOffsetAlignment),
+		                         VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT |
+		                         VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT);
+		managers.descriptor.set_max_retained_blocks(64);
+	}
+
 	for (int i = 0; i < QUEUE_INDEX_COUNT; i++)
 	{
 		if (queue_info.family_indices[i] == VK_QUEUE_FAMILY_IGNORED)
@@ -1201,6 +1234,17 @@ void Device::request_uniform_block_nolock(BufferBlock &block, VkDeviceSize size)
 	request_block(*this, block, size, managers.ubo, frame().ubo_blocks);
 }
 
+void Device::request_descriptor_block(BufferBlock &block, VkDeviceSize size)
+{
+	LOCK();
+	request_descriptor_block_nolock(block, size);
+}
+
+void Device::request_descriptor_block_nolock(BufferBlock &block, VkDeviceSize size)
+{
+	request_block(*this, block, size, managers.descriptor, frame().descriptor_blocks);
+}
+
 void Device::request_staging_block(BufferBlock &block, VkDeviceSize size)
 {
 	LOCK();
@@ -1992,6 +2036,16 @@ Device::~Device()
 
 	wait_idle();
 
+	// Background pipeline compiles which have started must complete before the pipeline cache goes away.
+	// Ones which are still queued are cancelled. The thread group may have stopped already, so never wait on those.
+	{
+		std::unique_lock<std::mutex> holder{pipeline_library->lock};
+		pipeline_library->shutdown = true;
+		pipeline_library->cond.wait(holder, [&]() {
+			return pipeline_library->compiling == 0;
+		});
+	}
+
 	managers.timestamps.log_simple();
 
 	if (pipeline_cache != VK_NULL_HANDLE)
@@ -2371,12 +2425,14 @@ void Device::wait_idle_nolock()
 	managers.ubo.reset();
 	managers.ibo.reset();
 	managers.staging.reset();
+	managers.descriptor.reset();
 	for (auto &frame : per_frame)
 	{
 		frame->vbo_blocks.clear();
 		frame->ibo_blocks.clear();
 		frame->ubo_blocks.clear();
 		frame->staging_blocks.clear();
+		frame->descriptor_blocks.clear();
 	}
 
 	framebuffer_allocator.clear();
@@ -2471,6 +2527,11 @@ void Device::next_frame_context()
 
 	promote_read_write_caches_to_read_only();
 
+#ifdef GRANITE_VULKAN_FOSSILIZE
+	if (recorder_state)
+		recorder_state->frame_count.fetch_add(1, std::memory_order_relaxed);
+#endif
+
 	frame().begin();
 	recalibrate_timestamps();
 	frame_context_begin_ts = write_calibrated_timestamp_nolock();
@@ -2489,13 +2550,17 @@ QueryPoolHandle Device::write_timestamp_nolock(VkCommandBuffer cmd, VkPipelineSt
 
 QueryPoolHandle Device::write_calibrated_timestamp()
 {
+	// Avoid taking the device lock for the common case where nothing consumes CPU timestamps.
+	if (!system_handles.timeline_trace_file && !timestamp_frame_samples.load(std::memory_order_relaxed))
+		return {};
+
 	LOCK();
 	return write_calibrated_timestamp_nolock();
 }
 
 QueryPoolHandle Device::write_calibrated_timestamp_nolock()
 {
-	if (!system_handles.timeline_trace_file)
+	if (!system_handles.timeline_trace_file && !timestamp_frame_samples.load(std::memory_order_relaxed))
 		return {};
 
 	auto handle = QueryPoolHandle(handle_pool.query.allocate(this, false));
@@ -2634,6 +2699,9 @@ void Device::recalibrate_timestamps()
 void Device::register_time_interval(std::string tid, QueryPoolHandle start_ts, QueryPoolHandle end_ts,
                                     const std::string &tag)
 {
+	if (!start_ts || !end_ts)
+		return;
+
 	LOCK();
 	register_time_interval_nolock(std::move(tid), std::move(start_ts), std::move(end_ts), tag);
 }
@@ -2748,10 +2816,13 @@ void Device::PerFrame::begin()
 		managers.ubo.recycle_block(block);
 	for (auto &block : staging_blocks)
 		managers.staging.recycle_block(block);
+	for (auto &block : descriptor_blocks)
+		managers.descriptor.recycle_block(block);
 	vbo_blocks.clear();
 	ibo_blocks.clear();
 	ubo_blocks.clear();
 	staging_blocks.clear();
+	descriptor_blocks.clear();
 
 	for (auto &framebuffer : destroyed_framebuffers)
 		table.vkDestroyFramebuffer(vkdevice, framebuffer, nullptr);
@@ -2808,6 +2879,7 @@ void Device::PerFrame::begin()
 
 			int64_t start_ts = ts.start_ts->get_timestamp_ticks();
 			int64_t end_ts = ts.end_ts->get_timestamp_ticks();
+			ts.timestamp_tag->set_device_timebase(ts.start_ts->is_device_timebase());
 			if (ts.start_ts->is_device_timebase())
 				ts.timestamp_tag->accumulate_time(device.convert_device_timestamp_delta(start_ts, end_ts));
 			else
@@ -2820,26 +2892,18 @@ void Device::PerFrame::begin()
 				min_timestamp_us = (std::min)(min_timestamp_us, start_ts);
 				max_timestamp_us = (std::max)(max_timestamp_us, end_ts);
 
-				auto *e = device.system_handles.timeline_trace_file->allocate_event();
-				e->set_desc(ts.timestamp_tag->get_tag().c_str());
-				e->set_tid(ts.tid.c_str());
-				e->pid = frame_index + 1;
-				e->start_ns = start_ts;
-				e->end_ns = end_ts;
-				device.system_handles.timeline_trace_file->submit_event(e);
+				device.system_handles.timeline_trace_file->write_event(
+						ts.timestamp_tag->get_tag().c_str(), ts.tid.c_str(),
+						frame_index + 1, start_ts, end_ts);
 			}
 		}
 	}
 
 	if (device.system_handles.timeline_trace_file && min_timestamp_us <= max_timestamp_us)
 	{
-		auto *e = device.system_handles.timeline_trace_file->allocate_event();
-		e->set_desc("CPU + GPU full frame");
-		e->set_tid("Frame context");
-		e->pid = frame_index + 1;
-		e->start_ns = min_timestamp_us;
-		e->end_ns = max_timestamp_us;
-		device.system_handles.timeline_trace_file->submit_event(e);
+		device.system_handles.timeline_trace_file->write_event(
+				"CPU + GPU full frame", "Frame context",
+				frame_index + 1, min_timestamp_us, max_timestamp_us);
 	}
 
 	managers.timestamps.mark_end_of_frame_context();
@@ -3702,6 +3766,56 @@ static void add_unique_family(uint32_t *sharing_indices, uint32_t &count, uint32
 	sharing_indices[count++] = family;
 }
 
+bool Device::get_image_memory_requirements(const ImageCreateInfo &create_info, VkMemoryRequirements *reqs)
+{
+	// Mirrors the parts of create_image_from_staging_buffer() which can affect memory requirements.
+	// Only optimally tiled images without initial data are meaningful here.
+	VkImageCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+	info.format = create_info.format;
+	info.extent.width = create_info.width;
+	info.extent.height = create_info.height;
+	info.extent.depth = create_info.depth;
+	info.imageType = create_info.type;
+	info.mipLevels = create_info.levels;
+	info.arrayLayers = create_info.layers;
+	info.samples = create_info.samples;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	info.usage = create_info.usage;
+	info.flags = create_info.flags;
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (create_info.domain == ImageDomain::Transient)
+		info.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	if (info.mipLevels == 0)
+		info.mipLevels = image_num_miplevels(info.extent);
+	if ((create_info.misc & IMAGE_MISC_MUTABLE_SRGB_BIT) != 0)
+		info.flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT;
+
+	uint32_t sharing_indices[QUEUE_INDEX_COUNT];
+	if (create_info.misc & IMAGE_MISC_CONCURRENT_QUEUE_GRAPHICS_BIT)
+		add_unique_family(sharing_indices, info.queueFamilyIndexCount, queue_info.family_indices[QUEUE_INDEX_GRAPHICS]);
+	if (create_info.misc & IMAGE_MISC_CONCURRENT_QUEUE_ASYNC_COMPUTE_BIT)
+		add_unique_family(sharing_indices, info.queueFamilyIndexCount, queue_info.family_indices[QUEUE_INDEX_COMPUTE]);
+	if (create_info.misc & IMAGE_MISC_CONCURRENT_QUEUE_ASYNC_TRANSFER_BIT)
+		add_unique_family(sharing_indices, info.queueFamilyIndexCount, queue_info.family_indices[QUEUE_INDEX_TRANSFER]);
+
+	if (info.queueFamilyIndexCount > 1)
+	{
+		info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		info.pQueueFamilyIndices = sharing_indices;
+	}
+	else
+		info.queueFamilyIndexCount = 0;
+
+	VkImage image;
+	if (table->vkCreateImage(device, &info, nullptr, &image) != VK_SUCCESS)
+		return false;
+	table->vkGetImageMemoryRequirements(device, image, reqs);
+	table->vkDestroyImage(device, image, nullptr);
+	return true;
+}
+
 ImageHandle Device::create_image_from_staging_buffer(const ImageCreateInfo &create_info,
                                                      const InitialImageBuffer *staging_buffer)
 {
@@ -5156,6 +5270,18 @@ void Device::timestamp_log(const TimestampIntervalReportCallback &cb) const
 	managers.timestamps.log_simple(cb);
 }
 
+void Device::timestamp_log_enable_frame_samples(bool enable)
+{
+	LOCK();
+	timestamp_frame_samples.store(enable, std::memory_order_relaxed);
+	managers.timestamps.set_frame_samples_enabled(enable);
+}
+
+bool Device::timestamp_log_frame_samples_enabled() const
+{
+	return timestamp_frame_samples.load(std::memory_order_relaxed);
+}
+
 CommandBufferHandle request_command_buffer_with_ownership_transfer(
 		Device &device,
 		const Vulkan::Image &image,
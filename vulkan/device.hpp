@@ -43,6 +43,7 @@
 #include <vector>
 #include <functional>
 #include <unordered_map>
+#include <unordered_set>
 #include <stdio.h>
 
 #ifdef GRANITE_VULKAN_SYSTEM_HANDLES
@@ -243,6 +244,17 @@ public:
 	bool get_pipeline_cache_data(uint8_t *data, size_t size);
 	bool init_pipeline_cache(const uint8_t *data, size_t size);
 
+	// With VK_EXT_graphics_pipeline_library, pipeline cache misses are fast-linked
+	// and replaced by an optimized pipeline compiled on the thread group.
+	struct PipelineLibraryStats
+	{
+		uint32_t fast_linked;
+		uint32_t optimized;
+	};
+	PipelineLibraryStats get_pipeline_library_stats();
+	// Waits for optimized compiles kicked so far. The thread group must be running.
+	void wait_for_optimized_pipelines();
+
 	// Frame-pushing interface.
 	void next_frame_context();
 
@@ -336,6 +348,9 @@ public:
 	ImageHandle wrap_image(const ImageCreateInfo &info, VkImage img);
 	DeviceAllocationOwnerHandle take_device_allocation_ownership(Image &image);
 	DeviceAllocationOwnerHandle allocate_memory(const MemoryAllocateInfo &info);
+	// Queries memory requirements of an image without creating it.
+	// Used to plan placement of images which alias memory, see ImageCreateInfo::memory_aliases.
+	bool get_image_memory_requirements(const ImageCreateInfo &info, VkMemoryRequirements *reqs);
 
 	// Create staging buffers for images.
 	InitialImageBuffer create_image_staging_buffer(const ImageCreateInfo &info, const ImageInitialData *initial);
@@ -452,7 +467,12 @@ public:
 		// For shipping configurations. We can still compile pipelines, but it may stutter.
 		ShaderModules,
 		// When this is done, pipelines should never stutter if Fossilize knows about the pipeline.
-		Pipelines
+		Pipelines,
+		// Pipelines are replayed in the order earlier sessions first used them.
+		// When this is done, every pipeline which earlier sessions used is ready,
+		// so rendering can start while the rest is compiled in the background.
+		// Without any usage history, this is equivalent to Pipelines.
+		UsedPipelines
 	};
 
 	// 0 -> not started
@@ -504,6 +524,10 @@ public:
 
 	void timestamp_log_reset();
 	void timestamp_log(const TimestampIntervalReportCallback &cb) const;
+	// Keeps per frame context samples for every timestamp interval, reported through timestamp_log().
+	// Also enables calibrated CPU timestamps when no timeline trace is active. Intended for benchmarking.
+	void timestamp_log_enable_frame_samples(bool enable);
+	bool timestamp_log_frame_samples_enabled() const;
 
 private:
 	VkInstance instance = VK_NULL_HANDLE;
@@ -524,6 +548,7 @@ private:
 	void request_index_block(BufferBlock &block, VkDeviceSize size);
 	void request_uniform_block(BufferBlock &block, VkDeviceSize size);
 	void request_staging_block(BufferBlock &block, VkDeviceSize size);
+	void request_descriptor_block(BufferBlock &block, VkDeviceSize size);
 
 	QueryPoolHandle write_timestamp(VkCommandBuffer cmd, VkPipelineStageFlags2 stage);
 
@@ -536,7 +561,8 @@ private:
 	                                              const ImmutableSamplerBank *immutable_samplers);
 	DescriptorSetAllocator *request_descriptor_set_allocator(const DescriptorSetLayout &layout,
 	                                                         const uint32_t *stages_for_sets,
-	                                                         const ImmutableSampler * const *immutable_samplers);
+	                                                         const ImmutableSampler * const *immutable_samplers,
+	                                                         DescriptorSetMode mode = DescriptorSetMode::Pool);
 	const Framebuffer &request_framebuffer(const RenderPassInfo &info);
 	const RenderPass &request_render_pass(const RenderPassInfo &info, bool compatible);
 
@@ -572,6 +598,8 @@ private:
 	int64_t calibrated_timestamp_device_accum = 0;
 	unsigned timestamp_calibration_counter = 0;
 	Vulkan::QueryPoolHandle frame_context_begin_ts;
+	// Written under the device lock, read without it by write_calibrated_timestamp().
+	std::atomic_bool timestamp_frame_samples;
 
 	struct Managers
 	{
@@ -579,7 +607,7 @@ private:
 		FenceManager fence;
 		SemaphoreManager semaphore;
 		EventManager event;
-		BufferPool vbo, ibo, ubo, staging;
+		BufferPool vbo, ibo, ubo, staging, descriptor;
 		TimestampIntervalManager timestamps;
 	};
 	Managers managers;
@@ -594,6 +622,19 @@ private:
 		bool async_frame_context = false;
 	} lock;
 
+	// Optimized pipelines being compiled in the background to replace fast-linked pipeline libraries.
+	// Shared with the compile tasks, since a queued task may only get to run after the Device is gone.
+	struct PipelineLibraryState
+	{
+		std::mutex lock;
+		std::condition_variable cond;
+		std::unordered_set<Util::Hash> pending;
+		unsigned compiling = 0;
+		bool shutdown = false;
+		PipelineLibraryStats stats = {};
+	};
+	std::shared_ptr<PipelineLibraryState> pipeline_library;
+
 	struct PerFrame
 	{
 		PerFrame(Device *device, unsigned index);
@@ -619,6 +660,7 @@ private:
 		std::vector<BufferBlock> ibo_blocks;
 		std::vector<BufferBlock> ubo_blocks;
 		std::vector<BufferBlock> staging_blocks;
+		std::vector<BufferBlock> descriptor_blocks;
 
 		std::vector<VkFence> wait_fences;
 		std::vector<VkFence> recycle_fences;
@@ -801,6 +843,7 @@ private:
 	void request_index_block_nolock(BufferBlock &block, VkDeviceSize size);
 	void request_uniform_block_nolock(BufferBlock &block, VkDeviceSize size);
 	void request_staging_block_nolock(BufferBlock &block, VkDeviceSize size);
+	void request_descriptor_block_nolock(BufferBlock &block, VkDeviceSize size);
 
 	CommandBufferHandle request_secondary_command_buffer_for_thread(unsigned thread_index,
 	                                                                const Framebuffer *framebuffer,
@@ -834,8 +877,10 @@ private:
 	bool enqueue_create_compute_pipeline(Fossilize::Hash hash, const VkComputePipelineCreateInfo *create_info, VkPipeline *pipeline) override;
 	bool enqueue_create_graphics_pipeline(Fossilize::Hash hash, const VkGraphicsPipelineCreateInfo *create_info, VkPipeline *pipeline) override;
 	bool enqueue_create_raytracing_pipeline(Fossilize::Hash hash, const VkRayTracingPipelineCreateInfoKHR *create_info, VkPipeline *pipeline) override;
-	bool fossilize_replay_graphics_pipeline(Fossilize::Hash hash, VkGraphicsPipelineCreateInfo &info);
-	bool fossilize_replay_compute_pipeline(Fossilize::Hash hash, VkComputePipelineCreateInfo &info);
+	bool fossilize_replay_graphics_pipeline(Fossilize::Hash hash, VkGraphicsPipelineCreateInfo &info, uint32_t replay_slot);
+	bool fossilize_replay_compute_pipeline(Fossilize::Hash hash, VkComputePipelineCreateInfo &info, uint32_t replay_slot);
+	void fossilize_replay_pipeline_done(uint32_t replay_slot);
+	void fossilize_schedule_replay();
 
 	void replay_tag_simple(Fossilize::ResourceTag tag);
 
@@ -847,6 +892,10 @@ private:
 	void register_shader_module(VkShaderModule module, Fossilize::Hash hash, const VkShaderModuleCreateInfo &info);
 	void register_sampler(VkSampler sampler, Fossilize::Hash hash, const VkSamplerCreateInfo &info);
 	void register_sampler_ycbcr_conversion(VkSamplerYcbcrConversion ycbcr, const VkSamplerYcbcrConversionCreateInfo &info);
+	void register_pipeline_use(Fossilize::Hash hash);
+	void register_replayed_pipeline_use(uint32_t replay_slot);
+	void load_pipeline_usage();
+	void save_pipeline_usage();
 
 	struct RecorderState;
 	std::unique_ptr<RecorderState> recorder_state;
@@ -31,6 +31,7 @@ namespace Vulkan
 Device::RecorderState::RecorderState()
 {
 	recorder_ready.store(false, std::memory_order_relaxed);
+	frame_count.store(0, std::memory_order_relaxed);
 }
 
 Device::RecorderState::~RecorderState()
@@ -42,6 +43,8 @@ Device::ReplayerState::ReplayerState()
 	progress.prepare.store(0, std::memory_order_relaxed);
 	progress.modules.store(0, std::memory_order_relaxed);
 	progress.pipelines.store(0, std::memory_order_relaxed);
+	progress.used_pipelines.store(0, std::memory_order_relaxed);
+	replay_cursor.store(0, std::memory_order_relaxed);
 }
 
 Device::ReplayerState::~ReplayerState()
@@ -126,11 +129,39 @@ void Device::register_shader_module(VkShaderModule module, Fossilize::Hash hash,
 		LOGW("Failed to register shader module.\n");
 }
 
+void Device::register_pipeline_use(Fossilize::Hash hash)
+{
+	auto &state = *recorder_state;
+	std::lock_guard<std::mutex> holder{state.usage_lock};
+	if (!state.used_hashes.insert(hash).second)
+		return;
+
+	PipelineUsage use = {};
+	use.hash = hash;
+	use.first_use_frame = state.frame_count.load(std::memory_order_relaxed);
+	use.first_use_order = uint32_t(state.first_uses.size());
+	use.sessions = 1;
+	state.first_uses.push_back(use);
+}
+
+void Device::register_replayed_pipeline_use(uint32_t replay_slot)
+{
+	if (!recorder_state)
+		return;
+
+	// Only the first use of a replayed pipeline needs to take the lock.
+	auto &used = recorder_state->replay_slot_used[replay_slot];
+	if (!used.load(std::memory_order_relaxed) && !used.exchange(true, std::memory_order_relaxed))
+		register_pipeline_use(recorder_state->replay_slot_hashes[replay_slot]);
+}
+
 void Device::register_compute_pipeline(Fossilize::Hash hash, const VkComputePipelineCreateInfo &info)
 {
 	if (!recorder_state)
 		return;
 
+	register_pipeline_use(hash);
+
 	if (!recorder_state->recorder_ready.load(std::memory_order_acquire))
 	{
 		LOGW("Attempting to register compute pipeline before recorder is ready.\n");
@@ -146,6 +177,8 @@ void Device::register_graphics_pipeline(Fossilize::Hash hash, const VkGraphicsPi
 	if (!recorder_state)
 		return;
 
+	register_pipeline_use(hash);
+
 	if (!recorder_state->recorder_ready.load(std::memory_order_acquire))
 	{
 		LOGW("Attempting to register graphics pipeline before recorder is ready.\n");
@@ -195,7 +228,8 @@ bool Device::enqueue_create_shader_module(Fossilize::Hash hash, const VkShaderMo
 	return true;
 }
 
-bool Device::fossilize_replay_graphics_pipeline(Fossilize::Hash hash, VkGraphicsPipelineCreateInfo &info)
+bool Device::fossilize_replay_graphics_pipeline(Fossilize::Hash hash, VkGraphicsPipelineCreateInfo &info,
+                                                uint32_t replay_slot)
 {
 	int vert_index = -1;
 	int task_index = -1;
@@ -261,7 +295,13 @@ bool Device::fossilize_replay_graphics_pipeline(Fossilize::Hash hash, VkGraphics
 	if (ret)
 	{
 		// The layout is dummy, resolve it here.
-		info.layout = ret->get_pipeline_layout()->get_layout();
+		// Whether it uses descriptor buffers depends on this device, not the recording one.
+		auto *layout = ret->get_pipeline_layout();
+		info.layout = layout->get_layout();
+		if (layout->uses_descriptor_buffer())
+			info.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+		else
+			info.flags &= ~VkPipelineCreateFlags(VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
 
 		// Resolve shader modules.
 		if (vert_index >= 0)
@@ -308,6 +348,27 @@ bool Device::fossilize_replay_graphics_pipeline(Fossilize::Hash hash, VkGraphics
 				dynamic_state |= COMMAND_BUFFER_DIRTY_STENCIL_REFERENCE_BIT;
 				break;
 
+			// Must match the mask computed in CommandBuffer::setup_graphics_pipeline_state(),
+			// otherwise replayed pipelines are keyed with a different dynamic mask than runtime pipelines.
+			case VK_DYNAMIC_STATE_CULL_MODE:
+			case VK_DYNAMIC_STATE_FRONT_FACE:
+			case VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE:
+			case VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE:
+			case VK_DYNAMIC_STATE_DEPTH_COMPARE_OP:
+			case VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE:
+			case VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE:
+			case VK_DYNAMIC_STATE_STENCIL_OP:
+			case VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY:
+			case VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE:
+			case VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT:
+			case VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT:
+			case VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT:
+			case VK_DYNAMIC_STATE_BLEND_CONSTANTS:
+			case VK_DYNAMIC_STATE_POLYGON_MODE_EXT:
+			case VK_DYNAMIC_STATE_ALPHA_TO_COVERAGE_ENABLE_EXT:
+				dynamic_state |= COMMAND_BUFFER_DIRTY_EXTENDED_DYNAMIC_STATE_BIT;
+				break;
+
 			default:
 				break;
 			}
@@ -323,7 +384,7 @@ bool Device::fossilize_replay_graphics_pipeline(Fossilize::Hash hash, VkGraphics
 		return false;
 	}
 
-	auto actual_pipe = ret->add_pipeline(hash, { pipeline, dynamic_state }).pipeline;
+	auto actual_pipe = ret->add_pipeline(hash, { pipeline, dynamic_state, replay_slot }).pipeline;
 	if (actual_pipe != pipeline)
 		table->vkDestroyPipeline(device, pipeline, nullptr);
 
@@ -331,7 +392,8 @@ bool Device::fossilize_replay_graphics_pipeline(Fossilize::Hash hash, VkGraphics
 	return actual_pipe != VK_NULL_HANDLE;
 }
 
-bool Device::fossilize_replay_compute_pipeline(Fossilize::Hash hash, VkComputePipelineCreateInfo &info)
+bool Device::fossilize_replay_compute_pipeline(Fossilize::Hash hash, VkComputePipelineCreateInfo &info,
+                                               uint32_t replay_slot)
 {
 	// Find the Shader* associated with this VkShaderModule and just use that.
 	auto *shader = shaders.find((Fossilize::Hash)info.stage.module);
@@ -346,7 +408,13 @@ bool Device::fossilize_replay_compute_pipeline(Fossilize::Hash hash, VkComputePi
 	if (ret)
 	{
 		// The layout is dummy, resolve it here.
-		info.layout = ret->get_pipeline_layout()->get_layout();
+		// Whether it uses descriptor buffers depends on this device, not the recording one.
+		auto *layout = ret->get_pipeline_layout();
+		info.layout = layout->get_layout();
+		if (layout->uses_descriptor_buffer())
+			info.flags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+		else
+			info.flags &= ~VkPipelineCreateFlags(VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
 
 		// Resolve shader module.
 		info.stage.module = shader->get_module();
@@ -370,7 +438,7 @@ bool Device::fossilize_replay_compute_pipeline(Fossilize::Hash hash, VkComputePi
 		return false;
 	}
 
-	auto actual_pipe = ret->add_pipeline(hash, { pipeline, 0 }).pipeline;
+	auto actual_pipe = ret->add_pipeline(hash, { pipeline, 0, replay_slot }).pipeline;
 	if (actual_pipe != pipeline)
 		table->vkDestroyPipeline(device, pipeline, nullptr);
 
@@ -378,6 +446,63 @@ bool Device::fossilize_replay_compute_pipeline(Fossilize::Hash hash, VkComputePi
 	return actual_pipe != VK_NULL_HANDLE;
 }
 
+void Device::fossilize_replay_pipeline_done(uint32_t replay_slot)
+{
+	auto &progress = replayer_state->progress;
+	if (replay_slot >= progress.num_used_pipelines)
+		return;
+
+	uint32_t done = progress.used_pipelines.fetch_add(1, std::memory_order_acq_rel) + 1;
+	if (done == progress.num_used_pipelines)
+	{
+		replayer_state->used_ready_time_ns = Util::get_current_time_nsecs() - replayer_state->start_time_ns;
+		LOGI("Fossilize: %u used pipelines ready after %.3f ms.\n",
+		     done, 1e-6 * double(replayer_state->used_ready_time_ns));
+	}
+}
+
+void Device::fossilize_schedule_replay()
+{
+	auto &order = replayer_state->replay_order;
+	auto &usage = replayer_state->usage;
+
+	order.reserve(replayer_state->graphics_pipelines.size() + replayer_state->compute_pipelines.size());
+	for (auto &pipe : replayer_state->graphics_pipelines)
+		order.push_back({ pipe.first, pipe.second, nullptr });
+	for (auto &pipe : replayer_state->compute_pipelines)
+		order.push_back({ pipe.first, nullptr, pipe.second });
+
+	auto num_used = uint32_t(PipelineUsageHistory::schedule(order, usage));
+	LOGI("Fossilize: Scheduling %zu pipelines, %u used by earlier sessions.\n", order.size(), num_used);
+
+	// Without history, the used set is everything.
+	if (!num_used)
+		num_used = uint32_t(order.size());
+	replayer_state->progress.num_used_pipelines = num_used;
+	if (!num_used)
+		replayer_state->progress.used_pipelines.store(~0u, std::memory_order_release);
+
+	recorder_state->replay_slot_hashes.reserve(order.size());
+	for (auto &pipe : order)
+		recorder_state->replay_slot_hashes.push_back(pipe.hash);
+	recorder_state->replay_slot_used.reset(new std::atomic_bool[order.size()]);
+	for (size_t i = 0; i < order.size(); i++)
+		recorder_state->replay_slot_used[i].store(false, std::memory_order_relaxed);
+}
+
+static bool graphics_pipeline_uses_dynamic_rendering(const DeviceFeatures &features,
+                                                     const VkGraphicsPipelineCreateInfo &info)
+{
+	if (!features.supports_dynamic_rendering)
+		return false;
+
+	for (auto *s = static_cast<const VkBaseInStructure *>(info.pNext); s; s = s->pNext)
+		if (s->sType == VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO)
+			return true;
+
+	return false;
+}
+
 bool Device::enqueue_create_graphics_pipeline(Fossilize::Hash hash,
                                               const VkGraphicsPipelineCreateInfo *create_info,
                                               VkPipeline *pipeline)
@@ -392,7 +517,8 @@ bool Device::enqueue_create_graphics_pipeline(Fossilize::Hash hash,
 		}
 	}
 
-	if (create_info->renderPass == VK_NULL_HANDLE || create_info->layout == VK_NULL_HANDLE)
+	if ((create_info->renderPass == VK_NULL_HANDLE && !graphics_pipeline_uses_dynamic_rendering(ext, *create_info)) ||
+	    create_info->layout == VK_NULL_HANDLE)
 	{
 		*pipeline = VK_NULL_HANDLE;
 		replayer_state->progress.pipelines.fetch_add(1, std::memory_order_release);
@@ -472,7 +598,11 @@ bool Device::enqueue_create_sampler(Fossilize::Hash hash, const VkSamplerCreateI
 
 bool Device::enqueue_create_descriptor_set_layout(Fossilize::Hash, const VkDescriptorSetLayoutCreateInfo *info, VkDescriptorSetLayout *layout)
 {
-	if (!replayer_state->feature_filter->descriptor_set_layout_is_supported(info))
+	// Set layouts are only used to recover immutable samplers here, the real layouts are created
+	// by request_pipeline_layout(), so a recorded descriptor buffer layout is fine without the extension.
+	auto filter_info = *info;
+	filter_info.flags &= ~VkDescriptorSetLayoutCreateFlags(VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT);
+	if (!replayer_state->feature_filter->descriptor_set_layout_is_supported(&filter_info))
 	{
 		*layout = VK_NULL_HANDLE;
 		return true;
@@ -558,9 +688,43 @@ void Device::promote_readonly_db_from_assets() const
 		std::string asset_iter;
 		if (fs->read_file_to_string("assets://fossilize/iteration", asset_iter))
 			fs->write_string_to_file("cache://fossilize/iteration", asset_iter);
+
+		// A shipped usage history lets the first session replay in a sensible order as well.
+		auto usage = fs->open_readonly_mapping("assets://fossilize/usage");
+		if (usage && !fs->write_buffer_to_file("cache://fossilize/usage", usage->data(), usage->get_size()))
+			LOGW("Failed to write to cache://fossilize/usage.\n");
 	}
 }
 
+void Device::load_pipeline_usage()
+{
+	auto file = get_system_handles().filesystem->open_readonly_mapping("cache://fossilize/usage");
+	if (file && !PipelineUsageHistory::parse(file->data(), file->get_size(), replayer_state->usage))
+		LOGW("Fossilize: Ignoring invalid pipeline usage history.\n");
+}
+
+void Device::save_pipeline_usage()
+{
+	auto *fs = get_system_handles().filesystem;
+	if (!fs || !recorder_state || !replayer_state)
+		return;
+
+	std::vector<uint32_t> words;
+
+	{
+		std::lock_guard<std::mutex> holder{recorder_state->usage_lock};
+
+		// Don't age out history because of a session which never rendered anything.
+		if (recorder_state->first_uses.empty())
+			return;
+
+		words = PipelineUsageHistory::serialize(recorder_state->first_uses, replayer_state->usage);
+	}
+
+	if (!fs->write_buffer_to_file("cache://fossilize/usage", words.data(), words.size() * sizeof(uint32_t)))
+		LOGW("Fossilize: Failed to write pipeline usage history.\n");
+}
+
 void Device::replay_tag_simple(Fossilize::ResourceTag tag)
 {
 	size_t count = 0;
@@ -597,7 +761,8 @@ void Device::promote_write_cache_to_readonly() const
 
 	for (auto &l : list)
 	{
-		if (l.type != Granite::PathType::File || l.path == "fossilize/iteration" || l.path == "fossilize/TOUCH")
+		if (l.type != Granite::PathType::File || l.path == "fossilize/iteration" || l.path == "fossilize/TOUCH" ||
+		    l.path == "fossilize/usage")
 			continue;
 		else if (l.path == "fossilize/db.foz")
 		{
@@ -693,6 +858,7 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 
 	replayer_state.reset(new ReplayerState);
 	recorder_state.reset(new RecorderState);
+	replayer_state->start_time_ns = Util::get_current_time_nsecs();
 
 	if (!recorder_state->recorder.record_application_info(application_info))
 		LOGW("Failed to record application info.\n");
@@ -747,6 +913,7 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 		{
 			replayer_state->progress.modules.store(~0u, std::memory_order_release);
 			replayer_state->progress.pipelines.store(~0u, std::memory_order_release);
+			replayer_state->progress.used_pipelines.store(~0u, std::memory_order_release);
 			return;
 		}
 
@@ -783,6 +950,8 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 			replayer_state->db->get_hash_list_for_resource_tag(Fossilize::RESOURCE_COMPUTE_PIPELINE, &count,
 			                                                   replayer_state->compute_hashes.data());
 
+			load_pipeline_usage();
+
 			replayer_state->progress.num_modules = replayer_state->module_hashes.size();
 			replayer_state->progress.num_pipelines =
 			    replayer_state->graphics_hashes.size() + replayer_state->compute_hashes.size();
@@ -791,7 +960,10 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 		if (replayer_state->progress.num_modules == 0)
 			replayer_state->progress.modules.store(~0u, std::memory_order_release);
 		if (replayer_state->progress.num_pipelines == 0)
+		{
 			replayer_state->progress.pipelines.store(~0u, std::memory_order_release);
+			replayer_state->progress.used_pipelines.store(~0u, std::memory_order_release);
+		}
 	});
 	prepare_task->set_desc("foz-prepare");
 
@@ -893,33 +1065,34 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 	parse_compute_task->set_desc("foz-parse-compute");
 	group->add_dependency(*parse_compute_task, *prepare_task);
 
-	auto compile_graphics_task = group->create_task();
-	auto compile_compute_task = group->create_task();
-	compile_graphics_task->set_desc("foz-compile-graphics");
-	compile_compute_task->set_desc("foz-compile-compute");
-	group->add_dependency(*compile_graphics_task, *parse_modules_task);
-	group->add_dependency(*compile_graphics_task, *parse_graphics_task);
-	group->add_dependency(*compile_compute_task, *parse_modules_task);
-	group->add_dependency(*compile_compute_task, *parse_compute_task);
+	auto schedule_task = group->create_task([this]() {
+		fossilize_schedule_replay();
+	});
+	schedule_task->set_desc("foz-schedule-replay");
+	group->add_dependency(*schedule_task, *parse_graphics_task);
+	group->add_dependency(*schedule_task, *parse_compute_task);
+
+	// Workers pull pipelines in scheduled order, so the pipelines used by earlier sessions
+	// become available first, and in roughly the order they will be needed.
+	auto compile_pipelines_task = group->create_task();
+	compile_pipelines_task->set_desc("foz-compile-pipelines");
+	group->add_dependency(*compile_pipelines_task, *parse_modules_task);
+	group->add_dependency(*compile_pipelines_task, *schedule_task);
 	for (unsigned i = 0; i < NumTasks; i++)
 	{
-		compile_graphics_task->enqueue_task([this, i]() {
-			size_t start = (i * replayer_state->graphics_pipelines.size()) / NumTasks;
-			size_t end = ((i + 1) * replayer_state->graphics_pipelines.size()) / NumTasks;
-			for (; start < end; start++)
-			{
-				auto &pipe = replayer_state->graphics_pipelines[start];
-				fossilize_replay_graphics_pipeline(pipe.first, *pipe.second);
-			}
-		});
+		compile_pipelines_task->enqueue_task([this]() {
+			auto &order = replayer_state->replay_order;
+			auto count = uint32_t(order.size());
+			uint32_t slot;
 
-		compile_compute_task->enqueue_task([this, i]() {
-			size_t start = (i * replayer_state->compute_pipelines.size()) / NumTasks;
-			size_t end = ((i + 1) * replayer_state->compute_pipelines.size()) / NumTasks;
-			for (; start < end; start++)
+			while ((slot = replayer_state->replay_cursor.fetch_add(1, std::memory_order_relaxed)) < count)
 			{
-				auto &pipe = replayer_state->compute_pipelines[start];
-				fossilize_replay_compute_pipeline(pipe.first, *pipe.second);
+				auto &pipe = order[slot];
+				if (pipe.graphics)
+					fossilize_replay_graphics_pipeline(pipe.hash, *pipe.graphics, slot);
+				else
+					fossilize_replay_compute_pipeline(pipe.hash, *pipe.compute, slot);
+				fossilize_replay_pipeline_done(slot);
 			}
 		});
 	}
@@ -929,6 +1102,9 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 			 replayer_state->module_hashes.size(),
 			 replayer_state->graphics_hashes.size(),
 			 replayer_state->compute_hashes.size());
+		LOGI("  Used pipelines ready: %.3f ms\n  All pipelines ready: %.3f ms\n",
+			 1e-6 * double(replayer_state->used_ready_time_ns),
+			 1e-6 * double(Util::get_current_time_nsecs() - replayer_state->start_time_ns));
 		lock.read_only_cache.unlock_read();
 		const auto cleanup = [](Fossilize::StateReplayer &r) {
 			r.forget_handle_references();
@@ -940,34 +1116,32 @@ void Device::init_pipeline_state(const Fossilize::FeatureFilter &filter,
 		cleanup(replayer_state->compute_replayer);
 		replayer_state->graphics_pipelines.clear();
 		replayer_state->compute_pipelines.clear();
+		replayer_state->replay_order.clear();
 		replayer_state->module_hashes.clear();
 		replayer_state->graphics_hashes.clear();
 		replayer_state->compute_hashes.clear();
 		replayer_state->db.reset();
 	});
 	replayer_state->complete->set_desc("foz-replay-complete");
-	group->add_dependency(*replayer_state->complete, *compile_graphics_task);
-	group->add_dependency(*replayer_state->complete, *compile_compute_task);
+	group->add_dependency(*replayer_state->complete, *compile_pipelines_task);
 	replayer_state->complete->flush();
 
 	replayer_state->module_ready = std::move(parse_modules_task);
 	replayer_state->module_ready->flush();
 
 	auto compile_task = group->create_task();
-	group->add_dependency(*compile_task, *compile_graphics_task);
-	group->add_dependency(*compile_task, *compile_compute_task);
+	group->add_dependency(*compile_task, *compile_pipelines_task);
 	replayer_state->pipeline_ready = std::move(compile_task);
 	replayer_state->pipeline_ready->flush();
 }
 
 void Device::flush_pipeline_state()
 {
-	if (replayer_state)
-	{
-		if (replayer_state->complete)
-			replayer_state->complete->wait();
-		replayer_state.reset();
-	}
+	if (replayer_state && replayer_state->complete)
+		replayer_state->complete->wait();
+
+	save_pipeline_usage();
+	replayer_state.reset();
 
 	if (recorder_state)
 	{
@@ -1008,6 +1182,17 @@ unsigned Device::query_initialization_progress(InitializationStage status) const
 		return (100u * done) / replayer_state->progress.num_pipelines;
 	}
 
+	case InitializationStage::UsedPipelines:
+	{
+		unsigned done = replayer_state->progress.used_pipelines.load(std::memory_order_acquire);
+		// Avoid 0/0.
+		if (!done)
+			return 0;
+		else if (done == ~0u)
+			return 100;
+		return (100u * done) / replayer_state->progress.num_used_pipelines;
+	}
+
 	default:
 		break;
 	}
@@ -24,6 +24,9 @@
 
 #include "device.hpp"
 #include "thread_group.hpp"
+#include "pipeline_usage.hpp"
+#include <unordered_map>
+#include <unordered_set>
 
 namespace Vulkan
 {
@@ -35,6 +38,16 @@ struct Device::RecorderState
 	std::unique_ptr<Fossilize::DatabaseInterface> db;
 	Fossilize::StateRecorder recorder;
 	std::atomic_bool recorder_ready;
+
+	// First use of pipelines in this session.
+	std::atomic_uint32_t frame_count;
+	std::mutex usage_lock;
+	std::unordered_set<Fossilize::Hash> used_hashes;
+	std::vector<PipelineUsage> first_uses;
+
+	// Replayed pipelines carry a slot, so first use can be observed without a hash lookup.
+	std::vector<Fossilize::Hash> replay_slot_hashes;
+	std::unique_ptr<std::atomic_bool[]> replay_slot_used;
 };
 
 static constexpr unsigned NumTasks = 4;
@@ -58,12 +71,28 @@ struct Device::ReplayerState
 	std::vector<std::pair<Fossilize::Hash, VkGraphicsPipelineCreateInfo *>> graphics_pipelines;
 	std::vector<std::pair<Fossilize::Hash, VkComputePipelineCreateInfo *>> compute_pipelines;
 
+	// Graphics and compute pipelines in compile order.
+	// Pipelines used in earlier sessions come first, ordered by first use and frequency.
+	struct ReplayPipeline
+	{
+		Fossilize::Hash hash;
+		VkGraphicsPipelineCreateInfo *graphics;
+		VkComputePipelineCreateInfo *compute;
+	};
+	std::vector<ReplayPipeline> replay_order;
+	std::atomic_uint32_t replay_cursor;
+	PipelineUsageMap usage;
+	uint64_t start_time_ns = 0;
+	uint64_t used_ready_time_ns = 0;
+
 	struct
 	{
 		std::atomic_uint32_t pipelines;
+		std::atomic_uint32_t used_pipelines;
 		std::atomic_uint32_t modules;
 		std::atomic_uint32_t prepare;
 		uint32_t num_pipelines = 0;
+		uint32_t num_used_pipelines = 0;
 		uint32_t num_modules = 0;
 	} progress;
 };
@@ -74,7 +74,8 @@ void ResourceManager::set_asset_class(Granite::AssetID id, Granite::AssetClass a
 			std::unique_lock<std::mutex> holder{lock};
 			views.resize(assets.size());
 
-			if (!views[id.id])
+			// IDs are recycled when assets are unregistered, possibly with a different class.
+			if (!views[id.id] || !assets[id.id].image)
 				views[id.id] = &get_fallback_image(asset_class)->get_view();
 		}
 	}
@@ -228,12 +229,80 @@ void ResourceManager::init()
 	}
 }
 
-ImageHandle ResourceManager::create_gtx(const MemoryMappedTexture &mapped_file, Granite::AssetID id)
+// Mips are laid out finest first with consistent alignment, so the levels from first_level onwards
+// form a valid layout of their own at the end of the buffer.
+static TextureFormatLayout get_mip_tail_layout(const TextureFormatLayout &layout, uint32_t first_level)
+{
+	TextureFormatLayout tail;
+	uint32_t levels = layout.get_levels() - first_level;
+
+	switch (layout.get_image_type())
+	{
+	case VK_IMAGE_TYPE_1D:
+		tail.set_1d(layout.get_format(), layout.get_width(first_level), layout.get_layers(), levels);
+		break;
+
+	case VK_IMAGE_TYPE_2D:
+		tail.set_2d(layout.get_format(), layout.get_width(first_level), layout.get_height(first_level),
+		            layout.get_layers(), levels);
+		break;
+
+	case VK_IMAGE_TYPE_3D:
+		tail.set_3d(layout.get_format(), layout.get_width(first_level), layout.get_height(first_level),
+		            layout.get_depth(first_level), levels);
+		break;
+
+	default:
+		return {};
+	}
+
+	size_t offset = layout.get_mip_info(first_level).offset;
+	VK_ASSERT(tail.get_required_size() == layout.get_required_size() - offset);
+
+	// Supercompressed textures have no data in the layout, the tail is decompressed on demand.
+	if (layout.get_buffer())
+		tail.set_buffer(static_cast<uint8_t *>(layout.get_buffer()) + offset, tail.get_required_size());
+	return tail;
+}
+
+// Decompresses only the uploaded levels, straight into the staging buffer.
+static InitialImageBuffer create_supercompressed_staging_buffer(Device &device, const MemoryMappedTexture &mapped_file,
+                                                                const TextureFormatLayout &layout, uint32_t first_level)
+{
+	InitialImageBuffer result;
+
+	BufferCreateInfo buffer_info = {};
+	// LZ4 reads back from its output, so avoid write-combined memory.
+	buffer_info.domain = BufferDomain::CachedCoherentHostPreferCached;
+	buffer_info.size = layout.get_required_size();
+	buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	result.buffer = device.create_buffer(buffer_info);
+	if (!result.buffer)
+		return {};
+	device.set_name(*result.buffer, "image-upload-staging-buffer");
+
+	void *mapped = device.map_host_buffer(*result.buffer, MEMORY_ACCESS_WRITE_BIT);
+	bool ret = mapped_file.decompress_levels(mapped, first_level, device.get_system_handles().thread_group);
+	device.unmap_host_buffer(*result.buffer, MEMORY_ACCESS_WRITE_BIT);
+
+	if (!ret)
+		return {};
+
+	layout.build_buffer_image_copies(result.blits);
+	return result;
+}
+
+ImageHandle ResourceManager::create_gtx(const MemoryMappedTexture &mapped_file, Granite::AssetID id,
+                                        uint32_t first_level)
 {
 	if (mapped_file.empty())
 		return {};
 
-	auto &layout = mapped_file.get_layout();
+	bool supercompressed = mapped_file.is_supercompressed();
+	TextureFormatLayout tail_layout;
+	if (first_level != 0 || supercompressed)
+		tail_layout = get_mip_tail_layout(mapped_file.get_layout(), first_level);
+	auto &layout = first_level != 0 || supercompressed ? tail_layout : mapped_file.get_layout();
 
 	VkComponentMapping swizzle = {};
 	mapped_file.remap_swizzle(swizzle);
@@ -245,9 +314,20 @@ ImageHandle ResourceManager::create_gtx(const MemoryMappedTexture &mapped_file,
 		LOGI("Compressed format #%u is not supported, falling back to compute decode of compressed image.\n",
 		     unsigned(layout.get_format()));
 
+		std::vector<uint8_t> decompressed;
+		if (supercompressed)
+		{
+			decompressed.resize(tail_layout.get_required_size());
+			if (!mapped_file.decompress_levels(decompressed.data(), first_level, device->get_system_handles().thread_group))
+				return {};
+			tail_layout.set_buffer(decompressed.data(), decompressed.size());
+		}
+
 		GRANITE_SCOPED_TIMELINE_EVENT_FILE(device->get_system_handles().timeline_trace_file, "texture-load-submit-decompress");
 		auto cmd = device->request_command_buffer(CommandBuffer::Type::AsyncCompute);
-		image = Granite::decode_compressed_image(*cmd, layout, VK_FORMAT_UNDEFINED, swizzle);
+		// Supercompressed data only exists in the decompressed tail, never decode from the file layout.
+		image = Granite::decode_compressed_image(*cmd, supercompressed ? tail_layout : layout,
+		                                         VK_FORMAT_UNDEFINED, swizzle);
 		Semaphore sem;
 		device->submit(cmd, nullptr, 1, &sem);
 		device->add_wait_semaphore(CommandBuffer::Type::Generic, sem, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, true);
@@ -282,7 +362,16 @@ ImageHandle ResourceManager::create_gtx(const MemoryMappedTexture &mapped_file,
 		{
 			GRANITE_SCOPED_TIMELINE_EVENT_FILE(device->get_system_handles().timeline_trace_file,
 			                                   "texture-load-create-staging");
-			staging = device->create_image_staging_buffer(layout);
+			if (supercompressed)
+				staging = create_supercompressed_staging_buffer(*device, mapped_file, layout, first_level);
+			else
+				staging = device->create_image_staging_buffer(layout);
+		}
+
+		if (!staging.buffer)
+		{
+			LOGE("Failed to create staging buffer for texture.\n");
+			return {};
 		}
 
 		{
@@ -300,18 +389,6 @@ ImageHandle ResourceManager::create_gtx(const MemoryMappedTexture &mapped_file,
 	return image;
 }
 
-ImageHandle ResourceManager::create_gtx(Granite::FileMappingHandle mapping, Granite::AssetID id)
-{
-	MemoryMappedTexture mapped_file;
-	if (!mapped_file.map_read(std::move(mapping)))
-	{
-		LOGE("Failed to read texture.\n");
-		return {};
-	}
-
-	return create_gtx(mapped_file, id);
-}
-
 ImageHandle ResourceManager::create_other(const Granite::FileMapping &mapping, Granite::AssetClass asset_class,
                                           Granite::AssetID id)
 {
@@ -321,6 +398,70 @@ ImageHandle ResourceManager::create_other(const Granite::FileMapping &mapping, G
 	return create_gtx(tex, id);
 }
 
+ImageHandle ResourceManager::create_trimmed_image(const Image &image, Granite::AssetID id, uint32_t first_level)
+{
+	auto info = image.get_create_info();
+	if (first_level >= info.levels)
+		return {};
+
+	info.width = std::max(info.width >> first_level, 1u);
+	info.height = std::max(info.height >> first_level, 1u);
+	info.depth = std::max(info.depth >> first_level, 1u);
+	info.levels -= first_level;
+	info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	info.misc &= ~IMAGE_MISC_GENERATE_MIPS_BIT;
+	info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	auto trimmed = device->create_image(info);
+	if (!trimmed)
+		return {};
+
+	// The resident image is sampled by rendering on the graphics queue,
+	// so transition it there, where the copy is ordered against that rendering.
+	auto cmd = device->request_command_buffer(CommandBuffer::Type::Generic);
+	cmd->image_barrier(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	                   VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, 0,
+	                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	cmd->image_barrier(*trimmed, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                   VK_PIPELINE_STAGE_NONE, 0,
+	                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+	VkImageSubresourceLayers subresource = {};
+	subresource.aspectMask = format_to_aspect_mask(info.format);
+	subresource.layerCount = info.layers;
+
+	for (uint32_t level = 0; level < info.levels; level++)
+	{
+		VkImageSubresourceLayers src_subresource = subresource;
+		VkImageSubresourceLayers dst_subresource = subresource;
+		src_subresource.mipLevel = level + first_level;
+		dst_subresource.mipLevel = level;
+
+		VkExtent3D extent = {
+			trimmed->get_width(level),
+			trimmed->get_height(level),
+			trimmed->get_depth(level),
+		};
+		cmd->copy_image(*trimmed, image, {}, {}, extent, dst_subresource, src_subresource);
+	}
+
+	cmd->image_barrier(image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                   VK_PIPELINE_STAGE_2_COPY_BIT, 0,
+	                   VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+	cmd->image_barrier(*trimmed, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	                   VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+	                   VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+	Semaphore sem;
+	device->submit(cmd, nullptr, 1, &sem);
+	device->add_wait_semaphore(CommandBuffer::Type::AsyncCompute, std::move(sem),
+	                           VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, true);
+
+	auto name = Util::join("AssetID-", id.id);
+	device->set_name(*trimmed, name.c_str());
+	return trimmed;
+}
+
 const ImageView *ResourceManager::get_image_view_blocking(Granite::AssetID id)
 {
 	std::unique_lock<std::mutex> holder{lock};
@@ -383,33 +524,11 @@ bool ResourceManager::allocate_asset_mesh(Granite::AssetID id, const Meshlet::Me
 	std::lock_guard<std::mutex> holder{mesh_allocator_lock};
 	auto &asset = assets[id.id];
 
-	bool ret = true;
-
-	if (mesh_encoding == MeshEncoding::MeshletEncoded)
-	{
-		if (ret)
-			ret = mesh_header_allocator.allocate(view.num_bounds_256, &asset.mesh.indirect_or_header);
-
-		if (ret)
-		{
-			ret = mesh_stream_allocator.allocate(
-					view.num_bounds_256 * Meshlet::ChunkFactor * view.format_header->stream_count,
-					&asset.mesh.attr_or_stream);
-		}
-
-		if (ret)
-			ret = mesh_payload_allocator.allocate(view.format_header->payload_size_words, &asset.mesh.index_or_payload);
-	}
-	else
-	{
-		if (ret)
-			ret = index_buffer_allocator.allocate(view.total_primitives, &asset.mesh.index_or_payload);
-		if (ret)
-			ret = attribute_buffer_allocator.allocate(view.total_vertices, &asset.mesh.attr_or_stream);
-
-		if (ret && mesh_encoding != MeshEncoding::Classic)
-			ret = indirect_buffer_allocator.allocate(view.num_bounds_256, &asset.mesh.indirect_or_header);
-	}
+	bool ret = index_buffer_allocator.allocate(view.total_primitives, &asset.mesh.index_or_payload);
+	if (ret)
+		ret = attribute_buffer_allocator.allocate(view.total_vertices, &asset.mesh.attr_or_stream);
+	if (ret && mesh_encoding != MeshEncoding::Classic)
+		ret = indirect_buffer_allocator.allocate(view.num_bounds_256, &asset.mesh.indirect_or_header);
 
 	if (mesh_encoding == MeshEncoding::Classic)
 	{
@@ -430,19 +549,9 @@ bool ResourceManager::allocate_asset_mesh(Granite::AssetID id, const Meshlet::Me
 
 	if (!ret)
 	{
-		if (mesh_encoding == MeshEncoding::MeshletEncoded)
-		{
-			mesh_payload_allocator.free(asset.mesh.index_or_payload);
-			mesh_stream_allocator.free(asset.mesh.attr_or_stream);
-			mesh_header_allocator.free(asset.mesh.indirect_or_header);
-		}
-		else
-		{
-			index_buffer_allocator.free(asset.mesh.index_or_payload);
-			attribute_buffer_allocator.free(asset.mesh.attr_or_stream);
-			indirect_buffer_allocator.free(asset.mesh.indirect_or_header);
-		}
-
+		index_buffer_allocator.free(asset.mesh.index_or_payload);
+		attribute_buffer_allocator.free(asset.mesh.attr_or_stream);
+		indirect_buffer_allocator.free(asset.mesh.indirect_or_header);
 		asset.mesh = {};
 	}
 	return ret;
@@ -456,6 +565,12 @@ void ResourceManager::instantiate_asset_mesh(Granite::AssetManager &manager_,
 	if (file.get_size())
 		mapping = file.map();
 
+	if (mesh_encoding == MeshEncoding::MeshletEncoded)
+	{
+		instantiate_asset_mesh_paged(manager_, id, mapping.get());
+		return;
+	}
+
 	Meshlet::MeshView view = {};
 	if (mapping)
 		view = Meshlet::create_mesh_view(*mapping);
@@ -463,7 +578,6 @@ void ResourceManager::instantiate_asset_mesh(Granite::AssetManager &manager_,
 
 	// Decode the meshlet. Later, we'll have to do a lot of device specific stuff here to select optimal
 	// processing:
-	// - Native meshlets
 	// - Encoded attribute
 	// - Decoded attributes
 	// - Optimize for multi-draw-indirect or not? (8-bit indices).
@@ -472,49 +586,254 @@ void ResourceManager::instantiate_asset_mesh(Granite::AssetManager &manager_,
 
 	if (ret)
 	{
-		size_t total_streams = view.format_header->meshlet_count * view.format_header->stream_count;
-		size_t total_padded_streams = view.num_bounds_256 * Meshlet::ChunkFactor * view.format_header->stream_count;
+		auto cmd = device->request_command_buffer(CommandBuffer::Type::AsyncCompute);
 
-		if (mesh_encoding == MeshEncoding::MeshletEncoded)
-		{
-			auto cmd = device->request_command_buffer(CommandBuffer::Type::AsyncTransfer);
+		BufferCreateInfo buf = {};
+		buf.domain = BufferDomain::Host;
+		buf.size = view.format_header->payload_size_words * sizeof(Meshlet::PayloadWord);
+		buf.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		auto payload = device->create_buffer(buf, view.payload);
 
-			void *payload_data = cmd->update_buffer(*mesh_payload_allocator.get_buffer(0, 0),
-			                                        asset.mesh.index_or_payload.offset * sizeof(Meshlet::PayloadWord),
-			                                        view.format_header->payload_size_words * sizeof(Meshlet::PayloadWord));
-			memcpy(payload_data, view.payload, view.format_header->payload_size_words * sizeof(Meshlet::PayloadWord));
+		Meshlet::DecodeInfo info = {};
+		info.target_style = Meshlet::MeshStyle::Textured;
+		if (mesh_encoding == MeshEncoding::Classic)
+			info.flags |= Meshlet::DECODE_MODE_UNROLLED_MESH;
+		info.ibo = index_buffer_allocator.get_buffer(0, 0);
 
-			auto *headers = static_cast<Meshlet::RuntimeHeaderEncoded *>(
-					cmd->update_buffer(*mesh_header_allocator.get_buffer(0, 0),
-					                   asset.mesh.indirect_or_header.offset * sizeof(Meshlet::RuntimeHeaderEncoded),
-					                   view.num_bounds_256 * sizeof(Meshlet::RuntimeHeaderEncoded)));
+		for (unsigned i = 0; i < 3; i++)
+			info.streams[i] = attribute_buffer_allocator.get_buffer(0, i);
 
-			for (uint32_t i = 0, n = view.num_bounds_256; i < n; i++)
-			{
-				headers[i].stream_offset = asset.mesh.attr_or_stream.offset +
-				                           i * Meshlet::ChunkFactor * view.format_header->stream_count;
-			}
+		info.payload = payload.get();
+
+		info.push.primitive_offset = asset.mesh.index_or_payload.offset;
+		info.push.vertex_offset = asset.mesh.attr_or_stream.offset;
 
+		info.runtime_style = mesh_encoding == MeshEncoding::MeshletDecoded ?
+		                     Meshlet::RuntimeStyle::Meshlet : Meshlet::RuntimeStyle::MDI;
+
+		if (mesh_encoding != MeshEncoding::Classic)
+		{
 			auto *bounds = static_cast<Meshlet::Bound *>(
-					cmd->update_buffer(*mesh_header_allocator.get_buffer(0, 1),
+					cmd->update_buffer(*indirect_buffer_allocator.get_buffer(0, 1),
 					                   asset.mesh.indirect_or_header.offset * sizeof(Meshlet::Bound),
 					                   view.num_bounds_256 * sizeof(Meshlet::Bound)));
 			memcpy(bounds, view.bounds_256, view.num_bounds_256 * sizeof(Meshlet::Bound));
 
-			auto *streams = static_cast<Meshlet::Stream *>(
-					cmd->update_buffer(*mesh_stream_allocator.get_buffer(0, 0),
-					                   asset.mesh.attr_or_stream.offset * sizeof(Meshlet::Stream),
-									   total_padded_streams * sizeof(Meshlet::Stream)));
+			info.indirect = indirect_buffer_allocator.get_buffer(0, 0);
+			info.indirect_offset = asset.mesh.indirect_or_header.offset;
+		}
 
-			for (uint32_t i = 0; i < total_streams; i++)
-			{
-				auto in_stream = view.streams[i];
-				in_stream.offset_in_words += asset.mesh.index_or_payload.offset;
-				streams[i] = in_stream;
-			}
+		Meshlet::decode_mesh(*cmd, info, view);
+
+		Semaphore sem;
+		device->submit(cmd, nullptr, 1, &sem);
+		device->add_wait_semaphore(CommandBuffer::Type::Generic, std::move(sem),
+		                           VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT |
+		                           VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, false);
+	}
+
+	uint64_t cost = 0;
+	if (ret)
+	{
+		cost += view.total_primitives * index_buffer_allocator.get_element_size(0);
+		cost += view.total_vertices * attribute_buffer_allocator.get_element_size(0);
+		cost += view.total_vertices * attribute_buffer_allocator.get_element_size(1);
+		cost += view.total_vertices * attribute_buffer_allocator.get_element_size(2);
+		if (mesh_encoding != MeshEncoding::Classic)
+		{
+			cost += view.format_header->meshlet_count * indirect_buffer_allocator.get_element_size(0);
+			cost += view.format_header->meshlet_count * indirect_buffer_allocator.get_element_size(1);
+		}
+	}
+
+	std::lock_guard<std::mutex> holder{lock};
+	updates.push_back(id);
+	manager_.update_cost(id, ret ? cost : 0);
+	asset.latchable = true;
+	cond.notify_all();
+}
+
+static uint32_t create_mesh_views(const Granite::FileMapping &mapping, Meshlet::MeshView *views)
+{
+	views[0] = Meshlet::create_mesh_view(mapping);
+	if (!views[0].format_header)
+		return 0;
 
-			memset(streams + total_streams, 0, (total_padded_streams - total_streams) * sizeof(Meshlet::Stream));
+	uint32_t num_levels = views[0].num_lod_levels;
+	for (uint32_t level = 1; level < num_levels; level++)
+	{
+		views[level] = Meshlet::create_mesh_view(mapping, level);
+		if (!views[level].format_header)
+			return 0;
+	}
+
+	return num_levels;
+}
+
+bool ResourceManager::allocate_mesh_residency_level(CommandBuffer &cmd, Meshlet::PayloadPages &pages,
+                                                    MeshResidencyLevel &level)
+{
+	if (pages.streams.empty())
+		return true;
+
+	{
+		std::lock_guard<std::mutex> holder{mesh_allocator_lock};
+		bool ret = mesh_stream_allocator.allocate(uint32_t(pages.streams.size()), &level.streams);
 
+		// Fixed size pages never fragment the payload buffer, and trimming a level returns whole pages.
+		level.pages.resize(pages.num_pages);
+		for (auto &page : level.pages)
+			if (ret)
+				ret = mesh_payload_allocator.allocate(Meshlet::PayloadPageWords, &page);
+
+		if (!ret)
+		{
+			free_mesh_residency_level(level);
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < pages.num_pages; i++)
+	{
+		void *payload = cmd.update_buffer(*mesh_payload_allocator.get_buffer(0, 0),
+		                                  level.pages[i].offset * sizeof(Meshlet::PayloadWord),
+		                                  Meshlet::PayloadPageWords * sizeof(Meshlet::PayloadWord));
+		memcpy(payload, pages.payload.data() + i * Meshlet::PayloadPageWords,
+		       Meshlet::PayloadPageWords * sizeof(Meshlet::PayloadWord));
+	}
+
+	for (auto &stream : pages.streams)
+	{
+		uint32_t page = stream.offset_in_words / Meshlet::PayloadPageWords;
+		stream.offset_in_words = level.pages[page].offset + stream.offset_in_words % Meshlet::PayloadPageWords;
+	}
+
+	void *streams = cmd.update_buffer(*mesh_stream_allocator.get_buffer(0, 0),
+	                                  level.streams.offset * sizeof(Meshlet::Stream),
+	                                  pages.streams.size() * sizeof(Meshlet::Stream));
+	memcpy(streams, pages.streams.data(), pages.streams.size() * sizeof(Meshlet::Stream));
+
+	level.cost = uint64_t(pages.num_pages) * Meshlet::PayloadPageWords * mesh_payload_allocator.get_element_size(0) +
+	             pages.streams.size() * mesh_stream_allocator.get_element_size(0);
+	return true;
+}
+
+bool ResourceManager::allocate_mesh_draw(CommandBuffer &cmd, const Meshlet::MeshView *views,
+                                         const std::vector<Meshlet::ResidencyChunk> *residency_levels,
+                                         uint32_t num_residency_levels, uint32_t level,
+                                         uint32_t level_stream_offset, uint32_t pinned_stream_offset,
+                                         Util::AllocatedSlice &header, DrawCall &draw)
+{
+	uint32_t pinned_level = num_residency_levels - 1;
+	auto &chunks = residency_levels[level];
+	auto &pinned_chunks = residency_levels[pinned_level];
+	uint32_t chunk_stride = Meshlet::ChunkFactor * views[0].format_header->stream_count;
+
+	uint32_t count = level != pinned_level ? uint32_t(chunks.size()) : 0;
+	for (auto &chunk : pinned_chunks)
+		if (chunk.lod_level <= level)
+			count++;
+
+	if (!count)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> holder{mesh_allocator_lock};
+		if (!mesh_header_allocator.allocate(count, &header))
+			return false;
+	}
+
+	auto *headers = static_cast<Meshlet::RuntimeHeaderEncoded *>(
+			cmd.update_buffer(*mesh_header_allocator.get_buffer(0, 0),
+			                  header.offset * sizeof(Meshlet::RuntimeHeaderEncoded),
+			                  count * sizeof(Meshlet::RuntimeHeaderEncoded)));
+
+	auto *bounds = static_cast<Meshlet::Bound *>(
+			cmd.update_buffer(*mesh_header_allocator.get_buffer(0, 1),
+			                  header.offset * sizeof(Meshlet::Bound),
+			                  count * sizeof(Meshlet::Bound)));
+
+	// The level's own chunks, then roots which are part of this cut from the always resident level.
+	uint32_t index = 0;
+	if (level != pinned_level)
+	{
+		for (uint32_t i = 0, n = uint32_t(chunks.size()); i < n; i++, index++)
+		{
+			headers[index].stream_offset = level_stream_offset + i * chunk_stride;
+			bounds[index] = views[chunks[i].lod_level].bounds_256[chunks[i].chunk_index];
+		}
+	}
+
+	for (uint32_t i = 0, n = uint32_t(pinned_chunks.size()); i < n; i++)
+	{
+		if (pinned_chunks[i].lod_level <= level)
+		{
+			headers[index].stream_offset = pinned_stream_offset + i * chunk_stride;
+			bounds[index] = views[pinned_chunks[i].lod_level].bounds_256[pinned_chunks[i].chunk_index];
+			index++;
+		}
+	}
+
+	draw.meshlet = { header.offset, count, views[0].format_header->style };
+	return true;
+}
+
+void ResourceManager::free_mesh_residency_level(MeshResidencyLevel &level)
+{
+	mesh_stream_allocator.free(level.streams);
+	for (auto &page : level.pages)
+		mesh_payload_allocator.free(page);
+	level = {};
+}
+
+uint64_t ResourceManager::get_mesh_resident_cost(const Asset &asset) const
+{
+	uint64_t cost = 0;
+	for (size_t i = asset.resident_level; i < asset.mesh.levels.size(); i++)
+		cost += asset.mesh.levels[i].cost;
+
+	auto &header = asset.mesh.pending_header.count ? asset.mesh.pending_header : asset.mesh.indirect_or_header;
+	cost += uint64_t(header.count) *
+	        (mesh_header_allocator.get_element_size(0) + mesh_header_allocator.get_element_size(1));
+	return cost;
+}
+
+void ResourceManager::instantiate_asset_mesh_paged(Granite::AssetManager &manager_, Granite::AssetID id,
+                                                   const Granite::FileMapping *mapping)
+{
+	auto &asset = assets[id.id];
+
+	Meshlet::MeshView views[Meshlet::MaxLodLevels];
+	std::vector<Meshlet::ResidencyChunk> residency_levels[Meshlet::MaxLodLevels];
+	uint32_t num_views = mapping ? create_mesh_views(*mapping, views) : 0;
+	uint32_t num_residency_levels = Meshlet::build_residency_levels(views, num_views, residency_levels);
+
+	// Only the coarse fallback is loaded up front, finer levels are streamed in by the asset manager.
+	std::vector<MeshResidencyLevel> levels(num_residency_levels);
+	uint32_t pinned_level = num_residency_levels ? num_residency_levels - 1 : 0;
+	Util::AllocatedSlice header;
+	DrawCall draw = {};
+	Meshlet::PayloadPages pages;
+	bool ret = false;
+
+	if (num_residency_levels)
+	{
+		ret = Meshlet::build_payload_pages(views, num_views, residency_levels[pinned_level].data(),
+		                                   residency_levels[pinned_level].size(), true, pages);
+	}
+
+	if (ret)
+	{
+		auto cmd = device->request_command_buffer(CommandBuffer::Type::AsyncTransfer);
+		ret = allocate_mesh_residency_level(*cmd, pages, levels[pinned_level]);
+		if (ret)
+		{
+			ret = allocate_mesh_draw(*cmd, views, residency_levels, num_residency_levels, pinned_level,
+			                         0, levels[pinned_level].streams.offset, header, draw);
+		}
+
+		if (ret)
+		{
 			Semaphore sem;
 			device->submit(cmd, nullptr, 1, &sem);
 			device->add_wait_semaphore(CommandBuffer::Type::Generic, std::move(sem),
@@ -523,82 +842,162 @@ void ResourceManager::instantiate_asset_mesh(Granite::AssetManager &manager_,
 		}
 		else
 		{
-			auto cmd = device->request_command_buffer(CommandBuffer::Type::AsyncCompute);
+			device->submit_discard(cmd);
+			std::lock_guard<std::mutex> holder{mesh_allocator_lock};
+			free_mesh_residency_level(levels[pinned_level]);
+		}
+	}
 
-			BufferCreateInfo buf = {};
-			buf.domain = BufferDomain::Host;
-			buf.size = view.format_header->payload_size_words * sizeof(Meshlet::PayloadWord);
-			buf.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-			auto payload = device->create_buffer(buf, view.payload);
+	uint64_t level_costs[Granite::AssetManager::MaxResidencyLevels] = {};
+	if (ret && pinned_level != 0)
+	{
+		level_costs[pinned_level] = levels[pinned_level].cost;
 
-			Meshlet::DecodeInfo info = {};
-			info.target_style = Meshlet::MeshStyle::Textured;
-			if (mesh_encoding == MeshEncoding::Classic)
-				info.flags |= Meshlet::DECODE_MODE_UNROLLED_MESH;
-			info.ibo = index_buffer_allocator.get_buffer(0, 0);
+		// Estimates from the page layout, the real cost is reported once a level is resident.
+		for (uint32_t level = 0; level < pinned_level; level++)
+		{
+			if (Meshlet::build_payload_pages(views, num_views, residency_levels[level].data(),
+			                                 residency_levels[level].size(), false, pages))
+			{
+				level_costs[level] =
+						uint64_t(pages.num_pages) * Meshlet::PayloadPageWords * mesh_payload_allocator.get_element_size(0) +
+						pages.streams.size() * mesh_stream_allocator.get_element_size(0);
+			}
+		}
+	}
 
-			for (unsigned i = 0; i < 3; i++)
-				info.streams[i] = attribute_buffer_allocator.get_buffer(0, i);
+	if (!ret)
+		LOGE("Failed to instantiate meshlet ID %u.\n", id.id);
 
-			info.payload = payload.get();
+	std::lock_guard<std::mutex> holder{lock};
+	updates.push_back(id);
 
-			info.push.primitive_offset = asset.mesh.index_or_payload.offset;
-			info.push.vertex_offset = asset.mesh.attr_or_stream.offset;
+	if (ret)
+	{
+		asset.mesh.levels = std::move(levels);
+		asset.mesh.indirect_or_header = header;
+		asset.mesh.draw = draw;
+		asset.resident_level = pinned_level;
+	}
 
-			info.runtime_style = mesh_encoding == MeshEncoding::MeshletDecoded ?
-			                     Meshlet::RuntimeStyle::Meshlet : Meshlet::RuntimeStyle::MDI;
+	if (ret && pinned_level != 0)
+	{
+		manager_.update_level_costs(id, num_residency_levels, pinned_level, level_costs);
+		manager_.update_cost(id, get_mesh_resident_cost(asset), pinned_level);
+	}
+	else
+		manager_.update_cost(id, ret ? get_mesh_resident_cost(asset) : 0);
 
-			if (mesh_encoding != MeshEncoding::Classic)
-			{
-				auto *bounds = static_cast<Meshlet::Bound *>(
-						cmd->update_buffer(*indirect_buffer_allocator.get_buffer(0, 1),
-						                   asset.mesh.indirect_or_header.offset * sizeof(Meshlet::Bound),
-						                   view.num_bounds_256 * sizeof(Meshlet::Bound)));
-				memcpy(bounds, view.bounds_256, view.num_bounds_256 * sizeof(Meshlet::Bound));
-
-				info.indirect = indirect_buffer_allocator.get_buffer(0, 0);
-				info.indirect_offset = asset.mesh.indirect_or_header.offset;
-			}
+	asset.latchable = true;
+	cond.notify_all();
+}
+
+void ResourceManager::instantiate_asset_mesh_level(Granite::AssetManager &manager_, Granite::AssetID id,
+                                                   Granite::File &file, unsigned level)
+{
+	auto &asset = assets[id.id];
+	uint32_t resident_level;
+	uint32_t num_resident_levels;
+	uint32_t level_stream_offset = 0;
+	uint32_t pinned_stream_offset = 0;
+
+	{
+		std::lock_guard<std::mutex> holder{lock};
+		resident_level = asset.resident_level;
+		num_resident_levels = uint32_t(asset.mesh.levels.size());
+		if (level < num_resident_levels)
+			level_stream_offset = asset.mesh.levels[level].streams.offset;
+		if (num_resident_levels)
+			pinned_stream_offset = asset.mesh.levels.back().streams.offset;
+	}
+
+	// Only the metadata and the pages of the streamed levels are touched in the mapping.
+	Granite::FileMappingHandle mapping;
+	if (file.get_size())
+		mapping = file.map();
+
+	Meshlet::MeshView views[Meshlet::MaxLodLevels];
+	std::vector<Meshlet::ResidencyChunk> residency_levels[Meshlet::MaxLodLevels];
+	uint32_t num_views = mapping ? create_mesh_views(*mapping, views) : 0;
+	uint32_t num_residency_levels = Meshlet::build_residency_levels(views, num_views, residency_levels);
+
+	bool ret = num_residency_levels != 0 && num_residency_levels == num_resident_levels &&
+	           level < num_residency_levels;
+
+	std::vector<MeshResidencyLevel> streamed;
+	Util::AllocatedSlice header;
+	DrawCall draw = {};
+
+	if (ret)
+	{
+		auto cmd = device->request_command_buffer(CommandBuffer::Type::AsyncTransfer);
+
+		// Streaming in uploads every level between the requested and the resident one.
+		// Trimming only needs new draw headers, the trimmed levels are freed once those are latched.
+		Meshlet::PayloadPages pages;
+		for (uint32_t i = level; i < resident_level && ret; i++)
+		{
+			streamed.emplace_back();
+			ret = Meshlet::build_payload_pages(views, num_views, residency_levels[i].data(),
+			                                   residency_levels[i].size(), true, pages) &&
+			      allocate_mesh_residency_level(*cmd, pages, streamed.back());
+		}
 
-			Meshlet::decode_mesh(*cmd, info, view);
+		if (ret && !streamed.empty())
+			level_stream_offset = streamed.front().streams.offset;
 
+		if (ret)
+		{
+			ret = allocate_mesh_draw(*cmd, views, residency_levels, num_residency_levels, level,
+			                         level_stream_offset, pinned_stream_offset, header, draw);
+		}
+
+		if (ret)
+		{
 			Semaphore sem;
 			device->submit(cmd, nullptr, 1, &sem);
 			device->add_wait_semaphore(CommandBuffer::Type::Generic, std::move(sem),
-			                           VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT |
-			                           VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, false);
+			                           VK_PIPELINE_STAGE_2_MESH_SHADER_BIT_EXT |
+			                           VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, false);
 		}
+		else
+			device->submit_discard(cmd);
 	}
 
-	uint64_t cost = 0;
+	std::lock_guard<std::mutex> holder{lock};
+
 	if (ret)
 	{
-		if (mesh_encoding == MeshEncoding::MeshletEncoded)
+		for (size_t i = 0; i < streamed.size(); i++)
 		{
-			cost += view.format_header->payload_size_words * mesh_payload_allocator.get_element_size(0);
-			cost += view.num_bounds_256 * mesh_header_allocator.get_element_size(0);
-			cost += view.num_bounds_256 * mesh_header_allocator.get_element_size(1);
-			cost += view.format_header->meshlet_count * view.format_header->stream_count * mesh_stream_allocator.get_element_size(0);
+			// A level which was trimmed, but not yet latched, may still be referenced by the current draw.
+			auto &slot = asset.mesh.levels[level + i];
+			if (slot.streams.count)
+				asset.mesh.retired_levels.push_back(std::move(slot));
+			slot = std::move(streamed[i]);
 		}
-		else
+
+		if (asset.mesh.pending_header.count)
 		{
-			cost += view.total_primitives * index_buffer_allocator.get_element_size(0);
-			cost += view.total_vertices * attribute_buffer_allocator.get_element_size(0);
-			cost += view.total_vertices * attribute_buffer_allocator.get_element_size(1);
-			cost += view.total_vertices * attribute_buffer_allocator.get_element_size(2);
-			if (mesh_encoding != MeshEncoding::Classic)
-			{
-				cost += view.format_header->meshlet_count * indirect_buffer_allocator.get_element_size(0);
-				cost += view.format_header->meshlet_count * indirect_buffer_allocator.get_element_size(1);
-			}
+			std::lock_guard<std::mutex> holder_alloc{mesh_allocator_lock};
+			mesh_header_allocator.free(asset.mesh.pending_header);
 		}
+
+		asset.mesh.pending_header = header;
+		asset.mesh.pending_draw = draw;
+		asset.resident_level = level;
+		updates.push_back(id);
+	}
+	else
+	{
+		LOGE("Failed to make level %u of meshlet ID %u resident.\n", level, id.id);
+		std::lock_guard<std::mutex> holder_alloc{mesh_allocator_lock};
+		for (auto &l : streamed)
+			free_mesh_residency_level(l);
+		mesh_header_allocator.free(header);
 	}
 
-	std::lock_guard<std::mutex> holder{lock};
-	updates.push_back(id);
-	manager_.update_cost(id, ret ? cost : 0);
-	asset.latchable = true;
-	cond.notify_all();
+	manager_.update_cost(id, get_mesh_resident_cost(asset), asset.resident_level);
 }
 
 void ResourceManager::instantiate_asset_image(Granite::AssetManager &manager_,
@@ -608,13 +1007,37 @@ void ResourceManager::instantiate_asset_image(Granite::AssetManager &manager_,
 	auto &asset = assets[id.id];
 
 	ImageHandle image;
+	unsigned pinned_level = 0;
 	if (file.get_size())
 	{
 		auto mapping = file.map();
 		if (mapping)
 		{
 			if (MemoryMappedTexture::is_header(mapping->data(), mapping->get_size()))
-				image = create_gtx(std::move(mapping), id);
+			{
+				MemoryMappedTexture mapped_file;
+				if (mapped_file.map_read(std::move(mapping), true))
+				{
+					// Only the mip tail is loaded up front, finer levels are streamed in by the asset manager.
+					pinned_level = get_pinned_level(mapped_file);
+					image = create_gtx(mapped_file, id, pinned_level);
+
+					if (image && pinned_level != 0)
+					{
+						auto &layout = mapped_file.get_layout();
+						uint64_t level_costs[Granite::AssetManager::MaxResidencyLevels];
+						for (uint32_t level = 0; level < layout.get_levels(); level++)
+						{
+							size_t end = level + 1 < layout.get_levels() ?
+							             layout.get_mip_info(level + 1).offset : layout.get_required_size();
+							level_costs[level] = end - layout.get_mip_info(level).offset;
+						}
+						manager_.update_level_costs(id, layout.get_levels(), pinned_level, level_costs);
+					}
+				}
+				else
+					LOGE("Failed to read texture.\n");
+			}
 			else
 				image = create_other(*mapping, asset.asset_class, id);
 		}
@@ -624,16 +1047,136 @@ void ResourceManager::instantiate_asset_image(Granite::AssetManager &manager_,
 
 	// Have to signal something.
 	if (!image)
+	{
 		image = get_fallback_image(asset.asset_class);
+		pinned_level = 0;
+	}
 
 	std::lock_guard<std::mutex> holder{lock};
 	updates.push_back(id);
 	asset.image = std::move(image);
+	asset.pending_image.reset();
+	asset.resident_level = pinned_level;
 	asset.latchable = true;
-	manager_.update_cost(id, asset.image ? asset.image->get_allocation().get_size() : 0);
+
+	uint64_t cost = asset.image ? asset.image->get_allocation().get_size() : 0;
+	if (pinned_level != 0)
+		manager_.update_cost(id, cost, pinned_level);
+	else
+		manager_.update_cost(id, cost);
 	cond.notify_all();
 }
 
+unsigned ResourceManager::get_pinned_level(const MemoryMappedTexture &mapped_file) const
+{
+	auto &layout = mapped_file.get_layout();
+	unsigned levels = layout.get_levels();
+
+	if ((mapped_file.get_flags() & MEMORY_MAPPED_TEXTURE_GENERATE_MIPMAP_ON_LOAD_BIT) != 0 ||
+	    levels <= 1 || levels > Granite::AssetManager::MaxResidencyLevels)
+	{
+		return 0;
+	}
+
+	// The mip tail is small enough that it is always loaded with the texture and is never trimmed.
+	constexpr uint32_t MipTailDimension = 128;
+	unsigned level = 0;
+	while (level + 1 < levels && std::max(layout.get_width(level), layout.get_height(level)) > MipTailDimension)
+		level++;
+	return level;
+}
+
+void ResourceManager::instantiate_asset_level(Granite::AssetManager &manager_, Granite::TaskGroup *task,
+                                              Granite::AssetID id, Granite::File &file, unsigned level)
+{
+	if (task)
+	{
+		task->enqueue_task([this, &manager_, &file, id, level]() {
+			if (assets[id.id].asset_class == Granite::AssetClass::Mesh)
+				instantiate_asset_mesh_level(manager_, id, file, level);
+			else
+				instantiate_asset_image_level(manager_, id, file, level);
+		});
+	}
+	else if (assets[id.id].asset_class == Granite::AssetClass::Mesh)
+	{
+		instantiate_asset_mesh_level(manager_, id, file, level);
+	}
+	else
+	{
+		instantiate_asset_image_level(manager_, id, file, level);
+	}
+}
+
+void ResourceManager::instantiate_asset_image_level(Granite::AssetManager &manager_, Granite::AssetID id,
+                                                    Granite::File &file, unsigned level)
+{
+	// A change in residency creates a new image which starts at the finest resident level.
+	// Since the view only contains resident levels, sampling is implicitly clamped to them.
+	// Trims copy the remaining levels out of the resident image on the GPU.
+	// Streaming in finer levels, or images which cannot be copied from, reupload from the file.
+	ImageHandle image;
+	{
+		ImageHandle resident;
+		uint32_t resident_level;
+		{
+			std::lock_guard<std::mutex> holder{lock};
+			auto &asset = assets[id.id];
+			resident = asset.pending_image ? asset.pending_image : asset.image;
+			resident_level = asset.resident_level;
+		}
+
+		if (resident && level > resident_level &&
+		    (resident->get_create_info().usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0 &&
+		    resident->get_create_info().initial_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		{
+			image = create_trimmed_image(*resident, id, level - resident_level);
+		}
+	}
+
+	if (!image)
+	{
+		if (auto mapping = file.map())
+		{
+			MemoryMappedTexture mapped_file;
+			if (mapped_file.map_read(std::move(mapping), true) && level < mapped_file.get_layout().get_levels())
+				image = create_gtx(mapped_file, id, level);
+		}
+	}
+
+	std::lock_guard<std::mutex> holder{lock};
+	auto &asset = assets[id.id];
+
+	if (image)
+	{
+		asset.pending_image = std::move(image);
+		asset.resident_level = level;
+		updates.push_back(id);
+	}
+	else
+		LOGE("Failed to make level %u of ID %u resident.\n", level, id.id);
+
+	// The latched image stays alive until the pending image replaces it, so charge for both until then.
+	// latch_handles() reports the cost of the new image alone.
+	uint64_t cost = 0;
+	if (asset.image)
+		cost += asset.image->get_allocation().get_size();
+	if (asset.pending_image)
+		cost += asset.pending_image->get_allocation().get_size();
+	manager_.update_cost(id, cost, asset.resident_level);
+}
+
+bool ResourceManager::is_image_resident(Granite::AssetID id) const
+{
+	auto *view = get_image_view(id);
+	if (!view)
+		return false;
+
+	auto *image = &view->get_image();
+	return image != fallback_color.get() && image != fallback_normal.get() &&
+	       image != fallback_zero.get() && image != fallback_pbr.get();
+}
+
 const ImageHandle &ResourceManager::get_fallback_image(Granite::AssetClass asset_class)
 {
 	switch (asset_class)
@@ -671,9 +1214,12 @@ void ResourceManager::latch_handles()
 					std::lock_guard<std::mutex> holder_alloc{mesh_allocator_lock};
 					if (mesh_encoding == MeshEncoding::MeshletEncoded)
 					{
-						mesh_payload_allocator.free(asset.mesh.index_or_payload);
-						mesh_stream_allocator.free(asset.mesh.attr_or_stream);
 						mesh_header_allocator.free(asset.mesh.indirect_or_header);
+						mesh_header_allocator.free(asset.mesh.pending_header);
+						for (auto &level : asset.mesh.levels)
+							free_mesh_residency_level(level);
+						for (auto &level : asset.mesh.retired_levels)
+							free_mesh_residency_level(level);
 					}
 					else
 					{
@@ -683,6 +1229,22 @@ void ResourceManager::latch_handles()
 					}
 				}
 				asset.mesh = {};
+				asset.resident_level = 0;
+			}
+			else if (asset.mesh.pending_header.count)
+			{
+				std::lock_guard<std::mutex> holder_alloc{mesh_allocator_lock};
+				mesh_header_allocator.free(asset.mesh.indirect_or_header);
+				asset.mesh.indirect_or_header = asset.mesh.pending_header;
+				asset.mesh.pending_header = {};
+				asset.mesh.draw = asset.mesh.pending_draw;
+
+				// Levels finer than the resident level were trimmed, and the new draw no longer references them.
+				for (uint32_t i = 0; i < asset.resident_level && i < asset.mesh.levels.size(); i++)
+					free_mesh_residency_level(asset.mesh.levels[i]);
+				for (auto &level : asset.mesh.retired_levels)
+					free_mesh_residency_level(level);
+				asset.mesh.retired_levels.clear();
 			}
 
 			draws[update.id] = asset.mesh.draw;
@@ -691,7 +1253,16 @@ void ResourceManager::latch_handles()
 		{
 			const ImageView *view;
 			if (!asset.latchable)
+			{
 				asset.image.reset();
+				asset.pending_image.reset();
+			}
+			else if (asset.pending_image)
+			{
+				asset.image = std::move(asset.pending_image);
+				if (manager)
+					manager->update_cost(update, asset.image->get_allocation().get_size());
+			}
 
 			if (asset.image)
 			{
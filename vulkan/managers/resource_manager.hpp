@@ -34,6 +34,7 @@
 namespace Vulkan
 {
 class MemoryMappedTexture;
+class CommandBuffer;
 
 namespace Internal
 {
@@ -100,6 +101,9 @@ public:
 
 	const Vulkan::ImageView *get_image_view_blocking(Granite::AssetID id);
 
+	// True when the latched view is backed by the asset itself rather than a fallback image.
+	bool is_image_resident(Granite::AssetID id) const;
+
 	struct DrawRange
 	{
 		uint32_t offset;
@@ -146,17 +150,36 @@ private:
 	uint64_t estimate_cost_asset(Granite::AssetID id, Granite::File &file) override;
 	void instantiate_asset(Granite::AssetManager &manager, Granite::TaskGroup *task,
 	                       Granite::AssetID id, Granite::File &file) override;
+	void instantiate_asset_level(Granite::AssetManager &manager, Granite::TaskGroup *task,
+	                             Granite::AssetID id, Granite::File &file, unsigned level) override;
 	void release_asset(Granite::AssetID id) override;
 	void set_id_bounds(uint32_t bound) override;
 	void set_asset_class(Granite::AssetID id, Granite::AssetClass asset_class) override;
 
+	// Stream headers and payload pages of the chunks in one residency level of an encoded meshlet mesh.
+	struct MeshResidencyLevel
+	{
+		Util::AllocatedSlice streams;
+		std::vector<Util::AllocatedSlice> pages;
+		uint64_t cost = 0;
+	};
+
 	struct Asset
 	{
 		ImageHandle image;
+		// Replaces image on the next latch when a different set of mip levels becomes resident.
+		ImageHandle pending_image;
+		uint32_t resident_level = 0;
 		struct
 		{
 			Util::AllocatedSlice index_or_payload, attr_or_stream, indirect_or_header;
 			DrawCall draw;
+			// Encoded meshlets are resident per level. Draw headers are rebuilt for every residency change,
+			// and replace indirect_or_header on the next latch, at which point trimmed levels are freed.
+			std::vector<MeshResidencyLevel> levels;
+			std::vector<MeshResidencyLevel> retired_levels;
+			Util::AllocatedSlice pending_header;
+			DrawCall pending_draw;
 		} mesh;
 		Granite::AssetClass asset_class = Granite::AssetClass::ImageZeroable;
 		bool latchable = false;
@@ -175,14 +198,21 @@ private:
 	ImageHandle fallback_zero;
 	ImageHandle fallback_pbr;
 
-	ImageHandle create_gtx(Granite::FileMappingHandle mapping, Granite::AssetID id);
-	ImageHandle create_gtx(const MemoryMappedTexture &mapping, Granite::AssetID id);
+	ImageHandle create_gtx(const MemoryMappedTexture &mapping, Granite::AssetID id, uint32_t first_level = 0);
+	ImageHandle create_trimmed_image(const Image &image, Granite::AssetID id, uint32_t first_level);
 	ImageHandle create_other(const Granite::FileMapping &mapping, Granite::AssetClass asset_class, Granite::AssetID id);
 	const ImageHandle &get_fallback_image(Granite::AssetClass asset_class);
 
 	void instantiate_asset(Granite::AssetManager &manager, Granite::AssetID id, Granite::File &file);
 	void instantiate_asset_image(Granite::AssetManager &manager, Granite::AssetID id, Granite::File &file);
+	void instantiate_asset_image_level(Granite::AssetManager &manager, Granite::AssetID id, Granite::File &file,
+	                                   unsigned level);
+	unsigned get_pinned_level(const MemoryMappedTexture &mapping) const;
 	void instantiate_asset_mesh(Granite::AssetManager &manager, Granite::AssetID id, Granite::File &file);
+	void instantiate_asset_mesh_paged(Granite::AssetManager &manager, Granite::AssetID id,
+	                                  const Granite::FileMapping *mapping);
+	void instantiate_asset_mesh_level(Granite::AssetManager &manager, Granite::AssetID id, Granite::File &file,
+	                                  unsigned level);
 
 	std::mutex mesh_allocator_lock;
 	MeshBufferAllocator index_buffer_allocator;
@@ -195,5 +225,13 @@ private:
 	MeshEncoding mesh_encoding = MeshEncoding::Classic;
 
 	bool allocate_asset_mesh(Granite::AssetID id, const Meshlet::MeshView &view);
+	bool allocate_mesh_residency_level(CommandBuffer &cmd, Meshlet::PayloadPages &pages, MeshResidencyLevel &level);
+	bool allocate_mesh_draw(CommandBuffer &cmd, const Meshlet::MeshView *views,
+	                        const std::vector<Meshlet::ResidencyChunk> *residency_levels,
+	                        uint32_t num_residency_levels, uint32_t level,
+	                        uint32_t level_stream_offset, uint32_t pinned_stream_offset,
+	                        Util::AllocatedSlice &header, DrawCall &draw);
+	void free_mesh_residency_level(MeshResidencyLevel &level);
+	uint64_t get_mesh_resident_cost(const Asset &asset) const;
 };
 }
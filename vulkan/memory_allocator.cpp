@@ -241,6 +241,18 @@ DeviceAllocation DeviceAllocation::make_imported_allocation(VkDeviceMemory memor
 	return alloc;
 }
 
+DeviceAllocation DeviceAllocation::make_sub_allocation(uint32_t sub_offset, uint32_t sub_size) const
+{
+	VK_ASSERT(sub_offset + sub_size <= size);
+	DeviceAllocation alloc = {};
+	alloc.base = base;
+	alloc.host_base = host_base ? host_base + sub_offset : nullptr;
+	alloc.offset = offset + sub_offset;
+	alloc.size = sub_size;
+	alloc.memory_type = memory_type;
+	return alloc;
+}
+
 bool Allocator::allocate(uint32_t size, uint32_t alignment, AllocationMode mode, DeviceAllocation *alloc)
 {
 	for (auto &c : classes)
@@ -121,6 +121,10 @@ public:
 
 	static DeviceAllocation make_imported_allocation(VkDeviceMemory memory, VkDeviceSize size, uint32_t memory_type);
 
+	// Non-owning view of a sub-range of this allocation.
+	// Used with ImageCreateInfo::memory_aliases to place resources at explicit offsets.
+	DeviceAllocation make_sub_allocation(uint32_t sub_offset, uint32_t sub_size) const;
+
 	ExternalHandle export_handle(Device &device);
 
 private:
@@ -25,12 +25,54 @@
 #include "buffer.hpp"
 #include "device.hpp"
 #include "filesystem.hpp"
+#include <limits>
+#include <cmath>
+#include <algorithm>
 
 namespace Vulkan
 {
 namespace Meshlet
 {
-MeshView create_mesh_view(const Granite::FileMapping &mapping)
+static bool parse_mesh_block(MeshView &view, const unsigned char *&ptr, const unsigned char *end_ptr)
+{
+	if (end_ptr - ptr < ptrdiff_t(sizeof(FormatHeader)))
+		return false;
+	view.format_header = reinterpret_cast<const FormatHeader *>(ptr);
+	ptr += sizeof(*view.format_header);
+
+	if (end_ptr - ptr < ptrdiff_t(view.format_header->meshlet_count * sizeof(Bound)))
+		return false;
+	view.bounds = reinterpret_cast<const Bound *>(ptr);
+	ptr += view.format_header->meshlet_count * sizeof(Bound);
+
+	size_t num_bounds_256 = (view.format_header->meshlet_count + ChunkFactor - 1) / ChunkFactor;
+
+	if (end_ptr - ptr < ptrdiff_t(num_bounds_256 * sizeof(Bound)))
+		return false;
+	view.bounds_256 = reinterpret_cast<const Bound *>(ptr);
+	ptr += num_bounds_256 * sizeof(Bound);
+
+	view.num_bounds = view.format_header->meshlet_count;
+	view.num_bounds_256 = num_bounds_256;
+
+	if (end_ptr - ptr < ptrdiff_t(view.format_header->meshlet_count * view.format_header->stream_count * sizeof(Stream)))
+		return false;
+	view.streams = reinterpret_cast<const Stream *>(ptr);
+	ptr += view.format_header->meshlet_count * view.format_header->stream_count * sizeof(Stream);
+
+	return true;
+}
+
+static bool parse_lod_bounds(MeshView &view, const unsigned char *&ptr, const unsigned char *end_ptr)
+{
+	if (end_ptr - ptr < ptrdiff_t(view.format_header->meshlet_count * sizeof(LodBound)))
+		return false;
+	view.lod_bounds = reinterpret_cast<const LodBound *>(ptr);
+	ptr += view.format_header->meshlet_count * sizeof(LodBound);
+	return true;
+}
+
+MeshView create_mesh_view(const Granite::FileMapping &mapping, uint32_t lod_level)
 {
 	MeshView view = {};
 
@@ -51,35 +93,56 @@ MeshView create_mesh_view(const Granite::FileMapping &mapping)
 
 	ptr += sizeof(magic);
 
-	view.format_header = reinterpret_cast<const FormatHeader *>(ptr);
-	ptr += sizeof(*view.format_header);
-
-	if (end_ptr - ptr < ptrdiff_t(view.format_header->meshlet_count * sizeof(Bound)))
+	if (!parse_mesh_block(view, ptr, end_ptr))
 		return {};
-	view.bounds = reinterpret_cast<const Bound *>(ptr);
-	ptr += view.format_header->meshlet_count * sizeof(Bound);
 
-	size_t num_bounds_256 = (view.format_header->meshlet_count + ChunkFactor - 1) / ChunkFactor;
+	if (!view.format_header->payload_size_words)
+		return {};
 
-	if (end_ptr - ptr < ptrdiff_t(num_bounds_256 * sizeof(Bound)))
+	if (end_ptr - ptr < ptrdiff_t(view.format_header->payload_size_words * sizeof(PayloadWord)))
 		return {};
-	view.bounds_256 = reinterpret_cast<const Bound *>(ptr);
-	ptr += num_bounds_256 * sizeof(Bound);
+	view.payload = reinterpret_cast<const PayloadWord *>(ptr);
+	ptr += view.format_header->payload_size_words * sizeof(PayloadWord);
+	view.num_lod_levels = 1;
 
-	view.num_bounds = view.format_header->meshlet_count;
-	view.num_bounds_256 = num_bounds_256;
+	// Skip the padding word and look for the optional LOD section.
+	if (end_ptr - ptr >= ptrdiff_t(sizeof(PayloadWord) + sizeof(lod_magic) + sizeof(LodFormatHeader)) &&
+	    memcmp(ptr + sizeof(PayloadWord), lod_magic, sizeof(lod_magic)) == 0)
+	{
+		ptr += sizeof(PayloadWord) + sizeof(lod_magic);
+		auto *lod_header = reinterpret_cast<const LodFormatHeader *>(ptr);
+		ptr += sizeof(*lod_header);
 
-	if (end_ptr - ptr < ptrdiff_t(view.format_header->meshlet_count * view.format_header->stream_count * sizeof(Stream)))
-		return {};
-	view.streams = reinterpret_cast<const Stream *>(ptr);
-	ptr += view.format_header->meshlet_count * view.format_header->stream_count * sizeof(Stream);
+		if (lod_header->level_count == 0 || lod_header->level_count > MaxLodLevels ||
+		    !parse_lod_bounds(view, ptr, end_ptr))
+		{
+			LOGE("Invalid LOD section.\n");
+			return {};
+		}
 
-	if (!view.format_header->payload_size_words)
-		return {};
+		view.num_lod_levels = lod_header->level_count;
+		auto *payload = view.payload;
 
-	if (end_ptr - ptr < ptrdiff_t(view.format_header->payload_size_words * sizeof(PayloadWord)))
+		for (uint32_t level = 1; level <= lod_level && level < view.num_lod_levels; level++)
+		{
+			view = {};
+			if (!parse_mesh_block(view, ptr, end_ptr) || !parse_lod_bounds(view, ptr, end_ptr))
+			{
+				LOGE("Invalid LOD level %u.\n", level);
+				return {};
+			}
+
+			view.payload = payload;
+			view.lod_level = level;
+			view.num_lod_levels = lod_header->level_count;
+		}
+	}
+
+	if (lod_level >= view.num_lod_levels)
+	{
+		LOGE("LOD level %u out of range, mesh has %u levels.\n", lod_level, view.num_lod_levels);
 		return {};
-	view.payload = reinterpret_cast<const PayloadWord *>(ptr);
+	}
 
 	for (uint32_t i = 0, n = view.format_header->meshlet_count; i < n; i++)
 	{
@@ -91,6 +154,209 @@ MeshView create_mesh_view(const Granite::FileMapping &mapping)
 	return view;
 }
 
+static float compute_lod_projected_error(const float *center, float radius, float error, const LodCutInfo &info)
+{
+	if (error == 0.0f)
+		return 0.0f;
+	if (error == std::numeric_limits<float>::max())
+		return std::numeric_limits<float>::infinity();
+
+	float dx = center[0] - info.camera_position[0];
+	float dy = center[1] - info.camera_position[1];
+	float dz = center[2] - info.camera_position[2];
+	float dist = std::sqrt(dx * dx + dy * dy + dz * dz) - radius;
+
+	// Inside the bounding sphere, any error is too large.
+	if (dist <= 0.0f)
+		return std::numeric_limits<float>::infinity();
+
+	return error * info.error_scale / dist;
+}
+
+void select_lod_cut(const MeshView *levels, uint32_t num_levels, const LodCutInfo &info,
+                    std::vector<LodSelection> &selection)
+{
+	selection.clear();
+
+	for (uint32_t level = 0; level < num_levels; level++)
+	{
+		auto &view = levels[level];
+
+		// Without LOD information, the full detail mesh is the only option.
+		if (!view.lod_bounds)
+		{
+			if (level == 0)
+				for (uint32_t i = 0; i < view.num_bounds; i++)
+					selection.push_back({ 0, i });
+			continue;
+		}
+
+		for (uint32_t i = 0; i < view.num_bounds; i++)
+		{
+			auto &lod = view.lod_bounds[i];
+			float self_error = compute_lod_projected_error(lod.center, lod.radius, lod.error, info);
+			float parent_error = compute_lod_projected_error(lod.parent_center, lod.parent_radius, lod.parent_error, info);
+			if (self_error <= info.error_threshold && parent_error > info.error_threshold)
+				selection.push_back({ level, i });
+		}
+	}
+}
+
+static bool is_root_cluster(const LodBound &lod)
+{
+	return lod.parent_error == std::numeric_limits<float>::max();
+}
+
+uint32_t build_residency_levels(const MeshView *levels, uint32_t num_levels,
+                                std::vector<ResidencyChunk> *residency_levels)
+{
+	for (uint32_t i = 0; i < num_levels; i++)
+		residency_levels[i].clear();
+
+	if (!num_levels || !levels[0].format_header)
+		return 0;
+
+	bool streamable = num_levels > 1;
+	for (uint32_t level = 0; level < num_levels && streamable; level++)
+	{
+		auto &view = levels[level];
+		if (!view.format_header || !view.lod_bounds ||
+		    view.format_header->stream_count != levels[0].format_header->stream_count ||
+		    view.format_header->style != levels[0].format_header->style)
+		{
+			streamable = false;
+			break;
+		}
+
+		bool coarsest = level + 1 == num_levels;
+
+		for (uint32_t chunk = 0; chunk < view.num_bounds_256; chunk++)
+		{
+			uint32_t begin = chunk * ChunkFactor;
+			uint32_t end = std::min(begin + ChunkFactor, view.num_bounds);
+			uint32_t num_roots = 0;
+			for (uint32_t i = begin; i < end; i++)
+				if (is_root_cluster(view.lod_bounds[i]))
+					num_roots++;
+
+			if (coarsest || num_roots == end - begin)
+				residency_levels[num_levels - 1].push_back({ level, chunk });
+			else if (num_roots == 0)
+				residency_levels[level].push_back({ level, chunk });
+			else
+			{
+				// A chunk which straddles groups cannot be swapped as a unit.
+				streamable = false;
+				break;
+			}
+		}
+	}
+
+	if (streamable)
+		return num_levels;
+
+	for (uint32_t i = 0; i < num_levels; i++)
+		residency_levels[i].clear();
+	for (uint32_t chunk = 0; chunk < levels[0].num_bounds_256; chunk++)
+		residency_levels[0].push_back({ 0, chunk });
+	return 1;
+}
+
+static uint32_t get_meshlet_payload_start(const MeshView &view, uint32_t meshlet)
+{
+	uint32_t stream_count = view.format_header->stream_count;
+	uint32_t start = UINT32_MAX;
+	for (uint32_t i = 0; i < stream_count; i++)
+		start = std::min(start, view.streams[meshlet * stream_count + i].offset_in_words);
+	return start;
+}
+
+bool build_payload_pages(const MeshView *levels, uint32_t num_levels,
+                         const ResidencyChunk *chunks, size_t num_chunks,
+                         bool include_payload, PayloadPages &pages)
+{
+	pages.num_pages = 0;
+	pages.payload.clear();
+	pages.streams.clear();
+
+	if (!num_levels || !levels[0].format_header)
+		return false;
+
+	uint32_t stream_count = levels[0].format_header->stream_count;
+	uint32_t payload_words = levels[0].format_header->payload_size_words;
+
+	// Meshlets are encoded back to back, so a meshlet ends where the next one in the shared payload begins.
+	std::vector<uint32_t> starts;
+	for (uint32_t level = 0; level < num_levels; level++)
+		for (uint32_t i = 0; i < levels[level].num_bounds; i++)
+			starts.push_back(get_meshlet_payload_start(levels[level], i));
+	std::sort(starts.begin(), starts.end());
+	starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+	pages.streams.resize(num_chunks * ChunkFactor * stream_count);
+	uint32_t page_offset = PayloadPageWords;
+
+	for (size_t chunk = 0; chunk < num_chunks; chunk++)
+	{
+		if (chunks[chunk].lod_level >= num_levels)
+			return false;
+
+		auto &view = levels[chunks[chunk].lod_level];
+		if (chunks[chunk].chunk_index >= view.num_bounds_256 || view.format_header->stream_count != stream_count)
+			return false;
+
+		uint32_t begin = chunks[chunk].chunk_index * ChunkFactor;
+		uint32_t end = std::min(begin + ChunkFactor, view.num_bounds);
+
+		for (uint32_t meshlet = begin; meshlet < end; meshlet++)
+		{
+			uint32_t start = get_meshlet_payload_start(view, meshlet);
+			auto itr = std::upper_bound(starts.begin(), starts.end(), start);
+			uint32_t meshlet_end = itr != starts.end() ? *itr : payload_words;
+
+			if (start >= meshlet_end || meshlet_end > payload_words)
+			{
+				LOGE("Invalid payload range for meshlet %u in LOD %u.\n", meshlet, view.lod_level);
+				return false;
+			}
+
+			uint32_t size = meshlet_end - start;
+			if (size > PayloadPageWords - 1)
+			{
+				LOGE("Meshlet %u in LOD %u does not fit in a page.\n", meshlet, view.lod_level);
+				return false;
+			}
+
+			if (page_offset + size > PayloadPageWords - 1)
+			{
+				pages.num_pages++;
+				page_offset = 0;
+				if (include_payload)
+					pages.payload.resize(pages.num_pages * PayloadPageWords);
+			}
+
+			uint32_t base = (pages.num_pages - 1) * PayloadPageWords + page_offset;
+			if (include_payload)
+				memcpy(pages.payload.data() + base, view.payload + start, size * sizeof(PayloadWord));
+
+			auto *out_streams = pages.streams.data() +
+			                    (chunk * ChunkFactor + (meshlet - begin)) * stream_count;
+			for (uint32_t i = 0; i < stream_count; i++)
+			{
+				auto stream = view.streams[meshlet * stream_count + i];
+				if (stream.offset_in_words - start > size)
+					return false;
+				stream.offset_in_words = base + (stream.offset_in_words - start);
+				out_streams[i] = stream;
+			}
+
+			page_offset += size;
+		}
+	}
+
+	return true;
+}
+
 static void upload_indirect_buffer(CommandBuffer &cmd, const Vulkan::Buffer &indirect_buffer, uint32_t alloc_offset,
                                    const MeshView &view, RuntimeStyle runtime_style)
 {
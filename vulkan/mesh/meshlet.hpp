@@ -23,6 +23,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
+#include <vector>
 
 namespace Granite
 {
@@ -43,6 +45,7 @@ namespace Meshlet
 static constexpr unsigned MaxStreams = 8;
 static constexpr unsigned MaxElements = 32;
 static constexpr unsigned ChunkFactor = 256 / MaxElements;
+static constexpr unsigned MaxLodLevels = 16;
 
 struct Stream
 {
@@ -103,6 +106,30 @@ struct FormatHeader
 
 using PayloadWord = uint32_t;
 
+// Simplification error of a cluster and of the group it was simplified into.
+// Error is in object space. Level 0 clusters have zero error,
+// clusters which were never simplified further have FLT_MAX parent error.
+struct LodBound
+{
+	float center[3];
+	float radius;
+	float error;
+	float parent_center[3];
+	float parent_radius;
+	float parent_error;
+};
+static_assert(sizeof(LodBound) == 40, "Unexpected LodBound size.");
+
+// Optional section following the payload padding word.
+// LodBound[level 0 meshlet_count], then for every level > 0:
+// FormatHeader, Bound[meshlet_count], Bound[num_bounds_256], Stream[meshlet_count * stream_count], LodBound[meshlet_count].
+// Stream offsets of every level point into the shared payload.
+struct LodFormatHeader
+{
+	uint32_t level_count;
+	uint32_t reserved;
+};
+
 struct MeshView
 {
 	const FormatHeader *format_header;
@@ -110,15 +137,79 @@ struct MeshView
 	const Bound *bounds_256;
 	const Stream *streams;
 	const PayloadWord *payload;
+	const LodBound *lod_bounds;
 	uint32_t total_primitives;
 	uint32_t total_vertices;
 	uint32_t num_bounds;
 	uint32_t num_bounds_256;
+	uint32_t lod_level;
+	uint32_t num_lod_levels;
 };
 
 static const char magic[8] = { 'M', 'E', 'S', 'H', 'L', 'E', 'T', '4' };
+static const char lod_magic[4] = { 'L', 'O', 'D', '1' };
+
+// Level 0 is the full detail mesh. Files without an LOD section only have level 0.
+MeshView create_mesh_view(const Granite::FileMapping &mapping, uint32_t lod_level = 0);
+
+struct LodCutInfo
+{
+	float camera_position[3];
+	// Converts object space error at unit distance to pixels, e.g. 0.5 * viewport_height / tan(0.5 * fovy).
+	float error_scale;
+	// Maximum projected error in pixels.
+	float error_threshold;
+};
+
+struct LodSelection
+{
+	uint32_t lod_level;
+	uint32_t meshlet_index;
+};
+
+// Reference traversal of the cluster DAG. A cluster is part of the cut when its own error is acceptable,
+// but the error of its parent group is not. Camera position is in object space.
+// levels must contain views for all LOD levels, in order.
+void select_lod_cut(const MeshView *levels, uint32_t num_levels, const LodCutInfo &info,
+                    std::vector<LodSelection> &selection);
+
+// Chunks of ChunkFactor clusters are the unit of residency. They line up with simplification groups,
+// so a chunk either has a parent group in the next LOD level, or it is a root.
+struct ResidencyChunk
+{
+	uint32_t lod_level;
+	uint32_t chunk_index;
+};
+
+// Splits the cluster hierarchy into residency levels, with level 0 being the finest.
+// Roots are needed by any cut through the hierarchy, so every root chunk goes into the coarsest residency level
+// along with the coarsest LOD level. This is the coarse fallback which is always resident.
+// Every other residency level holds the remaining chunks of its LOD level.
+// Drawing residency level L means drawing its own chunks and the coarsest residency level's chunks of LOD level <= L.
+// Meshes which cannot be split this way get one residency level with the full detail mesh.
+// residency_levels must have room for num_levels entries. Returns the number of residency levels.
+uint32_t build_residency_levels(const MeshView *levels, uint32_t num_levels,
+                                std::vector<ResidencyChunk> *residency_levels);
+
+// Payload is streamed in fixed size pages which only hold whole meshlets.
+// Like the payload in the file, the last word of a page is padding.
+static constexpr uint32_t PayloadPageWords = 4096;
 
-MeshView create_mesh_view(const Granite::FileMapping &mapping);
+struct PayloadPages
+{
+	uint32_t num_pages;
+	// PayloadPageWords per page.
+	std::vector<PayloadWord> payload;
+	// ChunkFactor * stream_count streams per chunk, padded with empty streams.
+	// Offsets are relative to the first page, and must be remapped once pages are allocated.
+	std::vector<Stream> streams;
+};
+
+// Packs the meshlets of chunks into payload pages. All levels must come from the same mesh.
+// Without include_payload, only streams and the page count are computed, which does not touch the payload.
+bool build_payload_pages(const MeshView *levels, uint32_t num_levels,
+                         const ResidencyChunk *chunks, size_t num_chunks,
+                         bool include_payload, PayloadPages &pages);
 
 enum DecodeModeFlagBits : uint32_t
 {
@@ -148,5 +239,19 @@ struct DecodeInfo
 };
 
 bool decode_mesh(Vulkan::CommandBuffer &cmd, const DecodeInfo &decode_info, const MeshView &view);
+
+struct DecodedMesh
+{
+	std::vector<uint32_t> indices; // 3 per primitive.
+	std::vector<float> positions; // 3 per vertex.
+	std::vector<float> uvs; // 2 per vertex, textured styles only.
+	std::vector<float> normals; // 3 per vertex, textured styles only.
+	std::vector<float> tangents; // 4 per vertex, w is bitangent sign, textured styles only.
+};
+
+// Reference decoder which does not need a device.
+// Output matches decode_mesh() with DECODE_MODE_UNROLLED_MESH, vertices of each meshlet are laid out back to back.
+// The view is validated while decoding, returns false for malformed streams or out of bounds payload access.
+bool decode_mesh_cpu(const MeshView &view, DecodedMesh &mesh);
 }
 }
@@ -0,0 +1,391 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "meshlet.hpp"
+#include "logging.hpp"
+#include "simd_headers.hpp"
+#include <math.h>
+#include <string.h>
+
+namespace Vulkan
+{
+namespace Meshlet
+{
+// Mirrors meshlet_decodeN() in meshlet_payload_decode.h. All components of an element are extracted from
+// one 64-bit window, which the encoder guarantees is large enough.
+// Reading the second word of the window is why the payload has a padding word at the end.
+template <unsigned Components>
+static inline void decode_element(uint32_t *values, const PayloadWord *payload,
+                                  uint32_t index, uint32_t bit_count)
+{
+	// Constant streams may sit at the very end of the payload, don't read anything.
+	if (!bit_count)
+	{
+		for (unsigned c = 0; c < Components; c++)
+			values[c] = 0;
+		return;
+	}
+
+	uint32_t start_bit = index * bit_count * Components;
+	uint32_t start_word = start_bit / 32u;
+	start_bit &= 31u;
+	uint64_t word = uint64_t(payload[start_word]) | (uint64_t(payload[start_word + 1]) << 32);
+	uint32_t mask = (1u << bit_count) - 1u;
+
+	for (unsigned c = 0; c < Components; c++, start_bit += bit_count)
+		values[c] = uint32_t(word >> start_bit) & mask;
+}
+
+static inline uint32_t words_for_bits(uint32_t bits)
+{
+	return (bits + 31) / 32;
+}
+
+// out[i] = float(in[i]) * scale + bias. Scale is a power of two, so this is exact like ldexp() in the shader.
+static void dequantize(float *out, const int32_t *in, unsigned count, float scale, float bias)
+{
+	unsigned i = 0;
+#if defined(__SSE2__)
+	__m128 vscale = _mm_set1_ps(scale);
+	__m128 vbias = _mm_set1_ps(bias);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 v = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(v, vscale), vbias));
+	}
+#elif defined(__ARM_NEON)
+	float32x4_t vbias = vdupq_n_f32(bias);
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t v = vcvtq_f32_s32(vld1q_s32(in + i));
+		vst1q_f32(out + i, vaddq_f32(vmulq_n_f32(v, scale), vbias));
+	}
+#endif
+	for (; i < count; i++)
+		out[i] = float(in[i]) * scale + bias;
+}
+
+// Matches attribute_decode_oct_normal() in meshlet_attribute_decode.h.
+// Inputs are octahedral coordinates in [-1, 1], outputs are written with the given stride.
+static void decode_oct(float *out, unsigned stride, const float *x, const float *y, unsigned count)
+{
+	unsigned i = 0;
+#if defined(__SSE2__)
+	const __m128 sign_mask = _mm_set1_ps(-0.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 nx = _mm_loadu_ps(x + i);
+		__m128 ny = _mm_loadu_ps(y + i);
+		__m128 nz = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(sign_mask, nx)), _mm_andnot_ps(sign_mask, ny));
+		__m128 t = _mm_max_ps(_mm_xor_ps(nz, sign_mask), _mm_setzero_ps());
+
+		// n >= 0 ? n - t : n + t. Inputs are never -0.0.
+		nx = _mm_sub_ps(nx, _mm_or_ps(t, _mm_and_ps(nx, sign_mask)));
+		ny = _mm_sub_ps(ny, _mm_or_ps(t, _mm_and_ps(ny, sign_mask)));
+
+		__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+		__m128 inv_len = _mm_div_ps(one, _mm_sqrt_ps(len2));
+		nx = _mm_mul_ps(nx, inv_len);
+		ny = _mm_mul_ps(ny, inv_len);
+		nz = _mm_mul_ps(nz, inv_len);
+
+		alignas(16) float tmp[3][4];
+		_mm_store_ps(tmp[0], nx);
+		_mm_store_ps(tmp[1], ny);
+		_mm_store_ps(tmp[2], nz);
+		for (unsigned j = 0; j < 4; j++)
+		{
+			out[(i + j) * stride + 0] = tmp[0][j];
+			out[(i + j) * stride + 1] = tmp[1][j];
+			out[(i + j) * stride + 2] = tmp[2][j];
+		}
+	}
+#elif defined(__ARM_NEON)
+	const float32x4_t one = vdupq_n_f32(1.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t nx = vld1q_f32(x + i);
+		float32x4_t ny = vld1q_f32(y + i);
+		float32x4_t nz = vsubq_f32(vsubq_f32(one, vabsq_f32(nx)), vabsq_f32(ny));
+		float32x4_t t = vmaxq_f32(vnegq_f32(nz), vdupq_n_f32(0.0f));
+
+		nx = vbslq_f32(vcgeq_f32(nx, vdupq_n_f32(0.0f)), vsubq_f32(nx, t), vaddq_f32(nx, t));
+		ny = vbslq_f32(vcgeq_f32(ny, vdupq_n_f32(0.0f)), vsubq_f32(ny, t), vaddq_f32(ny, t));
+
+		float32x4_t len2 = vaddq_f32(vaddq_f32(vmulq_f32(nx, nx), vmulq_f32(ny, ny)), vmulq_f32(nz, nz));
+		float32x4x3_t n;
+#if defined(__aarch64__)
+		float32x4_t inv_len = vdivq_f32(one, vsqrtq_f32(len2));
+#else
+		float32x4_t inv_len = vrsqrteq_f32(len2);
+		inv_len = vmulq_f32(inv_len, vrsqrtsq_f32(vmulq_f32(len2, inv_len), inv_len));
+		inv_len = vmulq_f32(inv_len, vrsqrtsq_f32(vmulq_f32(len2, inv_len), inv_len));
+#endif
+		n.val[0] = vmulq_f32(nx, inv_len);
+		n.val[1] = vmulq_f32(ny, inv_len);
+		n.val[2] = vmulq_f32(nz, inv_len);
+
+		if (stride == 3)
+		{
+			vst3q_f32(out + i * 3, n);
+		}
+		else
+		{
+			float tmp[3][4];
+			vst1q_f32(tmp[0], n.val[0]);
+			vst1q_f32(tmp[1], n.val[1]);
+			vst1q_f32(tmp[2], n.val[2]);
+			for (unsigned j = 0; j < 4; j++)
+			{
+				out[(i + j) * stride + 0] = tmp[0][j];
+				out[(i + j) * stride + 1] = tmp[1][j];
+				out[(i + j) * stride + 2] = tmp[2][j];
+			}
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float nx = x[i];
+		float ny = y[i];
+		float nz = 1.0f - fabsf(nx) - fabsf(ny);
+		float t = nz < 0.0f ? -nz : 0.0f;
+		nx += nx >= 0.0f ? -t : t;
+		ny += ny >= 0.0f ? -t : t;
+		float inv_len = 1.0f / sqrtf(nx * nx + ny * ny + nz * nz);
+		out[i * stride + 0] = nx * inv_len;
+		out[i * stride + 1] = ny * inv_len;
+		out[i * stride + 2] = nz * inv_len;
+	}
+}
+
+static bool check_stream_bounds(const MeshView &view, const Stream &stream, uint32_t bits_per_element,
+                                uint32_t count, uint32_t meshlet_index, StreamType type)
+{
+	// One extra word may be read by decode_element(), which is covered by the padding word.
+	uint64_t end_word = uint64_t(stream.offset_in_words) + words_for_bits(bits_per_element * count);
+	if (end_word > view.format_header->payload_size_words)
+	{
+		LOGE("Meshlet %u, stream %u: payload access out of bounds (%llu > %u words).\n",
+		     meshlet_index, unsigned(type), static_cast<unsigned long long>(end_word),
+		     view.format_header->payload_size_words);
+		return false;
+	}
+
+	return true;
+}
+
+static bool decode_indices(const MeshView &view, const Stream &stream, uint32_t meshlet_index,
+                           uint32_t *out_indices, uint32_t base_vertex)
+{
+	auto &counts = stream.u.counts;
+	if (!check_stream_bounds(view, stream, 15, counts.prim_count, meshlet_index, StreamType::Primitive))
+		return false;
+
+	const auto *payload = view.payload + stream.offset_in_words;
+	for (uint32_t i = 0; i < counts.prim_count; i++)
+	{
+		uint32_t indices[3];
+		decode_element<3>(indices, payload, i, 5);
+		for (unsigned c = 0; c < 3; c++)
+		{
+			if (indices[c] >= counts.vert_count)
+			{
+				LOGE("Meshlet %u: index %u out of range, meshlet has %u vertices.\n",
+				     meshlet_index, indices[c], counts.vert_count);
+				return false;
+			}
+			out_indices[3 * i + c] = indices[c] + base_vertex;
+		}
+	}
+
+	return true;
+}
+
+template <unsigned Components>
+static bool decode_snorm_exp(const MeshView &view, const Stream &stream, uint32_t meshlet_index, StreamType type,
+                             uint32_t count, float *out, float scale_factor, float bias)
+{
+	uint32_t bits = stream.bits & 0xff;
+	int exponent = int(stream.bits) >> 16;
+
+	// The GPU extracts a whole element from a 64-bit window.
+	if (bits > 16 || (Components == 3 && bits > 12 && bits < 16))
+	{
+		LOGE("Meshlet %u, stream %u: unsupported bit count %u.\n", meshlet_index, unsigned(type), bits);
+		return false;
+	}
+
+	if (!check_stream_bounds(view, stream, bits * Components, count, meshlet_index, type))
+		return false;
+
+	uint32_t base[Components];
+	for (unsigned c = 0; c < Components; c++)
+		base[c] = (stream.u.base_value[c / 2] >> (16 * (c & 1))) & 0xffffu;
+
+	const auto *payload = view.payload + stream.offset_in_words;
+	int32_t values[MaxElements * Components];
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t v[Components];
+		decode_element<Components>(v, payload, i, bits);
+		for (unsigned c = 0; c < Components; c++)
+			values[i * Components + c] = int16_t(uint16_t(v[c] + base[c]));
+	}
+
+	dequantize(out, values, count * Components, ldexpf(scale_factor, exponent), bias);
+	return true;
+}
+
+static bool decode_normal_tangent(const MeshView &view, const Stream &stream, uint32_t meshlet_index,
+                                  uint32_t count, float *out_normals, float *out_tangents)
+{
+	uint32_t bits = stream.bits & 0xff;
+	uint32_t aux = stream.bits >> 16;
+
+	if (bits > 8 || aux < 1 || aux > 3)
+	{
+		LOGE("Meshlet %u: invalid normal/tangent stream (bits %u, aux %u).\n", meshlet_index, bits, aux);
+		return false;
+	}
+
+	if (!check_stream_bounds(view, stream, bits * 4, count, meshlet_index, StreamType::NormalTangentOct8))
+		return false;
+
+	const auto *payload = view.payload + stream.offset_in_words;
+	uint32_t base = stream.u.base_value[0];
+
+	float n[2][MaxElements];
+	float t[2][MaxElements];
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t v[4];
+		decode_element<4>(v, payload, i, bits);
+		for (unsigned c = 0; c < 4; c++)
+			v[c] = (v[c] + (base >> (8 * c))) & 0xffu;
+
+		bool t_sign;
+		if (aux == 3)
+		{
+			t_sign = (v[3] & 1) != 0;
+			v[3] &= ~1u;
+		}
+		else
+			t_sign = aux == 2;
+
+		n[0][i] = float(int8_t(v[0])) * (1.0f / 127.0f);
+		n[1][i] = float(int8_t(v[1])) * (1.0f / 127.0f);
+		t[0][i] = float(int8_t(v[2])) * (1.0f / 127.0f);
+		t[1][i] = float(int8_t(v[3])) * (1.0f / 127.0f);
+		out_tangents[4 * i + 3] = t_sign ? -1.0f : 1.0f;
+	}
+
+	decode_oct(out_normals, 3, n[0], n[1], count);
+	decode_oct(out_tangents, 4, t[0], t[1], count);
+	return true;
+}
+
+bool decode_mesh_cpu(const MeshView &view, DecodedMesh &mesh)
+{
+	mesh = {};
+
+	if (!view.format_header || !view.streams || !view.payload)
+	{
+		LOGE("Invalid mesh view.\n");
+		return false;
+	}
+
+	auto &header = *view.format_header;
+	bool textured = header.style == MeshStyle::Textured || header.style == MeshStyle::Skinned;
+	uint32_t required_streams = textured ? 4 : 2;
+
+	if (header.stream_count < required_streams || header.stream_count > MaxStreams)
+	{
+		LOGE("Invalid stream count %u for mesh style %u.\n", header.stream_count, unsigned(header.style));
+		return false;
+	}
+
+	uint64_t total_primitives = 0;
+	uint64_t total_vertices = 0;
+	for (uint32_t i = 0; i < header.meshlet_count; i++)
+	{
+		auto &counts = view.streams[i * header.stream_count].u.counts;
+		if (counts.prim_count > MaxElements || counts.vert_count > MaxElements)
+		{
+			LOGE("Meshlet %u: too many elements (%u primitives, %u vertices).\n",
+			     i, counts.prim_count, counts.vert_count);
+			return false;
+		}
+
+		total_primitives += counts.prim_count;
+		total_vertices += counts.vert_count;
+	}
+
+	mesh.indices.resize(total_primitives * 3);
+	mesh.positions.resize(total_vertices * 3);
+	if (textured)
+	{
+		mesh.uvs.resize(total_vertices * 2);
+		mesh.normals.resize(total_vertices * 3);
+		mesh.tangents.resize(total_vertices * 4);
+	}
+
+	uint32_t base_primitive = 0;
+	uint32_t base_vertex = 0;
+
+	for (uint32_t i = 0; i < header.meshlet_count; i++)
+	{
+		auto *streams = view.streams + i * header.stream_count;
+		auto &counts = streams[int(StreamType::Primitive)].u.counts;
+		uint32_t vert_count = counts.vert_count;
+
+		if (!decode_indices(view, streams[int(StreamType::Primitive)], i,
+		                    mesh.indices.data() + 3 * base_primitive, base_vertex))
+			return false;
+
+		if (!decode_snorm_exp<3>(view, streams[int(StreamType::Position)], i, StreamType::Position,
+		                         vert_count, mesh.positions.data() + 3 * base_vertex, 1.0f, 0.0f))
+			return false;
+
+		if (textured)
+		{
+			if (!decode_snorm_exp<2>(view, streams[int(StreamType::UV)], i, StreamType::UV,
+			                         vert_count, mesh.uvs.data() + 2 * base_vertex, 0.5f, 0.5f))
+				return false;
+
+			if (!decode_normal_tangent(view, streams[int(StreamType::NormalTangentOct8)], i, vert_count,
+			                           mesh.normals.data() + 3 * base_vertex,
+			                           mesh.tangents.data() + 4 * base_vertex))
+				return false;
+		}
+
+		base_primitive += counts.prim_count;
+		base_vertex += vert_count;
+	}
+
+	return true;
+}
+}
+}
@@ -0,0 +1,109 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "pipeline_usage.hpp"
+#include <string.h>
+#include <unordered_set>
+
+namespace Vulkan
+{
+namespace PipelineUsageHistory
+{
+static constexpr uint32_t Magic = 0x45535546; // 'FUSE'
+static constexpr uint32_t Version = 1;
+// Hash (2 words), first use frame, first use order, sessions.
+static constexpr uint32_t EntryWords = 5;
+static constexpr uint32_t HeaderWords = 3;
+
+bool parse(const void *data, size_t size, PipelineUsageMap &usage)
+{
+	size_t num_words = size / sizeof(uint32_t);
+	if (num_words < HeaderWords)
+		return false;
+
+	std::vector<uint32_t> words(num_words);
+	memcpy(words.data(), data, num_words * sizeof(uint32_t));
+
+	if (words[0] != Magic || words[1] != Version || num_words < HeaderWords + size_t(words[2]) * EntryWords)
+		return false;
+
+	uint32_t count = words[2];
+	usage.reserve(usage.size() + count);
+	const uint32_t *entry = words.data() + HeaderWords;
+
+	for (uint32_t i = 0; i < count; i++, entry += EntryWords)
+	{
+		PipelineUsage use = {};
+		use.hash = uint64_t(entry[0]) | (uint64_t(entry[1]) << 32);
+		use.first_use_frame = entry[2];
+		use.first_use_order = entry[3];
+		use.sessions = entry[4];
+		usage[use.hash] = use;
+	}
+
+	return true;
+}
+
+std::vector<uint32_t> serialize(const std::vector<PipelineUsage> &first_uses, const PipelineUsageMap &usage)
+{
+	std::vector<uint32_t> words;
+	words.reserve(HeaderWords + (first_uses.size() + usage.size()) * EntryWords);
+	words.push_back(Magic);
+	words.push_back(Version);
+	words.push_back(0);
+
+	const auto push_use = [&](const PipelineUsage &use) {
+		words.push_back(uint32_t(use.hash));
+		words.push_back(uint32_t(use.hash >> 32));
+		words.push_back(use.first_use_frame);
+		words.push_back(use.first_use_order);
+		words.push_back(use.sessions);
+		words[2]++;
+	};
+
+	std::unordered_set<uint64_t> used;
+	used.reserve(first_uses.size());
+
+	for (auto use : first_uses)
+	{
+		used.insert(use.hash);
+		auto itr = usage.find(use.hash);
+		if (itr != usage.end())
+			use.sessions = std::min<uint32_t>(itr->second.sessions + 1, MaxSessions);
+		push_use(use);
+	}
+
+	for (auto &itr : usage)
+	{
+		auto use = itr.second;
+		if (use.sessions > 1 && !used.count(use.hash))
+		{
+			use.sessions--;
+			push_use(use);
+		}
+	}
+
+	return words;
+}
+}
+}
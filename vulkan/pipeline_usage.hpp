@@ -0,0 +1,90 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "bitops.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace Vulkan
+{
+// Persisted in cache://fossilize/usage alongside the database, used to prioritize replay.
+struct PipelineUsage
+{
+	uint64_t hash;
+	// Frame and order in which the pipeline was first used in the last session which used it.
+	uint32_t first_use_frame;
+	uint32_t first_use_order;
+	// Incremented for every session which uses the pipeline, decremented for sessions which do not.
+	// Pipelines which fall to zero are forgotten.
+	uint32_t sessions;
+};
+
+using PipelineUsageMap = std::unordered_map<uint64_t, PipelineUsage>;
+
+namespace PipelineUsageHistory
+{
+enum { MaxSessions = 16 };
+
+// Returns false if the blob is not a valid usage history, in which case usage is left untouched.
+bool parse(const void *data, size_t size, PipelineUsageMap &usage);
+
+// Merges the first uses of this session into the history of earlier sessions, and ages out the rest.
+std::vector<uint32_t> serialize(const std::vector<PipelineUsage> &first_uses, const PipelineUsageMap &usage);
+
+// Pipelines first used within the same power-of-two frame window are considered equally urgent,
+// and among those, pipelines which are used consistently across sessions win.
+static inline bool compiles_before(const PipelineUsage &a, const PipelineUsage &b)
+{
+	uint32_t window_a = Util::floor_log2(a.first_use_frame + 1);
+	uint32_t window_b = Util::floor_log2(b.first_use_frame + 1);
+	if (window_a != window_b)
+		return window_a < window_b;
+	else if (a.sessions != b.sessions)
+		return a.sessions > b.sessions;
+	else
+		return a.first_use_order < b.first_use_order;
+}
+
+// Sorts pipelines, anything with a hash member, into compile order.
+// Pipelines with history come first, and the rest keep database order at the end.
+// Returns the number of pipelines with history.
+template <typename T>
+size_t schedule(std::vector<T> &order, const PipelineUsageMap &usage)
+{
+	auto used_end = std::stable_partition(order.begin(), order.end(), [&](const T &pipe) {
+		return usage.count(pipe.hash) != 0;
+	});
+
+	std::stable_sort(order.begin(), used_end, [&](const T &a, const T &b) {
+		return compiles_before(usage.find(a.hash)->second, usage.find(b.hash)->second);
+	});
+
+	return size_t(used_end - order.begin());
+}
+}
+}
@@ -424,6 +424,10 @@ void TimestampInterval::mark_end_of_frame_context()
 {
 	if (total_time > 0.0)
 		total_frame_iterations++;
+
+	if (frame_samples_enabled && frame_context_time > 0.0)
+		frame_samples.push_back(frame_context_time);
+	frame_context_time = 0.0;
 }
 
 uint64_t TimestampInterval::get_total_accumulations() const
@@ -444,6 +448,7 @@ double TimestampInterval::get_total_time() const
 void TimestampInterval::accumulate_time(double t)
 {
 	total_time += t;
+	frame_context_time += t;
 	total_accumulations++;
 }
 
@@ -471,8 +476,32 @@ const std::string &TimestampInterval::get_tag() const
 void TimestampInterval::reset()
 {
 	total_time = 0.0;
+	frame_context_time = 0.0;
 	total_accumulations = 0;
 	total_frame_iterations = 0;
+	frame_samples.clear();
+}
+
+void TimestampInterval::set_frame_samples_enabled(bool enable)
+{
+	frame_samples_enabled = enable;
+	if (!enable)
+		frame_samples.clear();
+}
+
+const std::vector<double> &TimestampInterval::get_frame_samples() const
+{
+	return frame_samples;
+}
+
+void TimestampInterval::set_device_timebase(bool device_timebase_)
+{
+	device_timebase = device_timebase_;
+}
+
+bool TimestampInterval::is_device_timebase() const
+{
+	return device_timebase;
 }
 
 TimestampInterval::TimestampInterval(std::string tag_)
@@ -484,7 +513,13 @@ TimestampInterval *TimestampIntervalManager::get_timestamp_tag(const char *tag)
 {
 	Util::Hasher h;
 	h.string(tag);
-	return timestamps.emplace_yield(h.get(), tag);
+	auto *timestamp = timestamps.find(h.get());
+	if (!timestamp)
+	{
+		timestamp = timestamps.emplace_yield(h.get(), tag);
+		timestamp->set_frame_samples_enabled(frame_samples_enabled);
+	}
+	return timestamp;
 }
 
 void TimestampIntervalManager::mark_end_of_frame_context()
@@ -499,6 +534,13 @@ void TimestampIntervalManager::reset()
 		timestamp.reset();
 }
 
+void TimestampIntervalManager::set_frame_samples_enabled(bool enable)
+{
+	frame_samples_enabled = enable;
+	for (auto &timestamp : timestamps)
+		timestamp.set_frame_samples_enabled(enable);
+}
+
 void TimestampIntervalManager::log_simple(const TimestampIntervalReportCallback &func) const
 {
 	for (auto &timestamp : timestamps)
@@ -510,6 +552,9 @@ void TimestampIntervalManager::log_simple(const TimestampIntervalReportCallback
 			report.time_per_frame_context = timestamp.get_time_per_iteration();
 			report.accumulations_per_frame_context =
 					double(timestamp.get_total_accumulations()) / double(timestamp.get_total_frame_iterations());
+			if (frame_samples_enabled)
+				report.frame_context_samples = &timestamp.get_frame_samples();
+			report.device_timebase = timestamp.is_device_timebase();
 
 			if (func)
 			{
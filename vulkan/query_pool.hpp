@@ -26,6 +26,7 @@
 #include "vulkan_common.hpp"
 #include "object_pool.hpp"
 #include <functional>
+#include <vector>
 
 namespace Vulkan
 {
@@ -156,11 +157,22 @@ public:
 	uint64_t get_total_accumulations() const;
 	void reset();
 
+	// When enabled, the accumulated time of every frame context is kept as a separate sample.
+	void set_frame_samples_enabled(bool enable);
+	const std::vector<double> &get_frame_samples() const;
+
+	void set_device_timebase(bool device_timebase);
+	bool is_device_timebase() const;
+
 private:
 	std::string tag;
 	double total_time = 0.0;
+	double frame_context_time = 0.0;
 	uint64_t total_frame_iterations = 0;
 	uint64_t total_accumulations = 0;
+	std::vector<double> frame_samples;
+	bool frame_samples_enabled = false;
+	bool device_timebase = false;
 };
 
 struct TimestampIntervalReport
@@ -168,6 +180,10 @@ struct TimestampIntervalReport
 	double time_per_accumulation;
 	double time_per_frame_context;
 	double accumulations_per_frame_context;
+	// Only non-null if frame samples are enabled. One entry per frame context in which the interval was active.
+	const std::vector<double> *frame_context_samples;
+	// False if the interval was measured on the host timeline.
+	bool device_timebase;
 };
 
 using TimestampIntervalReportCallback = std::function<void (const std::string &, const TimestampIntervalReport &)>;
@@ -179,8 +195,10 @@ public:
 	void mark_end_of_frame_context();
 	void reset();
 	void log_simple(const TimestampIntervalReportCallback &func = {}) const;
+	void set_frame_samples_enabled(bool enable);
 
 private:
 	Util::IntrusiveHashMap<TimestampInterval> timestamps;
+	bool frame_samples_enabled = false;
 };
 }
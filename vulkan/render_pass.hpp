@@ -145,6 +145,17 @@ public:
 		return subpasses_info[subpass].input_attachments[index];
 	}
 
+	VkFormat get_color_format(unsigned attachment) const
+	{
+		VK_ASSERT(attachment < VULKAN_NUM_ATTACHMENTS);
+		return color_attachments[attachment];
+	}
+
+	VkFormat get_depth_stencil_format() const
+	{
+		return depth_stencil;
+	}
+
 	bool has_depth(unsigned subpass) const
 	{
 		VK_ASSERT(subpass < subpasses_info.size());
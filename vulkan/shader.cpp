@@ -59,12 +59,23 @@ PipelineLayout::PipelineLayout(Hash hash, Device *device_, const CombinedResourc
 	, device(device_)
 	, layout(layout_)
 {
+	select_descriptor_buffer();
+	if (!descriptor_buffer)
+		select_push_descriptor_set();
+
 	VkDescriptorSetLayout layouts[VULKAN_NUM_DESCRIPTOR_SETS] = {};
 	unsigned num_sets = 0;
 	for (unsigned i = 0; i < VULKAN_NUM_DESCRIPTOR_SETS; i++)
 	{
+		DescriptorSetMode mode = DescriptorSetMode::Pool;
+		if (descriptor_buffer)
+			mode = DescriptorSetMode::DescriptorBuffer;
+		else if (push_descriptor_set_mask & (1u << i))
+			mode = DescriptorSetMode::PushDescriptor;
+
 		set_allocators[i] = device->request_descriptor_set_allocator(layout.sets[i], layout.stages_for_bindings[i],
-		                                                             immutable_samplers ? immutable_samplers->samplers[i] : nullptr);
+		                                                             immutable_samplers ? immutable_samplers->samplers[i] : nullptr,
+		                                                             mode);
 		layouts[i] = set_allocators[i]->get_layout();
 		if (layout.descriptor_set_mask & (1u << i))
 			num_sets = i + 1;
@@ -99,7 +110,59 @@ PipelineLayout::PipelineLayout(Hash hash, Device *device_, const CombinedResourc
 	device->register_pipeline_layout(pipe_layout, get_hash(), info);
 #endif
 
-	create_update_templates();
+	if (!descriptor_buffer)
+		create_update_templates();
+}
+
+void PipelineLayout::select_descriptor_buffer()
+{
+	if (!device->get_device_features().supports_descriptor_buffer)
+		return;
+
+	// Every set layout in a descriptor buffer pipeline layout must be a descriptor buffer layout.
+	// Immutable samplers would need embedded sampler sets, texel buffers would need their format
+	// tracked in ResourceBinding, and bindless sets rely on update-after-bind pools.
+	// Such layouts keep using descriptor sets and push descriptors.
+	if (layout.bindless_descriptor_set_mask != 0)
+		return;
+
+	for (auto &set : layout.sets)
+	{
+		if (set.immutable_sampler_mask || set.sampled_texel_buffer_mask || set.storage_texel_buffer_mask)
+			return;
+	}
+
+	descriptor_buffer = true;
+}
+
+void PipelineLayout::select_push_descriptor_set()
+{
+	auto &features = device->get_device_features();
+	if (!features.supports_push_descriptor)
+		return;
+
+	// Only one set per pipeline layout can use push descriptors.
+	// Prefer the highest set index since those tend to be updated per draw,
+	// which is where hashing and pool allocation is the most expensive.
+	for (int set = VULKAN_NUM_DESCRIPTOR_SETS - 1; set >= 0; set--)
+	{
+		if ((layout.descriptor_set_mask & (1u << set)) == 0 ||
+		    (layout.bindless_descriptor_set_mask & (1u << set)) != 0)
+		{
+			continue;
+		}
+
+		uint32_t descriptor_count = 0;
+		for (unsigned binding = 0; binding < VULKAN_NUM_BINDINGS; binding++)
+			if (layout.stages_for_bindings[set][binding] != 0)
+				descriptor_count += layout.sets[set].array_size[binding];
+
+		if (descriptor_count <= features.push_descriptor_properties.maxPushDescriptors)
+		{
+			push_descriptor_set_mask = 1u << set;
+			break;
+		}
+	}
 }
 
 void PipelineLayout::create_update_templates()
@@ -114,6 +177,7 @@ void PipelineLayout::create_update_templates()
 
 		VkDescriptorUpdateTemplateEntry update_entries[VULKAN_NUM_BINDINGS];
 		uint32_t update_count = 0;
+		bool push_descriptor = (push_descriptor_set_mask & (1u << desc_set)) != 0;
 
 		auto &set_layout = layout.sets[desc_set];
 
@@ -121,7 +185,8 @@ void PipelineLayout::create_update_templates()
 			unsigned array_size = set_layout.array_size[binding];
 			VK_ASSERT(update_count < VULKAN_NUM_BINDINGS);
 			auto &entry = update_entries[update_count++];
-			entry.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+			entry.descriptorType = push_descriptor ?
+					VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 			entry.dstBinding = binding;
 			entry.dstArrayElement = 0;
 			entry.descriptorCount = array_size;
@@ -240,7 +305,9 @@ void PipelineLayout::create_update_templates()
 		VkDescriptorUpdateTemplateCreateInfo info = {VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO };
 		info.pipelineLayout = pipe_layout;
 		info.descriptorSetLayout = set_allocators[desc_set]->get_layout();
-		info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+		info.templateType = push_descriptor ?
+				VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR :
+				VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
 		info.set = desc_set;
 		info.descriptorUpdateEntryCount = update_count;
 		info.pDescriptorUpdateEntries = update_entries;
@@ -95,6 +95,8 @@ struct ResourceBinding
 		VkBufferView buffer_view;
 	};
 	VkDeviceSize dynamic_offset;
+	// Only written when descriptor buffers are supported.
+	VkDeviceAddress buffer_address;
 };
 
 struct ResourceBindings
@@ -138,13 +140,29 @@ public:
 		return update_template[set];
 	}
 
+	// At most one set, its update template is of push descriptor type.
+	uint32_t get_push_descriptor_set_mask() const
+	{
+		return push_descriptor_set_mask;
+	}
+
+	// All sets are written into descriptor buffers, there are no update templates.
+	bool uses_descriptor_buffer() const
+	{
+		return descriptor_buffer;
+	}
+
 private:
 	Device *device;
 	VkPipelineLayout pipe_layout = VK_NULL_HANDLE;
 	CombinedResourceLayout layout;
 	DescriptorSetAllocator *set_allocators[VULKAN_NUM_DESCRIPTOR_SETS] = {};
 	VkDescriptorUpdateTemplate update_template[VULKAN_NUM_DESCRIPTOR_SETS] = {};
+	uint32_t push_descriptor_set_mask = 0;
+	bool descriptor_buffer = false;
 	void create_update_templates();
+	void select_push_descriptor_set();
+	void select_descriptor_buffer();
 };
 
 class Shader : public HashedObject<Shader>
@@ -178,6 +196,8 @@ struct Pipeline
 {
 	VkPipeline pipeline;
 	uint32_t dynamic_mask;
+	// Set for pipelines created by Fossilize replay, see Device::register_replayed_pipeline_use().
+	uint32_t replay_slot = ~0u;
 };
 
 class Program : public HashedObject<Program>
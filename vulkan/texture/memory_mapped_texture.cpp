@@ -21,8 +21,17 @@
  */
 
 #include "memory_mapped_texture.hpp"
+#include "thread_group.hpp"
+#include "logging.hpp"
 #include <string.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace Vulkan
 {
@@ -38,12 +47,14 @@ struct MemoryMappedHeader
 	uint32_t levels;
 	uint32_t flags;
 	uint64_t payload_size;
-	uint64_t reserved1;
+	// Only used by supercompressed textures, must be levels * layers.
+	uint64_t num_chunks;
 };
 static const size_t header_size = 16 + 8 * 4 + 2 * 8;
 static_assert(sizeof(MemoryMappedHeader) == header_size, "Header size is not properly packed.");
 
 static const char MAGIC[16] = "GRANITE TEXFMT1";
+static const char MAGIC_SUPERCOMPRESSED[16] = "GRANITE TEXFMT2";
 
 void MemoryMappedTexture::set_generate_mipmaps_on_load(bool enable)
 {
@@ -97,11 +108,15 @@ void MemoryMappedTexture::set_cube(VkFormat format, uint32_t size, uint32_t cube
 	cube = true;
 }
 
-bool MemoryMappedTexture::copy_to_path(Granite::Filesystem &fs, const std::string &path)
+bool MemoryMappedTexture::copy_to_path(Granite::Filesystem &fs, const std::string &path,
+                                       TextureSupercompression compression, Granite::ThreadGroup *group)
 {
-	if (layout.get_required_size() == 0 || !mapped)
+	if (layout.get_required_size() == 0 || !mapped || chunks)
 		return false;
 
+	if (compression != TextureSupercompression::None)
+		return write_supercompressed(fs, path, compression, group);
+
 	auto target_file = fs.open(path, Granite::FileMode::WriteOnly);
 	if (!target_file)
 		return false;
@@ -118,9 +133,17 @@ bool MemoryMappedTexture::map_write(Granite::FileMappingHandle new_file)
 {
 	file = std::move(new_file);
 	mapped = file->mutable_data<uint8_t>();
+	chunks = nullptr;
+
+	write_header(mapped, false);
+	layout.set_buffer(mapped + sizeof(MemoryMappedHeader), layout.get_required_size());
+	return true;
+}
 
+void MemoryMappedTexture::write_header(void *dst, bool supercompressed) const
+{
 	MemoryMappedHeader header = {};
-	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	memcpy(header.magic, supercompressed ? MAGIC_SUPERCOMPRESSED : MAGIC, sizeof(MAGIC));
 	header.width = layout.get_width();
 	header.height = layout.get_height();
 	header.depth = layout.get_depth();
@@ -130,10 +153,9 @@ bool MemoryMappedTexture::map_write(Granite::FileMappingHandle new_file)
 	header.payload_size = layout.get_required_size();
 	header.type = layout.get_image_type();
 	header.format = layout.get_format();
-	memcpy(mapped, &header, sizeof(header));
-
-	layout.set_buffer(mapped + sizeof(header), layout.get_required_size());
-	return true;
+	if (supercompressed)
+		header.num_chunks = uint64_t(layout.get_levels()) * layout.get_layers();
+	memcpy(dst, &header, sizeof(header));
 }
 
 bool MemoryMappedTexture::map_write(Granite::Filesystem &fs, const std::string &path)
@@ -195,6 +217,13 @@ void MemoryMappedTexture::make_local_copy()
 	if (empty())
 		return;
 
+	if (chunks)
+	{
+		if (!decompress_to_local_copy())
+			LOGE("Failed to decompress texture.\n");
+		return;
+	}
+
 	auto new_file = Util::make_handle<ScratchFile>(mapped, get_required_size());
 	file = new_file->map();
 	mapped = file->mutable_data<uint8_t>();
@@ -281,12 +310,17 @@ bool MemoryMappedTexture::map_copy(const void *mapped_, size_t size)
 	return map_read(std::move(new_mapped));
 }
 
-bool MemoryMappedTexture::map_read(Granite::FileMappingHandle new_file)
+bool MemoryMappedTexture::map_read(Granite::FileMappingHandle new_file, bool defer_decompression)
 {
 	file = std::move(new_file);
 	mapped = const_cast<uint8_t *>(file->data<uint8_t>());
+	chunks = nullptr;
+
+	if (file->get_size() < sizeof(MemoryMappedHeader))
+		return false;
 
 	auto *header = reinterpret_cast<const MemoryMappedHeader *>(mapped);
+	bool supercompressed = memcmp(header->magic, MAGIC_SUPERCOMPRESSED, sizeof(MAGIC_SUPERCOMPRESSED)) == 0;
 	switch (header->type)
 	{
 	case VK_IMAGE_TYPE_1D:
@@ -312,16 +346,31 @@ bool MemoryMappedTexture::map_read(Granite::FileMappingHandle new_file)
 	swizzle.b = static_cast<VkComponentSwizzle>((header->flags >> MEMORY_MAPPED_TEXTURE_SWIZZLE_B_SHIFT) & MEMORY_MAPPED_TEXTURE_SWIZZLE_MASK);
 	swizzle.a = static_cast<VkComponentSwizzle>((header->flags >> MEMORY_MAPPED_TEXTURE_SWIZZLE_A_SHIFT) & MEMORY_MAPPED_TEXTURE_SWIZZLE_MASK);
 
-	if ((layout.get_required_size() + sizeof(MemoryMappedHeader)) < file->get_size())
-		return false;
 	if (header->payload_size != layout.get_required_size())
 		return false;
 
+	if (supercompressed)
+	{
+		uint64_t num_chunks = uint64_t(layout.get_levels()) * layout.get_layers();
+		if (header->num_chunks != num_chunks)
+			return false;
+
+		auto *index = parse_supercompressed_index(mapped, file->get_size(), sizeof(MemoryMappedHeader), num_chunks);
+		if (!index)
+			return false;
+
+		chunks = index;
+		return defer_decompression || decompress_to_local_copy();
+	}
+
+	if ((layout.get_required_size() + sizeof(MemoryMappedHeader)) < file->get_size())
+		return false;
+
 	layout.set_buffer(static_cast<uint8_t *>(mapped) + sizeof(MemoryMappedHeader), header->payload_size);
 	return true;
 }
 
-bool MemoryMappedTexture::map_read(Granite::Filesystem &fs, const std::string &path)
+bool MemoryMappedTexture::map_read(Granite::Filesystem &fs, const std::string &path, bool defer_decompression)
 {
 	auto loaded_file = fs.open(path, Granite::FileMode::ReadOnly);
 	if (!loaded_file)
@@ -334,13 +383,183 @@ bool MemoryMappedTexture::map_read(Granite::Filesystem &fs, const std::string &p
 	if (!new_mapped)
 		return false;
 
-	return map_read(std::move(new_mapped));
+	return map_read(std::move(new_mapped), defer_decompression);
+}
+
+// Runs func(index) for every index in [0, count), with helper tasks if a thread group is provided.
+// The calling thread pulls work as well and only waits for work which helpers have already claimed,
+// so this cannot deadlock even if every worker thread is blocked in here.
+struct ParallelChunkState
+{
+	std::function<bool (uint32_t)> func;
+	uint32_t count = 0;
+	std::atomic_uint32_t cursor;
+	std::atomic_uint32_t completed;
+	std::atomic_bool failed;
+	std::mutex lock;
+	std::condition_variable cond;
+
+	void run()
+	{
+		uint32_t index;
+		while ((index = cursor.fetch_add(1, std::memory_order_relaxed)) < count)
+		{
+			if (!func(index))
+				failed.store(true, std::memory_order_relaxed);
+
+			if (completed.fetch_add(1, std::memory_order_acq_rel) + 1 == count)
+			{
+				std::lock_guard<std::mutex> holder{lock};
+				cond.notify_one();
+			}
+		}
+	}
+};
+
+static bool parallel_for_chunks(Granite::ThreadGroup *group, uint32_t count, std::function<bool (uint32_t)> func)
+{
+	if (!group || count <= 1)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			if (!func(i))
+				return false;
+		return true;
+	}
+
+	auto state = std::make_shared<ParallelChunkState>();
+	state->func = std::move(func);
+	state->count = count;
+	state->cursor.store(0, std::memory_order_relaxed);
+	state->completed.store(0, std::memory_order_relaxed);
+	state->failed.store(false, std::memory_order_relaxed);
+
+	{
+		auto task = group->create_task();
+		task->set_desc("texture-chunks");
+		unsigned num_helpers = std::min<unsigned>(group->get_num_threads(), count - 1);
+		for (unsigned i = 0; i < num_helpers; i++)
+			task->enqueue_task([state]() { state->run(); });
+	}
+
+	state->run();
+
+	std::unique_lock<std::mutex> holder{state->lock};
+	state->cond.wait(holder, [&]() {
+		return state->completed.load(std::memory_order_acquire) == count;
+	});
+	return !state->failed.load(std::memory_order_relaxed);
+}
+
+static size_t get_chunk_size(const TextureFormatLayout &layout, uint32_t level)
+{
+	return layout.get_layer_size(level) * layout.get_mip_info(level).depth;
+}
+
+static size_t get_chunk_offset(const TextureFormatLayout &layout, uint32_t level, uint32_t layer)
+{
+	return layout.get_mip_info(level).offset + layer * get_chunk_size(layout, level);
+}
+
+bool MemoryMappedTexture::decompress_levels(void *dst, uint32_t first_level, Granite::ThreadGroup *group) const
+{
+	if (!chunks || first_level >= layout.get_levels())
+		return false;
+
+	uint32_t layers = layout.get_layers();
+	uint32_t first_chunk = first_level * layers;
+	uint32_t num_chunks = layout.get_levels() * layers - first_chunk;
+	size_t base_offset = layout.get_mip_info(first_level).offset;
+
+	return parallel_for_chunks(group, num_chunks, [&](uint32_t index) -> bool {
+		index += first_chunk;
+		uint32_t level = index / layers;
+		uint32_t layer = index % layers;
+		auto &chunk = chunks[index];
+		size_t size = get_chunk_size(layout, level);
+		auto *chunk_dst = static_cast<uint8_t *>(dst) + get_chunk_offset(layout, level, layer) - base_offset;
+
+		if (!decompress_supercompressed_chunk(chunk_dst, size, mapped + chunk.offset, chunk, layout.get_block_stride()))
+		{
+			LOGE("Failed to decompress level %u, layer %u of texture.\n", level, layer);
+			return false;
+		}
+		return true;
+	});
+}
+
+bool MemoryMappedTexture::decompress_to_local_copy()
+{
+	auto new_file = Util::make_handle<ScratchFile>(nullptr, get_required_size());
+	auto new_mapped = new_file->map();
+	auto *new_data = new_mapped->mutable_data<uint8_t>();
+
+	if (!decompress_levels(new_data + sizeof(MemoryMappedHeader), 0))
+		return false;
+
+	write_header(new_data, false);
+	file = std::move(new_mapped);
+	mapped = new_data;
+	chunks = nullptr;
+	layout.set_buffer(mapped + sizeof(MemoryMappedHeader), layout.get_required_size());
+	return true;
+}
+
+bool MemoryMappedTexture::write_supercompressed(Granite::Filesystem &fs, const std::string &path,
+                                                TextureSupercompression compression,
+                                                Granite::ThreadGroup *group) const
+{
+	if (compression != TextureSupercompression::LZ4)
+		return false;
+
+	uint32_t layers = layout.get_layers();
+	uint32_t num_chunks = layout.get_levels() * layers;
+	size_t stride = layout.get_block_stride();
+
+	std::vector<SupercompressedChunk> index(num_chunks);
+	std::vector<std::vector<uint8_t>> payloads(num_chunks);
+
+	bool ret = parallel_for_chunks(group, num_chunks, [&](uint32_t i) -> bool {
+		uint32_t level = i / layers;
+		uint32_t layer = i % layers;
+		size_t size = get_chunk_size(layout, level);
+		auto *src = static_cast<const uint8_t *>(layout.data()) + get_chunk_offset(layout, level, layer);
+
+		return compress_supercompressed_chunk(payloads[i], index[i], src, size, stride);
+	});
+
+	if (!ret)
+		return false;
+
+	size_t offset = sizeof(MemoryMappedHeader) + num_chunks * sizeof(SupercompressedChunk);
+	for (uint32_t i = 0; i < num_chunks; i++)
+	{
+		index[i].offset = offset;
+		offset += index[i].compressed_size;
+	}
+
+	auto target_file = fs.open(path, Granite::FileMode::WriteOnly);
+	if (!target_file)
+		return false;
+
+	auto new_mapped = target_file->map_write(offset);
+	if (!new_mapped)
+		return false;
+
+	auto *dst = new_mapped->mutable_data<uint8_t>();
+	write_header(dst, true);
+	memcpy(dst + sizeof(MemoryMappedHeader), index.data(), num_chunks * sizeof(SupercompressedChunk));
+	for (uint32_t i = 0; i < num_chunks; i++)
+		memcpy(dst + index[i].offset, payloads[i].data(), payloads[i].size());
+
+	LOGI("Supercompressed texture from %zu to %zu bytes.\n", get_required_size(), offset);
+	return true;
 }
 
 bool MemoryMappedTexture::is_header(const void *mapped_, size_t size)
 {
 	if (size < sizeof(MemoryMappedHeader))
 		return false;
-	return memcmp(mapped_, MAGIC, sizeof(MAGIC)) == 0;
+	return memcmp(mapped_, MAGIC, sizeof(MAGIC)) == 0 ||
+	       memcmp(mapped_, MAGIC_SUPERCOMPRESSED, sizeof(MAGIC_SUPERCOMPRESSED)) == 0;
 }
 }
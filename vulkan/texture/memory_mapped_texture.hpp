@@ -23,8 +23,14 @@
 #pragma once
 
 #include "texture_format.hpp"
+#include "texture_supercompression.hpp"
 #include "filesystem.hpp"
 
+namespace Granite
+{
+class ThreadGroup;
+}
+
 namespace Vulkan
 {
 enum MemoryMappedTextureFlagBits
@@ -39,6 +45,8 @@ enum MemoryMappedTextureFlagBits
 };
 using MemoryMappedTextureFlags = uint32_t;
 
+// Supercompressed (v2) textures store every layer of every mip as an independently compressed chunk,
+// so readers only fetch the mips they need, and chunks can be decompressed in parallel.
 class MemoryMappedTexture
 {
 public:
@@ -51,13 +59,28 @@ public:
 
 	bool map_write(Granite::Filesystem &fs, const std::string &path);
 	bool map_write(Granite::FileMappingHandle file);
-	bool map_read(Granite::Filesystem &fs, const std::string &path);
-	bool map_read(Granite::FileMappingHandle file);
+	// Supercompressed textures are decompressed to a local copy on read unless decompression is deferred.
+	// With deferred decompression, the layout has no data, and levels must be read with decompress_levels().
+	bool map_read(Granite::Filesystem &fs, const std::string &path, bool defer_decompression = false);
+	bool map_read(Granite::FileMappingHandle file, bool defer_decompression = false);
 	bool map_copy(const void *mapped, size_t size);
 	bool map_write_scratch();
-	bool copy_to_path(Granite::Filesystem &fs, const std::string &path);
+	bool copy_to_path(Granite::Filesystem &fs, const std::string &path,
+	                  TextureSupercompression compression = TextureSupercompression::None,
+	                  Granite::ThreadGroup *group = nullptr);
 	void make_local_copy();
 
+	inline bool is_supercompressed() const
+	{
+		return chunks != nullptr;
+	}
+
+	// Decompresses levels [first_level, levels) into dst, packed like a layout which starts at first_level.
+	// dst must hold get_layout().get_required_size() - get_layout().get_mip_info(first_level).offset bytes.
+	// If a thread group is provided, chunks are decompressed in parallel.
+	// The calling thread takes part in the work, so this is safe to call from within a task.
+	bool decompress_levels(void *dst, uint32_t first_level, Granite::ThreadGroup *group = nullptr) const;
+
 	inline const Vulkan::TextureFormatLayout &get_layout() const
 	{
 		return layout;
@@ -82,6 +105,7 @@ private:
 	Vulkan::TextureFormatLayout layout;
 	Granite::FileMappingHandle file;
 	uint8_t *mapped = nullptr;
+	const SupercompressedChunk *chunks = nullptr;
 	bool cube = false;
 	bool mipgen_on_load = false;
 	VkComponentMapping swizzle = {
@@ -90,5 +114,10 @@ private:
 		VK_COMPONENT_SWIZZLE_B,
 		VK_COMPONENT_SWIZZLE_A,
 	};
+
+	void write_header(void *dst, bool supercompressed) const;
+	bool decompress_to_local_copy();
+	bool write_supercompressed(Granite::Filesystem &fs, const std::string &path,
+	                           TextureSupercompression compression, Granite::ThreadGroup *group) const;
 };
 }
@@ -42,7 +42,7 @@ public:
 	static uint32_t num_miplevels(uint32_t width, uint32_t height = 1, uint32_t depth = 1);
 
 	void set_buffer(void *buffer, size_t size);
-	inline void *get_buffer()
+	inline void *get_buffer() const
 	{
 		return buffer;
 	}
@@ -0,0 +1,138 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "texture_supercompression.hpp"
+#include "lz4_block.hpp"
+#include <string.h>
+
+namespace Vulkan
+{
+const SupercompressedChunk *parse_supercompressed_index(const uint8_t *data, size_t size,
+                                                        size_t index_offset, uint64_t num_chunks)
+{
+	if (index_offset > size || num_chunks > (size - index_offset) / sizeof(SupercompressedChunk))
+		return nullptr;
+
+	uint64_t payload_begin = index_offset + num_chunks * sizeof(SupercompressedChunk);
+	auto *index = reinterpret_cast<const SupercompressedChunk *>(data + index_offset);
+	for (uint64_t i = 0; i < num_chunks; i++)
+	{
+		if (index[i].offset < payload_begin || index[i].offset > size ||
+		    index[i].compressed_size > size - index[i].offset)
+		{
+			return nullptr;
+		}
+	}
+
+	return index;
+}
+
+static void block_shuffle(uint8_t *dst, const uint8_t *src, size_t size, size_t stride)
+{
+	size_t num_blocks = size / stride;
+	for (size_t i = 0; i < num_blocks; i++)
+		for (size_t b = 0; b < stride; b++)
+			dst[b * num_blocks + i] = src[i * stride + b];
+}
+
+static void block_unshuffle(uint8_t *dst, const uint8_t *src, size_t size, size_t stride)
+{
+	size_t num_blocks = size / stride;
+	for (size_t b = 0; b < stride; b++)
+		for (size_t i = 0; i < num_blocks; i++)
+			dst[i * stride + b] = src[b * num_blocks + i];
+}
+
+bool decompress_supercompressed_chunk(uint8_t *dst, size_t size, const uint8_t *src,
+                                      const SupercompressedChunk &chunk, size_t stride)
+{
+	switch (chunk.compression)
+	{
+	case TextureSupercompression::None:
+		if (chunk.compressed_size != size || chunk.filter != ChunkFilter::None)
+			return false;
+		memcpy(dst, src, size);
+		return true;
+
+	case TextureSupercompression::LZ4:
+		if (chunk.filter == ChunkFilter::None)
+			return Util::lz4_decompress(dst, size, src, chunk.compressed_size);
+		else if (chunk.filter == ChunkFilter::BlockShuffle)
+		{
+			if (!stride || size % stride)
+				return false;
+
+			// Decompress to scratch, the unshuffle has to read the planes anyway.
+			std::vector<uint8_t> shuffled(size);
+			if (!Util::lz4_decompress(shuffled.data(), size, src, chunk.compressed_size))
+				return false;
+			block_unshuffle(dst, shuffled.data(), size, stride);
+			return true;
+		}
+		else
+			return false;
+
+	default:
+		return false;
+	}
+}
+
+bool compress_supercompressed_chunk(std::vector<uint8_t> &payload, SupercompressedChunk &chunk,
+                                    const uint8_t *src, size_t size, size_t stride)
+{
+	payload.resize(Util::lz4_compress_bound(size));
+	size_t compressed_size = Util::lz4_compress(payload.data(), payload.size(), src, size);
+	if (!compressed_size)
+		return false;
+	chunk.compression = TextureSupercompression::LZ4;
+	chunk.filter = ChunkFilter::None;
+
+	// Keep whichever filter compresses better.
+	if (stride > 1 && size % stride == 0)
+	{
+		std::vector<uint8_t> shuffled(size);
+		std::vector<uint8_t> shuffled_payload(payload.size());
+		block_shuffle(shuffled.data(), src, size, stride);
+		size_t shuffled_size = Util::lz4_compress(shuffled_payload.data(), shuffled_payload.size(),
+		                                          shuffled.data(), size);
+		if (shuffled_size && shuffled_size < compressed_size)
+		{
+			payload = std::move(shuffled_payload);
+			compressed_size = shuffled_size;
+			chunk.filter = ChunkFilter::BlockShuffle;
+		}
+	}
+
+	// Incompressible data is stored as-is.
+	if (compressed_size >= size)
+	{
+		payload.assign(src, src + size);
+		compressed_size = size;
+		chunk.compression = TextureSupercompression::None;
+		chunk.filter = ChunkFilter::None;
+	}
+
+	payload.resize(compressed_size);
+	chunk.compressed_size = compressed_size;
+	return true;
+}
+}
@@ -0,0 +1,73 @@
+/* Copyright (c) 2017-2023 Hans-Kristian Arntzen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Chunk level encoding of supercompressed (v2) GTX files.
+// This has no Vulkan dependency so the container can be validated and tested on its own.
+namespace Vulkan
+{
+enum class TextureSupercompression : uint32_t
+{
+	None = 0,
+	LZ4 = 1
+};
+
+enum class ChunkFilter : uint32_t
+{
+	None = 0,
+	// Bytes are transposed by their position within a block, i.e. all first bytes of every block,
+	// then all second bytes, etc. This groups endpoints and indices of compressed blocks,
+	// and channels of uncompressed texels, which helps the LZ matcher considerably.
+	BlockShuffle = 1
+};
+
+// Supercompressed textures follow the header with one chunk per layer per level, level-major.
+// Payloads follow the chunk index.
+struct SupercompressedChunk
+{
+	uint64_t offset;
+	uint64_t compressed_size;
+	TextureSupercompression compression;
+	ChunkFilter filter;
+};
+static_assert(sizeof(SupercompressedChunk) == 24, "Chunk size is not properly packed.");
+
+// Returns the chunk index which starts at index_offset in a file of size bytes,
+// or nullptr if the index is truncated, or any chunk overlaps the index or extends past the end of the file.
+const SupercompressedChunk *parse_supercompressed_index(const uint8_t *data, size_t size,
+                                                        size_t index_offset, uint64_t num_chunks);
+
+// Decodes a chunk which must expand to exactly size bytes. src points to the chunk payload.
+// stride is the texel block size, which BlockShuffle operates on.
+bool decompress_supercompressed_chunk(uint8_t *dst, size_t size, const uint8_t *src,
+                                      const SupercompressedChunk &chunk, size_t stride);
+
+// Encodes size bytes with the smallest of the supported encodings, falling back to a raw chunk.
+// Fills in everything but chunk.offset.
+bool compress_supercompressed_chunk(std::vector<uint8_t> &payload, SupercompressedChunk &chunk,
+                                    const uint8_t *src, size_t size, size_t stride);
+}